@@ -253,7 +253,9 @@ function TEST_mon_features() {
     jq_success "$jqinput" "$jqfilter" "pacific" || return 1
     jqfilter='.monmap.features.persistent[]|select(. == "elector-pinging")'
     jq_success "$jqinput" "$jqfilter" "elector-pinging" || return 1
-    jqfilter='.monmap.features.persistent | length == 8'
+    jqfilter='.monmap.features.persistent[]|select(. == "log-chunks")'
+    jq_success "$jqinput" "$jqfilter" "log-chunks" || return 1
+    jqfilter='.monmap.features.persistent | length == 9'
     jq_success "$jqinput" "$jqfilter" || return 1
 
     CEPH_ARGS=$CEPH_ARGS_orig
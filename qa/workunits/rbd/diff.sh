@@ -8,6 +8,8 @@ function cleanup() {
     rbd rm foo.copy || :
     rbd snap purge foo.copy2 || :
     rbd rm foo.copy2 || :
+    rbd snap purge foo.copy3 || :
+    rbd rm foo.copy3 || :
     rm -f foo.diff foo.out
 }
 
@@ -47,6 +49,21 @@ if [ "$orig" != "$copy" ]; then
     exit 1
 fi
 
+# streamed diffs are applied concurrently
+rbd create foo.copy3 --size 1000
+rbd export-diff --whole-object foo@three - | \
+    rbd import-diff --rbd-concurrent-management-ops 32 - foo.copy3
+rbd export foo@three foo.out
+orig=`md5sum foo.out | awk '{print $1}'`
+rm foo.out
+rbd export foo.copy3@three foo.out
+copy=`md5sum foo.out | awk '{print $1}'`
+
+if [ "$orig" != "$copy" ]; then
+    echo does not match
+    exit 1
+fi
+
 cleanup
 
 echo OK
@@ -327,4 +327,23 @@ _sudo dd if=${DATA} of=${TEMPDIR}/mnt/test1 bs=1M count=1 oflag=direct
 _sudo umount ${TEMPDIR}/mnt
 unmap_device ${DEV} ${PID}
 
+# test multiple connections
+expect_false _sudo rbd-nbd map --num-connections 4 ${POOL}/${IMAGE}
+DEV=`_sudo rbd-nbd map --try-netlink --num-connections 4 ${POOL}/${IMAGE}`
+get_pid
+_sudo dd if=${DATA} of=${DEV} bs=1M count=4 oflag=direct
+_sudo rbd-nbd detach ${POOL}/${IMAGE}
+expect_false get_pid
+expect_false _sudo rbd-nbd attach --device ${DEV} --num-connections 2 \
+    ${POOL}/${IMAGE}
+_sudo rbd-nbd attach --device ${DEV} ${POOL}/${IMAGE}
+get_pid
+_sudo cmp -n 4M ${DATA} ${DEV}
+_sudo rbd-nbd detach ${POOL}/${IMAGE}
+expect_false get_pid
+_sudo rbd-nbd attach --device ${DEV} --num-connections 4 ${POOL}/${IMAGE}
+get_pid
+_sudo dd if=${DATA} of=${DEV} bs=1M count=4 oflag=direct
+unmap_device ${DEV} ${PID}
+
 echo OK
@@ -0,0 +1,5 @@
+#!/bin/sh -e
+
+ceph_test_rgw_lc_checkpoint
+
+exit 0
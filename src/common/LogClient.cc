@@ -246,6 +246,7 @@ void LogChannel::do_log(clog_type prio, const std::string& s)
 ceph::ref_t<Message> LogClient::get_mon_log_message(bool flush)
 {
   std::lock_guard l(log_lock);
+  _flush_repeats(ceph_clock_now(), flush);
   if (flush) {
     if (log_queue.empty())
       return nullptr;
@@ -318,6 +319,16 @@ void LogClient::_send_to_mon()
 version_t LogClient::queue(LogEntry &entry)
 {
   std::lock_guard l(log_lock);
+  _flush_repeats(entry.stamp);
+  if (_is_repeat(entry)) {
+    return last_log;
+  }
+  return _queue(entry);
+}
+
+version_t LogClient::_queue(LogEntry &entry)
+{
+  ceph_assert(ceph_mutex_is_locked(log_lock));
   entry.seq = ++last_log;
   log_queue.push_back(entry);
 
@@ -328,6 +339,55 @@ version_t LogClient::queue(LogEntry &entry)
   return entry.seq;
 }
 
+bool LogClient::_is_repeat(const LogEntry &entry)
+{
+  ceph_assert(ceph_mutex_is_locked(log_lock));
+  // the monitor logs to itself as it goes and has no tick to send the
+  // summaries from, so only the other daemons fold their repeats
+  if (is_mon) {
+    return false;
+  }
+  double interval = cct->_conf.get_val<double>("clog_repeat_interval");
+  if (interval <= 0) {
+    return false;
+  }
+  auto key = std::make_tuple(entry.channel, entry.prio, entry.msg);
+  auto p = repeats.find(key);
+  if (p == repeats.end()) {
+    repeats.emplace(key, repeated_entry_t{entry, entry.stamp, 0});
+    return false;
+  }
+  p->second.last = entry.stamp;
+  ++p->second.count;
+  return true;
+}
+
+void LogClient::_flush_repeats(utime_t now, bool all)
+{
+  ceph_assert(ceph_mutex_is_locked(log_lock));
+  double interval = cct->_conf.get_val<double>("clog_repeat_interval");
+  for (auto p = repeats.begin(); p != repeats.end(); ) {
+    auto& r = p->second;
+    if (!all && interval > 0 &&
+	(double)now - (double)r.first.stamp < interval) {
+      ++p;
+      continue;
+    }
+    if (r.count) {
+      ldout(cct,10) << __func__ << " " << r.count << " repeats of "
+		    << r.first << dendl;
+      LogEntry e = r.first;
+      e.stamp = r.last;
+      ostringstream ss;
+      ss << e.msg << " (repeated " << r.count << " more times since "
+	 << r.first.stamp << ")";
+      e.msg = ss.str();
+      _queue(e);
+    }
+    p = repeats.erase(p);
+  }
+}
+
 uint64_t LogClient::get_next_seq()
 {
   std::lock_guard l(log_lock);
@@ -16,6 +16,7 @@
 #define CEPH_LOGCLIENT_H
 
 #include <atomic>
+#include <tuple>
 #include "common/LogEntry.h"
 #include "common/ceph_mutex.h"
 #include "common/ostream_temp.h"
@@ -238,6 +239,11 @@ public:
 private:
   ceph::ref_t<Message> _get_mon_log_message();
   void _send_to_mon();
+  version_t _queue(LogEntry &entry);
+  bool _is_repeat(const LogEntry &entry);
+  /// queue the summaries of the repeats whose interval is over, or of
+  /// all of them
+  void _flush_repeats(utime_t now, bool all = false);
 
   CephContext *cct;
   Messenger *messenger;
@@ -248,6 +254,19 @@ private:
   version_t last_log;
   std::deque<LogEntry> log_queue;
 
+  /**
+   * messages repeated within clog_repeat_interval of their first
+   * occurrence are not queued: they are counted here and sent as a
+   * single summary entry once the interval is over.
+   */
+  struct repeated_entry_t {
+    LogEntry first;
+    utime_t last;
+    unsigned count = 0;
+  };
+  std::map<std::tuple<std::string, clog_type, std::string>,
+	   repeated_entry_t> repeats;
+
   std::map<std::string, LogChannelRef> channels;
 
 };
@@ -125,8 +125,14 @@ struct LogSummary {
     tail_by_channel[e.channel].push_back(std::make_pair(++seq, e));
   }
   void prune(size_t max) {
+    prune({}, max);
+  }
+  // keep max_by_channel[channel] entries of each channel, or max if unset
+  void prune(const std::map<std::string,size_t>& max_by_channel, size_t max) {
     for (auto& i : tail_by_channel) {
-      while (i.second.size() > max) {
+      auto m = max_by_channel.find(i.first);
+      size_t channel_max = m == max_by_channel.end() ? max : m->second;
+      while (i.second.size() > channel_max) {
 	keys.erase(i.second.front().second.key());
 	i.second.pop_front();
       }
@@ -703,6 +703,14 @@ std::vector<Option> get_global_options() {
     .set_description("Graylog port number for cluster log messages")
     .add_see_also("clog_to_graylog"),
 
+    Option("clog_repeat_interval", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(5.0)
+    .set_min(0.0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Interval (seconds) over which daemons fold repeated cluster log messages into one")
+    .set_long_description("A cluster log message with the same channel, priority and text as one sent less than this many seconds earlier is not sent to the monitors again; once the interval is over, a single entry with the number of repeats is sent instead. 0 sends every message.")
+    .add_see_also("clog_to_monitors"),
+
     Option("mon_cluster_log_to_stderr", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .add_service("mon")
@@ -1377,6 +1385,12 @@ std::vector<Option> get_global_options() {
     .add_service("mon")
     .set_description("maximum number of OSDMaps to cache in memory"),
 
+    Option("mon_osd_share_map_encoding", Option::TYPE_BOOL, Option::LEVEL_DEV)
+    .set_default(true)
+    .add_service("mon")
+    .set_description("encode the OSDMap messages for subscribers once per range of maps and feature set")
+    .set_long_description("Subscribers that need the same range of maps and have the same significant features share one encoded message payload rather than each getting the maps encoded again. At most mon_osd_cache_size encodings of the latest epoch are kept."),
+
     Option("mon_osd_cache_size_min", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(128_M)
     .add_service("mon")
@@ -1910,6 +1924,23 @@ std::vector<Option> get_global_options() {
     .add_service("mon")
     .set_description("number of recent cluster log messages to retain"),
 
+    Option("mon_log_max_summary_by_channel", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("")
+    .add_service("mon")
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("number of recent cluster log messages to retain per channel")
+    .set_long_description("A list of key/value pairs where the key is the log channel and the value the number of its recent messages to retain, e.g. 'audit=200 cluster=100'. Channels not listed retain the 'default' value if there is one, mon_log_max_summary messages otherwise.")
+    .add_see_also("mon_log_max_summary"),
+
+    Option("mon_cluster_log_compression", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("snappy")
+    .set_enum_allowed({"none", "snappy", "zlib", "zstd", "lz4"})
+    .add_service("mon")
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("compression algorithm for the cluster log entries stored by the monitors")
+    .set_long_description("Once all the monitors support the log-chunks feature, the cluster log entries of each paxos version are stored in one chunk per channel, compressed with this algorithm.")
+    .add_see_also("mon_max_log_epochs"),
+
     Option("mon_max_log_entries_per_event", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(4096)
     .add_service("mon")
@@ -2182,6 +2213,21 @@ std::vector<Option> get_global_options() {
     .add_service("mon")
     .set_description("database backend to use for the mon database"),
 
+    Option("mon_log_store_prefixes", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("")
+    .set_flag(Option::FLAG_CREATE)
+    .add_service("mon")
+    .set_description("store the versions of these prefixes in an append-only log instead of the mon database")
+    .set_long_description("A list of mon store prefixes, e.g. 'paxos,osdmap,logm'.  Their versioned keys are appended to segment files under store.log, and old versions are trimmed by removing whole segments rather than by compacting the database.  The other keys of these prefixes stay in the database.  Only used when the mon store is created.")
+    .add_see_also("mon_log_store_segment_size"),
+
+    Option("mon_log_store_segment_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_M)
+    .set_min(1_M)
+    .add_service("mon")
+    .set_description("size at which a new segment of the mon log store is started")
+    .add_see_also("mon_log_store_prefixes"),
+
     Option("mon_debug_unsafe_allow_tier_with_nonempty_snaps", Option::TYPE_BOOL, Option::LEVEL_DEV)
     .set_default(false)
     .add_service("mon")
@@ -2250,6 +2296,18 @@ std::vector<Option> get_global_options() {
     .add_service("mon")
     .set_description(""),
 
+    Option("paxos_propose_batch_max_delay", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.05)
+    .add_service("mon")
+    .set_description("Longest time to hold back a proposal to batch changes")
+    .set_long_description("While proposals follow each other closely (within "
+                          "paxos_propose_interval of the previous commit), the "
+                          "leader waits up to half the average proposal "
+                          "round latency, capped by this value, before "
+                          "proposing, so that changes of other services are "
+                          "committed in the same round. 0 disables this.")
+    .add_see_also("paxos_propose_interval"),
+
     Option("paxos_min", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(500)
     .add_service("mon")
@@ -5321,6 +5379,16 @@ std::vector<Option> get_global_options() {
                           "if you simply do not require the most up to date "
                           "performance counter data."),
 
+    Option("mgr_stats_delta", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .add_service("mgr")
+    .set_description("Have daemons send only changed perf counters to manager")
+    .set_long_description("When enabled, daemons only send the values of "
+                          "the perf counters that changed since their "
+                          "previous report, delta and varint encoded, "
+                          "instead of the values of all counters.")
+    .add_see_also("mgr_stats_period"),
+
     Option("mgr_client_bytes", Option::TYPE_SIZE, Option::LEVEL_DEV)
     .set_default(128_M)
     .add_service("mgr"),
@@ -5722,6 +5790,17 @@ std::vector<Option> get_rgw_options() {
       "Number of threads in per-LCWorker workpools--used to accelerate "
       "per-bucket processing"),
 
+    Option("rgw_lc_shard_parallel", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Split lifecycle processing of a bucket by index shard")
+    .set_long_description(
+      "When enabled, each lifecycle rule of a bucket with more than one "
+      "index shard is applied shard by shard, with shards spread across the "
+      "per-LCWorker workpool. Progress is checkpointed per shard so that a "
+      "bucket which does not finish within rgw_lifecycle_work_time resumes "
+      "from the last processed key on the next run.")
+    .add_see_also({"rgw_lc_max_wp_worker", "rgw_lifecycle_work_time"}),
+
     Option("rgw_lc_max_objs", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(32)
     .set_description("Number of lifecycle data shards")
@@ -6283,6 +6362,45 @@ std::vector<Option> get_rgw_options() {
         "listener needs to clear data (by reading it) quickly enough.")
     .add_see_also({"rgw_enable_ops_log", "rgw_ops_log_socket_path"}),
 
+    Option("rgw_ops_log_async", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Write ops log entries asynchronously in batches")
+    .set_long_description(
+        "If set, ops log entries are buffered in memory and written out by a "
+        "background thread: entries for the same rados log object are appended "
+        "with a single operation, and formatting for the ops log socket is done "
+        "off the request path. Entries still buffered when RGW crashes are lost.")
+    .add_see_also({"rgw_enable_ops_log", "rgw_ops_log_flush_interval",
+                   "rgw_ops_log_flush_size", "rgw_ops_log_max_buffer",
+                   "rgw_ops_log_file_path"}),
+
+    Option("rgw_ops_log_flush_interval", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1000)
+    .set_description("Maximum time in milliseconds async ops log entries are buffered")
+    .add_see_also({"rgw_ops_log_async"}),
+
+    Option("rgw_ops_log_flush_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(1_M)
+    .set_description("Amount of buffered async ops log data that triggers a flush")
+    .add_see_also({"rgw_ops_log_async"}),
+
+    Option("rgw_ops_log_max_buffer", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_M)
+    .set_description("Maximum amount of buffered async ops log data")
+    .set_long_description(
+        "When the flush thread falls behind and this much data is buffered, new "
+        "ops log entries are dropped and counted in the ops_log_dropped perf counter.")
+    .add_see_also({"rgw_ops_log_async"}),
+
+    Option("rgw_ops_log_file_path", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("")
+    .set_description("Local file to append binary ops log entries to")
+    .set_long_description(
+        "When set together with rgw_ops_log_async, encoded ops log entries are "
+        "also appended to this file, in the same format as rados ops log objects. "
+        "Use 'radosgw-admin log show --infile <path>' to decode it.")
+    .add_see_also({"rgw_ops_log_async"}),
+
     Option("rgw_fcgi_socket_backlog", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(1024)
     .set_description("FastCGI socket connection backlog")
@@ -6378,6 +6496,16 @@ std::vector<Option> get_rgw_options() {
     .set_description("Max number of keys to remove from garbage collector log in a single operation")
     .add_see_also({"rgw_gc_max_objs", "rgw_gc_obj_min_wait", "rgw_gc_processor_max_time", "rgw_gc_max_concurrent_io"}),
 
+    Option("rgw_gc_max_concurrent_shards", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(4)
+    .set_min(1)
+    .set_description("Number of garbage collector shards processed concurrently")
+    .set_long_description(
+        "The number of garbage collector data shards that a single RGW process will "
+        "work on in parallel during a collection cycle. Each shard worker has its own "
+        "pool of rgw_gc_max_concurrent_io RADOS operations.")
+    .add_see_also({"rgw_gc_max_objs", "rgw_gc_max_concurrent_io"}),
+
     Option("rgw_gc_max_deferred_entries_size", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(3072)
     .set_description("maximum allowed size of deferred entries in queue head for gc"),
@@ -7208,6 +7336,65 @@ std::vector<Option> get_rgw_options() {
     .add_see_also("rgw_dmclock_metadata_res")
     .add_see_also("rgw_dmclock_metadata_wgt"),
 
+    Option("rgw_dmclock_client_key", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("none")
+    .set_enum_allowed( { "none", "tenant", "bucket" } )
+    .set_description("Key data and metadata requests to per-client mclock classes")
+    .set_long_description(
+        "When set to 'tenant' or 'bucket', data and metadata requests are "
+        "scheduled in an mclock class per bucket tenant or per bucket, created "
+        "on the first request and erased once idle, so that a single busy "
+        "client can't starve the others. Requests without a tenant or bucket "
+        "in their url keep using the data and metadata classes.")
+    .add_see_also("rgw_dmclock_client_res")
+    .add_see_also("rgw_dmclock_client_overrides"),
+
+    Option("rgw_dmclock_client_res", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.0)
+    .set_description("mclock reservation for per-client classes")
+    .add_see_also("rgw_dmclock_client_key")
+    .add_see_also("rgw_dmclock_client_wgt")
+    .add_see_also("rgw_dmclock_client_lim"),
+
+    Option("rgw_dmclock_client_wgt", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(100.0)
+    .set_description("mclock weight for per-client classes")
+    .add_see_also("rgw_dmclock_client_key")
+    .add_see_also("rgw_dmclock_client_res")
+    .add_see_also("rgw_dmclock_client_lim"),
+
+    Option("rgw_dmclock_client_lim", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.0)
+    .set_description("mclock limit for per-client classes")
+    .add_see_also("rgw_dmclock_client_key")
+    .add_see_also("rgw_dmclock_client_res")
+    .add_see_also("rgw_dmclock_client_wgt"),
+
+    Option("rgw_dmclock_client_overrides", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("")
+    .set_description("mclock settings of individual per-client classes")
+    .set_long_description(
+        "A space separated list of <key>=<res>,<wgt>,<lim> entries, where the "
+        "key is a tenant name or a bucket name (as <tenant>:<bucket> for "
+        "tenanted buckets) depending on rgw_dmclock_client_key. Classes "
+        "without an entry use rgw_dmclock_client_{res,wgt,lim}.")
+    .add_see_also("rgw_dmclock_client_key"),
+
+    Option("rgw_dmclock_client_idle_age", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(600)
+    .set_min(2)
+    .set_description("Seconds without requests before a per-client class is idle")
+    .set_long_description(
+        "An idle class loses its accumulated tags, so that it starts afresh "
+        "when its requests resume. Takes effect on restart.")
+    .add_see_also("rgw_dmclock_client_erase_age"),
+
+    Option("rgw_dmclock_client_erase_age", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(900)
+    .set_description("Seconds without requests before a per-client class and its perf counters are erased")
+    .set_long_description("Takes effect on restart for the scheduler queue.")
+    .add_see_also("rgw_dmclock_client_idle_age"),
+
    Option("rgw_data_log_backing", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("auto")
     .set_enum_allowed( { "auto", "fifo", "omap" } )
@@ -7331,6 +7518,20 @@ static std::vector<Option> get_rbd_options() {
     .set_default(false)
     .set_description("whether to enable rbd shared ro cache"),
 
+    Option("rbd_read_cache_enabled", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("whether to cache object data read from the cluster on local storage")
+    .set_long_description("HEAD data is only cached while the image owns the exclusive lock. Snapshot data is always cached. The cache is discarded when the image is closed."),
+
+    Option("rbd_read_cache_path", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("/tmp")
+    .set_description("location of the local read cache file"),
+
+    Option("rbd_read_cache_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(1_G)
+    .set_min(1_M)
+    .set_description("size of the local read cache file"),
+
     Option("rbd_concurrent_management_ops", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(10)
     .set_min(1)
@@ -7669,7 +7870,8 @@ static std::vector<Option> get_rbd_options() {
     Option("rbd_io_scheduler_simple_max_delay", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(0)
     .set_min(0)
-    .set_description("maximum io delay (in milliseconds) for simple io scheduler (if set to 0 dalay is calculated based on latency stats)"),
+    .set_description("maximum io delay (in milliseconds) for simple io scheduler (if set to 0 dalay is calculated based on latency stats)")
+    .set_long_description("The actual delay adapts to the write inter-arrival time: writes are not delayed if they arrive further apart than the maximum delay and are otherwise delayed for a few inter-arrival times."),
 
     Option("rbd_rwl_enabled", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
@@ -7686,7 +7888,13 @@ static std::vector<Option> get_rbd_options() {
 
     Option("rbd_rwl_path", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("/tmp")
-    .set_description("location of the persistent write back cache in a DAX-enabled filesystem on persistent memory"),
+    .set_description("location of the persistent write back cache in a DAX-enabled filesystem on persistent memory, or in a filesystem on an SSD in ssd mode"),
+
+    Option("rbd_rwl_mode", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("rwl")
+    .set_enum_allowed({"rwl", "ssd"})
+    .set_description("persistent write back cache mode")
+    .set_long_description("rwl keeps the cache on persistent memory; ssd keeps it in a file on an SSD. The mode is recorded with a cache when it is created."),
 
     Option("rbd_quiesce_notification_attempts", Option::TYPE_UINT, Option::LEVEL_DEV)
     .set_default(10)
@@ -7698,6 +7906,25 @@ static std::vector<Option> get_rbd_options() {
     .set_enum_allowed({"required", "ignore-error", "skip"})
     .set_description("default snapshot quiesce mode"),
 
+    Option("rbd_migration_http_max_connections", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(4)
+    .set_min(1)
+    .set_description("maximum number of concurrent connections to an HTTP or S3 migration source"),
+
+    Option("rbd_migration_http_block_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(1_M)
+    .set_min(4_K)
+    .set_description("size of the blocks read from an HTTP or S3 migration source"),
+
+    Option("rbd_migration_http_cache_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_M)
+    .set_description("maximum size of the block cache of an HTTP or S3 migration source"),
+
+    Option("rbd_migration_http_prefetch_blocks", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(8)
+    .set_description("number of blocks to prefetch from an HTTP or S3 migration source on sequential reads")
+    .set_long_description("Set to 0 to disable prefetching."),
+
     Option("rbd_plugins", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("")
     .set_description("comma-delimited list of librbd plugins to enable"),
@@ -7728,6 +7955,20 @@ static std::vector<Option> get_rbd_mirror_options() {
     .set_default(5)
     .set_description("maximum number of image syncs in parallel"),
 
+    Option("rbd_mirror_image_sync_bps_limit", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("maximum number of bytes per second read by all image syncs, 0 means unlimited")
+    .add_see_also("rbd_mirror_concurrent_image_syncs"),
+
+    Option("rbd_mirror_image_sync_bps_burst", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("the desired burst limit of image sync read bytes, 0 means rbd_mirror_image_sync_bps_limit"),
+
+    Option("rbd_mirror_image_sync_bps_burst_seconds", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1)
+    .set_min(1)
+    .set_description("the desired burst duration in seconds of image sync read bytes"),
+
     Option("rbd_mirror_pool_replayers_refresh_interval", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(30)
     .set_description("interval to refresh peers in rbd-mirror daemon"),
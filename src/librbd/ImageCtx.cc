@@ -284,6 +284,14 @@ librados::IoCtx duplicate_io_ctx(librados::IoCtx& io_ctx) {
     plb.add_u64_counter(l_librbd_readahead, "readahead", "Read ahead");
     plb.add_u64_counter(l_librbd_readahead_bytes, "readahead_bytes", "Data size in read ahead", NULL, 0, unit_t(UNIT_BYTES));
     plb.add_u64_counter(l_librbd_invalidate_cache, "invalidate_cache", "Cache invalidates");
+    plb.add_u64_counter(l_librbd_read_cache_hit, "read_cache_hit", "Read cache hits");
+    plb.add_u64_counter(l_librbd_read_cache_hit_bytes, "read_cache_hit_bytes", "Data size in read cache hits", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_librbd_read_cache_miss, "read_cache_miss", "Read cache misses");
+    plb.add_u64_counter(l_librbd_read_cache_miss_bytes, "read_cache_miss_bytes", "Data size in read cache misses", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_librbd_read_cache_evict, "read_cache_evict", "Read cache block evictions");
+    plb.add_u64_counter(l_librbd_io_scheduler_delayed_writes, "io_scheduler_delayed_writes", "Writes delayed by the IO scheduler");
+    plb.add_u64_counter(l_librbd_io_scheduler_dispatched_writes, "io_scheduler_dispatched_writes", "Merged writes dispatched by the IO scheduler");
+    plb.add_time_avg(l_librbd_io_scheduler_delay, "io_scheduler_delay", "Time writes were delayed by the IO scheduler");
 
     plb.add_time(l_librbd_opened_time, "opened_time", "Opened time",
                  "ots", perf_prio);
@@ -52,6 +52,16 @@ enum {
 
   l_librbd_invalidate_cache,
 
+  l_librbd_read_cache_hit,
+  l_librbd_read_cache_hit_bytes,
+  l_librbd_read_cache_miss,
+  l_librbd_read_cache_miss_bytes,
+  l_librbd_read_cache_evict,
+
+  l_librbd_io_scheduler_delayed_writes,
+  l_librbd_io_scheduler_dispatched_writes,
+  l_librbd_io_scheduler_delay,
+
   l_librbd_opened_time,
   l_librbd_lock_acquired_time,
 
@@ -0,0 +1,603 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "librbd/cache/ReadCacheObjectDispatch.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include "common/safe_io.h"
+#include "include/intarith.h"
+#include "librbd/ExclusiveLock.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/Utils.h"
+#include "librbd/asio/ContextWQ.h"
+#include "librbd/io/ObjectDispatchSpec.h"
+#include "librbd/io/ObjectDispatcherInterface.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::cache::ReadCacheObjectDispatch: " \
+                           << this << " " << __func__ << ": "
+
+namespace librbd {
+namespace cache {
+
+using librbd::util::data_object_name;
+
+namespace {
+
+// returns the extent contents with holes (and missing objects) zeroed
+bufferlist get_dense_data(int r, const io::ReadExtent& extent) {
+  bufferlist data;
+  if (r == -ENOENT) {
+    data.append_zero(extent.length);
+    return data;
+  }
+
+  if (extent.extent_map.empty()) {
+    data = extent.bl;
+  } else {
+    uint64_t pos = extent.offset;
+    auto it = extent.bl.cbegin();
+    for (auto& [off, len] : extent.extent_map) {
+      if (off > pos) {
+        data.append_zero(off - pos);
+      }
+      it.copy(len, data);
+      pos = off + len;
+    }
+  }
+  if (data.length() < extent.length) {
+    data.append_zero(extent.length - data.length());
+  }
+  return data;
+}
+
+} // anonymous namespace
+
+template <typename I>
+ReadCacheObjectDispatch<I>::ReadCacheObjectDispatch(
+    I* image_ctx, const std::string& path, uint64_t size)
+  : m_image_ctx(image_ctx), m_path(path), m_size(size),
+    m_lock(ceph::make_mutex(util::unique_lock_name(
+      "librbd::cache::ReadCacheObjectDispatch::lock", this))) {
+}
+
+template <typename I>
+ReadCacheObjectDispatch<I>::~ReadCacheObjectDispatch() {
+  if (m_fd >= 0) {
+    VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+  }
+}
+
+template <typename I>
+int ReadCacheObjectDispatch<I>::init() {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 5) << "path=" << m_path << ", size=" << m_size << dendl;
+
+  uint64_t num_slots = m_size / BLOCK_SIZE;
+  if (num_slots < 2) {
+    lderr(cct) << "read cache size " << m_size << " is too small" << dendl;
+    return -EINVAL;
+  }
+
+  // the file is unlinked right away: it only lives as long as this image
+  std::string file_path = m_path + "/rbd-read-cache." + m_image_ctx->id +
+                          ".XXXXXX";
+  std::vector<char> name(file_path.begin(), file_path.end());
+  name.push_back('\0');
+  m_fd = ::mkstemp(name.data());
+  if (m_fd < 0) {
+    int r = -errno;
+    lderr(cct) << "failed to create read cache file in " << m_path << ": "
+               << cpp_strerror(r) << dendl;
+    return r;
+  }
+  ::unlink(name.data());
+
+#ifdef O_DIRECT
+  // bypass the page cache when the filesystem allows it
+  int flags = ::fcntl(m_fd, F_GETFL);
+  if (flags >= 0 && ::fcntl(m_fd, F_SETFL, flags | O_DIRECT) < 0) {
+    ldout(cct, 5) << "O_DIRECT not supported: " << cpp_strerror(-errno)
+                  << dendl;
+  }
+#endif
+
+  if (::ftruncate(m_fd, num_slots * BLOCK_SIZE) < 0) {
+    int r = -errno;
+    lderr(cct) << "failed to size read cache file: " << cpp_strerror(r)
+               << dendl;
+    VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+    m_fd = -1;
+    return r;
+  }
+
+  m_slots.resize(num_slots);
+  m_blocks.reserve(num_slots);
+
+  // add ourself to the IO object dispatcher chain
+  m_image_ctx->io_object_dispatcher->register_dispatch(this);
+  return 0;
+}
+
+template <typename I>
+void ReadCacheObjectDispatch<I>::shut_down(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 5) << dendl;
+
+  // block inserts are queued on the op work queue -- wait for them
+  m_image_ctx->op_work_queue->queue(new LambdaContext(
+    [this, on_finish](int r) {
+      if (m_fd >= 0) {
+        VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+        m_fd = -1;
+      }
+      on_finish->complete(0);
+    }), 0);
+}
+
+template <typename I>
+bool ReadCacheObjectDispatch<I>::read(
+    uint64_t object_no, io::ReadExtents* extents, IOContext io_context,
+    int op_flags, int read_flags, const ZTracer::Trace &parent_trace,
+    uint64_t* version, int* object_dispatch_flags,
+    io::DispatchResult* dispatch_result, Context** on_finish,
+    Context* on_dispatched) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << object_no << " " << *extents << dendl;
+
+  if (version != nullptr || read_flags != 0) {
+    // versioned reads and reads with special semantics bypass the cache
+    return false;
+  }
+
+  uint64_t snap_id = io_context->read_snap().value_or(CEPH_NOSNAP);
+  if (snap_id == CEPH_NOSNAP && !is_lock_owner()) {
+    // HEAD can be modified by other clients
+    return false;
+  }
+
+  uint64_t length = 0;
+  for (auto& extent : *extents) {
+    length += extent.length;
+  }
+
+  if (read_from_cache(snap_id, object_no, extents)) {
+    ldout(cct, 20) << "hit" << dendl;
+    m_image_ctx->perfcounter->inc(l_librbd_read_cache_hit);
+    m_image_ctx->perfcounter->inc(l_librbd_read_cache_hit_bytes, length);
+
+    *dispatch_result = io::DISPATCH_RESULT_COMPLETE;
+    on_dispatched->complete(0);
+    return true;
+  }
+
+  m_image_ctx->perfcounter->inc(l_librbd_read_cache_miss);
+  m_image_ctx->perfcounter->inc(l_librbd_read_cache_miss_bytes, length);
+
+  uint64_t start_seq;
+  {
+    std::lock_guard locker{m_lock};
+    start_seq = m_seq;
+    m_in_flight_reads.insert(start_seq);
+  }
+
+  *on_finish = new LambdaContext(
+    [this, snap_id, object_no, extents, start_seq,
+     on_finish=*on_finish](int r) {
+      handle_read(r, snap_id, object_no, extents, start_seq);
+      on_finish->complete(r);
+    });
+  return false;
+}
+
+template <typename I>
+bool ReadCacheObjectDispatch<I>::discard(
+    uint64_t object_no, uint64_t object_off, uint64_t object_len,
+    IOContext io_context, int discard_flags,
+    const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+    uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+    Context** on_finish, Context* on_dispatched) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << data_object_name(m_image_ctx, object_no) << " "
+                 << object_off << "~" << object_len << dendl;
+
+  start_write(object_no, object_off, object_len, on_finish);
+  return false;
+}
+
+template <typename I>
+bool ReadCacheObjectDispatch<I>::write(
+    uint64_t object_no, uint64_t object_off, ceph::bufferlist&& data,
+    IOContext io_context, int op_flags, int write_flags,
+    std::optional<uint64_t> assert_version,
+    const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+    uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+    Context** on_finish, Context* on_dispatched) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << data_object_name(m_image_ctx, object_no) << " "
+                 << object_off << "~" << data.length() << dendl;
+
+  start_write(object_no, object_off, data.length(), on_finish);
+  return false;
+}
+
+template <typename I>
+bool ReadCacheObjectDispatch<I>::write_same(
+    uint64_t object_no, uint64_t object_off, uint64_t object_len,
+    io::LightweightBufferExtents&& buffer_extents, ceph::bufferlist&& data,
+    IOContext io_context, int op_flags,
+    const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+    uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+    Context** on_finish, Context* on_dispatched) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << data_object_name(m_image_ctx, object_no) << " "
+                 << object_off << "~" << object_len << dendl;
+
+  start_write(object_no, object_off, object_len, on_finish);
+  return false;
+}
+
+template <typename I>
+bool ReadCacheObjectDispatch<I>::compare_and_write(
+    uint64_t object_no, uint64_t object_off, ceph::bufferlist&& cmp_data,
+    ceph::bufferlist&& write_data, IOContext io_context, int op_flags,
+    const ZTracer::Trace &parent_trace, uint64_t* mismatch_offset,
+    int* object_dispatch_flags, uint64_t* journal_tid,
+    io::DispatchResult* dispatch_result, Context** on_finish,
+    Context* on_dispatched) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << data_object_name(m_image_ctx, object_no) << " "
+                 << object_off << "~" << write_data.length() << dendl;
+
+  start_write(object_no, object_off, write_data.length(), on_finish);
+  return false;
+}
+
+template <typename I>
+bool ReadCacheObjectDispatch<I>::invalidate_cache(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 5) << dendl;
+
+  std::lock_guard locker{m_lock};
+  for (uint64_t slot = 0; slot < m_slots.size(); ++slot) {
+    if (m_slots[slot].state == SLOT_STATE_VALID &&
+        m_slots[slot].key.snap_id == CEPH_NOSNAP) {
+      free_slot(slot);
+    }
+  }
+
+  // reads that are still in flight must not repopulate HEAD blocks
+  m_invalidated_seq = ++m_seq;
+  return false;
+}
+
+template <typename I>
+bool ReadCacheObjectDispatch<I>::is_lock_owner() const {
+  std::shared_lock image_locker{m_image_ctx->image_lock};
+  return (m_image_ctx->exclusive_lock != nullptr &&
+          m_image_ctx->exclusive_lock->is_lock_owner());
+}
+
+template <typename I>
+bool ReadCacheObjectDispatch<I>::read_from_cache(
+    uint64_t snap_id, uint64_t object_no, io::ReadExtents* extents) {
+  auto cct = m_image_ctx->cct;
+
+  std::vector<CachedBlock> cached_blocks;
+  {
+    std::lock_guard locker{m_lock};
+    for (auto& extent : *extents) {
+      if (extent.length == 0) {
+        continue;
+      }
+
+      uint64_t first_block = extent.offset / BLOCK_SIZE;
+      uint64_t last_block = (extent.offset + extent.length - 1) / BLOCK_SIZE;
+      for (uint64_t block = first_block; block <= last_block; ++block) {
+        auto it = m_blocks.find({snap_id, object_no, block});
+        if (it == m_blocks.end()) {
+          return false;
+        }
+        cached_blocks.push_back({it->second, m_slots[it->second].gen});
+      }
+    }
+  }
+
+  if (cached_blocks.empty()) {
+    return false;
+  }
+
+  // read runs of adjacent slots with a single call
+  bufferlist data;
+  for (size_t i = 0; i < cached_blocks.size();) {
+    size_t count = 1;
+    while (i + count < cached_blocks.size() &&
+           cached_blocks[i + count].slot == cached_blocks[i].slot + count) {
+      ++count;
+    }
+
+    auto bp = buffer::create_page_aligned(count * BLOCK_SIZE);
+    int r = safe_pread_exact(m_fd, bp.c_str(), count * BLOCK_SIZE,
+                             cached_blocks[i].slot * BLOCK_SIZE);
+    if (r < 0) {
+      lderr(cct) << "failed to read cached blocks: " << cpp_strerror(r)
+                 << dendl;
+      return false;
+    }
+    data.append(std::move(bp));
+    i += count;
+  }
+
+  {
+    // slots might have been recycled while they were read
+    std::lock_guard locker{m_lock};
+    for (auto& cached_block : cached_blocks) {
+      auto& slot = m_slots[cached_block.slot];
+      if (slot.state != SLOT_STATE_VALID || slot.gen != cached_block.gen) {
+        ldout(cct, 20) << "lost race with eviction" << dendl;
+        return false;
+      }
+    }
+    for (auto& cached_block : cached_blocks) {
+      m_slots[cached_block.slot].referenced = true;
+    }
+  }
+
+  uint64_t data_off = 0;
+  for (auto& extent : *extents) {
+    if (extent.length == 0) {
+      continue;
+    }
+
+    uint64_t first_block = extent.offset / BLOCK_SIZE;
+    uint64_t last_block = (extent.offset + extent.length - 1) / BLOCK_SIZE;
+    extent.bl.clear();
+    extent.bl.substr_of(
+      data, data_off + extent.offset - first_block * BLOCK_SIZE,
+      extent.length);
+    extent.extent_map.clear();
+    data_off += (last_block - first_block + 1) * BLOCK_SIZE;
+  }
+  return true;
+}
+
+template <typename I>
+void ReadCacheObjectDispatch<I>::handle_read(
+    int r, uint64_t snap_id, uint64_t object_no, io::ReadExtents* extents,
+    uint64_t start_seq) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << object_no << ", r=" << r << dendl;
+
+  bool insert = false;
+  if (r >= 0 || r == -ENOENT) {
+    std::lock_guard locker{m_lock};
+    insert = can_insert(snap_id, object_no, start_seq);
+  }
+
+  BlockData blocks;
+  if (insert) {
+    for (auto& extent : *extents) {
+      uint64_t start = p2roundup<uint64_t>(extent.offset, BLOCK_SIZE);
+      uint64_t end = p2align<uint64_t>(extent.offset + extent.length,
+                                       BLOCK_SIZE);
+      if (start >= end) {
+        // partial blocks are not cached
+        continue;
+      }
+
+      auto data = get_dense_data(r, extent);
+      for (uint64_t off = start; off < end; off += BLOCK_SIZE) {
+        auto bp = buffer::create_page_aligned(BLOCK_SIZE);
+        data.begin(off - extent.offset).copy(BLOCK_SIZE, bp.c_str());
+        blocks.emplace_back(off / BLOCK_SIZE, std::move(bp));
+      }
+    }
+  }
+
+  if (blocks.empty()) {
+    std::lock_guard locker{m_lock};
+    finish_read(start_seq);
+    return;
+  }
+
+  m_image_ctx->op_work_queue->queue(new LambdaContext(
+    [this, snap_id, object_no, start_seq,
+     blocks=std::move(blocks)](int r) mutable {
+      insert_blocks(snap_id, object_no, start_seq, std::move(blocks));
+    }), 0);
+}
+
+template <typename I>
+void ReadCacheObjectDispatch<I>::insert_blocks(
+    uint64_t snap_id, uint64_t object_no, uint64_t start_seq,
+    BlockData&& blocks) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << object_no << ", blocks=" << blocks.size()
+                 << dendl;
+
+  for (auto& [block, bp] : blocks) {
+    BlockKey key{snap_id, object_no, block};
+    uint64_t slot;
+    uint64_t gen;
+    {
+      std::lock_guard locker{m_lock};
+      if (!can_insert(snap_id, object_no, start_seq)) {
+        break;
+      }
+      if (m_blocks.count(key) != 0) {
+        continue;
+      }
+
+      slot = alloc_slot();
+      gen = m_slots[slot].gen;
+    }
+
+    int r = safe_pwrite(m_fd, bp.c_str(), BLOCK_SIZE, slot * BLOCK_SIZE);
+
+    std::lock_guard locker{m_lock};
+    auto& s = m_slots[slot];
+    ceph_assert(s.state == SLOT_STATE_FILLING && s.gen == gen);
+    if (r < 0 || !can_insert(snap_id, object_no, start_seq) ||
+        m_blocks.count(key) != 0) {
+      if (r < 0) {
+        lderr(cct) << "failed to write cached block: " << cpp_strerror(r)
+                   << dendl;
+      }
+      s.state = SLOT_STATE_FREE;
+      continue;
+    }
+
+    s.key = key;
+    s.state = SLOT_STATE_VALID;
+    s.referenced = false;
+    m_blocks[key] = slot;
+  }
+
+  std::lock_guard locker{m_lock};
+  finish_read(start_seq);
+}
+
+template <typename I>
+void ReadCacheObjectDispatch<I>::start_write(
+    uint64_t object_no, uint64_t object_off, uint64_t object_len,
+    Context** on_finish) {
+  {
+    std::lock_guard locker{m_lock};
+    ++m_in_flight_writes[object_no];
+
+    if (object_len > 0 && !m_blocks.empty()) {
+      uint64_t first_block = object_off / BLOCK_SIZE;
+      uint64_t last_block = (object_off + object_len - 1) / BLOCK_SIZE;
+      for (uint64_t block = first_block; block <= last_block; ++block) {
+        auto it = m_blocks.find({CEPH_NOSNAP, object_no, block});
+        if (it != m_blocks.end()) {
+          free_slot(it->second);
+        }
+      }
+    }
+  }
+
+  *on_finish = new LambdaContext(
+    [this, object_no, on_finish=*on_finish](int r) {
+      finish_write(object_no);
+      on_finish->complete(r);
+    });
+}
+
+template <typename I>
+void ReadCacheObjectDispatch<I>::finish_write(uint64_t object_no) {
+  std::lock_guard locker{m_lock};
+  auto it = m_in_flight_writes.find(object_no);
+  ceph_assert(it != m_in_flight_writes.end());
+  if (--it->second == 0) {
+    m_in_flight_writes.erase(it);
+  }
+
+  // even a failed write might have modified the object
+  uint64_t seq = ++m_seq;
+  auto seq_it = m_object_write_seqs.find(object_no);
+  if (seq_it != m_object_write_seqs.end()) {
+    auto range = m_write_seq_objects.equal_range(seq_it->second);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second == object_no) {
+        m_write_seq_objects.erase(it);
+        break;
+      }
+    }
+    seq_it->second = seq;
+  } else {
+    m_object_write_seqs[object_no] = seq;
+  }
+  m_write_seq_objects.emplace(seq, object_no);
+  prune_write_seqs();
+}
+
+template <typename I>
+bool ReadCacheObjectDispatch<I>::can_insert(
+    uint64_t snap_id, uint64_t object_no, uint64_t start_seq) const {
+  ceph_assert(ceph_mutex_is_locked(m_lock));
+  if (snap_id != CEPH_NOSNAP) {
+    return true;
+  }
+
+  if (start_seq < m_invalidated_seq ||
+      m_in_flight_writes.count(object_no) != 0) {
+    return false;
+  }
+
+  auto it = m_object_write_seqs.find(object_no);
+  return (it == m_object_write_seqs.end() || it->second <= start_seq);
+}
+
+template <typename I>
+uint64_t ReadCacheObjectDispatch<I>::alloc_slot() {
+  ceph_assert(ceph_mutex_is_locked(m_lock));
+
+  while (true) {
+    uint64_t slot = m_clock_hand;
+    m_clock_hand = (m_clock_hand + 1) % m_slots.size();
+
+    auto& s = m_slots[slot];
+    if (s.state == SLOT_STATE_FILLING) {
+      continue;
+    } else if (s.state == SLOT_STATE_VALID) {
+      if (s.referenced) {
+        s.referenced = false;
+        continue;
+      }
+      free_slot(slot);
+      m_image_ctx->perfcounter->inc(l_librbd_read_cache_evict);
+    }
+
+    s.state = SLOT_STATE_FILLING;
+    ++s.gen;
+    return slot;
+  }
+}
+
+template <typename I>
+void ReadCacheObjectDispatch<I>::free_slot(uint64_t slot) {
+  ceph_assert(ceph_mutex_is_locked(m_lock));
+
+  auto& s = m_slots[slot];
+  ceph_assert(s.state == SLOT_STATE_VALID);
+  m_blocks.erase(s.key);
+  s.state = SLOT_STATE_FREE;
+  s.referenced = false;
+  ++s.gen;
+}
+
+template <typename I>
+void ReadCacheObjectDispatch<I>::finish_read(uint64_t start_seq) {
+  ceph_assert(ceph_mutex_is_locked(m_lock));
+
+  auto it = m_in_flight_reads.find(start_seq);
+  ceph_assert(it != m_in_flight_reads.end());
+  m_in_flight_reads.erase(it);
+  prune_write_seqs();
+}
+
+template <typename I>
+void ReadCacheObjectDispatch<I>::prune_write_seqs() {
+  ceph_assert(ceph_mutex_is_locked(m_lock));
+
+  // write completions no newer than the oldest in-flight read are irrelevant
+  uint64_t min_seq = (m_in_flight_reads.empty() ?
+                        m_seq : *m_in_flight_reads.begin());
+  while (!m_write_seq_objects.empty() &&
+         m_write_seq_objects.begin()->first <= min_seq) {
+    auto it = m_write_seq_objects.begin();
+    m_object_write_seqs.erase(it->second);
+    m_write_seq_objects.erase(it);
+  }
+}
+
+} // namespace cache
+} // namespace librbd
+
+template class librbd::cache::ReadCacheObjectDispatch<librbd::ImageCtx>;
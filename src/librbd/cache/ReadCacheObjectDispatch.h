@@ -0,0 +1,220 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_CACHE_READ_CACHE_OBJECT_DISPATCH_H
+#define CEPH_LIBRBD_CACHE_READ_CACHE_OBJECT_DISPATCH_H
+
+#include "librbd/io/ObjectDispatchInterface.h"
+#include "common/ceph_mutex.h"
+#include "include/buffer.h"
+#include "librbd/io/Types.h"
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Context;
+
+namespace librbd {
+
+struct ImageCtx;
+
+namespace cache {
+
+/*
+ * Caches object data read from the cluster in a file on local storage
+ * (usually an SSD), in fixed-size blocks evicted with the clock algorithm.
+ *
+ * The layer sits below crypto so only ciphertext is stored. HEAD data is
+ * only cached while the image owns the exclusive lock: writes issued
+ * through this image invalidate the affected blocks and blocks read while
+ * a write to the same object was in flight are never inserted. Releasing
+ * the lock invalidates all HEAD blocks. Snapshot data is immutable and is
+ * cached regardless of the lock. The cache is not persisted across opens.
+ */
+template <typename ImageCtxT = ImageCtx>
+class ReadCacheObjectDispatch : public io::ObjectDispatchInterface {
+public:
+  static ReadCacheObjectDispatch* create(ImageCtxT* image_ctx,
+                                         const std::string& path,
+                                         uint64_t size) {
+    return new ReadCacheObjectDispatch(image_ctx, path, size);
+  }
+
+  ReadCacheObjectDispatch(ImageCtxT* image_ctx, const std::string& path,
+                          uint64_t size);
+  ~ReadCacheObjectDispatch() override;
+
+  io::ObjectDispatchLayer get_dispatch_layer() const override {
+    return io::OBJECT_DISPATCH_LAYER_READ_CACHE;
+  }
+
+  int init();
+  void shut_down(Context* on_finish) override;
+
+  bool read(
+      uint64_t object_no, io::ReadExtents* extents, IOContext io_context,
+      int op_flags, int read_flags, const ZTracer::Trace &parent_trace,
+      uint64_t* version, int* object_dispatch_flags,
+      io::DispatchResult* dispatch_result, Context** on_finish,
+      Context* on_dispatched) override;
+
+  bool discard(
+      uint64_t object_no, uint64_t object_off, uint64_t object_len,
+      IOContext io_context, int discard_flags,
+      const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+      uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+      Context**on_finish, Context* on_dispatched) override;
+
+  bool write(
+      uint64_t object_no, uint64_t object_off, ceph::bufferlist&& data,
+      IOContext io_context, int op_flags, int write_flags,
+      std::optional<uint64_t> assert_version,
+      const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+      uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+      Context**on_finish, Context* on_dispatched) override;
+
+  bool write_same(
+      uint64_t object_no, uint64_t object_off, uint64_t object_len,
+      io::LightweightBufferExtents&& buffer_extents, ceph::bufferlist&& data,
+      IOContext io_context, int op_flags,
+      const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+      uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+      Context**on_finish, Context* on_dispatched) override;
+
+  bool compare_and_write(
+      uint64_t object_no, uint64_t object_off, ceph::bufferlist&& cmp_data,
+      ceph::bufferlist&& write_data, IOContext io_context, int op_flags,
+      const ZTracer::Trace &parent_trace, uint64_t* mismatch_offset,
+      int* object_dispatch_flags, uint64_t* journal_tid,
+      io::DispatchResult* dispatch_result, Context** on_finish,
+      Context* on_dispatched) override;
+
+  bool flush(
+      io::FlushSource flush_source, const ZTracer::Trace &parent_trace,
+      uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+      Context** on_finish, Context* on_dispatched) override {
+    return false;
+  }
+
+  bool list_snaps(
+      uint64_t object_no, io::Extents&& extents, io::SnapIds&& snap_ids,
+      int list_snap_flags, const ZTracer::Trace &parent_trace,
+      io::SnapshotDelta* snapshot_delta, int* object_dispatch_flags,
+      io::DispatchResult* dispatch_result, Context** on_finish,
+      Context* on_dispatched) override {
+    return false;
+  }
+
+  bool invalidate_cache(Context* on_finish) override;
+
+  bool reset_existence_cache(Context* on_finish) override {
+    return false;
+  }
+
+  void extent_overwritten(
+      uint64_t object_no, uint64_t object_off, uint64_t object_len,
+      uint64_t journal_tid, uint64_t new_journal_tid) override {
+  }
+
+  void prepare_copyup(
+      uint64_t object_no,
+      io::SnapshotSparseBufferlist* snapshot_sparse_bufferlist) override {
+  }
+
+  static const uint64_t BLOCK_SIZE = 4096;
+
+private:
+  struct BlockKey {
+    uint64_t snap_id;
+    uint64_t object_no;
+    uint64_t block;
+
+    bool operator==(const BlockKey& rhs) const {
+      return (snap_id == rhs.snap_id && object_no == rhs.object_no &&
+              block == rhs.block);
+    }
+  };
+
+  struct BlockKeyHash {
+    size_t operator()(const BlockKey& key) const {
+      size_t h = std::hash<uint64_t>()(key.object_no);
+      h ^= std::hash<uint64_t>()(key.block) + 0x9e3779b97f4a7c15ULL +
+           (h << 6) + (h >> 2);
+      h ^= std::hash<uint64_t>()(key.snap_id) + 0x9e3779b97f4a7c15ULL +
+           (h << 6) + (h >> 2);
+      return h;
+    }
+  };
+
+  enum SlotState {
+    SLOT_STATE_FREE,
+    SLOT_STATE_FILLING,
+    SLOT_STATE_VALID
+  };
+
+  struct Slot {
+    BlockKey key = {0, 0, 0};
+    uint64_t gen = 0;
+    SlotState state = SLOT_STATE_FREE;
+    bool referenced = false;
+  };
+
+  struct CachedBlock {
+    uint64_t slot;
+    uint64_t gen;
+  };
+
+  typedef std::unordered_map<BlockKey, uint64_t, BlockKeyHash> Blocks;
+  typedef std::vector<std::pair<uint64_t, ceph::bufferptr>> BlockData;
+
+  ImageCtxT* m_image_ctx;
+  std::string m_path;
+  uint64_t m_size;
+  int m_fd = -1;
+
+  ceph::mutex m_lock;
+  Blocks m_blocks;
+  std::vector<Slot> m_slots;
+  uint64_t m_clock_hand = 0;
+
+  /*
+   * Sequence numbers order reads against write completions: a read that
+   * started before the last completed write to an object (or before an
+   * invalidation) must not insert HEAD blocks of that object.
+   */
+  uint64_t m_seq = 0;
+  uint64_t m_invalidated_seq = 0;
+  std::multiset<uint64_t> m_in_flight_reads;
+  std::map<uint64_t, uint32_t> m_in_flight_writes;
+  std::map<uint64_t, uint64_t> m_object_write_seqs;
+  std::multimap<uint64_t, uint64_t> m_write_seq_objects;
+
+  bool is_lock_owner() const;
+
+  bool read_from_cache(uint64_t snap_id, uint64_t object_no,
+                       io::ReadExtents* extents);
+  void handle_read(int r, uint64_t snap_id, uint64_t object_no,
+                   io::ReadExtents* extents, uint64_t start_seq);
+  void insert_blocks(uint64_t snap_id, uint64_t object_no, uint64_t start_seq,
+                     BlockData&& blocks);
+
+  void start_write(uint64_t object_no, uint64_t object_off,
+                   uint64_t object_len, Context** on_finish);
+  void finish_write(uint64_t object_no);
+
+  bool can_insert(uint64_t snap_id, uint64_t object_no,
+                  uint64_t start_seq) const;
+  uint64_t alloc_slot();
+  void free_slot(uint64_t slot);
+  void finish_read(uint64_t start_seq);
+  void prune_write_seqs();
+};
+
+} // namespace cache
+} // namespace librbd
+
+extern template class librbd::cache::ReadCacheObjectDispatch<librbd::ImageCtx>;
+
+#endif // CEPH_LIBRBD_CACHE_READ_CACHE_OBJECT_DISPATCH_H
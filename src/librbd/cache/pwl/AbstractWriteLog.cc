@@ -333,7 +333,7 @@ void AbstractWriteLog<I>::arm_periodic_stats() {
 }
 
 template <typename I>
-void AbstractWriteLog<I>::update_entries(std::shared_ptr<GenericLogEntry> log_entry,
+void AbstractWriteLog<I>::update_entries(std::shared_ptr<GenericLogEntry> &log_entry,
     WriteLogPmemEntry *pmem_entry, std::map<uint64_t, bool> &missing_sync_points,
     std::map<uint64_t, std::shared_ptr<SyncPointLogEntry>> &sync_point_entries,
     int entry_index) {
@@ -520,9 +520,12 @@ void AbstractWriteLog<I>::pwl_init(Context *on_finish, DeferredContexts &later)
              (access(m_log_pool_name.c_str(), F_OK) != 0)) {
     ldout(cct, 5) << "Can't find the existed pool file " << m_log_pool_name << dendl;
     on_finish->complete(-errno);
+    return;
   }
 
-  initialize_pool(on_finish, later);
+  if (!initialize_pool(on_finish, later)) {
+    return;
+  }
 
   ldout(cct,1) << "pool " << m_log_pool_name << " has " << m_total_log_entries
                << " log entries, " << m_free_log_entries << " of which are free."
@@ -743,7 +746,7 @@ void AbstractWriteLog<I>::read(Extents&& image_extents,
         buffer::list hit_bl;
 
         buffer::list entry_bl_copy;
-        write_entry->copy_pmem_bl(&entry_bl_copy);
+        read_data_from_buffer(write_entry, &entry_bl_copy);
         entry_bl_copy.begin(read_buffer_offset).copy(entry_hit_length, hit_bl);
 
         ceph_assert(hit_bl.length() == entry_hit_length);
@@ -782,6 +785,16 @@ void AbstractWriteLog<I>::read(Extents&& image_extents,
   }
 }
 
+/*
+ * Copies the payload of a write log entry for a read hit. The caller
+ * holds m_entry_reader_lock, so the entry can't be retired meanwhile.
+ */
+template <typename I>
+void AbstractWriteLog<I>::read_data_from_buffer(
+    std::shared_ptr<GenericWriteLogEntry> log_entry, bufferlist *out_bl) {
+  log_entry->copy_pmem_bl(out_bl);
+}
+
 template <typename I>
 void AbstractWriteLog<I>::write(Extents &&image_extents,
                                       bufferlist&& bl,
@@ -1186,7 +1199,7 @@ void AbstractWriteLog<I>::append_scheduled(GenericLogOperations &ops, bool &ops_
       ops_remain = true; /* Always check again before leaving */
       ldout(m_image_ctx.cct, 20) << "appending " << ops.size() << ", "
                                  << m_ops_to_append.size() << " remain" << dendl;
-    } else if (isRWL) {
+    } else {
       ops_remain = false;
       if (appending) {
         appending = false;
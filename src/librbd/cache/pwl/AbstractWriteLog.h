@@ -307,7 +307,7 @@ protected:
   void wake_up();
 
   void update_entries(
-      std::shared_ptr<pwl::GenericLogEntry> log_entry,
+      std::shared_ptr<pwl::GenericLogEntry> &log_entry,
       pwl::WriteLogPmemEntry *pmem_entry, std::map<uint64_t, bool> &missing_sync_points,
       std::map<uint64_t, std::shared_ptr<pwl::SyncPointLogEntry>> &sync_point_entries,
       int entry_index);
@@ -336,9 +336,11 @@ protected:
   virtual void append_scheduled_ops(void) = 0;
   virtual void schedule_append_ops(pwl::GenericLogOperations &ops) = 0;
   virtual void remove_pool_file() = 0;
-  virtual void initialize_pool(Context *on_finish, pwl::DeferredContexts &later) = 0;
+  virtual bool initialize_pool(Context *on_finish, pwl::DeferredContexts &later) = 0;
   virtual void write_data_to_buffer(
       std::shared_ptr<pwl::WriteLogEntry> ws_entry, pwl::WriteLogPmemEntry *pmem_entry) {}
+  virtual void read_data_from_buffer(
+      std::shared_ptr<pwl::GenericWriteLogEntry> log_entry, bufferlist *out_bl);
   virtual void alloc_op_log_entries(pwl::GenericLogOperations &ops) {}
   virtual bool retire_entries(const unsigned long int frees_per_tx) {return false;}
   virtual void schedule_flush_and_append(pwl::GenericLogOperationsVector &ops) {}
@@ -39,6 +39,9 @@ ImageCacheState<I>::ImageCacheState(I *image_ctx) : m_image_ctx(image_ctx) {
 
   ConfigProxy &config = image_ctx->config;
   log_periodic_stats = config.get_val<bool>("rbd_rwl_log_periodic_stats");
+  if (config.get_val<std::string>("rbd_rwl_mode") == "ssd") {
+    cache_type = IMAGE_CACHE_TYPE_SSD;
+  }
 }
 
 template <typename I>
@@ -56,6 +59,7 @@ ImageCacheState<I>::ImageCacheState(
   std::istringstream iss(f["pwl_size"]);
   iss >> pwl_size;
   size = pwl_size;
+  cache_type = (ImageCacheType)(int)f["cache_type"];
 
   // Others from config
   ConfigProxy &config = image_ctx->config;
@@ -140,6 +144,7 @@ ImageCacheState<I>* ImageCacheState<I>::get_image_cache_state(
 
     switch (cache_type) {
       case IMAGE_CACHE_TYPE_RWL:
+      case IMAGE_CACHE_TYPE_SSD:
         if (!cache_exists) {
           cache_state = new ImageCacheState<I>(image_ctx);
         } else {
@@ -29,6 +29,7 @@ public:
   std::string path;
   uint64_t size = 0;
   bool log_periodic_stats;
+  ImageCacheType cache_type = IMAGE_CACHE_TYPE_RWL;
 
   ImageCacheState(ImageCtxT* image_ctx);
 
@@ -37,7 +38,7 @@ public:
   ~ImageCacheState() {}
 
   ImageCacheType get_image_cache_type() const {
-    return IMAGE_CACHE_TYPE_RWL;
+    return cache_type;
   }
 
 
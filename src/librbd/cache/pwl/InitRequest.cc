@@ -11,6 +11,7 @@
 #if defined(WITH_RBD_RWL)
 #include "librbd/cache/pwl/ImageCacheState.h"
 #include "librbd/cache/pwl/ReplicatedWriteLog.h"
+#include "librbd/cache/pwl/SSDWriteLog.h"
 #include "librbd/cache/WriteLogImageDispatch.h"
 #endif // WITH_RBD_RWL
 
@@ -81,6 +82,11 @@ void InitRequest<I>::get_image_cache_state() {
         new librbd::cache::pwl::ReplicatedWriteLog<I>(m_image_ctx,
                                                       cache_state);
       break;
+    case cache::IMAGE_CACHE_TYPE_SSD:
+      m_image_cache =
+        new librbd::cache::pwl::SSDWriteLog<I>(m_image_ctx,
+                                               cache_state);
+      break;
     default:
       delete cache_state;
       cache_state = nullptr;
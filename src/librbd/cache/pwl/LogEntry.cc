@@ -76,9 +76,15 @@ std::ostream &operator<<(std::ostream &os,
 void WriteLogEntry::init(bool has_data, std::vector<WriteBufferAllocation>::iterator allocation,
                          uint64_t current_sync_gen, uint64_t last_op_sequence_num, bool persist_on_flush) {
   ram_entry.has_data = 1;
-  ram_entry.write_data = allocation->buffer_oid;
-  ceph_assert(!TOID_IS_NULL(ram_entry.write_data));
-  pmem_buffer = D_RW(ram_entry.write_data);
+  if (allocation->buffer_bp.have_raw()) {
+    /* SSD: the payload is staged here until it's appended to the log */
+    init_cache_bp(allocation->buffer_bp);
+    ram_entry.write_data_pos = allocation->buffer_pos;
+  } else {
+    ram_entry.write_data = allocation->buffer_oid;
+    ceph_assert(!TOID_IS_NULL(ram_entry.write_data));
+    pmem_buffer = D_RW(ram_entry.write_data);
+  }
   ram_entry.sync_gen_number = current_sync_gen;
   if (persist_on_flush) {
     /* Persist on flush. Sequence #0 is never used. */
@@ -136,6 +142,22 @@ void WriteLogEntry::copy_pmem_bl(bufferlist *out_bl) {
   this->init_bl(cloned_bp, *out_bl);
 }
 
+void WriteLogEntry::init_cache_bp(buffer::ptr &bp) {
+  ceph_assert(!pmem_bp.have_raw());
+  cache_bp = bp;
+  pmem_buffer = (uint8_t*)cache_bp.c_str();
+}
+
+void WriteLogEntry::release_cache_bp() {
+  std::lock_guard locker(m_entry_bl_lock);
+  ceph_assert(0 == reader_count());
+  pmem_bl.clear();
+  pmem_bp = buffer::ptr();
+  bl_refs = 0;
+  pmem_buffer = nullptr;
+  cache_bp = buffer::ptr();
+}
+
 void WriteLogEntry::writeback(librbd::cache::ImageWritebackInterface &image_writeback,
                               Context *ctx) {
   /* Pass a copy of the pmem buffer to ImageWriteback (which may hang on to the bl even after flush()). */
@@ -139,6 +139,7 @@ class WriteLogEntry : public GenericWriteLogEntry {
 protected:
   buffer::ptr pmem_bp;
   buffer::list pmem_bl;
+  buffer::ptr cache_bp; /* SSD: in-memory copy of the payload, if any */
   std::atomic<int> bl_refs = {0}; /* The refs held on pmem_bp by pmem_bl */
   /* Used in WriteLogEntry::get_pmem_bl() to syncronize between threads making entries readable */
   mutable ceph::mutex m_entry_bl_lock;
@@ -176,6 +177,13 @@ public:
   buffer::list &get_pmem_bl();
   /* Constructs a new bl containing copies of pmem_bp */
   void copy_pmem_bl(bufferlist *out_bl) override;
+  /* Makes bp (SSD_BLOCK_SIZE aligned) the buffer holding this entry's payload */
+  void init_cache_bp(buffer::ptr &bp);
+  buffer::ptr &get_cache_bp() {
+    return cache_bp;
+  }
+  /* Drops the in-memory payload once it's readable from the SSD */
+  void release_cache_bp();
   void writeback(librbd::cache::ImageWritebackInterface &image_writeback,
                  Context *ctx) override;
   bool can_retire() const override {
@@ -0,0 +1,139 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "SSDDataRing.h"
+#include "include/ceph_assert.h"
+#include <algorithm>
+
+namespace librbd {
+namespace cache {
+namespace pwl {
+
+void SSDDataRing::init(uint64_t start, uint64_t end) {
+  ceph_assert(start < end);
+  m_start = start;
+  m_end = end;
+  m_head = start;
+  m_tail = start;
+  m_used = 0;
+  m_released.clear();
+}
+
+bool SSDDataRing::load(uint64_t tail, uint64_t head, Extents extents) {
+  if (tail < m_start || tail >= m_end || head < m_start || head >= m_end) {
+    return false;
+  }
+  /* Positions as offsets from the tail, in allocation order */
+  auto offset = [this, tail](uint64_t pos) {
+    return pos >= tail ? pos - tail : pos - m_start + m_end - tail;
+  };
+  m_head = head;
+  m_tail = tail;
+  m_used = offset(head);
+  m_released.clear();
+
+  std::sort(extents.begin(), extents.end(),
+            [&offset](const auto &a, const auto &b) {
+              return offset(a.first) < offset(b.first);
+            });
+  /* Everything between the extents is free: released reservations,
+   * payloads retired after the superblock was written, skipped space */
+  uint64_t cursor = 0;
+  for (auto &[pos, length] : extents) {
+    if (pos < m_start || pos + length > m_end ||
+        offset(pos) < cursor || offset(pos) + length > m_used) {
+      return false;
+    }
+    release_range(cursor, offset(pos));
+    cursor = offset(pos) + length;
+  }
+  release_range(cursor, m_used);
+  advance_tail();
+  return true;
+}
+
+bool SSDDataRing::alloc(uint64_t length, uint64_t *pos) {
+  ceph_assert(length > 0);
+  uint64_t skip = 0;
+  uint64_t p = m_head;
+  if (p + length > m_end) {
+    /* Skip the end of the ring */
+    skip = m_end - p;
+    p = m_start;
+  }
+  if (m_used + skip + length >= get_size()) {
+    return false;
+  }
+  if (skip) {
+    m_released[m_head] = skip;
+    m_used += skip;
+  }
+  m_used += length;
+  m_head = p + length;
+  if (m_head == m_end) {
+    m_head = m_start;
+  }
+  if (skip) {
+    /* The ring may have been empty, with the tail at the old head */
+    advance_tail();
+  }
+  *pos = p;
+  return true;
+}
+
+void SSDDataRing::release(uint64_t pos, uint64_t length) {
+  ceph_assert(pos >= m_start && pos + length <= m_end);
+  ceph_assert(length <= m_used);
+  auto r = m_released.emplace(pos, length);
+  ceph_assert(r.second);
+  advance_tail();
+}
+
+/*
+ * Marks the space between two offsets from the tail as released,
+ * splitting it where it wraps around the end of the ring.
+ */
+void SSDDataRing::release_range(uint64_t from, uint64_t to) {
+  const uint64_t to_end = m_end - m_tail;
+  if (from < to && from < to_end) {
+    uint64_t n = std::min(to, to_end) - from;
+    m_released[m_tail + from] = n;
+    from += n;
+  }
+  if (from < to) {
+    m_released[m_start + from - to_end] = to - from;
+  }
+}
+
+void SSDDataRing::advance_tail() {
+  while (m_used > 0) {
+    auto it = m_released.find(m_tail);
+    if (it == m_released.end()) {
+      break;
+    }
+    m_tail += it->second;
+    m_used -= it->second;
+    m_released.erase(it);
+    if (m_tail == m_end) {
+      m_tail = m_start;
+    }
+  }
+  if (m_used == 0) {
+    ceph_assert(m_tail == m_head);
+    ceph_assert(m_released.empty());
+  }
+}
+
+std::ostream &operator<<(std::ostream &os, const SSDDataRing &ring) {
+  os << "start=" << ring.m_start << ", "
+     << "end=" << ring.m_end << ", "
+     << "head=" << ring.m_head << ", "
+     << "tail=" << ring.m_tail << ", "
+     << "used=" << ring.m_used << ", "
+     << "released=" << ring.m_released.size();
+  return os;
+}
+
+} // namespace pwl
+} // namespace cache
+} // namespace librbd
@@ -0,0 +1,77 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_CACHE_PWL_SSD_DATA_RING_H
+#define CEPH_LIBRBD_CACHE_PWL_SSD_DATA_RING_H
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace librbd {
+namespace cache {
+namespace pwl {
+
+/**
+ * SSDDataRing: allocator for the ring of data buffers of an SSDWriteLog
+ *
+ * Space is handed out at the head, and can be released in any order.
+ * The tail only moves past released space. An allocation that doesn't
+ * fit before the end of the ring skips the rest of it; the skipped
+ * space stays in use until the tail moves past it. The ring is never
+ * filled completely, so head == tail means it's empty.
+ *
+ * Not thread safe.
+ */
+class SSDDataRing {
+public:
+  typedef std::vector<std::pair<uint64_t, uint64_t>> Extents;
+
+  void init(uint64_t start, uint64_t end);
+
+  /* Rebuilds the ring of an existing log from its persisted head and
+   * tail, and the extents the loaded log entries still use. Returns
+   * false if an extent isn't between tail and head. */
+  bool load(uint64_t tail, uint64_t head, Extents extents);
+
+  /* Allocates length bytes at the head. Returns false if they don't
+   * fit, counting the space skipped at the end of the ring. */
+  bool alloc(uint64_t length, uint64_t *pos);
+  void release(uint64_t pos, uint64_t length);
+
+  uint64_t get_head() const {
+    return m_head;
+  }
+  uint64_t get_tail() const {
+    return m_tail;
+  }
+  /* Bytes between tail and head, including released and skipped space
+   * the tail hasn't moved past yet */
+  uint64_t get_used() const {
+    return m_used;
+  }
+  uint64_t get_size() const {
+    return m_end - m_start;
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, const SSDDataRing &ring);
+
+private:
+  uint64_t m_start = 0;
+  uint64_t m_end = 0;
+  uint64_t m_head = 0;
+  uint64_t m_tail = 0;
+  uint64_t m_used = 0;
+  std::map<uint64_t, uint64_t> m_released; /* Ahead of the tail */
+
+  void advance_tail();
+  void release_range(uint64_t from, uint64_t to);
+};
+
+} // namespace pwl
+} // namespace cache
+} // namespace librbd
+
+#endif // CEPH_LIBRBD_CACHE_PWL_SSD_DATA_RING_H
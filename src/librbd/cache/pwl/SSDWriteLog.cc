@@ -0,0 +1,1076 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <fcntl.h>
+#include <unistd.h>
+#include "SSDWriteLog.h"
+#include "include/buffer.h"
+#include "include/Context.h"
+#include "include/ceph_assert.h"
+#include "include/crc32c.h"
+#include "include/intarith.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include "common/safe_io.h"
+#include "common/WorkQueue.h"
+#include "common/Timer.h"
+#include "common/perf_counters.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/Utils.h"
+#include "librbd/asio/ContextWQ.h"
+#include "librbd/cache/pwl/ImageCacheState.h"
+#include "librbd/cache/pwl/LogEntry.h"
+#include "librbd/cache/pwl/Types.h"
+#include <map>
+#include <vector>
+
+#undef dout_subsys
+#define dout_subsys ceph_subsys_rbd_pwl
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::cache::pwl::SSDWriteLog: " << this << " " \
+                             <<  __func__ << ": "
+
+namespace librbd {
+namespace cache {
+namespace pwl {
+
+using namespace librbd::cache::pwl;
+
+namespace {
+
+/* Space a payload of write_bytes takes in the data ring */
+uint64_t data_alloc_size(uint64_t write_bytes) {
+  return p2roundup<uint64_t>(std::max<uint64_t>(write_bytes, MIN_WRITE_ALLOC_SIZE),
+                             SSD_BLOCK_SIZE);
+}
+
+uint32_t log_entry_crc(const WriteLogPmemEntry *pmem_entry) {
+  return ceph_crc32c(0, (const unsigned char *)pmem_entry,
+                     offsetof(struct WriteLogPmemEntry, entry_crc));
+}
+
+} // anonymous namespace
+
+template <typename I>
+SSDWriteLog<I>::SSDWriteLog(
+    I &image_ctx, librbd::cache::pwl::ImageCacheState<I>* cache_state)
+: AbstractWriteLog<I>(image_ctx, cache_state),
+  m_superblock_lock(ceph::make_mutex(util::unique_lock_name(
+    "librbd::cache::pwl::SSDWriteLog::m_superblock_lock", this)))
+{
+}
+
+template <typename I>
+SSDWriteLog<I>::~SSDWriteLog() {
+  if (m_fd >= 0) {
+    VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+    m_fd = -1;
+  }
+}
+
+template <typename I>
+int SSDWriteLog<I>::open_pool_file(bool create) {
+  CephContext *cct = m_image_ctx.cct;
+  int flags = O_RDWR | O_CLOEXEC;
+  if (create) {
+    flags |= O_CREAT | O_EXCL;
+  }
+  m_fd = ::open(this->m_log_pool_name.c_str(), flags | O_DIRECT, S_IWUSR | S_IRUSR);
+  if (m_fd < 0 && errno == EINVAL) {
+    ldout(cct, 5) << "O_DIRECT isn't supported for " << this->m_log_pool_name
+                  << ", falling back to buffered io" << dendl;
+    m_fd = ::open(this->m_log_pool_name.c_str(), flags, S_IWUSR | S_IRUSR);
+  }
+  if (m_fd < 0) {
+    return -errno;
+  }
+  if (create) {
+    /* Allocate the whole file up front, so appends don't have to */
+    int r = ::posix_fallocate(m_fd, 0, this->m_log_pool_config_size);
+    if (r != 0) {
+      ldout(cct, 5) << "posix_fallocate failed: " << cpp_strerror(r)
+                    << ", falling back to ftruncate" << dendl;
+      if (::ftruncate(m_fd, this->m_log_pool_config_size) < 0) {
+        return -errno;
+      }
+    }
+  }
+  return 0;
+}
+
+/*
+ * Sets up the in-memory log entry ring and the data ring bounds for a
+ * pool of pool_size bytes holding num_log_entries log entries.
+ */
+template <typename I>
+void SSDWriteLog<I>::init_layout(uint32_t num_log_entries, uint64_t pool_size) {
+  uint64_t log_entries_size = p2roundup<uint64_t>(
+    num_log_entries * sizeof(struct WriteLogPmemEntry), SSD_BLOCK_SIZE);
+  m_log_entries_bp = buffer::create_page_aligned(log_entries_size);
+  m_log_entries_bp.zero();
+  m_data_start = SSD_BLOCK_SIZE + log_entries_size;
+  m_data_ring.init(m_data_start, p2align<uint64_t>(pool_size, SSD_BLOCK_SIZE));
+  this->m_total_log_entries = num_log_entries;
+  this->m_bytes_allocated_cap = (uint64_t)(m_data_ring.get_size() * USABLE_SIZE);
+}
+
+template <typename I>
+int SSDWriteLog<I>::write_superblock() {
+  m_superblock.crc = ceph_crc32c(0, (unsigned char *)&m_superblock,
+                                 offsetof(struct WriteLogSSDSuperblock, crc));
+  bufferptr bp = buffer::create_page_aligned(SSD_BLOCK_SIZE);
+  bp.zero();
+  memcpy(bp.c_str(), &m_superblock, sizeof(m_superblock));
+  int r = safe_pwrite(m_fd, bp.c_str(), bp.length(), 0);
+  if (r < 0) {
+    return r;
+  }
+  if (::fdatasync(m_fd) < 0) {
+    return -errno;
+  }
+  return 0;
+}
+
+/*
+ * Applies update to the superblock, and persists it along with the
+ * current bounds of the data ring.
+ */
+template <typename I>
+int SSDWriteLog<I>::update_superblock(
+    std::function<void(WriteLogSSDSuperblock&)> update) {
+  std::lock_guard superblock_locker(m_superblock_lock);
+  update(m_superblock);
+  {
+    std::lock_guard locker(m_lock);
+    m_superblock.first_valid_data = m_data_ring.get_tail();
+    m_superblock.first_free_data = m_data_ring.get_head();
+  }
+  return write_superblock();
+}
+
+template <typename I>
+int SSDWriteLog<I>::read_superblock() {
+  CephContext *cct = m_image_ctx.cct;
+  bufferptr bp = buffer::create_page_aligned(SSD_BLOCK_SIZE);
+  int r = safe_pread_exact(m_fd, bp.c_str(), bp.length(), 0);
+  if (r < 0) {
+    return r;
+  }
+  memcpy(&m_superblock, bp.c_str(), sizeof(m_superblock));
+  if (m_superblock.magic != SSD_SUPERBLOCK_MAGIC) {
+    lderr(cct) << "Pool has no SSD cache superblock" << dendl;
+    return -EINVAL;
+  }
+  uint32_t crc = ceph_crc32c(0, (unsigned char *)&m_superblock,
+                             offsetof(struct WriteLogSSDSuperblock, crc));
+  if (crc != m_superblock.crc) {
+    lderr(cct) << "Pool superblock crc mismatch (have " << m_superblock.crc
+               << " expected " << crc << ")" << dendl;
+    return -EIO;
+  }
+  if (m_superblock.layout_version != SSD_LAYOUT_VERSION) {
+    // TODO: will handle upgrading version in the future
+    lderr(cct) << "Pool layout version is " << m_superblock.layout_version
+               << " expected " << (int)SSD_LAYOUT_VERSION << dendl;
+    return -EINVAL;
+  }
+  if (m_superblock.block_size != SSD_BLOCK_SIZE) {
+    lderr(cct) << "Pool block size is " << m_superblock.block_size
+               << " expected " << SSD_BLOCK_SIZE << dendl;
+    return -EINVAL;
+  }
+  uint32_t num_log_entries = m_superblock.num_log_entries;
+  if (num_log_entries % SSD_LOG_ENTRIES_PER_BLOCK != 0 ||
+      num_log_entries < 2 * SSD_LOG_ENTRIES_PER_BLOCK ||
+      num_log_entries > MAX_LOG_ENTRIES ||
+      m_superblock.first_free_entry >= num_log_entries ||
+      m_superblock.first_free_entry % SSD_LOG_ENTRIES_PER_BLOCK != 0 ||
+      m_superblock.first_valid_entry >= num_log_entries) {
+    lderr(cct) << "Pool has invalid log entry ring (entries=" << num_log_entries
+               << ", first_free=" << m_superblock.first_free_entry
+               << ", first_valid=" << m_superblock.first_valid_entry << ")"
+               << dendl;
+    return -EINVAL;
+  }
+  if (m_superblock.pool_size <
+      SSD_BLOCK_SIZE * 2 + num_log_entries * sizeof(struct WriteLogPmemEntry)) {
+    lderr(cct) << "Pool size " << m_superblock.pool_size
+               << " is too small for " << num_log_entries << " log entries"
+               << dendl;
+    return -EINVAL;
+  }
+  return 0;
+}
+
+/*
+ * Reads length bytes of payload from pos in the data ring, and appends
+ * them to bl.
+ */
+template <typename I>
+int SSDWriteLog<I>::read_data(uint64_t pos, uint64_t length, bufferlist *bl) {
+  bufferptr bp = buffer::create_page_aligned(data_alloc_size(length));
+  int r = safe_pread_exact(m_fd, bp.c_str(), bp.length(), pos);
+  if (r < 0) {
+    return r;
+  }
+  bp.set_length(length);
+  bl->append(std::move(bp));
+  return 0;
+}
+
+/*
+ * Writes the blocks of the log entry ring holding count entries,
+ * starting at first_index.
+ */
+template <typename I>
+int SSDWriteLog<I>::write_log_entries(uint32_t first_index, uint32_t count) {
+  while (count > 0) {
+    /* Split where the entries wrap around the end of the ring */
+    uint32_t n = std::min<uint32_t>(count, this->m_total_log_entries - first_index);
+    uint64_t start = p2align<uint64_t>(
+      first_index * sizeof(struct WriteLogPmemEntry), SSD_BLOCK_SIZE);
+    uint64_t end = p2roundup<uint64_t>(
+      (first_index + n) * sizeof(struct WriteLogPmemEntry), SSD_BLOCK_SIZE);
+    ldout(m_image_ctx.cct, 20) << "entry count=" << n << " "
+                               << "first index=" << first_index << " "
+                               << "bytes=" << end - start << dendl;
+    int r = safe_pwrite(m_fd, m_log_entries_bp.c_str() + start, end - start,
+                        SSD_BLOCK_SIZE + start);
+    if (r < 0) {
+      return r;
+    }
+    first_index = (first_index + n) % this->m_total_log_entries;
+    count -= n;
+  }
+  return 0;
+}
+
+/*
+ * Allocate the (already reserved) write log entries for a set of
+ * operations, and pad them to the end of their last block. Their data
+ * buffers were placed in the data ring when they were reserved.
+ *
+ * Locking:
+ * Acquires lock
+ */
+template <typename I>
+void SSDWriteLog<I>::alloc_op_log_entries(GenericLogOperations &ops)
+{
+  struct WriteLogPmemEntry *log_entries =
+    reinterpret_cast<struct WriteLogPmemEntry*>(m_log_entries_bp.c_str());
+
+  ceph_assert(ceph_mutex_is_locked_by_me(this->m_log_append_lock));
+
+  /* Allocate the (already reserved) log entries */
+  std::lock_guard locker(m_lock);
+
+  ceph_assert(this->m_first_free_entry % SSD_LOG_ENTRIES_PER_BLOCK == 0);
+  for (auto &operation : ops) {
+    uint32_t entry_index = this->m_first_free_entry;
+    this->m_first_free_entry = (this->m_first_free_entry + 1) % this->m_total_log_entries;
+    auto &log_entry = operation->get_log_entry();
+    log_entry->log_entry_index = entry_index;
+    log_entry->ram_entry.entry_index = entry_index;
+    log_entry->pmem_entry = &log_entries[entry_index];
+    log_entry->ram_entry.entry_valid = 1;
+    m_log_entries.push_back(log_entry);
+    ldout(m_image_ctx.cct, 20) << "operation=[" << *operation << "]" << dendl;
+  }
+
+  /* Each op reserved a block of log entries (see alloc_resources()).
+   * Pad with invalid entries, and give back what the padding didn't use. */
+  uint32_t padding = p2nphase<uint32_t>(this->m_first_free_entry,
+                                        SSD_LOG_ENTRIES_PER_BLOCK);
+  memset(m_log_entries_bp.c_str() +
+         this->m_first_free_entry * sizeof(struct WriteLogPmemEntry), 0,
+         padding * sizeof(struct WriteLogPmemEntry));
+  this->m_first_free_entry = (this->m_first_free_entry + padding) % this->m_total_log_entries;
+  this->m_free_log_entries += ops.size() * (SSD_LOG_ENTRIES_PER_BLOCK - 1) - padding;
+  this->wake_up();
+}
+
+/*
+ * Write and persist the (already allocated) data buffers and write log
+ * entries for a set of ops, then publish them in the superblock.
+ *
+ * Only called by the appending thread (see append_scheduled()), so this
+ * needs no lock until the superblock update.
+ */
+template <typename I>
+int SSDWriteLog<I>::append_op_log_entries(GenericLogOperations &ops)
+{
+  CephContext *cct = m_image_ctx.cct;
+  int r = 0;
+
+  if (ops.empty()) {
+    return 0;
+  }
+
+  const uint32_t first_index = ops.front()->get_log_entry()->log_entry_index;
+  const uint32_t num_entries = p2roundup<uint32_t>(ops.size(), SSD_LOG_ENTRIES_PER_BLOCK);
+
+  /* Write data buffers, one write for each run adjacent in the ring */
+  utime_t now = ceph_clock_now();
+  bufferlist data_bl;
+  uint64_t data_pos = 0;
+  for (auto &operation : ops) {
+    if (!operation->reserved_allocated()) {
+      continue;
+    }
+    auto log_entry = static_pointer_cast<WriteLogEntry>(operation->get_log_entry());
+    uint64_t pos = log_entry->ram_entry.write_data_pos;
+    if (data_bl.length() && (data_pos + data_bl.length() != pos)) {
+      r = data_bl.write_fd(m_fd, data_pos);
+      if (r < 0) {
+        break;
+      }
+      data_bl.clear();
+    }
+    if (!data_bl.length()) {
+      data_pos = pos;
+    }
+    data_bl.append(log_entry->get_cache_bp());
+    operation->buf_persist_time = now;
+  }
+  if (r == 0 && data_bl.length()) {
+    r = data_bl.write_fd(m_fd, data_pos);
+  }
+
+  /* Write log entries to ring */
+  if (r == 0) {
+    now = ceph_clock_now();
+    for (auto &operation : ops) {
+      auto log_entry = operation->get_log_entry();
+      ldout(cct, 05) << "APPENDING: index=" << log_entry->log_entry_index << " "
+                     << "operation=[" << *operation << "]" << dendl;
+      operation->log_append_time = now;
+      *log_entry->pmem_entry = log_entry->ram_entry;
+      log_entry->pmem_entry->entry_crc = log_entry_crc(log_entry->pmem_entry);
+    }
+    /* Along with the padding that ends the batch */
+    r = write_log_entries(first_index, num_entries);
+  }
+
+  /* Sync once for all, before the superblock makes them valid */
+  if (r == 0 && ::fdatasync(m_fd) < 0) {
+    r = -errno;
+  }
+  utime_t tx_start = ceph_clock_now();
+  for (auto &operation : ops) {
+    if (operation->reserved_allocated()) {
+      operation->buf_persist_comp_time = tx_start;
+    }
+  }
+
+  /* Advance the log head pointer */
+  if (r == 0) {
+    uint32_t first_free_entry = (first_index + num_entries) % this->m_total_log_entries;
+    r = update_superblock([first_free_entry](WriteLogSSDSuperblock &superblock) {
+        superblock.first_free_entry = first_free_entry;
+      });
+  }
+  if (r < 0) {
+    lderr(cct) << "failed to append " << ops.size()
+               << " log entries (" << this->m_log_pool_name << "): "
+               << cpp_strerror(r) << dendl;
+    ceph_assert(false);
+  }
+
+  utime_t tx_end = ceph_clock_now();
+  m_perfcounter->tinc(l_librbd_pwl_append_tx_t, tx_end - tx_start);
+  m_perfcounter->hinc(
+    l_librbd_pwl_append_tx_t_hist, utime_t(tx_end - tx_start).to_nsec(), ops.size());
+  for (auto &operation : ops) {
+    operation->log_append_comp_time = tx_end;
+  }
+
+  return r;
+}
+
+/*
+ * Drop the in-memory copies of payloads that are now on the SSD. Write
+ * same patterns are small, so they're kept.
+ */
+template <typename I>
+void SSDWriteLog<I>::release_appended_buffers(GenericLogOperations &ops)
+{
+  RWLock::WLocker entry_reader_locker(this->m_entry_reader_lock);
+  for (auto &operation : ops) {
+    if (!operation->reserved_allocated()) {
+      continue;
+    }
+    auto log_entry = static_pointer_cast<WriteLogEntry>(operation->get_log_entry());
+    if (!log_entry->ram_entry.is_writesame()) {
+      log_entry->release_cache_bp();
+    }
+  }
+}
+
+template <typename I>
+void SSDWriteLog<I>::remove_pool_file() {
+  if (m_fd >= 0) {
+    ldout(m_image_ctx.cct, 6) << "closing pool file" << dendl;
+    VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+    m_fd = -1;
+  }
+  if (m_cache_state->clean) {
+    ldout(m_image_ctx.cct, 5) << "Removing empty pool file: " << this->m_log_pool_name << dendl;
+    if (remove(this->m_log_pool_name.c_str()) != 0) {
+      lderr(m_image_ctx.cct) << "failed to remove empty pool \"" << this->m_log_pool_name << "\": "
+                             << cpp_strerror(errno) << dendl;
+    } else {
+      m_cache_state->clean = true;
+      m_cache_state->empty = true;
+      m_cache_state->present = false;
+    }
+  } else {
+    ldout(m_image_ctx.cct, 5) << "Not removing pool file: " << this->m_log_pool_name << dendl;
+  }
+}
+
+template <typename I>
+bool SSDWriteLog<I>::initialize_pool(Context *on_finish, pwl::DeferredContexts &later) {
+  CephContext *cct = m_image_ctx.cct;
+  int r;
+  ceph_assert(ceph_mutex_is_locked_by_me(m_lock));
+  if (access(this->m_log_pool_name.c_str(), F_OK) != 0) {
+    r = open_pool_file(true);
+    if (r < 0) {
+      lderr(cct) << "failed to create pool (" << this->m_log_pool_name << "): "
+                 << cpp_strerror(r) << dendl;
+      m_cache_state->present = false;
+      m_cache_state->clean = true;
+      m_cache_state->empty = true;
+      on_finish->complete(r);
+      return false;
+    }
+    m_cache_state->present = true;
+    m_cache_state->clean = true;
+    m_cache_state->empty = true;
+
+    /* new pool, calculate and store metadata */
+    uint64_t num_log_entries = this->m_log_pool_config_size /
+      (SSD_BLOCK_SIZE + sizeof(struct WriteLogPmemEntry));
+    if (num_log_entries > MAX_LOG_ENTRIES) {
+      num_log_entries = MAX_LOG_ENTRIES;
+    }
+    /* Batches are padded to whole blocks of log entries */
+    num_log_entries = p2align<uint64_t>(num_log_entries, SSD_LOG_ENTRIES_PER_BLOCK);
+    if (num_log_entries < 2 * SSD_LOG_ENTRIES_PER_BLOCK) {
+      lderr(cct) << "num_log_entries needs to be >= "
+                 << 2 * SSD_LOG_ENTRIES_PER_BLOCK << dendl;
+      on_finish->complete(-EINVAL);
+      return false;
+    }
+    this->m_log_pool_actual_size = this->m_log_pool_config_size;
+    init_layout(num_log_entries, this->m_log_pool_actual_size);
+    /* Log ring empty */
+    m_first_free_entry = 0;
+    m_first_valid_entry = 0;
+    m_superblock = {};
+    m_superblock.magic = SSD_SUPERBLOCK_MAGIC;
+    m_superblock.layout_version = SSD_LAYOUT_VERSION;
+    m_superblock.pool_size = this->m_log_pool_actual_size;
+    m_superblock.flushed_sync_gen = this->m_flushed_sync_gen;
+    m_superblock.block_size = SSD_BLOCK_SIZE;
+    m_superblock.num_log_entries = num_log_entries;
+    m_superblock.first_free_entry = m_first_free_entry;
+    m_superblock.first_valid_entry = m_first_valid_entry;
+    m_superblock.first_valid_data = m_data_ring.get_tail();
+    m_superblock.first_free_data = m_data_ring.get_head();
+    r = write_superblock();
+    if (r < 0) {
+      this->m_total_log_entries = 0;
+      this->m_free_log_entries = 0;
+      lderr(cct) << "failed to initialize pool (" << this->m_log_pool_name << "): "
+                 << cpp_strerror(r) << dendl;
+      on_finish->complete(r);
+      return false;
+    }
+    this->m_free_log_entries = this->m_total_log_entries - 1; // leave one free
+  } else {
+    m_cache_state->present = true;
+    /* Open existing pool */
+    r = open_pool_file(false);
+    if (r == 0) {
+      r = read_superblock();
+    }
+    if (r < 0) {
+      lderr(cct) << "failed to open pool (" << this->m_log_pool_name << "): "
+                 << cpp_strerror(r) << dendl;
+      on_finish->complete(r);
+      return false;
+    }
+    this->m_log_pool_actual_size = m_superblock.pool_size;
+    this->m_flushed_sync_gen = m_superblock.flushed_sync_gen;
+    init_layout(m_superblock.num_log_entries, m_superblock.pool_size);
+    m_first_free_entry = m_superblock.first_free_entry;
+    m_first_valid_entry = m_superblock.first_valid_entry;
+    if (m_first_free_entry < m_first_valid_entry) {
+      /* Valid entries wrap around the end of the ring, so first_free is lower
+       * than first_valid.  If first_valid was == first_free+1, the entry at
+       * first_free would be empty. The last entry is never used, so in
+       * that case there would be zero free log entries. */
+      this->m_free_log_entries = this->m_total_log_entries - (m_first_valid_entry - m_first_free_entry) -1;
+    } else {
+      /* first_valid is <= first_free. If they are == we have zero valid log
+       * entries, and n-1 free log entries */
+      this->m_free_log_entries = this->m_total_log_entries - (m_first_free_entry - m_first_valid_entry) -1;
+    }
+    r = safe_pread_exact(m_fd, m_log_entries_bp.c_str(), m_log_entries_bp.length(),
+                         SSD_BLOCK_SIZE);
+    if (r < 0) {
+      lderr(cct) << "failed to read log entries (" << this->m_log_pool_name << "): "
+                 << cpp_strerror(r) << dendl;
+      on_finish->complete(r);
+      return false;
+    }
+    r = load_existing_entries(later);
+    if (r < 0) {
+      lderr(cct) << "failed to load log entries (" << this->m_log_pool_name << "): "
+                 << cpp_strerror(r) << dendl;
+      on_finish->complete(r);
+      return false;
+    }
+    m_cache_state->clean = this->m_dirty_log_entries.empty();
+    m_cache_state->empty = m_log_entries.empty();
+  }
+  return true;
+}
+
+/*
+ * Loads the log entries from an existing log, and rebuilds the data
+ * ring from them. See ReplicatedWriteLog::load_existing_entries().
+ * Write payloads are left on the SSD. Returns -EIO if the log entries
+ * are corrupt.
+ */
+template <typename I>
+int SSDWriteLog<I>::load_existing_entries(DeferredContexts &later) {
+  CephContext *cct = m_image_ctx.cct;
+  struct WriteLogPmemEntry *log_entries =
+    reinterpret_cast<struct WriteLogPmemEntry*>(m_log_entries_bp.c_str());
+  std::map<uint64_t, std::shared_ptr<SyncPointLogEntry>> sync_point_entries;
+  std::map<uint64_t, bool> missing_sync_points;
+  SSDDataRing::Extents data_extents;
+
+  /* Check all entries, and rebuild the data ring, before loading any.
+   * Invalid entries only pad a batch to the end of its block. */
+  bool padding = false;
+  for (uint64_t entry_index = m_first_valid_entry;
+       entry_index != m_first_free_entry;
+       entry_index = (entry_index + 1) % this->m_total_log_entries) {
+    WriteLogPmemEntry *pmem_entry = &log_entries[entry_index];
+    if (entry_index % SSD_LOG_ENTRIES_PER_BLOCK == 0) {
+      padding = false;
+    }
+    if (!pmem_entry->entry_valid) {
+      padding = true;
+      continue;
+    }
+    if (padding || pmem_entry->entry_index != entry_index ||
+        pmem_entry->entry_crc != log_entry_crc(pmem_entry)) {
+      lderr(cct) << "log entry " << entry_index << " is corrupt: "
+                 << *pmem_entry << dendl;
+      return -EIO;
+    }
+    uint64_t data_bytes = 0;
+    if (pmem_entry->is_writesame()) {
+      data_bytes = pmem_entry->ws_datalen;
+    } else if (pmem_entry->is_write()) {
+      data_bytes = pmem_entry->write_bytes;
+    }
+    if (data_bytes > 0) {
+      data_extents.emplace_back(pmem_entry->write_data_pos,
+                                data_alloc_size(data_bytes));
+    }
+  }
+  if (!m_data_ring.load(m_superblock.first_valid_data,
+                        m_superblock.first_free_data, data_extents)) {
+    lderr(cct) << "log entry payloads are outside the data ring (tail="
+               << m_superblock.first_valid_data << ", head="
+               << m_superblock.first_free_data << ")" << dendl;
+    return -EIO;
+  }
+
+  for (uint64_t entry_index = m_first_valid_entry;
+       entry_index != m_first_free_entry;
+       entry_index = (entry_index + 1) % this->m_total_log_entries) {
+    WriteLogPmemEntry *pmem_entry = &log_entries[entry_index];
+    if (!pmem_entry->entry_valid) {
+      continue;
+    }
+    std::shared_ptr<GenericLogEntry> log_entry = nullptr;
+
+    this->update_entries(log_entry, pmem_entry, missing_sync_points,
+        sync_point_entries, entry_index);
+
+    log_entry->ram_entry = *pmem_entry;
+    log_entry->pmem_entry = pmem_entry;
+    log_entry->log_entry_index = entry_index;
+    log_entry->completed = true;
+
+    m_log_entries.push_back(log_entry);
+  }
+
+  this->update_sync_points(missing_sync_points, sync_point_entries, later);
+
+  /* Account for the space all payloads (write same too) take on the SSD */
+  this->m_bytes_allocated = 0;
+  this->m_bytes_cached = 0;
+  for (auto &log_entry : m_log_entries) {
+    if (log_entry->write_bytes() > 0) {
+      this->m_bytes_allocated += data_alloc_size(log_entry->write_bytes());
+      this->m_bytes_cached += log_entry->write_bytes();
+    }
+  }
+  return 0;
+}
+
+template <typename I>
+void SSDWriteLog<I>::write_data_to_buffer(std::shared_ptr<WriteLogEntry> ws_entry,
+    WriteLogPmemEntry *pmem_entry) {
+  if (!pmem_entry->is_writesame()) {
+    /* Read from the SSD when needed */
+    return;
+  }
+  bufferptr bp = buffer::create_page_aligned(data_alloc_size(pmem_entry->ws_datalen));
+  int r = safe_pread_exact(m_fd, bp.c_str(), bp.length(), pmem_entry->write_data_pos);
+  if (r < 0) {
+    lderr(m_image_ctx.cct) << "failed to read write same pattern: "
+                           << cpp_strerror(r) << dendl;
+    ceph_assert(false);
+  }
+  ws_entry->init_cache_bp(bp);
+}
+
+template <typename I>
+void SSDWriteLog<I>::read_data_from_buffer(
+    std::shared_ptr<GenericWriteLogEntry> log_entry, bufferlist *out_bl) {
+  auto write_entry = static_pointer_cast<WriteLogEntry>(log_entry);
+  if (write_entry->pmem_buffer) {
+    /* Not appended yet, or a write same pattern */
+    write_entry->copy_pmem_bl(out_bl);
+    return;
+  }
+  out_bl->clear();
+  int r = read_data(write_entry->ram_entry.write_data_pos,
+                    write_entry->write_bytes(), out_bl);
+  if (r < 0) {
+    lderr(m_image_ctx.cct) << "failed to read log entry=[" << *write_entry
+                           << "]: " << cpp_strerror(r) << dendl;
+    ceph_assert(false);
+  }
+}
+
+/**
+ * Retire up to frees_per_tx of the oldest log entries that are
+ * eligible to be retired. Returns true if anything was retired.
+ */
+template <typename I>
+bool SSDWriteLog<I>::retire_entries(const unsigned long int frees_per_tx) {
+  CephContext *cct = m_image_ctx.cct;
+  GenericLogEntriesVector retiring_entries;
+  uint32_t initial_first_valid_entry;
+  uint32_t first_valid_entry;
+
+  std::lock_guard retire_locker(this->m_log_retire_lock);
+  ldout(cct, 20) << "Look for entries to retire" << dendl;
+  {
+    /* Entry readers can't be added while we hold m_entry_reader_lock */
+    RWLock::WLocker entry_reader_locker(this->m_entry_reader_lock);
+    std::lock_guard locker(m_lock);
+    initial_first_valid_entry = this->m_first_valid_entry;
+    first_valid_entry = this->m_first_valid_entry;
+    while (!m_log_entries.empty() &&
+           retiring_entries.size() < frees_per_tx &&
+           this->can_retire_entry(m_log_entries.front())) {
+      auto entry = m_log_entries.front();
+      if (entry->log_entry_index != first_valid_entry) {
+        lderr(cct) << "Retiring entry index (" << entry->log_entry_index
+                   << ") and first valid log entry index (" << first_valid_entry
+                   << ") must be ==." << dendl;
+      }
+      ceph_assert(entry->log_entry_index == first_valid_entry);
+      m_log_entries.pop_front();
+      retiring_entries.push_back(entry);
+      /* Skip the padding after the last entry of a batch */
+      first_valid_entry = m_log_entries.empty() ? this->m_first_free_entry :
+        m_log_entries.front()->log_entry_index;
+      /* Remove entry from map so there will be no more readers */
+      if ((entry->write_bytes() > 0) || (entry->bytes_dirty() > 0)) {
+        auto gen_write_entry = static_pointer_cast<GenericWriteLogEntry>(entry);
+        if (gen_write_entry) {
+          this->m_blocks_to_log_entries.remove_log_entry(gen_write_entry);
+        }
+      }
+    }
+  }
+
+  if (retiring_entries.size()) {
+    ldout(cct, 20) << "Retiring " << retiring_entries.size() << " entries" << dendl;
+
+    utime_t tx_start;
+    utime_t tx_end;
+    /* Advance first valid entry and release buffers */
+    {
+      uint64_t flushed_sync_gen;
+      {
+        std::lock_guard locker(m_lock);
+        flushed_sync_gen = this->m_flushed_sync_gen;
+      }
+
+      tx_start = ceph_clock_now();
+      int r = update_superblock(
+        [this, flushed_sync_gen, first_valid_entry](WriteLogSSDSuperblock &superblock) {
+          if (superblock.flushed_sync_gen < flushed_sync_gen) {
+            ldout(m_image_ctx.cct, 20) << "flushed_sync_gen in log updated from "
+                                       << superblock.flushed_sync_gen << " to "
+                                       << flushed_sync_gen << dendl;
+            superblock.flushed_sync_gen = flushed_sync_gen;
+          }
+          superblock.first_valid_entry = first_valid_entry;
+        });
+      if (r < 0) {
+        lderr(cct) << "failed to commit free of" << retiring_entries.size()
+                   << " log entries (" << this->m_log_pool_name << "): "
+                   << cpp_strerror(r) << dendl;
+        ceph_assert(false);
+      }
+      tx_end = ceph_clock_now();
+    }
+    m_perfcounter->tinc(l_librbd_pwl_retire_tx_t, tx_end - tx_start);
+    m_perfcounter->hinc(l_librbd_pwl_retire_tx_t_hist, utime_t(tx_end - tx_start).to_nsec(),
+        retiring_entries.size());
+
+    /* Update runtime copy of first_valid, and free entries counts */
+    {
+      std::lock_guard locker(m_lock);
+
+      ceph_assert(this->m_first_valid_entry == initial_first_valid_entry);
+      this->m_first_valid_entry = first_valid_entry;
+      /* Padding included */
+      this->m_free_log_entries +=
+        (first_valid_entry + this->m_total_log_entries - initial_first_valid_entry) %
+        this->m_total_log_entries;
+      for (auto &entry: retiring_entries) {
+        if (entry->write_bytes()) {
+          ceph_assert(this->m_bytes_cached >= entry->write_bytes());
+          this->m_bytes_cached -= entry->write_bytes();
+          uint64_t entry_allocation_size = data_alloc_size(entry->write_bytes());
+          ceph_assert(this->m_bytes_allocated >= entry_allocation_size);
+          this->m_bytes_allocated -= entry_allocation_size;
+          m_data_ring.release(entry->ram_entry.write_data_pos, entry_allocation_size);
+        }
+      }
+      this->m_alloc_failed_since_retire = false;
+      this->wake_up();
+    }
+  } else {
+    ldout(cct, 20) << "Nothing to retire" << dendl;
+    return false;
+  }
+  return true;
+}
+
+template <typename I>
+Context* SSDWriteLog<I>::construct_flush_entry_ctx(
+    std::shared_ptr<GenericLogEntry> log_entry) {
+  bool invalidating = this->m_invalidating; // snapshot so we behave consistently
+  Context *ctx = this->construct_flush_entry(log_entry, invalidating);
+
+  if (invalidating) {
+    return ctx;
+  }
+  return new LambdaContext(
+    [this, log_entry, ctx](int r) {
+      m_image_ctx.op_work_queue->queue(new LambdaContext(
+        [this, log_entry, ctx](int r) {
+          ldout(m_image_ctx.cct, 15) << "flushing:" << log_entry
+                                     << " " << *log_entry << dendl;
+          if (!log_entry->ram_entry.is_write()) {
+            log_entry->writeback(this->m_image_writeback, ctx);
+            return;
+          }
+          /* The payload is normally only on the SSD by now */
+          bufferlist entry_bl;
+          {
+            RWLock::RLocker entry_reader_locker(this->m_entry_reader_lock);
+            read_data_from_buffer(
+              static_pointer_cast<GenericWriteLogEntry>(log_entry), &entry_bl);
+          }
+          this->m_image_writeback.aio_write(
+            {{log_entry->ram_entry.image_offset_bytes, log_entry->ram_entry.write_bytes}},
+            std::move(entry_bl), 0, ctx);
+        }), 0);
+    });
+}
+
+/*
+ * Performs the log event append operation for all of the scheduled
+ * events. Payloads are written with their log entries, so there's no
+ * separate buffer flush step.
+ */
+template <typename I>
+void SSDWriteLog<I>::append_scheduled_ops(void) {
+  GenericLogOperations ops;
+  int append_result = 0;
+  bool ops_remain = false;
+  bool appending = false; /* true if we set m_appending */
+  ldout(m_image_ctx.cct, 20) << dendl;
+  do {
+    ops.clear();
+    /* Every batch costs two syncs, so make them as large as a sync point */
+    this->append_scheduled(ops, ops_remain, appending);
+
+    if (ops.size()) {
+      {
+        std::lock_guard locker(this->m_log_append_lock);
+        alloc_op_log_entries(ops);
+      }
+      append_result = append_op_log_entries(ops);
+    }
+
+    int num_ops = ops.size();
+    if (num_ops) {
+      if (append_result == 0) {
+        release_appended_buffers(ops);
+      }
+      /* New entries may be flushable. Completion will wake up flusher. */
+      this->complete_op_log_entries(std::move(ops), append_result);
+    }
+  } while (ops_remain);
+}
+
+template <typename I>
+void SSDWriteLog<I>::setup_schedule_append(
+    pwl::GenericLogOperationsVector &ops, bool do_early_flush) {
+  /* Payloads are persisted in the append step */
+  this->schedule_append(ops);
+}
+
+/*
+ * Takes custody of ops. They'll all get their log entries appended,
+ * and have their on_write_persist contexts completed once they and
+ * all prior log entries are persisted everywhere.
+ */
+template <typename I>
+void SSDWriteLog<I>::schedule_append_ops(GenericLogOperations &ops)
+{
+  bool need_finisher;
+  GenericLogOperationsVector appending;
+
+  std::copy(std::begin(ops), std::end(ops), std::back_inserter(appending));
+  {
+    std::lock_guard locker(m_lock);
+
+    need_finisher = this->m_ops_to_append.empty() && !this->m_appending;
+    this->m_ops_to_append.splice(this->m_ops_to_append.end(), ops);
+  }
+
+  if (need_finisher) {
+    this->enlist_op_appender();
+  }
+
+  for (auto &op : appending) {
+    op->appending();
+  }
+}
+
+template <typename I>
+void SSDWriteLog<I>::process_work() {
+  CephContext *cct = m_image_ctx.cct;
+  int max_iterations = 4;
+  bool wake_up_requested = false;
+  uint64_t aggressive_high_water_bytes = this->m_bytes_allocated_cap * AGGRESSIVE_RETIRE_HIGH_WATER;
+  uint64_t high_water_bytes = this->m_bytes_allocated_cap * RETIRE_HIGH_WATER;
+  uint64_t low_water_bytes = this->m_bytes_allocated_cap * RETIRE_LOW_WATER;
+  uint64_t aggressive_high_water_entries = this->m_total_log_entries * AGGRESSIVE_RETIRE_HIGH_WATER;
+  uint64_t high_water_entries = this->m_total_log_entries * RETIRE_HIGH_WATER;
+  uint64_t low_water_entries = this->m_total_log_entries * RETIRE_LOW_WATER;
+
+  ldout(cct, 20) << dendl;
+
+  do {
+    {
+      std::lock_guard locker(m_lock);
+      this->m_wake_up_requested = false;
+    }
+    if (this->m_alloc_failed_since_retire || this->m_invalidating ||
+        this->m_bytes_allocated > high_water_bytes ||
+        (m_log_entries.size() > high_water_entries)) {
+      int retired = 0;
+      utime_t started = ceph_clock_now();
+      ldout(m_image_ctx.cct, 10) << "alloc_fail=" << this->m_alloc_failed_since_retire
+                                 << ", allocated > high_water="
+                                 << (this->m_bytes_allocated > high_water_bytes)
+                                 << ", allocated_entries > high_water="
+                                 << (m_log_entries.size() > high_water_entries)
+                                 << dendl;
+      while (this->m_alloc_failed_since_retire || this->m_invalidating ||
+            (this->m_bytes_allocated > high_water_bytes) ||
+            (m_log_entries.size() > high_water_entries) ||
+            (((this->m_bytes_allocated > low_water_bytes) ||
+              (m_log_entries.size() > low_water_entries)) &&
+            (utime_t(ceph_clock_now() - started).to_msec() < RETIRE_BATCH_TIME_LIMIT_MS))) {
+        /* Retiring costs a superblock update, so always retire in batches */
+        if (!retire_entries((this->m_shutting_down || this->m_invalidating ||
+           (this->m_bytes_allocated > aggressive_high_water_bytes) ||
+           (m_log_entries.size() > aggressive_high_water_entries))
+            ? MAX_WRITES_PER_SYNC_POINT
+            : MAX_ALLOC_PER_TRANSACTION)) {
+          break;
+        }
+        retired++;
+        this->dispatch_deferred_writes();
+        this->process_writeback_dirty_entries();
+      }
+      ldout(m_image_ctx.cct, 10) << "Retired " << retired << " times" << dendl;
+    }
+    this->dispatch_deferred_writes();
+    this->process_writeback_dirty_entries();
+
+    {
+      std::lock_guard locker(m_lock);
+      wake_up_requested = this->m_wake_up_requested;
+    }
+  } while (wake_up_requested && --max_iterations > 0);
+
+  {
+    std::lock_guard locker(m_lock);
+    this->m_wake_up_scheduled = false;
+    /* Reschedule if it's still requested */
+    if (this->m_wake_up_requested) {
+      this->wake_up();
+    }
+  }
+}
+
+/**
+ * Update/persist the last flushed sync point in the log
+ */
+template <typename I>
+void SSDWriteLog<I>::persist_last_flushed_sync_gen()
+{
+  uint64_t flushed_sync_gen;
+  {
+    std::lock_guard locker(m_lock);
+    flushed_sync_gen = this->m_flushed_sync_gen;
+  }
+  {
+    std::lock_guard superblock_locker(m_superblock_lock);
+    if (m_superblock.flushed_sync_gen >= flushed_sync_gen) {
+      return;
+    }
+  }
+
+  int r = update_superblock(
+    [this, flushed_sync_gen](WriteLogSSDSuperblock &superblock) {
+      if (superblock.flushed_sync_gen < flushed_sync_gen) {
+        ldout(m_image_ctx.cct, 15) << "flushed_sync_gen in log updated from "
+                                   << superblock.flushed_sync_gen << " to "
+                                   << flushed_sync_gen << dendl;
+        superblock.flushed_sync_gen = flushed_sync_gen;
+      }
+    });
+  if (r < 0) {
+    lderr(m_image_ctx.cct) << "failed to commit update of flushed sync point: "
+                           << cpp_strerror(r) << dendl;
+    ceph_assert(false);
+  }
+}
+
+/*
+ * Stages each payload in an SSD_BLOCK_SIZE aligned buffer, and reserves
+ * its place in the data ring. Fails with no_space if the ring is full.
+ */
+template <typename I>
+void SSDWriteLog<I>::reserve_pmem(C_BlockIORequestT *req,
+                                  bool &alloc_succeeds, bool &no_space) {
+  std::vector<WriteBufferAllocation>& buffers = req->get_resources_buffers();
+  {
+    std::lock_guard locker(m_lock);
+    for (auto &buffer : buffers) {
+      if (!m_data_ring.alloc(data_alloc_size(buffer.allocation_size),
+                             &buffer.buffer_pos)) {
+        ldout(m_image_ctx.cct, 20) << "data ring full (" << m_data_ring << ")"
+                                   << dendl;
+        alloc_succeeds = false;
+        no_space = true;
+        break;
+      }
+      buffer.allocated = true;
+    }
+  }
+  if (!alloc_succeeds) {
+    /* alloc_resources() releases what was reserved */
+    return;
+  }
+  for (auto &buffer : buffers) {
+    utime_t before_reserve = ceph_clock_now();
+    buffer.buffer_bp = buffer::create_page_aligned(data_alloc_size(buffer.allocation_size));
+    buffer.allocation_lat = ceph_clock_now() - before_reserve;
+    ldout(m_image_ctx.cct, 20) << "Allocated " << buffer.buffer_bp.length()
+                               << " bytes at " << buffer.buffer_pos
+                               << ", size=" << buffer.allocation_size << dendl;
+  }
+}
+
+/*
+ * Releases the data ring space reserved for buffers that won't be
+ * appended.
+ */
+template <typename I>
+void SSDWriteLog<I>::release_data(std::vector<WriteBufferAllocation> &buffers) {
+  std::lock_guard locker(m_lock);
+  for (auto &buffer : buffers) {
+    if (buffer.allocated) {
+      m_data_ring.release(buffer.buffer_pos, data_alloc_size(buffer.allocation_size));
+      buffer.buffer_bp = bufferptr();
+      buffer.allocated = false;
+    }
+  }
+}
+
+template <typename I>
+bool SSDWriteLog<I>::alloc_resources(C_BlockIORequestT *req) {
+  bool alloc_succeeds = true;
+  uint64_t bytes_allocated = 0;
+  uint64_t bytes_cached = 0;
+  uint64_t bytes_dirtied = 0;
+  uint64_t num_lanes = 0;
+  uint64_t num_unpublished_reserves = 0;
+  uint64_t num_log_entries = 0;
+
+  ldout(m_image_ctx.cct, 20) << dendl;
+  // Setup buffer, and get all the number of required resources
+  req->setup_buffer_resources(bytes_cached, bytes_dirtied, bytes_allocated,
+                              num_lanes, num_log_entries, num_unpublished_reserves);
+
+  std::vector<WriteBufferAllocation>& buffers = req->get_resources_buffers();
+  /* Payloads take whole blocks in the data ring */
+  bytes_allocated = 0;
+  for (auto &buffer : buffers) {
+    bytes_allocated += data_alloc_size(buffer.allocation_size);
+  }
+  /* Up to a block of log entries per op, for the padding after the
+   * batch it's appended in. Unused ones are given back on append. */
+  num_log_entries *= SSD_LOG_ENTRIES_PER_BLOCK;
+
+  alloc_succeeds = this->check_allocation(req, bytes_cached, bytes_dirtied, bytes_allocated,
+                              num_lanes, num_log_entries, num_unpublished_reserves,
+                              this->m_bytes_allocated_cap);
+
+  if (!alloc_succeeds) {
+    /* On alloc failure, free any buffers we did allocate */
+    release_data(buffers);
+  }
+
+  req->set_allocated(alloc_succeeds);
+  return alloc_succeeds;
+}
+
+} // namespace pwl
+} // namespace cache
+} // namespace librbd
+
+template class librbd::cache::pwl::SSDWriteLog<librbd::ImageCtx>;
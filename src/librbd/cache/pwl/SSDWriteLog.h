@@ -0,0 +1,125 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_CACHE_SSD_WRITE_LOG
+#define CEPH_LIBRBD_CACHE_SSD_WRITE_LOG
+
+#include "common/RWLock.h"
+#include "common/WorkQueue.h"
+#include "common/AsyncOpTracker.h"
+#include "librbd/cache/ImageWriteback.h"
+#include "librbd/Utils.h"
+#include "librbd/BlockGuard.h"
+#include "librbd/cache/Types.h"
+#include "librbd/cache/pwl/LogOperation.h"
+#include "librbd/cache/pwl/Request.h"
+#include "librbd/cache/pwl/LogMap.h"
+#include "librbd/cache/pwl/SSDDataRing.h"
+#include "AbstractWriteLog.h"
+#include <functional>
+#include <list>
+
+class Context;
+class SafeTimer;
+
+namespace librbd {
+
+struct ImageCtx;
+
+namespace cache {
+
+namespace pwl {
+
+/*
+ * Write log kept in a file on a (non-persistent memory) SSD.
+ *
+ * The file starts with a WriteLogSSDSuperblock, followed by the ring of
+ * log entries and then the ring of data buffers. Both rings are only
+ * written in SSD_BLOCK_SIZE units. Ops are appended in batches: the data
+ * buffers and the log entries of a batch are written and synced, then
+ * the superblock is updated to publish them. Each batch is padded to a
+ * whole block of log entries, so a torn write can only hit entries that
+ * aren't published yet, and every entry carries a crc.
+ *
+ * Space in the data ring is reserved with the other resources of a
+ * request. Payloads are kept in memory only until they are appended.
+ * Later read hits and writeback read them back from the SSD.
+ */
+template <typename ImageCtxT>
+class SSDWriteLog : public AbstractWriteLog<ImageCtxT> {
+public:
+  SSDWriteLog(
+      ImageCtxT &image_ctx, librbd::cache::pwl::ImageCacheState<ImageCtxT>* cache_state);
+  ~SSDWriteLog();
+  SSDWriteLog(const SSDWriteLog&) = delete;
+  SSDWriteLog &operator=(const SSDWriteLog&) = delete;
+
+private:
+  using This = AbstractWriteLog<ImageCtxT>;
+  using C_WriteRequestT = pwl::C_WriteRequest<This>;
+  using C_BlockIORequestT = pwl::C_BlockIORequest<This>;
+  using C_FlushRequestT = pwl::C_FlushRequest<This>;
+  using C_DiscardRequestT = pwl::C_DiscardRequest<This>;
+  using C_WriteSameRequestT = pwl::C_WriteSameRequest<This>;
+  using C_CompAndWriteRequestT = pwl::C_CompAndWriteRequest<This>;
+
+  int m_fd = -1;
+  /* Serializes superblock updates, which are the only I/O done under a
+   * lock. Appends write their data and log entries without one. */
+  ceph::mutex m_superblock_lock;
+  WriteLogSSDSuperblock m_superblock; /* Last persisted, under m_superblock_lock */
+  bufferptr m_log_entries_bp;         /* In-memory copy of the log entry ring */
+  uint64_t m_data_start = 0;          /* Data ring, in bytes from the file start */
+  SSDDataRing m_data_ring;            /* Under m_lock */
+
+  int open_pool_file(bool create);
+  void init_layout(uint32_t num_log_entries, uint64_t pool_size);
+  int write_superblock();
+  int update_superblock(std::function<void(WriteLogSSDSuperblock&)> update);
+  int read_superblock();
+  int read_data(uint64_t pos, uint64_t length, bufferlist *bl);
+  void remove_pool_file();
+  int load_existing_entries(pwl::DeferredContexts &later);
+  void release_data(std::vector<WriteBufferAllocation> &buffers);
+  void alloc_op_log_entries(pwl::GenericLogOperations &ops);
+  int append_op_log_entries(pwl::GenericLogOperations &ops);
+  int write_log_entries(uint32_t first_index, uint32_t count);
+  void release_appended_buffers(pwl::GenericLogOperations &ops);
+
+protected:
+  using AbstractWriteLog<ImageCtxT>::m_lock;
+  using AbstractWriteLog<ImageCtxT>::m_log_entries;
+  using AbstractWriteLog<ImageCtxT>::m_image_ctx;
+  using AbstractWriteLog<ImageCtxT>::m_perfcounter;
+  using AbstractWriteLog<ImageCtxT>::m_ops_to_flush;
+  using AbstractWriteLog<ImageCtxT>::m_cache_state;
+  using AbstractWriteLog<ImageCtxT>::m_first_free_entry;
+  using AbstractWriteLog<ImageCtxT>::m_first_valid_entry;
+
+  void process_work() override;
+  void schedule_append_ops(pwl::GenericLogOperations &ops) override;
+  void append_scheduled_ops(void) override;
+  void reserve_pmem(C_BlockIORequestT *req, bool &alloc_succeeds, bool &no_space) override;
+  bool retire_entries(const unsigned long int frees_per_tx) override;
+  void persist_last_flushed_sync_gen() override;
+  bool alloc_resources(C_BlockIORequestT *req) override;
+  void setup_schedule_append(
+      pwl::GenericLogOperationsVector &ops, bool do_early_flush) override;
+  Context *construct_flush_entry_ctx(
+        const std::shared_ptr<pwl::GenericLogEntry> log_entry) override;
+  bool initialize_pool(Context *on_finish, pwl::DeferredContexts &later) override;
+  void write_data_to_buffer(
+      std::shared_ptr<pwl::WriteLogEntry> ws_entry,
+      pwl::WriteLogPmemEntry *pmem_entry) override;
+  void read_data_from_buffer(
+      std::shared_ptr<pwl::GenericWriteLogEntry> log_entry,
+      bufferlist *out_bl) override;
+};
+
+} // namespace pwl
+} // namespace cache
+} // namespace librbd
+
+extern template class librbd::cache::pwl::SSDWriteLog<librbd::ImageCtx>;
+
+#endif // CEPH_LIBRBD_CACHE_SSD_WRITE_LOG
@@ -6,6 +6,7 @@
 
 #include <vector>
 #include <libpmemobj.h>
+#include "include/buffer.h"
 #include "librbd/BlockGuard.h"
 #include "librbd/io/Types.h"
 
@@ -195,7 +196,10 @@ struct WriteLogPmemEntry {
   uint64_t write_sequence_number = 0;
   uint64_t image_offset_bytes;
   uint64_t write_bytes;
-  TOID(uint8_t) write_data;
+  union {
+    TOID(uint8_t) write_data;  /* RWL: pmem buffer holding the payload */
+    uint64_t write_data_pos;   /* SSD: offset of the payload on the device */
+  };
   struct {
     uint8_t entry_valid :1; /* if 0, this entry is free */
     uint8_t sync_point :1;  /* No data. No write sequence number. Marks sync
@@ -208,6 +212,7 @@ struct WriteLogPmemEntry {
   uint32_t ws_datalen = 0;  /* Length of data buffer (writesame only) */
   uint32_t entry_index = 0; /* For debug consistency check. Can be removed if
                              * we need the space */
+  uint32_t entry_crc = 0;   /* SSD: crc32c of the fields above */
   WriteLogPmemEntry(const uint64_t image_offset_bytes, const uint64_t write_bytes)
     : image_offset_bytes(image_offset_bytes), write_bytes(write_bytes),
       entry_valid(0), sync_point(0), sequenced(0), has_data(0), discard(0), writesame(0) {
@@ -255,10 +260,40 @@ struct WriteLogPoolRoot {
   uint32_t first_valid_entry;    /* Index of the oldest valid entry in the log */
 };
 
+/* SSD structures */
+const uint64_t SSD_SUPERBLOCK_MAGIC = 0x7277636c73736421ULL; /* "rwlcssd!" */
+const uint8_t SSD_LAYOUT_VERSION = 1;
+const uint64_t SSD_BLOCK_SIZE = 4096;
+/* Each append batch is padded to a whole block of log entries, so later
+ * batches never rewrite a block holding committed entries */
+const uint32_t SSD_LOG_ENTRIES_PER_BLOCK = SSD_BLOCK_SIZE / sizeof(WriteLogPmemEntry);
+
+/*
+ * The first block of an SSD cache file. Followed by the ring of
+ * WriteLogPmemEntry structs (num_log_entries of them, padded to
+ * SSD_BLOCK_SIZE), which is followed by the ring of data buffers.
+ */
+struct WriteLogSSDSuperblock {
+  uint64_t magic;
+  uint64_t layout_version;
+  uint64_t pool_size;
+  uint64_t flushed_sync_gen;     /* All writing entries with this or a lower
+                                  * sync gen number are flushed. */
+  uint64_t first_valid_data;     /* Tail of the data ring */
+  uint64_t first_free_data;      /* Head of the data ring */
+  uint32_t block_size;
+  uint32_t num_log_entries;
+  uint32_t first_free_entry;     /* Entry following the newest valid entry */
+  uint32_t first_valid_entry;    /* Index of the oldest valid entry in the log */
+  uint32_t crc;                  /* crc32c of the fields above */
+};
+
 struct WriteBufferAllocation {
   unsigned int allocation_size = 0;
   pobj_action buffer_alloc_action;
   TOID(uint8_t) buffer_oid = OID_NULL;
+  bufferptr buffer_bp;           /* SSD: payload staged in memory */
+  uint64_t buffer_pos = 0;       /* SSD: where the payload goes in the data ring */
   bool allocated = false;
   utime_t allocation_lat;
 };
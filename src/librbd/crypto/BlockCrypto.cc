@@ -5,6 +5,8 @@
 #include "include/byteorder.h"
 #include "include/ceph_assert.h"
 
+#include "include/page.h"
+
 #include <stdlib.h>
 
 namespace librbd {
@@ -18,6 +20,33 @@ BlockCrypto<T>::BlockCrypto(CephContext* cct, DataCryptor<T>* data_cryptor,
   ceph_assert((block_size % data_cryptor->get_block_size()) == 0);
 }
 
+template <typename T>
+int BlockCrypto<T>::crypt_blocks(T* ctx, uint64_t block_offset,
+                                 const unsigned char* in, unsigned char* out,
+                                 uint64_t length) {
+  // each block is a separate cipher data unit keyed by its block number
+  unsigned char* iv = (unsigned char*)alloca(m_iv_size);
+  memset(iv, 0, m_iv_size);
+
+  for (uint64_t pos = 0; pos < length; pos += m_block_size) {
+    auto block_offset_le = init_le64(block_offset++);
+    memcpy(iv, &block_offset_le, sizeof(block_offset_le));
+    auto r = m_data_cryptor->init_context(ctx, iv, m_iv_size);
+    if (r != 0) {
+      lderr(m_cct) << "unable to init cipher's IV" << dendl;
+      return r;
+    }
+
+    r = m_data_cryptor->update_context(ctx, in + pos, out + pos,
+                                       m_block_size);
+    if (r < 0) {
+      lderr(m_cct) << "crypt update failed" << dendl;
+      return r;
+    }
+  }
+  return 0;
+}
+
 template <typename T>
 int BlockCrypto<T>::crypt(ceph::bufferlist* data, uint64_t image_offset,
                            CipherMode mode) {
@@ -32,59 +61,61 @@ int BlockCrypto<T>::crypt(ceph::bufferlist* data, uint64_t image_offset,
     return -EINVAL;
   }
 
-  unsigned char* iv = (unsigned char*)alloca(m_iv_size);
-  memset(iv, 0, m_iv_size);
-
-  bufferlist src = *data;
-  data->clear();
-
   auto ctx = m_data_cryptor->get_context(mode);
   if (ctx == nullptr) {
     lderr(m_cct) << "unable to get crypt context" << dendl;
     return -EIO;
   }
+
   auto block_offset = image_offset / m_block_size;
-  auto appender = data->get_contiguous_appender(src.length());
-  unsigned char* out_buf_ptr = nullptr;
-  uint32_t remaining_block_bytes = 0;
-  for (auto buf = src.buffers().begin(); buf != src.buffers().end(); ++buf) {
-    auto in_buf_ptr = reinterpret_cast<const unsigned char*>(buf->c_str());
-    auto remaining_buf_bytes = buf->length();
-    while (remaining_buf_bytes > 0) {
-      if (remaining_block_bytes == 0) {
-        auto block_offset_le = init_le64(block_offset);
-        memcpy(iv, &block_offset_le, sizeof(block_offset_le));
-        auto r = m_data_cryptor->init_context(ctx, iv, m_iv_size);
-        if (r != 0) {
-          lderr(m_cct) << "unable to init cipher's IV" << dendl;
-          return r;
-        }
-
-        out_buf_ptr = reinterpret_cast<unsigned char*>(
-                appender.get_pos_add(m_block_size));
-        remaining_block_bytes = m_block_size;
-        ++block_offset;
+  int r = 0;
+  if (mode == CipherMode::CIPHER_MODE_DEC && data->is_contiguous()) {
+    // decrypted data is owned by the caller: transform it in place
+    auto buf = reinterpret_cast<unsigned char*>(data->c_str());
+    r = crypt_blocks(ctx, block_offset, buf, buf, data->length());
+  } else {
+    // the source may reference the user's write buffer (zero-copy), so the
+    // result is written to a new buffer. Runs of whole blocks within a
+    // source buffer are transformed directly; only blocks that straddle
+    // buffers are gathered first.
+    auto length = data->length();
+    bufferptr bp(buffer::create_aligned(length, CEPH_PAGE_SIZE));
+    auto out_buf_ptr = reinterpret_cast<unsigned char*>(bp.c_str());
+
+    auto it = data->cbegin();
+    uint64_t pos = 0;
+    while (r == 0 && pos < length) {
+      const char* in_buf_ptr;
+      auto in_length = it.get_ptr_and_advance(length - pos, &in_buf_ptr);
+      auto blocks_length = in_length - (in_length % m_block_size);
+      if (blocks_length > 0) {
+        r = crypt_blocks(
+          ctx, block_offset,
+          reinterpret_cast<const unsigned char*>(in_buf_ptr),
+          out_buf_ptr + pos, blocks_length);
+        block_offset += blocks_length / m_block_size;
+        pos += blocks_length;
       }
 
-      auto crypto_input_length = std::min(remaining_buf_bytes,
-                                          remaining_block_bytes);
-      auto crypto_output_length = m_data_cryptor->update_context(
-              ctx, in_buf_ptr, out_buf_ptr, crypto_input_length);
-      if (crypto_output_length < 0) {
-        lderr(m_cct) << "crypt update failed" << dendl;
-        return crypto_output_length;
+      if (r == 0 && in_length > blocks_length) {
+        auto partial_length = in_length - blocks_length;
+        memcpy(out_buf_ptr + pos, in_buf_ptr + blocks_length, partial_length);
+        it.copy(m_block_size - partial_length,
+                reinterpret_cast<char*>(out_buf_ptr + pos + partial_length));
+        r = crypt_blocks(ctx, block_offset++, out_buf_ptr + pos,
+                         out_buf_ptr + pos, m_block_size);
+        pos += m_block_size;
       }
+    }
 
-      out_buf_ptr += crypto_output_length;
-      in_buf_ptr += crypto_input_length;
-      remaining_buf_bytes -= crypto_input_length;
-      remaining_block_bytes -= crypto_input_length;
+    if (r == 0) {
+      data->clear();
+      data->push_back(std::move(bp));
     }
   }
 
   m_data_cryptor->return_context(ctx, mode);
-
-  return 0;
+  return r;
 }
 
 template <typename T>
@@ -11,6 +11,8 @@
 namespace librbd {
 namespace crypto {
 
+// Encrypts whole blocks using the block number as IV. Decryption of a
+// contiguous buffer is done in place; encryption never modifies the input.
 template <typename T>
 class BlockCrypto : public CryptoInterface {
 
@@ -31,6 +33,8 @@ private:
     uint32_t m_block_size;
     uint32_t m_iv_size;
 
+    int crypt_blocks(T* ctx, uint64_t block_offset, const unsigned char* in,
+                     unsigned char* out, uint64_t length);
     int crypt(ceph::bufferlist* data, uint64_t image_offset, CipherMode mode);
 };
 
@@ -2,6 +2,7 @@
 // vim: ts=8 sw=2 smarttab
 
 #include "librbd/crypto/CryptoContextPool.h"
+#include <algorithm>
 
 namespace librbd {
 namespace crypto {
@@ -9,25 +10,29 @@ namespace crypto {
 template <typename T>
 CryptoContextPool<T>::CryptoContextPool(DataCryptor<T>* data_cryptor,
                                         uint32_t pool_size)
-     : m_data_cryptor(data_cryptor), m_encrypt_contexts(pool_size),
-       m_decrypt_contexts(pool_size) {
+     : m_data_cryptor(data_cryptor), m_pool_size(std::max(pool_size, 1U)),
+       m_encrypt_contexts(new Slot[m_pool_size]),
+       m_decrypt_contexts(new Slot[m_pool_size]) {
 }
 
 template <typename T>
 CryptoContextPool<T>::~CryptoContextPool() {
-  T* ctx;
-  while (m_encrypt_contexts.pop(ctx)) {
-    m_data_cryptor->return_context(ctx, CipherMode::CIPHER_MODE_ENC);
-  }
-  while (m_decrypt_contexts.pop(ctx)) {
-    m_data_cryptor->return_context(ctx, CipherMode::CIPHER_MODE_DEC);
+  for (uint32_t i = 0; i < m_pool_size; ++i) {
+    auto ctx = m_encrypt_contexts[i].ctx.exchange(nullptr);
+    if (ctx != nullptr) {
+      m_data_cryptor->return_context(ctx, CipherMode::CIPHER_MODE_ENC);
+    }
+    ctx = m_decrypt_contexts[i].ctx.exchange(nullptr);
+    if (ctx != nullptr) {
+      m_data_cryptor->return_context(ctx, CipherMode::CIPHER_MODE_DEC);
+    }
   }
 }
 
 template <typename T>
 T* CryptoContextPool<T>::get_context(CipherMode mode) {
-  T* ctx;
-  if (!get_contexts(mode).pop(ctx)) {
+  auto ctx = get_slot(mode).ctx.exchange(nullptr, std::memory_order_acquire);
+  if (ctx == nullptr) {
     ctx = m_data_cryptor->get_context(mode);
   }
   return ctx;
@@ -35,7 +40,10 @@ T* CryptoContextPool<T>::get_context(CipherMode mode) {
 
 template <typename T>
 void CryptoContextPool<T>::return_context(T* ctx, CipherMode mode) {
-  if (!get_contexts(mode).push(ctx)) {
+  T* expected = nullptr;
+  if (!get_slot(mode).ctx.compare_exchange_strong(
+        expected, ctx, std::memory_order_release,
+        std::memory_order_relaxed)) {
     m_data_cryptor->return_context(ctx, mode);
   }
 }
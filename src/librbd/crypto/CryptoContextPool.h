@@ -5,13 +5,18 @@
 #define CEPH_LIBRBD_CRYPTO_CRYPTO_CONTEXT_POOL_H
 
 #include "librbd/crypto/DataCryptor.h"
-#include "common/allocator.h"
 #include "include/ceph_assert.h"
-#include <boost/lockfree/queue.hpp>
+#include <atomic>
+#include <memory>
 
 namespace librbd {
 namespace crypto {
 
+/*
+ * Caches up to pool_size contexts per cipher mode. Each thread maps to a
+ * fixed slot so that concurrent threads do not contend on a shared queue;
+ * a context is only shared between threads that map to the same slot.
+ */
 template <typename T>
 class CryptoContextPool : public DataCryptor<T>  {
 
@@ -38,23 +43,31 @@ public:
       return m_data_cryptor->update_context(ctx, in, out, len);
     }
 
-    typedef boost::lockfree::queue<
-            T*,
-            boost::lockfree::allocator<ceph::allocator<void>>> ContextQueue;
-
 private:
+    struct alignas(64) Slot {
+      std::atomic<T*> ctx = {nullptr};
+    };
+
     DataCryptor<T>* m_data_cryptor;
-    ContextQueue m_encrypt_contexts;
-    ContextQueue m_decrypt_contexts;
+    uint32_t m_pool_size;
+    std::unique_ptr<Slot[]> m_encrypt_contexts;
+    std::unique_ptr<Slot[]> m_decrypt_contexts;
+
+    static uint32_t get_thread_index() {
+      static std::atomic<uint32_t> next_thread_index = {0};
+      static thread_local uint32_t thread_index = next_thread_index++;
+      return thread_index;
+    }
 
-    inline ContextQueue& get_contexts(CipherMode mode) {
+    inline Slot& get_slot(CipherMode mode) {
+      auto index = get_thread_index() % m_pool_size;
       switch(mode) {
         case CIPHER_MODE_ENC:
-          return m_encrypt_contexts;
+          return m_encrypt_contexts[index];
         case CIPHER_MODE_DEC:
-          return m_decrypt_contexts;
+          return m_decrypt_contexts[index];
         default:
-          ceph_assert(false);
+          ceph_abort();
       }
     }
 };
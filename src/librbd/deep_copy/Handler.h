@@ -5,6 +5,7 @@
 #define CEPH_LIBRBD_DEEP_COPY_HANDLER_H
 
 #include "include/int_types.h"
+#include "include/Context.h"
 #include "include/rbd/librbd.hpp"
 
 namespace librbd {
@@ -17,6 +18,13 @@ struct Handler {
 
   virtual int update_progress(uint64_t object_number,
                               uint64_t object_count) = 0;
+
+  // invoked before reading 'bytes' from the source image so that the
+  // caller can rate-limit the copy: 'on_ready' must be completed when the
+  // read may proceed
+  virtual void throttle_read(uint64_t bytes, Context* on_ready) {
+    on_ready->complete(0);
+  }
 };
 
 struct NoOpHandler : public Handler {
@@ -137,6 +137,36 @@ void ObjectCopyRequest<I>::send_read() {
     return;
   }
 
+  if (m_handler != nullptr) {
+    ldout(m_cct, 20) << "throttle: bytes=" << read_op.image_interval.size()
+                     << dendl;
+    auto ctx = create_context_callback<
+      ObjectCopyRequest<I>, &ObjectCopyRequest<I>::handle_throttle_read>(this);
+    m_handler->throttle_read(read_op.image_interval.size(), ctx);
+    return;
+  }
+
+  send_read_object();
+}
+
+template <typename I>
+void ObjectCopyRequest<I>::handle_throttle_read(int r) {
+  ldout(m_cct, 20) << "r=" << r << dendl;
+
+  if (r < 0) {
+    lderr(m_cct) << "failed to throttle read: " << cpp_strerror(r) << dendl;
+    finish(r);
+    return;
+  }
+
+  send_read_object();
+}
+
+template <typename I>
+void ObjectCopyRequest<I>::send_read_object() {
+  auto index = *m_read_snaps.begin();
+  auto& read_op = m_read_ops[index];
+
   auto io_context = m_src_image_ctx->duplicate_data_io_context();
   io_context->read_snap(index.second);
 
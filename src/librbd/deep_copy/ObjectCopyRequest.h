@@ -66,10 +66,13 @@ private:
    *    v
    * LIST_SNAPS
    *    |
-   *    |/---------\
-   *    |          | (repeat for each snapshot)
-   *    v          |
-   * READ ---------/
+   *    |/-------------\
+   *    |              | (repeat for each snapshot)
+   *    v              |
+   * THROTTLE_READ     | (skip if no handler)
+   *    |              |
+   *    v              |
+   * READ -------------/
    *    |
    *    |     /-----------\
    *    |     |           | (repeat for each snapshot)
@@ -134,6 +137,8 @@ private:
   void handle_list_snaps(int r);
 
   void send_read();
+  void handle_throttle_read(int r);
+  void send_read_object();
   void handle_read(int r);
 
   void send_update_object_map();
@@ -10,6 +10,7 @@
 #include "librbd/PluginRegistry.h"
 #include "librbd/Utils.h"
 #include "librbd/cache/ObjectCacherObjectDispatch.h"
+#include "librbd/cache/ReadCacheObjectDispatch.h"
 #include "librbd/cache/WriteAroundObjectDispatch.h"
 #include "librbd/image/CloseRequest.h"
 #include "librbd/image/RefreshRequest.h"
@@ -558,6 +559,22 @@ Context* OpenRequest<I>::handle_init_plugin_registry(int *result) {
 
 template <typename I>
 Context *OpenRequest<I>::send_init_cache(int *result) {
+  if (m_image_ctx->child == nullptr && m_image_ctx->data_ctx.is_valid() &&
+      m_image_ctx->config.template get_val<bool>("rbd_read_cache_enabled")) {
+    auto read_cache = cache::ReadCacheObjectDispatch<I>::create(
+      m_image_ctx,
+      m_image_ctx->config.template get_val<std::string>("rbd_read_cache_path"),
+      m_image_ctx->config.template get_val<Option::size_t>(
+        "rbd_read_cache_size"));
+    int r = read_cache->init();
+    if (r < 0) {
+      // the read cache is optional
+      lderr(m_image_ctx->cct) << "failed to initialize read cache: "
+                              << cpp_strerror(r) << dendl;
+      delete read_cache;
+    }
+  }
+
   if (!m_image_ctx->cache || m_image_ctx->child != nullptr ||
       !m_image_ctx->data_ctx.is_valid()) {
     return send_register_watch(result);
@@ -33,6 +33,9 @@ using librbd::util::data_object_name;
 
 static const int LATENCY_STATS_WINDOW_SIZE = 10;
 
+// delay writes for up to this many write inter-arrival times
+static const uint64_t ADAPTIVE_DELAY_WRITES = 4;
+
 class LatencyStats {
 private:
   accumulator_set<uint64_t, stats<tag::rolling_count, tag::rolling_sum>> m_acc;
@@ -54,7 +57,7 @@ public:
     auto count = rolling_count(m_acc);
 
     if (count > 0) {
-      return rolling_sum(m_acc);
+      return rolling_sum(m_acc) / count;
     }
     return 0;
   }
@@ -73,6 +76,7 @@ bool SimpleSchedulerObjectDispatch<I>::ObjectRequests::try_delay_request(
   } else {
     m_io_context = io_context;
     m_op_flags = op_flags;
+    m_delay_start_time = ceph::real_clock::now();
   }
 
   if (data.length() == 0) {
@@ -146,9 +150,15 @@ void SimpleSchedulerObjectDispatch<I>::ObjectRequests::try_merge_delayed_request
 template <typename I>
 void SimpleSchedulerObjectDispatch<I>::ObjectRequests::dispatch_delayed_requests(
     I *image_ctx, LatencyStats *latency_stats, ceph::mutex *latency_stats_lock) {
+  if (!m_delayed_requests.empty()) {
+    image_ctx->perfcounter->tinc(l_librbd_io_scheduler_delay,
+                                 ceph::real_clock::now() - m_delay_start_time);
+  }
+
   for (auto &it : m_delayed_requests) {
     auto offset = it.first;
     auto &merged_requests = it.second;
+    image_ctx->perfcounter->inc(l_librbd_io_scheduler_dispatched_writes);
 
     auto ctx = new LambdaContext(
         [requests=std::move(merged_requests.requests), latency_stats,
@@ -272,13 +282,16 @@ bool SimpleSchedulerObjectDispatch<I>::write(
   // don't try to batch assert version writes
   if (assert_version.has_value() ||
       (write_flags & OBJECT_WRITE_FLAG_CREATE_EXCLUSIVE) != 0) {
+    std::lock_guard locker{m_lock};
     dispatch_delayed_requests(object_no);
     return false;
   }
 
   std::lock_guard locker{m_lock};
+  update_write_interval();
   if (try_delay_write(object_no, object_off, std::move(data), io_context,
                       op_flags, *object_dispatch_flags, on_dispatched)) {
+    m_image_ctx->perfcounter->inc(l_librbd_io_scheduler_delayed_writes);
 
     auto dispatch_seq = ++m_dispatch_seq;
     m_flush_tracker->start_io(dispatch_seq);
@@ -390,6 +403,12 @@ bool SimpleSchedulerObjectDispatch<I>::try_delay_write(
   }
 
   auto &object_requests = it->second;
+  auto delay = get_delay();
+  if (delay == 0 && !object_requests->is_scheduled_dispatch()) {
+    ldout(cct, 20) << "writes too sparse to merge" << dendl;
+    return false;
+  }
+
   bool delayed = object_requests->try_delay_request(
       object_off, std::move(data), io_context, op_flags, object_dispatch_flags,
       on_dispatched);
@@ -398,12 +417,7 @@ bool SimpleSchedulerObjectDispatch<I>::try_delay_write(
 
   // schedule dispatch on the first request added
   if (delayed && !object_requests->is_scheduled_dispatch()) {
-    auto dispatch_time = ceph::real_clock::now();
-    if (m_latency_stats) {
-      dispatch_time += std::chrono::nanoseconds(m_latency_stats->avg() / 2);
-    } else {
-      dispatch_time += std::chrono::milliseconds(m_max_delay);
-    }
+    auto dispatch_time = Clock::now() + std::chrono::nanoseconds(delay);
     object_requests->set_scheduled_dispatch(dispatch_time);
     m_dispatch_queue.push_back(object_requests);
     if (m_dispatch_queue.front() == object_requests) {
@@ -414,6 +428,47 @@ bool SimpleSchedulerObjectDispatch<I>::try_delay_write(
   return delayed;
 }
 
+template <typename I>
+void SimpleSchedulerObjectDispatch<I>::update_write_interval() {
+  ceph_assert(ceph_mutex_is_locked(m_lock));
+
+  auto now = Clock::now();
+  if (m_last_write_time != typename Clock::time_point{}) {
+    uint64_t interval = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      now - m_last_write_time).count();
+    if (m_write_interval == 0) {
+      m_write_interval = std::max<uint64_t>(interval, 1);
+    } else {
+      // exponentially weighted moving average
+      m_write_interval = std::max<uint64_t>(
+        (m_write_interval * 7 + interval) / 8, 1);
+    }
+  }
+  m_last_write_time = now;
+}
+
+template <typename I>
+uint64_t SimpleSchedulerObjectDispatch<I>::get_delay() const {
+  ceph_assert(ceph_mutex_is_locked(m_lock));
+
+  uint64_t max_delay;
+  if (m_latency_stats) {
+    max_delay = m_latency_stats->avg() / 2;
+  } else {
+    max_delay = m_max_delay * 1000000;
+  }
+
+  if (m_write_interval == 0) {
+    return max_delay;
+  } else if (m_write_interval >= max_delay) {
+    // the next write is not expected before the delay expires
+    return 0;
+  }
+
+  // wait for a few more writes under streaming load
+  return std::min(max_delay, m_write_interval * ADAPTIVE_DELAY_WRITES);
+}
+
 template <typename I>
 void SimpleSchedulerObjectDispatch<I>::dispatch_all_delayed_requests() {
   ceph_assert(ceph_mutex_is_locked(m_lock));
@@ -504,6 +559,29 @@ void SimpleSchedulerObjectDispatch<I>::dispatch_delayed_requests(
   }
 }
 
+template <typename I>
+void SimpleSchedulerObjectDispatch<I>::dispatch_due_delayed_requests(
+    uint64_t object_no) {
+  ceph_assert(ceph_mutex_is_locked(m_lock));
+  auto cct = m_image_ctx->cct;
+
+  // dispatch everything that is due with a single timer run
+  std::set<uint64_t> object_nos = {object_no};
+  auto now = Clock::now();
+  for (auto& object_requests : m_dispatch_queue) {
+    if (object_requests->is_scheduled_dispatch() &&
+        object_requests->get_dispatch_time() <= now) {
+      object_nos.insert(object_requests->get_object_no());
+    }
+  }
+
+  ldout(cct, 20) << "dispatching " << object_nos.size() << " objects"
+                 << dendl;
+  for (auto object_no : object_nos) {
+    dispatch_delayed_requests(object_no);
+  }
+}
+
 template <typename I>
 void SimpleSchedulerObjectDispatch<I>::schedule_dispatch_delayed_requests() {
   ceph_assert(ceph_mutex_is_locked(m_lock));
@@ -547,7 +625,7 @@ void SimpleSchedulerObjectDispatch<I>::schedule_dispatch_delayed_requests() {
       m_image_ctx->asio_engine->post(
         [this, object_no]() {
           std::lock_guard locker{m_lock};
-          dispatch_delayed_requests(object_no);
+          dispatch_due_delayed_requests(object_no);
         });
     });
 
@@ -14,6 +14,7 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <set>
 
 namespace librbd {
 
@@ -33,6 +34,7 @@ private:
   // mock unit testing support
   typedef ::librbd::io::TypeTraits<ImageCtxT> TypeTraits;
   typedef typename TypeTraits::SafeTimer SafeTimer;
+  typedef typename TypeTraits::Clock Clock;
 public:
   static SimpleSchedulerObjectDispatch* create(ImageCtxT* image_ctx) {
     return new SimpleSchedulerObjectDispatch(image_ctx);
@@ -174,6 +176,7 @@ private:
     uint64_t m_object_no;
     uint64_t m_dispatch_seq = 0;
     clock_t::time_point m_dispatch_time;
+    clock_t::time_point m_delay_start_time;
     IOContext m_io_context;
     int m_op_flags = 0;
     int m_object_dispatch_flags = 0;
@@ -197,6 +200,8 @@ private:
   ceph::mutex *m_timer_lock;
   uint64_t m_max_delay;
   uint64_t m_dispatch_seq = 0;
+  typename Clock::time_point m_last_write_time;
+  uint64_t m_write_interval = 0; // ns, moving average
 
   Requests m_requests;
   std::list<ObjectRequestsRef> m_dispatch_queue;
@@ -209,9 +214,13 @@ private:
                        Context* on_dispatched);
   bool intersects(uint64_t object_no, uint64_t object_off, uint64_t len) const;
 
+  void update_write_interval();
+  uint64_t get_delay() const;
+
   void dispatch_all_delayed_requests();
   void dispatch_delayed_requests(uint64_t object_no);
   void dispatch_delayed_requests(ObjectRequestsRef object_requests);
+  void dispatch_due_delayed_requests(uint64_t object_no);
   void register_in_flight_request(uint64_t object_no, const utime_t &start_time,
                                   Context** on_finish);
 
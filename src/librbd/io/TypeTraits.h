@@ -4,6 +4,8 @@
 #ifndef CEPH_LIBRBD_IO_TYPE_TRAITS_H
 #define CEPH_LIBRBD_IO_TYPE_TRAITS_H
 
+#include "common/ceph_time.h"
+
 class SafeTimer;
 
 namespace librbd {
@@ -12,6 +14,7 @@ namespace io {
 template <typename IoCtxT>
 struct TypeTraits {
   typedef ::SafeTimer SafeTimer;
+  typedef ceph::real_clock Clock;
 };
 
 } // namespace io
@@ -101,6 +101,7 @@ enum ObjectDispatchLayer {
   OBJECT_DISPATCH_LAYER_CACHE,
   OBJECT_DISPATCH_LAYER_CRYPTO,
   OBJECT_DISPATCH_LAYER_JOURNAL,
+  OBJECT_DISPATCH_LAYER_READ_CACHE,
   OBJECT_DISPATCH_LAYER_PARENT_CACHE,
   OBJECT_DISPATCH_LAYER_SCHEDULER,
   OBJECT_DISPATCH_LAYER_CORE,
@@ -0,0 +1,925 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "librbd/migration/HttpClient.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include "include/stringify.h"
+#include "librbd/AsioEngine.h"
+#include "librbd/ImageCtx.h"
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/ssl/error.hpp>
+#include <boost/asio/ssl/rfc2818_verification.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/http/parser.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/status.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/beast/ssl/ssl_stream.hpp>
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <openssl/err.h>
+
+namespace librbd {
+namespace migration {
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::migration::HttpClient: " << this \
+                           << " " << __func__ << ": "
+
+namespace http = boost::beast::http;
+
+namespace {
+
+const std::chrono::seconds IO_TIMEOUT{60};
+
+// upper bound on the size of a single range request so that large reads
+// are spread over the available connections
+const uint64_t MAX_RANGE_REQUEST_SIZE = 4 << 20;
+
+int get_error(const boost::system::error_code& ec) {
+  if (ec == boost::beast::error::timeout) {
+    return -ETIMEDOUT;
+  } else if (ec == boost::asio::error::operation_aborted) {
+    return -ECANCELED;
+  } else if (ec.category() == boost::system::system_category()) {
+    return -ec.value();
+  }
+  return -EIO;
+}
+
+int get_http_error(http::status status) {
+  if (http::to_status_class(status) == http::status_class::successful) {
+    return 0;
+  }
+
+  switch (status) {
+  case http::status::not_found:
+    return -ENOENT;
+  case http::status::unauthorized:
+  case http::status::forbidden:
+    return -EACCES;
+  case http::status::range_not_satisfiable:
+    return -ERANGE;
+  default:
+    return -EIO;
+  }
+}
+
+} // anonymous namespace
+
+template <typename I>
+struct HttpClient<I>::Work {
+  Request request;
+  Completion completion;
+  // range requests are bounded by the requested length
+  uint64_t body_limit = std::numeric_limits<uint64_t>::max();
+
+  Work(Request&& request, Completion&& completion)
+    : request(std::move(request)), completion(std::move(completion)) {
+  }
+};
+
+template <typename I>
+struct HttpClient<I>::SessionBase {
+  bool busy = false;
+
+  virtual ~SessionBase() {
+  }
+
+  virtual void start(WorkRef&& work) = 0;
+  virtual void shut_down() = 0;
+};
+
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::migration::HttpClient::HttpSession " \
+                           << this << " " << __func__ << ": "
+
+template <typename I>
+template <typename D>
+struct HttpClient<I>::HttpSession : public SessionBase {
+  HttpClient* http_client;
+  boost::asio::ip::tcp::resolver resolver;
+  boost::beast::flat_buffer buffer;
+  std::optional<http::response_parser<StringBody>> parser;
+
+  WorkRef work;
+  bool connected = false;
+  uint64_t completed_requests = 0;
+
+  HttpSession(HttpClient* http_client)
+    : http_client(http_client),
+      resolver(http_client->m_asio_engine->get_io_context()) {
+  }
+
+  D& derived() {
+    return static_cast<D&>(*this);
+  }
+
+  void start(WorkRef&& w) override {
+    ceph_assert(!this->busy);
+    this->busy = true;
+    work = std::move(w);
+
+    if (connected) {
+      send();
+    } else {
+      resolve();
+    }
+  }
+
+  void shut_down() override {
+    ceph_assert(!this->busy);
+    disconnect();
+  }
+
+  void resolve() {
+    auto cct = http_client->m_cct;
+    auto& url_spec = http_client->m_url_spec;
+    ldout(cct, 15) << "host=" << url_spec.host << ", port=" << url_spec.port
+                   << dendl;
+
+    resolver.async_resolve(
+      url_spec.host, url_spec.port,
+      boost::asio::bind_executor(
+        http_client->m_strand,
+        [this](boost::system::error_code ec,
+               boost::asio::ip::tcp::resolver::results_type results) {
+          handle_resolve(ec, results);
+        }));
+  }
+
+  void handle_resolve(boost::system::error_code ec,
+                      boost::asio::ip::tcp::resolver::results_type results) {
+    auto cct = http_client->m_cct;
+    if (ec) {
+      lderr(cct) << "failed to resolve host '"
+                 << http_client->m_url_spec.host << "': " << ec.message()
+                 << dendl;
+      complete(get_error(ec), {});
+      return;
+    }
+
+    derived().connect(results, [this](boost::system::error_code ec) {
+        handle_connect(ec);
+      });
+  }
+
+  void handle_connect(boost::system::error_code ec) {
+    auto cct = http_client->m_cct;
+    if (ec) {
+      lderr(cct) << "failed to connect to host '"
+                 << http_client->m_url_spec.host << "': " << ec.message()
+                 << dendl;
+      disconnect();
+      complete(get_error(ec), {});
+      return;
+    }
+
+    ldout(cct, 15) << "connected" << dendl;
+    connected = true;
+    completed_requests = 0;
+    send();
+  }
+
+  void send() {
+    auto cct = http_client->m_cct;
+    ldout(cct, 20) << "request=" << work->request.method() << " "
+                   << work->request.target() << dendl;
+
+    boost::beast::get_lowest_layer(derived().get_stream()).expires_after(
+      IO_TIMEOUT);
+    http::async_write(
+      derived().get_stream(), work->request,
+      boost::asio::bind_executor(
+        http_client->m_strand,
+        [this](boost::system::error_code ec, std::size_t) {
+          handle_send(ec);
+        }));
+  }
+
+  void handle_send(boost::system::error_code ec) {
+    if (ec) {
+      handle_io_error(ec, "send request");
+      return;
+    }
+
+    receive();
+  }
+
+  void receive() {
+    parser.emplace();
+    parser->body_limit(work->body_limit);
+    if (work->request.method() == http::verb::head) {
+      // HEAD responses carry a content-length but no body
+      parser->skip(true);
+    }
+
+    boost::beast::get_lowest_layer(derived().get_stream()).expires_after(
+      IO_TIMEOUT);
+    http::async_read(
+      derived().get_stream(), buffer, *parser,
+      boost::asio::bind_executor(
+        http_client->m_strand,
+        [this](boost::system::error_code ec, std::size_t) {
+          handle_receive(ec);
+        }));
+  }
+
+  void handle_receive(boost::system::error_code ec) {
+    auto cct = http_client->m_cct;
+    if (ec == http::error::body_limit) {
+      // the rest of the body is still in the stream: drop the connection
+      lderr(cct) << "response from '" << http_client->m_url_spec.host
+                 << "' exceeds the requested " << work->body_limit
+                 << " bytes: status=" << parser->get().result_int() << dendl;
+      parser.reset();
+      disconnect();
+      complete(-EIO, {});
+      return;
+    } else if (ec) {
+      handle_io_error(ec, "receive response");
+      return;
+    }
+
+    auto response = parser->release();
+    parser.reset();
+    ++completed_requests;
+
+    ldout(cct, 20) << "status=" << response.result_int() << ", "
+                   << "content_length=" << response.body().size() << dendl;
+    if (!response.keep_alive()) {
+      disconnect();
+    }
+
+    int r = get_http_error(response.result());
+    if (r < 0) {
+      lderr(cct) << "HTTP request failed: " << response.result_int() << " "
+                 << response.reason() << dendl;
+    }
+    complete(r, std::move(response));
+  }
+
+  void handle_io_error(boost::system::error_code ec, const char* action) {
+    auto cct = http_client->m_cct;
+
+    // the server might have dropped an idle keep-alive connection while the
+    // request was in flight: retry once on a new connection
+    bool retry = (completed_requests > 0 &&
+                  ec != boost::asio::error::operation_aborted &&
+                  ec != boost::beast::error::timeout);
+    disconnect();
+    if (retry) {
+      ldout(cct, 5) << "failed to " << action << " on reused connection, "
+                    << "reconnecting: " << ec.message() << dendl;
+      resolve();
+      return;
+    }
+
+    lderr(cct) << "failed to " << action << ": " << ec.message() << dendl;
+    complete(get_error(ec), {});
+  }
+
+  void disconnect() {
+    if (connected) {
+      ldout(http_client->m_cct, 15) << dendl;
+    }
+    connected = false;
+    completed_requests = 0;
+    buffer.clear();
+    derived().close_stream();
+  }
+
+  void complete(int r, Response&& response) {
+    auto w = std::move(work);
+    this->busy = false;
+
+    w->completion(r, std::move(response));
+    http_client->handle_session_idle(this);
+  }
+};
+
+template <typename I>
+struct HttpClient<I>::PlainHttpSession
+  : public HttpSession<PlainHttpSession> {
+  typedef HttpSession<PlainHttpSession> Base;
+  std::optional<boost::beast::tcp_stream> stream;
+
+  PlainHttpSession(HttpClient* http_client) : Base(http_client) {
+  }
+
+  boost::beast::tcp_stream& get_stream() {
+    return *stream;
+  }
+
+  template <typename C>
+  void connect(boost::asio::ip::tcp::resolver::results_type results,
+               C&& on_finish) {
+    auto http_client = this->http_client;
+    stream.emplace(http_client->m_asio_engine->get_io_context());
+    stream->expires_after(IO_TIMEOUT);
+    stream->async_connect(
+      results,
+      boost::asio::bind_executor(
+        http_client->m_strand,
+        [on_finish=std::move(on_finish)](
+            boost::system::error_code ec,
+            const boost::asio::ip::tcp::endpoint&) {
+          on_finish(ec);
+        }));
+  }
+
+  void close_stream() {
+    if (stream) {
+      boost::system::error_code ec;
+      stream->socket().shutdown(boost::asio::ip::tcp::socket::shutdown_both,
+                                ec);
+      stream->close();
+      stream.reset();
+    }
+  }
+};
+
+template <typename I>
+struct HttpClient<I>::SslHttpSession
+  : public HttpSession<SslHttpSession> {
+  typedef HttpSession<SslHttpSession> Base;
+  std::optional<boost::beast::ssl_stream<boost::beast::tcp_stream>> stream;
+
+  SslHttpSession(HttpClient* http_client) : Base(http_client) {
+  }
+
+  boost::beast::ssl_stream<boost::beast::tcp_stream>& get_stream() {
+    return *stream;
+  }
+
+  template <typename C>
+  void connect(boost::asio::ip::tcp::resolver::results_type results,
+               C&& on_finish) {
+    auto http_client = this->http_client;
+    auto& host = http_client->m_url_spec.host;
+    stream.emplace(http_client->m_asio_engine->get_io_context(),
+                   http_client->m_ssl_context);
+
+    // SNI and server certificate host name verification
+    if (!SSL_set_tlsext_host_name(stream->native_handle(), host.c_str())) {
+      on_finish(boost::system::error_code{
+        static_cast<int>(::ERR_get_error()),
+        boost::asio::error::get_ssl_category()});
+      return;
+    }
+    stream->set_verify_callback(
+      boost::asio::ssl::rfc2818_verification(host));
+
+    auto& tcp_stream = boost::beast::get_lowest_layer(*stream);
+    tcp_stream.expires_after(IO_TIMEOUT);
+    tcp_stream.async_connect(
+      results,
+      boost::asio::bind_executor(
+        http_client->m_strand,
+        [this, on_finish=std::move(on_finish)](
+            boost::system::error_code ec,
+            const boost::asio::ip::tcp::endpoint&) mutable {
+          if (ec) {
+            on_finish(ec);
+            return;
+          }
+          handshake(std::move(on_finish));
+        }));
+  }
+
+  template <typename C>
+  void handshake(C&& on_finish) {
+    boost::beast::get_lowest_layer(*stream).expires_after(IO_TIMEOUT);
+    stream->async_handshake(
+      boost::asio::ssl::stream_base::client,
+      boost::asio::bind_executor(
+        this->http_client->m_strand,
+        [on_finish=std::move(on_finish)](boost::system::error_code ec) {
+          on_finish(ec);
+        }));
+  }
+
+  void close_stream() {
+    if (stream) {
+      // skip the TLS close_notify exchange since the connection is not reused
+      boost::beast::get_lowest_layer(*stream).close();
+      stream.reset();
+    }
+  }
+};
+
+template <typename I>
+struct HttpClient<I>::Block {
+  bool loading = true;
+  bufferlist bl;
+  std::list<uint64_t>::iterator lru_it;
+  std::list<ReadRequest*> waiters;
+};
+
+template <typename I>
+struct HttpClient<I>::ReadRequest {
+  io::Extents byte_extents;
+  bufferlist* data;
+  Context* on_finish;
+
+  std::map<uint64_t, BlockRef> blocks;
+  uint32_t pending = 0;
+  int r = 0;
+
+  ReadRequest(io::Extents&& byte_extents, bufferlist* data,
+              Context* on_finish)
+    : byte_extents(std::move(byte_extents)), data(data),
+      on_finish(on_finish) {
+  }
+};
+
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::migration::HttpClient: " << this \
+                           << " " << __func__ << ": "
+
+template <typename I>
+HttpClient<I>::HttpClient(I* image_ctx, const std::string& url)
+  : m_cct(image_ctx->cct), m_asio_engine(image_ctx->asio_engine), m_url(url),
+    m_strand(*m_asio_engine),
+    m_ssl_context(boost::asio::ssl::context::sslv23_client),
+    m_max_sessions(image_ctx->config.template get_val<uint64_t>(
+      "rbd_migration_http_max_connections")),
+    m_block_size(image_ctx->config.template get_val<Option::size_t>(
+      "rbd_migration_http_block_size")),
+    m_cache_size(image_ctx->config.template get_val<Option::size_t>(
+      "rbd_migration_http_cache_size")),
+    m_prefetch_blocks(image_ctx->config.template get_val<uint64_t>(
+      "rbd_migration_http_prefetch_blocks")) {
+  m_ssl_context.set_options(
+    boost::asio::ssl::context::default_workarounds |
+    boost::asio::ssl::context::no_sslv2 |
+    boost::asio::ssl::context::no_sslv3);
+}
+
+template <typename I>
+HttpClient<I>::~HttpClient() {
+  ceph_assert(is_idle());
+}
+
+template <typename I>
+void HttpClient<I>::open(Context* on_finish) {
+  ldout(m_cct, 10) << "url=" << m_url << dendl;
+
+  int r = util::parse_url(m_cct, m_url, &m_url_spec);
+  if (r < 0) {
+    on_finish->complete(r);
+    return;
+  }
+
+  if (m_url_spec.scheme == util::URL_SCHEME_HTTPS) {
+    boost::system::error_code ec;
+    m_ssl_context.set_default_verify_paths(ec);
+    if (ec) {
+      lderr(m_cct) << "failed to load default CA certificates: "
+                   << ec.message() << dendl;
+      on_finish->complete(-EINVAL);
+      return;
+    }
+    m_ssl_context.set_verify_mode(boost::asio::ssl::verify_peer);
+  }
+
+  // the object size is needed to clamp the block ranges
+  issue(create_request(http::verb::head),
+        [this, on_finish](int r, Response&& response) {
+          handle_open(r, std::move(response), on_finish);
+        });
+}
+
+template <typename I>
+void HttpClient<I>::handle_open(int r, Response&& response,
+                                Context* on_finish) {
+  ldout(m_cct, 10) << "r=" << r << dendl;
+
+  if (r < 0) {
+    lderr(m_cct) << "failed to retrieve size of '" << m_url << "': "
+                 << cpp_strerror(r) << dendl;
+    on_finish->complete(r);
+    return;
+  }
+
+  auto content_length = response.find(http::field::content_length);
+  if (content_length == response.end()) {
+    lderr(m_cct) << "server did not provide the size of '" << m_url << "'"
+                 << dendl;
+    on_finish->complete(-EINVAL);
+    return;
+  }
+
+  try {
+    m_size = boost::lexical_cast<uint64_t>(content_length->value());
+  } catch (boost::bad_lexical_cast&) {
+    lderr(m_cct) << "invalid content length: " << content_length->value()
+                 << dendl;
+    on_finish->complete(-EINVAL);
+    return;
+  }
+
+  ldout(m_cct, 10) << "size=" << m_size << dendl;
+  on_finish->complete(0);
+}
+
+template <typename I>
+void HttpClient<I>::close(Context* on_finish) {
+  ldout(m_cct, 10) << dendl;
+
+  boost::asio::post(m_strand, [this, on_finish]() {
+      ceph_assert(m_on_close == nullptr);
+      m_on_close = on_finish;
+
+      auto work_queue = std::move(m_work_queue);
+      for (auto& work : work_queue) {
+        work->completion(-ESHUTDOWN, {});
+      }
+
+      maybe_finish_close();
+    });
+}
+
+template <typename I>
+void HttpClient<I>::get_size(uint64_t* size, Context* on_finish) {
+  ldout(m_cct, 10) << dendl;
+
+  *size = m_size;
+  on_finish->complete(0);
+}
+
+template <typename I>
+void HttpClient<I>::read(io::Extents&& byte_extents, bufferlist* data,
+                         Context* on_finish) {
+  ldout(m_cct, 20) << "byte_extents=" << byte_extents << dendl;
+
+  auto read_request = new ReadRequest(std::move(byte_extents), data,
+                                      on_finish);
+  boost::asio::post(m_strand, [this, read_request]() {
+      start_read(read_request);
+    });
+}
+
+template <typename I>
+void HttpClient<I>::issue(Request&& request, Completion&& completion) {
+  auto work = std::make_shared<Work>(std::move(request),
+                                     std::move(completion));
+  boost::asio::post(m_strand, [this, work=std::move(work)]() mutable {
+      queue_work(std::move(work));
+    });
+}
+
+template <typename I>
+typename HttpClient<I>::Request HttpClient<I>::create_request(
+    http::verb verb) const {
+  Request request;
+  request.method(verb);
+  request.target(m_url_spec.path);
+  request.version(11);
+  request.set(http::field::host, m_url_spec.host);
+  request.set(http::field::user_agent, "ceph-librbd");
+  request.keep_alive(true);
+  return request;
+}
+
+template <typename I>
+void HttpClient<I>::queue_work(WorkRef&& work) {
+  if (m_on_close != nullptr) {
+    work->completion(-ESHUTDOWN, {});
+    return;
+  }
+
+  if (m_http_processor != nullptr) {
+    m_http_processor->process_request(work->request);
+  }
+
+  m_work_queue.push_back(std::move(work));
+  dispatch_work();
+}
+
+template <typename I>
+void HttpClient<I>::dispatch_work() {
+  while (!m_work_queue.empty()) {
+    SessionBase* session = nullptr;
+    for (auto& s : m_sessions) {
+      if (!s->busy) {
+        session = s.get();
+        break;
+      }
+    }
+
+    if (session == nullptr) {
+      if (m_sessions.size() >= m_max_sessions) {
+        break;
+      }
+
+      ldout(m_cct, 15) << "creating session " << m_sessions.size() << dendl;
+      if (m_url_spec.scheme == util::URL_SCHEME_HTTPS) {
+        m_sessions.emplace_back(new SslHttpSession(this));
+      } else {
+        m_sessions.emplace_back(new PlainHttpSession(this));
+      }
+      session = m_sessions.back().get();
+    }
+
+    auto work = std::move(m_work_queue.front());
+    m_work_queue.pop_front();
+    session->start(std::move(work));
+  }
+}
+
+template <typename I>
+void HttpClient<I>::handle_session_idle(SessionBase* session) {
+  if (m_on_close != nullptr) {
+    maybe_finish_close();
+    return;
+  }
+
+  dispatch_work();
+}
+
+template <typename I>
+bool HttpClient<I>::is_idle() const {
+  return std::none_of(m_sessions.begin(), m_sessions.end(),
+                      [](auto& session) { return session->busy; });
+}
+
+template <typename I>
+void HttpClient<I>::maybe_finish_close() {
+  if (!is_idle()) {
+    return;
+  }
+
+  ldout(m_cct, 10) << dendl;
+  for (auto& session : m_sessions) {
+    session->shut_down();
+  }
+
+  m_blocks.clear();
+  m_lru.clear();
+  m_cached_bytes = 0;
+
+  auto on_finish = m_on_close;
+  on_finish->complete(0);
+}
+
+template <typename I>
+void HttpClient<I>::start_read(ReadRequest* read_request) {
+  if (m_on_close != nullptr) {
+    read_request->r = -ESHUTDOWN;
+    finish_read(read_request);
+    return;
+  }
+
+  std::vector<uint64_t> missing_blocks;
+  uint64_t first_block = std::numeric_limits<uint64_t>::max();
+  uint64_t last_block = 0;
+  for (auto [offset, length] : read_request->byte_extents) {
+    if (length == 0) {
+      continue;
+    } else if (offset + length > m_size) {
+      lderr(m_cct) << "read " << offset << "~" << length << " beyond end "
+                   << "of stream" << dendl;
+      read_request->r = -ERANGE;
+      break;
+    }
+
+    auto start = offset / m_block_size;
+    auto end = (offset + length - 1) / m_block_size;
+    first_block = std::min(first_block, start);
+    last_block = std::max(last_block, end);
+    for (auto index = start; index <= end; ++index) {
+      if (read_request->blocks.count(index) != 0) {
+        continue;
+      }
+
+      auto& block = m_blocks[index];
+      if (!block) {
+        block = std::make_shared<Block>();
+        missing_blocks.push_back(index);
+      } else if (!block->loading) {
+        m_lru.splice(m_lru.end(), m_lru, block->lru_it);
+      }
+
+      if (block->loading) {
+        block->waiters.push_back(read_request);
+        ++read_request->pending;
+      }
+      read_request->blocks[index] = block;
+    }
+  }
+
+  ldout(m_cct, 20) << "read_request=" << read_request << ", "
+                   << "blocks=" << read_request->blocks.size() << ", "
+                   << "missing=" << missing_blocks.size() << ", "
+                   << "pending=" << read_request->pending << dendl;
+
+  fetch_blocks(std::move(missing_blocks));
+  if (read_request->r == 0 && !read_request->blocks.empty()) {
+    prefetch_blocks(first_block, last_block);
+  }
+
+  if (read_request->pending == 0) {
+    finish_read(read_request);
+  }
+}
+
+template <typename I>
+void HttpClient<I>::finish_read(ReadRequest* read_request) {
+  int r = read_request->r;
+  ldout(m_cct, 20) << "read_request=" << read_request << ", r=" << r
+                   << dendl;
+
+  auto data = read_request->data;
+  data->clear();
+  if (r == 0) {
+    for (auto [offset, length] : read_request->byte_extents) {
+      while (length > 0) {
+        auto index = offset / m_block_size;
+        auto block_offset = offset % m_block_size;
+        auto block_length = std::min(length, m_block_size - block_offset);
+
+        bufferlist bl;
+        bl.substr_of(read_request->blocks[index]->bl, block_offset,
+                     block_length);
+        data->claim_append(bl);
+
+        offset += block_length;
+        length -= block_length;
+      }
+    }
+  }
+
+  read_request->on_finish->complete(r);
+  delete read_request;
+}
+
+template <typename I>
+void HttpClient<I>::prefetch_blocks(uint64_t first_block,
+                                    uint64_t last_block) {
+  // concurrent readers (e.g. a deep-copy) do not arrive strictly in order:
+  // treat reads that start close to the end of the previous read as
+  // sequential
+  auto next_block = m_next_sequential_block;
+  m_next_sequential_block = last_block + 1;
+  if (m_prefetch_blocks == 0 ||
+      first_block + m_prefetch_blocks < next_block ||
+      first_block > next_block + m_prefetch_blocks) {
+    return;
+  }
+
+  // never prefetch more than half of the cache
+  auto prefetch_blocks = std::min(
+    m_prefetch_blocks, std::max<uint64_t>(1, m_cache_size / m_block_size / 2));
+  auto block_count = (m_size + m_block_size - 1) / m_block_size;
+  auto end = std::min(last_block + 1 + prefetch_blocks, block_count);
+
+  std::vector<uint64_t> missing_blocks;
+  for (auto index = last_block + 1; index < end; ++index) {
+    auto& block = m_blocks[index];
+    if (!block) {
+      block = std::make_shared<Block>();
+      missing_blocks.push_back(index);
+    }
+  }
+
+  if (!missing_blocks.empty()) {
+    ldout(m_cct, 20) << "prefetching " << missing_blocks.size() << " blocks "
+                     << "from " << missing_blocks.front() << dendl;
+    fetch_blocks(std::move(missing_blocks));
+  }
+}
+
+template <typename I>
+void HttpClient<I>::fetch_blocks(std::vector<uint64_t>&& block_indexes) {
+  if (block_indexes.empty()) {
+    return;
+  }
+
+  // coalesce contiguous blocks into a single range request
+  std::sort(block_indexes.begin(), block_indexes.end());
+  auto max_blocks = std::max<uint64_t>(
+    1, MAX_RANGE_REQUEST_SIZE / m_block_size);
+  uint64_t first_block = block_indexes.front();
+  uint64_t block_count = 1;
+  for (size_t idx = 1; idx < block_indexes.size(); ++idx) {
+    if (block_indexes[idx] == first_block + block_count &&
+        block_count < max_blocks) {
+      ++block_count;
+      continue;
+    }
+
+    fetch_block_range(first_block, block_count);
+    first_block = block_indexes[idx];
+    block_count = 1;
+  }
+  fetch_block_range(first_block, block_count);
+}
+
+template <typename I>
+void HttpClient<I>::fetch_block_range(uint64_t first_block,
+                                      uint64_t block_count) {
+  auto offset = first_block * m_block_size;
+  auto end = std::min((first_block + block_count) * m_block_size, m_size);
+  ldout(m_cct, 20) << "offset=" << offset << ", length=" << (end - offset)
+                   << dendl;
+
+  auto request = create_request(http::verb::get);
+  request.set(http::field::range,
+              "bytes=" + stringify(offset) + "-" + stringify(end - 1));
+
+  auto work = std::make_shared<Work>(
+    std::move(request),
+    [this, first_block, block_count](int r, Response&& response) {
+      handle_fetch_blocks(r, first_block, block_count, std::move(response));
+    });
+  work->body_limit = end - offset;
+  queue_work(std::move(work));
+}
+
+template <typename I>
+void HttpClient<I>::handle_fetch_blocks(int r, uint64_t first_block,
+                                        uint64_t block_count,
+                                        Response&& response) {
+  auto offset = first_block * m_block_size;
+  auto length = std::min((first_block + block_count) * m_block_size,
+                         m_size) - offset;
+  ldout(m_cct, 20) << "offset=" << offset << ", length=" << length << ", "
+                   << "r=" << r << dendl;
+
+  bufferptr bp;
+  if (r >= 0) {
+    auto& body = response.body();
+    if (response.result() == http::status::partial_content &&
+        body.size() == length) {
+      bp = buffer::copy(body.data(), length);
+    } else if (response.result() != http::status::partial_content) {
+      lderr(m_cct) << "server '" << m_url_spec.host << "' does not support "
+                   << "range requests: status=" << response.result_int()
+                   << dendl;
+      r = -EIO;
+    } else {
+      lderr(m_cct) << "unexpected response to range request from '"
+                   << m_url_spec.host << "': length=" << body.size()
+                   << ", expected=" << length << dendl;
+      r = -EIO;
+    }
+  } else if (r != -ESHUTDOWN) {
+    lderr(m_cct) << "failed to read " << offset << "~" << length << ": "
+                 << cpp_strerror(r) << dendl;
+  }
+
+  for (uint64_t index = first_block; index < first_block + block_count;
+       ++index) {
+    auto it = m_blocks.find(index);
+    ceph_assert(it != m_blocks.end() && it->second->loading);
+    auto block = it->second;
+
+    if (r < 0) {
+      // failed blocks are dropped so that a later read can retry them
+      m_blocks.erase(it);
+    } else {
+      auto block_offset = (index - first_block) * m_block_size;
+      auto block_length = std::min(m_block_size, length - block_offset);
+      block->bl.append(bp, block_offset, block_length);
+      block->loading = false;
+      block->lru_it = m_lru.insert(m_lru.end(), index);
+      m_cached_bytes += block_length;
+    }
+
+    auto waiters = std::move(block->waiters);
+    for (auto read_request : waiters) {
+      if (r < 0 && read_request->r == 0) {
+        read_request->r = r;
+      }
+      if (--read_request->pending == 0) {
+        finish_read(read_request);
+      }
+    }
+  }
+
+  trim_cache();
+}
+
+template <typename I>
+void HttpClient<I>::trim_cache() {
+  // blocks still referenced by in-flight reads remain valid after eviction
+  while (m_cached_bytes > m_cache_size && !m_lru.empty()) {
+    auto it = m_blocks.find(m_lru.front());
+    ceph_assert(it != m_blocks.end());
+    m_cached_bytes -= it->second->bl.length();
+    m_blocks.erase(it);
+    m_lru.pop_front();
+  }
+}
+
+} // namespace migration
+} // namespace librbd
+
+template class librbd::migration::HttpClient<librbd::ImageCtx>;
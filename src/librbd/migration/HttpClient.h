@@ -0,0 +1,143 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_MIGRATION_HTTP_CLIENT_H
+#define CEPH_LIBRBD_MIGRATION_HTTP_CLIENT_H
+
+#include "include/common_fwd.h"
+#include "include/int_types.h"
+#include "include/buffer.h"
+#include "librbd/io/Types.h"
+#include "librbd/migration/HttpProcessorInterface.h"
+#include "librbd/migration/Utils.h"
+#include <boost/asio/io_context_strand.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Context;
+
+namespace librbd {
+
+struct AsioEngine;
+struct ImageCtx;
+
+namespace migration {
+
+/*
+ * Reads a remote object with HTTP(S) range requests.
+ *
+ * Requests are spread over a small pool of keep-alive connections. The
+ * object is read in fixed-size blocks that are kept in an LRU cache;
+ * contiguous missing blocks are fetched with a single range request and
+ * sequential reads prefetch the following blocks. All state is owned by a
+ * single strand.
+ */
+template <typename ImageCtxT>
+class HttpClient {
+public:
+  using StringBody = boost::beast::http::string_body;
+  using Request = EmptyRequest;
+  using Response = boost::beast::http::response<StringBody>;
+  using Completion = std::function<void(int, Response&&)>;
+
+  static HttpClient* create(ImageCtxT* image_ctx, const std::string& url) {
+    return new HttpClient(image_ctx, url);
+  }
+
+  HttpClient(ImageCtxT* image_ctx, const std::string& url);
+  ~HttpClient();
+
+  HttpClient(const HttpClient&) = delete;
+  HttpClient& operator=(const HttpClient&) = delete;
+
+  void open(Context* on_finish);
+  void close(Context* on_finish);
+
+  void get_size(uint64_t* size, Context* on_finish);
+
+  void read(io::Extents&& byte_extents, bufferlist* data,
+            Context* on_finish);
+
+  void set_http_processor(HttpProcessorInterface* http_processor) {
+    m_http_processor = http_processor;
+  }
+
+  const util::UrlSpec& get_url_spec() const {
+    return m_url_spec;
+  }
+
+  // issue an arbitrary request against the URL (completion runs in the strand)
+  void issue(Request&& request, Completion&& completion);
+
+private:
+  struct Work;
+  struct SessionBase;
+  template <typename D> struct HttpSession;
+  struct PlainHttpSession;
+  struct SslHttpSession;
+  struct Block;
+  struct ReadRequest;
+
+  typedef std::shared_ptr<Work> WorkRef;
+  typedef std::shared_ptr<Block> BlockRef;
+
+  CephContext* m_cct;
+  std::shared_ptr<AsioEngine> m_asio_engine;
+  std::string m_url;
+
+  util::UrlSpec m_url_spec;
+  HttpProcessorInterface* m_http_processor = nullptr;
+
+  boost::asio::io_context::strand m_strand;
+  boost::asio::ssl::context m_ssl_context;
+
+  uint32_t m_max_sessions;
+  uint64_t m_block_size;
+  uint64_t m_cache_size;
+  uint64_t m_prefetch_blocks;
+
+  std::vector<std::unique_ptr<SessionBase>> m_sessions;
+  std::deque<WorkRef> m_work_queue;
+  Context* m_on_close = nullptr;
+
+  uint64_t m_size = 0;
+  std::map<uint64_t, BlockRef> m_blocks;
+  std::list<uint64_t> m_lru;
+  uint64_t m_cached_bytes = 0;
+  uint64_t m_next_sequential_block = 0;
+
+  void handle_open(int r, Response&& response, Context* on_finish);
+
+  Request create_request(boost::beast::http::verb verb) const;
+
+  void queue_work(WorkRef&& work);
+  void dispatch_work();
+  void handle_session_idle(SessionBase* session);
+  bool is_idle() const;
+  void maybe_finish_close();
+
+  void start_read(ReadRequest* read_request);
+  void finish_read(ReadRequest* read_request);
+  void prefetch_blocks(uint64_t first_block, uint64_t last_block);
+  void fetch_blocks(std::vector<uint64_t>&& block_indexes);
+  void fetch_block_range(uint64_t first_block, uint64_t block_count);
+  void handle_fetch_blocks(int r, uint64_t first_block, uint64_t block_count,
+                           Response&& response);
+  void trim_cache();
+};
+
+} // namespace migration
+} // namespace librbd
+
+extern template class librbd::migration::HttpClient<librbd::ImageCtx>;
+
+#endif // CEPH_LIBRBD_MIGRATION_HTTP_CLIENT_H
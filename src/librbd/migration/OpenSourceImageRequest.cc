@@ -9,6 +9,9 @@
 #include "librbd/io/ImageDispatcher.h"
 #include "librbd/migration/ImageDispatch.h"
 #include "librbd/migration/NativeFormat.h"
+#include "librbd/migration/QCOWFormat.h"
+#include "librbd/migration/RawFormat.h"
+#include "json_spirit/json_spirit.h"
 
 #define dout_subsys ceph_subsys_rbd
 #undef dout_prefix
@@ -18,6 +21,12 @@
 namespace librbd {
 namespace migration {
 
+namespace {
+
+const std::string TYPE{"type"};
+
+} // anonymous namespace
+
 template <typename I>
 OpenSourceImageRequest<I>::OpenSourceImageRequest(
     I* dst_image_ctx, uint64_t src_snap_id,
@@ -44,9 +53,11 @@ void OpenSourceImageRequest<I>::open_source() {
     m_dst_image_ctx->md_ctx, true);
   (*m_src_image_ctx)->child = m_dst_image_ctx;
 
-  // TODO use factory once multiple sources are available
-  m_format = std::unique_ptr<FormatInterface>(NativeFormat<I>::create(
-    *m_src_image_ctx, m_migration_info));
+  int r = create_format();
+  if (r < 0) {
+    finish(r);
+    return;
+  }
 
   auto ctx = util::create_context_callback<
     OpenSourceImageRequest<I>,
@@ -54,6 +65,49 @@ void OpenSourceImageRequest<I>::open_source() {
   m_format->open(ctx);
 }
 
+template <typename I>
+int OpenSourceImageRequest<I>::create_format() {
+  auto cct = m_dst_image_ctx->cct;
+
+  // legacy migrations do not record a source-spec
+  std::string type{"native"};
+  json_spirit::mObject source_spec_object;
+  if (!m_migration_info.source_spec.empty()) {
+    json_spirit::mValue json_root;
+    if (!json_spirit::read(m_migration_info.source_spec, json_root) ||
+        json_root.type() != json_spirit::obj_type) {
+      lderr(cct) << "invalid source-spec JSON" << dendl;
+      return -EINVAL;
+    }
+
+    source_spec_object = json_root.get_obj();
+    auto type_value_it = source_spec_object.find(TYPE);
+    if (type_value_it == source_spec_object.end() ||
+        type_value_it->second.type() != json_spirit::str_type) {
+      lderr(cct) << "missing or invalid format type" << dendl;
+      return -EINVAL;
+    }
+    type = type_value_it->second.get_str();
+  }
+
+  ldout(cct, 10) << "type=" << type << dendl;
+  if (type == "native") {
+    m_format.reset(NativeFormat<I>::create(*m_src_image_ctx,
+                                           m_migration_info));
+  } else if (type == "raw") {
+    m_format.reset(RawFormat<I>::create(*m_src_image_ctx,
+                                        source_spec_object));
+  } else if (type == "qcow") {
+    m_format.reset(QCOWFormat<I>::create(*m_src_image_ctx,
+                                         source_spec_object));
+  } else {
+    lderr(cct) << "unknown or unsupported format type '" << type << "'"
+               << dendl;
+    return -EINVAL;
+  }
+  return 0;
+}
+
 template <typename I>
 void OpenSourceImageRequest<I>::handle_open_source(int r) {
   auto cct = m_dst_image_ctx->cct;
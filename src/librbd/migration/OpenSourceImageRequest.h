@@ -64,6 +64,8 @@ private:
   void open_source();
   void handle_open_source(int r);
 
+  int create_format();
+
   void finish(int r);
 
 };
@@ -0,0 +1,75 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_MIGRATION_QCOW_H
+#define CEPH_LIBRBD_MIGRATION_QCOW_H
+
+#include "include/int_types.h"
+
+/*
+ * On-disk definitions of the QEMU qcow2 image format (versions 2 and 3).
+ * All on-disk integers are big-endian.
+ */
+
+namespace librbd {
+namespace migration {
+namespace qcow {
+
+static const uint32_t QCOW_MAGIC = 0x514649fb; // 'Q', 'F', 'I', 0xfb
+
+static const uint32_t QCOW_CRYPT_NONE = 0;
+
+static const uint32_t MIN_CLUSTER_BITS = 9;
+static const uint32_t MAX_CLUSTER_BITS = 21;
+
+static const uint32_t MAX_BACKING_FILE_SIZE = 1023;
+
+// header field offsets
+static const uint64_t HEADER_MAGIC = 0;
+static const uint64_t HEADER_VERSION = 4;
+static const uint64_t HEADER_BACKING_FILE_OFFSET = 8;
+static const uint64_t HEADER_BACKING_FILE_SIZE = 16;
+static const uint64_t HEADER_CLUSTER_BITS = 20;
+static const uint64_t HEADER_SIZE = 24;
+static const uint64_t HEADER_CRYPT_METHOD = 32;
+static const uint64_t HEADER_L1_SIZE = 36;
+static const uint64_t HEADER_L1_TABLE_OFFSET = 40;
+static const uint64_t HEADER_NB_SNAPSHOTS = 60;
+static const uint64_t HEADER_INCOMPATIBLE_FEATURES = 72;
+static const uint64_t HEADER_LENGTH = 100;
+static const uint64_t HEADER_COMPRESSION_TYPE = 104;
+
+static const uint64_t HEADER_V2_LENGTH = 72;
+static const uint64_t HEADER_V3_MIN_LENGTH = 104;
+
+// incompatible feature bits (version 3)
+static const uint64_t QCOW_INCOMPAT_DIRTY = 1ULL << 0;
+static const uint64_t QCOW_INCOMPAT_CORRUPT = 1ULL << 1;
+static const uint64_t QCOW_INCOMPAT_DATA_FILE = 1ULL << 2;
+static const uint64_t QCOW_INCOMPAT_COMPRESSION = 1ULL << 3;
+static const uint64_t QCOW_INCOMPAT_EXTL2 = 1ULL << 4;
+
+// the dirty bit only affects refcounts, which are not used for reading
+static const uint64_t QCOW_INCOMPAT_SUPPORTED = QCOW_INCOMPAT_DIRTY;
+
+static const uint8_t QCOW_COMPRESSION_TYPE_ZLIB = 0;
+
+// header extensions
+static const uint32_t QCOW_EXT_END = 0x00000000;
+static const uint32_t QCOW_EXT_BACKING_FORMAT = 0xe2792aca;
+
+// L1 / L2 table entries
+static const uint64_t QCOW_OFLAG_COPIED = 1ULL << 63;
+static const uint64_t QCOW_OFLAG_COMPRESSED = 1ULL << 62;
+static const uint64_t QCOW_OFLAG_ZERO = 1ULL << 0;
+
+static const uint64_t L1E_OFFSET_MASK = 0x00fffffffffffe00ULL;
+static const uint64_t L2E_OFFSET_MASK = 0x00fffffffffffe00ULL;
+
+static const uint64_t COMPRESSED_SECTOR_SIZE = 512;
+
+} // namespace qcow
+} // namespace migration
+} // namespace librbd
+
+#endif // CEPH_LIBRBD_MIGRATION_QCOW_H
@@ -0,0 +1,1138 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "librbd/migration/QCOWFormat.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include "include/Context.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/io/AioCompletion.h"
+#include "librbd/io/ReadResult.h"
+#include "librbd/migration/QCOW.h"
+#include "librbd/migration/StreamBuilder.h"
+#include "librbd/migration/StreamInterface.h"
+#include <boost/endian/conversion.hpp>
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::migration::QCOWFormat: " << this \
+                           << " " << __func__ << ": "
+
+namespace librbd {
+namespace migration {
+
+using namespace qcow;
+
+namespace {
+
+const std::string BACKING{"backing"};
+const std::string FORMAT_TYPE{"type"};
+
+const uint32_t MAX_BACKING_DEPTH = 8;
+
+const uint64_t HEADER_READ_SIZE = 512;
+// same limit as QEMU
+const uint64_t MAX_L1_TABLE_SIZE = 32 << 20;
+const uint64_t L2_CACHE_BYTES = 32 << 20;
+const uint64_t MIN_L2_CACHE_TABLES = 4;
+
+uint32_t decode_be32(const char* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return boost::endian::big_to_native(v);
+}
+
+uint64_t decode_be64(const char* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return boost::endian::big_to_native(v);
+}
+
+int decompress_cluster(bufferlist&& compressed_bl, uint64_t cluster_size,
+                       bufferlist* bl) {
+  bufferptr bp(buffer::create(cluster_size));
+
+  // raw deflate stream with a 4KiB window, as written by QEMU
+  z_stream strm;
+  memset(&strm, 0, sizeof(strm));
+  if (inflateInit2(&strm, -12) != Z_OK) {
+    return -EIO;
+  }
+
+  strm.next_in = reinterpret_cast<Bytef*>(compressed_bl.c_str());
+  strm.avail_in = compressed_bl.length();
+  strm.next_out = reinterpret_cast<Bytef*>(bp.c_str());
+  strm.avail_out = cluster_size;
+
+  // the compressed data is padded to a sector so trailing input is expected
+  int r = inflate(&strm, Z_FINISH);
+  bool complete = ((r == Z_STREAM_END || r == Z_BUF_ERROR) &&
+                   strm.avail_out == 0);
+  inflateEnd(&strm);
+  if (!complete) {
+    return -EIO;
+  }
+
+  bl->push_back(std::move(bp));
+  return 0;
+}
+
+} // anonymous namespace
+
+template <typename I>
+struct QCOWFormat<I>::L2Table {
+  bool loading = true;
+  std::vector<uint64_t> entries;
+  std::list<Context*> waiters;
+  std::list<uint64_t>::iterator lru_it;
+};
+
+template <typename I>
+struct QCOWFormat<I>::ClusterExtent {
+  uint64_t image_offset;
+  uint64_t length;
+  uint64_t cluster_offset;
+  uint64_t l1_index;
+  uint64_t l2_index;
+
+  ClusterType type = CLUSTER_TYPE_UNALLOCATED;
+  uint64_t host_offset = 0;
+  uint64_t compressed_length = 0;
+
+  ClusterExtent(uint64_t image_offset, uint64_t length,
+                uint64_t cluster_offset, uint64_t l1_index, uint64_t l2_index)
+    : image_offset(image_offset), length(length),
+      cluster_offset(cluster_offset), l1_index(l1_index),
+      l2_index(l2_index) {
+  }
+};
+
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::migration::QCOWFormat::ReadRequest: " \
+                           << this << " " << __func__ << ": "
+
+template <typename I>
+struct QCOWFormat<I>::ReadRequest {
+  QCOWFormat* qcow_format;
+  io::Extents image_extents;
+  bufferlist* data;
+  Context* on_finish;
+
+  ClusterExtents cluster_extents;
+  L2Tables l2_tables;
+
+  std::vector<uint64_t> compressed_lengths;
+  bufferlist data_bl;
+  bufferlist compressed_bl;
+  bufferlist backing_bl;
+
+  ReadRequest(QCOWFormat* qcow_format, io::Extents&& image_extents,
+              bufferlist* data, Context* on_finish)
+    : qcow_format(qcow_format), image_extents(std::move(image_extents)),
+      data(data), on_finish(on_finish) {
+    auto cct = qcow_format->m_image_ctx->cct;
+    ldout(cct, 20) << dendl;
+  }
+
+  void send() {
+    std::set<uint64_t> l1_indexes;
+    qcow_format->split_extents(image_extents, &cluster_extents, &l1_indexes);
+
+    auto ctx = new LambdaContext([this](int r) { handle_load_l2_tables(r); });
+    qcow_format->load_l2_tables(l1_indexes, &l2_tables, ctx);
+  }
+
+  void handle_load_l2_tables(int r) {
+    auto cct = qcow_format->m_image_ctx->cct;
+    ldout(cct, 20) << "r=" << r << dendl;
+
+    if (r < 0) {
+      lderr(cct) << "failed to load L2 tables: " << cpp_strerror(r) << dendl;
+      finish(r);
+      return;
+    }
+
+    qcow_format->map_cluster_extents(l2_tables, &cluster_extents);
+    read_clusters();
+  }
+
+  void read_clusters() {
+    auto cct = qcow_format->m_image_ctx->cct;
+
+    // coalesce physically contiguous data clusters into a single extent
+    io::Extents data_extents;
+    io::Extents compressed_extents;
+    io::Extents backing_extents;
+    for (auto& cluster_extent : cluster_extents) {
+      switch (cluster_extent.type) {
+      case CLUSTER_TYPE_DATA:
+        if (!data_extents.empty() &&
+            data_extents.back().first + data_extents.back().second ==
+              cluster_extent.host_offset) {
+          data_extents.back().second += cluster_extent.length;
+        } else {
+          data_extents.emplace_back(cluster_extent.host_offset,
+                                    cluster_extent.length);
+        }
+        break;
+      case CLUSTER_TYPE_COMPRESSED:
+        {
+          auto stream_size = qcow_format->m_stream_size;
+          if (cluster_extent.host_offset >= stream_size) {
+            lderr(cct) << "compressed cluster beyond end of image" << dendl;
+            finish(-EINVAL);
+            return;
+          }
+
+          // the last compressed cluster may end before its last sector
+          auto length = std::min(cluster_extent.compressed_length,
+                                 stream_size - cluster_extent.host_offset);
+          compressed_extents.emplace_back(cluster_extent.host_offset, length);
+          compressed_lengths.push_back(length);
+        }
+        break;
+      case CLUSTER_TYPE_UNALLOCATED:
+        if (cluster_extent.image_offset < qcow_format->m_backing_size) {
+          backing_extents.emplace_back(
+            cluster_extent.image_offset,
+            std::min(cluster_extent.length,
+                     qcow_format->m_backing_size -
+                       cluster_extent.image_offset));
+        }
+        break;
+      case CLUSTER_TYPE_ZERO:
+        break;
+      }
+    }
+
+    ldout(cct, 20) << "data_extents=" << data_extents << ", "
+                   << "compressed_extents=" << compressed_extents << ", "
+                   << "backing_extents=" << backing_extents << dendl;
+
+    auto gather_ctx = new C_Gather(cct, new LambdaContext([this](int r) {
+        handle_read_clusters(r);
+      }));
+    if (!data_extents.empty()) {
+      qcow_format->m_stream->read(std::move(data_extents), &data_bl,
+                                  gather_ctx->new_sub());
+    }
+    if (!compressed_extents.empty()) {
+      qcow_format->m_stream->read(std::move(compressed_extents),
+                                  &compressed_bl, gather_ctx->new_sub());
+    }
+    if (!backing_extents.empty()) {
+      qcow_format->read_backing(std::move(backing_extents), &backing_bl,
+                                gather_ctx->new_sub());
+    }
+    gather_ctx->activate();
+  }
+
+  void handle_read_clusters(int r) {
+    auto cct = qcow_format->m_image_ctx->cct;
+    ldout(cct, 20) << "r=" << r << dendl;
+
+    if (r < 0) {
+      lderr(cct) << "failed to read clusters: " << cpp_strerror(r) << dendl;
+      finish(r);
+      return;
+    }
+
+    uint64_t data_offset = 0;
+    uint64_t compressed_offset = 0;
+    uint64_t backing_offset = 0;
+    auto compressed_length_it = compressed_lengths.begin();
+
+    // consecutive extents frequently fall within the same compressed cluster
+    uint64_t decompressed_host_offset = 0;
+    bufferlist decompressed_bl;
+
+    data->clear();
+    for (auto& cluster_extent : cluster_extents) {
+      bufferlist bl;
+      switch (cluster_extent.type) {
+      case CLUSTER_TYPE_DATA:
+        bl.substr_of(data_bl, data_offset, cluster_extent.length);
+        data_offset += cluster_extent.length;
+        break;
+      case CLUSTER_TYPE_COMPRESSED:
+        {
+          auto compressed_length = *(compressed_length_it++);
+          if (decompressed_bl.length() == 0 ||
+              decompressed_host_offset != cluster_extent.host_offset) {
+            bufferlist cluster_bl;
+            cluster_bl.substr_of(compressed_bl, compressed_offset,
+                                 compressed_length);
+            decompressed_bl.clear();
+            r = decompress_cluster(std::move(cluster_bl),
+                                   qcow_format->m_cluster_size,
+                                   &decompressed_bl);
+            if (r < 0) {
+              lderr(cct) << "failed to decompress cluster at "
+                         << cluster_extent.host_offset << dendl;
+              finish(r);
+              return;
+            }
+            decompressed_host_offset = cluster_extent.host_offset;
+          }
+          compressed_offset += compressed_length;
+
+          bl.substr_of(decompressed_bl, cluster_extent.cluster_offset,
+                       cluster_extent.length);
+        }
+        break;
+      case CLUSTER_TYPE_UNALLOCATED:
+        {
+          uint64_t backing_length = 0;
+          auto backing_size = qcow_format->m_backing_size;
+          if (cluster_extent.image_offset < backing_size) {
+            backing_length = std::min(
+              cluster_extent.length,
+              backing_size - cluster_extent.image_offset);
+            bl.substr_of(backing_bl, backing_offset, backing_length);
+            backing_offset += backing_length;
+          }
+          bl.append_zero(cluster_extent.length - backing_length);
+        }
+        break;
+      case CLUSTER_TYPE_ZERO:
+        bl.append_zero(cluster_extent.length);
+        break;
+      }
+
+      data->claim_append(bl);
+    }
+
+    finish(0);
+  }
+
+  void finish(int r) {
+    auto cct = qcow_format->m_image_ctx->cct;
+    ldout(cct, 20) << "r=" << r << dendl;
+
+    if (r < 0) {
+      data->clear();
+    }
+
+    on_finish->complete(r);
+    delete this;
+  }
+};
+
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::migration::QCOWFormat::" \
+                           << "ListSnapsRequest: " << this << " " \
+                           << __func__ << ": "
+
+template <typename I>
+struct QCOWFormat<I>::ListSnapsRequest {
+  QCOWFormat* qcow_format;
+  io::Extents image_extents;
+  io::SnapshotDelta* snapshot_delta;
+  Context* on_finish;
+
+  ClusterExtents cluster_extents;
+  L2Tables l2_tables;
+
+  ListSnapsRequest(QCOWFormat* qcow_format, io::Extents&& image_extents,
+                   io::SnapshotDelta* snapshot_delta, Context* on_finish)
+    : qcow_format(qcow_format), image_extents(std::move(image_extents)),
+      snapshot_delta(snapshot_delta), on_finish(on_finish) {
+    auto cct = qcow_format->m_image_ctx->cct;
+    ldout(cct, 20) << dendl;
+  }
+
+  void send() {
+    std::set<uint64_t> l1_indexes;
+    qcow_format->split_extents(image_extents, &cluster_extents, &l1_indexes);
+
+    auto ctx = new LambdaContext([this](int r) { handle_load_l2_tables(r); });
+    qcow_format->load_l2_tables(l1_indexes, &l2_tables, ctx);
+  }
+
+  void handle_load_l2_tables(int r) {
+    auto cct = qcow_format->m_image_ctx->cct;
+    ldout(cct, 20) << "r=" << r << dendl;
+
+    if (r < 0) {
+      lderr(cct) << "failed to load L2 tables: " << cpp_strerror(r) << dendl;
+      finish(r);
+      return;
+    }
+
+    qcow_format->map_cluster_extents(l2_tables, &cluster_extents);
+
+    // unallocated clusters within the backing image are conservatively
+    // reported as data
+    auto& snapshot = (*snapshot_delta)[{CEPH_NOSNAP, CEPH_NOSNAP}];
+    auto backing_size = qcow_format->m_backing_size;
+    for (auto& cluster_extent : cluster_extents) {
+      auto offset = cluster_extent.image_offset;
+      auto length = cluster_extent.length;
+      switch (cluster_extent.type) {
+      case CLUSTER_TYPE_DATA:
+      case CLUSTER_TYPE_COMPRESSED:
+        snapshot.insert(offset, length,
+                        {io::SPARSE_EXTENT_STATE_DATA, length});
+        break;
+      case CLUSTER_TYPE_UNALLOCATED:
+        if (offset < backing_size) {
+          auto backing_length = std::min(length, backing_size - offset);
+          snapshot.insert(offset, backing_length,
+                          {io::SPARSE_EXTENT_STATE_DATA, backing_length});
+          offset += backing_length;
+          length -= backing_length;
+        }
+        if (length > 0) {
+          snapshot.insert(offset, length,
+                          {io::SPARSE_EXTENT_STATE_ZEROED, length});
+        }
+        break;
+      case CLUSTER_TYPE_ZERO:
+        snapshot.insert(offset, length,
+                        {io::SPARSE_EXTENT_STATE_ZEROED, length});
+        break;
+      }
+    }
+
+    finish(0);
+  }
+
+  void finish(int r) {
+    auto cct = qcow_format->m_image_ctx->cct;
+    ldout(cct, 20) << "r=" << r << dendl;
+
+    on_finish->complete(r);
+    delete this;
+  }
+};
+
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::migration::QCOWFormat: " << this \
+                           << " " << __func__ << ": "
+
+template <typename I>
+QCOWFormat<I>::QCOWFormat(
+    I* image_ctx, const json_spirit::mObject& json_object, uint32_t depth)
+  : m_image_ctx(image_ctx), m_json_object(json_object), m_depth(depth),
+    m_lock(ceph::make_mutex("librbd::migration::QCOWFormat::m_lock")) {
+}
+
+template <typename I>
+QCOWFormat<I>::~QCOWFormat() {
+}
+
+template <typename I>
+void QCOWFormat<I>::open(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << "depth=" << m_depth << dendl;
+
+  open_stream(on_finish);
+}
+
+template <typename I>
+void QCOWFormat<I>::open_stream(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << dendl;
+
+  int r = StreamBuilder<I>::build(m_image_ctx, m_json_object, &m_stream);
+  if (r < 0) {
+    on_finish->complete(r);
+    return;
+  }
+
+  auto ctx = new LambdaContext([this, on_finish](int r) {
+      handle_open_stream(r, on_finish);
+    });
+  m_stream->open(ctx);
+}
+
+template <typename I>
+void QCOWFormat<I>::handle_open_stream(int r, Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << "r=" << r << dendl;
+
+  if (r < 0) {
+    lderr(cct) << "failed to open stream: " << cpp_strerror(r) << dendl;
+    on_finish->complete(r);
+    return;
+  }
+
+  get_stream_size(on_finish);
+}
+
+template <typename I>
+void QCOWFormat<I>::get_stream_size(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << dendl;
+
+  auto ctx = new LambdaContext([this, on_finish](int r) {
+      handle_get_stream_size(r, on_finish);
+    });
+  m_stream->get_size(&m_stream_size, ctx);
+}
+
+template <typename I>
+void QCOWFormat<I>::handle_get_stream_size(int r, Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << "r=" << r << ", stream_size=" << m_stream_size << dendl;
+
+  if (r < 0) {
+    lderr(cct) << "failed to retrieve stream size: " << cpp_strerror(r)
+               << dendl;
+    handle_open(r, on_finish);
+    return;
+  }
+
+  read_header(on_finish);
+}
+
+template <typename I>
+void QCOWFormat<I>::read_header(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << dendl;
+
+  auto length = std::min(HEADER_READ_SIZE, m_stream_size);
+  if (length < HEADER_V2_LENGTH) {
+    m_bl.clear();
+    handle_read_header(0, on_finish);
+    return;
+  }
+
+  auto ctx = new LambdaContext([this, on_finish](int r) {
+      handle_read_header(r, on_finish);
+    });
+  m_stream->read({{0, length}}, &m_bl, ctx);
+}
+
+template <typename I>
+void QCOWFormat<I>::handle_read_header(int r, Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << "r=" << r << dendl;
+
+  if (r < 0) {
+    lderr(cct) << "failed to read header: " << cpp_strerror(r) << dendl;
+    handle_open(r, on_finish);
+    return;
+  }
+
+  auto p = m_bl.c_str();
+  if (m_bl.length() < HEADER_V2_LENGTH ||
+      decode_be32(p + HEADER_MAGIC) != QCOW_MAGIC) {
+    lderr(cct) << "invalid qcow2 header magic" << dendl;
+    handle_open(-EINVAL, on_finish);
+    return;
+  }
+
+  m_version = decode_be32(p + HEADER_VERSION);
+  if (m_version != 2 && m_version != 3) {
+    lderr(cct) << "unsupported qcow version " << m_version << dendl;
+    handle_open(-ENOTSUP, on_finish);
+    return;
+  }
+
+  m_backing_file_offset = decode_be64(p + HEADER_BACKING_FILE_OFFSET);
+  m_backing_file_size = decode_be32(p + HEADER_BACKING_FILE_SIZE);
+  m_cluster_bits = decode_be32(p + HEADER_CLUSTER_BITS);
+  m_size = decode_be64(p + HEADER_SIZE);
+  auto crypt_method = decode_be32(p + HEADER_CRYPT_METHOD);
+  m_l1_size = decode_be32(p + HEADER_L1_SIZE);
+  m_l1_table_offset = decode_be64(p + HEADER_L1_TABLE_OFFSET);
+  auto nb_snapshots = decode_be32(p + HEADER_NB_SNAPSHOTS);
+
+  if (m_cluster_bits < MIN_CLUSTER_BITS || m_cluster_bits > MAX_CLUSTER_BITS) {
+    lderr(cct) << "invalid cluster bits: " << m_cluster_bits << dendl;
+    handle_open(-EINVAL, on_finish);
+    return;
+  }
+  m_cluster_size = 1ULL << m_cluster_bits;
+  m_l2_bits = m_cluster_bits - 3;
+
+  if (crypt_method != QCOW_CRYPT_NONE) {
+    lderr(cct) << "encrypted qcow2 images are not supported" << dendl;
+    handle_open(-ENOTSUP, on_finish);
+    return;
+  }
+
+  if (m_version == 2) {
+    m_header_length = HEADER_V2_LENGTH;
+  } else {
+    if (m_bl.length() < HEADER_V3_MIN_LENGTH) {
+      lderr(cct) << "truncated qcow2 header" << dendl;
+      handle_open(-EINVAL, on_finish);
+      return;
+    }
+
+    auto incompatible_features = decode_be64(
+      p + HEADER_INCOMPATIBLE_FEATURES);
+    if ((incompatible_features & QCOW_INCOMPAT_CORRUPT) != 0) {
+      lderr(cct) << "qcow2 image is marked corrupt" << dendl;
+      handle_open(-EINVAL, on_finish);
+      return;
+    } else if ((incompatible_features & ~QCOW_INCOMPAT_SUPPORTED) != 0) {
+      lderr(cct) << "unsupported qcow2 incompatible features: 0x" << std::hex
+                 << (incompatible_features & ~QCOW_INCOMPAT_SUPPORTED)
+                 << std::dec << dendl;
+      handle_open(-ENOTSUP, on_finish);
+      return;
+    }
+
+    m_header_length = decode_be32(p + HEADER_LENGTH);
+    if (m_header_length < HEADER_V3_MIN_LENGTH ||
+        m_header_length > m_cluster_size) {
+      lderr(cct) << "invalid qcow2 header length: " << m_header_length
+                 << dendl;
+      handle_open(-EINVAL, on_finish);
+      return;
+    }
+  }
+
+  if (m_backing_file_offset != 0 &&
+      (m_backing_file_size == 0 ||
+       m_backing_file_size > MAX_BACKING_FILE_SIZE ||
+       m_backing_file_offset + m_backing_file_size > m_cluster_size)) {
+    lderr(cct) << "invalid backing file name location" << dendl;
+    handle_open(-EINVAL, on_finish);
+    return;
+  }
+
+  // the L1 table must cover the virtual size, and entries past it are
+  // never used
+  uint64_t l2_coverage = m_cluster_size << m_l2_bits;
+  uint64_t min_l1_size = m_size / l2_coverage +
+                         (m_size % l2_coverage != 0 ? 1 : 0);
+  if (min_l1_size > MAX_L1_TABLE_SIZE / sizeof(uint64_t)) {
+    lderr(cct) << "image size " << m_size << " requires an L1 table larger "
+               << "than " << MAX_L1_TABLE_SIZE << " bytes" << dendl;
+    handle_open(-EFBIG, on_finish);
+    return;
+  }
+
+  uint64_t l1_table_bytes = m_l1_size * sizeof(uint64_t);
+  if (m_l1_size < min_l1_size ||
+      l1_table_bytes > MAX_L1_TABLE_SIZE ||
+      (m_l1_table_offset & (m_cluster_size - 1)) != 0 ||
+      m_l1_table_offset > m_stream_size ||
+      l1_table_bytes > m_stream_size - m_l1_table_offset) {
+    lderr(cct) << "invalid L1 table: size=" << m_l1_size << ", "
+               << "offset=" << m_l1_table_offset << dendl;
+    handle_open(-EINVAL, on_finish);
+    return;
+  }
+  m_l1_size = min_l1_size;
+
+  if (nb_snapshots > 0) {
+    ldout(cct, 5) << "ignoring " << nb_snapshots << " internal snapshots"
+                  << dendl;
+  }
+
+  m_l2_cache_size = std::max(MIN_L2_CACHE_TABLES,
+                             L2_CACHE_BYTES / m_cluster_size);
+
+  ldout(cct, 10) << "version=" << m_version << ", "
+                 << "size=" << m_size << ", "
+                 << "cluster_size=" << m_cluster_size << ", "
+                 << "l1_size=" << m_l1_size << dendl;
+  read_header_cluster(on_finish);
+}
+
+template <typename I>
+void QCOWFormat<I>::read_header_cluster(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << dendl;
+
+  m_bl.clear();
+  auto ctx = new LambdaContext([this, on_finish](int r) {
+      handle_read_header_cluster(r, on_finish);
+    });
+  m_stream->read({{0, std::min(m_cluster_size, m_stream_size)}}, &m_bl, ctx);
+}
+
+template <typename I>
+void QCOWFormat<I>::handle_read_header_cluster(int r, Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << "r=" << r << dendl;
+
+  if (r < 0) {
+    lderr(cct) << "failed to read header cluster: " << cpp_strerror(r)
+               << dendl;
+    handle_open(r, on_finish);
+    return;
+  }
+
+  r = parse_header_extensions();
+  if (r < 0) {
+    handle_open(r, on_finish);
+    return;
+  }
+
+  if (m_backing_file_offset != 0) {
+    if (m_backing_file_offset + m_backing_file_size > m_bl.length()) {
+      lderr(cct) << "truncated backing file name" << dendl;
+      handle_open(-EINVAL, on_finish);
+      return;
+    }
+
+    m_backing_file_name.assign(m_bl.c_str() + m_backing_file_offset,
+                               m_backing_file_size);
+    ldout(cct, 10) << "backing_file=" << m_backing_file_name << ", "
+                   << "backing_format=" << m_backing_format << dendl;
+  }
+
+  read_l1_table(on_finish);
+}
+
+template <typename I>
+int QCOWFormat<I>::parse_header_extensions() {
+  auto cct = m_image_ctx->cct;
+
+  // extensions follow the header up to the backing file name (if any)
+  uint64_t end = m_bl.length();
+  if (m_backing_file_offset != 0) {
+    end = std::min<uint64_t>(end, m_backing_file_offset);
+  }
+
+  auto p = m_bl.c_str();
+  uint64_t offset = m_header_length;
+  while (offset + 8 <= end) {
+    auto type = decode_be32(p + offset);
+    auto length = decode_be32(p + offset + 4);
+    if (type == QCOW_EXT_END) {
+      break;
+    } else if (offset + 8 + length > end) {
+      lderr(cct) << "invalid header extension 0x" << std::hex << type
+                 << std::dec << dendl;
+      return -EINVAL;
+    }
+
+    if (type == QCOW_EXT_BACKING_FORMAT) {
+      m_backing_format.assign(p + offset + 8, length);
+    }
+    offset += 8 + ((length + 7) & ~7ULL);
+  }
+  return 0;
+}
+
+template <typename I>
+void QCOWFormat<I>::read_l1_table(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << dendl;
+
+  if (m_l1_size == 0) {
+    open_backing(on_finish);
+    return;
+  }
+
+  m_bl.clear();
+  auto ctx = new LambdaContext([this, on_finish](int r) {
+      handle_read_l1_table(r, on_finish);
+    });
+  m_stream->read({{m_l1_table_offset, m_l1_size * sizeof(uint64_t)}}, &m_bl,
+                 ctx);
+}
+
+template <typename I>
+void QCOWFormat<I>::handle_read_l1_table(int r, Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << "r=" << r << dendl;
+
+  if (r < 0) {
+    lderr(cct) << "failed to read L1 table: " << cpp_strerror(r) << dendl;
+    handle_open(r, on_finish);
+    return;
+  }
+
+  auto p = m_bl.c_str();
+  m_l1_table.resize(m_l1_size);
+  for (uint32_t idx = 0; idx < m_l1_size; ++idx) {
+    auto l2_offset = decode_be64(p + idx * sizeof(uint64_t)) &
+                     L1E_OFFSET_MASK;
+    if ((l2_offset & (m_cluster_size - 1)) != 0) {
+      lderr(cct) << "unaligned L2 table offset " << l2_offset << dendl;
+      handle_open(-EINVAL, on_finish);
+      return;
+    }
+    m_l1_table[idx] = l2_offset;
+  }
+  m_bl.clear();
+
+  open_backing(on_finish);
+}
+
+template <typename I>
+int QCOWFormat<I>::build_backing_spec(json_spirit::mObject* backing_spec) {
+  auto cct = m_image_ctx->cct;
+
+  auto backing_it = m_json_object.find(BACKING);
+  if (backing_it != m_json_object.end()) {
+    if (backing_it->second.type() != json_spirit::obj_type) {
+      lderr(cct) << "invalid backing section" << dendl;
+      return -EINVAL;
+    }
+
+    *backing_spec = backing_it->second.get_obj();
+    auto type_it = backing_spec->find(FORMAT_TYPE);
+    if (type_it == backing_spec->end() ||
+        type_it->second.type() != json_spirit::str_type ||
+        (type_it->second.get_str() != "raw" &&
+         type_it->second.get_str() != "qcow")) {
+      lderr(cct) << "backing image must be a raw or qcow image" << dendl;
+      return -EINVAL;
+    }
+    return 0;
+  }
+
+  // the backing file name comes from the image and cannot be trusted to
+  // name a path or format
+  lderr(cct) << "backing file '" << m_backing_file_name << "' requires "
+             << "a '" << BACKING << "' source-spec" << dendl;
+  return -ENOTSUP;
+}
+
+template <typename I>
+void QCOWFormat<I>::open_backing(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  if (m_backing_file_name.empty()) {
+    handle_open(0, on_finish);
+    return;
+  }
+
+  ldout(cct, 10) << dendl;
+  if (m_depth + 1 >= MAX_BACKING_DEPTH) {
+    lderr(cct) << "backing chain is too long" << dendl;
+    handle_open(-EINVAL, on_finish);
+    return;
+  }
+
+  json_spirit::mObject backing_spec;
+  int r = build_backing_spec(&backing_spec);
+  if (r < 0) {
+    handle_open(r, on_finish);
+    return;
+  }
+
+  auto ctx = new LambdaContext([this, on_finish](int r) {
+      handle_open_backing(r, on_finish);
+    });
+
+  auto& format_type = backing_spec[FORMAT_TYPE].get_str();
+  if (format_type == "raw") {
+    r = StreamBuilder<I>::build(m_image_ctx, backing_spec, &m_backing_stream);
+    if (r < 0) {
+      handle_open(r, on_finish);
+      return;
+    }
+
+    auto stream = m_backing_stream.get();
+    m_backing_stream->open(new LambdaContext([this, stream, ctx](int r) {
+        if (r < 0) {
+          ctx->complete(r);
+          return;
+        }
+        stream->get_size(&m_backing_size, ctx);
+      }));
+    return;
+  }
+
+  m_backing_qcow.reset(new QCOWFormat(m_image_ctx, backing_spec, m_depth + 1));
+  auto qcow = m_backing_qcow.get();
+  m_backing_qcow->open(new LambdaContext([this, qcow, ctx](int r) {
+      if (r < 0) {
+        ctx->complete(r);
+        return;
+      }
+      qcow->get_image_size(CEPH_NOSNAP, &m_backing_size, ctx);
+    }));
+}
+
+template <typename I>
+void QCOWFormat<I>::handle_open_backing(int r, Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << "r=" << r << ", backing_size=" << m_backing_size << dendl;
+
+  if (r < 0) {
+    lderr(cct) << "failed to open backing image '" << m_backing_file_name
+               << "': " << cpp_strerror(r) << dendl;
+  }
+
+  handle_open(r, on_finish);
+}
+
+template <typename I>
+void QCOWFormat<I>::handle_open(int r, Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << "r=" << r << dendl;
+
+  m_bl.clear();
+  if (r < 0) {
+    close(new LambdaContext([r, on_finish](int) {
+        on_finish->complete(r);
+      }));
+    return;
+  }
+
+  on_finish->complete(0);
+}
+
+template <typename I>
+void QCOWFormat<I>::close(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << dendl;
+
+  auto ctx = new LambdaContext([this, on_finish](int r) {
+      if (!m_stream) {
+        on_finish->complete(0);
+        return;
+      }
+      m_stream->close(on_finish);
+    });
+
+  if (m_backing_qcow) {
+    m_backing_qcow->close(ctx);
+  } else if (m_backing_stream) {
+    m_backing_stream->close(ctx);
+  } else {
+    ctx->complete(0);
+  }
+}
+
+template <typename I>
+void QCOWFormat<I>::get_snapshots(SnapInfos* snap_infos, Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << dendl;
+
+  snap_infos->clear();
+  on_finish->complete(0);
+}
+
+template <typename I>
+void QCOWFormat<I>::get_image_size(uint64_t snap_id, uint64_t* size,
+                                   Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 10) << dendl;
+
+  if (snap_id != CEPH_NOSNAP) {
+    on_finish->complete(-EINVAL);
+    return;
+  }
+
+  *size = m_size;
+  on_finish->complete(0);
+}
+
+template <typename I>
+bool QCOWFormat<I>::read(
+    io::AioCompletion* aio_comp, uint64_t snap_id, io::Extents&& image_extents,
+    io::ReadResult&& read_result, int op_flags, int read_flags,
+    const ZTracer::Trace &parent_trace) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "image_extents=" << image_extents << dendl;
+
+  if (snap_id != CEPH_NOSNAP) {
+    aio_comp->fail(-EINVAL);
+    return true;
+  }
+
+  aio_comp->read_result = std::move(read_result);
+  aio_comp->read_result.set_image_extents(image_extents);
+
+  aio_comp->set_request_count(1);
+  auto ctx = new io::ReadResult::C_ImageReadRequest(aio_comp,
+                                                    image_extents);
+  read_extents(std::move(image_extents), &ctx->bl, ctx);
+  return true;
+}
+
+template <typename I>
+void QCOWFormat<I>::read_extents(io::Extents&& image_extents,
+                                 bufferlist* data, Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "image_extents=" << image_extents << dendl;
+
+  auto req = new ReadRequest(this, std::move(image_extents), data, on_finish);
+  req->send();
+}
+
+template <typename I>
+void QCOWFormat<I>::list_snaps(io::Extents&& image_extents,
+                               io::SnapIds&& snap_ids, int list_snaps_flags,
+                               io::SnapshotDelta* snapshot_delta,
+                               const ZTracer::Trace &parent_trace,
+                               Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "image_extents=" << image_extents << dendl;
+
+  auto req = new ListSnapsRequest(this, std::move(image_extents),
+                                  snapshot_delta, on_finish);
+  req->send();
+}
+
+template <typename I>
+void QCOWFormat<I>::split_extents(const io::Extents& image_extents,
+                                  ClusterExtents* cluster_extents,
+                                  std::set<uint64_t>* l1_indexes) const {
+  uint64_t l2_mask = (1ULL << m_l2_bits) - 1;
+  for (auto [offset, length] : image_extents) {
+    while (length > 0) {
+      auto cluster_offset = offset & (m_cluster_size - 1);
+      auto cluster_length = std::min(length, m_cluster_size - cluster_offset);
+      auto cluster_index = offset >> m_cluster_bits;
+      auto l1_index = cluster_index >> m_l2_bits;
+
+      cluster_extents->emplace_back(offset, cluster_length, cluster_offset,
+                                    l1_index, cluster_index & l2_mask);
+      if (offset < m_size && l1_index < m_l1_table.size() &&
+          m_l1_table[l1_index] != 0) {
+        l1_indexes->insert(l1_index);
+      }
+
+      offset += cluster_length;
+      length -= cluster_length;
+    }
+  }
+}
+
+template <typename I>
+void QCOWFormat<I>::load_l2_tables(const std::set<uint64_t>& l1_indexes,
+                                   L2Tables* l2_tables, Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+
+  std::vector<uint64_t> missing_l1_indexes;
+  auto gather_ctx = new C_Gather(cct, on_finish);
+  {
+    std::lock_guard locker{m_lock};
+    for (auto l1_index : l1_indexes) {
+      auto& l2_table = m_l2_tables[l1_index];
+      if (!l2_table) {
+        l2_table = std::make_shared<L2Table>();
+        missing_l1_indexes.push_back(l1_index);
+      } else if (!l2_table->loading) {
+        m_l2_lru.splice(m_l2_lru.end(), m_l2_lru, l2_table->lru_it);
+      }
+
+      if (l2_table->loading) {
+        l2_table->waiters.push_back(gather_ctx->new_sub());
+      }
+      (*l2_tables)[l1_index] = l2_table;
+    }
+  }
+
+  for (auto l1_index : missing_l1_indexes) {
+    auto l2_offset = m_l1_table[l1_index];
+    ldout(cct, 20) << "loading L2 table " << l1_index << " at " << l2_offset
+                   << dendl;
+
+    auto bl = std::make_shared<bufferlist>();
+    auto ctx = new LambdaContext([this, l1_index, bl](int r) {
+        handle_load_l2_table(r, l1_index, std::move(*bl));
+      });
+    m_stream->read({{l2_offset, m_cluster_size}}, bl.get(), ctx);
+  }
+
+  gather_ctx->activate();
+}
+
+template <typename I>
+void QCOWFormat<I>::handle_load_l2_table(int r, uint64_t l1_index,
+                                         bufferlist&& bl) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "l1_index=" << l1_index << ", r=" << r << dendl;
+
+  std::list<Context*> waiters;
+  {
+    std::lock_guard locker{m_lock};
+    auto it = m_l2_tables.find(l1_index);
+    ceph_assert(it != m_l2_tables.end());
+    auto l2_table = it->second;
+    waiters.swap(l2_table->waiters);
+
+    if (r >= 0 && bl.length() != m_cluster_size) {
+      r = -EIO;
+    }
+
+    if (r < 0) {
+      lderr(cct) << "failed to read L2 table " << l1_index << ": "
+                 << cpp_strerror(r) << dendl;
+      m_l2_tables.erase(it);
+    } else {
+      auto p = bl.c_str();
+      l2_table->entries.resize(m_cluster_size / sizeof(uint64_t));
+      for (size_t idx = 0; idx < l2_table->entries.size(); ++idx) {
+        l2_table->entries[idx] = decode_be64(p + idx * sizeof(uint64_t));
+      }
+      l2_table->loading = false;
+      l2_table->lru_it = m_l2_lru.insert(m_l2_lru.end(), l1_index);
+
+      // in-flight requests keep their evicted tables alive
+      while (m_l2_lru.size() > m_l2_cache_size) {
+        m_l2_tables.erase(m_l2_lru.front());
+        m_l2_lru.pop_front();
+      }
+    }
+  }
+
+  for (auto ctx : waiters) {
+    ctx->complete(r);
+  }
+}
+
+template <typename I>
+void QCOWFormat<I>::map_cluster_extents(const L2Tables& l2_tables,
+                                        ClusterExtents* cluster_extents) const {
+  // compressed cluster descriptors: host offset in the low bits followed by
+  // the number of additional 512 byte sectors
+  uint64_t csize_shift = 62 - (m_cluster_bits - 8);
+  uint64_t csize_mask = (1ULL << (m_cluster_bits - 8)) - 1;
+  uint64_t coffset_mask = (1ULL << csize_shift) - 1;
+
+  for (auto& cluster_extent : *cluster_extents) {
+    if (cluster_extent.image_offset >= m_size) {
+      cluster_extent.type = CLUSTER_TYPE_ZERO;
+      continue;
+    }
+
+    auto it = l2_tables.find(cluster_extent.l1_index);
+    if (it == l2_tables.end()) {
+      cluster_extent.type = CLUSTER_TYPE_UNALLOCATED;
+      continue;
+    }
+
+    auto l2_entry = it->second->entries[cluster_extent.l2_index];
+    if ((l2_entry & QCOW_OFLAG_COMPRESSED) != 0) {
+      cluster_extent.type = CLUSTER_TYPE_COMPRESSED;
+      cluster_extent.host_offset = l2_entry & coffset_mask;
+
+      auto nb_csectors = ((l2_entry >> csize_shift) & csize_mask) + 1;
+      cluster_extent.compressed_length =
+        nb_csectors * COMPRESSED_SECTOR_SIZE -
+        (cluster_extent.host_offset & (COMPRESSED_SECTOR_SIZE - 1));
+    } else if (m_version >= 3 && (l2_entry & QCOW_OFLAG_ZERO) != 0) {
+      cluster_extent.type = CLUSTER_TYPE_ZERO;
+    } else if ((l2_entry & L2E_OFFSET_MASK) == 0) {
+      cluster_extent.type = CLUSTER_TYPE_UNALLOCATED;
+    } else {
+      cluster_extent.type = CLUSTER_TYPE_DATA;
+      cluster_extent.host_offset = (l2_entry & L2E_OFFSET_MASK) +
+                                   cluster_extent.cluster_offset;
+    }
+  }
+}
+
+template <typename I>
+void QCOWFormat<I>::read_backing(io::Extents&& image_extents,
+                                 bufferlist* data, Context* on_finish) {
+  if (m_backing_qcow) {
+    m_backing_qcow->read_extents(std::move(image_extents), data, on_finish);
+    return;
+  }
+
+  ceph_assert(m_backing_stream);
+  m_backing_stream->read(std::move(image_extents), data, on_finish);
+}
+
+} // namespace migration
+} // namespace librbd
+
+template class librbd::migration::QCOWFormat<librbd::ImageCtx>;
@@ -0,0 +1,194 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_MIGRATION_QCOW_FORMAT_H
+#define CEPH_LIBRBD_MIGRATION_QCOW_FORMAT_H
+
+#include "include/int_types.h"
+#include "include/buffer.h"
+#include "common/ceph_mutex.h"
+#include "librbd/Types.h"
+#include "librbd/migration/FormatInterface.h"
+#include "json_spirit/json_spirit.h"
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+struct Context;
+
+namespace librbd {
+
+struct ImageCtx;
+
+namespace migration {
+
+struct StreamInterface;
+
+/*
+ * Reads a QEMU qcow2 (version 2 or 3) image from a stream.
+ *
+ * The L1 table is loaded when the image is opened and L2 tables are loaded
+ * on demand into a small LRU cache. Clusters may be compressed (zlib).
+ * Unallocated clusters are read from the backing image, which must be a
+ * raw or qcow2 image, or are zero if there is none. Internal qcow2
+ * snapshots and encrypted images are not supported.
+ */
+template <typename ImageCtxT>
+class QCOWFormat : public FormatInterface {
+public:
+  static QCOWFormat* create(ImageCtxT* image_ctx,
+                            const json_spirit::mObject& json_object) {
+    return new QCOWFormat(image_ctx, json_object, 0);
+  }
+
+  // backing images are opened with a non-zero depth
+  QCOWFormat(ImageCtxT* image_ctx, const json_spirit::mObject& json_object,
+             uint32_t depth);
+  ~QCOWFormat() override;
+
+  QCOWFormat(const QCOWFormat&) = delete;
+  QCOWFormat& operator=(const QCOWFormat&) = delete;
+
+  void open(Context* on_finish) override;
+  void close(Context* on_finish) override;
+
+  void get_snapshots(SnapInfos* snap_infos, Context* on_finish) override;
+  void get_image_size(uint64_t snap_id, uint64_t* size,
+                      Context* on_finish) override;
+
+  bool read(io::AioCompletion* aio_comp, uint64_t snap_id,
+            io::Extents&& image_extents, io::ReadResult&& read_result,
+            int op_flags, int read_flags,
+            const ZTracer::Trace &parent_trace) override;
+
+  void list_snaps(io::Extents&& image_extents, io::SnapIds&& snap_ids,
+                  int list_snaps_flags, io::SnapshotDelta* snapshot_delta,
+                  const ZTracer::Trace &parent_trace,
+                  Context* on_finish) override;
+
+  // reads the image extents into a single buffer
+  void read_extents(io::Extents&& image_extents, bufferlist* data,
+                    Context* on_finish);
+
+private:
+  /**
+   * @verbatim
+   *
+   * <start>
+   *    |
+   *    v
+   * OPEN_STREAM
+   *    |
+   *    v
+   * GET_STREAM_SIZE
+   *    |
+   *    v
+   * READ_HEADER
+   *    |
+   *    v
+   * READ_HEADER_CLUSTER (header extensions and backing file name)
+   *    |
+   *    v
+   * READ_L1_TABLE
+   *    |
+   *    v
+   * OPEN_BACKING (skip if no backing file)
+   *    |
+   *    v
+   * <finish> (close stream on error)
+   *
+   * @endverbatim
+   */
+
+  enum ClusterType {
+    CLUSTER_TYPE_UNALLOCATED,
+    CLUSTER_TYPE_ZERO,
+    CLUSTER_TYPE_DATA,
+    CLUSTER_TYPE_COMPRESSED
+  };
+
+  struct L2Table;
+  struct ClusterExtent;
+  struct ReadRequest;
+  struct ListSnapsRequest;
+
+  typedef std::shared_ptr<L2Table> L2TableRef;
+  typedef std::map<uint64_t, L2TableRef> L2Tables;
+  typedef std::vector<ClusterExtent> ClusterExtents;
+
+  ImageCtxT* m_image_ctx;
+  json_spirit::mObject m_json_object;
+  uint32_t m_depth;
+
+  std::unique_ptr<StreamInterface> m_stream;
+  uint64_t m_stream_size = 0;
+
+  bufferlist m_bl;
+  uint32_t m_version = 0;
+  uint32_t m_cluster_bits = 0;
+  uint64_t m_cluster_size = 0;
+  uint32_t m_l2_bits = 0;
+  uint64_t m_size = 0;
+  uint64_t m_header_length = 0;
+  uint64_t m_backing_file_offset = 0;
+  uint32_t m_backing_file_size = 0;
+  std::string m_backing_file_name;
+  std::string m_backing_format;
+  uint32_t m_l1_size = 0;
+  uint64_t m_l1_table_offset = 0;
+  std::vector<uint64_t> m_l1_table;
+
+  std::unique_ptr<StreamInterface> m_backing_stream;
+  std::unique_ptr<QCOWFormat> m_backing_qcow;
+  uint64_t m_backing_size = 0;
+
+  ceph::mutex m_lock;
+  L2Tables m_l2_tables;
+  std::list<uint64_t> m_l2_lru;
+  uint64_t m_l2_cache_size = 0;
+
+  void open_stream(Context* on_finish);
+  void handle_open_stream(int r, Context* on_finish);
+
+  void get_stream_size(Context* on_finish);
+  void handle_get_stream_size(int r, Context* on_finish);
+
+  void read_header(Context* on_finish);
+  void handle_read_header(int r, Context* on_finish);
+
+  void read_header_cluster(Context* on_finish);
+  void handle_read_header_cluster(int r, Context* on_finish);
+
+  void read_l1_table(Context* on_finish);
+  void handle_read_l1_table(int r, Context* on_finish);
+
+  void open_backing(Context* on_finish);
+  void handle_open_backing(int r, Context* on_finish);
+
+  void handle_open(int r, Context* on_finish);
+
+  int parse_header_extensions();
+  int build_backing_spec(json_spirit::mObject* backing_spec);
+
+  void split_extents(const io::Extents& image_extents,
+                     ClusterExtents* cluster_extents,
+                     std::set<uint64_t>* l1_indexes) const;
+  void load_l2_tables(const std::set<uint64_t>& l1_indexes,
+                      L2Tables* l2_tables, Context* on_finish);
+  void handle_load_l2_table(int r, uint64_t l1_index, bufferlist&& bl);
+  void map_cluster_extents(const L2Tables& l2_tables,
+                           ClusterExtents* cluster_extents) const;
+
+  void read_backing(io::Extents&& image_extents, bufferlist* data,
+                    Context* on_finish);
+};
+
+} // namespace migration
+} // namespace librbd
+
+extern template class librbd::migration::QCOWFormat<librbd::ImageCtx>;
+
+#endif // CEPH_LIBRBD_MIGRATION_QCOW_FORMAT_H
@@ -6,12 +6,9 @@
 #include "librbd/ImageCtx.h"
 #include "librbd/io/AioCompletion.h"
 #include "librbd/io/ReadResult.h"
-#include "librbd/migration/FileStream.h"
+#include "librbd/migration/StreamBuilder.h"
 #include "librbd/migration/StreamInterface.h"
 
-static const std::string STREAM{"stream"};
-static const std::string STREAM_TYPE{"type"};
-
 #define dout_subsys ceph_subsys_rbd
 #undef dout_prefix
 #define dout_prefix *_dout << "librbd::migration::RawFormat: " << this \
@@ -31,30 +28,12 @@ void RawFormat<I>::open(Context* on_finish) {
   auto cct = m_image_ctx->cct;
   ldout(cct, 10) << dendl;
 
-  // TODO switch to stream builder when more available
-  auto& stream_value = m_json_object[STREAM];
-  if (stream_value.type() != json_spirit::obj_type) {
-    lderr(cct) << "missing stream section" << dendl;
-    on_finish->complete(-EINVAL);
-    return;
-  }
-
-  auto& stream_obj = stream_value.get_obj();
-  auto& stream_type_value = stream_obj[STREAM_TYPE];
-  if (stream_type_value.type() != json_spirit::str_type) {
-    lderr(cct) << "missing stream type value" << dendl;
-    on_finish->complete(-EINVAL);
-    return;
-  }
-
-  auto& stream_type = stream_type_value.get_str();
-  if (stream_type != "file") {
-    lderr(cct) << "unknown stream type '" << stream_type << "'" << dendl;
-    on_finish->complete(-EINVAL);
+  int r = StreamBuilder<I>::build(m_image_ctx, m_json_object, &m_stream);
+  if (r < 0) {
+    on_finish->complete(r);
     return;
   }
 
-  m_stream.reset(FileStream<I>::create(m_image_ctx, stream_obj));
   m_stream->open(on_finish);
 }
 
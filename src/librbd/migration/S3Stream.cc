@@ -0,0 +1,150 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "librbd/migration/S3Stream.h"
+#include "common/ceph_crypto.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include "include/buffer.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/migration/HttpClient.h"
+#include <boost/beast/http/field.hpp>
+#include <ctime>
+
+namespace librbd {
+namespace migration {
+
+namespace {
+
+const std::string URL_KEY {"url"};
+const std::string ACCESS_KEY {"access_key"};
+const std::string SECRET_KEY {"secret_key"};
+
+} // anonymous namespace
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::migration::S3Stream: " << this \
+                           << " " << __func__ << ": "
+
+template <typename I>
+S3Stream<I>::S3Stream(I* image_ctx, const json_spirit::mObject& json_object)
+  : m_image_ctx(image_ctx), m_cct(image_ctx->cct),
+    m_json_object(json_object), m_http_processor(this) {
+}
+
+template <typename I>
+S3Stream<I>::~S3Stream() {
+}
+
+template <typename I>
+void S3Stream<I>::open(Context* on_finish) {
+  auto& url_value = m_json_object[URL_KEY];
+  if (url_value.type() != json_spirit::str_type) {
+    lderr(m_cct) << "failed to locate '" << URL_KEY << "' key" << dendl;
+    on_finish->complete(-EINVAL);
+    return;
+  }
+
+  auto& access_key = m_json_object[ACCESS_KEY];
+  if (access_key.type() != json_spirit::str_type) {
+    lderr(m_cct) << "failed to locate '" << ACCESS_KEY << "' key" << dendl;
+    on_finish->complete(-EINVAL);
+    return;
+  }
+
+  auto& secret_key = m_json_object[SECRET_KEY];
+  if (secret_key.type() != json_spirit::str_type) {
+    lderr(m_cct) << "failed to locate '" << SECRET_KEY << "' key" << dendl;
+    on_finish->complete(-EINVAL);
+    return;
+  }
+
+  auto& url = url_value.get_str();
+  ldout(m_cct, 10) << "url=" << url << dendl;
+
+  m_access_key = access_key.get_str();
+  m_secret_key = secret_key.get_str();
+
+  m_http_client.reset(HttpClient<I>::create(m_image_ctx, url));
+  m_http_client->set_http_processor(&m_http_processor);
+  m_http_client->open(on_finish);
+}
+
+template <typename I>
+void S3Stream<I>::close(Context* on_finish) {
+  ldout(m_cct, 10) << dendl;
+
+  if (!m_http_client) {
+    on_finish->complete(0);
+    return;
+  }
+
+  m_http_client->close(on_finish);
+}
+
+template <typename I>
+void S3Stream<I>::get_size(uint64_t* size, Context* on_finish) {
+  ldout(m_cct, 10) << dendl;
+
+  m_http_client->get_size(size, on_finish);
+}
+
+template <typename I>
+void S3Stream<I>::read(io::Extents&& byte_extents, bufferlist* data,
+                       Context* on_finish) {
+  ldout(m_cct, 20) << "byte_extents=" << byte_extents << dendl;
+
+  m_http_client->read(std::move(byte_extents), data, on_finish);
+}
+
+template <typename I>
+void S3Stream<I>::process_request(EmptyRequest& request) {
+  ldout(m_cct, 20) << dendl;
+
+  // RFC 1123 date
+  char date[64];
+  auto now = time(nullptr);
+  struct tm tm;
+  gmtime_r(&now, &tm);
+  strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  request.set(boost::beast::http::field::date, date);
+
+  // path-style requests: the target is the canonicalized resource
+  auto target = std::string{request.target()};
+  auto query_pos = target.find('?');
+  if (query_pos != std::string::npos) {
+    target.resize(query_pos);
+  }
+
+  std::string string_to_sign;
+  string_to_sign += std::string{request.method_string()} + "\n";
+  string_to_sign += "\n";  // Content-MD5
+  string_to_sign += "\n";  // Content-Type
+  string_to_sign += std::string{date} + "\n";
+  string_to_sign += target;
+
+  unsigned char digest[CEPH_CRYPTO_HMACSHA1_DIGESTSIZE];
+  ceph::crypto::HMACSHA1 hmac(
+    reinterpret_cast<const unsigned char*>(m_secret_key.c_str()),
+    m_secret_key.size());
+  hmac.Update(reinterpret_cast<const unsigned char*>(string_to_sign.c_str()),
+              string_to_sign.size());
+  hmac.Final(digest);
+
+  bufferlist digest_bl;
+  digest_bl.append(reinterpret_cast<const char*>(digest), sizeof(digest));
+
+  bufferlist signature_bl;
+  digest_bl.encode_base64(signature_bl);
+
+  request.set(boost::beast::http::field::authorization,
+              "AWS " + m_access_key + ":" + signature_bl.to_str());
+
+  ldout(m_cct, 20) << "string_to_sign=" << string_to_sign << dendl;
+}
+
+} // namespace migration
+} // namespace librbd
+
+template class librbd::migration::S3Stream<librbd::ImageCtx>;
@@ -0,0 +1,66 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "librbd/migration/StreamBuilder.h"
+#include "common/dout.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/migration/FileStream.h"
+#include "librbd/migration/HttpStream.h"
+#include "librbd/migration/S3Stream.h"
+#include "librbd/migration/StreamInterface.h"
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::migration::StreamBuilder: " \
+                           << __func__ << ": "
+
+namespace librbd {
+namespace migration {
+
+namespace {
+
+const std::string STREAM{"stream"};
+const std::string STREAM_TYPE{"type"};
+
+} // anonymous namespace
+
+template <typename I>
+int StreamBuilder<I>::build(I* image_ctx,
+                            const json_spirit::mObject& format_object,
+                            std::unique_ptr<StreamInterface>* stream) {
+  auto cct = image_ctx->cct;
+
+  auto stream_it = format_object.find(STREAM);
+  if (stream_it == format_object.end() ||
+      stream_it->second.type() != json_spirit::obj_type) {
+    lderr(cct) << "missing stream section" << dendl;
+    return -EINVAL;
+  }
+
+  auto& stream_obj = stream_it->second.get_obj();
+  auto stream_type_it = stream_obj.find(STREAM_TYPE);
+  if (stream_type_it == stream_obj.end() ||
+      stream_type_it->second.type() != json_spirit::str_type) {
+    lderr(cct) << "missing stream type value" << dendl;
+    return -EINVAL;
+  }
+
+  auto& stream_type = stream_type_it->second.get_str();
+  if (stream_type == "file") {
+    stream->reset(FileStream<I>::create(image_ctx, stream_obj));
+  } else if (stream_type == "http") {
+    stream->reset(HttpStream<I>::create(image_ctx, stream_obj));
+  } else if (stream_type == "s3") {
+    stream->reset(S3Stream<I>::create(image_ctx, stream_obj));
+  } else {
+    lderr(cct) << "unknown stream type '" << stream_type << "'" << dendl;
+    return -EINVAL;
+  }
+
+  return 0;
+}
+
+} // namespace migration
+} // namespace librbd
+
+template struct librbd::migration::StreamBuilder<librbd::ImageCtx>;
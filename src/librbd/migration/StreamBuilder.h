@@ -0,0 +1,32 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_MIGRATION_STREAM_BUILDER_H
+#define CEPH_LIBRBD_MIGRATION_STREAM_BUILDER_H
+
+#include "include/int_types.h"
+#include <json_spirit/json_spirit.h>
+#include <memory>
+
+namespace librbd {
+
+struct ImageCtx;
+
+namespace migration {
+
+struct StreamInterface;
+
+template <typename ImageCtxT>
+struct StreamBuilder {
+  // builds the stream described by the "stream" section of a format spec
+  static int build(ImageCtxT* image_ctx,
+                   const json_spirit::mObject& format_object,
+                   std::unique_ptr<StreamInterface>* stream);
+};
+
+} // namespace migration
+} // namespace librbd
+
+extern template struct librbd::migration::StreamBuilder<librbd::ImageCtx>;
+
+#endif // CEPH_LIBRBD_MIGRATION_STREAM_BUILDER_H
@@ -0,0 +1,102 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "librbd/migration/Utils.h"
+#include "common/dout.h"
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/lexical_cast.hpp>
+#include <ostream>
+#include <regex>
+
+namespace librbd {
+namespace migration {
+namespace util {
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::migration::util::" << __func__ << ": "
+
+std::ostream& operator<<(std::ostream& os, UrlScheme url_scheme) {
+  switch (url_scheme) {
+  case URL_SCHEME_HTTP:
+    os << "http";
+    break;
+  case URL_SCHEME_HTTPS:
+    os << "https";
+    break;
+  default:
+    os << "unknown (" << static_cast<int>(url_scheme) << ")";
+    break;
+  }
+  return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const UrlSpec& url_spec) {
+  os << "[scheme=" << url_spec.scheme << ", "
+     << "host=" << url_spec.host << ", "
+     << "port=" << url_spec.port << ", "
+     << "path=" << url_spec.path << "]";
+  return os;
+}
+
+bool operator==(const UrlSpec& lhs, const UrlSpec& rhs) {
+  return (lhs.scheme == rhs.scheme && lhs.host == rhs.host &&
+          lhs.port == rhs.port && lhs.path == rhs.path);
+}
+
+int parse_url(CephContext* cct, const std::string& url, UrlSpec* url_spec) {
+  ldout(cct, 10) << "url=" << url << dendl;
+  *url_spec = UrlSpec{};
+
+  // scheme, host (optionally a bracketed IPv6 address), port and the
+  // remainder of the request target (path and query)
+  static const std::regex url_regex(
+    R"(^([A-Za-z][A-Za-z0-9+.-]*)://(\[[^\]/]+\]|[^/:?#\[\]]+))"
+    R"((?::([0-9]+))?([/?][^#]*)?(?:#.*)?$)");
+  std::smatch match;
+  if (!std::regex_match(url, match, url_regex)) {
+    lderr(cct) << "invalid url: '" << url << "'" << dendl;
+    return -EINVAL;
+  }
+
+  auto& scheme = match[1];
+  if (boost::iequals(scheme.str(), "http")) {
+    url_spec->scheme = URL_SCHEME_HTTP;
+    url_spec->port = "80";
+  } else if (boost::iequals(scheme.str(), "https")) {
+    url_spec->scheme = URL_SCHEME_HTTPS;
+    url_spec->port = "443";
+  } else {
+    lderr(cct) << "invalid url scheme: '" << url << "'" << dendl;
+    return -EINVAL;
+  }
+
+  url_spec->host = match[2];
+  if (url_spec->host.front() == '[') {
+    url_spec->host = url_spec->host.substr(1, url_spec->host.size() - 2);
+  }
+
+  auto& port = match[3];
+  if (port.matched) {
+    try {
+      boost::lexical_cast<uint16_t>(port.str());
+    } catch (boost::bad_lexical_cast&) {
+      lderr(cct) << "invalid url port: '" << url << "'" << dendl;
+      return -EINVAL;
+    }
+    url_spec->port = port;
+  }
+
+  auto& path = match[4];
+  if (path.matched) {
+    url_spec->path = path.str();
+    if (url_spec->path.front() != '/') {
+      url_spec->path.insert(0, "/");
+    }
+  }
+  return 0;
+}
+
+} // namespace util
+} // namespace migration
+} // namespace librbd
@@ -0,0 +1,45 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_MIGRATION_UTILS_H
+#define CEPH_LIBRBD_MIGRATION_UTILS_H
+
+#include "include/common_fwd.h"
+#include <iosfwd>
+#include <string>
+
+namespace librbd {
+namespace migration {
+namespace util {
+
+enum UrlScheme {
+  URL_SCHEME_HTTP,
+  URL_SCHEME_HTTPS,
+};
+
+std::ostream& operator<<(std::ostream& os, UrlScheme url_scheme);
+
+struct UrlSpec {
+  UrlSpec() {}
+  UrlSpec(UrlScheme scheme, const std::string& host, const std::string& port,
+          const std::string& path)
+    : scheme(scheme), host(host), port(port), path(path) {
+  }
+
+  UrlScheme scheme = URL_SCHEME_HTTP;
+  std::string host;
+  std::string port = "80";
+  std::string path = "/";
+};
+
+std::ostream& operator<<(std::ostream& os, const UrlSpec& url_spec);
+
+bool operator==(const UrlSpec& lhs, const UrlSpec& rhs);
+
+int parse_url(CephContext* cct, const std::string& url, UrlSpec* url_spec);
+
+} // namespace util
+} // namespace migration
+} // namespace librbd
+
+#endif // CEPH_LIBRBD_MIGRATION_UTILS_H
@@ -25,7 +25,7 @@
  */
 class MMgrConfigure : public Message {
 private:
-  static constexpr int HEAD_VERSION = 4;
+  static constexpr int HEAD_VERSION = 5;
   static constexpr int COMPAT_VERSION = 1;
 
 public:
@@ -38,6 +38,9 @@ public:
 
   boost::optional<MetricConfigMessage> metric_config_message;
 
+  // Send only the counters that changed since the previous report
+  bool stats_delta = false;
+
   void decode_payload() override
   {
     using ceph::decode;
@@ -52,6 +55,9 @@ public:
     if (header.version >= 4) {
       decode(metric_config_message, p);
     }
+    if (header.version >= 5) {
+      decode(stats_delta, p);
+    }
   }
 
   void encode_payload(uint64_t features) override {
@@ -60,12 +66,14 @@ public:
     encode(stats_threshold, payload);
     encode(osd_perf_metric_queries, payload);
     encode(metric_config_message, payload);
+    encode(stats_delta, payload);
   }
 
   std::string_view get_type_name() const override { return "mgrconfigure"; }
   void print(std::ostream& out) const override {
     out << get_type_name() << "(period=" << stats_period
-			   << ", threshold=" << stats_threshold << ")";
+			   << ", threshold=" << stats_threshold
+			   << (stats_delta ? ", delta" : "") << ")";
   }
 
 private:
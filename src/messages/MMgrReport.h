@@ -17,6 +17,7 @@
 
 #include <boost/optional.hpp>
 
+#include "include/denc.h"
 #include "msg/Message.h"
 #include "mgr/MetricTypes.h"
 #include "mgr/OSDPerfMetricTypes.h"
@@ -77,6 +78,18 @@ public:
 };
 WRITE_CLASS_ENCODER(PerfCounterType)
 
+/**
+ * The values of a counter as of the last report that carried them, which
+ * delta encoded reports are relative to.  Both ends of a session keep
+ * one per declared counter.
+ */
+struct PerfCounterReportedValue
+{
+  uint64_t value = 0;
+  uint64_t avgcount = 0;
+  uint64_t avgcount2 = 0;
+};
+
 class MMgrReport : public Message {
 private:
   static constexpr int HEAD_VERSION = 9;
@@ -97,6 +110,13 @@ public:
   // Decode: iterate over the types we know about, sorted by idx,
   // and use the current type's type to decide how to decode
   // the next bytes from the ceph::buffer::list.
+  //
+  // If the mgr asked for delta encoding in MMgrConfigure, the packed
+  // struct is version 2 and only carries the counters whose values
+  // changed since the previous report of the session: the number of
+  // changed counters, then a blob with, for each of them, the varint
+  // distance to the index of the previous changed counter (sorted by
+  // idx as above) followed by its encode_delta()'d values.
   ceph::buffer::list packed;
 
   std::string daemon_name;
@@ -160,6 +180,21 @@ public:
     encode(metric_report_message, payload);
   }
 
+  /// append the difference between two values of a counter, as a
+  /// zigzag varint
+  static void encode_delta(uint64_t from, uint64_t to,
+			   ceph::buffer::list::contiguous_appender &p) {
+    int64_t d = static_cast<int64_t>(to - from);
+    denc_varint((static_cast<uint64_t>(d) << 1) ^
+		static_cast<uint64_t>(d >> 63), p);
+  }
+  static uint64_t decode_delta(uint64_t from,
+			       ceph::buffer::ptr::const_iterator &p) {
+    uint64_t z = 0;
+    denc_varint(z, p);
+    return from + ((z >> 1) ^ -(z & 1));
+  }
+
   std::string_view get_type_name() const override { return "mgrreport"; }
   void print(std::ostream& out) const override {
     out << get_type_name() << "(";
@@ -151,6 +151,22 @@ public:
     }
   }
 
+  /// carry the same maps as @p other, whose payload has already been
+  /// encoded, for a peer with the same significant features.  the
+  /// encoded payload is shared rather than encoded again.
+  void share_payload(const MOSDMap &other) {
+    ceph_assert(!other.empty_payload());
+    fsid = other.fsid;
+    encode_features = other.encode_features;
+    incremental_maps = other.incremental_maps;
+    maps = other.maps;
+    oldest_map = other.oldest_map;
+    newest_map = other.newest_map;
+    header.version = other.header.version;
+    header.compat_version = other.header.compat_version;
+    payload = other.payload;
+  }
+
   std::string_view get_type_name() const override { return "osdmap"; }
   void print(std::ostream& out) const override {
     out << "osd_map(" << get_first() << ".." << get_last();
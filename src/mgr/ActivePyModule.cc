@@ -14,6 +14,7 @@
 #include "PyFormatter.h"
 
 #include "common/debug.h"
+#include "common/perf_counters.h"
 #include "mon/MonCommand.h"
 
 #include "ActivePyModule.h"
@@ -25,9 +26,27 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "mgr " << __func__ << " "
 
+ActivePyModule::~ActivePyModule()
+{
+  if (perf) {
+    g_ceph_context->get_perfcounters_collection()->remove(perf);
+    delete perf;
+  }
+}
+
 int ActivePyModule::load(ActivePyModules *py_modules)
 {
   ceph_assert(py_modules);
+
+  PerfCountersBuilder plb(g_ceph_context, "mgr-module-" + get_name(),
+                          l_mgr_module_first, l_mgr_module_last);
+  plb.add_time_avg(l_mgr_module_get_lat, "get_lat",
+                   "Latency of get() calls");
+  plb.add_time_avg(l_mgr_module_get_view_lat, "get_view_lat",
+                   "Latency of get_view() calls");
+  perf = plb.create_perf_counters();
+  g_ceph_context->get_perfcounters_collection()->add(perf);
+
   Gil gil(py_module->pMyThreadState, true);
 
   // We tell the module how we name it, so that it can be consistent
@@ -51,6 +70,14 @@ int ActivePyModule::load(ActivePyModules *py_modules)
   return 0;
 }
 
+void ActivePyModule::record_get(bool view, ceph::timespan elapsed)
+{
+  if (perf) {
+    perf->tinc(view ? l_mgr_module_get_view_lat : l_mgr_module_get_lat,
+               elapsed);
+  }
+}
+
 void ActivePyModule::notify(const std::string &notify_type, const std::string &notify_id)
 {
   if (is_dead()) {
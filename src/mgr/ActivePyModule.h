@@ -18,6 +18,7 @@
 // Python.h comes first because otherwise it clobbers ceph's assert
 #include "Python.h"
 
+#include "common/ceph_time.h"
 #include "common/cmdparse.h"
 #include "common/LogEntry.h"
 #include "common/Thread.h"
@@ -34,6 +35,14 @@ class ActivePyModule;
 class ActivePyModules;
 class MgrSession;
 class ModuleCommand;
+class PerfCounters;
+
+enum {
+  l_mgr_module_first = 102000,
+  l_mgr_module_get_lat,
+  l_mgr_module_get_view_lat,
+  l_mgr_module_last,
+};
 
 class ActivePyModule : public PyModuleRunner
 {
@@ -46,11 +55,15 @@ private:
   std::string m_command_perms;
   const MgrSession* m_session = nullptr;
 
+  // time spent by the module fetching cluster state
+  PerfCounters *perf = nullptr;
+
 public:
   ActivePyModule(const PyModuleRef &py_module_,
       LogChannelRef clog_)
     : PyModuleRunner(py_module_, clog_)
   {}
+  ~ActivePyModule();
 
   int load(ActivePyModules *py_modules);
   void notify(const std::string &notify_type, const std::string &notify_id);
@@ -58,6 +71,8 @@ public:
 
   bool method_exists(const std::string &method) const;
 
+  void record_get(bool view, ceph::timespan elapsed);
+
   PyObject *dispatch_remote(
       const std::string &method,
       PyObject *args,
@@ -18,6 +18,7 @@
 #include "include/stringify.h"
 
 #include "PyFormatter.h"
+#include "PyStateView.h"
 
 #include "osd/OSDMap.h"
 #include "mon/MonMap.h"
@@ -439,6 +440,177 @@ PyObject *ActivePyModules::get_python(const std::string &what)
   }
 }
 
+namespace {
+
+// random access to the items of an associative container
+template <typename Container>
+auto index_items(const Container &container)
+{
+  auto index = std::make_shared<
+    std::vector<typename Container::const_iterator>>();
+  index->reserve(container.size());
+  for (auto i = container.begin(); i != container.end(); ++i) {
+    index->push_back(i);
+  }
+  return index;
+}
+
+// the items mirror those of PGMap::dump_{pg,pool,osd}_stats()
+template <typename PGStat>
+void add_pg_stats(StateSnapshot *snapshot,
+		  const std::shared_ptr<const PGStat> &pg_stat)
+{
+  auto index = index_items(*pg_stat);
+  snapshot->add_list("pg_stats", index->size(),
+    [pg_stat, index](size_t n, Formatter *f) {
+      auto i = (*index)[n];
+      f->dump_stream("pgid") << i->first;
+      i->second.dump(f);
+    });
+}
+
+template <typename PoolSum, typename NumPG>
+void add_pool_stats(StateSnapshot *snapshot,
+		    const std::shared_ptr<const PoolSum> &pg_pool_sum,
+		    const std::shared_ptr<const NumPG> &num_pg_by_pool)
+{
+  auto index = index_items(*pg_pool_sum);
+  snapshot->add_list("pool_stats", index->size(),
+    [pg_pool_sum, num_pg_by_pool, index](size_t n, Formatter *f) {
+      auto p = (*index)[n];
+      f->dump_int("poolid", p->first);
+      auto q = num_pg_by_pool->find(p->first);
+      if (q != num_pg_by_pool->end()) {
+	f->dump_unsigned("num_pg", q->second);
+      }
+      p->second.dump(f);
+    });
+}
+
+template <typename OSDStat>
+void add_osd_stats(StateSnapshot *snapshot,
+		   const std::shared_ptr<const OSDStat> &osd_stat)
+{
+  auto index = index_items(*osd_stat);
+  snapshot->add_list("osd_stats", index->size(),
+    [osd_stat, index](size_t n, Formatter *f) {
+      auto q = (*index)[n];
+      f->dump_int("osd", q->first);
+      q->second.dump(f, false);
+    });
+}
+
+template <typename T>
+void copy_once(std::shared_ptr<const T> *copy, const T &t)
+{
+  if (!*copy) {
+    *copy = std::make_shared<const T>(t);
+  }
+}
+
+} // anonymous namespace
+
+std::shared_ptr<const StateSnapshot> ActivePyModules::get_snapshot(
+  const std::string &what)
+{
+  bool from_pg_map = (what == "pg_dump" || what == "pg_stats" ||
+		      what == "pool_stats" || what == "osd_stats");
+  if (!from_pg_map && what != "osd_map") {
+    return nullptr;
+  }
+
+  std::lock_guard l(snapshot_lock);
+  std::shared_ptr<const StateSnapshot> snapshot;
+
+  // Under the ClusterState/Objecter locks, only copy what the snapshot
+  // needs from a map version that wasn't seen yet. The OSDMap is dumped
+  // once from its copy, which is dropped afterwards.
+  if (!from_pg_map) {
+    std::shared_ptr<OSDMap> osd_map;
+    cluster_state.with_osdmap([&](const OSDMap &o) {
+      snapshot = snapshots.find(what, o.get_epoch());
+      if (!snapshot) {
+	osd_map = std::make_shared<OSDMap>();
+	osd_map->deepish_copy_from(o);
+      }
+    });
+    if (snapshot) {
+      return snapshot;
+    }
+    dout(10) << "taking " << what << " snapshot at version "
+	     << osd_map->get_epoch() << dendl;
+    auto s = std::make_shared<StateSnapshot>(what, osd_map->get_epoch());
+    s->add_dumped([&osd_map](Formatter *f) {
+      osd_map->dump(f);
+    });
+    return snapshots.add("osd_map", std::move(s));
+  }
+
+  std::shared_ptr<StateSnapshot> s;
+  cluster_state.with_pgmap([&](const PGMap &pg_map) {
+    snapshot = snapshots.find(what, pg_map.version);
+    if (snapshot) {
+      return;
+    }
+    dout(10) << "taking " << what << " snapshot at version "
+	     << pg_map.version << dendl;
+    if (pg_map_copy.version != pg_map.version) {
+      pg_map_copy = PGMapCopy{pg_map.version};
+    }
+    s = std::make_shared<StateSnapshot>(what, pg_map.version);
+    if (what == "pg_dump") {
+      // only the sums and deltas
+      s->add_dumped([&pg_map](Formatter *f) {
+	pg_map.dump_basic(f);
+      });
+    }
+    if (what == "pg_dump" || what == "pg_stats") {
+      copy_once(&pg_map_copy.pg_stat, pg_map.pg_stat);
+      add_pg_stats(s.get(), pg_map_copy.pg_stat);
+    }
+    if (what == "pg_dump" || what == "pool_stats") {
+      copy_once(&pg_map_copy.pg_pool_sum, pg_map.pg_pool_sum);
+      copy_once(&pg_map_copy.num_pg_by_pool, pg_map.num_pg_by_pool);
+      add_pool_stats(s.get(), pg_map_copy.pg_pool_sum,
+		     pg_map_copy.num_pg_by_pool);
+    }
+    if (what == "pg_dump" || what == "osd_stats") {
+      copy_once(&pg_map_copy.osd_stat, pg_map.osd_stat);
+      add_osd_stats(s.get(), pg_map_copy.osd_stat);
+    }
+  });
+  if (snapshot) {
+    return snapshot;
+  }
+  return snapshots.add("pg_map", std::move(s));
+}
+
+PyObject *ActivePyModules::get_view_python(const std::string &what,
+					   PyObject *views)
+{
+  // Taking a snapshot only blocks on the cluster maps' locks, and
+  // may copy a large map: drop the GIL meanwhile.
+  PyThreadState *tstate = PyEval_SaveThread();
+  auto snapshot = get_snapshot(what);
+  PyEval_RestoreThread(tstate);
+
+  if (!snapshot) {
+    return get_python(what);
+  }
+
+  // keep the items the view has converted so far
+  PyObject *view = PyDict_GetItemString(views, what.c_str());
+  if (view != nullptr && get_state_view_snapshot(view) == snapshot.get()) {
+    Py_INCREF(view);
+    return view;
+  }
+  view = construct_state_view(std::move(snapshot));
+  if (view != nullptr) {
+    PyDict_SetItemString(views, what.c_str(), view);
+  }
+  return view;
+}
+
 void ActivePyModules::start_one(PyModuleRef py_module)
 {
   std::lock_guard l(lock);
@@ -800,6 +972,19 @@ PyObject* ActivePyModules::get_latest_counter_python(
   return with_perf_counters(extract_latest_counters, svc_name, svc_id, path);
 }
 
+PyObject* ActivePyModules::get_perf_counters_exposition_python(
+    int prio_limit,
+    const std::set<std::string> &services)
+{
+  std::string exposition;
+  PyThreadState *tstate = PyEval_SaveThread();
+  daemon_state.enable_perf_exposition();
+  daemon_state.perf_exposition.render(prio_limit, services, &exposition);
+  PyEval_RestoreThread(tstate);
+
+  return PyUnicode_FromStringAndSize(exposition.data(), exposition.size());
+}
+
 PyObject* ActivePyModules::get_perf_schema_python(
     const std::string &svc_type,
     const std::string &svc_id)
@@ -30,6 +30,7 @@
 #include "DaemonState.h"
 #include "ClusterState.h"
 #include "OSDPerfMetricTypes.h"
+#include "StateSnapshot.h"
 
 class health_check_map_t;
 class DaemonServer;
@@ -62,6 +63,22 @@ private:
 
   mutable ceph::mutex lock = ceph::make_mutex("ActivePyModules::lock");
 
+  // snapshots handed out by get_view_python(), shared by all the modules
+  // until the map they were taken from changes
+  ceph::mutex snapshot_lock = ceph::make_mutex("ActivePyModules::snapshot_lock");
+  StateSnapshotCache snapshots;
+  // the PGMap containers copied for the snapshots of one version, each
+  // copied on first use and shared by all the snapshots listing it
+  struct PGMapCopy {
+    version_t version = 0;
+    std::shared_ptr<const decltype(PGMap::pg_stat)> pg_stat;
+    std::shared_ptr<const decltype(PGMap::pg_pool_sum)> pg_pool_sum;
+    std::shared_ptr<const decltype(PGMap::num_pg_by_pool)> num_pg_by_pool;
+    std::shared_ptr<const decltype(PGMap::osd_stat)> osd_stat;
+  } pg_map_copy;
+
+  std::shared_ptr<const StateSnapshot> get_snapshot(const std::string &what);
+
 public:
   ActivePyModules(PyModuleConfig &module_config,
             std::map<std::string, std::string> store_data,
@@ -76,6 +93,9 @@ public:
   Objecter  &get_objecter() {return objecter;}
   Client    &get_client() {return client;}
   PyObject *get_python(const std::string &what);
+  /// @p views holds the caller's views by name: one is returned again
+  /// as long as no newer snapshot was taken
+  PyObject *get_view_python(const std::string &what, PyObject *views);
   PyObject *get_server_python(const std::string &hostname);
   PyObject *list_servers_python();
   PyObject *get_metadata_python(
@@ -93,6 +113,9 @@ public:
   PyObject *get_perf_schema_python(
      const std::string &svc_type,
      const std::string &svc_id);
+  PyObject *get_perf_counters_exposition_python(
+     int prio_limit,
+     const std::set<std::string> &services);
   PyObject *get_context();
   PyObject *get_osdmap();
   PyObject *with_perf_counters(
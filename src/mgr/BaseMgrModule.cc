@@ -43,6 +43,8 @@ typedef struct {
   PyObject_HEAD
   ActivePyModules *py_modules;
   ActivePyModule *this_module;
+  // views returned by get_view(), by data name
+  PyObject *views;
 } BaseMgrModule;
 
 class MonCommandCompletion : public Context
@@ -367,7 +369,24 @@ ceph_state_get(BaseMgrModule *self, PyObject *args)
     return NULL;
   }
 
-  return self->py_modules->get_python(what);
+  auto start = ceph::mono_clock::now();
+  auto result = self->py_modules->get_python(what);
+  self->this_module->record_get(false, ceph::mono_clock::now() - start);
+  return result;
+}
+
+static PyObject*
+ceph_state_get_view(BaseMgrModule *self, PyObject *args)
+{
+  char *what = NULL;
+  if (!PyArg_ParseTuple(args, "s:ceph_state_get_view", &what)) {
+    return NULL;
+  }
+
+  auto start = ceph::mono_clock::now();
+  auto result = self->py_modules->get_view_python(what, self->views);
+  self->this_module->record_get(true, ceph::mono_clock::now() - start);
+  return result;
 }
 
 
@@ -634,6 +653,33 @@ get_perf_schema(BaseMgrModule *self, PyObject *args)
   return self->py_modules->get_perf_schema_python(type_str, svc_id);
 }
 
+static PyObject*
+get_perf_counters_exposition(BaseMgrModule *self, PyObject *args)
+{
+  int prio_limit = 0;
+  PyObject *services_list = nullptr;
+  if (!PyArg_ParseTuple(args, "iO:get_perf_counters_exposition",
+                        &prio_limit, &services_list)) {
+    return nullptr;
+  }
+
+  PyObject *services_iter = PyObject_GetIter(services_list);
+  if (services_iter == nullptr) {
+    return nullptr;
+  }
+  std::set<std::string> services;
+  while (PyObject *service = PyIter_Next(services_iter)) {
+    if (PyUnicode_Check(service)) {
+      services.insert(PyUnicode_AsUTF8(service));
+    }
+    Py_DECREF(service);
+  }
+  Py_DECREF(services_iter);
+
+  return self->py_modules->get_perf_counters_exposition_python(
+    prio_limit, services);
+}
+
 static PyObject *
 ceph_get_osdmap(BaseMgrModule *self, PyObject *args)
 {
@@ -1348,6 +1394,9 @@ PyMethodDef BaseMgrModule_methods[] = {
   {"_ceph_get", (PyCFunction)ceph_state_get, METH_VARARGS,
    "Get a cluster object"},
 
+  {"_ceph_get_view", (PyCFunction)ceph_state_get_view, METH_VARARGS,
+   "Get a read-only view of a cluster object"},
+
   {"_ceph_get_server", (PyCFunction)ceph_get_server, METH_VARARGS,
    "Get a server object"},
 
@@ -1393,6 +1442,10 @@ PyMethodDef BaseMgrModule_methods[] = {
   {"_ceph_get_perf_schema", (PyCFunction)get_perf_schema, METH_VARARGS,
     "Get the performance counter schema"},
 
+  {"_ceph_get_perf_counters_exposition",
+    (PyCFunction)get_perf_counters_exposition, METH_VARARGS,
+    "Get the latest perf counters in prometheus text format"},
+
   {"_ceph_log", (PyCFunction)ceph_log, METH_VARARGS,
    "Emit a (local) log message"},
 
@@ -1465,10 +1518,25 @@ BaseMgrModule_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
     BaseMgrModule *self;
 
     self = (BaseMgrModule *)type->tp_alloc(type, 0);
+    if (self == nullptr) {
+        return nullptr;
+    }
+    self->views = PyDict_New();
+    if (self->views == nullptr) {
+        Py_DECREF(self);
+        return nullptr;
+    }
 
     return (PyObject *)self;
 }
 
+static void
+BaseMgrModule_dealloc(BaseMgrModule *self)
+{
+    Py_CLEAR(self->views);
+    Py_TYPE(self)->tp_free(self);
+}
+
 static int
 BaseMgrModule_init(BaseMgrModule *self, PyObject *args, PyObject *kwds)
 {
@@ -1498,7 +1566,7 @@ PyTypeObject BaseMgrModuleType = {
   "ceph_module.BaseMgrModule", /* tp_name */
   sizeof(BaseMgrModule),     /* tp_basicsize */
   0,                         /* tp_itemsize */
-  0,                         /* tp_dealloc */
+  (destructor)BaseMgrModule_dealloc, /* tp_dealloc */
   0,                         /* tp_print */
   0,                         /* tp_getattr */
   0,                         /* tp_setattr */
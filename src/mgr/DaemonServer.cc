@@ -99,12 +99,28 @@ DaemonServer::DaemonServer(MonClient *monc_,
 }
 
 DaemonServer::~DaemonServer() {
+  if (perf) {
+    g_ceph_context->get_perfcounters_collection()->remove(perf);
+    delete perf;
+  }
   delete msgr;
   g_conf().remove_observer(this);
 }
 
 int DaemonServer::init(uint64_t gid, entity_addrvec_t client_addrs)
 {
+  PerfCountersBuilder plb(g_ceph_context, "mgr-server",
+                          l_mgr_server_first, l_mgr_server_last);
+  plb.add_u64_counter(l_mgr_server_report, "report",
+                      "Daemon reports received");
+  plb.add_u64_counter(l_mgr_server_report_bytes, "report_bytes",
+                      "Bytes of daemon reports received", NULL,
+                      PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
+  plb.add_time_avg(l_mgr_server_report_lat, "report_lat",
+                   "Latency of processing daemon reports");
+  perf = plb.create_perf_counters();
+  g_ceph_context->get_perfcounters_collection()->add(perf);
+
   // Initialize Messenger
   std::string public_msgr_type = g_conf()->ms_public_type.empty() ?
     g_conf().get_val<std::string>("ms_type") : g_conf()->ms_public_type;
@@ -563,6 +579,7 @@ void DaemonServer::update_task_status(
 
 bool DaemonServer::handle_report(const ref_t<MMgrReport>& m)
 {
+  const auto start = ceph::mono_clock::now();
   DaemonKey key;
   if (!m->service_name.empty()) {
     key.type = m->service_name;
@@ -634,6 +651,7 @@ bool DaemonServer::handle_report(const ref_t<MMgrReport>& m)
       std::lock_guard l(daemon->lock);
       auto &daemon_counters = daemon->perf_counters;
       daemon_counters.update(*m.get());
+      daemon_state.perf_exposition.update(key, daemon_counters);
 
       auto p = m->config_bl.cbegin();
       if (p != m->config_bl.end()) {
@@ -681,6 +699,10 @@ bool DaemonServer::handle_report(const ref_t<MMgrReport>& m)
     boost::apply_visitor(HandlePayloadVisitor(this), message.payload);
   }
 
+  perf->inc(l_mgr_server_report);
+  perf->inc(l_mgr_server_report_bytes,
+            m->get_payload().length() + m->get_data().length());
+  perf->tinc(l_mgr_server_report_lat, ceph::mono_clock::now() - start);
   return true;
 }
 
@@ -2882,6 +2904,7 @@ const char** DaemonServer::get_tracked_conf_keys() const
   static const char *KEYS[] = {
     "mgr_stats_threshold",
     "mgr_stats_period",
+    "mgr_stats_delta",
     nullptr
   };
 
@@ -2892,8 +2915,10 @@ void DaemonServer::handle_conf_change(const ConfigProxy& conf,
 				      const std::set <std::string> &changed)
 {
 
-  if (changed.count("mgr_stats_threshold") || changed.count("mgr_stats_period")) {
-    dout(4) << "Updating stats threshold/period on "
+  if (changed.count("mgr_stats_threshold") ||
+      changed.count("mgr_stats_period") ||
+      changed.count("mgr_stats_delta")) {
+    dout(4) << "Updating stats threshold/period/delta on "
             << daemon_connections.size() << " clients" << dendl;
     // Send a fresh MMgrConfigure to all clients, so that they can follow
     // the new policy for transmitting stats
@@ -2913,6 +2938,7 @@ void DaemonServer::_send_configure(ConnectionRef c)
   auto configure = make_message<MMgrConfigure>();
   configure->stats_period = g_conf().get_val<int64_t>("mgr_stats_period");
   configure->stats_threshold = g_conf().get_val<int64_t>("mgr_stats_threshold");
+  configure->stats_delta = g_conf().get_val<bool>("mgr_stats_delta");
 
   if (c->peer_is_osd()) {
     configure->osd_perf_metric_queries =
@@ -45,6 +45,14 @@ class CommandContext;
 struct OSDPerfMetricQuery;
 struct MDSPerfMetricQuery;
 
+enum {
+  l_mgr_server_first = 102100,
+  l_mgr_server_report,
+  l_mgr_server_report_bytes,
+  l_mgr_server_report_lat,
+  l_mgr_server_last,
+};
+
 /**
  * Server used in ceph-mgr to communicate with Ceph daemons like
  * MDSs and OSDs.
@@ -82,6 +90,8 @@ protected:
 
   ceph::mutex lock = ceph::make_mutex("DaemonServer");
 
+  PerfCounters *perf = nullptr;
+
   static void _generate_command_map(cmdmap_t& cmdmap,
                                     map<string,string> &param_str_map);
   static const MonCommand *_get_mgrcommand(const string &cmd_prefix,
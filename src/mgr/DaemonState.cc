@@ -186,6 +186,8 @@ void DaemonStateIndex::_erase(const DaemonKey& dmk)
     }
   }
 
+  perf_exposition.remove(dmk);
+
   auto &server_collection = by_server[dm->hostname];
   server_collection.erase(dm->key);
   if (server_collection.empty()) {
@@ -195,6 +197,18 @@ void DaemonStateIndex::_erase(const DaemonKey& dmk)
   all.erase(to_erase);
 }
 
+void DaemonStateIndex::enable_perf_exposition()
+{
+  if (!perf_exposition.enable()) {
+    return;
+  }
+  std::shared_lock l{lock};
+  for (auto &[key, state] : all) {
+    std::lock_guard dl(state->lock);
+    perf_exposition.update(key, state->perf_counters);
+  }
+}
+
 DaemonStateCollection DaemonStateIndex::get_by_service(
   const std::string& svc) const
 {
@@ -299,54 +313,106 @@ void DaemonStateIndex::cull_services(const std::set<std::string>& types_exist)
 }
 
 void DaemonPerfCounters::update(const MMgrReport& report)
+{
+  // Retrieve session state
+  auto priv = report.get_connection()->get_priv();
+  update(report, static_cast<MgrSession*>(priv.get()));
+}
+
+void DaemonPerfCounters::update(const MMgrReport& report,
+				MgrSession *session)
 {
   dout(20) << "loading " << report.declare_types.size() << " new types, "
 	   << report.undeclare_types.size() << " old types, had "
 	   << types.size() << " types, got "
            << report.packed.length() << " bytes of data" << dendl;
 
-  // Retrieve session state
-  auto priv = report.get_connection()->get_priv();
-  auto session = static_cast<MgrSession*>(priv.get());
-
   // Load any newly declared types
   for (const auto &t : report.declare_types) {
     types.insert(std::make_pair(t.path, t));
-    session->declared_types.insert(t.path);
+    session->declared_types[t.path] = PerfCounterReportedValue{};
   }
   // Remove any old types
   for (const auto &t : report.undeclare_types) {
     session->declared_types.erase(t);
   }
 
-  const auto now = ceph_clock_now();
+  if (slots_session_id != session->session_id ||
+      !report.declare_types.empty() ||
+      !report.undeclare_types.empty()) {
+    slots_session_id = session->session_id;
+    slots.clear();
+    slots.reserve(session->declared_types.size());
+    for (auto &[t_path, last] : session->declared_types) {
+      const auto &t = types.at(t_path);
+      auto instances_it = instances.find(t_path);
+      // Always check the instance exists, as we don't prevent yet
+      // multiple sessions from daemons with the same name, and one
+      // session clearing stats created by another on open.
+      if (instances_it == instances.end()) {
+	instances_it = instances.insert({t_path, t.type}).first;
+      }
+      slots.push_back({&t, &last, &instances_it->second});
+    }
+  }
 
   // Parse packed data according to declared set of types
   auto p = report.packed.cbegin();
-  DECODE_START(1, p);
-  for (const auto &t_path : session->declared_types) {
-    const auto &t = types.at(t_path);
-    auto instances_it = instances.find(t_path);
-    // Always check the instance exists, as we don't prevent yet
-    // multiple sessions from daemons with the same name, and one
-    // session clearing stats created by another on open.
-    if (instances_it == instances.end()) {
-      instances_it = instances.insert({t_path, t.type}).first;
+  DECODE_START(2, p);
+  if (struct_v < 2) {
+    for (auto &slot : slots) {
+      decode(slot.last->value, p);
+      if (slot.type->type & PERFCOUNTER_LONGRUNAVG) {
+	decode(slot.last->avgcount, p);
+	decode(slot.last->avgcount2, p);
+      }
     }
-    uint64_t val = 0;
-    uint64_t avgcount = 0;
-    uint64_t avgcount2 = 0;
-
-    decode(val, p);
-    if (t.type & PERFCOUNTER_LONGRUNAVG) {
-      decode(avgcount, p);
-      decode(avgcount2, p);
-      instances_it->second.push_avg(now, val, avgcount);
-    } else {
-      instances_it->second.push(now, val);
+  } else {
+    // only the counters that changed since the previous report
+    uint32_t changed;
+    decode(changed, p);
+    ceph::buffer::list deltas;
+    decode(deltas, p);
+    // an empty blob when nothing changed
+    if (changed > 0) {
+      if (deltas.length() == 0) {
+	throw ceph::buffer::end_of_buffer();
+      }
+      ceph::buffer::ptr tmp;
+      auto q = deltas.cbegin();
+      q.copy_shallow(deltas.length(), tmp);
+      auto d = std::cbegin(tmp);
+      size_t index = 0;
+      for (uint32_t i = 0; i < changed; ++i) {
+	uint32_t gap;
+	denc_varint(gap, d);
+	index += gap;
+	if (index >= slots.size()) {
+	  throw ceph::buffer::malformed_input("counter index out of range");
+	}
+	auto &slot = slots[index];
+	slot.last->value = MMgrReport::decode_delta(slot.last->value, d);
+	if (slot.type->type & PERFCOUNTER_LONGRUNAVG) {
+	  slot.last->avgcount = MMgrReport::decode_delta(slot.last->avgcount,
+							 d);
+	  slot.last->avgcount2 = MMgrReport::decode_delta(slot.last->avgcount2,
+							  d);
+	}
+      }
     }
   }
   DECODE_FINISH(p);
+
+  // unchanged counters still get a sample, so that rates and averages
+  // computed from the time series are the same as with full reports
+  const auto now = ceph_clock_now();
+  for (auto &slot : slots) {
+    if (slot.type->type & PERFCOUNTER_LONGRUNAVG) {
+      slot.instance->push_avg(now, slot.last->value, slot.last->avgcount);
+    } else {
+      slot.instance->push(now, slot.last->value);
+    }
+  }
 }
 
 void PerfCounterInstance::push(utime_t t, uint64_t const &v)
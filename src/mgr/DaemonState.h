@@ -28,6 +28,8 @@
 // For PerfCounterType
 #include "messages/MMgrReport.h"
 #include "DaemonKey.h"
+#include "MgrSession.h"
+#include "PerfCounterExposition.h"
 
 namespace ceph {
   class Formatter;
@@ -109,11 +111,29 @@ class DaemonPerfCounters
   std::map<std::string, PerfCounterInstance> instances;
 
   void update(const MMgrReport& report);
+  /// apply a report received on @p session
+  void update(const MMgrReport& report, MgrSession *session);
 
   void clear()
   {
     instances.clear();
+    slots.clear();
+    slots_session_id = 0;
   }
+
+  private:
+  // The declared counters of the session that sent the last report, in
+  // the order their values are packed, so that a report is applied in
+  // one pass instead of looking up every counter by path
+  struct Slot {
+    const PerfCounterType *type;
+    PerfCounterReportedValue *last;
+    PerfCounterInstance *instance;
+  };
+  // not a reference, so that the counters don't keep a closed session
+  // alive; the slots are rebuilt before they are used with another one
+  uint64_t slots_session_id = 0;
+  std::vector<Slot> slots;
 };
 
 // The state that we store about one daemon
@@ -279,6 +299,12 @@ public:
   // objects internally to avoid this.
   PerfCounterTypes types;
 
+  // the daemons' latest perf counters, rendered for prometheus
+  PerfCounterExposition perf_exposition;
+  /// start filling perf_exposition, from the counters of the daemons
+  /// that already reported
+  void enable_perf_exposition();
+
   void insert(DaemonStatePtr dm);
   void _insert(DaemonStatePtr dm);
   bool exists(const DaemonKey &key) const;
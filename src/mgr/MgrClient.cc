@@ -323,53 +323,93 @@ void MgrClient::_send_report()
       session->declared.erase(path);
     };
 
-    ENCODE_START(1, 1, report->packed);
+    const bool delta = session->stats_delta;
+    ENCODE_START(delta ? 2 : 1, delta ? 2 : 1, report->packed);
 
     // Find counters that no longer exist, and undeclare them
     for (auto p = session->declared.begin(); p != session->declared.end(); ) {
-      const auto &path = *(p++);
+      const auto &path = (p++)->first;
       if (by_path.count(path) == 0) {
         undeclare(path);
       }
     }
 
-    for (const auto &i : by_path) {
-      auto& path = i.first;
-      auto& data = *(i.second.data);
-      auto& perf_counters = *(i.second.perf_counters);
-
-      // Find counters that still exist, but are no longer permitted by
-      // stats_threshold
-      if (!include_counter(data, perf_counters)) {
-        if (session->declared.count(path)) {
-          undeclare(path);
+    // the varint index gaps and value deltas of the changed counters
+    ceph::buffer::list deltas;
+    uint32_t changed = 0;
+    uint32_t index = 0;
+    uint32_t last_changed = 0;
+    {
+      auto app = deltas.get_contiguous_appender(
+        delta ? by_path.size() * (5 + 3 * 10) : 0);
+
+      for (const auto &i : by_path) {
+        auto& path = i.first;
+        auto& data = *(i.second.data);
+        auto& perf_counters = *(i.second.perf_counters);
+
+        // Find counters that still exist, but are no longer permitted by
+        // stats_threshold
+        if (!include_counter(data, perf_counters)) {
+          if (session->declared.count(path)) {
+            undeclare(path);
+          }
+          continue;
         }
-        continue;
-      }
 
-      if (session->declared.count(path) == 0) {
-	ldout(cct,20) << " declare " << path << dendl;
-	PerfCounterType type;
-	type.path = path;
-	if (data.description) {
-	  type.description = data.description;
-	}
-	if (data.nick) {
-	  type.nick = data.nick;
-	}
-	type.type = data.type;
-       type.priority = perf_counters.get_adjusted_priority(data.prio);
-	type.unit = data.unit;
-	report->declare_types.push_back(std::move(type));
-	session->declared.insert(path);
-      }
+        auto last = session->declared.find(path);
+        if (last == session->declared.end()) {
+	  ldout(cct,20) << " declare " << path << dendl;
+	  PerfCounterType type;
+	  type.path = path;
+	  if (data.description) {
+	    type.description = data.description;
+	  }
+	  if (data.nick) {
+	    type.nick = data.nick;
+	  }
+	  type.type = data.type;
+	  type.priority = perf_counters.get_adjusted_priority(data.prio);
+	  type.unit = data.unit;
+	  report->declare_types.push_back(std::move(type));
+	  last = session->declared.emplace(path, PerfCounterReportedValue{}).first;
+        }
 
-      encode(static_cast<uint64_t>(data.u64), report->packed);
-      if (data.type & PERFCOUNTER_LONGRUNAVG) {
-        encode(static_cast<uint64_t>(data.avgcount), report->packed);
-        encode(static_cast<uint64_t>(data.avgcount2), report->packed);
+        PerfCounterReportedValue value;
+        value.value = data.u64;
+        if (data.type & PERFCOUNTER_LONGRUNAVG) {
+          value.avgcount = data.avgcount;
+          value.avgcount2 = data.avgcount2;
+        }
+        auto &sent = last->second;
+        if (!delta) {
+          encode(value.value, report->packed);
+          if (data.type & PERFCOUNTER_LONGRUNAVG) {
+            encode(value.avgcount, report->packed);
+            encode(value.avgcount2, report->packed);
+          }
+        } else if (value.value != sent.value ||
+                   value.avgcount != sent.avgcount ||
+                   value.avgcount2 != sent.avgcount2) {
+          denc_varint(index - last_changed, app);
+          MMgrReport::encode_delta(sent.value, value.value, app);
+          if (data.type & PERFCOUNTER_LONGRUNAVG) {
+            MMgrReport::encode_delta(sent.avgcount, value.avgcount, app);
+            MMgrReport::encode_delta(sent.avgcount2, value.avgcount2, app);
+          }
+          last_changed = index;
+          ++changed;
+        }
+        sent = value;
+        ++index;
       }
     }
+    if (delta) {
+      ldout(cct, 20) << changed << " of " << index << " counters changed"
+                     << dendl;
+      encode(changed, report->packed);
+      encode(deltas, report->packed);
+    }
     ENCODE_FINISH(report->packed);
 
     ldout(cct, 20) << "sending " << session->declared.size() << " counters ("
@@ -438,6 +478,11 @@ bool MgrClient::handle_mgr_configure(ref_t<MMgrConfigure> m)
 
   ldout(cct, 4) << "stats_period=" << m->stats_period << dendl;
 
+  if (session->stats_delta != m->stats_delta) {
+    ldout(cct, 4) << "delta encoded reports: " << m->stats_delta << dendl;
+    session->stats_delta = m->stats_delta;
+  }
+
   if (stats_threshold != m->stats_threshold) {
     ldout(cct, 4) << "updated stats threshold: " << m->stats_threshold << dendl;
     stats_threshold = m->stats_threshold;
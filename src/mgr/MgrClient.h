@@ -40,8 +40,12 @@ class MonMap;
 class MgrSessionState
 {
   public:
-  // Which performance counters have we already transmitted schema for?
-  std::set<std::string> declared;
+  // Which performance counters have we already transmitted schema for,
+  // and which values did we last send for them?
+  std::map<std::string, PerfCounterReportedValue> declared;
+
+  // Does the mgr want only the counters that changed in each report?
+  bool stats_delta = false;
 
   // Our connection to the mgr
   ConnectionRef con;
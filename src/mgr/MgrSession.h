@@ -4,9 +4,12 @@
 #ifndef CEPH_MGR_MGRSESSION_H
 #define CEPH_MGR_MGRSESSION_H
 
+#include <atomic>
+
 #include "common/RefCountedObj.h"
 #include "common/entity_name.h"
 #include "msg/msg_types.h"
+#include "messages/MMgrReport.h"
 #include "MgrCap.h"
 
 
@@ -14,6 +17,8 @@
  * Session state associated with the Connection.
  */
 struct MgrSession : public RefCountedObject {
+  // unique among the sessions of this mgr, unlike their addresses
+  const uint64_t session_id;
   uint64_t global_id = 0;
   EntityName entity_name;
   entity_inst_t inst;
@@ -22,7 +27,8 @@ struct MgrSession : public RefCountedObject {
 
   MgrCap caps;
 
-  std::set<std::string> declared_types;
+  // counters declared by the daemon, with the values it last reported
+  std::map<std::string, PerfCounterReportedValue> declared_types;
 
   const entity_addr_t& get_peer_addr() const {
     return inst.addr;
@@ -30,8 +36,14 @@ struct MgrSession : public RefCountedObject {
 
 private:
   FRIEND_MAKE_REF(MgrSession);
-  explicit MgrSession(CephContext *cct) : RefCountedObject(cct) {}
+  explicit MgrSession(CephContext *cct)
+    : RefCountedObject(cct), session_id(next_session_id()) {}
   ~MgrSession() override = default;
+
+  static uint64_t next_session_id() {
+    static std::atomic<uint64_t> last_session_id = {0};
+    return ++last_session_id;
+  }
 };
 
 using MgrSessionRef = ceph::ref_t<MgrSession>;
@@ -0,0 +1,264 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "PerfCounterExposition.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <regex>
+
+#include "DaemonState.h"
+
+namespace {
+
+// same as promethize() in the prometheus module
+std::string promethize(const std::string &path)
+{
+  bool trailing_minus = !path.empty() && path.back() == '-';
+  std::string name = "ceph_";
+  name.reserve(name.size() + path.size());
+  for (size_t i = 0; i < path.size(); ++i) {
+    char c = path[i];
+    if (c == '.' || c == '/' || isspace(static_cast<unsigned char>(c))) {
+      name += '_';
+    } else if (c == ':' && i + 1 < path.size() && path[i + 1] == ':') {
+      name += '_';
+      ++i;
+    } else if (c == '+') {
+      name += "_plus";
+    } else if (c == '-') {
+      if (!trailing_minus) {
+	name += '_';
+      } else if (i + 1 == path.size()) {
+	name += "_minus";
+      } else {
+	name += '-';
+      }
+    } else {
+      name += c;
+    }
+  }
+  return name;
+}
+
+// Go-compatible float, formatted like python's repr()
+std::string floatstr(double value)
+{
+  // fast path for integer values (counts, most counters)
+  if (value >= 0 && value < 1e16 && value == std::floor(value)) {
+    return std::to_string(static_cast<uint64_t>(value)) + ".0";
+  }
+  if (std::isinf(value)) {
+    return value > 0 ? "+Inf" : "-Inf";
+  } else if (std::isnan(value)) {
+    return "NaN";
+  }
+  char buf[32];
+  for (int precision = 15; precision <= 17; ++precision) {
+    snprintf(buf, sizeof(buf), "%.*g", precision, value);
+    if (strtod(buf, nullptr) == value) {
+      break;
+    }
+  }
+  std::string s(buf);
+  if (s.find_first_of(".en") == std::string::npos) {
+    s += ".0";
+  }
+  return s;
+}
+
+const std::regex rbd_mirror_image_re(
+  "^rbd_mirror_image_([^/]+)/(?:(?:([^/]+)/)?)(.*)\\.(replay(?:_bytes|_latency)?)$");
+const std::regex data_sync_re("^data-sync-from-(.*)\\.");
+const std::regex data_sync_zone_re("from-([^.]*)");
+
+} // anonymous namespace
+
+void PerfCounterExposition::update(const DaemonKey &key,
+				   const DaemonPerfCounters &counters)
+{
+  if (!enabled) {
+    return;
+  }
+  std::lock_guard l(lock);
+  auto &daemon = daemons[key];
+  bool changed = daemon.counters.size() != counters.instances.size();
+  if (!changed) {
+    auto c = daemon.counters.begin();
+    for (auto &[path, instance] : counters.instances) {
+      if ((c++)->path != path) {
+	changed = true;
+	break;
+      }
+    }
+  }
+  if (changed) {
+    _build(key, counters, &daemon);
+  }
+
+  for (auto lines : daemon.lines) {
+    lines->clear();
+  }
+  auto c = daemon.counters.begin();
+  for (auto &[path, instance] : counters.instances) {
+    auto &counter = *c++;
+    if (counter.outputs.empty()) {
+      continue;
+    }
+    std::string value, count;
+    if (counter.avg) {
+      if (instance.get_data_avg().empty()) {
+	continue;
+      }
+      auto &data = instance.get_latest_data_avg();
+      value = floatstr(data.s / counter.scale);
+      count = floatstr(data.c);
+    } else {
+      if (instance.get_data().empty()) {
+	continue;
+      }
+      value = floatstr(instance.get_latest_data().v / counter.scale);
+    }
+    for (auto &output : counter.outputs) {
+      output.lines->append(output.prefix).append(output.count ? count : value);
+    }
+  }
+}
+
+void PerfCounterExposition::_build(const DaemonKey &key,
+				   const DaemonPerfCounters &counters,
+				   Daemon *daemon)
+{
+  _clear(key, daemon);
+  const std::string daemon_name = ceph::to_string(key);
+  daemon->counters.reserve(counters.instances.size());
+  for (const auto &[counter_path, instance] : counters.instances) {
+    auto &counter = daemon->counters.emplace_back();
+    counter.path = counter_path;
+    auto t = counters.types.find(counter_path);
+    if (t == counters.types.end()) {
+      continue;
+    }
+    const auto &type = t->second;
+
+    const char *mtype;
+    switch (type.type & ~(PERFCOUNTER_TIME | PERFCOUNTER_U64)) {
+    case PERFCOUNTER_NONE:
+      mtype = "gauge";
+      break;
+    case PERFCOUNTER_LONGRUNAVG:
+    case PERFCOUNTER_COUNTER:
+      mtype = "counter";
+      break;
+    default:
+      // histograms are represented by their long running averages
+      continue;
+    }
+
+    std::string path = counter_path;
+    std::string labels = "ceph_daemon=\"" + daemon_name + "\"";
+    std::smatch match;
+    if (key.type == "rbd-mirror" &&
+	std::regex_match(counter_path, match, rbd_mirror_image_re)) {
+      path = "rbd_mirror_image_" + match.str(4);
+      labels += ",pool=\"" + match.str(1) + "\",namespace=\"" +
+	match.str(2) + "\",image=\"" + match.str(3) + "\"";
+    }
+
+    counter.scale = (type.type & PERFCOUNTER_TIME) ? 1000000000.0 : 1.0;
+    counter.avg = type.type & PERFCOUNTER_LONGRUNAVG;
+    if (counter.avg) {
+      _add_output(key, path + "_sum", mtype, type, " Total", labels, false,
+		  daemon, &counter);
+      _add_output(key, path + "_count", "counter", type, " Count", labels,
+		  true, daemon, &counter);
+    } else {
+      _add_output(key, path, mtype, type, "", labels, false, daemon,
+		  &counter);
+    }
+  }
+}
+
+void PerfCounterExposition::_add_output(const DaemonKey &key,
+					const std::string &path,
+					const char *type,
+					const PerfCounterType &counter_type,
+					const char *description_suffix,
+					const std::string &labels, bool count,
+					Daemon *daemon, Counter *counter)
+{
+  auto add = [&](const std::string &path, const std::string &labels) {
+    auto name = promethize(path);
+    auto &family = families[name];
+    if (family.header.empty()) {
+      family.header = "\n# HELP " + name + " " + counter_type.description +
+	description_suffix + "\n# TYPE " + name + " " + type;
+    }
+    auto &sample = family.samples[key];
+    sample.priority = counter_type.priority;
+    auto lines = &sample.lines;
+    if (daemon->families.insert(name).second) {
+      daemon->lines.push_back(lines);
+    }
+    counter->outputs.push_back(
+      {lines, "\n" + name + "{" + labels + "} ", count});
+  };
+  add(path, labels);
+
+  // rgw sync counters are also exported under a fixed name, with the
+  // zone as a label (see add_fixed_name_metrics() in the module)
+  std::smatch match;
+  if (path.compare(0, 15, "data-sync-from-") == 0 &&
+      std::regex_search(path, match, data_sync_re)) {
+    add(std::regex_replace(path, data_sync_zone_re, "from-zone"),
+	labels + ",source_zone=\"" + match.str(1) + "\"");
+  }
+}
+
+void PerfCounterExposition::_clear(const DaemonKey &key, Daemon *daemon)
+{
+  for (auto &name : daemon->families) {
+    auto family = families.find(name);
+    family->second.samples.erase(key);
+    if (family->second.samples.empty()) {
+      families.erase(family);
+    }
+  }
+  daemon->families.clear();
+  daemon->lines.clear();
+  daemon->counters.clear();
+}
+
+void PerfCounterExposition::remove(const DaemonKey &key)
+{
+  std::lock_guard l(lock);
+  auto daemon = daemons.find(key);
+  if (daemon == daemons.end()) {
+    return;
+  }
+  _clear(key, &daemon->second);
+  daemons.erase(daemon);
+}
+
+void PerfCounterExposition::render(int prio_limit,
+				   const std::set<std::string> &services,
+				   std::string *out) const
+{
+  std::lock_guard l(lock);
+  for (auto &[name, family] : families) {
+    bool empty = true;
+    for (auto &[key, sample] : family.samples) {
+      if (sample.lines.empty() || sample.priority < prio_limit ||
+	  services.count(key.type) == 0) {
+	continue;
+      }
+      if (empty) {
+	out->append(family.header);
+	empty = false;
+      }
+      out->append(sample.lines);
+    }
+  }
+}
@@ -0,0 +1,100 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common/ceph_mutex.h"
+
+#include "DaemonKey.h"
+
+class DaemonPerfCounters;
+class PerfCounterType;
+
+/**
+ * The latest values of the daemons' perf counters, in the prometheus
+ * text exposition format.
+ *
+ * The samples of a daemon are rendered when its report is processed, so
+ * that a scrape only concatenates strings; the metric names and labels
+ * of a daemon are only computed again when its set of counters changes.
+ * The output matches what the prometheus module builds from
+ * MgrModule.get_all_perf_counters():
+ * histograms are skipped, long running averages are exported as _sum
+ * and _count pairs, and rbd-mirror image and rgw data sync counters get
+ * the same labels.
+ *
+ * Nothing is kept until the exposition is first asked for, so that the
+ * reports do not pay for it when no module scrapes the counters.
+ */
+class PerfCounterExposition
+{
+public:
+  /// start keeping samples; returns true only on the first call, after
+  /// which the caller should update() every daemon that already reported
+  bool enable() {
+    return !enabled.exchange(true);
+  }
+  /// replace the samples of a daemon with its latest counter values
+  void update(const DaemonKey &key, const DaemonPerfCounters &counters);
+  void remove(const DaemonKey &key);
+
+  /// append the metrics with at least @p prio_limit priority, for the
+  /// daemons of the given service types, to @p out
+  void render(int prio_limit, const std::set<std::string> &services,
+	      std::string *out) const;
+
+private:
+  struct Sample {
+    int priority = 0;
+    std::string lines;
+  };
+
+  struct Family {
+    std::string header;
+    // sample lines of each daemon, which may each declare the counter
+    // with a different priority
+    std::map<DaemonKey, Sample> samples;
+  };
+
+  // one sample of a counter
+  struct Output {
+    std::string *lines;   // the daemon's sample lines in the family
+    std::string prefix;   // "\n<metric name>{<labels>} "
+    bool count;           // long running average count rather than value
+  };
+
+  struct Counter {
+    std::string path;
+    double scale = 1.0;
+    bool avg = false;
+    std::vector<Output> outputs;   // empty if not exported
+  };
+
+  // how the counters of a daemon are laid out in the families, rebuilt
+  // only when the daemon's set of counters changes
+  struct Daemon {
+    std::vector<Counter> counters;  // one per counter instance, in order
+    std::set<std::string> families;
+    std::vector<std::string*> lines;  // the daemon's samples in each family
+  };
+
+  std::atomic<bool> enabled = false;
+  mutable ceph::mutex lock = ceph::make_mutex("PerfCounterExposition::lock");
+  // metric name -> family
+  std::map<std::string, Family> families;
+  std::map<DaemonKey, Daemon> daemons;
+
+  void _build(const DaemonKey &key, const DaemonPerfCounters &counters,
+	      Daemon *daemon);
+  void _add_output(const DaemonKey &key, const std::string &path,
+		   const char *type, const PerfCounterType &counter_type,
+		   const char *description_suffix, const std::string &labels,
+		   bool count, Daemon *daemon, Counter *counter);
+  void _clear(const DaemonKey &key, Daemon *daemon);
+};
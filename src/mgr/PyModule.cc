@@ -14,6 +14,7 @@
 #include "BaseMgrModule.h"
 #include "BaseMgrStandbyModule.h"
 #include "PyOSDMap.h"
+#include "PyStateView.h"
 #include "MgrContext.h"
 #include "PyUtil.h"
 
@@ -296,6 +297,19 @@ PyObject* PyModule::init_ceph_module()
 
     PyModule_AddObject(ceph_module, name, (PyObject *)type);
   }
+  // views are only created by BaseMgrModule._ceph_get_view()
+  std::map<const char*, PyTypeObject*> view_classes{
+    {{"StateView", &StateViewType},
+     {"StateViewList", &StateViewListType}}
+  };
+  for (auto [name, type] : view_classes) {
+    if (PyType_Ready(type) < 0) {
+      ceph_abort();
+    }
+    Py_INCREF(type);
+
+    PyModule_AddObject(ceph_module, name, (PyObject *)type);
+  }
   return ceph_module;
 }
 
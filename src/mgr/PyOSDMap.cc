@@ -158,6 +158,59 @@ static PyObject *osdmap_calc_pg_upmaps(BasePyOSDMap* self, PyObject *args)
   return PyLong_FromLong(r);
 }
 
+static PyObject *osdmap_calc_pg_upmaps_parallel(BasePyOSDMap* self,
+						 PyObject *args)
+{
+  PyObject *pool_list;
+  BasePyOSDMapIncremental *incobj;
+  int max_deviation = 0;
+  int max_iterations = 0;
+  int num_threads = 1;
+  if (!PyArg_ParseTuple(args, "OiiOi:calc_pg_upmaps_parallel",
+			&incobj, &max_deviation,
+			&max_iterations, &pool_list, &num_threads)) {
+    return nullptr;
+  }
+  if (!PyList_CheckExact(pool_list)) {
+    derr << __func__ << " pool_list not a list" << dendl;
+    return nullptr;
+  }
+  vector<pair<int64_t,int>> pools;
+  for (auto i = 0; i < PyList_Size(pool_list); ++i) {
+    PyObject *pool = PyList_GET_ITEM(pool_list, i);
+    const char *pool_name = nullptr;
+    int pool_max = 0;
+    if (!PyArg_ParseTuple(pool, "si", &pool_name, &pool_max)) {
+      derr << __func__ << " " << pool << " not a (pool, max) tuple" << dendl;
+      return nullptr;
+    }
+    auto pool_id = self->osdmap->lookup_pg_pool_name(pool_name);
+    if (pool_id < 0) {
+      derr << __func__ << " pool '" << pool_name
+           << "' does not exist" << dendl;
+      return nullptr;
+    }
+    pools.emplace_back(pool_id, pool_max);
+  }
+
+  dout(10) << __func__ << " osdmap " << self->osdmap << " inc " << incobj->inc
+	   << " max_deviation " << max_deviation
+	   << " max_iterations " << max_iterations
+	   << " pools " << pools
+	   << " threads " << num_threads
+	   << dendl;
+  PyThreadState *tstate = PyEval_SaveThread();
+  int r = self->osdmap->calc_pg_upmaps_parallel(g_ceph_context,
+					  max_deviation,
+					  max_iterations,
+					  pools,
+					  std::max(num_threads, 1),
+					  incobj->inc);
+  PyEval_RestoreThread(tstate);
+  dout(10) << __func__ << " r = " << r << dendl;
+  return PyLong_FromLong(r);
+}
+
 static PyObject *osdmap_map_pool_pgs_up(BasePyOSDMap* self, PyObject *args)
 {
   int poolid;
@@ -287,6 +340,8 @@ PyMethodDef BasePyOSDMap_methods[] = {
    "Get pools that have CRUSH rules that TAKE the given root"},
   {"_calc_pg_upmaps", (PyCFunction)osdmap_calc_pg_upmaps, METH_VARARGS,
    "Calculate new pg-upmap values"},
+  {"_calc_pg_upmaps_parallel", (PyCFunction)osdmap_calc_pg_upmaps_parallel,
+   METH_VARARGS, "Calculate new pg-upmap values, balancing pools in parallel"},
   {"_map_pool_pgs_up", (PyCFunction)osdmap_map_pool_pgs_up, METH_VARARGS,
    "Calculate up set mappings for all PGs in a pool"},
   {"_pg_to_up_acting_osds", (PyCFunction)osdmap_pg_to_up_acting_osds, METH_VARARGS,
@@ -0,0 +1,407 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "PyStateView.h"
+
+#include "PyFormatter.h"
+#include "StateSnapshot.h"
+
+#include "include/stringify.h"
+
+typedef struct {
+  PyObject_HEAD
+  std::shared_ptr<const StateSnapshot> *snapshot;
+  // item name -> python object, for the items accessed so far
+  PyObject *cache;
+} StateView;
+
+typedef struct {
+  PyObject_HEAD
+  std::shared_ptr<const StateSnapshot> *snapshot;
+  const StateSnapshot::List *list;
+  // python objects for the items accessed so far, NULL for the others
+  PyObject *items;
+} StateViewList;
+
+// ----------
+
+static PyObject *construct_state_view_list(
+  const std::shared_ptr<const StateSnapshot> &snapshot,
+  const StateSnapshot::List *list)
+{
+  PyObject *items = PyList_New(list->size);
+  if (items == nullptr) {
+    return nullptr;
+  }
+  auto self = PyObject_New(StateViewList, &StateViewListType);
+  if (self == nullptr) {
+    Py_DECREF(items);
+    return nullptr;
+  }
+  self->snapshot = new std::shared_ptr<const StateSnapshot>(snapshot);
+  self->list = list;
+  self->items = items;
+  return (PyObject *)self;
+}
+
+static void
+StateViewList_dealloc(StateViewList *self)
+{
+  Py_CLEAR(self->items);
+  delete self->snapshot;
+  self->snapshot = nullptr;
+  Py_TYPE(self)->tp_free(self);
+}
+
+static Py_ssize_t state_view_list_length(StateViewList *self)
+{
+  return self->list->size;
+}
+
+static PyObject *state_view_list_item(StateViewList *self, Py_ssize_t i)
+{
+  if (i < 0 || static_cast<size_t>(i) >= self->list->size) {
+    PyErr_SetString(PyExc_IndexError, "StateViewList index out of range");
+    return nullptr;
+  }
+  PyObject *item = PyList_GET_ITEM(self->items, i);
+  if (item == nullptr) {
+    PyFormatter f;
+    self->list->dump_item(i, &f);
+    item = f.get();
+    PyList_SET_ITEM(self->items, i, item);
+  }
+  Py_INCREF(item);
+  return item;
+}
+
+static PyObject *state_view_list_subscript(StateViewList *self, PyObject *key)
+{
+  Py_ssize_t size = self->list->size;
+  if (PyIndex_Check(key)) {
+    Py_ssize_t i = PyNumber_AsSsize_t(key, PyExc_IndexError);
+    if (i == -1 && PyErr_Occurred()) {
+      return nullptr;
+    }
+    if (i < 0) {
+      i += size;
+    }
+    return state_view_list_item(self, i);
+  } else if (PySlice_Check(key)) {
+    Py_ssize_t start, stop, step, count;
+    if (PySlice_GetIndicesEx(key, size, &start, &stop, &step, &count) < 0) {
+      return nullptr;
+    }
+    PyObject *result = PyList_New(count);
+    if (result == nullptr) {
+      return nullptr;
+    }
+    for (Py_ssize_t n = 0; n < count; ++n) {
+      PyObject *item = state_view_list_item(self, start + n * step);
+      if (item == nullptr) {
+	Py_DECREF(result);
+	return nullptr;
+      }
+      PyList_SET_ITEM(result, n, item);
+    }
+    return result;
+  }
+  PyErr_Format(PyExc_TypeError,
+	       "StateViewList indices must be integers or slices, not %.200s",
+	       Py_TYPE(key)->tp_name);
+  return nullptr;
+}
+
+static PyObject *StateViewList_repr(StateViewList *self)
+{
+  auto &snapshot = *self->snapshot;
+  std::string repr = "<StateViewList " + snapshot->get_what() + "@" +
+    stringify(snapshot->get_version()) + " len=" +
+    stringify(self->list->size) + ">";
+  return PyUnicode_FromString(repr.c_str());
+}
+
+static PySequenceMethods StateViewList_as_sequence = {
+  (lenfunc)state_view_list_length,     /* sq_length */
+  0,                                   /* sq_concat */
+  0,                                   /* sq_repeat */
+  (ssizeargfunc)state_view_list_item,  /* sq_item */
+};
+
+static PyMappingMethods StateViewList_as_mapping = {
+  (lenfunc)state_view_list_length,          /* mp_length */
+  (binaryfunc)state_view_list_subscript,    /* mp_subscript */
+  0,                                        /* mp_ass_subscript */
+};
+
+PyTypeObject StateViewListType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "ceph_module.StateViewList", /* tp_name */
+  sizeof(StateViewList),     /* tp_basicsize */
+  0,                         /* tp_itemsize */
+  (destructor)StateViewList_dealloc,      /* tp_dealloc */
+  0,                         /* tp_print */
+  0,                         /* tp_getattr */
+  0,                         /* tp_setattr */
+  0,                         /* tp_compare */
+  (reprfunc)StateViewList_repr,           /* tp_repr */
+  0,                         /* tp_as_number */
+  &StateViewList_as_sequence,             /* tp_as_sequence */
+  &StateViewList_as_mapping,              /* tp_as_mapping */
+  0,                         /* tp_hash */
+  0,                         /* tp_call */
+  0,                         /* tp_str */
+  0,                         /* tp_getattro */
+  0,                         /* tp_setattro */
+  0,                         /* tp_as_buffer */
+  Py_TPFLAGS_DEFAULT,        /* tp_flags */
+  "Read-only list view of a cluster state snapshot", /* tp_doc */
+};
+
+// ----------
+
+PyObject *construct_state_view(std::shared_ptr<const StateSnapshot> snapshot)
+{
+  PyObject *cache = PyDict_New();
+  if (cache == nullptr) {
+    return nullptr;
+  }
+  auto self = PyObject_New(StateView, &StateViewType);
+  if (self == nullptr) {
+    Py_DECREF(cache);
+    return nullptr;
+  }
+  self->snapshot = new std::shared_ptr<const StateSnapshot>(
+    std::move(snapshot));
+  self->cache = cache;
+  return (PyObject *)self;
+}
+
+const StateSnapshot *get_state_view_snapshot(PyObject *obj)
+{
+  if (!PyObject_TypeCheck(obj, &StateViewType)) {
+    return nullptr;
+  }
+  return reinterpret_cast<StateView*>(obj)->snapshot->get();
+}
+
+static void
+StateView_dealloc(StateView *self)
+{
+  Py_CLEAR(self->cache);
+  delete self->snapshot;
+  self->snapshot = nullptr;
+  Py_TYPE(self)->tp_free(self);
+}
+
+static Py_ssize_t state_view_length(StateView *self)
+{
+  return (*self->snapshot)->get_keys().size();
+}
+
+// returns a new reference, or nullptr without setting an error if
+// the snapshot has no such item
+static PyObject *state_view_lookup(StateView *self, PyObject *key)
+{
+  PyObject *value = PyDict_GetItemWithError(self->cache, key);
+  if (value != nullptr) {
+    Py_INCREF(value);
+    return value;
+  } else if (PyErr_Occurred() || !PyUnicode_Check(key)) {
+    PyErr_Clear();
+    return nullptr;
+  }
+
+  auto &snapshot = *self->snapshot;
+  std::string name = PyUnicode_AsUTF8(key);
+  if (!snapshot->has_key(name)) {
+    return nullptr;
+  }
+
+  auto list = snapshot->get_list(name);
+  if (list != nullptr) {
+    value = construct_state_view_list(snapshot, list);
+    if (value == nullptr) {
+      PyErr_Clear();
+      return nullptr;
+    }
+  } else {
+    PyFormatter f;
+    snapshot->dump_value(name, &f);
+    PyObject *dumped = f.get();
+    value = PyDict_GetItem(dumped, key);
+    if (value == nullptr) {
+      value = Py_None;
+    }
+    Py_INCREF(value);
+    Py_DECREF(dumped);
+  }
+  PyDict_SetItem(self->cache, key, value);
+  return value;
+}
+
+static PyObject *state_view_subscript(StateView *self, PyObject *key)
+{
+  PyObject *value = state_view_lookup(self, key);
+  if (value == nullptr) {
+    PyErr_SetObject(PyExc_KeyError, key);
+  }
+  return value;
+}
+
+static int state_view_contains(StateView *self, PyObject *key)
+{
+  if (!PyUnicode_Check(key)) {
+    return 0;
+  }
+  return (*self->snapshot)->has_key(PyUnicode_AsUTF8(key));
+}
+
+static PyObject *state_view_keys(StateView *self, PyObject *args)
+{
+  auto &keys = (*self->snapshot)->get_keys();
+  PyObject *result = PyList_New(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    PyList_SET_ITEM(result, i, PyUnicode_FromString(keys[i].c_str()));
+  }
+  return result;
+}
+
+static PyObject *state_view_iter(StateView *self)
+{
+  PyObject *keys = state_view_keys(self, nullptr);
+  PyObject *iter = PyObject_GetIter(keys);
+  Py_DECREF(keys);
+  return iter;
+}
+
+static PyObject *state_view_values(StateView *self, PyObject *args)
+{
+  auto &keys = (*self->snapshot)->get_keys();
+  PyObject *result = PyList_New(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    PyObject *key = PyUnicode_FromString(keys[i].c_str());
+    PyObject *value = state_view_lookup(self, key);
+    Py_DECREF(key);
+    if (value == nullptr) {
+      value = Py_None;
+      Py_INCREF(value);
+    }
+    PyList_SET_ITEM(result, i, value);
+  }
+  return result;
+}
+
+static PyObject *state_view_items(StateView *self, PyObject *args)
+{
+  auto &keys = (*self->snapshot)->get_keys();
+  PyObject *result = PyList_New(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    PyObject *key = PyUnicode_FromString(keys[i].c_str());
+    PyObject *value = state_view_lookup(self, key);
+    if (value == nullptr) {
+      value = Py_None;
+      Py_INCREF(value);
+    }
+    PyList_SET_ITEM(result, i, PyTuple_Pack(2, key, value));
+    Py_DECREF(key);
+    Py_DECREF(value);
+  }
+  return result;
+}
+
+static PyObject *state_view_get(StateView *self, PyObject *args)
+{
+  PyObject *key = nullptr;
+  PyObject *default_value = Py_None;
+  if (!PyArg_ParseTuple(args, "O|O:get", &key, &default_value)) {
+    return nullptr;
+  }
+  PyObject *value = state_view_lookup(self, key);
+  if (value == nullptr) {
+    Py_INCREF(default_value);
+    value = default_value;
+  }
+  return value;
+}
+
+static PyObject *state_view_get_version(StateView *self, void *closure)
+{
+  return PyLong_FromUnsignedLongLong((*self->snapshot)->get_version());
+}
+
+static PyObject *StateView_repr(StateView *self)
+{
+  auto &snapshot = *self->snapshot;
+  std::string repr = "<StateView " + snapshot->get_what() + "@" +
+    stringify(snapshot->get_version()) + ">";
+  return PyUnicode_FromString(repr.c_str());
+}
+
+static PyMethodDef StateView_methods[] = {
+  {"keys", (PyCFunction)state_view_keys, METH_NOARGS,
+   "Return the names of the top level items"},
+  {"values", (PyCFunction)state_view_values, METH_NOARGS,
+   "Return all the top level items, converting them if needed"},
+  {"items", (PyCFunction)state_view_items, METH_NOARGS,
+   "Return (name, item) pairs, converting the items if needed"},
+  {"get", (PyCFunction)state_view_get, METH_VARARGS,
+   "Return an item, or the default value if there is no such item"},
+  {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef StateView_getset[] = {
+  {const_cast<char*>("version"), (getter)state_view_get_version, nullptr,
+   const_cast<char*>("Map version (epoch) of the snapshot"), nullptr},
+  {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+static PySequenceMethods StateView_as_sequence = {
+  0,                                   /* sq_length */
+  0,                                   /* sq_concat */
+  0,                                   /* sq_repeat */
+  0,                                   /* sq_item */
+  0,                                   /* was_sq_slice */
+  0,                                   /* sq_ass_item */
+  0,                                   /* was_sq_ass_slice */
+  (objobjproc)state_view_contains,     /* sq_contains */
+};
+
+static PyMappingMethods StateView_as_mapping = {
+  (lenfunc)state_view_length,          /* mp_length */
+  (binaryfunc)state_view_subscript,    /* mp_subscript */
+  0,                                   /* mp_ass_subscript */
+};
+
+PyTypeObject StateViewType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "ceph_module.StateView",   /* tp_name */
+  sizeof(StateView),         /* tp_basicsize */
+  0,                         /* tp_itemsize */
+  (destructor)StateView_dealloc,      /* tp_dealloc */
+  0,                         /* tp_print */
+  0,                         /* tp_getattr */
+  0,                         /* tp_setattr */
+  0,                         /* tp_compare */
+  (reprfunc)StateView_repr,  /* tp_repr */
+  0,                         /* tp_as_number */
+  &StateView_as_sequence,    /* tp_as_sequence */
+  &StateView_as_mapping,     /* tp_as_mapping */
+  0,                         /* tp_hash */
+  0,                         /* tp_call */
+  0,                         /* tp_str */
+  0,                         /* tp_getattro */
+  0,                         /* tp_setattro */
+  0,                         /* tp_as_buffer */
+  Py_TPFLAGS_DEFAULT,        /* tp_flags */
+  "Read-only view of a cluster state snapshot", /* tp_doc */
+  0,                         /* tp_traverse */
+  0,                         /* tp_clear */
+  0,                         /* tp_richcompare */
+  0,                         /* tp_weaklistoffset */
+  (getiterfunc)state_view_iter,       /* tp_iter */
+  0,                         /* tp_iternext */
+  StateView_methods,         /* tp_methods */
+  0,                         /* tp_members */
+  StateView_getset,          /* tp_getset */
+};
@@ -0,0 +1,25 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <Python.h>
+
+#include <memory>
+
+class StateSnapshot;
+
+extern PyTypeObject StateViewType;
+extern PyTypeObject StateViewListType;
+
+/**
+ * Wrap a snapshot in a read-only, dict-like ceph_module.StateView. Items
+ * are converted to python objects on first access and then cached in the
+ * view; arrays added with StateSnapshot::add_list() are returned as
+ * list-like ceph_module.StateViewList objects that convert their items
+ * one at a time.
+ */
+PyObject *construct_state_view(std::shared_ptr<const StateSnapshot> snapshot);
+
+/// the snapshot behind a StateView, or nullptr if @p obj isn't one
+const StateSnapshot *get_state_view_snapshot(PyObject *obj);
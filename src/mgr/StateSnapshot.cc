@@ -0,0 +1,284 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "StateSnapshot.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <sstream>
+#include <variant>
+
+#include "include/ceph_assert.h"
+
+namespace {
+
+/*
+ * The formatter calls that dumped one top level item, replayed whenever
+ * the item is accessed.
+ */
+class Recording
+{
+public:
+  enum Type {
+    OPEN_ARRAY, OPEN_OBJECT, CLOSE, UNSIGNED, INT, FLOAT, BOOL, STRING,
+    STREAM, FORMAT, FORMAT_UNQUOTED,
+  };
+
+  struct Op {
+    Type type;
+    std::string name;
+    std::variant<std::monostate, uint64_t, int64_t, double, bool,
+		 std::string> value;
+  };
+
+  std::vector<Op> ops;
+
+  void replay(ceph::Formatter *f) const {
+    for (auto &op : ops) {
+      switch (op.type) {
+      case OPEN_ARRAY:
+	f->open_array_section(op.name);
+	break;
+      case OPEN_OBJECT:
+	f->open_object_section(op.name);
+	break;
+      case CLOSE:
+	f->close_section();
+	break;
+      case UNSIGNED:
+	f->dump_unsigned(op.name, std::get<uint64_t>(op.value));
+	break;
+      case INT:
+	f->dump_int(op.name, std::get<int64_t>(op.value));
+	break;
+      case FLOAT:
+	f->dump_float(op.name, std::get<double>(op.value));
+	break;
+      case BOOL:
+	f->dump_bool(op.name, std::get<bool>(op.value));
+	break;
+      case STRING:
+	f->dump_string(op.name, std::get<std::string>(op.value));
+	break;
+      case STREAM:
+	f->dump_stream(op.name) << std::get<std::string>(op.value);
+	break;
+      case FORMAT:
+	f->dump_format(op.name, "%s",
+		       std::get<std::string>(op.value).c_str());
+	break;
+      case FORMAT_UNQUOTED:
+	f->dump_format_unquoted(op.name, "%s",
+				std::get<std::string>(op.value).c_str());
+	break;
+      }
+    }
+  }
+};
+
+/*
+ * Records a dump into one Recording per top level item.
+ */
+class SplitFormatter : public ceph::Formatter
+{
+public:
+  // the top level items, in dump order
+  std::vector<std::pair<std::string, std::shared_ptr<Recording>>> items;
+
+  void enable_line_break() override {}
+  void flush(std::ostream& os) override {}
+  void reset() override {}
+  void set_status(int status, const char* status_name) override {}
+  void output_header() override {}
+  void output_footer() override {}
+  int get_len() const override {
+    return 0;
+  }
+  void write_raw_data(const char *data) override {}
+
+  void open_array_section(std::string_view name) override {
+    add(Recording::OPEN_ARRAY, name, {});
+    ++depth;
+  }
+  void open_array_section_in_ns(std::string_view name,
+				const char *ns) override {
+    open_array_section(name);
+  }
+  void open_object_section(std::string_view name) override {
+    add(Recording::OPEN_OBJECT, name, {});
+    ++depth;
+  }
+  void open_object_section_in_ns(std::string_view name,
+				 const char *ns) override {
+    open_object_section(name);
+  }
+  void close_section() override {
+    ceph_assert(depth > 0);
+    add(Recording::CLOSE, {}, {});
+    --depth;
+  }
+
+  void dump_unsigned(std::string_view name, uint64_t u) override {
+    add(Recording::UNSIGNED, name, u);
+  }
+  void dump_int(std::string_view name, int64_t s) override {
+    add(Recording::INT, name, s);
+  }
+  void dump_float(std::string_view name, double d) override {
+    add(Recording::FLOAT, name, d);
+  }
+  void dump_string(std::string_view name, std::string_view s) override {
+    add(Recording::STRING, name, std::string(s));
+  }
+  void dump_bool(std::string_view name, bool b) override {
+    add(Recording::BOOL, name, b);
+  }
+  std::ostream& dump_stream(std::string_view name) override {
+    add(Recording::STREAM, name, std::string());
+    stream_op = &current->ops.back();
+    return stream;
+  }
+  void dump_format_va(std::string_view name, const char *ns, bool quoted,
+		      const char *fmt, va_list ap) override {
+    va_list aq;
+    va_copy(aq, ap);
+    int len = vsnprintf(nullptr, 0, fmt, aq);
+    va_end(aq);
+    std::string buf(std::max(len, 0), '\0');
+    vsnprintf(buf.data(), buf.size() + 1, fmt, ap);
+    add(quoted ? Recording::FORMAT : Recording::FORMAT_UNQUOTED, name,
+	std::move(buf));
+  }
+
+  /// completes the last item once the dump is over
+  void finish() {
+    ceph_assert(depth == 0);
+    finish_stream();
+  }
+
+private:
+  unsigned depth = 0;
+  Recording *current = nullptr;
+  // the output of dump_stream() goes into the last op
+  Recording::Op *stream_op = nullptr;
+  std::ostringstream stream;
+
+  void finish_stream() {
+    if (stream_op != nullptr) {
+      stream_op->value = stream.str();
+      stream_op = nullptr;
+      stream.str("");
+      stream.clear();
+    }
+  }
+
+  void add(Recording::Type type, std::string_view name,
+	   decltype(Recording::Op::value) &&value) {
+    finish_stream();
+    if (depth == 0) {
+      auto recording = std::make_shared<Recording>();
+      current = recording.get();
+      items.emplace_back(name, std::move(recording));
+    }
+    current->ops.push_back(Recording::Op{type, std::string(name),
+					 std::move(value)});
+  }
+};
+
+} // anonymous namespace
+
+void StateSnapshot::add_value(const std::string &name, Dumper &&dumper)
+{
+  ceph_assert(!has_key(name));
+  keys.push_back(name);
+  values.emplace(name, std::move(dumper));
+}
+
+void StateSnapshot::add_list(const std::string &name, size_t size,
+			     ItemDumper &&dumper)
+{
+  ceph_assert(!has_key(name));
+  keys.push_back(name);
+  lists.emplace(name, List{size, std::move(dumper)});
+}
+
+void StateSnapshot::add_dumped(const Dumper &dumper)
+{
+  SplitFormatter split;
+  dumper(&split);
+  split.finish();
+
+  for (auto &[name, recording] : split.items) {
+    if (has_key(name)) {
+      continue;
+    }
+    add_value(name, [recording=std::move(recording)](ceph::Formatter *f) {
+      recording->replay(f);
+    });
+  }
+}
+
+const StateSnapshot::List *StateSnapshot::get_list(
+  const std::string &name) const
+{
+  auto i = lists.find(name);
+  if (i == lists.end()) {
+    return nullptr;
+  }
+  return &i->second;
+}
+
+void StateSnapshot::dump_value(const std::string &name,
+			       ceph::Formatter *f) const
+{
+  auto i = values.find(name);
+  ceph_assert(i != values.end());
+  i->second(f);
+}
+
+std::shared_ptr<const StateSnapshot> StateSnapshotCache::get(
+  const std::string &what, const std::string &map, version_t version,
+  const Builder &build)
+{
+  auto snapshot = find(what, version);
+  if (snapshot) {
+    return snapshot;
+  }
+
+  auto s = std::make_shared<StateSnapshot>(what, version);
+  build(s.get());
+  return add(map, std::move(s));
+}
+
+std::shared_ptr<const StateSnapshot> StateSnapshotCache::find(
+  const std::string &what, version_t version) const
+{
+  auto i = snapshots.find(what);
+  if (i != snapshots.end() && i->second.snapshot->get_version() == version) {
+    return i->second.snapshot;
+  }
+  return nullptr;
+}
+
+std::shared_ptr<const StateSnapshot> StateSnapshotCache::add(
+  const std::string &map, std::shared_ptr<const StateSnapshot> snapshot)
+{
+  auto version = snapshot->get_version();
+  auto &entry = snapshots[snapshot->get_what()];
+  entry.map = map;
+  entry.snapshot = std::move(snapshot);
+  auto result = entry.snapshot;
+
+  // keep at most one copy of each map around for the modules that
+  // haven't asked for it yet
+  for (auto i = snapshots.begin(); i != snapshots.end(); ) {
+    if (i->second.map == map &&
+	i->second.snapshot->get_version() != version) {
+      i = snapshots.erase(i);
+    } else {
+      ++i;
+    }
+  }
+  return result;
+}
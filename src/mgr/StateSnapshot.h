@@ -0,0 +1,113 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "include/types.h"
+#include "common/Formatter.h"
+
+/**
+ * An immutable snapshot of one of the cluster-wide objects that python
+ * modules fetch with get(), taken at a given map version.
+ *
+ * A snapshot holds one dumper per top level item, so that each item is
+ * only converted when it is accessed. Small items are recorded from a
+ * single dump of the map when the snapshot is taken; large arrays
+ * (e.g. pg_stats) are bound to a private copy of their container and
+ * dumped item by item.
+ *
+ * Snapshots never touch python and may be shared between modules.
+ */
+class StateSnapshot
+{
+public:
+  // dumps exactly one named item into the formatter
+  typedef std::function<void(ceph::Formatter*)> Dumper;
+  // dumps the fields of the n'th array item into the open object
+  typedef std::function<void(size_t, ceph::Formatter*)> ItemDumper;
+
+  struct List {
+    size_t size = 0;
+    ItemDumper dump_item;
+  };
+
+  StateSnapshot(const std::string &what, version_t version)
+    : what(what), version(version)
+  {}
+
+  StateSnapshot(const StateSnapshot&) = delete;
+  StateSnapshot& operator=(const StateSnapshot&) = delete;
+
+  /// add a top level item dumped by @p dumper
+  void add_value(const std::string &name, Dumper &&dumper);
+  /// add a top level array whose items are dumped one at a time
+  void add_list(const std::string &name, size_t size, ItemDumper &&dumper);
+  /// run @p dumper once, and add every top level item it emits but
+  /// those already added, each of them replaying its part of the dump
+  void add_dumped(const Dumper &dumper);
+
+  const std::string &get_what() const {
+    return what;
+  }
+  version_t get_version() const {
+    return version;
+  }
+  /// top level item names, in dump order
+  const std::vector<std::string> &get_keys() const {
+    return keys;
+  }
+  bool has_key(const std::string &name) const {
+    return values.count(name) || lists.count(name);
+  }
+  /// returns nullptr if @p name is not an array added with add_list()
+  const List *get_list(const std::string &name) const;
+
+  /// dump the named (non list) item into @p f
+  void dump_value(const std::string &name, ceph::Formatter *f) const;
+
+private:
+  std::string what;
+  version_t version;
+
+  std::vector<std::string> keys;
+  std::map<std::string, Dumper> values;
+  std::map<std::string, List> lists;
+};
+
+/**
+ * The latest snapshots of each kind, shared by every module until the map
+ * they were taken from changes. Not thread safe.
+ */
+class StateSnapshotCache
+{
+public:
+  typedef std::function<void(StateSnapshot*)> Builder;
+
+  /// return the snapshot of @p what at @p version, using @p build to fill
+  /// it in unless it was already taken
+  std::shared_ptr<const StateSnapshot> get(const std::string &what,
+					   const std::string &map,
+					   version_t version,
+					   const Builder &build);
+
+  /// return the snapshot of @p what at @p version, or nullptr
+  std::shared_ptr<const StateSnapshot> find(const std::string &what,
+					    version_t version) const;
+  /// add a snapshot taken from @p map. Snapshots of other versions of
+  /// @p map are forgotten, though views holding them keep them alive.
+  std::shared_ptr<const StateSnapshot> add(
+    const std::string &map, std::shared_ptr<const StateSnapshot> snapshot);
+
+private:
+  struct Entry {
+    std::string map;
+    std::shared_ptr<const StateSnapshot> snapshot;
+  };
+  std::map<std::string, Entry> snapshots;
+};
@@ -236,12 +236,9 @@ void LogMonitor::update_from_paxos(bool *need_bootstrap)
     ceph_assert(err == 0);
     ceph_assert(bl.length());
 
-    auto p = bl.cbegin();
-    __u8 v;
-    decode(v, p);
-    while (!p.end()) {
-      LogEntry le;
-      le.decode(p);
+    vector<LogEntry> entries;
+    _decode_entries(bl, &entries);
+    for (auto& le : entries) {
       dout(7) << "update_from_paxos applying incremental log " << summary.version+1 <<  " " << le << dendl;
 
       string channel = le.channel;
@@ -303,7 +300,7 @@ void LogMonitor::update_from_paxos(bool *need_bootstrap)
     }
 
     summary.version++;
-    summary.prune(g_conf()->mon_log_max_summary);
+    _prune_summary(&summary);
   }
 
   dout(15) << __func__ << " logging for "
@@ -350,15 +347,49 @@ void LogMonitor::encode_pending(MonitorDBStore::TransactionRef t)
   version_t version = get_last_committed() + 1;
   bufferlist bl;
   dout(10) << __func__ << " v" << version << dendl;
-  __u8 v = 1;
-  encode(v, bl);
-  for (auto p = pending_log.begin(); p != pending_log.end(); ++p)
-    p->second.encode(bl, mon->get_quorum_con_features());
+  uint64_t raw_bytes = _encode_entries(bl);
+  mon->logger->inc(l_mon_log_bytes, raw_bytes);
+  mon->logger->inc(l_mon_log_stored_bytes, bl.length());
 
   put_version(t, version, bl);
   put_last_committed(t, version);
 }
 
+/**
+ * encode the pending entries of a new version
+ *
+ * @param bl	where to encode them
+ * @return	the length of the entries before they were compressed
+ */
+uint64_t LogMonitor::_encode_entries(bufferlist& bl)
+{
+  __u8 v = 1;
+  if (mon->get_required_mon_features().contains_all(
+	ceph::features::mon::FEATURE_LOG_CHUNKS)) {
+    v = 2;
+  }
+  auto alg = Compressor::get_comp_alg_type(
+    g_conf().get_val<string>("mon_cluster_log_compression"));
+  return codec.encode(pending_log, v, mon->get_quorum_con_features(),
+		      alg ? *alg : Compressor::COMP_ALG_NONE, bl);
+}
+
+/**
+ * decode the entries of a version, in the order they were logged
+ *
+ * @param bl	a version as encoded by _encode_entries()
+ * @param entries	where to put the entries
+ */
+void LogMonitor::_decode_entries(const bufferlist& bl,
+				 vector<LogEntry> *entries)
+{
+  ostringstream err;
+  if (codec.decode(bl, entries, &err) < 0) {
+    derr << __func__ << " " << err.str() << dendl;
+    ceph_abort_msg("unable to decompress cluster log entries");
+  }
+}
+
 void LogMonitor::encode_full(MonitorDBStore::TransactionRef t)
 {
   dout(10) << __func__ << " log v " << summary.version << dendl;
@@ -494,9 +525,12 @@ bool LogMonitor::prepare_log(MonOpRequestRef op)
     if (!pending_summary.contains(p->key())) {
       pending_summary.add(*p);
       pending_log.insert(pair<utime_t,LogEntry>(p->stamp, *p));
+      mon->logger->inc(l_mon_log_entries);
+    } else {
+      mon->logger->inc(l_mon_log_dup);
     }
   }
-  pending_summary.prune(g_conf()->mon_log_max_summary);
+  _prune_summary(&pending_summary);
   wait_for_finished_proposal(op, new C_Log(this, op));
   return true;
 }
@@ -713,8 +747,9 @@ bool LogMonitor::prepare_command(MonOpRequestRef op)
     le.channel = CLOG_CHANNEL_DEFAULT;
     le.msg = str_join(logtext, " ");
     pending_summary.add(le);
-    pending_summary.prune(g_conf()->mon_log_max_summary);
+    _prune_summary(&pending_summary);
     pending_log.insert(pair<utime_t,LogEntry>(le.stamp, le));
+    mon->logger->inc(l_mon_log_entries);
     wait_for_finished_proposal(op, new Monitor::C_Command(
           mon, op, 0, string(), get_last_committed() + 1));
     return true;
@@ -821,13 +856,9 @@ void LogMonitor::_create_sub_incremental(MLog *mlog, int level, version_t sv)
     int err = get_version(sv, bl);
     ceph_assert(err == 0);
     ceph_assert(bl.length());
-    auto p = bl.cbegin();
-    __u8 v;
-    decode(v,p);
-    while (!p.end()) {
-      LogEntry le;
-      le.decode(p);
-
+    vector<LogEntry> entries;
+    _decode_entries(bl, &entries);
+    for (auto& le : entries) {
       if (le.prio < level) {
 	dout(20) << __func__ << " requested " << level 
 		 << " entry " << le.prio << dendl;
@@ -930,6 +961,42 @@ void LogMonitor::update_log_channels()
   channels.expand_channel_meta();
 }
 
+void LogMonitor::update_summary_retention()
+{
+  ostringstream oss;
+  map<string,string> max_by_channel;
+  int r = get_conf_str_map_helper(
+    g_conf().get_val<string>("mon_log_max_summary_by_channel"), oss,
+    &max_by_channel, CLOG_CONFIG_DEFAULT_KEY);
+  if (r < 0) {
+    derr << __func__ << " error parsing 'mon_log_max_summary_by_channel'"
+	 << dendl;
+    return;
+  }
+
+  summary_max_by_channel.clear();
+  for (auto& [channel, value] : max_by_channel) {
+    string err;
+    long long max = strict_strtoll(value.c_str(), 10, &err);
+    if (!err.empty() || max < 0) {
+      derr << __func__ << " invalid retention '" << value
+	   << "' for channel '" << channel << "'" << dendl;
+      continue;
+    }
+    summary_max_by_channel[channel] = max;
+  }
+}
+
+void LogMonitor::_prune_summary(LogSummary *s)
+{
+  size_t max = g_conf()->mon_log_max_summary;
+  auto p = summary_max_by_channel.find(CLOG_CONFIG_DEFAULT_KEY);
+  if (p != summary_max_by_channel.end()) {
+    max = p->second;
+  }
+  s->prune(summary_max_by_channel, max);
+}
+
 
 void LogMonitor::handle_conf_change(const ConfigProxy& conf,
                                     const std::set<std::string> &changed)
@@ -944,4 +1011,7 @@ void LogMonitor::handle_conf_change(const ConfigProxy& conf,
       changed.count("mon_cluster_log_to_graylog_port")) {
     update_log_channels();
   }
+  if (changed.count("mon_log_max_summary_by_channel")) {
+    update_summary_retention();
+  }
 }
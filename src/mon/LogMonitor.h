@@ -23,6 +23,7 @@
 
 #include "common/config_fwd.h"
 #include "common/LogEntry.h"
+#include "LogVersionCodec.h"
 #include "include/str_map.h"
 
 class MLog;
@@ -41,6 +42,10 @@ private:
   std::multimap<utime_t,LogEntry> pending_log;
   LogSummary pending_summary, summary;
 
+  // channel -> number of recent entries kept in the summary
+  std::map<std::string,size_t> summary_max_by_channel;
+  LogVersionCodec codec;
+
   struct log_channel_info {
 
     std::map<std::string,std::string> log_to_syslog;
@@ -113,6 +118,12 @@ private:
   } channels;
 
   void update_log_channels();
+  void update_summary_retention();
+  void _prune_summary(LogSummary *s);
+
+  uint64_t _encode_entries(ceph::buffer::list& bl);
+  void _decode_entries(const ceph::buffer::list& bl,
+		       std::vector<LogEntry> *entries);
 
   void create_initial() override;
   void update_from_paxos(bool *need_bootstrap) override;
@@ -144,12 +155,14 @@ private:
 
  public:
   LogMonitor(Monitor *mn, Paxos *p, const std::string& service_name) 
-    : PaxosService(mn, p, service_name) { }
+    : PaxosService(mn, p, service_name),
+      codec(g_ceph_context) { }
 
   void init() override {
     generic_dout(10) << "LogMonitor::init" << dendl;
     g_conf().add_observer(this);
     update_log_channels();
+    update_summary_retention();
   }
   
   void tick() override;  // check state, take actions
@@ -179,6 +192,7 @@ private:
       "mon_cluster_log_to_graylog",
       "mon_cluster_log_to_graylog_host",
       "mon_cluster_log_to_graylog_port",
+      "mon_log_max_summary_by_channel",
       NULL
     };
     return KEYS;
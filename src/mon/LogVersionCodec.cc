@@ -0,0 +1,170 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "LogVersionCodec.h"
+
+#include <algorithm>
+
+#include "common/debug.h"
+
+#define dout_subsys ceph_subsys_mon
+#undef dout_prefix
+#define dout_prefix *_dout << "LogVersionCodec::" << __func__ << " "
+
+using ceph::bufferlist;
+
+namespace {
+
+/// the entries of one channel in a format 2 version
+struct log_chunk_t {
+  std::string channel;
+  uint32_t num_entries = 0;
+  __u8 alg = Compressor::COMP_ALG_NONE;
+  boost::optional<int32_t> compressor_message;
+  uint32_t raw_length = 0;  ///< length of the entries once decompressed
+  bufferlist data;
+
+  void encode(bufferlist& bl) const {
+    ENCODE_START(1, 1, bl);
+    encode(channel, bl);
+    encode(num_entries, bl);
+    encode(alg, bl);
+    encode(compressor_message, bl);
+    encode(raw_length, bl);
+    encode(data, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::const_iterator& p) {
+    DECODE_START(1, p);
+    decode(channel, p);
+    decode(num_entries, p);
+    decode(alg, p);
+    decode(compressor_message, p);
+    decode(raw_length, p);
+    decode(data, p);
+    DECODE_FINISH(p);
+  }
+};
+WRITE_CLASS_ENCODER(log_chunk_t)
+
+} // anonymous namespace
+
+CompressorRef LogVersionCodec::get_compressor(int alg)
+{
+  auto& compressor = compressors[alg];
+  if (!compressor) {
+    compressor = Compressor::create(cct, alg);
+  }
+  return compressor;
+}
+
+uint64_t LogVersionCodec::encode(const std::multimap<utime_t,LogEntry>& entries,
+				 __u8 v, uint64_t features,
+				 Compressor::CompressionAlgorithm alg,
+				 bufferlist& bl)
+{
+  using ceph::encode;
+  encode(v, bl);
+  if (v < 2) {
+    auto start = bl.length();
+    for (auto& [stamp, le] : entries)
+      le.encode(bl, features);
+    return bl.length() - start;
+  }
+
+  std::map<std::string,log_chunk_t> chunks;
+  for (auto& [stamp, le] : entries) {
+    auto& chunk = chunks[le.channel];
+    le.encode(chunk.data, features);
+    ++chunk.num_entries;
+  }
+
+  CompressorRef compressor;
+  if (alg != Compressor::COMP_ALG_NONE) {
+    compressor = get_compressor(alg);
+  }
+
+  uint64_t raw_bytes = 0;
+  encode((uint32_t)chunks.size(), bl);
+  for (auto& [channel, chunk] : chunks) {
+    chunk.channel = channel;
+    chunk.raw_length = chunk.data.length();
+    raw_bytes += chunk.raw_length;
+    if (compressor) {
+      bufferlist out;
+      boost::optional<int32_t> compressor_message;
+      if (compressor->compress(chunk.data, out, compressor_message) == 0 &&
+	  out.length() < chunk.data.length()) {
+	chunk.alg = compressor->get_type();
+	chunk.compressor_message = compressor_message;
+	chunk.data.swap(out);
+      }
+    }
+    ldout(cct, 20) << "channel '" << channel << "' "
+		   << chunk.num_entries << " entries, " << chunk.raw_length
+		   << " bytes, " << chunk.data.length() << " stored" << dendl;
+    encode(chunk, bl);
+  }
+  return raw_bytes;
+}
+
+int LogVersionCodec::decode(const bufferlist& bl,
+			    std::vector<LogEntry> *entries,
+			    std::ostream *err)
+{
+  using ceph::decode;
+  auto p = bl.cbegin();
+  __u8 v;
+  decode(v, p);
+  if (v < 2) {
+    while (!p.end()) {
+      LogEntry le;
+      le.decode(p);
+      entries->push_back(std::move(le));
+    }
+    return 0;
+  }
+
+  uint32_t num_chunks;
+  decode(num_chunks, p);
+  while (num_chunks--) {
+    log_chunk_t chunk;
+    decode(chunk, p);
+    bufferlist raw;
+    if (chunk.alg == Compressor::COMP_ALG_NONE) {
+      raw.swap(chunk.data);
+    } else {
+      auto compressor = get_compressor(chunk.alg);
+      if (!compressor ||
+	  compressor->decompress(chunk.data, raw,
+				 chunk.compressor_message) < 0 ||
+	  raw.length() != chunk.raw_length) {
+	*err << "unable to decompress the entries of channel '"
+	     << chunk.channel << "' with "
+	     << Compressor::get_comp_alg_name(chunk.alg);
+	return -EIO;
+      }
+    }
+    auto q = raw.cbegin();
+    for (uint32_t i = 0; i < chunk.num_entries; ++i) {
+      LogEntry le;
+      le.decode(q);
+      entries->push_back(std::move(le));
+    }
+  }
+  // the chunks split the entries by channel
+  std::stable_sort(entries->begin(), entries->end(),
+		   [](const LogEntry& a, const LogEntry& b) {
+		     return a.stamp < b.stamp;
+		   });
+  return 0;
+}
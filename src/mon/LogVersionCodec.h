@@ -0,0 +1,66 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_LOGVERSIONCODEC_H
+#define CEPH_LOGVERSIONCODEC_H
+
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "common/LogEntry.h"
+#include "compressor/Compressor.h"
+
+/**
+ * Encodes the entries of a LogMonitor version, and decodes them again
+ *
+ * Format 1 is the entries one after the other.  Format 2, used once the
+ * quorum has FEATURE_LOG_CHUNKS, holds one chunk per channel, so that
+ * the (similar) messages of a channel compress together.
+ */
+class LogVersionCodec {
+  CephContext *cct;
+  // algorithm -> compressor for the chunks
+  std::map<int,CompressorRef> compressors;
+
+  CompressorRef get_compressor(int alg);
+
+public:
+  explicit LogVersionCodec(CephContext *cct) : cct(cct) {}
+
+  /**
+   * encode the entries of a version
+   *
+   * @param entries	the entries, by stamp
+   * @param v		format to encode
+   * @param features	features to encode the entries with
+   * @param alg		compression of the chunks of format 2
+   * @param bl		where to encode them
+   * @return		the length of the entries before they were compressed
+   */
+  uint64_t encode(const std::multimap<utime_t,LogEntry>& entries, __u8 v,
+		  uint64_t features, Compressor::CompressionAlgorithm alg,
+		  ceph::buffer::list& bl);
+
+  /**
+   * decode the entries of a version, in the order they were logged
+   *
+   * @param bl		a version as encoded by encode()
+   * @param entries	where to put the entries
+   * @param err		why the version could not be decoded
+   * @return		0, or -EIO if a chunk cannot be decompressed
+   */
+  int decode(const ceph::buffer::list& bl, std::vector<LogEntry> *entries,
+	     std::ostream *err);
+};
+
+#endif
@@ -752,6 +752,24 @@ int Monitor::preinit()
         "ewon", PerfCountersBuilder::PRIO_INTERESTING);
     pcb.add_u64_counter(l_mon_election_lose, "election_lose", "Elections lost",
         "elst", PerfCountersBuilder::PRIO_INTERESTING);
+    pcb.add_u64_counter(l_mon_osdmap_msg_sent, "osdmap_msg_sent",
+        "OSDMap messages sent to subscribers");
+    pcb.add_u64_counter(l_mon_osdmap_msg_shared, "osdmap_msg_shared",
+        "OSDMap messages sent with an encoding shared with other subscribers");
+    pcb.add_time_avg(l_mon_osdmap_encode_lat, "osdmap_encode_lat",
+        "Latency of building and encoding a shared OSDMap message");
+    pcb.add_time_avg(l_mon_osdmap_subs_lat, "osdmap_subs_lat",
+        "Latency of sending a new OSDMap epoch to all subscribers");
+    pcb.add_u64_counter(l_mon_log_entries, "log_entries",
+        "Cluster log entries received", "logm",
+        PerfCountersBuilder::PRIO_INTERESTING);
+    pcb.add_u64_counter(l_mon_log_dup, "log_dup",
+        "Cluster log entries received again and ignored");
+    pcb.add_u64_counter(l_mon_log_bytes, "log_bytes",
+        "Bytes of cluster log entries committed", NULL, 0, unit_t(UNIT_BYTES));
+    pcb.add_u64_counter(l_mon_log_stored_bytes, "log_stored_bytes",
+        "Bytes of cluster log entries committed, once compressed", NULL, 0,
+        unit_t(UNIT_BYTES));
     logger = pcb.create_perf_counters();
     cct->get_perfcounters_collection()->add(logger);
   }
@@ -95,6 +95,14 @@ enum {
   l_mon_election_call,
   l_mon_election_win,
   l_mon_election_lose,
+  l_mon_osdmap_msg_sent,
+  l_mon_osdmap_msg_shared,
+  l_mon_osdmap_encode_lat,
+  l_mon_osdmap_subs_lat,
+  l_mon_log_entries,
+  l_mon_log_dup,
+  l_mon_log_bytes,
+  l_mon_log_stored_bytes,
   l_mon_last,
 };
 
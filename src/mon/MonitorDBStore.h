@@ -22,6 +22,7 @@
 #include <sstream>
 #include <fstream>
 #include "kv/KeyValueDB.h"
+#include "mon/MonitorLogStore.h"
 
 #include "include/ceph_assert.h"
 #include "common/Formatter.h"
@@ -31,6 +32,7 @@
 #include "common/safe_io.h"
 #include "common/blkdev.h"
 #include "common/PriorityCache.h"
+#include "include/str_list.h"
 
 #define dout_context g_ceph_context
 
@@ -38,6 +40,10 @@ class MonitorDBStore
 {
   std::string path;
   boost::scoped_ptr<KeyValueDB> db;
+  /// versioned keys of the log_prefixes, if the store was created with
+  /// mon_log_store_prefixes
+  std::unique_ptr<MonitorLogStore> log;
+  std::set<std::string> log_prefixes;
   bool do_dump;
   int dump_fd_binary;
   std::ofstream dump_fd_json;
@@ -48,6 +54,257 @@ class MonitorDBStore
 
   bool is_open;
 
+  /// kv prefix holding the seq of the last record committed to the log
+  static constexpr const char *LOG_STORE_PREFIX = "mon_log_store";
+
+  bool is_logged(const std::string& prefix) const {
+    return log && log_prefixes.count(prefix);
+  }
+
+  /// only the versions go to the log; the rest of the prefix (e.g.
+  /// first_committed, full_*) stays in the kv store
+  bool is_logged(const std::string& prefix, const std::string& key) const {
+    return is_logged(prefix) && !key.empty() &&
+      std::all_of(key.begin(), key.end(), ::isdigit);
+  }
+
+  /// append to the log; the caller must log->commit(*seq) once dbt
+  /// is committed, if *seq is not 0
+  int _submit_log(MonitorLogStore::Transaction& logt,
+		  KeyValueDB::Transaction dbt, uint64_t *seq) {
+    using ceph::encode;
+    int r = log->submit(logt, seq);
+    if (r < 0)
+      return r;
+    if (*seq) {
+      ceph::buffer::list bl;
+      encode(*seq, bl);
+      dbt->set(LOG_STORE_PREFIX, "committed_seq", bl);
+    }
+    return 0;
+  }
+
+  /**
+   * merge of two whole space iterators with disjoint keys
+   *
+   * Used to iterate over the kv store and the log store as one.
+   */
+  class MergedIteratorImpl : public KeyValueDB::WholeSpaceIteratorImpl {
+    KeyValueDB::WholeSpaceIterator a, b;
+    KeyValueDB::WholeSpaceIterator cur;
+    bool forward = true;
+
+    KeyValueDB::WholeSpaceIterator& other() {
+      return cur == a ? b : a;
+    }
+    int pick() {
+      bool va = a->valid(), vb = b->valid();
+      if (va && vb) {
+	bool a_first = a->raw_key() < b->raw_key();
+	cur = a_first == forward ? a : b;
+      } else {
+	cur = va ? a : b;
+      }
+      return 0;
+    }
+
+  public:
+    MergedIteratorImpl(KeyValueDB::WholeSpaceIterator a,
+		       KeyValueDB::WholeSpaceIterator b)
+      : a(a), b(b), cur(a) {}
+
+    int seek_to_first() override {
+      a->seek_to_first();
+      b->seek_to_first();
+      forward = true;
+      return pick();
+    }
+    int seek_to_first(const std::string &prefix) override {
+      a->seek_to_first(prefix);
+      b->seek_to_first(prefix);
+      forward = true;
+      return pick();
+    }
+    int seek_to_last() override {
+      a->seek_to_last();
+      b->seek_to_last();
+      forward = false;
+      return pick();
+    }
+    int seek_to_last(const std::string &prefix) override {
+      a->seek_to_last(prefix);
+      b->seek_to_last(prefix);
+      forward = false;
+      return pick();
+    }
+    int upper_bound(const std::string &prefix,
+		    const std::string &after) override {
+      a->upper_bound(prefix, after);
+      b->upper_bound(prefix, after);
+      forward = true;
+      return pick();
+    }
+    int lower_bound(const std::string &prefix,
+		    const std::string &to) override {
+      a->lower_bound(prefix, to);
+      b->lower_bound(prefix, to);
+      forward = true;
+      return pick();
+    }
+    bool valid() override {
+      return cur->valid();
+    }
+    int next() override {
+      if (!forward) {
+	// move the other one past the current key
+	auto key = cur->raw_key();
+	other()->upper_bound(key.first, key.second);
+	forward = true;
+      }
+      cur->next();
+      return pick();
+    }
+    int prev() override {
+      if (forward) {
+	// move the other one before the current key
+	auto key = cur->raw_key();
+	auto& o = other();
+	o->lower_bound(key.first, key.second);
+	if (o->valid())
+	  o->prev();
+	else
+	  o->seek_to_last();
+	forward = false;
+      }
+      cur->prev();
+      return pick();
+    }
+    std::string key() override {
+      return cur->key();
+    }
+    std::pair<std::string,std::string> raw_key() override {
+      return cur->raw_key();
+    }
+    bool raw_key_is_prefixed(const std::string &prefix) override {
+      return cur->raw_key_is_prefixed(prefix);
+    }
+    ceph::buffer::list value() override {
+      return cur->value();
+    }
+    ceph::buffer::ptr value_as_ptr() override {
+      return cur->value_as_ptr();
+    }
+    int status() override {
+      int r = a->status();
+      return r < 0 ? r : b->status();
+    }
+  };
+
+  /// a prefix of a merged iterator
+  class MergedPrefixIteratorImpl : public KeyValueDB::IteratorImpl {
+    const std::string prefix;
+    KeyValueDB::WholeSpaceIterator iter;
+
+  public:
+    MergedPrefixIteratorImpl(const std::string &prefix,
+			     KeyValueDB::WholeSpaceIterator iter)
+      : prefix(prefix), iter(iter) {}
+
+    int seek_to_first() override {
+      return iter->seek_to_first(prefix);
+    }
+    int seek_to_last() override {
+      return iter->seek_to_last(prefix);
+    }
+    int upper_bound(const std::string &after) override {
+      return iter->upper_bound(prefix, after);
+    }
+    int lower_bound(const std::string &to) override {
+      return iter->lower_bound(prefix, to);
+    }
+    bool valid() override {
+      return iter->valid() && iter->raw_key_is_prefixed(prefix);
+    }
+    int next() override {
+      return iter->next();
+    }
+    int prev() override {
+      return iter->prev();
+    }
+    std::string key() override {
+      return iter->key();
+    }
+    std::pair<std::string,std::string> raw_key() override {
+      return iter->raw_key();
+    }
+    ceph::buffer::list value() override {
+      return iter->value();
+    }
+    ceph::buffer::ptr value_as_ptr() override {
+      return iter->value_as_ptr();
+    }
+    int status() override {
+      return iter->status();
+    }
+  };
+
+  KeyValueDB::WholeSpaceIterator _get_wholespace_iterator() {
+    if (!log)
+      return db->get_wholespace_iterator();
+    return std::make_shared<MergedIteratorImpl>(
+      db->get_wholespace_iterator(), log->get_wholespace_iterator());
+  }
+
+  std::string _store_path(const std::string& name) const {
+    int pos = 0;
+    for (auto rit = path.rbegin(); rit != path.rend(); ++rit, ++pos) {
+      if (*rit != '/')
+	break;
+    }
+    return path.substr(0, path.size() - pos) + "/" + name;
+  }
+
+  /**
+   * open the log store, if the store uses one
+   *
+   * Whether it does is decided when the store is created and recorded
+   * in the log_store_prefixes meta key, as stores created without it
+   * hold the versioned keys in the kv store.
+   */
+  int _open_log(bool create, std::ostream &out) {
+    using ceph::decode;
+    std::string prefixes;
+    int r = read_meta("log_store_prefixes", &prefixes);
+    if (r < 0 && create) {
+      prefixes = g_conf().get_val<std::string>("mon_log_store_prefixes");
+      r = write_meta("log_store_prefixes", prefixes);
+      if (r < 0)
+	return r;
+    } else if (r < 0) {
+      return 0;
+    }
+    log_prefixes.clear();
+    ceph::for_each_substr(prefixes, ";,= \t", [this] (auto prefix) {
+      log_prefixes.emplace(prefix);
+    });
+    if (log_prefixes.empty())
+      return 0;
+
+    uint64_t committed_seq = 0;
+    ceph::buffer::list bl;
+    if (db->get(LOG_STORE_PREFIX, "committed_seq", &bl) == 0) {
+      auto p = bl.cbegin();
+      decode(committed_seq, p);
+    }
+    log.reset(new MonitorLogStore(
+      g_ceph_context, _store_path("store.log"),
+      g_conf().get_val<Option::size_t>("mon_log_store_segment_size")));
+    r = log->open(create, committed_seq, out);
+    if (r < 0)
+      log.reset();
+    return r;
+  }
+
  public:
 
   std::string get_devname() {
@@ -316,16 +573,25 @@ class MonitorDBStore
     }
 
     std::list<std::pair<std::string, std::pair<std::string,std::string>>> compact;
+    MonitorLogStore::Transaction logt;
     for (auto it = t->ops.begin(); it != t->ops.end(); ++it) {
       const Op& op = *it;
       switch (op.type) {
       case Transaction::OP_PUT:
-	dbt->set(op.prefix, op.key, op.bl);
+	if (is_logged(op.prefix, op.key))
+	  logt.put(op.prefix, op.key, op.bl);
+	else
+	  dbt->set(op.prefix, op.key, op.bl);
 	break;
       case Transaction::OP_ERASE:
-	dbt->rmkey(op.prefix, op.key);
+	if (is_logged(op.prefix, op.key))
+	  logt.erase(op.prefix, op.key);
+	else
+	  dbt->rmkey(op.prefix, op.key);
 	break;
       case Transaction::OP_ERASE_RANGE:
+	if (is_logged(op.prefix))
+	  logt.erase_range(op.prefix, op.key, op.endkey);
 	dbt->rm_range_keys(op.prefix, op.key, op.endkey);
 	break;
       case Transaction::OP_COMPACT:
@@ -337,8 +603,19 @@ class MonitorDBStore
 	break;
       }
     }
+    uint64_t log_seq = 0;
+    if (!logt.empty()) {
+      int r = _submit_log(logt, dbt, &log_seq);
+      if (r < 0) {
+	derr << __func__ << " failed to write to log store: "
+	     << cpp_strerror(r) << dendl;
+	ceph_abort_msg("failed to write to log store");
+      }
+    }
     int r = db->submit_transaction_sync(dbt);
     if (r >= 0) {
+      if (log_seq)
+	log->commit(log_seq);
       while (!compact.empty()) {
 	if (compact.front().second.first == std::string() &&
 	    compact.front().second.second == std::string())
@@ -512,8 +789,7 @@ class MonitorDBStore
 
   Synchronizer get_synchronizer(std::pair<std::string,std::string> &key,
 				std::set<std::string> &prefixes) {
-    KeyValueDB::WholeSpaceIterator iter;
-    iter = db->get_wholespace_iterator();
+    KeyValueDB::WholeSpaceIterator iter = _get_wholespace_iterator();
 
     if (!key.first.empty() && !key.second.empty())
       iter->upper_bound(key.first, key.second);
@@ -527,20 +803,26 @@ class MonitorDBStore
 
   KeyValueDB::Iterator get_iterator(const std::string &prefix) {
     ceph_assert(!prefix.empty());
-    KeyValueDB::Iterator iter = db->get_iterator(prefix);
+    KeyValueDB::Iterator iter;
+    if (is_logged(prefix))
+      iter = std::make_shared<MergedPrefixIteratorImpl>(
+	prefix, _get_wholespace_iterator());
+    else
+      iter = db->get_iterator(prefix);
     iter->seek_to_first();
     return iter;
   }
 
   KeyValueDB::WholeSpaceIterator get_iterator() {
-    KeyValueDB::WholeSpaceIterator iter;
-    iter = db->get_wholespace_iterator();
+    KeyValueDB::WholeSpaceIterator iter = _get_wholespace_iterator();
     iter->seek_to_first();
     return iter;
   }
 
   int get(const std::string& prefix, const std::string& key, ceph::buffer::list& bl) {
     ceph_assert(bl.length() == 0);
+    if (is_logged(prefix, key))
+      return log->get(prefix, key, &bl);
     return db->get(prefix, key, &bl);
   }
 
@@ -573,6 +855,8 @@ class MonitorDBStore
   }
 
   bool exists(const std::string& prefix, const std::string& key) {
+    if (is_logged(prefix, key))
+      return log->exists(prefix, key);
     KeyValueDB::Iterator it = db->get_iterator(prefix);
     int err = it->lower_bound(key);
     if (err < 0)
@@ -602,23 +886,26 @@ class MonitorDBStore
 
   void clear(std::set<std::string>& prefixes) {
     KeyValueDB::Transaction dbt = db->get_transaction();
+    MonitorLogStore::Transaction logt;
 
     for (auto iter = prefixes.begin(); iter != prefixes.end(); ++iter) {
       dbt->rmkeys_by_prefix((*iter));
+      if (is_logged(*iter))
+	logt.erase_prefix(*iter);
+    }
+    uint64_t log_seq = 0;
+    if (!logt.empty()) {
+      int r = _submit_log(logt, dbt, &log_seq);
+      ceph_assert(r >= 0);
     }
     int r = db->submit_transaction_sync(dbt);
     ceph_assert(r >= 0);
+    if (log_seq)
+      log->commit(log_seq);
   }
 
   void _open(const std::string& kv_type) {
-    int pos = 0;
-    for (auto rit = path.rbegin(); rit != path.rend(); ++rit, ++pos) {
-      if (*rit != '/')
-	break;
-    }
-    std::ostringstream os;
-    os << path.substr(0, path.size() - pos) << "/store.db";
-    std::string full_path = os.str();
+    std::string full_path = _store_path("store.db");
 
     KeyValueDB *db_ptr = KeyValueDB::create(g_ceph_context,
 					    kv_type,
@@ -668,6 +955,9 @@ class MonitorDBStore
     }
     _open(kv_type);
     r = db->open(out);
+    if (r < 0)
+      return r;
+    r = _open_log(false, out);
     if (r < 0)
       return r;
 
@@ -695,8 +985,14 @@ class MonitorDBStore
       if (r < 0)
 	return r;
     }
+    // only a new store may start using the log store
+    struct stat st;
+    bool is_new = ::stat(_store_path("store.db").c_str(), &st) < 0;
     _open(kv_type);
     r = db->create_and_open(out);
+    if (r < 0)
+      return r;
+    r = _open_log(is_new, out);
     if (r < 0)
       return r;
     io_work.start();
@@ -708,6 +1004,7 @@ class MonitorDBStore
     // there should be no work queued!
     io_work.stop();
     is_open = false;
+    log.reset();
     db.reset(NULL);
   }
 
@@ -724,7 +1021,13 @@ class MonitorDBStore
   }
 
   uint64_t get_estimated_size(std::map<std::string, uint64_t> &extras) {
-    return db->get_estimated_size(extras);
+    uint64_t size = db->get_estimated_size(extras);
+    if (log) {
+      uint64_t log_size = log->get_size();
+      extras["misc"] += log_size;
+      size += log_size;
+    }
+    return size;
   }
 
   /**
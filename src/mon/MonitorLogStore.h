@@ -0,0 +1,683 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ */
+#ifndef CEPH_MONITOR_LOG_STORE_H
+#define CEPH_MONITOR_LOG_STORE_H
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "include/buffer.h"
+#include "include/encoding.h"
+#include "include/compat.h"
+#include "common/ceph_mutex.h"
+#include "common/debug.h"
+#include "common/errno.h"
+#include "common/safe_io.h"
+#include "kv/KeyValueDB.h"
+
+/**
+ * Segmented append-only log for the versioned keys of the mon store
+ *
+ * Every transaction is appended as one record to the newest segment
+ * file, and a new segment is started once it grows past segment_size.
+ * Values are found through an in-memory index that is rebuilt by
+ * replaying the segments on open.  Erased values are recorded as
+ * tombstones; the oldest segment is removed as soon as none of its
+ * values are live anymore, so trimming old versions never rewrites
+ * or compacts anything.
+ *
+ * Records carry a sequence number.  The caller commits the sequence
+ * number of each record in the kv store together with the rest of the
+ * transaction, and on open any record past the committed one is
+ * discarded, so a transaction is either in both stores or in neither.
+ * For the same reason a record only takes effect, and may only let
+ * older segments go, once the caller has committed it to the kv store
+ * and calls commit().
+ */
+class MonitorLogStore
+{
+public:
+  enum {
+    OP_PUT = 1,
+    OP_ERASE = 2,
+  };
+
+  struct Transaction {
+    struct Op {
+      uint8_t type;
+      std::string prefix, key;
+      ceph::buffer::list bl;
+    };
+    std::vector<Op> ops;
+    /// (prefix, [start, end)); an empty end is the end of the prefix
+    std::vector<std::pair<std::string,
+			  std::pair<std::string,std::string>>> erase_ranges;
+
+    void put(const std::string& prefix, const std::string& key,
+	     const ceph::buffer::list& bl) {
+      ops.push_back(Op{OP_PUT, prefix, key, bl});
+    }
+    void erase(const std::string& prefix, const std::string& key) {
+      ops.push_back(Op{OP_ERASE, prefix, key, {}});
+    }
+    void erase_range(const std::string& prefix, const std::string& start,
+		     const std::string& end) {
+      erase_ranges.emplace_back(prefix, std::make_pair(start, end));
+    }
+    void erase_prefix(const std::string& prefix) {
+      erase_range(prefix, {}, {});
+    }
+    bool empty() const {
+      return ops.empty() && erase_ranges.empty();
+    }
+  };
+
+private:
+  static constexpr uint32_t RECORD_HEADER_SIZE = 8; // length, crc
+
+  struct Segment {
+    const uint64_t seq;
+    const std::string path;
+    int fd = -1;
+    uint64_t length = 0;   ///< bytes of complete records
+    uint64_t live = 0;     ///< values in the index
+
+    Segment(uint64_t seq, const std::string& path) : seq(seq), path(path) {}
+    ~Segment() {
+      if (fd >= 0) {
+	VOID_TEMP_FAILURE_RETRY(::close(fd));
+      }
+    }
+  };
+  using SegmentRef = std::shared_ptr<Segment>;
+
+  struct Location {
+    SegmentRef segment;
+    uint64_t offset;
+    uint32_t length;
+  };
+  using Index = std::map<std::string, std::map<std::string, Location>>;
+
+  /// index change of a submitted record
+  struct Update {
+    std::string prefix, key;
+    bool put;
+    Location loc;
+  };
+
+  CephContext *cct;
+  const std::string path;
+  const uint64_t segment_size;
+
+  /// serializes writers
+  ceph::mutex write_lock = ceph::make_mutex("MonitorLogStore::write_lock");
+  /// write_lock, held from submit() until the record is committed
+  std::unique_lock<ceph::mutex> pending_lock;
+  uint64_t pending_seq = 0;
+  SegmentRef pending_segment;
+  uint64_t pending_length = 0;
+  std::vector<Update> pending_updates;
+  /// protects the index and the segments
+  ceph::mutex lock = ceph::make_mutex("MonitorLogStore::lock");
+  Index index;
+  std::map<uint64_t, SegmentRef> segments;
+  uint64_t last_seq = 0;
+
+  static int read_value(const Location& loc, ceph::buffer::list *out) {
+    ceph::buffer::ptr bp(loc.length);
+    int r = safe_pread_exact(loc.segment->fd, bp.c_str(), loc.length,
+			     loc.offset);
+    if (r < 0) {
+      return r;
+    }
+    out->push_back(std::move(bp));
+    return 0;
+  }
+
+  std::string segment_path(uint64_t seq) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.seg", (unsigned long long)seq);
+    return path + "/" + name;
+  }
+
+  int sync_dir() const {
+    int fd = ::open(path.c_str(), O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    if (fd < 0) {
+      return -errno;
+    }
+    int r = ::fsync(fd);
+    if (r < 0) {
+      r = -errno;
+    }
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+    return r;
+  }
+
+  int _open_segment(uint64_t seq, bool create, SegmentRef *out) {
+    auto segment = std::make_shared<Segment>(seq, segment_path(seq));
+    segment->fd = ::open(segment->path.c_str(),
+			 O_RDWR|O_CLOEXEC|(create ? O_CREAT|O_EXCL : 0), 0644);
+    if (segment->fd < 0) {
+      return -errno;
+    }
+    if (create) {
+      int r = sync_dir();
+      if (r < 0) {
+	return r;
+      }
+    }
+    *out = std::move(segment);
+    return 0;
+  }
+
+  void _index_put(const std::string& prefix, const std::string& key,
+		  const Location& loc) {
+    auto& l = index[prefix][key];
+    if (l.segment) {
+      --l.segment->live;
+    }
+    l = loc;
+    ++l.segment->live;
+  }
+
+  void _index_erase(const std::string& prefix, const std::string& key) {
+    auto p = index.find(prefix);
+    if (p == index.end()) {
+      return;
+    }
+    auto k = p->second.find(key);
+    if (k == p->second.end()) {
+      return;
+    }
+    --k->second.segment->live;
+    p->second.erase(k);
+    if (p->second.empty()) {
+      index.erase(p);
+    }
+  }
+
+  /// apply one record to the index; returns its seq, or 0 if it is
+  /// corrupt or was never committed
+  uint64_t _replay_record(const SegmentRef& segment, uint64_t offset,
+			  const ceph::buffer::list& payload,
+			  uint64_t committed_seq) {
+    using ceph::decode;
+    uint64_t seq = 0;
+    try {
+      auto p = payload.cbegin();
+      DECODE_START(1, p);
+      decode(seq, p);
+      if (seq > committed_seq) {
+	return 0;
+      }
+      uint32_t num_ops;
+      decode(num_ops, p);
+      while (num_ops--) {
+	uint8_t type;
+	std::string prefix, key;
+	decode(type, p);
+	decode(prefix, p);
+	decode(key, p);
+	if (type == OP_PUT) {
+	  uint32_t length;
+	  decode(length, p);
+	  Location loc{segment, offset + RECORD_HEADER_SIZE + p.get_off(),
+		       length};
+	  p += length;
+	  _index_put(prefix, key, loc);
+	} else {
+	  _index_erase(prefix, key);
+	}
+      }
+      DECODE_FINISH(p);
+    } catch (ceph::buffer::error& e) {
+      return 0;
+    }
+    return seq;
+  }
+
+  /**
+   * replay a segment
+   *
+   * @param complete [out] false if the segment ends with a torn or
+   *                       uncommitted record, which is cut off
+   */
+  int _replay_segment(const SegmentRef& segment, uint64_t committed_seq,
+		      bool *complete) {
+    using ceph::decode;
+    struct stat st;
+    if (::fstat(segment->fd, &st) < 0) {
+      return -errno;
+    }
+    ceph::buffer::list bl;
+    if (st.st_size > 0) {
+      ssize_t r = bl.read_fd(segment->fd, st.st_size);
+      if (r < 0) {
+	return r;
+      }
+    }
+    *complete = true;
+    uint64_t offset = 0;
+    while (offset < bl.length()) {
+      if (bl.length() - offset < RECORD_HEADER_SIZE) {
+	*complete = false;
+	break;
+      }
+      ceph::buffer::list header, payload;
+      header.substr_of(bl, offset, RECORD_HEADER_SIZE);
+      uint32_t length, crc;
+      auto p = header.cbegin();
+      decode(length, p);
+      decode(crc, p);
+      if (bl.length() - offset - RECORD_HEADER_SIZE < length) {
+	*complete = false;
+	break;
+      }
+      payload.substr_of(bl, offset + RECORD_HEADER_SIZE, length);
+      if (payload.crc32c(0) != crc) {
+	*complete = false;
+	break;
+      }
+      uint64_t seq = _replay_record(segment, offset, payload, committed_seq);
+      if (seq == 0) {
+	*complete = false;
+	break;
+      }
+      last_seq = seq;
+      offset += RECORD_HEADER_SIZE + length;
+    }
+    segment->length = offset;
+    if (!*complete) {
+      lsubdout(cct, mon, 1) << "MonitorLogStore: discarding "
+			    << bl.length() - offset << " bytes past "
+			    << segment->path << "~" << offset
+			    << ", committed seq " << committed_seq << dendl;
+      if (::ftruncate(segment->fd, offset) < 0 ||
+	  ::fdatasync(segment->fd) < 0) {
+	return -errno;
+      }
+    }
+    return 0;
+  }
+
+  /// drop the oldest segments while none of their values are live
+  void _trim() {
+    while (segments.size() > 1 && segments.begin()->second->live == 0) {
+      auto& segment = segments.begin()->second;
+      lsubdout(cct, mon, 10) << "MonitorLogStore: removing " << segment->path
+			     << dendl;
+      if (::unlink(segment->path.c_str()) < 0) {
+	lderr(cct) << "MonitorLogStore: failed to remove " << segment->path
+		   << ": " << cpp_strerror(errno) << dendl;
+	break;
+      }
+      // readers that still hold the segment keep it open until they
+      // are done with it
+      segments.erase(segments.begin());
+    }
+  }
+
+  class LogIteratorImpl : public KeyValueDB::WholeSpaceIteratorImpl {
+    using entry_t = std::pair<std::pair<std::string,std::string>, Location>;
+    std::vector<entry_t> entries;
+    size_t pos;
+
+    static bool key_less(const entry_t& e,
+			 const std::pair<std::string,std::string>& k) {
+      return e.first < k;
+    }
+    static bool less_key(const std::pair<std::string,std::string>& k,
+			 const entry_t& e) {
+      return k < e.first;
+    }
+
+  public:
+    explicit LogIteratorImpl(const Index& index) {
+      for (auto& [prefix, keys] : index) {
+	for (auto& [key, loc] : keys) {
+	  entries.emplace_back(std::make_pair(prefix, key), loc);
+	}
+      }
+      pos = entries.size();
+    }
+
+    int seek_to_first() override {
+      pos = 0;
+      return 0;
+    }
+    int seek_to_first(const std::string &prefix) override {
+      return lower_bound(prefix, {});
+    }
+    int seek_to_last() override {
+      pos = entries.empty() ? 0 : entries.size() - 1;
+      return 0;
+    }
+    int seek_to_last(const std::string &prefix) override {
+      // the last key of the prefix, or the last key before it
+      auto p = std::find_if(entries.begin(), entries.end(),
+			    [&](const entry_t& e) {
+			      return e.first.first > prefix;
+			    });
+      pos = p == entries.begin() ? entries.size() : p - entries.begin() - 1;
+      return 0;
+    }
+    int upper_bound(const std::string &prefix,
+		    const std::string &after) override {
+      pos = std::upper_bound(entries.begin(), entries.end(),
+			     std::make_pair(prefix, after), less_key) -
+	entries.begin();
+      return 0;
+    }
+    int lower_bound(const std::string &prefix,
+		    const std::string &to) override {
+      pos = std::lower_bound(entries.begin(), entries.end(),
+			     std::make_pair(prefix, to), key_less) -
+	entries.begin();
+      return 0;
+    }
+    bool valid() override {
+      return pos < entries.size();
+    }
+    int next() override {
+      if (pos < entries.size()) {
+	++pos;
+      }
+      return 0;
+    }
+    int prev() override {
+      pos = pos == 0 ? entries.size() : pos - 1;
+      return 0;
+    }
+    std::string key() override {
+      return entries[pos].first.second;
+    }
+    std::pair<std::string,std::string> raw_key() override {
+      return entries[pos].first;
+    }
+    bool raw_key_is_prefixed(const std::string &prefix) override {
+      return entries[pos].first.first == prefix;
+    }
+    ceph::buffer::list value() override {
+      ceph::buffer::list bl;
+      read_value(entries[pos].second, &bl);
+      return bl;
+    }
+    int status() override {
+      return 0;
+    }
+  };
+
+public:
+  MonitorLogStore(CephContext *cct, const std::string& path,
+		  uint64_t segment_size)
+    : cct(cct), path(path), segment_size(segment_size) {}
+
+  /**
+   * open the log, replaying the segments into the index
+   *
+   * @param committed_seq the last seq committed to the kv store
+   */
+  int open(bool create, uint64_t committed_seq, std::ostream &out) {
+    std::lock_guard wl(write_lock);
+    std::lock_guard l(lock);
+    if (create && ::mkdir(path.c_str(), 0755) < 0 && errno != EEXIST) {
+      int r = -errno;
+      out << "failed to create " << path << ": " << cpp_strerror(r);
+      return r;
+    }
+    DIR *dir = ::opendir(path.c_str());
+    if (!dir) {
+      int r = -errno;
+      out << "failed to open " << path << ": " << cpp_strerror(r);
+      return r;
+    }
+    std::vector<uint64_t> seqs;
+    while (struct dirent *de = ::readdir(dir)) {
+      unsigned long long seq;
+      char suffix[8];
+      if (sscanf(de->d_name, "%16llx.%7s", &seq, suffix) == 2 &&
+	  std::string(suffix) == "seg") {
+	seqs.push_back(seq);
+      }
+    }
+    ::closedir(dir);
+    std::sort(seqs.begin(), seqs.end());
+
+    bool complete = true;
+    for (auto seq : seqs) {
+      if (!complete) {
+	// nothing past a torn or uncommitted record has been committed
+	lsubdout(cct, mon, 1) << "MonitorLogStore: removing "
+			      << segment_path(seq) << dendl;
+	if (::unlink(segment_path(seq).c_str()) < 0) {
+	  int r = -errno;
+	  out << "failed to remove " << segment_path(seq) << ": "
+	      << cpp_strerror(r);
+	  return r;
+	}
+	continue;
+      }
+      SegmentRef segment;
+      int r = _open_segment(seq, false, &segment);
+      if (r == 0) {
+	r = _replay_segment(segment, committed_seq, &complete);
+      }
+      if (r < 0) {
+	out << "failed to replay " << segment_path(seq) << ": "
+	    << cpp_strerror(r);
+	return r;
+      }
+      segments[seq] = segment;
+    }
+    if (segments.empty()) {
+      SegmentRef segment;
+      int r = _open_segment(1, true, &segment);
+      if (r < 0) {
+	out << "failed to create " << segment_path(1) << ": "
+	    << cpp_strerror(r);
+	return r;
+      }
+      segments[1] = segment;
+    }
+    // every record up to committed_seq may have been trimmed away
+    last_seq = std::max(last_seq, committed_seq);
+    _trim();
+    lsubdout(cct, mon, 1) << "MonitorLogStore: opened " << path << " with "
+			  << segments.size() << " segments, seq "
+			  << last_seq << dendl;
+    return 0;
+  }
+
+  /**
+   * append a transaction to the log
+   *
+   * The record is durable when this returns, but it only shows up in
+   * the index once commit() is called with its seq; no other
+   * transaction can be submitted until then.
+   *
+   * @param seq [out] seq of the record to commit with the transaction,
+   *                  or 0 if nothing was written
+   */
+  int submit(Transaction& t, uint64_t *seq) {
+    using ceph::encode;
+    std::unique_lock wl(write_lock);
+    *seq = 0;
+
+    // resolve the ranges to the keys they erase now; replay only sees
+    // the keys
+    std::vector<Transaction::Op> range_ops;
+    if (!t.erase_ranges.empty()) {
+      std::lock_guard l(lock);
+      for (auto& [prefix, range] : t.erase_ranges) {
+	auto p = index.find(prefix);
+	if (p == index.end()) {
+	  continue;
+	}
+	auto k = p->second.lower_bound(range.first);
+	auto end = range.second.empty() ? p->second.end() :
+	  p->second.lower_bound(range.second);
+	for (; k != end; ++k) {
+	  range_ops.push_back(Transaction::Op{OP_ERASE, prefix, k->first, {}});
+	}
+      }
+    }
+    if (t.ops.empty() && range_ops.empty()) {
+      return 0;
+    }
+
+    ceph::buffer::list payload;
+    std::vector<uint64_t> value_offsets;
+    ENCODE_START(1, 1, payload);
+    encode(last_seq + 1, payload);
+    encode((uint32_t)(range_ops.size() + t.ops.size()), payload);
+    for (auto ops : {&range_ops, &t.ops}) {
+      for (auto& op : *ops) {
+	encode(op.type, payload);
+	encode(op.prefix, payload);
+	encode(op.key, payload);
+	if (op.type == OP_PUT) {
+	  value_offsets.push_back(payload.length() + sizeof(uint32_t));
+	  encode(op.bl, payload);
+	}
+      }
+    }
+    ENCODE_FINISH(payload);
+    ceph::buffer::list record;
+    encode((uint32_t)payload.length(), record);
+    encode(payload.crc32c(0), record);
+    record.claim_append(payload);
+
+    SegmentRef segment;
+    {
+      std::lock_guard l(lock);
+      segment = segments.rbegin()->second;
+    }
+    if (segment->length > 0 &&
+	segment->length + record.length() > segment_size) {
+      int r = _open_segment(segment->seq + 1, true, &segment);
+      if (r < 0) {
+	return r;
+      }
+      std::lock_guard l(lock);
+      segments[segment->seq] = segment;
+    }
+    uint64_t offset = segment->length;
+    int r = record.write_fd(segment->fd, offset);
+    if (r == 0 && ::fdatasync(segment->fd) < 0) {
+      r = -errno;
+    }
+    if (r < 0) {
+      return r;
+    }
+
+    pending_updates.clear();
+    for (auto& op : range_ops) {
+      pending_updates.push_back(Update{op.prefix, op.key, false, {}});
+    }
+    auto value_offset = value_offsets.begin();
+    for (auto& op : t.ops) {
+      if (op.type == OP_PUT) {
+	pending_updates.push_back(
+	  Update{op.prefix, op.key, true,
+		 Location{segment,
+			  offset + RECORD_HEADER_SIZE + *value_offset++,
+			  op.bl.length()}});
+      } else {
+	pending_updates.push_back(Update{op.prefix, op.key, false, {}});
+      }
+    }
+    pending_segment = segment;
+    pending_length = record.length();
+    pending_seq = last_seq + 1;
+    pending_lock = std::move(wl);
+    *seq = pending_seq;
+    return 0;
+  }
+
+  /**
+   * apply a submitted record, once its seq is committed to the kv store
+   *
+   * Only now may the segments whose values it erased be removed: until
+   * the kv store has the seq, a restart would discard the record and
+   * need them again.
+   */
+  void commit(uint64_t seq) {
+    ceph_assert(pending_lock.owns_lock());
+    ceph_assert(seq == pending_seq);
+    {
+      std::lock_guard l(lock);
+      pending_segment->length += pending_length;
+      for (auto& u : pending_updates) {
+	if (u.put) {
+	  _index_put(u.prefix, u.key, u.loc);
+	} else {
+	  _index_erase(u.prefix, u.key);
+	}
+      }
+      last_seq = seq;
+      _trim();
+    }
+    pending_updates.clear();
+    pending_segment.reset();
+    pending_seq = 0;
+    pending_lock.unlock();
+  }
+
+  int get(const std::string& prefix, const std::string& key,
+	  ceph::buffer::list *out) {
+    Location loc;
+    {
+      std::lock_guard l(lock);
+      auto p = index.find(prefix);
+      if (p == index.end()) {
+	return -ENOENT;
+      }
+      auto k = p->second.find(key);
+      if (k == p->second.end()) {
+	return -ENOENT;
+      }
+      loc = k->second;
+    }
+    return read_value(loc, out);
+  }
+
+  bool exists(const std::string& prefix, const std::string& key) {
+    std::lock_guard l(lock);
+    auto p = index.find(prefix);
+    return p != index.end() && p->second.count(key);
+  }
+
+  /// iterate over a snapshot of the log
+  KeyValueDB::WholeSpaceIterator get_wholespace_iterator() {
+    std::lock_guard l(lock);
+    return std::make_shared<LogIteratorImpl>(index);
+  }
+
+  uint64_t get_size() {
+    std::lock_guard l(lock);
+    uint64_t size = 0;
+    for (auto& [seq, segment] : segments) {
+      size += segment->length;
+    }
+    return size;
+  }
+};
+
+#endif /* CEPH_MONITOR_LOG_STORE_H */
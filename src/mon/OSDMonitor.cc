@@ -465,6 +465,8 @@ OSDMonitor::OSDMonitor(
   }
 }
 
+OSDMonitor::~OSDMonitor() = default;
+
 const char **OSDMonitor::get_tracked_conf_keys() const
 {
   static const char* KEYS[] = {
@@ -4449,6 +4451,40 @@ MOSDMap *OSDMonitor::build_incremental(epoch_t from, epoch_t to, uint64_t featur
   return m;
 }
 
+MOSDMap *OSDMonitor::build_shared_incremental(epoch_t from, epoch_t to,
+					      uint64_t features)
+{
+  if (!g_conf().get_val<bool>("mon_osd_share_map_encoding")) {
+    return build_incremental(from, to, features);
+  }
+  if (shared_osdmap_msgs_epoch != osdmap.get_epoch() ||
+      shared_osdmap_msgs_oldest != get_first_committed() ||
+      shared_osdmap_msgs.size() >= (size_t)g_conf()->mon_osd_cache_size) {
+    shared_osdmap_msgs.clear();
+    shared_osdmap_msgs_epoch = osdmap.get_epoch();
+    shared_osdmap_msgs_oldest = get_first_committed();
+  }
+  // the payload only depends on the significant features
+  auto key = std::make_tuple(from, to,
+			     OSDMap::get_significant_features(features));
+  auto p = shared_osdmap_msgs.find(key);
+  if (p == shared_osdmap_msgs.end()) {
+    auto start = ceph::mono_clock::now();
+    ceph::ref_t<MOSDMap> encoded(build_incremental(from, to, features), false);
+    encoded->encode_payload(features);
+    mon->logger->tinc(l_mon_osdmap_encode_lat,
+		      ceph::mono_clock::now() - start);
+    p = shared_osdmap_msgs.emplace(key, std::move(encoded)).first;
+  } else {
+    dout(20) << __func__ << " [" << from << ".." << to << "] sharing "
+	     << p->second->get_payload().length() << " bytes" << dendl;
+    mon->logger->inc(l_mon_osdmap_msg_shared);
+  }
+  MOSDMap *m = new MOSDMap;
+  m->share_payload(*p->second);
+  return m;
+}
+
 void OSDMonitor::send_full(MonOpRequestRef op)
 {
   op->mark_osdmon_event(__func__);
@@ -4524,7 +4560,15 @@ void OSDMonitor::send_incremental(epoch_t first,
   while (first <= osdmap.get_epoch()) {
     epoch_t last = std::min<epoch_t>(first + g_conf()->osd_map_message_max - 1,
 				     osdmap.get_epoch());
-    MOSDMap *m = build_incremental(first, last, features);
+    MOSDMap *m;
+    if (req || !session->con_features) {
+      m = build_incremental(first, last, features);
+    } else {
+      // the maps are encoded for the features of the connection, so the
+      // encoding can be shared with the other subscribers behind by as
+      // many epochs
+      m = build_shared_incremental(first, last, features);
+    }
 
     if (req) {
       // send some maps.  it may not be all of them, but it will get them
@@ -4532,6 +4576,7 @@ void OSDMonitor::send_incremental(epoch_t first,
       mon->send_reply(req, m);
     } else {
       session->con->send_message(m);
+      mon->logger->inc(l_mon_osdmap_msg_sent);
       first = last + 1;
     }
     session->osd_epoch = last;
@@ -4794,12 +4839,14 @@ void OSDMonitor::check_osdmap_subs()
   if (osdmap_subs == mon->session_map.subs.end()) {
     return;
   }
+  auto start = ceph::mono_clock::now();
   auto p = osdmap_subs->second->begin();
   while (!p.end()) {
     auto sub = *p;
     ++p;
     check_osdmap_sub(sub);
   }
+  mon->logger->tinc(l_mon_osdmap_subs_lat, ceph::mono_clock::now() - start);
 }
 
 void OSDMonitor::check_osdmap_sub(Subscription *sub)
@@ -14086,7 +14133,7 @@ int OSDMonitor::_prepare_remove_pool(
     }
   }
   // remove any pg_upmap mappings for this pool
-  for (auto& p : osdmap.pg_upmap) {
+  for (auto& p : *osdmap.pg_upmap) {
     if (p.first.pool() == pool) {
       dout(10) << __func__ << " " << pool
                << " removing obsolete pg_upmap "
@@ -14109,7 +14156,7 @@ int OSDMonitor::_prepare_remove_pool(
     }
   }
   // remove any pg_upmap_items mappings for this pool
-  for (auto& p : osdmap.pg_upmap_items) {
+  for (auto& p : *osdmap.pg_upmap_items) {
     if (p.first.pool() == pool) {
       dout(10) << __func__ << " " << pool
                << " removing obsolete pg_upmap_items " << p.first
@@ -23,6 +23,7 @@
 
 #include <map>
 #include <set>
+#include <tuple>
 #include <utility>
 
 #include "include/types.h"
@@ -240,6 +241,14 @@ public:
   osdmap_cache_t inc_osd_cache;
   osdmap_cache_t full_osd_cache;
 
+  // encoded MOSDMap messages for the latest epoch, shared by the
+  // subscribers that need the same maps with the same significant
+  // features: (first, last, features) -> message
+  using shared_osdmap_key_t = std::tuple<epoch_t, epoch_t, uint64_t>;
+  std::map<shared_osdmap_key_t, ceph::ref_t<MOSDMap>> shared_osdmap_msgs;
+  epoch_t shared_osdmap_msgs_epoch = 0;
+  epoch_t shared_osdmap_msgs_oldest = 0;
+
   bool has_osdmap_manifest;
   osdmap_manifest_t osdmap_manifest;
 
@@ -409,6 +418,8 @@ private:
   // ...
   MOSDMap *build_latest_full(uint64_t features);
   MOSDMap *build_incremental(epoch_t first, epoch_t last, uint64_t features);
+  MOSDMap *build_shared_incremental(epoch_t first, epoch_t last,
+				    uint64_t features);
   void send_full(MonOpRequestRef op);
   void send_incremental(MonOpRequestRef op, epoch_t first);
 public:
@@ -677,6 +688,7 @@ protected:
 
 public:
   OSDMonitor(CephContext *cct, Monitor *mn, Paxos *p, const std::string& service_name);
+  ~OSDMonitor() override;
 
   void tick() override;  // check state, take actions
 
@@ -1,6 +1,9 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 
+#include <functional>
+#include <mutex>
+
 #include <boost/algorithm/string.hpp>
 
 #include "PGMap.h"
@@ -8,7 +11,9 @@
 #define dout_subsys ceph_subsys_mon
 #include "common/debug.h"
 #include "common/Clock.h"
+#include "common/ceph_mutex.h"
 #include "common/Formatter.h"
+#include "common/Thread.h"
 #include "global/global_context.h"
 #include "include/ceph_features.h"
 #include "include/stringify.h"
@@ -1162,15 +1167,25 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
 
     auto pg_stat_iter = pg_stat.find(update_pg);
     pool_stat_t &pool_sum_ref = pg_pool_sum[update_pool];
+    // most updates do not move the pg, so leave the per-osd indexes be
+    bool sameosds = false;
     if (pg_stat_iter == pg_stat.end()) {
       pg_stat.insert(make_pair(update_pg, update_stat));
     } else {
-      stat_pg_sub(update_pg, pg_stat_iter->second);
-      pool_sum_ref.sub(pg_stat_iter->second);
+      const pg_stat_t &old_stat = pg_stat_iter->second;
+      sameosds = (old_stat.up == update_stat.up &&
+		  old_stat.acting == update_stat.acting &&
+		  old_stat.up_primary == update_stat.up_primary &&
+		  old_stat.blocked_by == update_stat.blocked_by);
+      stat_pg_sub(update_pg, old_stat, sameosds);
+      pool_sum_ref.sub(old_stat);
       pg_stat_iter->second = update_stat;
     }
-    stat_pg_add(update_pg, update_stat);
+    stat_pg_add(update_pg, update_stat, sameosds);
     pool_sum_ref.add(update_stat);
+    if (!purged_snaps_all_dirty) {
+      purged_snaps_dirty.insert(update_pool);
+    }
   }
 
   for (auto p = inc.pool_statfs_updates.begin();
@@ -1229,6 +1244,9 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
       if (pool_erased) {
         deleted_pools.insert(removed_pg.pool());
       }
+      if (!purged_snaps_all_dirty) {
+        purged_snaps_dirty.insert(removed_pg.pool());
+      }
     }
   }
 
@@ -1283,7 +1301,98 @@ void PGMap::apply_incremental(CephContext *cct, const Incremental& inc)
     last_pg_scan = inc.pg_scan;
 }
 
-void PGMap::calc_stats()
+namespace {
+// The threads calc_stats() sums the pg stats on.  They are started on
+// first use and kept, as the stats of a large map are recalculated on
+// every PGMap decode.
+class PGStatSumPool {
+public:
+  ~PGStatSumPool() {
+    {
+      std::lock_guard l(lock);
+      stopping = true;
+      cond.notify_all();
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+
+  /// run fn(1) .. fn(shards - 1) on the pool, and meanwhile() then
+  /// fn(0) on the calling thread
+  void run(unsigned shards,
+	   const std::function<void(unsigned)>& fn,
+	   const std::function<void()>& meanwhile) {
+    if (shards <= 1) {
+      meanwhile();
+      fn(0);
+      return;
+    }
+    std::lock_guard r(run_lock);
+    std::unique_lock l(lock);
+    while (threads.size() < shards - 1) {
+      threads.push_back(make_named_thread("pgmap_stats",
+					  &PGStatSumPool::worker, this));
+    }
+    job = &fn;
+    next = 1;
+    num_shards = shards;
+    pending = shards - 1;
+    cond.notify_all();
+    l.unlock();
+
+    meanwhile();
+    fn(0);
+
+    l.lock();
+    done_cond.wait(l, [this] { return pending == 0; });
+    job = nullptr;
+    num_shards = 0;
+  }
+
+private:
+  std::mutex run_lock;  ///< one run at a time
+  ceph::mutex lock = ceph::make_mutex("PGStatSumPool::lock");
+  ceph::condition_variable cond;
+  ceph::condition_variable done_cond;
+  std::vector<std::thread> threads;
+  const std::function<void(unsigned)> *job = nullptr;
+  unsigned next = 0;
+  unsigned num_shards = 0;
+  unsigned pending = 0;
+  bool stopping = false;
+
+  void worker() {
+    std::unique_lock l(lock);
+    while (true) {
+      cond.wait(l, [this] { return stopping || next < num_shards; });
+      if (stopping) {
+	return;
+      }
+      unsigned shard = next++;
+      auto fn = job;
+      l.unlock();
+      (*fn)(shard);
+      l.lock();
+      if (--pending == 0) {
+	done_cond.notify_all();
+      }
+    }
+  }
+};
+} // anonymous namespace
+
+// add the pg stats summed in another pool_stat_t
+static void add_pg_sum(pool_stat_t *sum, const pool_stat_t &o)
+{
+  sum->stats.add(o.stats);
+  sum->log_size += o.log_size;
+  sum->ondisk_log_size += o.ondisk_log_size;
+  sum->up += o.up;
+  sum->acting += o.acting;
+}
+
+void PGMap::calc_stats(unsigned max_shards)
 {
   num_pg = 0;
   num_pg_active = 0;
@@ -1298,14 +1407,47 @@ void PGMap::calc_stats()
   num_pg_by_state.clear();
   num_pg_by_pool_state.clear();
   num_pg_by_osd.clear();
-
-  for (auto p = pg_stat.begin();
-       p != pg_stat.end();
-       ++p) {
-    auto pg = p->first;
-    stat_pg_add(pg, p->second);
-    pg_pool_sum[pg.pool()].add(p->second);
+  purged_snaps_all_dirty = true;
+  purged_snaps_dirty.clear();
+
+  // Summing the pg stats is the expensive part of the walk, so the
+  // per-pool sums are reduced in parallel over shards of the pg table
+  // buckets while this thread builds the counts and indexes.  Maps too
+  // small for more than one shard are walked on this thread alone.
+  unsigned shards = std::max<size_t>(
+    1, pg_stat.size() / CALC_STATS_MIN_PGS_PER_SHARD);
+  shards = std::min({shards, std::max(1u, std::thread::hardware_concurrency()),
+		     CALC_STATS_MAX_SHARDS});
+  if (max_shards) {
+    shards = std::min(shards, max_shards);
+  }
+  const size_t buckets = pg_stat.bucket_count();
+  std::vector<std::map<int64_t, pool_stat_t>> shard_sums(shards);
+  auto sum_shard = [&](unsigned shard) {
+    auto& sums = shard_sums[shard];
+    for (size_t b = buckets * shard / shards;
+	 b < buckets * (shard + 1) / shards;
+	 ++b) {
+      for (auto p = pg_stat.begin(b); p != pg_stat.end(b); ++p) {
+	sums[p->first.pool()].add(p->second);
+      }
+    }
+  };
+  static PGStatSumPool sum_pool;
+  sum_pool.run(shards, sum_shard, [this] {
+    for (auto p = pg_stat.begin();
+	 p != pg_stat.end();
+	 ++p) {
+      stat_pg_count_add(p->first, p->second);
+    }
+  });
+  for (auto& sums : shard_sums) {
+    for (auto& [pool, sum] : sums) {
+      add_pg_sum(&pg_sum, sum);
+      add_pg_sum(&pg_pool_sum[pool], sum);
+    }
   }
+
   for (auto p = pool_statfs.begin();
        p != pool_statfs.end();
        ++p) {
@@ -1321,8 +1463,14 @@ void PGMap::calc_stats()
 void PGMap::stat_pg_add(const pg_t &pgid, const pg_stat_t &s,
                         bool sameosds)
 {
-  auto pool = pgid.pool();
   pg_sum.add(s);
+  stat_pg_count_add(pgid, s, sameosds);
+}
+
+void PGMap::stat_pg_count_add(const pg_t &pgid, const pg_stat_t &s,
+                              bool sameosds)
+{
+  auto pool = pgid.pool();
 
   num_pg++;
   num_pg_by_state[s.state]++;
@@ -1455,9 +1603,23 @@ bool PGMap::stat_pg_sub(const pg_t &pgid, const pg_stat_t &s,
 
 void PGMap::calc_purged_snaps()
 {
-  purged_snaps.clear();
+  // only the pools whose pgs changed since the last time need to be
+  // intersected again
+  if (purged_snaps_all_dirty) {
+    purged_snaps.clear();
+  } else if (purged_snaps_dirty.empty()) {
+    return;
+  } else {
+    for (auto pool : purged_snaps_dirty) {
+      purged_snaps.erase(pool);
+    }
+  }
   set<int64_t> unknown;
   for (auto& i : pg_stat) {
+    if (!purged_snaps_all_dirty &&
+	purged_snaps_dirty.count(i.first.pool()) == 0) {
+      continue;
+    }
     if (i.second.state == 0) {
       unknown.insert(i.first.pool());
       purged_snaps.erase(i.first.pool());
@@ -1473,6 +1635,8 @@ void PGMap::calc_purged_snaps()
       j->second.intersection_of(i.second.purged_snaps);
     }
   }
+  purged_snaps_all_dirty = false;
+  purged_snaps_dirty.clear();
 }
 
 void PGMap::calc_osd_sum_by_class(const OSDMap& osdmap)
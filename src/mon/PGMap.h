@@ -307,6 +307,10 @@ public:
   mempool::pgmap::list<std::pair<pool_stat_t, utime_t> > pg_sum_deltas;
   mempool::pgmap::unordered_map<int64_t,mempool::pgmap::unordered_map<uint64_t,int32_t>> num_pg_by_pool_state;
 
+  // pools whose pgs changed since calc_purged_snaps()
+  mempool::pgmap::set<int64_t> purged_snaps_dirty;
+  bool purged_snaps_all_dirty = true;
+
   utime_t stamp;
 
   void update_pool_deltas(
@@ -333,6 +337,13 @@ public:
   }
 
  private:
+  static constexpr size_t CALC_STATS_MIN_PGS_PER_SHARD = 16384;
+  static constexpr unsigned CALC_STATS_MAX_SHARDS = 8;
+
+  /// stat_pg_add() without the pg_sum
+  void stat_pg_count_add(const pg_t &pgid, const pg_stat_t &s,
+			 bool sameosds=false);
+
   void update_delta(
     CephContext *cct,
     const utime_t ts,
@@ -419,7 +430,9 @@ public:
 
 
   void apply_incremental(CephContext *cct, const Incremental& inc);
-  void calc_stats();
+  /// recalculate the aggregate stats from scratch, summing the pg stats
+  /// over up to @p max_shards threads (0 for as many as worthwhile)
+  void calc_stats(unsigned max_shards = 0);
   void stat_pg_add(const pg_t &pgid, const pg_stat_t &s,
 		   bool sameosds=false);
   bool stat_pg_sub(const pg_t &pgid, const pg_stat_t &s,
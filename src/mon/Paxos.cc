@@ -132,6 +132,28 @@ void Paxos::init_logger()
   pcb.add_u64_avg(l_paxos_share_state_bytes, "share_state_bytes", "Data in shared state", NULL, 0, unit_t(UNIT_BYTES));
   pcb.add_u64_counter(l_paxos_new_pn, "new_pn", "New proposal number queries");
   pcb.add_time_avg(l_paxos_new_pn_latency, "new_pn_latency", "New proposal number getting latency");
+  pcb.add_u64_avg(l_paxos_proposal_batch, "proposal_batch", "Changes batched in a proposal");
+  pcb.add_time_avg(l_paxos_proposal_batch_delay, "proposal_batch_delay", "Time proposals were held back to batch changes");
+  pcb.add_time_avg(l_paxos_proposal_latency, "proposal_latency", "Latency of proposals, until the round finished");
+
+  PerfHistogramCommon::axis_config_d proposal_latency_axis_config{
+    "Latency (usec)",
+    PerfHistogramCommon::SCALE_LOG2, // latency in logarithmic scale
+    0,                               // start at 0
+    1000000,                         // quantization unit is 1ms
+    16,                              // up to ~30s
+  };
+  PerfHistogramCommon::axis_config_d proposal_batch_axis_config{
+    "Batch size (changes)",
+    PerfHistogramCommon::SCALE_LINEAR, // batch size in linear scale
+    0,                                 // start at 0
+    1,                                 // quantization unit is 1 change
+    16,                                // up to 14 changes
+  };
+  pcb.add_u64_counter_histogram(
+    l_paxos_proposal_latency_batch_hist, "proposal_latency_batch_histogram",
+    proposal_latency_axis_config, proposal_batch_axis_config,
+    "Histogram of proposal latency + changes batched in the proposal");
   logger = pcb.create_perf_counters();
   g_ceph_context->get_perfcounters_collection()->add(logger);
 }
@@ -1088,6 +1110,16 @@ void Paxos::finish_round()
   
   dout(10) << __func__ << " done w/ waiters, state " << get_statename(state) << dendl;
 
+  if (!proposal_start.is_zero()) {
+    utime_t latency = ceph_clock_now() - proposal_start;
+    proposal_start = utime_t();
+    avg_round_latency = avg_round_latency == 0 ? (double)latency :
+      0.8 * avg_round_latency + 0.2 * (double)latency;
+    logger->tinc(l_paxos_proposal_latency, latency);
+    logger->hinc(l_paxos_proposal_latency_batch_hist, latency.to_nsec(),
+		 proposal_batch);
+  }
+
   if (should_trim()) {
     trim();
   }
@@ -1317,6 +1349,11 @@ void Paxos::cancel_events()
     mon->timer.cancel_event(lease_timeout_event);
     lease_timeout_event = 0;
   }
+  if (batch_event) {
+    mon->timer.cancel_event(batch_event);
+    batch_event = 0;
+    batch_start = utime_t();
+  }
 }
 
 void Paxos::shutdown()
@@ -1417,6 +1454,7 @@ void Paxos::restart()
 
 void Paxos::reset_pending_committing_finishers()
 {
+  proposal_start = utime_t();
   committing_finishers.splice(committing_finishers.end(), pending_finishers);
   finish_contexts(g_ceph_context, committing_finishers, -EAGAIN);
 }
@@ -1548,6 +1586,15 @@ void Paxos::propose_pending()
 
   pending_proposal.reset();
 
+  if (!batch_start.is_zero()) {
+    logger->tinc(l_paxos_proposal_batch_delay,
+		 ceph_clock_now() - batch_start);
+    batch_start = utime_t();
+  }
+  proposal_start = ceph_clock_now();
+  proposal_batch = pending_finishers.size();
+  logger->inc(l_paxos_proposal_batch, proposal_batch);
+
   committing_finishers.swap(pending_finishers);
   state = STATE_UPDATING;
   begin(bl);
@@ -1575,7 +1622,26 @@ bool Paxos::trigger_propose()
   if (plugged) {
     dout(10) << __func__ << " plugged, not proposing now" << dendl;
     return false;
+  } else if (batch_event) {
+    dout(10) << __func__ << " batching, will propose shortly" << dendl;
+    return false;
   } else if (is_active()) {
+    double delay = get_propose_batch_delay();
+    if (delay > 0) {
+      dout(10) << __func__ << " active, proposing in " << delay
+	       << "s to batch changes" << dendl;
+      batch_start = ceph_clock_now();
+      batch_event = mon->timer.add_event_after(
+	delay,
+	new C_MonContext{mon, [this](int r) {
+	  batch_event = 0;
+	  if (r == -ECANCELED)
+	    return;
+	  if (!plugged && is_active() && pending_proposal)
+	    propose_pending();
+	}});
+      return false;
+    }
     dout(10) << __func__ << " active, proposing now" << dendl;
     propose_pending();
     return true;
@@ -1585,6 +1651,20 @@ bool Paxos::trigger_propose()
   }
 }
 
+double Paxos::get_propose_batch_delay()
+{
+  double max_delay = g_conf().get_val<double>("paxos_propose_batch_max_delay");
+  if (max_delay <= 0 || mon->get_quorum().size() == 1) {
+    return 0;
+  }
+  // only hold back proposals while they are following each other
+  // closely; an idle monitor proposes right away
+  if (ceph_clock_now() - last_commit_time > g_conf()->paxos_propose_interval) {
+    return 0;
+  }
+  return std::min(max_delay, avg_round_latency / 2);
+}
+
 bool Paxos::is_consistent()
 {
   return (first_committed <= last_committed);
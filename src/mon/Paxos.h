@@ -156,6 +156,10 @@ enum {
   l_paxos_share_state_bytes,
   l_paxos_new_pn,
   l_paxos_new_pn_latency,
+  l_paxos_proposal_batch,
+  l_paxos_proposal_batch_delay,
+  l_paxos_proposal_latency,
+  l_paxos_proposal_latency_batch_hist,
   l_paxos_last,
 };
 
@@ -629,6 +633,41 @@ private:
    */
   bool plugged = false;
 
+  /**
+   * @defgroup Paxos_h_batching Proposal batching
+   *
+   * While proposals follow each other closely, trigger_propose() holds
+   * the pending proposal back for a short, adaptive delay, so that the
+   * changes of other services get committed in the same round instead
+   * of waiting for the next one.
+   * @{
+   */
+  /**
+   * Proposes the pending transaction once the batching delay is over.
+   */
+  Context *batch_event = nullptr;
+  utime_t batch_start;
+  /**
+   * When the pending proposal was proposed, and how many changes (queued
+   * finishers) it carries.
+   */
+  utime_t proposal_start;
+  size_t proposal_batch = 0;
+  /**
+   * Moving average of the time from proposing a value to finishing the
+   * round, in seconds.
+   */
+  double avg_round_latency = 0;
+  /**
+   * How long to hold back a proposal that was just triggered
+   *
+   * @returns 0 if it should be proposed right away
+   */
+  double get_propose_batch_delay();
+  /**
+   * @}
+   */
+
   /**
    * @defgroup Paxos_h_callbacks Callback classes.
    * @{
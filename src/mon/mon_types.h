@@ -488,6 +488,8 @@ namespace ceph {
       constexpr mon_feature_t FEATURE_PACIFIC(    (1ULL << 6));
       // elector pinging and CONNECTIVITY mode:
       constexpr mon_feature_t FEATURE_PINGING(    (1ULL << 7));
+      // cluster log entries stored in compressed per-channel chunks:
+      constexpr mon_feature_t FEATURE_LOG_CHUNKS( (1ULL << 8));
 
       constexpr mon_feature_t FEATURE_RESERVED(   (1ULL << 63));
       constexpr mon_feature_t FEATURE_NONE(       (0ULL));
@@ -507,6 +509,7 @@ namespace ceph {
 	  FEATURE_OCTOPUS |
 	  FEATURE_PACIFIC |
 	  FEATURE_PINGING |
+	  FEATURE_LOG_CHUNKS |
 	  FEATURE_NONE
 	  );
       }
@@ -530,6 +533,7 @@ namespace ceph {
 	  FEATURE_OCTOPUS |
 	  FEATURE_PACIFIC |
 	  FEATURE_PINGING |
+	  FEATURE_LOG_CHUNKS |
 	  FEATURE_NONE
 	  );
       }
@@ -584,6 +588,8 @@ static inline const char *ceph::features::mon::get_feature_name(uint64_t b) {
     return "nautilus";
   } else if (f == FEATURE_PINGING) {
     return "elector-pinging";
+  } else if (f == FEATURE_LOG_CHUNKS) {
+    return "log-chunks";
   } else if (f == FEATURE_OCTOPUS) {
     return "octopus";
   } else if (f == FEATURE_PACIFIC) {
@@ -608,6 +614,8 @@ inline mon_feature_t ceph::features::mon::get_feature_by_name(const std::string
     return FEATURE_NAUTILUS;
   } else if (n == "feature-pinging") {
     return FEATURE_PINGING;
+  } else if (n == "log-chunks") {
+    return FEATURE_LOG_CHUNKS;
   } else if (n == "octopus") {
     return FEATURE_OCTOPUS;
   } else if (n == "pacific") {
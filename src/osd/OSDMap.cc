@@ -16,8 +16,10 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <optional>
 #include <random>
+#include <thread>
 
 #include <boost/algorithm/string.hpp>
 
@@ -35,6 +37,7 @@
 
 #include "crush/CrushTreeDumper.h"
 #include "common/Clock.h"
+#include "common/Thread.h"
 #include "mon/PGMap.h"
 
 using std::list;
@@ -1402,13 +1405,15 @@ void OSDMap::set_max_osd(int m)
   osd_weight.resize(max_osd, CEPH_OSD_OUT);
   osd_info.resize(max_osd);
   osd_xinfo.resize(max_osd);
-  osd_addrs->client_addrs.resize(max_osd);
-  osd_addrs->cluster_addrs.resize(max_osd);
-  osd_addrs->hb_back_addrs.resize(max_osd);
-  osd_addrs->hb_front_addrs.resize(max_osd);
-  osd_uuid->resize(max_osd);
+  auto& addrs = _unshare(osd_addrs);
+  addrs.client_addrs.resize(max_osd);
+  addrs.cluster_addrs.resize(max_osd);
+  addrs.hb_back_addrs.resize(max_osd);
+  addrs.hb_front_addrs.resize(max_osd);
+  _unshare(osd_uuid).resize(max_osd);
   if (osd_primary_affinity)
-    osd_primary_affinity->resize(max_osd, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY);
+    _unshare(osd_primary_affinity).resize(max_osd,
+					  CEPH_OSD_DEFAULT_PRIMARY_AFFINITY);
 
   calc_num_osds();
 }
@@ -1601,7 +1606,7 @@ uint64_t OSDMap::get_features(int entity_type, uint64_t *pmask) const
   }
   mask |= CEPH_FEATURES_CRUSH;
 
-  if (!pg_upmap.empty() || !pg_upmap_items.empty())
+  if (!pg_upmap->empty() || !pg_upmap_items->empty())
     features |= CEPH_FEATUREMASK_OSDMAP_PG_UPMAP;
   mask |= CEPH_FEATUREMASK_OSDMAP_PG_UPMAP;
 
@@ -1742,27 +1747,31 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
   // do addrs match?
   if (o->max_osd != n->max_osd)
     diff++;
-  for (int i = 0; i < o->max_osd && i < n->max_osd; i++) {
-    if ( n->osd_addrs->client_addrs[i] &&  o->osd_addrs->client_addrs[i] &&
-	*n->osd_addrs->client_addrs[i] == *o->osd_addrs->client_addrs[i])
-      n->osd_addrs->client_addrs[i] = o->osd_addrs->client_addrs[i];
-    else
-      diff++;
-    if ( n->osd_addrs->cluster_addrs[i] &&  o->osd_addrs->cluster_addrs[i] &&
-	*n->osd_addrs->cluster_addrs[i] == *o->osd_addrs->cluster_addrs[i])
-      n->osd_addrs->cluster_addrs[i] = o->osd_addrs->cluster_addrs[i];
-    else
-      diff++;
-    if ( n->osd_addrs->hb_back_addrs[i] &&  o->osd_addrs->hb_back_addrs[i] &&
-	*n->osd_addrs->hb_back_addrs[i] == *o->osd_addrs->hb_back_addrs[i])
-      n->osd_addrs->hb_back_addrs[i] = o->osd_addrs->hb_back_addrs[i];
-    else
-      diff++;
-    if ( n->osd_addrs->hb_front_addrs[i] &&  o->osd_addrs->hb_front_addrs[i] &&
-	*n->osd_addrs->hb_front_addrs[i] == *o->osd_addrs->hb_front_addrs[i])
-      n->osd_addrs->hb_front_addrs[i] = o->osd_addrs->hb_front_addrs[i];
-    else
-      diff++;
+  if (n->osd_addrs != o->osd_addrs) {
+    auto& n_addrs = _unshare(n->osd_addrs);
+    const auto& o_addrs = *o->osd_addrs;
+    for (int i = 0; i < o->max_osd && i < n->max_osd; i++) {
+      if ( n_addrs.client_addrs[i] &&  o_addrs.client_addrs[i] &&
+	  *n_addrs.client_addrs[i] == *o_addrs.client_addrs[i])
+	n_addrs.client_addrs[i] = o_addrs.client_addrs[i];
+      else
+	diff++;
+      if ( n_addrs.cluster_addrs[i] &&  o_addrs.cluster_addrs[i] &&
+	  *n_addrs.cluster_addrs[i] == *o_addrs.cluster_addrs[i])
+	n_addrs.cluster_addrs[i] = o_addrs.cluster_addrs[i];
+      else
+	diff++;
+      if ( n_addrs.hb_back_addrs[i] &&  o_addrs.hb_back_addrs[i] &&
+	  *n_addrs.hb_back_addrs[i] == *o_addrs.hb_back_addrs[i])
+	n_addrs.hb_back_addrs[i] = o_addrs.hb_back_addrs[i];
+      else
+	diff++;
+      if ( n_addrs.hb_front_addrs[i] &&  o_addrs.hb_front_addrs[i] &&
+	  *n_addrs.hb_front_addrs[i] == *o_addrs.hb_front_addrs[i])
+	n_addrs.hb_front_addrs[i] = o_addrs.hb_front_addrs[i];
+      else
+	diff++;
+    }
   }
   if (diff == 0) {
     // zoinks, no differences at all!
@@ -1787,6 +1796,12 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
       n->primary_temp = o->primary_temp;
   }
 
+  // do pg_upmap and pg_upmap_items match?
+  if (*o->pg_upmap == *n->pg_upmap)
+    n->pg_upmap = o->pg_upmap;
+  if (*o->pg_upmap_items == *n->pg_upmap_items)
+    n->pg_upmap_items = o->pg_upmap_items;
+
   // do uuids match?
   if (o->osd_uuid->size() == n->osd_uuid->size() &&
       *o->osd_uuid == *n->osd_uuid)
@@ -1876,10 +1891,10 @@ void OSDMap::clean_temps(CephContext *cct,
 
 void OSDMap::get_upmap_pgs(vector<pg_t> *upmap_pgs) const
 {
-  upmap_pgs->reserve(pg_upmap.size() + pg_upmap_items.size());
-  for (auto& p : pg_upmap)
+  upmap_pgs->reserve(pg_upmap->size() + pg_upmap_items->size());
+  for (auto& p : *pg_upmap)
     upmap_pgs->push_back(p.first);
-  for (auto& p : pg_upmap_items)
+  for (auto& p : *pg_upmap_items)
     upmap_pgs->push_back(p.first);
 }
 
@@ -1959,16 +1974,16 @@ bool OSDMap::check_pg_upmaps(
       continue;
     // okay, upmap is valid
     // continue to check if it is still necessary
-    auto i = pg_upmap.find(pg);
-    if (i != pg_upmap.end() && raw == i->second) {
+    auto i = pg_upmap->find(pg);
+    if (i != pg_upmap->end() && raw == i->second) {
       ldout(cct, 10) << " removing redundant pg_upmap "
                      << i->first << " " << i->second
                      << dendl;
       to_cancel->push_back(pg);
       continue;
     }
-    auto j = pg_upmap_items.find(pg);
-    if (j != pg_upmap_items.end()) {
+    auto j = pg_upmap_items->find(pg);
+    if (j != pg_upmap_items->end()) {
       mempool::osdmap::vector<pair<int,int>> newmap;
       for (auto& p : j->second) {
         if (std::find(raw.begin(), raw.end(), p.first) == raw.end()) {
@@ -2016,8 +2031,8 @@ void OSDMap::clean_pg_upmaps(
                      << dendl;
       pending_inc->new_pg_upmap.erase(i);
     }
-    auto j = pg_upmap.find(pg);
-    if (j != pg_upmap.end()) {
+    auto j = pg_upmap->find(pg);
+    if (j != pg_upmap->end()) {
       ldout(cct, 10) << __func__ << " cancel invalid pg_upmap entry "
                      << j->first << "->" << j->second
                      << dendl;
@@ -2031,8 +2046,8 @@ void OSDMap::clean_pg_upmaps(
                      << dendl;
       pending_inc->new_pg_upmap_items.erase(p);
     }
-    auto q = pg_upmap_items.find(pg);
-    if (q != pg_upmap_items.end()) {
+    auto q = pg_upmap_items->find(pg);
+    if (q != pg_upmap_items->end()) {
       ldout(cct, 10) << __func__ << " cancel invalid "
                      << "pg_upmap_items entry "
                      << q->first << "->" << q->second
@@ -2185,14 +2200,15 @@ int OSDMap::apply_incremental(const Incremental &inc)
     if ((osd_state[osd] & CEPH_OSD_EXISTS) &&
 	(s & CEPH_OSD_EXISTS)) {
       // osd is destroyed; clear out anything interesting.
-      (*osd_uuid)[osd] = uuid_d();
+      _unshare(osd_uuid)[osd] = uuid_d();
       osd_info[osd] = osd_info_t();
       osd_xinfo[osd] = osd_xinfo_t();
       set_primary_affinity(osd, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY);
-      osd_addrs->client_addrs[osd].reset(new entity_addrvec_t());
-      osd_addrs->cluster_addrs[osd].reset(new entity_addrvec_t());
-      osd_addrs->hb_front_addrs[osd].reset(new entity_addrvec_t());
-      osd_addrs->hb_back_addrs[osd].reset(new entity_addrvec_t());
+      auto& addrs = _unshare(osd_addrs);
+      addrs.client_addrs[osd].reset(new entity_addrvec_t());
+      addrs.cluster_addrs[osd].reset(new entity_addrvec_t());
+      addrs.hb_front_addrs[osd].reset(new entity_addrvec_t());
+      addrs.hb_back_addrs[osd].reset(new entity_addrvec_t());
       osd_state[osd] = 0;
     } else {
       osd_state[osd] ^= s;
@@ -2202,18 +2218,19 @@ int OSDMap::apply_incremental(const Incremental &inc)
   for (const auto &client : inc.new_up_client) {
     osd_state[client.first] |= CEPH_OSD_EXISTS | CEPH_OSD_UP;
     osd_state[client.first] &= ~CEPH_OSD_STOP; // if any
-    osd_addrs->client_addrs[client.first].reset(
+    auto& addrs = _unshare(osd_addrs);
+    addrs.client_addrs[client.first].reset(
       new entity_addrvec_t(client.second));
-    osd_addrs->hb_back_addrs[client.first].reset(
+    addrs.hb_back_addrs[client.first].reset(
       new entity_addrvec_t(inc.new_hb_back_up.find(client.first)->second));
-    osd_addrs->hb_front_addrs[client.first].reset(
+    addrs.hb_front_addrs[client.first].reset(
       new entity_addrvec_t(inc.new_hb_front_up.find(client.first)->second));
 
     osd_info[client.first].up_from = epoch;
   }
 
   for (const auto &cluster : inc.new_up_cluster)
-    osd_addrs->cluster_addrs[cluster.first].reset(
+    _unshare(osd_addrs).cluster_addrs[cluster.first].reset(
       new entity_addrvec_t(cluster.second));
 
   // info
@@ -2234,38 +2251,48 @@ int OSDMap::apply_incremental(const Incremental &inc)
 
   // uuid
   for (const auto &uuid : inc.new_uuid)
-    (*osd_uuid)[uuid.first] = uuid.second;
+    _unshare(osd_uuid)[uuid.first] = uuid.second;
 
   // pg rebuild
-  for (const auto &pg : inc.new_pg_temp) {
-    if (pg.second.empty())
-      pg_temp->erase(pg.first);
-    else
-      pg_temp->set(pg.first, pg.second);
-  }
   if (!inc.new_pg_temp.empty()) {
+    auto& temp = _unshare(pg_temp);
+    for (const auto &pg : inc.new_pg_temp) {
+      if (pg.second.empty())
+	temp.erase(pg.first);
+      else
+	temp.set(pg.first, pg.second);
+    }
     // make sure pg_temp is efficiently stored
-    pg_temp->rebuild();
+    temp.rebuild();
   }
 
-  for (const auto &pg : inc.new_primary_temp) {
-    if (pg.second == -1)
-      primary_temp->erase(pg.first);
-    else
-      (*primary_temp)[pg.first] = pg.second;
+  if (!inc.new_primary_temp.empty()) {
+    auto& temp = _unshare(primary_temp);
+    for (const auto &pg : inc.new_primary_temp) {
+      if (pg.second == -1)
+	temp.erase(pg.first);
+      else
+	temp[pg.first] = pg.second;
+    }
   }
 
-  for (auto& p : inc.new_pg_upmap) {
-    pg_upmap[p.first] = p.second;
-  }
-  for (auto& pg : inc.old_pg_upmap) {
-    pg_upmap.erase(pg);
-  }
-  for (auto& p : inc.new_pg_upmap_items) {
-    pg_upmap_items[p.first] = p.second;
+  if (!inc.new_pg_upmap.empty() || !inc.old_pg_upmap.empty()) {
+    auto& upmap = _unshare(pg_upmap);
+    for (auto& p : inc.new_pg_upmap) {
+      upmap[p.first] = p.second;
+    }
+    for (auto& pg : inc.old_pg_upmap) {
+      upmap.erase(pg);
+    }
   }
-  for (auto& pg : inc.old_pg_upmap_items) {
-    pg_upmap_items.erase(pg);
+  if (!inc.new_pg_upmap_items.empty() || !inc.old_pg_upmap_items.empty()) {
+    auto& upmap_items = _unshare(pg_upmap_items);
+    for (auto& p : inc.new_pg_upmap_items) {
+      upmap_items[p.first] = p.second;
+    }
+    for (auto& pg : inc.old_pg_upmap_items) {
+      upmap_items.erase(pg);
+    }
   }
 
   // blocklist
@@ -2466,8 +2493,8 @@ int OSDMap::_pick_primary(const vector<int>& osds) const
 void OSDMap::_apply_upmap(const pg_pool_t& pi, pg_t raw_pg, vector<int> *raw) const
 {
   pg_t pg = pi.raw_pg_to_pg(raw_pg);
-  auto p = pg_upmap.find(pg);
-  if (p != pg_upmap.end()) {
+  auto p = pg_upmap->find(pg);
+  if (p != pg_upmap->end()) {
     // make sure targets aren't marked out
     for (auto osd : p->second) {
       if (osd != CRUSH_ITEM_NONE && osd < max_osd && osd >= 0 &&
@@ -2480,8 +2507,8 @@ void OSDMap::_apply_upmap(const pg_pool_t& pi, pg_t raw_pg, vector<int> *raw) co
     // continue to check and apply pg_upmap_items if any
   }
 
-  auto q = pg_upmap_items.find(pg);
-  if (q != pg_upmap_items.end()) {
+  auto q = pg_upmap_items->find(pg);
+  if (q != pg_upmap_items->end()) {
     // NOTE: this approach does not allow a bidirectional swap,
     // e.g., [[1,2],[2,1]] applied to [0,1,2] -> [0,2,1].
     for (auto& r : q->second) {
@@ -3003,11 +3030,11 @@ void OSDMap::encode(ceph::buffer::list& bl, uint64_t features) const
     encode(erasure_code_profiles, bl);
 
     if (v >= 4) {
-      encode(pg_upmap, bl);
-      encode(pg_upmap_items, bl);
+      encode(*pg_upmap, bl);
+      encode(*pg_upmap_items, bl);
     } else {
-      ceph_assert(pg_upmap.empty());
-      ceph_assert(pg_upmap_items.empty());
+      ceph_assert(pg_upmap->empty());
+      ceph_assert(pg_upmap_items->empty());
     }
     if (v >= 6) {
       encode(crush_version, bl);
@@ -3129,6 +3156,25 @@ void OSDMap::decode(ceph::buffer::list& bl)
   decode(p);
 }
 
+void OSDMap::_detach_shared()
+{
+  // the decoded contents replace those of the sub-structures, which may
+  // be shared with the map this one was copied from
+  auto detach = [](auto& p) {
+    using T = typename std::decay_t<decltype(p)>::element_type;
+    if (p.use_count() > 1) {
+      p = std::make_shared<T>();
+    }
+  };
+  detach(osd_addrs);
+  detach(pg_temp);
+  detach(primary_temp);
+  detach(pg_upmap);
+  detach(pg_upmap_items);
+  detach(osd_uuid);
+  detach(crush);
+}
+
 void OSDMap::decode_classic(ceph::buffer::list::const_iterator& p)
 {
   using ceph::decode;
@@ -3264,6 +3310,8 @@ void OSDMap::decode(ceph::buffer::list::const_iterator& bl)
   size_t tail_offset = 0;
   ceph::buffer::list crc_front, crc_tail;
 
+  _detach_shared();
+
   DECODE_START_LEGACY_COMPAT_LEN(8, 7, 7, bl); // wrapper
   if (struct_v < 7) {
     bl.seek(start_offset);
@@ -3330,11 +3378,11 @@ void OSDMap::decode(ceph::buffer::list::const_iterator& bl)
     // version increased from 3 to 4 still in luminous, so same as above
     // applies.
     if (struct_v >= 4) {
-      decode(pg_upmap, bl);
-      decode(pg_upmap_items, bl);
+      decode(*pg_upmap, bl);
+      decode(*pg_upmap_items, bl);
     } else {
-      pg_upmap.clear();
-      pg_upmap_items.clear();
+      pg_upmap->clear();
+      pg_upmap_items->clear();
     }
     // again, version increased from 5 to 6 still in luminous, so above
     // applies.
@@ -3602,7 +3650,7 @@ void OSDMap::dump(Formatter *f) const
   f->close_section();
 
   f->open_array_section("pg_upmap");
-  for (auto& p : pg_upmap) {
+  for (auto& p : *pg_upmap) {
     f->open_object_section("mapping");
     f->dump_stream("pgid") << p.first;
     f->open_array_section("osds");
@@ -3614,7 +3662,7 @@ void OSDMap::dump(Formatter *f) const
   }
   f->close_section();
   f->open_array_section("pg_upmap_items");
-  for (auto& p : pg_upmap_items) {
+  for (auto& p : *pg_upmap_items) {
     f->open_object_section("mapping");
     f->dump_stream("pgid") << p.first;
     f->open_array_section("mappings");
@@ -3888,10 +3936,10 @@ void OSDMap::print(ostream& out) const
   print_osds(out);
   out << std::endl;
 
-  for (auto& p : pg_upmap) {
+  for (auto& p : *pg_upmap) {
     out << "pg_upmap " << p.first << " " << p.second << "\n";
   }
-  for (auto& p : pg_upmap_items) {
+  for (auto& p : *pg_upmap_items) {
     out << "pg_upmap_items " << p.first << " " << p.second << "\n";
   }
 
@@ -4828,8 +4876,8 @@ int OSDMap::calc_pg_upmaps(
       }
       // look for remaps we can un-remap
       for (auto pg : pgs) {
-	auto p = tmp.pg_upmap_items.find(pg);
-        if (p == tmp.pg_upmap_items.end())
+	auto p = tmp.pg_upmap_items->find(pg);
+        if (p == tmp.pg_upmap_items->end())
           continue;
         mempool::osdmap::vector<pair<int32_t,int32_t>> new_upmap_items;
         for (auto q : p->second) {
@@ -4868,8 +4916,8 @@ int OSDMap::calc_pg_upmaps(
 
       // try upmap
       for (auto pg : pgs) {
-        auto temp_it = tmp.pg_upmap.find(pg);
-        if (temp_it != tmp.pg_upmap.end()) {
+        auto temp_it = tmp.pg_upmap->find(pg);
+        if (temp_it != tmp.pg_upmap->end()) {
           // leave pg_upmap alone
           // it must be specified by admin since balancer does not
           // support pg_upmap yet
@@ -4881,14 +4929,14 @@ int OSDMap::calc_pg_upmaps(
         auto pg_pool_size = tmp.get_pg_pool_size(pg);
         mempool::osdmap::vector<pair<int32_t,int32_t>> new_upmap_items;
         set<int> existing;
-        auto it = tmp.pg_upmap_items.find(pg);
-        if (it != tmp.pg_upmap_items.end() &&
+        auto it = tmp.pg_upmap_items->find(pg);
+        if (it != tmp.pg_upmap_items->end() &&
             it->second.size() >= (size_t)pg_pool_size) {
           ldout(cct, 10) << " " << pg << " already has full-size pg_upmap_items "
                          << it->second << ", skipping"
                          << dendl;
           continue;
-        } else if (it != tmp.pg_upmap_items.end()) {
+        } else if (it != tmp.pg_upmap_items->end()) {
           ldout(cct, 10) << " " << pg << " already has pg_upmap_items "
                          << it->second
                          << dendl;
@@ -4971,8 +5019,8 @@ int OSDMap::calc_pg_upmaps(
       // look for remaps we can un-remap
       vector<pair<pg_t,
         mempool::osdmap::vector<pair<int32_t,int32_t>>>> candidates;
-      candidates.reserve(tmp.pg_upmap_items.size());
-      for (auto& i : tmp.pg_upmap_items) {
+      candidates.reserve(tmp.pg_upmap_items->size());
+      for (auto& i : *tmp.pg_upmap_items) {
         if (to_skip.count(i.first))
           continue;
         if (!only_pools.empty() && !only_pools.count(i.first.pool()))
@@ -5104,8 +5152,8 @@ int OSDMap::calc_pg_upmaps(
     deviation_osd = temp_deviation_osd;
     for (auto& i : to_unmap) {
       ldout(cct, 10) << " unmap pg " << i << dendl;
-      ceph_assert(tmp.pg_upmap_items.count(i));
-      tmp.pg_upmap_items.erase(i);
+      ceph_assert(tmp.pg_upmap_items->count(i));
+      _unshare(tmp.pg_upmap_items).erase(i);
       pending_inc->old_pg_upmap_items.insert(i);
       ++num_changed;
     }
@@ -5113,7 +5161,7 @@ int OSDMap::calc_pg_upmaps(
       ldout(cct, 10) << " upmap pg " << i.first
                      << " new pg_upmap_items " << i.second
                      << dendl;
-      tmp.pg_upmap_items[i.first] = i.second;
+      _unshare(tmp.pg_upmap_items)[i.first] = i.second;
       pending_inc->new_pg_upmap_items[i.first] = i.second;
       ++num_changed;
     }
@@ -5128,6 +5176,81 @@ int OSDMap::calc_pg_upmaps(
   return num_changed;
 }
 
+int OSDMap::calc_pg_upmaps_parallel(
+  CephContext *cct,
+  uint32_t max_deviation,
+  int max,
+  const vector<pair<int64_t,int>>& pools,
+  unsigned num_threads,
+  OSDMap::Incremental *pending_inc,
+  map<int64_t,int> *changed_by_pool)
+{
+  ldout(cct, 10) << __func__ << " pools " << pools
+		 << " max " << max
+		 << " threads " << num_threads << dendl;
+  // the deviation of an osd is only computed from the pgs of the pools
+  // being balanced, so each pool can be balanced on its own.  the
+  // copies calc_pg_upmaps() makes of this map share everything it does
+  // not change, and crush is only read, so the pools can be balanced
+  // concurrently.
+  struct pool_result_t {
+    Incremental inc;
+    int changed = 0;
+  };
+  vector<pool_result_t> results(pools.size());
+  std::atomic<size_t> next = {0};
+  auto calc_pools = [&]() {
+    for (size_t i = next++; i < pools.size(); i = next++) {
+      auto& [pool, pool_max] = pools[i];
+      results[i].changed = calc_pg_upmaps(cct, max_deviation,
+					  std::min(pool_max, max),
+					  {pool}, &results[i].inc);
+    }
+  };
+  num_threads = std::clamp<size_t>(num_threads, 1, pools.size());
+  vector<std::thread> threads;
+  for (unsigned i = 1; i < num_threads; ++i) {
+    threads.push_back(make_named_thread("pg_upmaps", calc_pools));
+  }
+  calc_pools();
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  // merge in order of preference.  like in a serial run, a pool whose
+  // changes do not fit in what is left of the limit is balanced within
+  // what is left instead
+  int num_changed = 0;
+  for (size_t i = 0; i < pools.size() && num_changed < max; ++i) {
+    auto& r = results[i];
+    if (num_changed + r.changed > max) {
+      auto& [pool, pool_max] = pools[i];
+      ldout(cct, 10) << __func__ << " pool " << pool
+		     << " has " << r.changed << " changes but only "
+		     << max - num_changed << " left" << dendl;
+      r.inc = Incremental();
+      r.changed = calc_pg_upmaps(cct, max_deviation,
+				 std::min(pool_max, max - num_changed),
+				 {pool}, &r.inc);
+    }
+    if (r.changed == 0) {
+      continue;
+    }
+    for (auto& pg : r.inc.old_pg_upmap_items) {
+      pending_inc->old_pg_upmap_items.insert(pg);
+    }
+    for (auto& [pg, items] : r.inc.new_pg_upmap_items) {
+      pending_inc->new_pg_upmap_items[pg] = items;
+    }
+    if (changed_by_pool) {
+      (*changed_by_pool)[pools[i].first] = r.changed;
+    }
+    num_changed += r.changed;
+  }
+  ldout(cct, 10) << __func__ << " num_changed = " << num_changed << dendl;
+  return num_changed;
+}
+
 int OSDMap::get_osds_by_bucket_name(const string &name, set<int> *osds) const
 {
   return crush->get_leaves(name, osds);
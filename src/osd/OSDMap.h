@@ -29,6 +29,7 @@
 #include <set>
 #include <map>
 #include <memory>
+#include <utility>
 
 #include <boost/smart_ptr/local_shared_ptr.hpp>
 #include "include/btree_map.h"
@@ -560,6 +561,9 @@ private:
     mempool::osdmap::vector<std::shared_ptr<entity_addrvec_t> > hb_back_addrs;
     mempool::osdmap::vector<std::shared_ptr<entity_addrvec_t> > hb_front_addrs;
   };
+  // The sub-structures held by shared_ptr are shared by the maps copied
+  // from one another (see deepish_copy_from()) and are copied on write:
+  // modify them through _unshare().
   std::shared_ptr<addrs_s> osd_addrs;
 
   entity_addrvec_t _blank_addrvec;
@@ -571,8 +575,8 @@ private:
   std::shared_ptr< mempool::osdmap::vector<__u32> > osd_primary_affinity; ///< 16.16 fixed point, 0x10000 = baseline
 
   // remap (post-CRUSH, pre-up)
-  mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>> pg_upmap; ///< remap pg
-  mempool::osdmap::map<pg_t,mempool::osdmap::vector<std::pair<int32_t,int32_t>>> pg_upmap_items; ///< remap osds in up set
+  std::shared_ptr<mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>>> pg_upmap; ///< remap pg
+  std::shared_ptr<mempool::osdmap::map<pg_t,mempool::osdmap::vector<std::pair<int32_t,int32_t>>>> pg_upmap_items; ///< remap osds in up set
 
   mempool::osdmap::map<int64_t,pg_pool_t> pools;
   mempool::osdmap::map<int64_t,std::string> pool_name;
@@ -614,6 +618,17 @@ private:
 
   void _calc_up_osd_features();
 
+  /// get a sub-structure for modification, copying it first if it is
+  /// shared with another map
+  template<typename T>
+  static T& _unshare(std::shared_ptr<T>& p) {
+    if (p.use_count() > 1) {
+      p = std::make_shared<T>(std::as_const(*p));
+    }
+    return *p;
+  }
+  void _detach_shared();
+
  public:
   bool have_crc() const { return crc_defined; }
   uint32_t get_crc() const { return crc; }
@@ -638,6 +653,8 @@ private:
 	     osd_addrs(std::make_shared<addrs_s>()),
 	     pg_temp(std::make_shared<PGTempMap>()),
 	     primary_temp(std::make_shared<mempool::osdmap::map<pg_t,int32_t>>()),
+	     pg_upmap(std::make_shared<mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>>>()),
+	     pg_upmap_items(std::make_shared<mempool::osdmap::map<pg_t,mempool::osdmap::vector<std::pair<int32_t,int32_t>>>>()),
 	     osd_uuid(std::make_shared<mempool::osdmap::vector<uuid_d>>()),
 	     cluster_snapshot_epoch(0),
 	     new_blocklist_entries(false),
@@ -660,17 +677,17 @@ public:
 
   uint64_t get_encoding_features() const;
 
+  /**
+   * copy a map in order to modify it, typically to apply the next
+   * incremental.
+   *
+   * the pg_temp, primary_temp, pg_upmap[_items], primary affinity, uuid
+   * and address sub-structures are shared with @p o and only copied when
+   * either map modifies them, so that the cost of a new epoch follows
+   * what the incremental changes.
+   */
   void deepish_copy_from(const OSDMap& o) {
     *this = o;
-    primary_temp.reset(new mempool::osdmap::map<pg_t,int32_t>(*o.primary_temp));
-    pg_temp.reset(new PGTempMap(*o.pg_temp));
-    osd_uuid.reset(new mempool::osdmap::vector<uuid_d>(*o.osd_uuid));
-
-    if (o.osd_primary_affinity)
-      osd_primary_affinity.reset(new mempool::osdmap::vector<__u32>(*o.osd_primary_affinity));
-
-    // NOTE: this still references shared entity_addrvec_t's.
-    osd_addrs.reset(new addrs_s(*o.osd_addrs));
 
     // NOTE: we do not copy crush.  note that apply_incremental will
     // allocate a new CrushWrapper, though.
@@ -785,11 +802,14 @@ public:
 
   void set_primary_affinity(int o, int w) {
     ceph_assert(o < max_osd);
-    if (!osd_primary_affinity)
+    if (!osd_primary_affinity) {
       osd_primary_affinity.reset(
 	new mempool::osdmap::vector<__u32>(
 	  max_osd, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY));
-    (*osd_primary_affinity)[o] = w;
+    } else if ((*osd_primary_affinity)[o] == (__u32)w) {
+      return;
+    }
+    _unshare(osd_primary_affinity)[o] = w;
   }
   unsigned get_primary_affinity(int o) const {
     ceph_assert(o < max_osd);
@@ -1433,11 +1453,25 @@ public:
     Incremental *pending_inc
     );
 
+  /// run calc_pg_upmaps() for each pool on its own, on up to num_threads
+  /// threads, and merge the results into pending_inc in the given pool
+  /// order.  the last pool to get changes is limited to what is left
+  /// of max.
+  int calc_pg_upmaps_parallel(
+    CephContext *cct,
+    uint32_t max_deviation, ///< max deviation from target (value >= 1)
+    int max,                ///< max changes, in total
+    const std::vector<std::pair<int64_t,int>>& pools, ///< pool, max changes
+    unsigned num_threads,
+    Incremental *pending_inc,
+    std::map<int64_t,int> *changed_by_pool = nullptr ///< [optional] out
+    );
+
   int get_osds_by_bucket_name(const std::string &name, std::set<int> *osds) const;
 
   bool have_pg_upmaps(pg_t pg) const {
-    return pg_upmap.count(pg) ||
-      pg_upmap_items.count(pg);
+    return pg_upmap->count(pg) ||
+      pg_upmap_items->count(pg);
   }
 
   bool check_full(const std::set<pg_shard_t> &missing_on) const {
@@ -1493,8 +1527,8 @@ public:
   int validate_crush_rules(CrushWrapper *crush, std::ostream *ss) const;
 
   void clear_temp() {
-    pg_temp->clear();
-    primary_temp->clear();
+    pg_temp = std::make_shared<PGTempMap>();
+    primary_temp = std::make_shared<mempool::osdmap::map<pg_t,int32_t>>();
   }
 
 private:
@@ -319,6 +319,15 @@ class Module(MgrModule):
             'long_desc': 'If the number of PGs are within this count then no optimization is attempted',
             'runtime': True,
         },
+        {
+            'name': 'upmap_max_threads',
+            'type': 'uint',
+            'default': 1,
+            'min': 1,
+            'desc': 'maximum number of pools to optimize at the same time',
+            'long_desc': 'Pools are optimized on their own, so with more than one thread several of them can be optimized at once; the changes are then combined in the order of the shuffled pool list, up to upmap_max_optimizations',
+            'runtime': True,
+        },
         {
             'name': 'pool_ids',
             'type': 'str',
@@ -450,8 +459,8 @@ class Module(MgrModule):
                     return (-errno.EPERM, '', warn)
             elif command['mode'] == 'crush-compat':
                 ms = MappingState(self.get_osdmap(),
-                                  self.get("pg_stats"),
-                                  self.get("pool_stats"),
+                                  self.get_view("pg_stats"),
+                                  self.get_view("pool_stats"),
                                   'initialize compat weight-set')
                 self.get_compat_weight_set_weights(ms) # ignore error
             self.set_module_option('mode', command['mode'])
@@ -528,7 +537,7 @@ class Module(MgrModule):
                     if option not in valid_pool_names:
                          return (-errno.EINVAL, '', 'option "%s" not a plan or a pool' % option)
                     pools.append(option)
-                    ms = MappingState(osdmap, self.get("pg_stats"), self.get("pool_stats"), 'pool "%s"' % option)
+                    ms = MappingState(osdmap, self.get_view("pg_stats"), self.get_view("pool_stats"), 'pool "%s"' % option)
                 else:
                     pools = plan.pools
                     if plan.mode == 'upmap':
@@ -539,15 +548,15 @@ class Module(MgrModule):
                         # using an old snapshotted osdmap vs a fresh copy of pg_stats.
                         # It should not be a big deal though..
                         ms = MappingState(plan.osdmap,
-                                          self.get("pg_stats"),
-                                          self.get("pool_stats"),
+                                          self.get_view("pg_stats"),
+                                          self.get_view("pool_stats"),
                                           'plan "%s"' % plan.name)
                     else:
                         ms = plan.final_state()
             else:
                 ms = MappingState(self.get_osdmap(),
-                                  self.get("pg_stats"),
-                                  self.get("pool_stats"),
+                                  self.get_view("pg_stats"),
+                                  self.get_view("pool_stats"),
                                   'current cluster')
             return (0, self.evaluate(ms, pools, verbose=verbose), '')
         elif command['prefix'] == 'balancer optimize':
@@ -703,8 +712,8 @@ class Module(MgrModule):
             plan = MsPlan(name,
                           mode,
                           MappingState(osdmap,
-                                       self.get("pg_stats"),
-                                       self.get("pool_stats"),
+                                       self.get_view("pg_stats"),
+                                       self.get_view("pool_stats"),
                                        'plan %s initial' % name),
                           pools)
         return plan
@@ -972,6 +981,7 @@ class Module(MgrModule):
         self.log.info('do_upmap')
         max_optimizations = self.get_module_option('upmap_max_optimizations')
         max_deviation = self.get_module_option('upmap_max_deviation')
+        max_threads = self.get_module_option('upmap_max_threads')
         osdmap_dump = plan.osdmap_dump
 
         if len(plan.pools):
@@ -1004,6 +1014,7 @@ class Module(MgrModule):
         # shuffle so all pools get equal (in)attention
         random.shuffle(adjusted_pools)
         pool_dump = osdmap_dump.get('pools', [])
+        pool_available = []
         for pool in adjusted_pools:
             num_pg = 0
             for p in pool_dump:
@@ -1024,11 +1035,20 @@ class Module(MgrModule):
                         num_pg_active_clean += s['count']
                         break
             available = left - (num_pg - num_pg_active_clean)
+            if max_threads > 1:
+                # the pools are balanced below, sharing what is left
+                if available > 0:
+                    pool_available.append((pool, available))
+                continue
             did = plan.osdmap.calc_pg_upmaps(inc, max_deviation, available, [pool])
             total_did += did
             left -= did
             if left <= 0:
                 break
+        if pool_available:
+            total_did = plan.osdmap.calc_pg_upmaps_parallel(
+                inc, max_deviation, left, pool_available,
+                max_threads)
         self.log.info('prepared %d/%d changes' % (total_did, max_optimizations))
         if total_did == 0:
             return -errno.EALREADY, 'Unable to find further optimization, ' \
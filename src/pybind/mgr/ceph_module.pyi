@@ -11,6 +11,7 @@ class BasePyOSDMap(object):
     def _get_crush(self):...
     def _get_pools_by_take(self, take):...
     def _calc_pg_upmaps(self, inc, max_deviation, max_iterations, pool):...
+    def _calc_pg_upmaps_parallel(self, inc, max_deviation, max_iterations, pools, num_threads):...
     def _map_pool_pgs_up(self, poolid):...
     def _pg_to_up_acting_osds(self, pool_id, ps):...
     def _pool_raw_used_rate(self, pool_id):...
@@ -145,6 +145,16 @@ class OSDMap(ceph_module.BasePyOSDMap):
             inc,
             max_deviation, max_iterations, pools)
 
+    def calc_pg_upmaps_parallel(self, inc, max_deviation, max_iterations,
+                                pools, num_threads=1):
+        """
+        :param pools: list of (pool name, max changes in that pool), in
+            order of preference
+        """
+        return self._calc_pg_upmaps_parallel(
+            inc,
+            max_deviation, max_iterations, pools, num_threads)
+
     def map_pool_pgs_up(self, poolid):
         return self._map_pool_pgs_up(poolid)
 
@@ -914,6 +924,27 @@ class MgrModule(ceph_module.BaseMgrModule, MgrModuleLoggingMixin):
         """
         return self._ceph_get(data_name)
 
+    def get_view(self, data_name):
+        """
+        Like :meth:`get`, but returns a read-only view of the data instead
+        of a fresh copy of it.
+
+        For osd_map, pg_dump, pg_stats, pool_stats and osd_stats, ceph-mgr
+        takes a snapshot of the underlying map once per map version and
+        shares it between all the modules. The view behaves like a ``dict``
+        whose items are only converted to python objects when they are
+        accessed, and large arrays such as ``pg_stats`` are list-like
+        objects converting one item at a time. Views cannot be modified or
+        passed to ``json.dumps()`` directly; their ``version`` attribute is
+        the map version (epoch) they were taken at. The same view is
+        returned until the map changes.
+
+        Other data names are returned as by :meth:`get`.
+
+        :param str data_name: see :meth:`get`
+        """
+        return self._ceph_get_view(data_name)
+
     def _stattype_to_str(self, stattype):
 
         typeonly = stattype & self.PERFCOUNTER_TYPE_MASK
@@ -1472,6 +1503,25 @@ class MgrModule(ceph_module.BaseMgrModule, MgrModuleLoggingMixin):
 
         return result
 
+    def get_perf_counters_exposition(self, prio_limit=PRIO_USEFUL,
+                                     services=("mds", "mon", "osd",
+                                               "rbd-mirror", "rgw",
+                                               "tcmu-runner")):
+        """
+        Return the perf counters selected as by :meth:`get_all_perf_counters`,
+        in the prometheus text exposition format.
+
+        ceph-mgr keeps the samples of each daemon rendered as its reports
+        come in, so this is much cheaper than formatting the result of
+        :meth:`get_all_perf_counters`. Metric names are the counter paths
+        prefixed with ``ceph_``, every sample has a ``ceph_daemon`` label,
+        long running averages are exported as ``_sum`` and ``_count``
+        metrics and histograms are skipped.
+
+        :return: a string, empty if no counter is selected
+        """
+        return self._ceph_get_perf_counters_exposition(prio_limit, services)
+
     def set_uri(self, uri):
         """
         If the module exposes a service, then call this to publish the
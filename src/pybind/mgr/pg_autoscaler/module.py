@@ -265,7 +265,7 @@ class PgAutoscaler(MgrModule):
                     s.total_target_bytes += target_bytes * osdmap.pool_raw_used_rate(pool_id)
 
         # finish subtrees
-        all_stats = self.get('osd_stats')
+        all_stats = self.get_view('osd_stats')
         for s in roots:
             s.osd_count = len(s.osds)
             s.pg_target = s.osd_count * self.mon_target_pg_per_osd
@@ -490,7 +490,7 @@ class Module(MgrModule):
                     which_osds=[osd_id],
                     start_epoch=self.get_osdmap().get_epoch()
                     )
-            r_ev.pg_update(self.get("pg_stats"), self.get("pg_ready"), self.log)
+            r_ev.pg_update(self.get_view("pg_stats"), self.get("pg_ready"), self.log)
             self._events[r_ev.id] = r_ev
 
     def _osdmap_changed(self, old_osdmap, new_osdmap):
@@ -534,7 +534,7 @@ class Module(MgrModule):
             # expensive get calls
             if len(self._events) == 0:
                 return
-            data = self.get("pg_stats")
+            data = self.get_view("pg_stats")
             ready = self.get("pg_ready")
             for ev_id in list(self._events):
                 ev = self._events[ev_id]
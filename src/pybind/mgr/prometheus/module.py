@@ -587,7 +587,7 @@ class Module(MgrModule):
 
     @profile_method()
     def get_osd_stats(self):
-        osd_stats = self.get('osd_stats')
+        osd_stats = self.get_view('osd_stats')
         for osd in osd_stats['osd_stats']:
             id_ = osd['osd']
             for stat in OSD_STATS:
@@ -607,7 +607,7 @@ class Module(MgrModule):
 
     @profile_method()
     def get_metadata_and_osd_status(self):
-        osd_map = self.get('osd_map')
+        osd_map = self.get_view('osd_map')
         osd_flags = osd_map['flags'].split(',')
         for flag in OSD_FLAGS:
             self.metrics['osd_flag_{}'.format(flag)].set(
@@ -776,7 +776,7 @@ class Module(MgrModule):
 
             if pool_name == "*":
                 # collect for all pools
-                osd_map = self.get('osd_map')
+                osd_map = self.get_view('osd_map')
                 for pool in osd_map['pools']:
                     if 'rbd' not in pool.get('application_metadata', {}):
                         continue
@@ -989,33 +989,6 @@ class Module(MgrModule):
             del self.rbd_stats['query']
         self.rbd_stats['pools'].clear()
 
-    def add_fixed_name_metrics(self):
-        """
-        Add fixed name metrics from existing ones that have details in their names
-        that should be in labels (not in name).
-        For backward compatibility, a new fixed name metric is created (instead of replacing)
-        and details are put in new labels.
-        Intended for RGW sync perf. counters but extendable as required.
-        See: https://tracker.ceph.com/issues/45311
-        """
-        new_metrics = {}
-        for metric_path in self.metrics.keys():
-            # Address RGW sync perf. counters.
-            match = re.search('^data-sync-from-(.*)\.', metric_path)
-            if match:
-                new_path = re.sub('from-([^.]*)', 'from-zone', metric_path)
-                if new_path not in new_metrics:
-                    new_metrics[new_path] = Metric(
-                        self.metrics[metric_path].mtype,
-                        new_path,
-                        self.metrics[metric_path].desc,
-                        self.metrics[metric_path].labelnames + ('source_zone',)
-                    )
-                for label_values, value in self.metrics[metric_path].value.items():
-                    new_metrics[new_path].set(value, label_values + (match.group(1),))
-
-        self.metrics.update(new_metrics)
-
     @profile_method(True)
     def collect(self):
         # Clear the metrics before scraping
@@ -1033,53 +1006,6 @@ class Module(MgrModule):
         self.get_pg_status()
         self.get_num_objects()
 
-        for daemon, counters in self.get_all_perf_counters().items():
-            for path, counter_info in counters.items():
-                # Skip histograms, they are represented by long running avgs
-                stattype = self._stattype_to_str(counter_info['type'])
-                if not stattype or stattype == 'histogram':
-                    self.log.debug('ignoring %s, type %s' % (path, stattype))
-                    continue
-
-                path, label_names, labels = self._perfpath_to_path_labels(
-                    daemon, path)
-
-                # Get the value of the counter
-                value = self._perfvalue_to_value(
-                    counter_info['type'], counter_info['value'])
-
-                # Represent the long running avgs as sum/count pairs
-                if counter_info['type'] & self.PERFCOUNTER_LONGRUNAVG:
-                    _path = path + '_sum'
-                    if _path not in self.metrics:
-                        self.metrics[_path] = Metric(
-                            stattype,
-                            _path,
-                            counter_info['description'] + ' Total',
-                            label_names,
-                        )
-                    self.metrics[_path].set(value, labels)
-
-                    _path = path + '_count'
-                    if _path not in self.metrics:
-                        self.metrics[_path] = Metric(
-                            'counter',
-                            _path,
-                            counter_info['description'] + ' Count',
-                            label_names,
-                        )
-                    self.metrics[_path].set(counter_info['count'], labels,)
-                else:
-                    if path not in self.metrics:
-                        self.metrics[path] = Metric(
-                            stattype,
-                            path,
-                            counter_info['description'],
-                            label_names,
-                        )
-                    self.metrics[path].set(value, labels)
-
-        self.add_fixed_name_metrics()
         self.get_rbd_stats()
 
         # Return formatted metrics and clear no longer used data
@@ -1087,6 +1013,9 @@ class Module(MgrModule):
         for k in self.metrics.keys():
             self.metrics[k].clear()
 
+        # the daemons' perf counters are rendered by ceph-mgr itself
+        _metrics.append(self.get_perf_counters_exposition())
+
         return ''.join(_metrics) + '\n'
 
     def get_file_sd_config(self):
@@ -98,6 +98,9 @@ if 'UNITTEST' in os.environ:
         def _ceph_get(self, data_name):
             return self.mock_store_get('_ceph_get', data_name, mock.MagicMock())
 
+        def _ceph_get_view(self, data_name):
+            return self._ceph_get(data_name)
+
         def _ceph_send_command(self, res, svc_type, svc_id, command, tag):
             cmd = json.loads(command)
 
@@ -566,6 +566,7 @@ namespace rgw {
     ldh->bind();
 
     rgw_log_usage_init(g_ceph_context, store->getRados());
+    rgw_log_ops_init(g_ceph_context, store->getRados());
 
     // XXX ex-RGWRESTMgr_lib, mgr->set_logging(true)
 
@@ -621,6 +622,7 @@ namespace rgw {
     unregister_async_signal_handler(SIGUSR1, handle_sigterm);
     shutdown_async_signal_handler();
 
+    rgw_log_ops_finalize();
     rgw_log_usage_finalize();
 
     delete olog;
@@ -217,7 +217,7 @@ void usage()
   cout << "  policy                     read bucket/object policy\n";
   cout << "  log list                   list log objects\n";
   cout << "  log show                   dump a log from specific object or (bucket + date\n";
-  cout << "                             + bucket-id)\n";
+  cout << "                             + bucket-id), or from an ops log file (--infile)\n";
   cout << "                             (NOTE: required to specify formatting of date\n";
   cout << "                             to \"YYYY-MM-DD-hh\")\n";
   cout << "  log rm                     remove log object\n";
@@ -6182,7 +6182,9 @@ int main(int argc, const char **argv)
   }
 
   if (opt_cmd == OPT::LOG_SHOW || opt_cmd == OPT::LOG_RM) {
-    if (object.empty() && (date.empty() || bucket_name.empty() || bucket_id.empty())) {
+    const bool from_file = (opt_cmd == OPT::LOG_SHOW && !infile.empty());
+    if (!from_file && object.empty() &&
+        (date.empty() || bucket_name.empty() || bucket_id.empty())) {
       cerr << "specify an object or a date, bucket and bucket-id" << std::endl;
       exit(1);
     }
@@ -6200,11 +6202,31 @@ int main(int argc, const char **argv)
 
     if (opt_cmd == OPT::LOG_SHOW) {
       RGWAccessHandle h;
-
-      int r = store->getRados()->log_show_init(oid, &h);
-      if (r < 0) {
-	cerr << "error opening log " << oid << ": " << cpp_strerror(-r) << std::endl;
-	return -r;
+      // entries written to a local file by rgw_ops_log_file_path use the
+      // same encoding as the rados log objects
+      bufferlist file_bl;
+      bufferlist::const_iterator file_iter;
+      std::function<int(rgw_log_entry *)> log_show_next;
+
+      if (from_file) {
+        int r = read_input(infile, file_bl);
+        if (r < 0) {
+          return -r;
+        }
+        oid = infile;
+        file_iter = file_bl.cbegin();
+        log_show_next = [&](rgw_log_entry *entry) {
+          return rgw_log_entry_decode_next(file_iter, entry);
+        };
+      } else {
+        int r = store->getRados()->log_show_init(oid, &h);
+        if (r < 0) {
+	  cerr << "error opening log " << oid << ": " << cpp_strerror(-r) << std::endl;
+	  return -r;
+        }
+        log_show_next = [&](rgw_log_entry *entry) {
+          return store->getRados()->log_show_next(h, entry);
+        };
       }
 
       formatter->reset();
@@ -6213,7 +6235,7 @@ int main(int argc, const char **argv)
       struct rgw_log_entry entry;
 
       // peek at first entry to get bucket metadata
-      r = store->getRados()->log_show_next(h, &entry);
+      int r = log_show_next(&entry);
       if (r < 0) {
 	cerr << "error reading log " << oid << ": " << cpp_strerror(-r) << std::endl;
 	return -r;
@@ -6249,7 +6271,7 @@ int main(int argc, const char **argv)
 	  formatter->flush(cout);
         }
 next:
-	r = store->getRados()->log_show_next(h, &entry);
+	r = log_show_next(&entry);
       } while (r > 0);
 
       if (r < 0) {
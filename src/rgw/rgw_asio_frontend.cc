@@ -368,14 +368,17 @@ class AsioFrontend {
   {
     auto sched_t = dmc::get_scheduler_t(ctx());
     switch(sched_t){
-    case dmc::scheduler_t::dmclock:
+    case dmc::scheduler_t::dmclock: {
+      const auto ages = dmc::get_client_ages(ctx());
       scheduler.reset(new dmc::AsyncScheduler(ctx(),
                                               context,
                                               std::ref(sched_ctx.get_dmc_client_counters()),
                                               sched_ctx.get_dmc_client_config(),
                                               *sched_ctx.get_dmc_client_config(),
+                                              ages.idle, ages.erase, ages.check,
                                               dmc::AtLimit::Reject));
       break;
+    }
     case dmc::scheduler_t::none:
       lderr(ctx()) << "Got invalid scheduler type for beast, defaulting to throttler" << dendl;
       [[fallthrough]];
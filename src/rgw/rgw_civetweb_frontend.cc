@@ -34,12 +34,14 @@ RGWCivetWebFrontend::RGWCivetWebFrontend(RGWProcessEnv& env,
     // to make decisions on in the future. Also while reconfiguring we should
     // probably set this to false
     auto server_ready_f = []() -> bool { return true; };
+    const auto ages = dmc::get_client_ages(cct());
 
     scheduler.reset(new dmc::SyncScheduler(cct(),
 					   std::ref(sched_ctx.get_dmc_client_counters()),
 					   *sched_ctx.get_dmc_client_config(),
 					   server_ready_f,
 					   std::ref(dmc::SyncScheduler::handle_request_cb),
+					   ages.idle, ages.erase, ages.check,
 					   dmc::AtLimit::Reject));
   }
 
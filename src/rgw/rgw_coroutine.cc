@@ -100,6 +100,31 @@ bool RGWCompletionManager::try_get_next(io_completion *io)
   return true;
 }
 
+int RGWCompletionManager::get_all(list<io_completion>& ios)
+{
+  std::unique_lock l{lock};
+  while (complete_reqs.empty()) {
+    if (going_down) {
+      return -ECANCELED;
+    }
+    cond.wait(l);
+  }
+  for (auto& io : complete_reqs) {
+    complete_reqs_set.erase(io.io_id);
+  }
+  ios.splice(ios.end(), complete_reqs);
+  return 0;
+}
+
+void RGWCompletionManager::try_get_all(list<io_completion>& ios)
+{
+  std::lock_guard l{lock};
+  for (auto& io : complete_reqs) {
+    complete_reqs_set.erase(io.io_id);
+  }
+  ios.splice(ios.end(), complete_reqs);
+}
+
 void RGWCompletionManager::go_down()
 {
   std::lock_guard l{lock};
@@ -556,6 +581,15 @@ void RGWCoroutinesManager::handle_unblocked_stack(set<RGWCoroutinesStack *>& con
   }
 }
 
+void RGWCoroutinesManager::handle_unblocked_stacks(set<RGWCoroutinesStack *>& context_stacks, list<RGWCoroutinesStack *>& scheduled_stacks,
+                                                   list<RGWCompletionManager::io_completion>& ios, int *blocked_count)
+{
+  for (auto& io : ios) {
+    handle_unblocked_stack(context_stacks, scheduled_stacks, io, blocked_count);
+  }
+  ios.clear();
+}
+
 void RGWCoroutinesManager::schedule(RGWCoroutinesEnv *env, RGWCoroutinesStack *stack)
 {
   std::unique_lock wl{lock};
@@ -606,8 +640,11 @@ int RGWCoroutinesManager::run(list<RGWCoroutinesStack *>& stacks)
   env.manager = this;
   env.scheduled_stacks = &scheduled_stacks;
 
+  /* completions are collected in batches to limit lock round trips with the
+   * completion manager (and with the threads feeding it) */
+  list<RGWCompletionManager::io_completion> ios;
+
   for (list<RGWCoroutinesStack *>::iterator iter = scheduled_stacks.begin(); iter != scheduled_stacks.end() && !going_down;) {
-    RGWCompletionManager::io_completion io;
     RGWCoroutinesStack *stack = *iter;
     ++iter;
     scheduled_stacks.pop_front();
@@ -679,9 +716,8 @@ int RGWCoroutinesManager::run(list<RGWCoroutinesStack *>& stacks)
       stack->run_count = 0;
     }
 
-    while (completion_mgr->try_get_next(&io)) {
-      handle_unblocked_stack(context_stacks, scheduled_stacks, io, &blocked_count);
-    }
+    completion_mgr->try_get_all(ios);
+    handle_unblocked_stacks(context_stacks, scheduled_stacks, ios, &blocked_count);
 
     /*
      * only account blocked operations that are not in interval_wait, these are stacks that
@@ -690,21 +726,22 @@ int RGWCoroutinesManager::run(list<RGWCoroutinesStack *>& stacks)
      */
     while (blocked_count - interval_wait_count >= ops_window) {
       lock.unlock();
-      ret = completion_mgr->get_next(&io);
+      ret = completion_mgr->get_all(ios);
       lock.lock();
       if (ret < 0) {
-       ldout(cct, 5) << "completion_mgr.get_next() returned ret=" << ret << dendl;
+       ldout(cct, 5) << "completion_mgr.get_all() returned ret=" << ret << dendl;
+       break;
       }
-      handle_unblocked_stack(context_stacks, scheduled_stacks, io, &blocked_count);
+      handle_unblocked_stacks(context_stacks, scheduled_stacks, ios, &blocked_count);
     }
 
 next:
     while (scheduled_stacks.empty() && blocked_count > 0) {
       lock.unlock();
-      ret = completion_mgr->get_next(&io);
+      ret = completion_mgr->get_all(ios);
       lock.lock();
       if (ret < 0) {
-        ldout(cct, 5) << "completion_mgr.get_next() returned ret=" << ret << dendl;
+        ldout(cct, 5) << "completion_mgr.get_all() returned ret=" << ret << dendl;
       }
       if (going_down) {
 	ldout(cct, 5) << __func__ << "(): was stopped, exiting" << dendl;
@@ -712,7 +749,7 @@ next:
         canceled = true;
         break;
       }
-      handle_unblocked_stack(context_stacks, scheduled_stacks, io, &blocked_count);
+      handle_unblocked_stacks(context_stacks, scheduled_stacks, ios, &blocked_count);
       iter = scheduled_stacks.begin();
     }
     if (canceled) {
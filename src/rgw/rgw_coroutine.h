@@ -41,10 +41,12 @@ class RGWCompletionManager : public RefCountedObject {
 
   CephContext *cct;
 
+public:
   struct io_completion {
     rgw_io_id io_id;
     void *user_info;
   };
+private:
   list<io_completion> complete_reqs;
   set<rgw_io_id> complete_reqs_set;
   using NotifierRef = boost::intrusive_ptr<RGWAioCompletionNotifier>;
@@ -71,6 +73,10 @@ public:
   void complete(RGWAioCompletionNotifier *cn, const rgw_io_id& io_id, void *user_info);
   int get_next(io_completion *io);
   bool try_get_next(io_completion *io);
+  /* take all pending completions with a single lock acquisition; get_all()
+   * waits for at least one */
+  int get_all(list<io_completion>& ios);
+  void try_get_all(list<io_completion>& ios);
 
   void go_down();
 
@@ -583,6 +589,8 @@ class RGWCoroutinesManager {
 
   void handle_unblocked_stack(set<RGWCoroutinesStack *>& context_stacks, list<RGWCoroutinesStack *>& scheduled_stacks,
                               RGWCompletionManager::io_completion& io, int *waiting_count);
+  void handle_unblocked_stacks(set<RGWCoroutinesStack *>& context_stacks, list<RGWCoroutinesStack *>& scheduled_stacks,
+                               list<RGWCompletionManager::io_completion>& ios, int *waiting_count);
 protected:
   RGWCompletionManager *completion_mgr;
   RGWCoroutinesManagerRegistry *cr_registry;
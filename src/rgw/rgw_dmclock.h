@@ -16,6 +16,8 @@
 
 #ifndef RGW_DMCLOCK_H
 #define RGW_DMCLOCK_H
+#include <ostream>
+#include <string>
 #include "dmclock/src/dmclock_server.h"
 
 namespace rgw::dmclock {
@@ -28,6 +30,48 @@ enum class client_id {
                       count
 };
 
+/// the dmclock scheduling key of a request. requests with an empty key are
+/// scheduled by their op class alone, otherwise each distinct key gets its own
+/// dmclock client that is created on first use and erased once it goes idle
+struct client_key {
+  client_id id;
+  std::string key; //< tenant or bucket, depending on rgw_dmclock_client_key
+
+  client_key(client_id id) : id(id) {}
+  client_key(client_id id, std::string key) : id(id), key(std::move(key)) {}
+};
+
+inline bool operator==(const client_key& lhs, const client_key& rhs) {
+  return lhs.id == rhs.id && lhs.key == rhs.key;
+}
+inline bool operator!=(const client_key& lhs, const client_key& rhs) {
+  return !(lhs == rhs);
+}
+inline bool operator<(const client_key& lhs, const client_key& rhs) {
+  if (lhs.id != rhs.id) {
+    return lhs.id < rhs.id;
+  }
+  return lhs.key < rhs.key;
+}
+
+inline const char* to_string(client_id client) {
+  switch (client) {
+  case client_id::admin: return "admin";
+  case client_id::auth: return "auth";
+  case client_id::data: return "data";
+  case client_id::metadata: return "metadata";
+  default: return "scheduler";
+  }
+}
+
+inline std::ostream& operator<<(std::ostream& out, const client_key& client) {
+  out << to_string(client.id);
+  if (!client.key.empty()) {
+    out << '/' << client.key;
+  }
+  return out;
+}
+
 // TODO move these to dmclock/types or so in submodule
 using crimson::dmclock::Cost;
 using crimson::dmclock::ClientInfo;
@@ -49,6 +93,24 @@ inline scheduler_t get_scheduler_t(CephContext* const cct)
     return scheduler_t::none;
 }
 
+/// what data and metadata requests are keyed by for per-client scheduling
+enum class client_key_t {
+                         none, //< op class only
+                         tenant, //< bucket tenant
+                         bucket //< tenant/bucket
+};
+
+inline client_key_t get_client_key_t(CephContext* const cct)
+{
+  const auto key_type = cct->_conf.get_val<std::string>("rgw_dmclock_client_key");
+  if (key_type == "tenant")
+    return client_key_t::tenant;
+  else if (key_type == "bucket")
+    return client_key_t::bucket;
+  else
+    return client_key_t::none;
+}
+
 } // namespace rgw::dmclock
 
 #endif /* RGW_DMCLOCK_H */
@@ -38,7 +38,7 @@ void AsyncScheduler::handle_conf_change(const ConfigProxy& conf,
   schedule(crimson::dmclock::TimeZero);
 }
 
-int AsyncScheduler::schedule_request_impl(const client_id& client,
+int AsyncScheduler::schedule_request_impl(const client_key& client,
                                           const ReqParams& params,
                                           const Time& time, const Cost& cost,
                                           optional_yield yield_ctx)
@@ -70,7 +70,9 @@ void AsyncScheduler::cancel()
   ClientSums sums;
 
   queue.remove_by_req_filter([&] (RequestRef&& request) {
-      inc(sums, request->client, request->cost);
+      if (auto c = counters(request->client)) {
+        inc(sums, c, request->cost);
+      }
       auto c = static_cast<Completion*>(request.release());
       Completion::dispatch(std::unique_ptr<Completion>{c},
                            boost::asio::error::operation_aborted,
@@ -79,14 +81,12 @@ void AsyncScheduler::cancel()
     });
   timer.cancel();
 
-  for (size_t i = 0; i < client_count; i++) {
-    if (auto c = counters(static_cast<client_id>(i))) {
-      on_cancel(c, sums[i]);
-    }
+  for (const auto& [c, sum] : sums) {
+    on_cancel(c, sum);
   }
 }
 
-void AsyncScheduler::cancel(const client_id& client)
+void AsyncScheduler::cancel(const client_key& client)
 {
   ClientSum sum;
 
@@ -152,10 +152,10 @@ void AsyncScheduler::process(const Time& now)
     if (auto c = counters(client)) {
       auto lat = Clock::from_double(now) - Clock::from_double(started);
       if (phase == PhaseType::reservation) {
-        inc(rsums, client, cost);
+        inc(rsums, c, cost);
         c->tinc(queue_counters::l_res_latency, lat);
       } else {
-        inc(psums, client, cost);
+        inc(psums, c, cost);
         c->tinc(queue_counters::l_prio_latency, lat);
       }
     }
@@ -167,10 +167,11 @@ void AsyncScheduler::process(const Time& now)
     }
   }
 
-  for (size_t i = 0; i < client_count; i++) {
-    if (auto c = counters(static_cast<client_id>(i))) {
-      on_process(c, rsums[i], psums[i]);
-    }
+  for (const auto& [c, sum] : rsums) {
+    on_process(c, sum, {});
+  }
+  for (const auto& [c, sum] : psums) {
+    on_process(c, {}, sum);
   }
 }
 
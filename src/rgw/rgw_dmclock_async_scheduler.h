@@ -50,7 +50,7 @@ class AsyncScheduler : public md_config_obs_t, public Scheduler {
   /// is ready or canceled. on success, this grants a throttle unit that must
   /// be returned with a call to request_complete()
   template <typename CompletionToken>
-  auto async_request(const client_id& client, const ReqParams& params,
+  auto async_request(const client_key& client, const ReqParams& params,
                      const Time& time, Cost cost, CompletionToken&& token);
 
   /// returns a throttle unit granted by async_request()
@@ -62,19 +62,19 @@ class AsyncScheduler : public md_config_obs_t, public Scheduler {
 
   /// cancel all queued requests for a given client, invoking their completion
   /// handler with an operation_aborted error and default-constructed result
-  void cancel(const client_id& client);
+  void cancel(const client_key& client);
 
   const char** get_tracked_conf_keys() const override;
   void handle_conf_change(const ConfigProxy& conf,
                           const std::set<std::string>& changed) override;
 
  private:
-  int schedule_request_impl(const client_id& client, const ReqParams& params,
+  int schedule_request_impl(const client_key& client, const ReqParams& params,
                             const Time& time, const Cost& cost,
                             optional_yield yield_ctx) override;
 
   static constexpr bool IsDelayed = false;
-  using Queue = crimson::dmclock::PullPriorityQueue<client_id, Request, IsDelayed>;
+  using Queue = crimson::dmclock::PullPriorityQueue<client_key, Request, IsDelayed>;
   using RequestRef = typename Queue::RequestRef;
   Queue queue; //< dmclock priority queue
 
@@ -124,7 +124,7 @@ AsyncScheduler::AsyncScheduler(CephContext *cct, boost::asio::io_context& contex
 }
 
 template <typename CompletionToken>
-auto AsyncScheduler::async_request(const client_id& client,
+auto AsyncScheduler::async_request(const client_key& client,
                               const ReqParams& params,
                               const Time& time, Cost cost,
                               CompletionToken&& token)
@@ -194,7 +194,7 @@ public:
   }
 
 private:
-  int schedule_request_impl(const client_id&, const ReqParams&,
+  int schedule_request_impl(const client_key&, const ReqParams&,
                             const Time&, const Cost&,
                             optional_yield) override {
     if (outstanding_requests++ >= max_requests) {
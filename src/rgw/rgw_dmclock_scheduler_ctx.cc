@@ -13,16 +13,30 @@
  */
 #include "rgw_dmclock_scheduler_ctx.h"
 
+#include "common/dout.h"
+#include "common/strtol.h"
+#include "include/str_list.h"
+
+#define dout_subsys ceph_subsys_rgw
+
 namespace rgw::dmclock {
 
-ClientConfig::ClientConfig(CephContext *cct)
+ClientConfig::ClientConfig(CephContext *cct) : cct(cct)
 {
   update(cct->_conf);
 }
 
-ClientInfo* ClientConfig::operator()(client_id client)
+ClientInfo* ClientConfig::operator()(const client_key& client)
 {
-  return &clients[static_cast<size_t>(client)];
+  std::lock_guard lock{mutex};
+  if (client.key.empty()) {
+    return &clients[static_cast<size_t>(client.id)];
+  }
+  if (auto i = keyed_overrides.find(client.key);
+      i != keyed_overrides.end() && i->second.configured) {
+    return &i->second.info;
+  }
+  return &keyed_default;
 }
 
 const char** ClientConfig::get_tracked_conf_keys() const
@@ -40,6 +54,10 @@ const char** ClientConfig::get_tracked_conf_keys() const
     "rgw_dmclock_metadata_res",
     "rgw_dmclock_metadata_wgt",
     "rgw_dmclock_metadata_lim",
+    "rgw_dmclock_client_res",
+    "rgw_dmclock_client_wgt",
+    "rgw_dmclock_client_lim",
+    "rgw_dmclock_client_overrides",
     "rgw_max_concurrent_requests",
     nullptr
   };
@@ -48,23 +66,72 @@ const char** ClientConfig::get_tracked_conf_keys() const
 
 void ClientConfig::update(const ConfigProxy& conf)
 {
-  clients.clear();
+  std::lock_guard lock{mutex};
+  auto set_client = [&] (client_id id, const char* res, const char* wgt,
+                         const char* lim) {
+    ClientInfo info(conf.get_val<double>(res), conf.get_val<double>(wgt),
+                    conf.get_val<double>(lim));
+    const auto i = static_cast<size_t>(id);
+    if (i < clients.size()) {
+      clients[i] = info;
+    } else {
+      clients.push_back(info);
+    }
+  };
   static_assert(0 == static_cast<int>(client_id::admin));
-  clients.emplace_back(conf.get_val<double>("rgw_dmclock_admin_res"),
-                       conf.get_val<double>("rgw_dmclock_admin_wgt"),
-                       conf.get_val<double>("rgw_dmclock_admin_lim"));
+  set_client(client_id::admin, "rgw_dmclock_admin_res",
+             "rgw_dmclock_admin_wgt", "rgw_dmclock_admin_lim");
   static_assert(1 == static_cast<int>(client_id::auth));
-  clients.emplace_back(conf.get_val<double>("rgw_dmclock_auth_res"),
-                       conf.get_val<double>("rgw_dmclock_auth_wgt"),
-                       conf.get_val<double>("rgw_dmclock_auth_lim"));
+  set_client(client_id::auth, "rgw_dmclock_auth_res",
+             "rgw_dmclock_auth_wgt", "rgw_dmclock_auth_lim");
   static_assert(2 == static_cast<int>(client_id::data));
-  clients.emplace_back(conf.get_val<double>("rgw_dmclock_data_res"),
-                       conf.get_val<double>("rgw_dmclock_data_wgt"),
-                       conf.get_val<double>("rgw_dmclock_data_lim"));
+  set_client(client_id::data, "rgw_dmclock_data_res",
+             "rgw_dmclock_data_wgt", "rgw_dmclock_data_lim");
   static_assert(3 == static_cast<int>(client_id::metadata));
-  clients.emplace_back(conf.get_val<double>("rgw_dmclock_metadata_res"),
-                       conf.get_val<double>("rgw_dmclock_metadata_wgt"),
-                       conf.get_val<double>("rgw_dmclock_metadata_lim"));
+  set_client(client_id::metadata, "rgw_dmclock_metadata_res",
+             "rgw_dmclock_metadata_wgt", "rgw_dmclock_metadata_lim");
+
+  keyed_default = ClientInfo(conf.get_val<double>("rgw_dmclock_client_res"),
+                             conf.get_val<double>("rgw_dmclock_client_wgt"),
+                             conf.get_val<double>("rgw_dmclock_client_lim"));
+
+  // entries are of the form <key>=<res>,<wgt>,<lim>
+  for (auto& [key, o] : keyed_overrides) {
+    o.configured = false;
+  }
+  std::list<std::string> entries;
+  get_str_list(conf.get_val<std::string>("rgw_dmclock_client_overrides"),
+               " ;\t", entries);
+  for (const auto& entry : entries) {
+    const auto eq = entry.rfind('=');
+    std::list<std::string> values;
+    if (eq != std::string::npos) {
+      get_str_list(entry.substr(eq + 1), ",", values);
+    }
+    if (eq == 0 || eq == std::string::npos || values.size() != 3) {
+      lderr(cct) << "ERROR: ignoring malformed rgw_dmclock_client_overrides "
+          "entry '" << entry << "'" << dendl;
+      continue;
+    }
+    std::string err;
+    double v[3];
+    auto value = values.begin();
+    for (int i = 0; i < 3 && err.empty(); i++, ++value) {
+      v[i] = strict_strtod(value->c_str(), &err);
+    }
+    if (!err.empty() || v[0] < 0 || v[1] <= 0 || v[2] < 0) {
+      lderr(cct) << "ERROR: ignoring invalid rgw_dmclock_client_overrides "
+          "entry '" << entry << "'" << dendl;
+      continue;
+    }
+    ClientInfo info(v[0], v[1], v[2]);
+    auto key = entry.substr(0, eq);
+    if (auto i = keyed_overrides.find(key); i != keyed_overrides.end()) {
+      i->second = KeyedOverride{info, true};
+    } else {
+      keyed_overrides.emplace(std::move(key), KeyedOverride{info, true});
+    }
+  }
 }
 
 void ClientConfig::handle_conf_change(const ConfigProxy& conf,
@@ -73,7 +140,7 @@ void ClientConfig::handle_conf_change(const ConfigProxy& conf,
   update(conf);
 }
 
-ClientCounters::ClientCounters(CephContext *cct)
+ClientCounters::ClientCounters(CephContext *cct) : cct(cct)
 {
   clients[static_cast<size_t>(client_id::admin)] =
       queue_counters::build(cct, "dmclock-admin");
@@ -87,9 +154,66 @@ ClientCounters::ClientCounters(CephContext *cct)
       throttle_counters::build(cct, "dmclock-scheduler");
 }
 
-void inc(ClientSums& sums, client_id client, Cost cost)
+PerfCounters* ClientCounters::get_keyed(const client_key& client) const
+{
+  if (!clients[static_cast<size_t>(client.id)]) {
+    return nullptr; // throttler_perf_counter is disabled
+  }
+  const auto now = ceph::coarse_mono_clock::now();
+  std::lock_guard lock{keyed_mutex};
+  if (now >= next_trim) {
+    trim_keyed(now);
+  }
+  auto i = keyed.find(client);
+  if (i == keyed.end()) {
+    auto name = std::string("dmclock-") + to_string(client.id) + "-" + client.key;
+    i = keyed.emplace(client,
+                      KeyedCounters{queue_counters::build(cct, name), now}).first;
+  } else {
+    i->second.last_used = now;
+  }
+  return i->second.counters.get();
+}
+
+void ClientCounters::trim_keyed(ceph::coarse_mono_time now) const
+{
+  const auto erase_age = std::chrono::seconds(
+      cct->_conf.get_val<uint64_t>("rgw_dmclock_client_erase_age"));
+  next_trim = now + erase_age / 2;
+
+  for (auto i = keyed.begin(); i != keyed.end();) {
+    auto& c = i->second;
+    // keep the counters of clients with queued requests, whatever their age
+    if (now - c.last_used > erase_age &&
+        c.counters->get(queue_counters::l_qlen) == 0) {
+      i = keyed.erase(i);
+    } else {
+      ++i;
+    }
+  }
+}
+
+size_t ClientCounters::keyed_count() const
+{
+  std::lock_guard lock{keyed_mutex};
+  return keyed.size();
+}
+
+ClientAges get_client_ages(CephContext *cct)
+{
+  ClientAges ages;
+  ages.idle = std::chrono::seconds(
+      cct->_conf.get_val<uint64_t>("rgw_dmclock_client_idle_age"));
+  // the queue requires erase_age >= idle_age > check_time
+  ages.erase = std::max(ages.idle, std::chrono::seconds(
+      cct->_conf.get_val<uint64_t>("rgw_dmclock_client_erase_age")));
+  ages.check = ages.idle / 2;
+  return ages;
+}
+
+void inc(ClientSums& sums, PerfCounters* c, Cost cost)
 {
-  auto& sum = sums[static_cast<size_t>(client)];
+  auto& sum = sums[c];
   sum.count++;
   sum.cost += cost;
 }
@@ -4,8 +4,12 @@
 #ifndef RGW_DMCLOCK_SCHEDULER_CTX_H
 #define RGW_DMCLOCK_SCHEDULER_CTX_H
 
+#include <map>
+#include <mutex>
+#include <boost/container/flat_map.hpp>
 #include "common/perf_counters.h"
 #include "common/ceph_context.h"
+#include "common/ceph_time.h"
 #include "common/config.h"
 #include "rgw_dmclock.h"
 
@@ -46,15 +50,35 @@ namespace rgw::dmclock {
 
 // the last client counter would be for global scheduler stats
 static constexpr auto counter_size = static_cast<size_t>(client_id::count) + 1;
-/// array of per-client counters to serve as GetClientCounters
+/// array of per-client counters to serve as GetClientCounters. counters for
+/// keyed clients are created on first use and dropped once they have been
+/// idle for rgw_dmclock_client_erase_age
 class ClientCounters {
+  CephContext *const cct;
   std::array<PerfCountersRef, counter_size> clients;
+
+  struct KeyedCounters {
+    PerfCountersRef counters;
+    ceph::coarse_mono_time last_used;
+  };
+  mutable std::mutex keyed_mutex;
+  mutable std::map<client_key, KeyedCounters> keyed;
+  mutable ceph::coarse_mono_time next_trim;
+
+  PerfCounters* get_keyed(const client_key& client) const;
+  void trim_keyed(ceph::coarse_mono_time now) const;
  public:
   ClientCounters(CephContext *cct);
 
-  PerfCounters* operator()(client_id client) const {
-    return clients[static_cast<size_t>(client)].get();
+  PerfCounters* operator()(const client_key& client) const {
+    if (client.key.empty()) {
+      return clients[static_cast<size_t>(client.id)].get();
+    }
+    return get_keyed(client);
   }
+
+  /// number of keyed clients that currently have counters
+  size_t keyed_count() const;
 };
 
 class ThrottleCounters {
@@ -74,29 +98,55 @@ struct ClientSum {
   Cost cost{0};
 };
 
-constexpr auto client_count = static_cast<size_t>(client_id::count);
-using ClientSums = std::array<ClientSum, client_count>;
+/// sums are accumulated per counter so that keyed clients are batched the
+/// same way as op classes
+using ClientSums = boost::container::flat_map<PerfCounters*, ClientSum>;
 
-void inc(ClientSums& sums, client_id client, Cost cost);
+void inc(ClientSums& sums, PerfCounters* c, Cost cost);
 void on_cancel(PerfCounters *c, const ClientSum& sum);
 void on_process(PerfCounters* c, const ClientSum& rsum, const ClientSum& psum);
 
 
+/// the ClientInfo pointers handed out by operator() are held by the dmclock
+/// queue until it calls update_client_infos(), so config changes update the
+/// existing entries in place and never free them
 class ClientConfig : public md_config_obs_t {
+  CephContext *const cct;
+  std::mutex mutex;
   std::vector<ClientInfo> clients;
+  /// defaults for keyed clients, from rgw_dmclock_client_{res,wgt,lim}
+  ClientInfo keyed_default{0, 1, 0};
+  struct KeyedOverride {
+    ClientInfo info;
+    /// false once the key is dropped from the config, so it falls back to
+    /// keyed_default
+    bool configured;
+  };
+  /// per-key settings from rgw_dmclock_client_overrides
+  std::map<std::string, KeyedOverride, std::less<>> keyed_overrides;
 
   void update(const ConfigProxy &conf);
 
 public:
   ClientConfig(CephContext *cct);
 
-  ClientInfo* operator()(client_id client);
+  ClientInfo* operator()(const client_key& client);
 
   const char** get_tracked_conf_keys() const override;
   void handle_conf_change(const ConfigProxy& conf,
                           const std::set<std::string>& changed) override;
 };
 
+/// how long a dmclock client may go without requests before it's marked idle
+/// and then erased from the queue, and how often the queue checks for them
+struct ClientAges {
+  std::chrono::seconds idle;
+  std::chrono::seconds erase;
+  std::chrono::seconds check;
+};
+
+ClientAges get_client_ages(CephContext *cct);
+
 class SchedulerCtx {
 public:
   SchedulerCtx(CephContext* const cct) : sched_t(get_scheduler_t(cct))
@@ -104,7 +154,7 @@ public:
     if(sched_t == scheduler_t::dmclock) {
       dmc_client_config = std::make_shared<ClientConfig>(cct);
       // we don't have a move only cref std::function yet
-      dmc_client_counters = std::make_optional<ClientCounters>(cct);
+      dmc_client_counters.emplace(cct);
     }
   }
   // We need to construct a std::function from a NonCopyable object
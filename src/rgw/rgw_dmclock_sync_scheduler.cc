@@ -12,7 +12,7 @@ SyncScheduler::~SyncScheduler()
   cancel();
 }
 
-int SyncScheduler::add_request(const client_id& client, const ReqParams& params,
+int SyncScheduler::add_request(const client_key& client, const ReqParams& params,
                                const Time& time, Cost cost)
 {
   std::mutex req_mtx;
@@ -45,7 +45,7 @@ int SyncScheduler::add_request(const client_id& client, const ReqParams& params,
   return r;
 }
 
-void SyncScheduler::handle_request_cb(const client_id &c,
+void SyncScheduler::handle_request_cb(const client_key &c,
                                       std::unique_ptr<SyncRequest> req,
                                       PhaseType phase, Cost cost)
 {
@@ -71,7 +71,7 @@ void SyncScheduler::handle_request_cb(const client_id &c,
 }
 
 
-void SyncScheduler::cancel(const client_id& client)
+void SyncScheduler::cancel(const client_key& client)
 {
   ClientSum sum;
 
@@ -98,7 +98,9 @@ void SyncScheduler::cancel()
 
   queue.remove_by_req_filter([&](RequestRef&& request) -> bool
            {
-             inc(sums, request->client, request->cost);
+             if (auto c = counters(request->client)) {
+               inc(sums, c, request->cost);
+             }
              {
                std::lock_guard<std::mutex> lg(request->req_mtx);
                request->req_state = ReqState::Cancelled;
@@ -107,10 +109,8 @@ void SyncScheduler::cancel()
              return true;
            });
 
-  for (size_t i = 0; i < client_count; i++) {
-    if (auto c = counters(static_cast<client_id>(i))) {
-      on_cancel(c, sums[i]);
-    }
+  for (const auto& [c, sum] : sums) {
+    on_cancel(c, sum);
   }
 }
 
@@ -14,9 +14,13 @@
 #include "cls/lock/cls_lock_client.h"
 #include "include/random.h"
 #include "rgw_gc_log.h"
+#include "common/ceph_json.h"
+#include "include/intarith.h"
+#include "include/rados.h"
 
 #include <list> // XXX
 #include <sstream>
+#include <tuple>
 #include "xxhash.h"
 
 #define dout_context g_ceph_context
@@ -27,6 +31,51 @@ using namespace librados;
 static string gc_oid_prefix = "gc";
 static string gc_index_lock_name = "gc_process";
 
+uint32_t rgw_gc_object_pg(uint32_t hash_position, uint32_t pg_num)
+{
+  if (pg_num == 0) {
+    return hash_position;
+  }
+  // same as pg_pool_t::raw_pg_to_pg()
+  const int pg_num_mask = (1 << cbits(pg_num - 1)) - 1;
+  return ceph_stable_mod(hash_position, pg_num, pg_num_mask);
+}
+
+void rgw_gc_sort_tail_removes(std::vector<RGWGCTailRemove>& removes)
+{
+  std::stable_sort(removes.begin(), removes.end(),
+                   [](const RGWGCTailRemove& l, const RGWGCTailRemove& r) {
+                     return std::tie(l.pool, l.pg) < std::tie(r.pool, r.pg);
+                   });
+}
+
+/* pg_num of a pool, to map object hashes to placement groups; 0 if the
+ * monitors can't tell
+ */
+static uint32_t get_pool_pg_num(const DoutPrefixProvider *dpp,
+                                librados::Rados *rados,
+                                const string& pool)
+{
+  bufferlist inbl, outbl;
+  int r = rados->mon_command(
+    "{\"prefix\": \"osd pool get\", \"pool\": \"" + pool +
+    "\", \"var\": \"pg_num\", \"format\": \"json\"}",
+    inbl, &outbl, nullptr);
+  uint32_t pg_num = 0;
+  JSONParser parser;
+  if (r < 0 || !parser.parse(outbl.c_str(), outbl.length())) {
+    ldpp_dout(dpp, 10) << "RGWGC::process failed to get pg_num of pool=" <<
+      pool << ", r=" << r << dendl;
+    return 0;
+  }
+  try {
+    JSONDecoder::decode_json("pg_num", pg_num, &parser, true);
+  } catch (JSONDecoder::err& e) {
+    return 0;
+  }
+  return pg_num;
+}
+
 void RGWGC::initialize(CephContext *_cct, RGWRados *_store) {
   cct = _cct;
   store = _store;
@@ -34,6 +83,7 @@ void RGWGC::initialize(CephContext *_cct, RGWRados *_store) {
   max_objs = min(static_cast<int>(cct->_conf->rgw_gc_max_objs), rgw_shards_max());
 
   obj_names = new string[max_objs];
+  transitioned_objects_cache = std::vector<std::atomic<bool>>(max_objs);
 
   for (int i = 0; i < max_objs; i++) {
     obj_names[i] = gc_oid_prefix;
@@ -41,9 +91,6 @@ void RGWGC::initialize(CephContext *_cct, RGWRados *_store) {
     snprintf(buf, 32, ".%d", i);
     obj_names[i].append(buf);
 
-    auto it = transitioned_objects_cache.begin() + i;
-    transitioned_objects_cache.insert(it, false);
-
     //version = 0 -> not ready for transition
     //version = 1 -> marked ready for transition
     librados::ObjectWriteOperation op;
@@ -374,6 +421,8 @@ public:
       goto done;
     }
 
+    gc->note_removed(1);
+
     if (! gc->transitioned_objects_cache[io.index]) {
       schedule_tag_removal(io.index, io.tag);
     }
@@ -465,6 +514,7 @@ public:
       /* log the count of tags retired for rate estimation */
       perfcounter->inc(l_rgw_gc_retire, rt.size());
     }
+    gc->note_retired(rt.size());
     ios.push_back(index_io);
   }
 
@@ -489,6 +539,7 @@ public:
       /* log the count of tags retired for rate estimation */
       perfcounter->inc(l_rgw_gc_retire, num_entries);
     }
+    gc->note_retired(num_entries);
     return 0;
   }
 }; // class RGWGCIOManger
@@ -526,7 +577,12 @@ int RGWGC::process(int index, int max_secs, bool expired_only,
   string marker;
   string next_marker;
   bool truncated;
-  IoCtx *ctx = new IoCtx;
+  /* one ioctx per data pool touched while working on this shard */
+  struct Pool {
+    IoCtx ctx;
+    uint32_t pg_num;
+  };
+  std::map<string, Pool> pools;
   do {
     int max = 100;
     std::list<cls_rgw_gc_obj_info> entries;
@@ -576,75 +632,87 @@ int RGWGC::process(int index, int max_secs, bool expired_only,
 
     marker = next_marker;
 
-    string last_pool;
-    std::list<cls_rgw_gc_obj_info>::iterator iter;
-    for (iter = entries.begin(); iter != entries.end(); ++iter) {
-      cls_rgw_gc_obj_info& info = *iter;
-
-      ldpp_dout(this, 20) << "RGWGC::process iterating over entry tag='" <<
-	info.tag << "', time=" << info.time << ", chain.objs.size()=" <<
-	info.chain.objs.size() << dendl;
+    {
+      /* tail objects of the whole batch, issued in (pool, pg) order so that
+       * consecutive removes land on the same placement group and osd
+       */
+      std::vector<RGWGCTailRemove> removes;
 
-      std::list<cls_rgw_obj>::iterator liter;
-      cls_rgw_obj_chain& chain = info.chain;
+      for (auto& info : entries) {
+        ldpp_dout(this, 20) << "RGWGC::process iterating over entry tag='" <<
+          info.tag << "', time=" << info.time << ", chain.objs.size()=" <<
+          info.chain.objs.size() << dendl;
 
-      utime_t now = ceph_clock_now();
-      if (now >= end) {
-        goto done;
-      }
-      if (! transitioned_objects_cache[index]) {
-        if (chain.objs.empty()) {
-          io_manager.schedule_tag_removal(index, info.tag);
-        } else {
-          io_manager.add_tag_io_size(index, info.tag, chain.objs.size());
+        utime_t now = ceph_clock_now();
+        if (now >= end) {
+          goto done;
+        }
+        if (! transitioned_objects_cache[index]) {
+          if (info.chain.objs.empty()) {
+            io_manager.schedule_tag_removal(index, info.tag);
+          } else {
+            io_manager.add_tag_io_size(index, info.tag, info.chain.objs.size());
+          }
+        }
+        for (auto& obj : info.chain.objs) {
+          auto pool_iter = pools.find(obj.pool);
+          if (pool_iter == pools.end()) {
+            IoCtx ctx;
+            ret = rgw_init_ioctx(store->get_rados_handle(), obj.pool, ctx);
+            if (ret < 0) {
+              if (transitioned_objects_cache[index]) {
+                goto done;
+              }
+              ldpp_dout(this, 0) << "ERROR: failed to create ioctx pool=" <<
+                obj.pool << dendl;
+              continue;
+            }
+            uint32_t pg_num = get_pool_pg_num(this, store->get_rados_handle(),
+                                               ctx.get_pool_name());
+            pool_iter = pools.emplace(
+              obj.pool, Pool{std::move(ctx), pg_num}).first;
+          }
+          auto& pool = pool_iter->second;
+          pool.ctx.locator_set_key(obj.loc);
+          /* objects with a locator are placed by it rather than by oid */
+          uint32_t hash_pos = 0;
+          pool.ctx.get_object_pg_hash_position2(
+            obj.loc.empty() ? obj.key.name : obj.loc, &hash_pos);
+          removes.push_back(RGWGCTailRemove{
+            pool.ctx.get_id(), rgw_gc_object_pg(hash_pos, pool.pg_num),
+            &pool.ctx, &obj, &info.tag});
         }
       }
-      if (! chain.objs.empty()) {
-	for (liter = chain.objs.begin(); liter != chain.objs.end(); ++liter) {
-	  cls_rgw_obj& obj = *liter;
-
-	  if (obj.pool != last_pool) {
-	    delete ctx;
-	    ctx = new IoCtx;
-	    ret = rgw_init_ioctx(store->get_rados_handle(), obj.pool, *ctx);
-	    if (ret < 0) {
-        if (transitioned_objects_cache[index]) {
+
+      rgw_gc_sort_tail_removes(removes);
+
+      for (auto& r : removes) {
+        const cls_rgw_obj& obj = *r.obj;
+        const string& oid = obj.key.name; /* just stored raw oid there */
+
+        r.ctx->locator_set_key(obj.loc);
+
+        ldpp_dout(this, 5) << "RGWGC::process removing " << obj.pool <<
+          ":" << obj.key.name << dendl;
+        ObjectWriteOperation op;
+        cls_refcount_put(op, *r.tag, true);
+
+        ret = io_manager.schedule_io(r.ctx, oid, &op, index, *r.tag);
+        if (ret < 0) {
+          ldpp_dout(this, 0) <<
+            "WARNING: failed to schedule deletion for oid=" << oid << dendl;
+          if (transitioned_objects_cache[index]) {
+            //If deleting oid failed for any of them, we will not delete queue entries
+            goto done;
+          }
+        }
+        if (going_down()) {
+          // leave early, even if tag isn't removed, it's ok since it
+          // will be picked up next time around
           goto done;
         }
-	      last_pool = "";
-	      ldpp_dout(this, 0) << "ERROR: failed to create ioctx pool=" <<
-		obj.pool << dendl;
-	      continue;
-	    }
-	    last_pool = obj.pool;
-	  }
-
-	  ctx->locator_set_key(obj.loc);
-
-	  const string& oid = obj.key.name; /* just stored raw oid there */
-
-	  ldpp_dout(this, 5) << "RGWGC::process removing " << obj.pool <<
-	    ":" << obj.key.name << dendl;
-	  ObjectWriteOperation op;
-	  cls_refcount_put(op, info.tag, true);
-
-	  ret = io_manager.schedule_io(ctx, oid, &op, index, info.tag);
-	  if (ret < 0) {
-	    ldpp_dout(this, 0) <<
-	      "WARNING: failed to schedule deletion for oid=" << oid << dendl;
-      if (transitioned_objects_cache[index]) {
-        //If deleting oid failed for any of them, we will not delete queue entries
-        goto done;
-      }
-	  }
-	  if (going_down()) {
-	    // leave early, even if tag isn't removed, it's ok since it
-	    // will be picked up next time around
-	    goto done;
-	  }
-	} // chains loop
-      } // else -- chains not empty
-    } // entries loop
+      } // removes loop
+    }
     if (transitioned_objects_cache[index] && entries.size() > 0) {
       ret = io_manager.drain_ios();
       if (ret < 0) {
@@ -666,7 +734,6 @@ done:
    * hold the system if backend is unresponsive
    */
   l.unlock(&store->gc_pool_ctx, obj_names[index]);
-  delete ctx;
 
   return 0;
 }
@@ -676,19 +743,150 @@ int RGWGC::process(bool expired_only)
   int max_secs = cct->_conf->rgw_gc_processor_max_time;
 
   const int start = ceph::util::generate_random_number(0, max_objs - 1);
+  const int num_workers = std::min<int>(
+    cct->_conf.get_val<int64_t>("rgw_gc_max_concurrent_shards"), max_objs);
 
-  RGWGCIOManager io_manager(this, store->ctx(), this);
+  const utime_t cycle_start = ceph_clock_now();
+  const uint64_t retired_before = retired_entries;
+  const uint64_t removed_before = removed_objs;
 
-  for (int i = 0; i < max_objs; i++) {
-    int index = (i + start) % max_objs;
-    int ret = process(index, max_secs, expired_only, io_manager);
-    if (ret < 0)
+  /* shard workers pull the next shard index off a shared cursor; each has
+   * its own io manager, so tag and queue trimming stay per shard
+   */
+  std::atomic<int> next = { 0 };
+  std::atomic<int> result = { 0 };
+  auto work = [&] {
+    RGWGCIOManager io_manager(this, store->ctx(), this);
+    for (int i = next++; i < max_objs && result == 0; i = next++) {
+      int index = (i + start) % max_objs;
+      int ret = process(index, max_secs, expired_only, io_manager);
+      if (ret < 0) {
+        result = ret;
+        break;
+      }
+      if (going_down()) {
+        break;
+      }
+    }
+    if (!going_down()) {
+      io_manager.drain();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 1; i < num_workers; i++) {
+    workers.push_back(make_named_thread("rgw_gc_shard", work));
+  }
+  work();
+  for (auto& t : workers) {
+    t.join();
+  }
+
+  const double secs = (double)(ceph_clock_now() - cycle_start);
+  {
+    std::lock_guard l{stats_lock};
+    stats.cycles++;
+    stats.last_start = cycle_start;
+    stats.last_secs = secs;
+    stats.last_retired = retired_entries - retired_before;
+    stats.last_removed = removed_objs - removed_before;
+    if (secs > 0) {
+      const double rate = stats.last_retired / secs;
+      stats.retire_rate = (stats.cycles == 1 ? rate :
+                           0.5 * stats.retire_rate + 0.5 * rate);
+    }
+  }
+
+  return result;
+}
+
+int RGWGC::count_pending(int index, uint64_t max, uint64_t *count, bool *truncated)
+{
+  string marker, next_marker;
+  *count = 0;
+  *truncated = false;
+  do {
+    std::list<cls_rgw_gc_obj_info> entries;
+    const uint32_t chunk = std::min<uint64_t>(1000, max - *count);
+    int ret;
+    if (transitioned_objects_cache[index]) {
+      ret = cls_rgw_gc_queue_list_entries(store->gc_pool_ctx, obj_names[index], marker,
+                                          chunk, true, entries, truncated, next_marker);
+    } else {
+      ret = cls_rgw_gc_list(store->gc_pool_ctx, obj_names[index], marker,
+                            chunk, true, entries, truncated, next_marker);
+    }
+    if (ret == -ENOENT) {
+      return 0;
+    }
+    if (ret < 0) {
       return ret;
+    }
+    *count += entries.size();
+    marker = next_marker;
+  } while (*truncated && *count < max);
+  return 0;
+}
+
+void RGWGC::dump_status(Formatter *f, uint64_t max_per_shard)
+{
+  CycleStats s;
+  {
+    std::lock_guard l{stats_lock};
+    s = stats;
   }
-  if (!going_down()) {
-    io_manager.drain();
+
+  uint64_t backlog = 0;
+  bool backlog_truncated = false;
+  f->open_array_section("shards");
+  for (int i = 0; i < max_objs; i++) {
+    uint64_t count = 0;
+    bool truncated = false;
+    int r = count_pending(i, max_per_shard, &count, &truncated);
+    f->open_object_section("shard");
+    encode_json("index", i, f);
+    encode_json("oid", obj_names[i], f);
+    if (r < 0) {
+      encode_json("error", r, f);
+    } else {
+      encode_json("expired_entries", count, f);
+      encode_json("truncated", truncated, f);
+      backlog += count;
+      backlog_truncated |= truncated;
+    }
+    f->close_section();
+  }
+  f->close_section();
+
+  encode_json("retired_entries", retired_entries.load(), f);
+  encode_json("removed_objects", removed_objs.load(), f);
+  encode_json("cycles", s.cycles, f);
+  encode_json("last_cycle_start", s.last_start, f);
+  encode_json("last_cycle_secs", s.last_secs, f);
+  encode_json("last_cycle_retired", s.last_retired, f);
+  encode_json("last_cycle_removed", s.last_removed, f);
+  encode_json("retire_rate", s.retire_rate, f);
+  encode_json("backlog", backlog, f);
+  encode_json("backlog_truncated", backlog_truncated, f);
+  if (s.retire_rate > 0) {
+    /* time spent working; the idle part of rgw_gc_processor_period is not
+     * accounted for */
+    encode_json("backlog_eta_secs", (uint64_t)(backlog / s.retire_rate), f);
   }
+}
 
+int RGWGC::StatusHook::call(std::string_view command, const cmdmap_t& cmdmap,
+                            Formatter *f, std::ostream& ss, bufferlist& out)
+{
+  int64_t max = 100000;
+  cmd_getval(cmdmap, "max_entries", max);
+  if (max <= 0) {
+    ss << "max_entries must be positive";
+    return -EINVAL;
+  }
+  f->open_object_section("gc_status");
+  gc->dump_status(f, max);
+  f->close_section();
   return 0;
 }
 
@@ -701,10 +899,23 @@ void RGWGC::start_processor()
 {
   worker = new GCWorker(this, cct, this);
   worker->create("rgw_gc");
+
+  int r = cct->get_admin_socket()->register_command(
+    "gc status name=max_entries,type=CephInt,req=false", &status_hook,
+    "show garbage collection throughput and backlog of expired entries");
+  if (r < 0) {
+    ldpp_dout(this, 0) << "ERROR: fail to register admin socket command (r=" << r << ")" << dendl;
+  } else {
+    status_hook_registered = true;
+  }
 }
 
 void RGWGC::stop_processor()
 {
+  if (status_hook_registered) {
+    cct->get_admin_socket()->unregister_commands(&status_hook);
+    status_hook_registered = false;
+  }
   down_flag = true;
   if (worker) {
     worker->stop();
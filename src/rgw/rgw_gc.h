@@ -10,6 +10,7 @@
 #include "common/ceph_mutex.h"
 #include "common/Cond.h"
 #include "common/Thread.h"
+#include "common/admin_socket.h"
 #include "rgw_common.h"
 #include "rgw_sal.h"
 #include "rgw_rados.h"
@@ -19,6 +20,23 @@
 
 class RGWGCIOManager;
 
+/* a tail object remove of a gc batch; the removes of a batch are issued
+ * in (pool, pg) order, so that consecutive ones land on the same
+ * placement group and osd
+ */
+struct RGWGCTailRemove {
+  int64_t pool;      // pool id
+  uint32_t pg;       // placement group in the pool
+  librados::IoCtx *ctx;
+  const cls_rgw_obj *obj;
+  const string *tag;
+};
+
+/// the placement group of an object, given its hash position in a pool
+/// of pg_num placement groups
+uint32_t rgw_gc_object_pg(uint32_t hash_position, uint32_t pg_num);
+void rgw_gc_sort_tail_removes(std::vector<RGWGCTailRemove>& removes);
+
 class RGWGC : public DoutPrefixProvider {
   CephContext *cct;
   RGWRados *store;
@@ -30,6 +48,36 @@ class RGWGC : public DoutPrefixProvider {
 
   int tag_index(const string& tag);
 
+  /* cumulative collection progress, fed by the io managers of all shard
+   * workers and sampled at the end of each cycle for 'gc status'
+   */
+  std::atomic<uint64_t> retired_entries = { 0 };
+  std::atomic<uint64_t> removed_objs = { 0 };
+
+  struct CycleStats {
+    uint64_t cycles{0};
+    utime_t last_start;
+    double last_secs{0};
+    uint64_t last_retired{0};
+    uint64_t last_removed{0};
+    double retire_rate{0}; // entries/sec, averaged over recent cycles
+  };
+  ceph::mutex stats_lock = ceph::make_mutex("RGWGC::stats_lock");
+  CycleStats stats;
+
+  class StatusHook : public AdminSocketHook {
+    RGWGC *gc;
+  public:
+    explicit StatusHook(RGWGC *_gc) : gc(_gc) {}
+    int call(std::string_view command, const cmdmap_t& cmdmap,
+	     Formatter *f, std::ostream& ss, bufferlist& out) override;
+  };
+  StatusHook status_hook{this};
+  bool status_hook_registered{false};
+
+  int count_pending(int index, uint64_t max, uint64_t *count, bool *truncated);
+  void dump_status(Formatter *f, uint64_t max_per_shard);
+
   class GCWorker : public Thread {
     const DoutPrefixProvider *dpp;
     CephContext *cct;
@@ -50,7 +98,9 @@ public:
     stop_processor();
     finalize();
   }
-  vector<bool> transitioned_objects_cache;
+  /* atomic rather than vector<bool>: shards are processed by concurrent
+   * workers and packed bits would share memory locations */
+  std::vector<std::atomic<bool>> transitioned_objects_cache;
   int send_chain(cls_rgw_obj_chain& chain, const string& tag);
 
   // asynchronously defer garbage collection on an object that's still being read
@@ -71,6 +121,9 @@ public:
               RGWGCIOManager& io_manager);
   int process(bool expired_only);
 
+  void note_retired(uint64_t num) { retired_entries += num; }
+  void note_removed(uint64_t num) { removed_objs += num; }
+
   bool going_down();
   void start_processor();
   void stop_processor();
@@ -24,6 +24,7 @@
 #include "rgw_common.h"
 #include "rgw_bucket.h"
 #include "rgw_lc.h"
+#include "rgw_lc_checkpoint.h"
 #include "rgw_zone.h"
 #include "rgw_string.h"
 #include "rgw_multi.h"
@@ -435,9 +436,13 @@ class LCObjsLister {
   int64_t delay_ms;
 
 public:
-  LCObjsLister(rgw::sal::RGWRadosStore *_store, RGWBucketInfo& _bucket_info) :
+  LCObjsLister(rgw::sal::RGWRadosStore *_store, RGWBucketInfo& _bucket_info,
+	       int shard_id = RGW_NO_SHARD) :
       store(_store), bucket_info(_bucket_info),
       target(store->getRados(), bucket_info), list_op(&target) {
+    /* with a shard id, the unordered listing is confined to that index
+     * shard; all versions of a key hash to the same shard */
+    target.set_shard_id(shard_id);
     list_op.params.list_versions = bucket_info.versioned();
     list_op.params.allow_unordered = true;
     delay_ms = store->ctx()->_conf.get_val<int64_t>("rgw_lc_thread_delay");
@@ -448,6 +453,10 @@ public:
     list_op.params.prefix = prefix;
   }
 
+  void set_marker(const rgw_obj_key& marker) {
+    list_op.params.marker = marker;
+  }
+
   int init() {
     return fetch();
   }
@@ -662,13 +671,30 @@ public:
 	      WorkQ* wq);
 }; /* LCOpRule */
 
+/* one lifecycle rule applied to one bucket index shard; listed and
+ * processed inline by a single workpool thread */
+struct LCShardTask {
+  rgw::sal::RGWRadosStore *store;
+  RGWBucketInfo *bucket_info;
+  lc_op *op;
+  std::string prefix;
+  int shard_id;
+  std::string ckpt_key;
+  LCShardCheckpoints *ckpts;
+  rgw_obj_key start_marker;
+  time_t stop_at;
+  bool once;
+};
+
 using WorkItem =
   boost::variant<void*,
 		 /* out-of-line delete */
 		 std::tuple<LCOpRule, rgw_bucket_dir_entry>,
 		 /* uncompleted MPU expiration */
 		 std::tuple<lc_op, rgw_bucket_dir_entry>,
-		 rgw_bucket_dir_entry>;
+		 rgw_bucket_dir_entry,
+		 /* per index shard listing */
+		 LCShardTask>;
 
 class WorkQ : public Thread
 {
@@ -1386,6 +1412,10 @@ int LCOpRule::process(rgw_bucket_dir_entry& o,
   shared_ptr<LCOpAction> *selected = nullptr; // n.b., req'd by sharing
   real_time exp;
 
+  if (perfcounter) {
+    perfcounter->inc(l_rgw_lc_examined, 1);
+  }
+
   for (auto& a : actions) {
     real_time action_exp;
 
@@ -1440,8 +1470,138 @@ int LCOpRule::process(rgw_bucket_dir_entry& o,
 
 }
 
-int RGWLC::bucket_lc_process(string& shard_id, LCWorker* worker,
-			     time_t stop_at, bool once)
+static void process_lc_shard(RGWLC::LCWorker* wk, WorkQ* wq,
+			     LCShardTask& task)
+{
+  auto lc = wk->get_lc();
+  LCObjsLister ol(task.store, *task.bucket_info, task.shard_id);
+  ol.set_prefix(task.prefix);
+  if (!task.start_marker.empty()) {
+    ol.set_marker(task.start_marker);
+  }
+
+  int ret = ol.init();
+  if (ret < 0) {
+    if (ret != -ENOENT) {
+      ldpp_dout(lc, 0) << "ERROR: " << __func__ << "(): list_objects() shard="
+		       << task.shard_id << " returned ret=" << ret
+		       << " " << wq->thr_name() << dendl;
+    }
+    return;
+  }
+
+  LCShardCheckpoint ckpt;
+  ckpt.marker = task.start_marker;
+  auto save = [&] {
+    int r = task.ckpts->save(task.ckpt_key, ckpt);
+    if (r < 0) {
+      ldpp_dout(lc, 0) << "WARNING: " << __func__
+		       << "(): failed to checkpoint lc shard " << task.ckpt_key
+		       << " of " << task.bucket_info->bucket
+		       << " r=" << r << dendl;
+    }
+  };
+
+  op_env oenv(*task.op, task.store, wk, *task.bucket_info, ol);
+  LCOpRule orule(oenv);
+  orule.build();
+  rgw_bucket_dir_entry* o{nullptr};
+  for (; ol.get_obj(&o, save); ol.next()) {
+    if (worker_should_stop(task.stop_at, task.once) || lc->going_down()) {
+      ldpp_dout(lc, 5) << __func__ << "(): stopping at " << ckpt.marker
+		       << " shard=" << task.ckpt_key << " "
+		       << wq->thr_name() << dendl;
+      save();
+      return;
+    }
+    orule.update();
+    int r = orule.process(*o, lc, wq);
+    if (r < 0) {
+      ldpp_dout(lc, 20) << "ERROR: orule.process() returned ret=" << r
+			<< wq->thr_name() << dendl;
+    }
+    ckpt.marker = o->key;
+  }
+
+  ckpt.done = true;
+  save();
+  if (perfcounter) {
+    perfcounter->inc(l_rgw_lc_shards_processed, 1);
+  }
+}
+
+int RGWLC::bucket_lc_process_shards(RGWBucketInfo& bucket_info,
+				    RGWLifecycleConfiguration& config,
+				    uint32_t config_crc, time_t cycle_start,
+				    LCWorker* worker, time_t stop_at, bool once)
+{
+  const int num_shards =
+    bucket_info.layout.current_index.layout.normal.num_shards;
+
+  LCShardCheckpoints ckpts(store->getRados()->lc_pool_ctx,
+			   bucket_info.bucket.get_key());
+  int ret = ckpts.load(config_crc, cycle_start);
+  if (ret < 0) {
+    ldpp_dout(this, 0) << "WARNING: " << __func__
+		       << "() failed to load lc checkpoints for "
+		       << bucket_info.bucket << " ret=" << ret << dendl;
+  }
+
+  auto pf = [](RGWLC::LCWorker* wk, WorkQ* wq, WorkItem& wi) {
+    auto& task = boost::get<LCShardTask>(wi);
+    process_lc_shard(wk, wq, task);
+  };
+  worker->workpool->setf(pf);
+
+  multimap<string, lc_op>& prefix_map = config.get_prefix_map();
+  int rule_ix = 0;
+  for (auto prefix_iter = prefix_map.begin(); prefix_iter != prefix_map.end();
+       ++prefix_iter, ++rule_ix) {
+
+    if (worker_should_stop(stop_at, once)) {
+      ldout(cct, 5) << __func__ << " interval budget EXPIRED worker "
+		     << worker->ix
+		     << dendl;
+      return 0;
+    }
+
+    auto& op = prefix_iter->second;
+    if (!is_valid_op(op)) {
+      continue;
+    }
+    ldpp_dout(this, 20) << __func__ << "(): prefix=" << prefix_iter->first
+			<< " index shards=" << num_shards << dendl;
+
+    for (int shard_id = 0; shard_id < num_shards; ++shard_id) {
+      auto key = LCShardCheckpoints::make_key(rule_ix, shard_id);
+      auto ckpt = ckpts.get(key);
+      if (ckpt.done) {
+	continue;
+      }
+      worker->workpool->enqueue(
+	WorkItem{LCShardTask{store, &bucket_info, &op, prefix_iter->first,
+			     shard_id, key, &ckpts, rgw_obj_key(ckpt.marker),
+			     stop_at, once}});
+    }
+    worker->workpool->drain();
+  }
+
+  if (worker_should_stop(stop_at, once) || going_down()) {
+    /* some shards may have stopped early, keep their markers */
+    return 0;
+  }
+
+  ret = ckpts.clear();
+  if (ret < 0) {
+    ldpp_dout(this, 0) << "WARNING: " << __func__
+		       << "() failed to remove lc checkpoints for "
+		       << bucket_info.bucket << " ret=" << ret << dendl;
+  }
+  return 0;
+}
+
+int RGWLC::bucket_lc_process(string& shard_id, time_t cycle_start,
+			     LCWorker* worker, time_t stop_at, bool once)
 {
   RGWLifecycleConfiguration  config(cct);
   RGWBucketInfo bucket_info;
@@ -1492,6 +1652,19 @@ int RGWLC::bucket_lc_process(string& shard_id, LCWorker* worker,
       return -1;
     }
 
+  if (cct->_conf.get_val<bool>("rgw_lc_shard_parallel") &&
+      bucket_info.layout.current_index.layout.normal.num_shards > 1) {
+    ret = bucket_lc_process_shards(bucket_info, config,
+				   aiter->second.crc32c(0), cycle_start,
+				   worker, stop_at, once);
+    if (ret < 0) {
+      return ret;
+    }
+    multimap<string, lc_op>& prefix_map = config.get_prefix_map();
+    return handle_multipart_expiration(&target, prefix_map, worker, stop_at,
+				       once);
+  }
+
   auto pf = [](RGWLC::LCWorker* wk, WorkQ* wq, WorkItem& wi) {
     auto wt =
       boost::get<std::tuple<LCOpRule, rgw_bucket_dir_entry>>(wi);
@@ -1824,7 +1997,8 @@ int RGWLC::process(int index, int max_lock_secs, LCWorker* worker,
 	    << dendl;
 
     l.unlock(&store->getRados()->lc_pool_ctx, obj_names[index]);
-    ret = bucket_lc_process(entry.bucket, worker, thread_stop_at(), once);
+    ret = bucket_lc_process(entry.bucket, head.start_date, worker,
+			    thread_stop_at(), once);
     bucket_lc_post(index, max_lock_secs, entry, ret, worker);
   } while(1 && !once);
 
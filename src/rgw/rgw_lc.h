@@ -521,8 +521,12 @@ public:
   int list_lc_progress(string& marker, uint32_t max_entries,
 		       vector<cls_rgw_lc_entry>&, int& index);
   int bucket_lc_prepare(int index, LCWorker* worker);
-  int bucket_lc_process(string& shard_id, LCWorker* worker, time_t stop_at,
-			bool once);
+  int bucket_lc_process(string& shard_id, time_t cycle_start,
+			LCWorker* worker, time_t stop_at, bool once);
+  int bucket_lc_process_shards(RGWBucketInfo& bucket_info,
+			       RGWLifecycleConfiguration& config,
+			       uint32_t config_crc, time_t cycle_start,
+			       LCWorker* worker, time_t stop_at, bool once);
   int bucket_lc_post(int index, int max_lock_sec,
 		     cls_rgw_lc_entry& entry, int& result, LCWorker* worker);
   bool going_down();
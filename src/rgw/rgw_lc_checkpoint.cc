@@ -0,0 +1,87 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#include "rgw_lc_checkpoint.h"
+
+#include <fmt/format.h>
+
+std::string LCShardCheckpoints::make_key(int rule_ix, int shard_id)
+{
+  return fmt::format("{}.{}", rule_ix, shard_id);
+}
+
+int LCShardCheckpoints::load(uint32_t config_crc, time_t cycle_start)
+{
+  const LCShardCheckpointsHeader expected{
+    config_crc, static_cast<uint64_t>(cycle_start)};
+  shards.clear();
+
+  std::map<std::string, bufferlist> vals;
+  int r = ioctx.omap_get_vals2(oid, std::string(), 100000, &vals, nullptr);
+  if (r == -ENOENT) {
+    return set_header(expected);
+  }
+  if (r < 0) {
+    return r;
+  }
+  LCShardCheckpointsHeader header;
+  auto iter = vals.find(header_key);
+  if (iter != vals.end()) {
+    try {
+      auto p = iter->second.cbegin();
+      decode(header, p);
+    } catch (buffer::error&) {
+      header = LCShardCheckpointsHeader{};
+    }
+  }
+  if (!(header == expected)) {
+    r = clear();
+    if (r < 0) {
+      return r;
+    }
+    return set_header(expected);
+  }
+  vals.erase(header_key);
+  for (auto& [key, bl] : vals) {
+    try {
+      auto p = bl.cbegin();
+      decode(shards[key], p);
+    } catch (buffer::error&) {
+      shards.erase(key);
+    }
+  }
+  return 0;
+}
+
+LCShardCheckpoint LCShardCheckpoints::get(const std::string& key) const
+{
+  auto iter = shards.find(key);
+  return (iter == shards.end() ? LCShardCheckpoint{} : iter->second);
+}
+
+int LCShardCheckpoints::save(const std::string& key,
+			     const LCShardCheckpoint& ckpt)
+{
+  std::map<std::string, bufferlist> vals;
+  encode(ckpt, vals[key]);
+  librados::ObjectWriteOperation op;
+  op.omap_set(vals);
+  return ioctx.operate(oid, &op);
+}
+
+int LCShardCheckpoints::clear()
+{
+  shards.clear();
+  int r = ioctx.remove(oid);
+  return (r == -ENOENT ? 0 : r);
+}
+
+int LCShardCheckpoints::set_header(const LCShardCheckpointsHeader& header)
+{
+  std::map<std::string, bufferlist> vals;
+  encode(header, vals[header_key]);
+  librados::ObjectWriteOperation op;
+  op.create(false);
+  op.omap_set(vals);
+  return ioctx.operate(oid, &op);
+}
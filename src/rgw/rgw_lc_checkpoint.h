@@ -0,0 +1,81 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "include/encoding.h"
+#include "include/rados/librados.hpp"
+#include "cls/rgw/cls_rgw_types.h"
+
+/* resumable progress of one lifecycle rule over one bucket index shard,
+ * kept in the omap of a per-bucket object in the lc pool */
+struct LCShardCheckpoint {
+  bool done{false};
+  cls_rgw_obj_key marker;
+
+  void encode(bufferlist& bl) const {
+    ENCODE_START(1, 1, bl);
+    encode(done, bl);
+    encode(marker, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::const_iterator& bl) {
+    DECODE_START(1, bl);
+    decode(done, bl);
+    decode(marker, bl);
+    DECODE_FINISH(bl);
+  }
+};
+WRITE_CLASS_ENCODER(LCShardCheckpoint)
+
+/* what the checkpoints of a bucket were taken under: the lifecycle
+ * configuration, whose rules are identified by their position in it,
+ * and the lc cycle, which starts over every day */
+struct LCShardCheckpointsHeader {
+  uint32_t config_crc{0};
+  uint64_t cycle_start{0};
+
+  void encode(bufferlist& bl) const {
+    ENCODE_START(1, 1, bl);
+    encode(config_crc, bl);
+    encode(cycle_start, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::const_iterator& bl) {
+    DECODE_START(1, bl);
+    decode(config_crc, bl);
+    decode(cycle_start, bl);
+    DECODE_FINISH(bl);
+  }
+  bool operator==(const LCShardCheckpointsHeader& o) const {
+    return config_crc == o.config_crc && cycle_start == o.cycle_start;
+  }
+};
+WRITE_CLASS_ENCODER(LCShardCheckpointsHeader)
+
+class LCShardCheckpoints {
+  static constexpr const char* header_key = "header";
+
+  librados::IoCtx& ioctx;
+  const std::string oid;
+  std::map<std::string, LCShardCheckpoint> shards;
+
+  int set_header(const LCShardCheckpointsHeader& header);
+
+public:
+  LCShardCheckpoints(librados::IoCtx& ioctx, const std::string& bucket_key)
+    : ioctx(ioctx), oid("lc_ckpt." + bucket_key) {}
+
+  static std::string make_key(int rule_ix, int shard_id);
+
+  /* load the checkpoints of the given cycle and configuration; those
+   * of an earlier cycle or another configuration are discarded */
+  int load(uint32_t config_crc, time_t cycle_start);
+
+  LCShardCheckpoint get(const std::string& key) const;
+  int save(const std::string& key, const LCShardCheckpoint& ckpt);
+  int clear();
+}; /* LCShardCheckpoints */
@@ -9,6 +9,7 @@
 
 #include "rgw_bucket.h"
 #include "rgw_log.h"
+#include "rgw_log_batcher.h"
 #include "rgw_acl.h"
 #include "rgw_client_io.h"
 #include "rgw_rest.h"
@@ -182,6 +183,64 @@ void rgw_log_usage_finalize()
   usage_logger = NULL;
 }
 
+/* appends batches of the asynchronous ops logger to the rados log
+ * objects */
+class RadosOpsLogBackend : public OpsLogBatcher::Backend {
+  RGWRados *store;
+
+  static void append_complete(librados::completion_t cb, void *arg) {
+    auto on_complete = static_cast<Context*>(arg);
+    on_complete->complete(rados_aio_get_return_value(cb));
+  }
+
+  int aio_append(const rgw_raw_obj& obj, bufferlist& bl, Context *on_complete) {
+    rgw_rados_ref ref;
+    int ret = store->get_raw_obj_ref(obj, &ref);
+    if (ret < 0) {
+      return ret;
+    }
+    auto c = librados::Rados::aio_create_completion(on_complete, append_complete);
+    ret = ref.pool.ioctx().aio_append(ref.obj.oid, c, bl, bl.length());
+    c->release();
+    return ret;
+  }
+
+public:
+  explicit RadosOpsLogBackend(RGWRados *_store) : store(_store) {}
+
+  int append(const string& oid, bufferlist& bl, Context *on_complete) override {
+    rgw_raw_obj obj(store->svc.zone->get_zone_params().log_pool, oid);
+    int ret = aio_append(obj, bl, on_complete);
+    if (ret == -ENOENT) {
+      ret = store->create_pool(store->svc.zone->get_zone_params().log_pool);
+      if (ret < 0)
+        return ret;
+      // retry
+      ret = aio_append(obj, bl, on_complete);
+    }
+    return ret;
+  }
+};
+
+static RadosOpsLogBackend *ops_log_backend = nullptr;
+static OpsLogBatcher *ops_log_batcher = nullptr;
+
+void rgw_log_ops_init(CephContext *cct, RGWRados *store)
+{
+  if (cct->_conf.get_val<bool>("rgw_ops_log_async")) {
+    ops_log_backend = new RadosOpsLogBackend(store);
+    ops_log_batcher = new OpsLogBatcher(cct, ops_log_backend);
+  }
+}
+
+void rgw_log_ops_finalize()
+{
+  delete ops_log_batcher;
+  ops_log_batcher = nullptr;
+  delete ops_log_backend;
+  ops_log_backend = nullptr;
+}
+
 static void log_usage(struct req_state *s, const string& op_name)
 {
   if (s->system_request) /* don't log system user operations */
@@ -291,6 +350,20 @@ void rgw_format_ops_log_entry(struct rgw_log_entry& entry, Formatter *formatter)
   formatter->close_section();
 }
 
+int rgw_log_entry_decode_next(bufferlist::const_iterator& iter,
+			      rgw_log_entry *entry)
+{
+  if (iter.end()) {
+    return 0;
+  }
+  try {
+    decode(*entry, iter);
+  } catch (const buffer::error& e) {
+    return -EINVAL;
+  }
+  return 1;
+}
+
 void OpsLogSocket::formatter_to_bl(bufferlist& bl)
 {
   stringstream ss;
@@ -447,9 +520,6 @@ int rgw_log_op(RGWRados *store, RGWREST* const rest, struct req_state *s,
   entry.bucket_id = bucket_id;
   entry.trans_id = s->trans_id;
 
-  bufferlist bl;
-  encode(entry, bl);
-
   struct tm bdt;
   time_t t = req_state::Clock::to_time_t(entry.time);
   if (s->cct->_conf->rgw_log_object_name_utc)
@@ -457,6 +527,19 @@ int rgw_log_op(RGWRados *store, RGWREST* const rest, struct req_state *s,
   else
     localtime_r(&t, &bdt);
 
+  if (ops_log_batcher) {
+    string oid;
+    if (s->cct->_conf->rgw_ops_log_rados) {
+      oid = render_log_object_name(s->cct->_conf->rgw_log_object_name, &bdt,
+                                   entry.bucket_id, entry.bucket);
+    }
+    ops_log_batcher->insert(std::move(entry), oid, olog);
+    return 0;
+  }
+
+  bufferlist bl;
+  encode(entry, bl);
+
   int ret = 0;
 
   if (s->cct->_conf->rgw_ops_log_rados) {
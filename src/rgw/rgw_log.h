@@ -147,8 +147,16 @@ int rgw_log_op(RGWRados *store, RGWREST* const rest, struct req_state *s,
 	       const string& op_name, OpsLogSocket *olog);
 void rgw_log_usage_init(CephContext *cct, RGWRados *store);
 void rgw_log_usage_finalize();
+void rgw_log_ops_init(CephContext *cct, RGWRados *store);
+void rgw_log_ops_finalize();
 void rgw_format_ops_log_entry(struct rgw_log_entry& entry,
 			      ceph::Formatter *formatter);
+/* decode the next entry of a buffer of back to back rgw_log_entry
+ * encodings, as in the rados log objects and rgw_ops_log_file_path.
+ * returns 1 if an entry was decoded, 0 at the end of the buffer and
+ * -EINVAL if the rest of it is not a valid entry */
+int rgw_log_entry_decode_next(bufferlist::const_iterator& iter,
+			      rgw_log_entry *entry);
 
 #endif /* CEPH_RGW_LOG_H */
 
@@ -0,0 +1,176 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#include <fcntl.h>
+
+#include "common/Clock.h"
+#include "common/Thread.h"
+#include "common/errno.h"
+
+#include "rgw_log_batcher.h"
+#include "rgw_perf_counters.h"
+
+#define dout_subsys ceph_subsys_rgw
+
+OpsLogBatcher::OpsLogBatcher(CephContext *_cct, Backend *_backend)
+  : cct(_cct), backend(_backend),
+    flush_size(cct->_conf.get_val<Option::size_t>("rgw_ops_log_flush_size")),
+    max_buffered(cct->_conf.get_val<Option::size_t>("rgw_ops_log_max_buffer")),
+    flush_interval(cct->_conf.get_val<uint64_t>("rgw_ops_log_flush_interval"))
+{
+  const auto& path = cct->_conf.get_val<std::string>("rgw_ops_log_file_path");
+  if (!path.empty()) {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+    if (fd < 0) {
+      lderr(cct) << "ERROR: failed to open ops log file " << path << ": "
+                 << cpp_strerror(errno) << dendl;
+    }
+  }
+  flusher = make_named_thread("rgw_ops_log", &OpsLogBatcher::run, this);
+}
+
+OpsLogBatcher::~OpsLogBatcher()
+{
+  {
+    std::lock_guard l{lock};
+    stopping = true;
+  }
+  cond.notify_one();
+  flusher.join();
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+OpsLogBatcher::Shard& OpsLogBatcher::get_shard()
+{
+  const auto h = std::hash<std::thread::id>{}(std::this_thread::get_id());
+  return shards[h % num_shards];
+}
+
+bool OpsLogBatcher::reserve(uint64_t size, uint64_t *total)
+{
+  // check and add in one step, so that concurrent inserts can't all pass
+  // the check and overshoot the limit together
+  uint64_t cur = buffered_bytes.load();
+  do {
+    if (cur + size > max_buffered) {
+      return false;
+    }
+  } while (!buffered_bytes.compare_exchange_weak(cur, cur + size));
+  *total = cur + size;
+  return true;
+}
+
+void OpsLogBatcher::run()
+{
+  std::unique_lock l{lock};
+  while (!stopping) {
+    cond.wait_for(l, flush_interval);
+    l.unlock();
+    flush();
+    l.lock();
+  }
+  l.unlock();
+  flush();
+}
+
+void OpsLogBatcher::insert(rgw_log_entry&& entry, const std::string& oid,
+                           OpsLogSocket *olog)
+{
+  bufferlist bl;
+  encode(entry, bl);
+  const uint64_t size = bl.length();
+
+  uint64_t total;
+  if (!reserve(size, &total)) {
+    if (perfcounter) {
+      perfcounter->inc(l_rgw_ops_log_dropped);
+    }
+    return;
+  }
+
+  auto& shard = get_shard();
+  {
+    std::lock_guard l{shard.lock};
+    if (!oid.empty()) {
+      shard.objs[oid].append(bl);
+    }
+    if (fd >= 0) {
+      shard.file_bl.append(bl);
+    }
+    if (olog) {
+      shard.socket_entries.emplace_back(olog, std::move(entry));
+    }
+    shard.bytes += size;
+  }
+
+  if (total >= flush_size) {
+    cond.notify_one();
+  }
+}
+
+void OpsLogBatcher::flush()
+{
+  std::map<std::string, bufferlist> objs;
+  bufferlist file_bl;
+  std::vector<std::pair<OpsLogSocket*, rgw_log_entry>> socket_entries;
+  uint64_t bytes = 0;
+  for (auto& shard : shards) {
+    std::lock_guard l{shard.lock};
+    for (auto& [oid, bl] : shard.objs) {
+      objs[oid].claim_append(bl);
+    }
+    shard.objs.clear();
+    file_bl.claim_append(shard.file_bl);
+    std::move(shard.socket_entries.begin(), shard.socket_entries.end(),
+              std::back_inserter(socket_entries));
+    shard.socket_entries.clear();
+    bytes += shard.bytes;
+    shard.bytes = 0;
+  }
+  buffered_bytes -= bytes;
+  if (bytes == 0) {
+    return;
+  }
+
+  const auto start = ceph::mono_clock::now();
+  C_GatherBuilder gather(cct, make_lambda_context(
+    [bytes, start] (int r) {
+      if (perfcounter) {
+        perfcounter->inc(l_rgw_ops_log_flushed_bytes, bytes);
+        perfcounter->tinc(l_rgw_ops_log_flush_lat,
+                          ceph::mono_clock::now() - start);
+      }
+    }));
+  // covers the file write and the socket, so the gather always has a sub
+  Context *local = gather.new_sub();
+
+  for (auto iter = objs.begin(); iter != objs.end(); ++iter) {
+    Context *sub = gather.new_sub();
+    Context *on_complete = make_lambda_context(
+      [cct = cct, oid = iter->first, sub] (int r) {
+        if (r < 0) {
+          ldout(cct, 0) << "ERROR: failed to write ops log object " << oid
+                        << ": " << cpp_strerror(r) << dendl;
+        }
+        sub->complete(r);
+      });
+    int ret = backend->append(iter->first, iter->second, on_complete);
+    if (ret < 0) {
+      on_complete->complete(ret);
+    }
+  }
+  if (fd >= 0 && file_bl.length() > 0) {
+    int ret = file_bl.write_fd(fd);
+    if (ret < 0) {
+      ldout(cct, 0) << "ERROR: failed to write ops log file: "
+                    << cpp_strerror(ret) << dendl;
+    }
+  }
+  for (auto& [olog, entry] : socket_entries) {
+    olog->log(entry);
+  }
+  local->complete(0);
+  gather.activate();
+}
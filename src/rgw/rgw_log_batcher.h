@@ -0,0 +1,80 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/ceph_mutex.h"
+#include "include/Context.h"
+#include "rgw_log.h"
+
+/* asynchronous ops logger: entries are encoded on the request path into
+ * buffers sharded by thread, and written out in batches by a flush thread:
+ * one append per log object, one write to the log file, and json
+ * formatting for the ops log socket moved off the request path */
+class OpsLogBatcher {
+public:
+  /* where the buffered entries of each log object go */
+  class Backend {
+  public:
+    virtual ~Backend() {}
+    /* start appending bl to the log object oid. on_complete is called
+     * with the result once the append is done, unless an error is
+     * returned */
+    virtual int append(const std::string& oid, bufferlist& bl,
+                       Context *on_complete) = 0;
+  };
+
+private:
+  CephContext *cct;
+  Backend *backend;
+
+  struct Shard {
+    ceph::mutex lock = ceph::make_mutex("OpsLogBatcher::Shard");
+    std::map<std::string, bufferlist> objs;
+    bufferlist file_bl;
+    std::vector<std::pair<OpsLogSocket*, rgw_log_entry>> socket_entries;
+    uint64_t bytes = 0;
+  };
+  static constexpr size_t num_shards = 16;
+  std::array<Shard, num_shards> shards;
+  std::atomic<uint64_t> buffered_bytes = { 0 };
+
+  const uint64_t flush_size;
+  const uint64_t max_buffered;
+  const std::chrono::milliseconds flush_interval;
+  int fd = -1;
+
+  ceph::mutex lock = ceph::make_mutex("OpsLogBatcher");
+  ceph::condition_variable cond;
+  bool stopping = false;
+  std::thread flusher;
+
+  Shard& get_shard();
+  /* reserve size bytes of the buffer, false if that would exceed
+   * rgw_ops_log_max_buffer */
+  bool reserve(uint64_t size, uint64_t *total);
+  void run();
+
+public:
+  OpsLogBatcher(CephContext *_cct, Backend *_backend);
+  ~OpsLogBatcher();
+
+  /* oid is empty when the entry is not logged to rados */
+  void insert(rgw_log_entry&& entry, const std::string& oid,
+              OpsLogSocket *olog);
+  /* write out everything buffered so far. ops_log_flush_lat is recorded
+   * once all of the appends have completed */
+  void flush();
+
+  uint64_t get_buffered_bytes() const {
+    return buffered_bytes;
+  }
+};
@@ -49,6 +49,10 @@ int rgw_perf_start(CephContext *cct)
 		      "Lifecycle non-current transition");
   plb.add_u64_counter(l_rgw_lc_abort_mpu, "lc_abort_mpu",
 		      "Lifecycle abort multipart upload");
+  plb.add_u64_counter(l_rgw_lc_examined, "lc_examined",
+		      "Lifecycle objects examined");
+  plb.add_u64_counter(l_rgw_lc_shards_processed, "lc_shards_processed",
+		      "Lifecycle bucket index shards completed");
 
   plb.add_u64_counter(l_rgw_pubsub_event_triggered, "pubsub_event_triggered", "Pubsub events with at least one topic");
   plb.add_u64_counter(l_rgw_pubsub_event_lost, "pubsub_event_lost", "Pubsub events lost");
@@ -59,6 +63,10 @@ int rgw_perf_start(CephContext *cct)
   plb.add_u64_counter(l_rgw_pubsub_push_failed, "pubsub_push_failed", "Pubsub events failed to be pushed to an endpoint");
   plb.add_u64(l_rgw_pubsub_push_pending, "pubsub_push_pending", "Pubsub events pending reply from endpoint");
   plb.add_u64_counter(l_rgw_pubsub_missing_conf, "pubsub_missing_conf", "Pubsub events could not be handled because of missing configuration");
+
+  plb.add_u64_counter(l_rgw_ops_log_dropped, "ops_log_dropped", "Ops log entries dropped because the async buffer was full");
+  plb.add_u64_counter(l_rgw_ops_log_flushed_bytes, "ops_log_flushed_bytes", "Bytes of encoded ops log entries flushed");
+  plb.add_time_avg(l_rgw_ops_log_flush_lat, "ops_log_flush_lat", "Ops log batch flush latency, until its appends complete");
   
   perfcounter = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(perfcounter);
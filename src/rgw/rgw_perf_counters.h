@@ -39,6 +39,8 @@ enum {
   l_rgw_lc_transition_current,
   l_rgw_lc_transition_noncurrent,
   l_rgw_lc_abort_mpu,
+  l_rgw_lc_examined,
+  l_rgw_lc_shards_processed,
 
   l_rgw_pubsub_event_triggered,
   l_rgw_pubsub_event_lost,
@@ -50,6 +52,10 @@ enum {
   l_rgw_pubsub_push_pending,
   l_rgw_pubsub_missing_conf,
 
+  l_rgw_ops_log_dropped,
+  l_rgw_ops_log_flushed_bytes,
+  l_rgw_ops_log_flush_lat,
+
   l_rgw_last,
 };
 
@@ -41,18 +41,44 @@ void RGWProcess::RGWWQ::_dump_queue()
   }
 } /* RGWProcess::RGWWQ::_dump_queue */
 
+/* data and metadata requests may be scheduled per tenant or bucket, so that
+ * one busy tenant can't starve the others. this runs before authentication,
+ * so the key is taken from the request url */
+static rgw::dmclock::client_key dmclock_client_key(req_state *s, RGWOp *op)
+{
+  using namespace rgw::dmclock;
+  const auto client = op->dmclock_client();
+  if (client != client_id::data && client != client_id::metadata) {
+    return client;
+  }
+  switch (get_client_key_t(s->cct)) {
+  case client_key_t::tenant:
+    return {client, s->bucket_tenant};
+  case client_key_t::bucket:
+    if (s->bucket_name.empty()) {
+      return client;
+    }
+    if (s->bucket_tenant.empty()) {
+      return {client, s->bucket_name};
+    }
+    return {client, s->bucket_tenant + ":" + s->bucket_name};
+  default:
+    return client;
+  }
+}
+
 auto schedule_request(Scheduler *scheduler, req_state *s, RGWOp *op)
 {
   using rgw::dmclock::SchedulerCompleter;
   if (!scheduler)
     return std::make_pair(0,SchedulerCompleter{});
 
-  const auto client = op->dmclock_client();
+  const auto client = dmclock_client_key(s, op);
   const auto cost = op->dmclock_cost();
   if (s->cct->_conf->subsys.should_gather(ceph_subsys_rgw, 10)) {
     ldpp_dout(op,10) << "scheduling with "
 		     << s->cct->_conf.get_val<std::string>("rgw_scheduler_type")
-		     << " client=" << static_cast<int>(client)
+		     << " client=" << client
 		     << " cost=" << cost << dendl;
   }
   return scheduler->schedule_request(client, {},
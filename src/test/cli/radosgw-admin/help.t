@@ -110,7 +110,7 @@
     policy                     read bucket/object policy
     log list                   list log objects
     log show                   dump a log from specific object or (bucket + date
-                               + bucket-id)
+                               + bucket-id), or from an ops log file (--infile)
                                (NOTE: required to specify formatting of date
                                to "YYYY-MM-DD-hh")
     log rm                     remove log object
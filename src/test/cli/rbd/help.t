@@ -164,26 +164,44 @@
   rbd help bench
   usage: rbd bench [--pool <pool>] [--namespace <namespace>] [--image <image>] 
                    [--io-size <io-size>] [--io-threads <io-threads>] 
-                   [--io-total <io-total>] [--io-pattern <io-pattern>] 
-                   [--rw-mix-read <rw-mix-read>] --io-type <io-type> 
-                   <image-spec> 
+                   [--io-depth <io-depth>] [--io-total <io-total>] 
+                   [--io-pattern <io-pattern>] [--rw-mix-read <rw-mix-read>] 
+                   [--zipf-theta <zipf-theta>] [--hotspot-data <hotspot-data>] 
+                   [--hotspot-io <hotspot-io>] [--format <format>] 
+                   [--pretty-format] --io-type <io-type> 
+                   <image-spec> <additional-image-spec> [<additional-image-spec>
+                   ...]
   
   Simple benchmark.
   
   Positional arguments
-    <image-spec>         image specification
-                         (example: [<pool-name>/[<namespace>/]]<image-name>)
-  
-  Optional arguments
-    -p [ --pool ] arg    pool name
-    --namespace arg      namespace name
-    --image arg          image name
-    --io-size arg        IO size (in B/K/M/G/T) [default: 4K]
-    --io-threads arg     ios in flight [default: 16]
-    --io-total arg       total size for IO (in B/K/M/G/T) [default: 1G]
-    --io-pattern arg     IO pattern (rand, seq, or full-seq) [default: seq]
-    --rw-mix-read arg    read proportion in readwrite (<= 100) [default: 50]
-    --io-type arg        IO type (read, write, or readwrite(rw))
+    <image-spec>                image specification
+                                (example:
+                                [<pool-name>/[<namespace>/]]<image-name>)
+    <additional-image-spec>     additional images to benchmark concurrently
+  
+  Optional arguments
+    -p [ --pool ] arg           pool name
+    --namespace arg             namespace name
+    --image arg                 image name
+    --io-size arg               IO size (in B/K/M/G/T) [default: 4K]
+    --io-threads arg            threads issuing ios per image [default: 16]
+    --io-depth arg              ios in flight per thread [default: 1]
+    --io-total arg              total size for IO per image (in B/K/M/G/T)
+                                [default: 1G]
+    --io-pattern arg            IO pattern (rand, seq, full-seq, zipf, or
+                                hotspot) [default: seq]
+    --rw-mix-read arg           read proportion in readwrite (<= 100) [default:
+                                50]
+    --zipf-theta arg            skew of the zipf IO pattern (> 0) [default: 0.99]
+    --hotspot-data arg          percentage of the image in the hotspot IO
+                                pattern's hot set (<= 100) [default: 10]
+    --hotspot-io arg            percentage of ios sent to the hot set (<= 100)
+                                [default: 90]
+    --format arg                output format (plain, json, or xml) [default:
+                                plain]
+    --pretty-format             pretty formatting (json and xml)
+    --io-type arg               IO type (read, write, or readwrite(rw))
   
   rbd help children
   usage: rbd children [--pool <pool>] [--namespace <namespace>] 
@@ -0,0 +1,115 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <gtest/gtest.h>
+
+#include "common/LogClient.h"
+#include "global/global_context.h"
+#include "messages/MLog.h"
+#include "mon/MonMap.h"
+
+using namespace std;
+
+namespace {
+
+LogEntry make_entry(utime_t stamp, const string& msg)
+{
+  LogEntry e;
+  e.stamp = stamp;
+  e.prio = CLOG_WARN;
+  e.channel = "cluster";
+  e.msg = msg;
+  return e;
+}
+
+deque<LogEntry> get_entries(LogClient *client, bool flush)
+{
+  auto m = client->get_mon_log_message(flush);
+  if (!m) {
+    return {};
+  }
+  return static_cast<MLog*>(m.get())->entries;
+}
+
+} // anonymous namespace
+
+TEST(LogClient, FoldRepeats)
+{
+  g_ceph_context->_conf.set_val("clog_repeat_interval", "5");
+  MonMap monmap;
+  LogClient client(g_ceph_context, nullptr, &monmap, LogClient::NO_FLAGS);
+
+  // an old burst, whose interval is over by the time it is sent
+  utime_t start = ceph_clock_now();
+  start -= 60;
+  for (int i = 0; i < 4; ++i) {
+    auto e = make_entry(start + utime_t(i, 0), "slow ops");
+    client.queue(e);
+  }
+  // other messages are not folded with it
+  auto other = make_entry(start + utime_t(1, 0), "osd down");
+  client.queue(other);
+
+  auto entries = get_entries(&client, false);
+  ASSERT_EQ(3u, entries.size());
+  EXPECT_EQ("slow ops", entries[0].msg);
+  EXPECT_EQ(start, entries[0].stamp);
+  EXPECT_EQ("osd down", entries[1].msg);
+  // one entry for the repeats, stamped with the last of them
+  EXPECT_EQ(0u, entries[2].msg.find("slow ops (repeated 3 more times since "));
+  EXPECT_EQ(start + utime_t(3, 0), entries[2].stamp);
+  EXPECT_EQ(CLOG_WARN, entries[2].prio);
+  EXPECT_EQ("cluster", entries[2].channel);
+
+  // a message repeated past the interval is sent again
+  auto e = make_entry(start + utime_t(10, 0), "slow ops");
+  client.queue(e);
+  entries = get_entries(&client, false);
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ("slow ops", entries[0].msg);
+}
+
+TEST(LogClient, FlushRepeats)
+{
+  g_ceph_context->_conf.set_val("clog_repeat_interval", "5");
+  MonMap monmap;
+  LogClient client(g_ceph_context, nullptr, &monmap, LogClient::NO_FLAGS);
+
+  utime_t now = ceph_clock_now();
+  for (int i = 0; i < 3; ++i) {
+    auto e = make_entry(now, "slow ops");
+    client.queue(e);
+  }
+  auto e = make_entry(now, "osd down");
+  client.queue(e);
+  e = make_entry(now, "osd down");
+  client.queue(e);
+
+  // the interval is not over yet
+  auto entries = get_entries(&client, false);
+  ASSERT_EQ(2u, entries.size());
+  ASSERT_TRUE(get_entries(&client, false).empty());
+
+  // but a flush sends every pending repeat
+  entries = get_entries(&client, true);
+  ASSERT_LE(2u, entries.size());
+  auto p = entries.end() - 2;
+  EXPECT_EQ(0u, p->msg.find("osd down (repeated 1 more times"));
+  ++p;
+  EXPECT_EQ(0u, p->msg.find("slow ops (repeated 2 more times"));
+}
+
+TEST(LogClient, NoRepeatInterval)
+{
+  g_ceph_context->_conf.set_val("clog_repeat_interval", "0");
+  MonMap monmap;
+  LogClient client(g_ceph_context, nullptr, &monmap, LogClient::NO_FLAGS);
+
+  utime_t now = ceph_clock_now();
+  for (int i = 0; i < 3; ++i) {
+    auto e = make_entry(now, "slow ops");
+    client.queue(e);
+  }
+  ASSERT_EQ(3u, get_entries(&client, false).size());
+  g_ceph_context->_conf.set_val("clog_repeat_interval", "5");
+}
@@ -0,0 +1,46 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <gtest/gtest.h>
+
+#include "common/LogEntry.h"
+
+using namespace std;
+
+static LogEntry make_entry(const string& channel, uint64_t seq)
+{
+  LogEntry e;
+  e.stamp = utime_t(seq, 0);
+  e.seq = seq;
+  e.prio = CLOG_INFO;
+  e.channel = channel;
+  e.msg = channel + " message";
+  return e;
+}
+
+TEST(LogSummary, prune) {
+  LogSummary summary;
+  for (uint64_t seq = 1; seq <= 10; ++seq) {
+    summary.add(make_entry("cluster", seq));
+    summary.add(make_entry("audit", 100 + seq));
+  }
+  summary.prune(8);
+  ASSERT_EQ(8u, summary.tail_by_channel["cluster"].size());
+  ASSERT_EQ(8u, summary.tail_by_channel["audit"].size());
+  ASSERT_FALSE(summary.contains(make_entry("cluster", 2).key()));
+  ASSERT_TRUE(summary.contains(make_entry("cluster", 3).key()));
+}
+
+TEST(LogSummary, prune_by_channel) {
+  LogSummary summary;
+  for (uint64_t seq = 1; seq <= 10; ++seq) {
+    summary.add(make_entry("cluster", seq));
+    summary.add(make_entry("audit", 100 + seq));
+  }
+  summary.prune({{"audit", 2}}, 5);
+  ASSERT_EQ(5u, summary.tail_by_channel["cluster"].size());
+  ASSERT_EQ(2u, summary.tail_by_channel["audit"].size());
+  ASSERT_TRUE(summary.contains(make_entry("cluster", 6).key()));
+  ASSERT_FALSE(summary.contains(make_entry("audit", 108).key()));
+  ASSERT_TRUE(summary.contains(make_entry("audit", 109).key()));
+}
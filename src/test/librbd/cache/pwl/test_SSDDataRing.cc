@@ -0,0 +1,170 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "librbd/cache/pwl/SSDDataRing.h"
+#include "gtest/gtest.h"
+
+namespace librbd {
+namespace cache {
+namespace pwl {
+
+static const uint64_t START = 8192;
+static const uint64_t END = START + 10 * 4096;
+
+TEST(TestSSDDataRing, Empty) {
+  SSDDataRing ring;
+  ring.init(START, END);
+  ASSERT_EQ(START, ring.get_head());
+  ASSERT_EQ(START, ring.get_tail());
+  ASSERT_EQ(0u, ring.get_used());
+  ASSERT_EQ(10 * 4096u, ring.get_size());
+}
+
+TEST(TestSSDDataRing, ReleaseOutOfOrder) {
+  SSDDataRing ring;
+  ring.init(START, END);
+  uint64_t pos1, pos2, pos3;
+  ASSERT_TRUE(ring.alloc(4096, &pos1));
+  ASSERT_TRUE(ring.alloc(8192, &pos2));
+  ASSERT_TRUE(ring.alloc(4096, &pos3));
+  ASSERT_EQ(START, pos1);
+  ASSERT_EQ(START + 4096, pos2);
+  ASSERT_EQ(START + 3 * 4096, pos3);
+  ASSERT_EQ(4 * 4096u, ring.get_used());
+
+  /* The tail only moves past released space */
+  ring.release(pos2, 8192);
+  ASSERT_EQ(START, ring.get_tail());
+  ASSERT_EQ(4 * 4096u, ring.get_used());
+  ring.release(pos1, 4096);
+  ASSERT_EQ(pos3, ring.get_tail());
+  ASSERT_EQ(4096u, ring.get_used());
+  ring.release(pos3, 4096);
+  ASSERT_EQ(ring.get_head(), ring.get_tail());
+  ASSERT_EQ(0u, ring.get_used());
+}
+
+TEST(TestSSDDataRing, Full) {
+  SSDDataRing ring;
+  ring.init(START, END);
+  uint64_t pos;
+  ASSERT_TRUE(ring.alloc(9 * 4096, &pos));
+  /* Filling the ring completely would make it look empty */
+  ASSERT_FALSE(ring.alloc(4096, &pos));
+  ASSERT_TRUE(ring.alloc(4095, &pos));
+  ASSERT_FALSE(ring.alloc(1, &pos));
+  ASSERT_EQ(10 * 4096u - 1, ring.get_used());
+}
+
+TEST(TestSSDDataRing, Wraparound) {
+  SSDDataRing ring;
+  ring.init(START, END);
+  uint64_t pos1, pos2, pos3;
+  ASSERT_TRUE(ring.alloc(4 * 4096, &pos1));
+  ASSERT_TRUE(ring.alloc(4 * 4096, &pos2));
+  ring.release(pos1, 4 * 4096);
+  ASSERT_EQ(pos2, ring.get_tail());
+
+  /* Doesn't fit before the end: the last two blocks are skipped */
+  ASSERT_TRUE(ring.alloc(3 * 4096, &pos3));
+  ASSERT_EQ(START, pos3);
+  ASSERT_EQ(START + 3 * 4096, ring.get_head());
+  ASSERT_EQ(9 * 4096u, ring.get_used());
+
+  /* The skipped space counts until the tail moves past it */
+  uint64_t pos;
+  ASSERT_FALSE(ring.alloc(4096, &pos));
+  ring.release(pos2, 4 * 4096);
+  ASSERT_EQ(START, ring.get_tail());
+  ASSERT_EQ(3 * 4096u, ring.get_used());
+
+  ring.release(pos3, 3 * 4096);
+  ASSERT_EQ(0u, ring.get_used());
+  ASSERT_EQ(ring.get_head(), ring.get_tail());
+}
+
+TEST(TestSSDDataRing, WraparoundEmpty) {
+  SSDDataRing ring;
+  ring.init(START, END);
+  uint64_t pos1, pos2;
+  ASSERT_TRUE(ring.alloc(8 * 4096, &pos1));
+  ring.release(pos1, 8 * 4096);
+  ASSERT_EQ(START + 8 * 4096, ring.get_tail());
+
+  /* Skipping the end of an empty ring moves the tail along */
+  ASSERT_TRUE(ring.alloc(4 * 4096, &pos2));
+  ASSERT_EQ(START, pos2);
+  ASSERT_EQ(START, ring.get_tail());
+  ASSERT_EQ(4 * 4096u, ring.get_used());
+}
+
+TEST(TestSSDDataRing, HeadAtEnd) {
+  SSDDataRing ring;
+  ring.init(START, END);
+  uint64_t pos1, pos2;
+  ASSERT_TRUE(ring.alloc(5 * 4096, &pos1));
+  ring.release(pos1, 5 * 4096);
+  ASSERT_TRUE(ring.alloc(5 * 4096, &pos2));
+  ASSERT_EQ(START + 5 * 4096, pos2);
+  ASSERT_EQ(START, ring.get_head());
+  ring.release(pos2, 5 * 4096);
+  ASSERT_EQ(START, ring.get_tail());
+  ASSERT_EQ(0u, ring.get_used());
+}
+
+TEST(TestSSDDataRing, Load) {
+  SSDDataRing ring;
+  ring.init(START, END);
+  /* From tail at block 7 to head at block 3, wrapping. Blocks 8 and 1
+   * were released, and block 9 was skipped. */
+  ASSERT_TRUE(ring.load(START + 7 * 4096, START + 3 * 4096,
+                        {{START + 2 * 4096, 4096},
+                         {START, 4096},
+                         {START + 7 * 4096, 4096}}));
+  ASSERT_EQ(START + 7 * 4096, ring.get_tail());
+  ASSERT_EQ(START + 3 * 4096, ring.get_head());
+  ASSERT_EQ(6 * 4096u, ring.get_used());
+
+  ring.release(START + 7 * 4096, 4096);
+  ASSERT_EQ(START, ring.get_tail());
+  ASSERT_EQ(3 * 4096u, ring.get_used());
+  ring.release(START, 4096);
+  ASSERT_EQ(START + 2 * 4096, ring.get_tail());
+  ring.release(START + 2 * 4096, 4096);
+  ASSERT_EQ(0u, ring.get_used());
+
+  uint64_t pos;
+  ASSERT_TRUE(ring.alloc(4096, &pos));
+  ASSERT_EQ(START + 3 * 4096, pos);
+}
+
+TEST(TestSSDDataRing, LoadReleased) {
+  SSDDataRing ring;
+  ring.init(START, END);
+  /* Everything between tail and head was retired */
+  ASSERT_TRUE(ring.load(START + 2 * 4096, START + 6 * 4096, {}));
+  ASSERT_EQ(0u, ring.get_used());
+  ASSERT_EQ(START + 6 * 4096, ring.get_tail());
+}
+
+TEST(TestSSDDataRing, LoadInvalid) {
+  SSDDataRing ring;
+  ring.init(START, END);
+  /* Outside of tail..head */
+  ASSERT_FALSE(ring.load(START + 2 * 4096, START + 6 * 4096,
+                         {{START + 6 * 4096, 4096}}));
+  ASSERT_FALSE(ring.load(START + 2 * 4096, START + 6 * 4096,
+                         {{START + 5 * 4096, 8192}}));
+  /* Overlapping */
+  ASSERT_FALSE(ring.load(START + 2 * 4096, START + 6 * 4096,
+                         {{START + 2 * 4096, 8192},
+                          {START + 3 * 4096, 4096}}));
+  /* Outside of the ring */
+  ASSERT_FALSE(ring.load(START + 2 * 4096, START + 6 * 4096,
+                         {{START - 4096, 4096}}));
+  ASSERT_FALSE(ring.load(END, START, {}));
+}
+
+} // namespace pwl
+} // namespace cache
+} // namespace librbd
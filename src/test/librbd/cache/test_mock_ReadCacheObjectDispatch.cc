@@ -0,0 +1,397 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "test/librbd/mock/MockImageCtx.h"
+#include "test/librbd/mock/MockExclusiveLock.h"
+#include "include/rbd/librbd.hpp"
+#include "librbd/cache/ReadCacheObjectDispatch.h"
+#include "librbd/io/ObjectDispatchSpec.h"
+
+namespace librbd {
+namespace {
+
+struct MockTestImageCtx : public MockImageCtx {
+  MockTestImageCtx(ImageCtx &image_ctx) : MockImageCtx(image_ctx) {
+  }
+};
+
+struct MockContext : public C_SaferCond  {
+  MOCK_METHOD1(complete, void(int));
+  MOCK_METHOD1(finish, void(int));
+
+  void do_complete(int r) {
+    C_SaferCond::complete(r);
+  }
+};
+
+} // anonymous namespace
+} // namespace librbd
+
+#include "librbd/cache/ReadCacheObjectDispatch.cc"
+
+namespace librbd {
+namespace cache {
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Return;
+
+struct TestMockCacheReadCacheObjectDispatch : public TestMockFixture {
+  typedef ReadCacheObjectDispatch<librbd::MockTestImageCtx> MockReadCacheObjectDispatch;
+
+  void expect_op_work_queue(MockTestImageCtx& mock_image_ctx) {
+    EXPECT_CALL(*mock_image_ctx.op_work_queue, queue(_, _))
+      .WillRepeatedly(Invoke([](Context* ctx, int r) {
+                        ctx->complete(r);
+                      }));
+  }
+
+  void expect_register_dispatch(MockTestImageCtx& mock_image_ctx) {
+    EXPECT_CALL(*mock_image_ctx.io_object_dispatcher, register_dispatch(_));
+  }
+
+  void expect_is_lock_owner(MockExclusiveLock& mock_exclusive_lock,
+                            bool owner) {
+    EXPECT_CALL(mock_exclusive_lock, is_lock_owner())
+      .WillRepeatedly(Return(owner));
+  }
+
+  void expect_context_complete(MockContext& mock_context, int r) {
+    EXPECT_CALL(mock_context, complete(r))
+      .WillOnce(Invoke([&mock_context](int r) {
+                  mock_context.do_complete(r);
+                }));
+  }
+
+  void init(MockTestImageCtx& mock_image_ctx,
+            MockReadCacheObjectDispatch& object_dispatch) {
+    expect_op_work_queue(mock_image_ctx);
+    expect_register_dispatch(mock_image_ctx);
+    ASSERT_EQ(0, object_dispatch.init());
+  }
+
+  // reads through the cache, fulfilling misses with the provided data
+  bool read(MockReadCacheObjectDispatch& object_dispatch,
+            IOContext io_context, uint64_t object_no, uint64_t off,
+            uint64_t len, int r, const bufferlist& data, bufferlist* out) {
+    io::ReadExtents extents = {{off, len}};
+    io::DispatchResult dispatch_result;
+    MockContext finish_ctx;
+    C_SaferCond dispatch_ctx;
+    Context* finish_ctx_ptr = &finish_ctx;
+    if (object_dispatch.read(object_no, &extents, io_context, 0, 0, {},
+                             nullptr, nullptr, &dispatch_result,
+                             &finish_ctx_ptr, &dispatch_ctx)) {
+      EXPECT_EQ(0, dispatch_ctx.wait());
+      EXPECT_EQ(io::DISPATCH_RESULT_COMPLETE, dispatch_result);
+      EXPECT_EQ(finish_ctx_ptr, &finish_ctx);
+      *out = extents[0].bl;
+      return true;
+    }
+
+    if (finish_ctx_ptr != &finish_ctx) {
+      expect_context_complete(finish_ctx, r);
+      extents[0].bl = data;
+      finish_ctx_ptr->complete(r);
+      EXPECT_EQ(r, finish_ctx.wait());
+    }
+    return false;
+  }
+
+  Context* start_write(MockReadCacheObjectDispatch& object_dispatch,
+                       uint64_t object_no, uint64_t off, uint64_t len,
+                       MockContext* finish_ctx) {
+    bufferlist data;
+    data.append(std::string(len, '2'));
+
+    io::DispatchResult dispatch_result;
+    MockContext dispatch_ctx;
+    Context* finish_ctx_ptr = finish_ctx;
+    EXPECT_FALSE(object_dispatch.write(object_no, off, std::move(data), {}, 0,
+                                       0, std::nullopt, {}, nullptr, nullptr,
+                                       &dispatch_result, &finish_ctx_ptr,
+                                       &dispatch_ctx));
+    EXPECT_NE(finish_ctx_ptr, finish_ctx);
+    return finish_ctx_ptr;
+  }
+
+  void finish_write(Context* ctx, MockContext* finish_ctx) {
+    expect_context_complete(*finish_ctx, 0);
+    ctx->complete(0);
+    ASSERT_EQ(0, finish_ctx->wait());
+  }
+};
+
+TEST_F(TestMockCacheReadCacheObjectDispatch, ReadHit) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockExclusiveLock mock_exclusive_lock;
+  mock_image_ctx.exclusive_lock = &mock_exclusive_lock;
+  expect_is_lock_owner(mock_exclusive_lock, true);
+
+  MockReadCacheObjectDispatch object_dispatch(&mock_image_ctx, "/tmp",
+                                              1 << 20);
+  init(mock_image_ctx, object_dispatch);
+
+  auto io_context = mock_image_ctx.get_data_io_context();
+  bufferlist data;
+  data.append(std::string(8192, '1'));
+
+  bufferlist out;
+  ASSERT_FALSE(read(object_dispatch, io_context, 0, 4096, 8192, 0, data,
+                    &out));
+  ASSERT_TRUE(read(object_dispatch, io_context, 0, 4096, 8192, 0, data,
+                   &out));
+  ASSERT_TRUE(data.contents_equal(out));
+
+  // partially covered blocks are served from the cache as well
+  ASSERT_TRUE(read(object_dispatch, io_context, 0, 5000, 100, 0, data,
+                   &out));
+  ASSERT_TRUE(out.contents_equal(std::string(100, '1').c_str(), 100));
+
+  // only cached blocks are served
+  ASSERT_FALSE(read(object_dispatch, io_context, 0, 0, 8192, -EIO, {},
+                    &out));
+  ASSERT_FALSE(read(object_dispatch, io_context, 1, 4096, 8192, -EIO, {},
+                    &out));
+
+  C_SaferCond ctx;
+  object_dispatch.shut_down(&ctx);
+  ASSERT_EQ(0, ctx.wait());
+}
+
+TEST_F(TestMockCacheReadCacheObjectDispatch, ReadSparse) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockExclusiveLock mock_exclusive_lock;
+  mock_image_ctx.exclusive_lock = &mock_exclusive_lock;
+  expect_is_lock_owner(mock_exclusive_lock, true);
+
+  MockReadCacheObjectDispatch object_dispatch(&mock_image_ctx, "/tmp",
+                                              1 << 20);
+  init(mock_image_ctx, object_dispatch);
+
+  auto io_context = mock_image_ctx.get_data_io_context();
+  bufferlist out;
+  ASSERT_FALSE(read(object_dispatch, io_context, 0, 0, 4096, -ENOENT, {},
+                    &out));
+  ASSERT_TRUE(read(object_dispatch, io_context, 0, 0, 4096, 0, {}, &out));
+  ASSERT_TRUE(out.is_zero());
+  ASSERT_EQ(4096U, out.length());
+}
+
+TEST_F(TestMockCacheReadCacheObjectDispatch, WriteInvalidates) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockExclusiveLock mock_exclusive_lock;
+  mock_image_ctx.exclusive_lock = &mock_exclusive_lock;
+  expect_is_lock_owner(mock_exclusive_lock, true);
+
+  MockReadCacheObjectDispatch object_dispatch(&mock_image_ctx, "/tmp",
+                                              1 << 20);
+  init(mock_image_ctx, object_dispatch);
+
+  auto io_context = mock_image_ctx.get_data_io_context();
+  bufferlist data;
+  data.append(std::string(8192, '1'));
+
+  bufferlist out;
+  ASSERT_FALSE(read(object_dispatch, io_context, 0, 0, 8192, 0, data, &out));
+
+  MockContext finish_ctx;
+  auto ctx = start_write(object_dispatch, 0, 4096, 512, &finish_ctx);
+  finish_write(ctx, &finish_ctx);
+
+  ASSERT_TRUE(read(object_dispatch, io_context, 0, 0, 4096, 0, {}, &out));
+  ASSERT_FALSE(read(object_dispatch, io_context, 0, 4096, 4096, -EIO, {},
+                    &out));
+}
+
+TEST_F(TestMockCacheReadCacheObjectDispatch, InFlightWriteBlocksInsert) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockExclusiveLock mock_exclusive_lock;
+  mock_image_ctx.exclusive_lock = &mock_exclusive_lock;
+  expect_is_lock_owner(mock_exclusive_lock, true);
+
+  MockReadCacheObjectDispatch object_dispatch(&mock_image_ctx, "/tmp",
+                                              1 << 20);
+  init(mock_image_ctx, object_dispatch);
+
+  auto io_context = mock_image_ctx.get_data_io_context();
+  bufferlist data;
+  data.append(std::string(4096, '1'));
+
+  // read starts before a write to the same object completes
+  io::ReadExtents extents = {{0, 4096}};
+  io::DispatchResult dispatch_result;
+  MockContext read_finish_ctx;
+  MockContext dispatch_ctx;
+  Context* read_finish_ctx_ptr = &read_finish_ctx;
+  ASSERT_FALSE(object_dispatch.read(0, &extents, io_context, 0, 0, {},
+                                    nullptr, nullptr, &dispatch_result,
+                                    &read_finish_ctx_ptr, &dispatch_ctx));
+
+  MockContext write_finish_ctx;
+  auto write_ctx = start_write(object_dispatch, 0, 8192, 512,
+                               &write_finish_ctx);
+  finish_write(write_ctx, &write_finish_ctx);
+
+  expect_context_complete(read_finish_ctx, 0);
+  extents[0].bl = data;
+  read_finish_ctx_ptr->complete(0);
+  ASSERT_EQ(0, read_finish_ctx.wait());
+
+  bufferlist out;
+  ASSERT_FALSE(read(object_dispatch, io_context, 0, 0, 4096, 0, data, &out));
+
+  // reads of other objects are not affected
+  MockContext write_finish_ctx2;
+  write_ctx = start_write(object_dispatch, 0, 0, 512, &write_finish_ctx2);
+  ASSERT_FALSE(read(object_dispatch, io_context, 0, 4096, 4096, 0, data,
+                    &out));
+  ASSERT_FALSE(read(object_dispatch, io_context, 0, 4096, 4096, -EIO, {},
+                    &out));
+  ASSERT_FALSE(read(object_dispatch, io_context, 1, 0, 4096, 0, data, &out));
+  ASSERT_TRUE(read(object_dispatch, io_context, 1, 0, 4096, 0, {}, &out));
+
+  finish_write(write_ctx, &write_finish_ctx2);
+}
+
+TEST_F(TestMockCacheReadCacheObjectDispatch, InvalidateCache) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockExclusiveLock mock_exclusive_lock;
+  mock_image_ctx.exclusive_lock = &mock_exclusive_lock;
+  expect_is_lock_owner(mock_exclusive_lock, true);
+
+  MockReadCacheObjectDispatch object_dispatch(&mock_image_ctx, "/tmp",
+                                              1 << 20);
+  init(mock_image_ctx, object_dispatch);
+
+  auto io_context = mock_image_ctx.get_data_io_context();
+  bufferlist data;
+  data.append(std::string(4096, '1'));
+
+  bufferlist out;
+  ASSERT_FALSE(read(object_dispatch, io_context, 0, 0, 4096, 0, data, &out));
+
+  // a read in flight during the invalidation is not inserted
+  io::ReadExtents extents = {{0, 4096}};
+  io::DispatchResult dispatch_result;
+  MockContext finish_ctx;
+  MockContext dispatch_ctx;
+  Context* finish_ctx_ptr = &finish_ctx;
+  ASSERT_FALSE(object_dispatch.read(1, &extents, io_context, 0, 0, {},
+                                    nullptr, nullptr, &dispatch_result,
+                                    &finish_ctx_ptr, &dispatch_ctx));
+
+  MockContext invalidate_ctx;
+  ASSERT_FALSE(object_dispatch.invalidate_cache(&invalidate_ctx));
+
+  expect_context_complete(finish_ctx, 0);
+  extents[0].bl = data;
+  finish_ctx_ptr->complete(0);
+  ASSERT_EQ(0, finish_ctx.wait());
+
+  ASSERT_FALSE(read(object_dispatch, io_context, 0, 0, 4096, -EIO, {}, &out));
+  ASSERT_FALSE(read(object_dispatch, io_context, 1, 0, 4096, -EIO, {}, &out));
+}
+
+TEST_F(TestMockCacheReadCacheObjectDispatch, NotLockOwner) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockExclusiveLock mock_exclusive_lock;
+  mock_image_ctx.exclusive_lock = &mock_exclusive_lock;
+  expect_is_lock_owner(mock_exclusive_lock, false);
+
+  MockReadCacheObjectDispatch object_dispatch(&mock_image_ctx, "/tmp",
+                                              1 << 20);
+  init(mock_image_ctx, object_dispatch);
+
+  io::ReadExtents extents = {{0, 4096}};
+  io::DispatchResult dispatch_result;
+  MockContext finish_ctx;
+  MockContext dispatch_ctx;
+  Context* finish_ctx_ptr = &finish_ctx;
+  ASSERT_FALSE(object_dispatch.read(0, &extents,
+                                    mock_image_ctx.get_data_io_context(), 0,
+                                    0, {}, nullptr, nullptr, &dispatch_result,
+                                    &finish_ctx_ptr, &dispatch_ctx));
+  ASSERT_EQ(finish_ctx_ptr, &finish_ctx);
+}
+
+TEST_F(TestMockCacheReadCacheObjectDispatch, SnapshotRead) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockReadCacheObjectDispatch object_dispatch(&mock_image_ctx, "/tmp",
+                                              1 << 20);
+  init(mock_image_ctx, object_dispatch);
+
+  auto io_context = mock_image_ctx.duplicate_data_io_context();
+  io_context->read_snap(123);
+
+  bufferlist data;
+  data.append(std::string(4096, '1'));
+
+  bufferlist out;
+  ASSERT_FALSE(read(object_dispatch, io_context, 0, 0, 4096, 0, data, &out));
+
+  // HEAD writes do not affect snapshot data
+  MockContext finish_ctx;
+  auto ctx = start_write(object_dispatch, 0, 0, 512, &finish_ctx);
+  finish_write(ctx, &finish_ctx);
+
+  ASSERT_TRUE(read(object_dispatch, io_context, 0, 0, 4096, 0, {}, &out));
+  ASSERT_TRUE(data.contents_equal(out));
+}
+
+TEST_F(TestMockCacheReadCacheObjectDispatch, Evict) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockExclusiveLock mock_exclusive_lock;
+  mock_image_ctx.exclusive_lock = &mock_exclusive_lock;
+  expect_is_lock_owner(mock_exclusive_lock, true);
+
+  MockReadCacheObjectDispatch object_dispatch(&mock_image_ctx, "/tmp",
+                                              2 * 4096);
+  init(mock_image_ctx, object_dispatch);
+
+  auto io_context = mock_image_ctx.get_data_io_context();
+  bufferlist data;
+  data.append(std::string(4096, '1'));
+
+  bufferlist out;
+  ASSERT_FALSE(read(object_dispatch, io_context, 0, 0, 4096, 0, data, &out));
+  ASSERT_FALSE(read(object_dispatch, io_context, 1, 0, 4096, 0, data, &out));
+
+  // the referenced block survives the next insert
+  ASSERT_TRUE(read(object_dispatch, io_context, 0, 0, 4096, 0, {}, &out));
+  ASSERT_FALSE(read(object_dispatch, io_context, 2, 0, 4096, 0, data, &out));
+
+  ASSERT_TRUE(read(object_dispatch, io_context, 0, 0, 4096, 0, {}, &out));
+  ASSERT_TRUE(read(object_dispatch, io_context, 2, 0, 4096, 0, {}, &out));
+  ASSERT_FALSE(read(object_dispatch, io_context, 1, 0, 4096, -EIO, {},
+                    &out));
+}
+
+} // namespace cache
+} // namespace librbd
@@ -0,0 +1,681 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <iostream>
+#include "common/hostname.h"
+#include "include/crc32c.h"
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "test/librbd/mock/MockImageCtx.h"
+#include "include/rbd/librbd.hpp"
+#include "librbd/cache/pwl/AbstractWriteLog.h"
+#include "librbd/cache/pwl/ImageCacheState.h"
+#include "librbd/cache/pwl/Types.h"
+#include "librbd/cache/ImageWriteback.h"
+
+
+namespace librbd {
+namespace {
+
+struct MockContextSSD : public C_SaferCond  {
+  MOCK_METHOD1(complete, void(int));
+  MOCK_METHOD1(finish, void(int));
+
+  void do_complete(int r) {
+    C_SaferCond::complete(r);
+  }
+};
+
+} // anonymous namespace
+
+namespace util {
+
+inline ImageCtx *get_image_ctx(MockImageCtx *image_ctx) {
+  return image_ctx->image_ctx;
+}
+
+} // namespace util
+} // namespace librbd
+
+#include "librbd/cache/pwl/AbstractWriteLog.cc"
+#include "librbd/cache/pwl/SSDWriteLog.cc"
+
+// template definitions
+#include "librbd/cache/ImageWriteback.cc"
+#include "librbd/cache/pwl/ImageCacheState.cc"
+#include "librbd/cache/pwl/Request.cc"
+
+namespace librbd {
+namespace cache {
+namespace pwl {
+
+using ::testing::_;
+using ::testing::DoDefault;
+using ::testing::InSequence;
+using ::testing::Invoke;
+
+struct TestMockCacheSSDWriteLog : public TestMockFixture {
+  typedef librbd::cache::pwl::SSDWriteLog<librbd::MockImageCtx> MockSSDWriteLog;
+  typedef librbd::cache::pwl::ImageCacheState<librbd::MockImageCtx> MockImageCacheStateSSD;
+
+  MockImageCacheStateSSD *get_cache_state(MockImageCtx& mock_image_ctx) {
+    MockImageCacheStateSSD *ssd_state = new MockImageCacheStateSSD(&mock_image_ctx);
+    ssd_state->cache_type = IMAGE_CACHE_TYPE_SSD;
+    return ssd_state;
+  }
+
+  void expect_op_work_queue(MockImageCtx& mock_image_ctx) {
+    EXPECT_CALL(*mock_image_ctx.op_work_queue, queue(_, _))
+      .WillRepeatedly(Invoke([](Context* ctx, int r) {
+                        ctx->complete(r);
+                      }));
+  }
+
+  void expect_context_complete(MockContextSSD& mock_context, int r) {
+    EXPECT_CALL(mock_context, complete(r))
+      .WillRepeatedly(Invoke([&mock_context](int r) {
+                        mock_context.do_complete(r);
+                      }));
+  }
+
+  void expect_metadata_set(MockImageCtx& mock_image_ctx) {
+    EXPECT_CALL(*mock_image_ctx.operations, execute_metadata_set(_, _, _))
+      .WillRepeatedly(Invoke([](std::string key, std::string val, Context* ctx) {
+                        ctx->complete(0);
+                      }));
+  }
+
+  /* An existing pool, small enough to make both rings wrap */
+  struct TestPool {
+    struct Write {
+      uint32_t entry_index;
+      uint64_t data_block;
+      uint64_t image_offset;
+      char fill;
+    };
+
+    uint32_t num_log_entries = 8 * SSD_LOG_ENTRIES_PER_BLOCK;
+    uint64_t data_blocks = 8;
+    uint64_t flushed_sync_gen = 0;
+    uint32_t first_valid_entry = 0;
+    uint32_t first_free_entry = 0;
+    uint64_t first_valid_data_block = 0;
+    uint64_t first_free_data_block = 0;
+    std::vector<Write> writes; /* All in sync gen 1 */
+
+    uint64_t data_pos(uint64_t data_block) const {
+      return SSD_BLOCK_SIZE + num_log_entries * sizeof(struct WriteLogPmemEntry) +
+        data_block * SSD_BLOCK_SIZE;
+    }
+  };
+
+  std::string get_pool_path(librbd::ImageCtx *ictx) {
+    return ictx->config.get_val<std::string>("rbd_rwl_path") +
+      "/rbd-pwl-test." + ictx->id + ".pool";
+  }
+
+  /* Writes the pool the way it's left if the cache isn't shut down */
+  void create_pool(const std::string &path, const TestPool &pool) {
+    bufferptr bp = buffer::create(pool.data_pos(pool.data_blocks));
+    bp.zero();
+
+    WriteLogSSDSuperblock superblock = {};
+    superblock.magic = SSD_SUPERBLOCK_MAGIC;
+    superblock.layout_version = SSD_LAYOUT_VERSION;
+    superblock.pool_size = bp.length();
+    superblock.flushed_sync_gen = pool.flushed_sync_gen;
+    superblock.first_valid_data = pool.data_pos(pool.first_valid_data_block);
+    superblock.first_free_data = pool.data_pos(pool.first_free_data_block);
+    superblock.block_size = SSD_BLOCK_SIZE;
+    superblock.num_log_entries = pool.num_log_entries;
+    superblock.first_free_entry = pool.first_free_entry;
+    superblock.first_valid_entry = pool.first_valid_entry;
+    superblock.crc = ceph_crc32c(0, (unsigned char *)&superblock,
+                                 offsetof(struct WriteLogSSDSuperblock, crc));
+    memcpy(bp.c_str(), &superblock, sizeof(superblock));
+
+    auto log_entries =
+      reinterpret_cast<struct WriteLogPmemEntry*>(bp.c_str() + SSD_BLOCK_SIZE);
+    uint64_t sequence_number = 1;
+    for (auto &write : pool.writes) {
+      WriteLogPmemEntry entry(write.image_offset, SSD_BLOCK_SIZE);
+      entry.sync_gen_number = 1;
+      entry.write_sequence_number = sequence_number++;
+      entry.entry_valid = 1;
+      entry.sequenced = 1;
+      entry.has_data = 1;
+      entry.write_data_pos = pool.data_pos(write.data_block);
+      entry.entry_index = write.entry_index;
+      WriteLogPmemEntry *pmem_entry = &log_entries[write.entry_index];
+      memcpy(pmem_entry, &entry, sizeof(entry));
+      pmem_entry->entry_crc = ceph_crc32c(0, (unsigned char *)pmem_entry,
+                                          offsetof(struct WriteLogPmemEntry, entry_crc));
+      memset(bp.c_str() + entry.write_data_pos, write.fill, SSD_BLOCK_SIZE);
+    }
+
+    bufferlist bl;
+    bl.append(bp);
+    ASSERT_EQ(0, bl.write_file(path.c_str(), 0600));
+  }
+
+  MockImageCacheStateSSD *get_cache_state(MockImageCtx& mock_image_ctx,
+                                          const std::string &path) {
+    MockImageCacheStateSSD *ssd_state = get_cache_state(mock_image_ctx);
+    ssd_state->present = true;
+    ssd_state->clean = false;
+    ssd_state->empty = false;
+    ssd_state->path = path;
+    return ssd_state;
+  }
+
+  /* The log entries of TestPool::writes that wrap around the end of
+   * both rings */
+  TestPool get_wrapped_pool() {
+    TestPool pool;
+    pool.first_valid_entry = pool.num_log_entries - 2;
+    pool.first_free_entry = SSD_LOG_ENTRIES_PER_BLOCK;
+    pool.first_valid_data_block = 6;
+    pool.first_free_data_block = 2;
+    pool.writes = {{pool.num_log_entries - 2, 6, 0, 'a'},
+                   {pool.num_log_entries - 1, 7, 4096, 'b'},
+                   {0, 0, 8192, 'c'},
+                   {1, 1, 12288, 'd'}};
+    return pool;
+  }
+};
+
+TEST_F(TestMockCacheSSDWriteLog, init_shutdown) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockSSDWriteLog ssd(mock_image_ctx, get_cache_state(mock_image_ctx));
+  MockContextSSD finish_ctx1;
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  ssd.shut_down(&finish_ctx2);
+  ASSERT_EQ(0, finish_ctx2.wait());
+}
+
+TEST_F(TestMockCacheSSDWriteLog, write) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockSSDWriteLog ssd(mock_image_ctx, get_cache_state(mock_image_ctx));
+
+  MockContextSSD finish_ctx1;
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  Extents image_extents{{0, 4096}};
+  bufferlist bl;
+  bl.append(std::string(4096, '1'));
+  int fadvise_flags = 0;
+  ssd.write(std::move(image_extents), std::move(bl), fadvise_flags, &finish_ctx2);
+  ASSERT_EQ(0, finish_ctx2.wait());
+
+  MockContextSSD finish_ctx3;
+  expect_context_complete(finish_ctx3, 0);
+  ssd.shut_down(&finish_ctx3);
+  ASSERT_EQ(0, finish_ctx3.wait());
+}
+
+TEST_F(TestMockCacheSSDWriteLog, flush) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockSSDWriteLog ssd(mock_image_ctx, get_cache_state(mock_image_ctx));
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  Extents image_extents{{0, 4096}};
+  bufferlist bl;
+  bl.append(std::string(4096, '1'));
+  bufferlist bl_copy = bl;
+  int fadvise_flags = 0;
+  ssd.write(std::move(image_extents), std::move(bl), fadvise_flags, &finish_ctx2);
+  ASSERT_EQ(0, finish_ctx2.wait());
+
+  MockContextSSD finish_ctx_flush;
+  expect_context_complete(finish_ctx_flush, 0);
+  ssd.flush(&finish_ctx_flush);
+  ASSERT_EQ(0, finish_ctx_flush.wait());
+
+  MockContextSSD finish_ctx3;
+  expect_context_complete(finish_ctx3, 0);
+  ssd.shut_down(&finish_ctx3);
+
+  ASSERT_EQ(0, finish_ctx3.wait());
+}
+
+TEST_F(TestMockCacheSSDWriteLog, read_hit_ssd_cache) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockSSDWriteLog ssd(mock_image_ctx, get_cache_state(mock_image_ctx));
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  Extents image_extents{{0, 4096}};
+  bufferlist bl;
+  bl.append(std::string(4096, '1'));
+  bufferlist bl_copy = bl;
+  int fadvise_flags = 0;
+  ssd.write(std::move(image_extents), std::move(bl), fadvise_flags, &finish_ctx2);
+  ASSERT_EQ(0, finish_ctx2.wait());
+
+  MockContextSSD finish_ctx_read;
+  expect_context_complete(finish_ctx_read, 0);
+  Extents image_extents_read{{0, 4096}};
+  bufferlist read_bl;
+  ssd.read(std::move(image_extents_read), &read_bl, fadvise_flags, &finish_ctx_read);
+  ASSERT_EQ(0, finish_ctx_read.wait());
+  ASSERT_EQ(4096, read_bl.length());
+  ASSERT_TRUE(bl_copy.contents_equal(read_bl));
+
+  MockContextSSD finish_ctx3;
+  expect_context_complete(finish_ctx3, 0);
+  ssd.shut_down(&finish_ctx3);
+  ASSERT_EQ(0, finish_ctx3.wait());
+}
+
+TEST_F(TestMockCacheSSDWriteLog, read_hit_part_ssd_cache) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockSSDWriteLog ssd(mock_image_ctx, get_cache_state(mock_image_ctx));
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  Extents image_extents{{0, 4096}};
+  bufferlist bl;
+  bl.append(std::string(4096, '1'));
+  bufferlist bl_copy = bl;
+  int fadvise_flags = 0;
+  ssd.write(std::move(image_extents), std::move(bl), fadvise_flags, &finish_ctx2);
+  ASSERT_EQ(0, finish_ctx2.wait());
+
+  MockContextSSD finish_ctx_read;
+  Extents image_extents_read{{512, 4096}};
+  bufferlist hit_bl;
+  bl_copy.begin(511).copy(4096-512, hit_bl);
+  expect_context_complete(finish_ctx_read, 512);
+  bufferlist read_bl;
+  ssd.read(std::move(image_extents_read), &read_bl, fadvise_flags, &finish_ctx_read);
+  ASSERT_EQ(512, finish_ctx_read.wait());
+  ASSERT_EQ(4096, read_bl.length());
+  bufferlist read_bl_hit;
+  read_bl.begin(0).copy(4096-512, read_bl_hit);
+  ASSERT_TRUE(hit_bl.contents_equal(read_bl_hit));
+
+  MockContextSSD finish_ctx3;
+  expect_context_complete(finish_ctx3, 0);
+  ssd.shut_down(&finish_ctx3);
+  ASSERT_EQ(0, finish_ctx3.wait());
+}
+
+TEST_F(TestMockCacheSSDWriteLog, discard) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockSSDWriteLog ssd(mock_image_ctx, get_cache_state(mock_image_ctx));
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  Extents image_extents{{0, 4096}};
+  bufferlist bl;
+  bl.append(std::string(4096, '1'));
+  bufferlist bl_copy = bl;
+  int fadvise_flags = 0;
+  ssd.write(std::move(image_extents), std::move(bl), fadvise_flags, &finish_ctx2);
+  ASSERT_EQ(0, finish_ctx2.wait());
+
+  MockContextSSD finish_ctx_discard;
+  expect_context_complete(finish_ctx_discard, 0);
+  ssd.discard(0, 4096, 1, &finish_ctx_discard);
+  ASSERT_EQ(0, finish_ctx_discard.wait());
+
+  MockContextSSD finish_ctx_read;
+  bufferlist read_bl;
+  expect_context_complete(finish_ctx_read, 0);
+  ssd.read({{0, 4096}}, &read_bl, fadvise_flags, &finish_ctx_read);
+  ASSERT_EQ(0, finish_ctx_read.wait());
+  ASSERT_EQ(4096, read_bl.length());
+  ASSERT_TRUE(read_bl.is_zero());
+
+  MockContextSSD finish_ctx3;
+  expect_context_complete(finish_ctx3, 0);
+  ssd.shut_down(&finish_ctx3);
+
+  ASSERT_EQ(0, finish_ctx3.wait());
+}
+
+TEST_F(TestMockCacheSSDWriteLog, writesame) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockSSDWriteLog ssd(mock_image_ctx, get_cache_state(mock_image_ctx));
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  bufferlist bl, test_bl;
+  bl.append(std::string(512, '1'));
+  test_bl.append(std::string(4096, '1'));
+  int fadvise_flags = 0;
+  ssd.writesame(0, 4096, std::move(bl), fadvise_flags, &finish_ctx2);
+  ASSERT_EQ(0, finish_ctx2.wait());
+
+  MockContextSSD finish_ctx_read;
+  bufferlist read_bl;
+  expect_context_complete(finish_ctx_read, 0);
+  ssd.read({{0, 4096}}, &read_bl, fadvise_flags, &finish_ctx_read);
+  ASSERT_EQ(0, finish_ctx_read.wait());
+  ASSERT_EQ(4096, read_bl.length());
+  ASSERT_TRUE(test_bl.contents_equal(read_bl));
+
+  MockContextSSD finish_ctx3;
+  expect_context_complete(finish_ctx3, 0);
+  ssd.shut_down(&finish_ctx3);
+
+  ASSERT_EQ(0, finish_ctx3.wait());
+}
+
+TEST_F(TestMockCacheSSDWriteLog, compare_and_write_compare_matched) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockSSDWriteLog ssd(mock_image_ctx, get_cache_state(mock_image_ctx));
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  Extents image_extents{{0, 4096}};
+  bufferlist bl1;
+  bl1.append(std::string(4096, '1'));
+  bufferlist com_bl = bl1;
+  int fadvise_flags = 0;
+  ssd.write(std::move(image_extents), std::move(bl1), fadvise_flags, &finish_ctx2);
+  ASSERT_EQ(0, finish_ctx2.wait());
+
+  MockContextSSD finish_ctx_cw;
+  bufferlist bl2;
+  bl2.append(std::string(4096, '2'));
+  bufferlist bl2_copy = bl2;
+  uint64_t mismatch_offset = -1;
+  expect_context_complete(finish_ctx_cw, 0);
+  ssd.compare_and_write({{0, 4096}}, std::move(com_bl), std::move(bl2),
+                            &mismatch_offset, fadvise_flags, &finish_ctx_cw);
+  ASSERT_EQ(0, finish_ctx_cw.wait());
+  ASSERT_EQ(0, mismatch_offset);
+
+  MockContextSSD finish_ctx_read;
+  bufferlist read_bl;
+  expect_context_complete(finish_ctx_read, 0);
+  ssd.read({{0, 4096}}, &read_bl, fadvise_flags, &finish_ctx_read);
+  ASSERT_EQ(0, finish_ctx_read.wait());
+  ASSERT_EQ(4096, read_bl.length());
+  ASSERT_TRUE(bl2_copy.contents_equal(read_bl));
+
+  MockContextSSD finish_ctx3;
+  expect_context_complete(finish_ctx3, 0);
+  ssd.shut_down(&finish_ctx3);
+
+  ASSERT_EQ(0, finish_ctx3.wait());
+}
+
+TEST_F(TestMockCacheSSDWriteLog, load_existing_entries) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+  std::string path = get_pool_path(ictx);
+  create_pool(path, get_wrapped_pool());
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockSSDWriteLog ssd(mock_image_ctx, get_cache_state(mock_image_ctx, path));
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  MockContextSSD finish_ctx_read;
+  expect_context_complete(finish_ctx_read, 0);
+  bufferlist read_bl;
+  int fadvise_flags = 0;
+  ssd.read({{0, 16384}}, &read_bl, fadvise_flags, &finish_ctx_read);
+  ASSERT_EQ(0, finish_ctx_read.wait());
+  bufferlist expected_bl;
+  expected_bl.append(std::string(4096, 'a'));
+  expected_bl.append(std::string(4096, 'b'));
+  expected_bl.append(std::string(4096, 'c'));
+  expected_bl.append(std::string(4096, 'd'));
+  ASSERT_TRUE(expected_bl.contents_equal(read_bl));
+
+  /* Appends after the loaded entries */
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  bufferlist bl;
+  bl.append(std::string(4096, 'e'));
+  bufferlist bl_copy = bl;
+  ssd.write({{16384, 4096}}, std::move(bl), fadvise_flags, &finish_ctx2);
+  ASSERT_EQ(0, finish_ctx2.wait());
+
+  MockContextSSD finish_ctx_read2;
+  expect_context_complete(finish_ctx_read2, 0);
+  bufferlist read_bl2;
+  ssd.read({{16384, 4096}}, &read_bl2, fadvise_flags, &finish_ctx_read2);
+  ASSERT_EQ(0, finish_ctx_read2.wait());
+  ASSERT_TRUE(bl_copy.contents_equal(read_bl2));
+
+  MockContextSSD finish_ctx3;
+  expect_context_complete(finish_ctx3, 0);
+  ssd.shut_down(&finish_ctx3);
+  ASSERT_EQ(0, finish_ctx3.wait());
+}
+
+TEST_F(TestMockCacheSSDWriteLog, load_corrupt_entry) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+  std::string path = get_pool_path(ictx);
+  TestPool pool = get_wrapped_pool();
+  create_pool(path, pool);
+
+  /* Torn write of the block holding entry 0 */
+  bufferlist bl;
+  std::string err;
+  ASSERT_EQ(0, bl.read_file(path.c_str(), &err));
+  bl.c_str()[SSD_BLOCK_SIZE + offsetof(struct WriteLogPmemEntry, image_offset_bytes)] ^= 1;
+  ASSERT_EQ(0, bl.write_file(path.c_str(), 0600));
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockSSDWriteLog ssd(mock_image_ctx, get_cache_state(mock_image_ctx, path));
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, -EIO);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(-EIO, finish_ctx1.wait());
+  ASSERT_EQ(0, ::remove(path.c_str()));
+}
+
+TEST_F(TestMockCacheSSDWriteLog, load_data_outside_ring) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+  std::string path = get_pool_path(ictx);
+  TestPool pool = get_wrapped_pool();
+  /* Entry 1 has its payload at the head of the data ring */
+  pool.first_free_data_block = 1;
+  create_pool(path, pool);
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockSSDWriteLog ssd(mock_image_ctx, get_cache_state(mock_image_ctx, path));
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, -EIO);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(-EIO, finish_ctx1.wait());
+  ASSERT_EQ(0, ::remove(path.c_str()));
+}
+
+TEST_F(TestMockCacheSSDWriteLog, ring_wraparound) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+  std::string path = get_pool_path(ictx);
+  TestPool pool;
+  pool.data_blocks = 16;
+  create_pool(path, pool);
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockSSDWriteLog ssd(mock_image_ctx, get_cache_state(mock_image_ctx, path));
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  /* Each write takes a block of log entries, and a block of data. This
+   * goes around the log entry ring 5 times, and the data ring 3 times. */
+  int fadvise_flags = 0;
+  for (int i = 0; i < 40; i++) {
+    MockContextSSD finish_ctx_write;
+    expect_context_complete(finish_ctx_write, 0);
+    bufferlist bl;
+    bl.append(std::string(4096, 'a' + i % 26));
+    ssd.write({{(i % 10) * 4096u, 4096}}, std::move(bl), fadvise_flags,
+              &finish_ctx_write);
+    ASSERT_EQ(0, finish_ctx_write.wait());
+  }
+
+  MockContextSSD finish_ctx_read;
+  expect_context_complete(finish_ctx_read, 0);
+  bufferlist read_bl;
+  ssd.read({{0, 40960}}, &read_bl, fadvise_flags, &finish_ctx_read);
+  ASSERT_EQ(0, finish_ctx_read.wait());
+  bufferlist expected_bl;
+  for (int i = 30; i < 40; i++) {
+    expected_bl.append(std::string(4096, 'a' + i % 26));
+  }
+  ASSERT_TRUE(expected_bl.contents_equal(read_bl));
+
+  MockContextSSD finish_ctx3;
+  expect_context_complete(finish_ctx3, 0);
+  ssd.shut_down(&finish_ctx3);
+  ASSERT_EQ(0, finish_ctx3.wait());
+}
+
+TEST_F(TestMockCacheSSDWriteLog, data_ring_full) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+  std::string path = get_pool_path(ictx);
+  /* A single, flushed, entry keeps the tail of the data ring just after
+   * its head: the payloads after it were retired, but the ring is full */
+  TestPool pool;
+  pool.flushed_sync_gen = 1;
+  pool.first_free_entry = SSD_LOG_ENTRIES_PER_BLOCK;
+  pool.first_valid_data_block = 1;
+  pool.first_free_data_block = 0;
+  pool.writes = {{0, 1, 0, 'a'}};
+  create_pool(path, pool);
+
+  MockImageCtx mock_image_ctx(*ictx);
+  MockSSDWriteLog ssd(mock_image_ctx, get_cache_state(mock_image_ctx, path));
+  expect_op_work_queue(mock_image_ctx);
+  expect_metadata_set(mock_image_ctx);
+
+  MockContextSSD finish_ctx1;
+  expect_context_complete(finish_ctx1, 0);
+  ssd.init(&finish_ctx1);
+  ASSERT_EQ(0, finish_ctx1.wait());
+
+  /* Waits for the entry to be retired */
+  MockContextSSD finish_ctx2;
+  expect_context_complete(finish_ctx2, 0);
+  bufferlist bl;
+  bl.append(std::string(4096, 'b'));
+  bufferlist bl_copy = bl;
+  int fadvise_flags = 0;
+  ssd.write({{4096, 4096}}, std::move(bl), fadvise_flags, &finish_ctx2);
+  ASSERT_EQ(0, finish_ctx2.wait());
+
+  MockContextSSD finish_ctx_read;
+  expect_context_complete(finish_ctx_read, 0);
+  bufferlist read_bl;
+  ssd.read({{4096, 4096}}, &read_bl, fadvise_flags, &finish_ctx_read);
+  ASSERT_EQ(0, finish_ctx_read.wait());
+  ASSERT_TRUE(bl_copy.contents_equal(read_bl));
+
+  MockContextSSD finish_ctx3;
+  expect_context_complete(finish_ctx3, 0);
+  ssd.shut_down(&finish_ctx3);
+  ASSERT_EQ(0, finish_ctx3.wait());
+}
+
+} // namespace pwl
+} // namespace cache
+} // namespace librbd
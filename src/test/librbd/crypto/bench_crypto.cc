@@ -0,0 +1,212 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "common/ceph_argparse.h"
+#include "common/debug.h"
+#include "common/strtol.h"
+#include "global/global_init.h"
+#include "include/buffer.h"
+#include "librbd/crypto/BlockCrypto.h"
+#include "librbd/crypto/CryptoContextPool.h"
+#include "librbd/crypto/openssl/DataCryptor.h"
+
+#include "librbd/crypto/BlockCrypto.cc"
+#include "librbd/crypto/CryptoContextPool.cc"
+
+#define dout_context g_ceph_context
+#define dout_subsys ceph_subsys_rbd
+
+using namespace librbd::crypto;
+
+static void usage()
+{
+  std::cout << "usage: ceph_bench_librbd_crypto [flags]\n"
+      "	 --cipher\n"
+      "	       OpenSSL cipher name (default aes-256-xts)\n"
+      "	 --io-size\n"
+      "	       bytes encrypted / decrypted per call (default 4M)\n"
+      "	 --block-size\n"
+      "	       crypto block (sector) size in bytes (default 4K)\n"
+      "	 --total\n"
+      "	       total bytes processed per thread and direction "
+      "(default 1G)\n"
+      "	 --threads\n"
+      "	       number of threads sharing the crypto object (default 1)\n"
+      "	 --pool-size\n"
+      "	       number of cached cipher contexts per mode (default 32)\n"
+      "	 --fragments\n"
+      "	       number of buffers each request is split into (default 1)\n"
+      << std::endl;
+  generic_client_usage();
+}
+
+struct Config {
+  std::string cipher = "aes-256-xts";
+  uint64_t io_size = 4 << 20;
+  uint32_t block_size = 4096;
+  uint64_t total = 1ULL << 30;
+  uint32_t threads = 1;
+  uint32_t pool_size = 32;
+  uint32_t fragments = 1;
+};
+
+typedef BlockCrypto<EVP_CIPHER_CTX> OpenSSLBlockCrypto;
+
+static ceph::bufferlist build_request(const Config& cfg) {
+  ceph::bufferlist bl;
+  auto fragment_size = cfg.io_size / cfg.fragments;
+  for (uint32_t i = 0; i < cfg.fragments; ++i) {
+    auto length = (i + 1 == cfg.fragments ?
+                     cfg.io_size - fragment_size * i : fragment_size);
+    ceph::bufferptr bp(ceph::buffer::create(length));
+    memset(bp.c_str(), 'a' + i, length);
+    bl.push_back(std::move(bp));
+  }
+  return bl;
+}
+
+static double run(const Config& cfg, OpenSSLBlockCrypto* crypto,
+                  CipherMode mode) {
+  std::atomic<int> result = {0};
+  std::vector<std::thread> threads;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t t = 0; t < cfg.threads; ++t) {
+    threads.emplace_back([&cfg, crypto, mode, t, &result]() {
+        auto src = build_request(cfg);
+        uint64_t image_offset = t * cfg.total;
+        for (uint64_t done = 0; done < cfg.total; done += cfg.io_size) {
+          // decrypt works in place: start from a private copy each time
+          ceph::bufferlist bl;
+          if (mode == CIPHER_MODE_ENC) {
+            bl = src;
+          } else {
+            bl.append(src.c_str(), src.length());
+          }
+
+          int r = (mode == CIPHER_MODE_ENC ?
+                     crypto->encrypt(&bl, image_offset + done) :
+                     crypto->decrypt(&bl, image_offset + done));
+          if (r < 0) {
+            result = r;
+            return;
+          }
+        }
+      });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (result < 0) {
+    return -1;
+  }
+
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+  return (cfg.total * cfg.threads) / elapsed.count() / (1 << 20);
+}
+
+int main(int argc, const char **argv)
+{
+  Config cfg;
+
+  std::vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  if (ceph_argparse_need_usage(args)) {
+    usage();
+    exit(0);
+  }
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_CLIENT,
+                         CODE_ENVIRONMENT_UTILITY,
+                         CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+
+  std::string val;
+  auto i = args.begin();
+  while (i != args.end()) {
+    std::string err;
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_witharg(args, i, &val, "--cipher",
+                                     (char*)nullptr)) {
+      cfg.cipher = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--io-size",
+                                     (char*)nullptr)) {
+      cfg.io_size = strict_iecstrtoll(val.c_str(), &err);
+    } else if (ceph_argparse_witharg(args, i, &val, "--block-size",
+                                     (char*)nullptr)) {
+      cfg.block_size = strict_iecstrtoll(val.c_str(), &err);
+    } else if (ceph_argparse_witharg(args, i, &val, "--total",
+                                     (char*)nullptr)) {
+      cfg.total = strict_iecstrtoll(val.c_str(), &err);
+    } else if (ceph_argparse_witharg(args, i, &val, "--threads",
+                                     (char*)nullptr)) {
+      cfg.threads = strict_strtol(val.c_str(), 10, &err);
+    } else if (ceph_argparse_witharg(args, i, &val, "--pool-size",
+                                     (char*)nullptr)) {
+      cfg.pool_size = strict_strtol(val.c_str(), 10, &err);
+    } else if (ceph_argparse_witharg(args, i, &val, "--fragments",
+                                     (char*)nullptr)) {
+      cfg.fragments = strict_strtol(val.c_str(), 10, &err);
+    } else {
+      derr << "error: can't understand argument: " << *i << dendl;
+      exit(1);
+    }
+
+    if (!err.empty()) {
+      derr << "error parsing '" << val << "': " << err << dendl;
+      exit(1);
+    }
+  }
+
+  common_init_finish(g_ceph_context);
+
+  if (cfg.block_size == 0 || cfg.io_size == 0 || cfg.threads == 0 ||
+      cfg.fragments == 0 || cfg.io_size % cfg.block_size != 0 ||
+      cfg.total % cfg.io_size != 0) {
+    derr << "io-size must be a multiple of block-size and total a multiple "
+         << "of io-size" << dendl;
+    exit(1);
+  }
+
+  openssl::DataCryptor data_cryptor(g_ceph_context);
+  std::vector<unsigned char> key(64, 0x5a);
+  auto cipher = EVP_get_cipherbyname(cfg.cipher.c_str());
+  if (cipher == nullptr) {
+    derr << "unknown cipher: " << cfg.cipher << dendl;
+    exit(1);
+  }
+  int r = data_cryptor.init(cfg.cipher.c_str(), key.data(),
+                            EVP_CIPHER_key_length(cipher));
+  if (r < 0) {
+    exit(1);
+  }
+
+  CryptoContextPool<EVP_CIPHER_CTX> pool(&data_cryptor, cfg.pool_size);
+  auto crypto = new OpenSSLBlockCrypto(g_ceph_context, &pool,
+                                       cfg.block_size);
+
+  std::cout << "cipher " << cfg.cipher << ", io-size " << cfg.io_size
+            << ", block-size " << cfg.block_size << ", threads "
+            << cfg.threads << ", fragments " << cfg.fragments << std::endl;
+
+  auto encrypt_mbps = run(cfg, crypto, CIPHER_MODE_ENC);
+  auto decrypt_mbps = run(cfg, crypto, CIPHER_MODE_DEC);
+  crypto->put();
+
+  if (encrypt_mbps < 0 || decrypt_mbps < 0) {
+    derr << "crypto operation failed" << dendl;
+    exit(1);
+  }
+
+  std::cout << "encrypt: " << encrypt_mbps << " MiB/s" << std::endl;
+  std::cout << "decrypt: " << decrypt_mbps << " MiB/s" << std::endl;
+  return 0;
+}
@@ -11,6 +11,7 @@ template class librbd::crypto::BlockCrypto<
 
 using ::testing::ExpectationSet;
 using ::testing::internal::ExpectationBase;
+using ::testing::Invoke;
 using ::testing::Return;
 using ::testing::_;
 
@@ -88,13 +89,12 @@ TEST_F(TestMockBlockCrypto, Encrypt) {
   data.claim_append(data2);
   data.claim_append(data3);
 
+  // blocks straddling buffers are gathered into whole blocks
   expect_get_context(CipherMode::CIPHER_MODE_ENC);
   expect_init_context(std::string("\x34\x12\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 16));
-  expect_update_context("123", 0);
-  expect_update_context("4", 4);
+  expect_update_context("1234", 4);
   expect_init_context(std::string("\x35\x12\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 16));
-  expect_update_context("56", 0);
-  expect_update_context("78", 4);
+  expect_update_context("5678", 4);
   EXPECT_CALL(cryptor, return_context(_, CipherMode::CIPHER_MODE_ENC));
 
   ASSERT_EQ(0, bc->encrypt(&data, image_offset));
@@ -103,6 +103,56 @@ TEST_F(TestMockBlockCrypto, Encrypt) {
   ASSERT_TRUE(data.is_aligned(block_size));
 }
 
+TEST_F(TestMockBlockCrypto, EncryptDoesNotModifyInput) {
+  ceph::bufferlist src;
+  src.append("12345678");
+  ceph::bufferlist data = src;
+
+  expect_get_context(CipherMode::CIPHER_MODE_ENC);
+  expect_init_context(std::string("\x01\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 16));
+  _set_last_expectation(
+          EXPECT_CALL(cryptor, update_context(_, _, _, block_size))
+          .After(*expectation_set).WillOnce(Invoke(
+            [](MockCryptoContext*, const unsigned char* in,
+                   unsigned char* out, uint32_t len) {
+              memset(out, 'x', len);
+              return len;
+            })));
+  expect_init_context(std::string("\x02\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 16));
+  expect_update_context("5678", 4);
+  EXPECT_CALL(cryptor, return_context(_, CipherMode::CIPHER_MODE_ENC));
+
+  ASSERT_EQ(0, bc->encrypt(&data, block_size));
+  ASSERT_EQ("12345678", src.to_str());
+  ASSERT_EQ('x', data[0]);
+}
+
+TEST_F(TestMockBlockCrypto, DecryptInPlace) {
+  ceph::bufferlist data;
+  data.append("12345678");
+  auto buf = data.c_str();
+
+  expect_get_context(CipherMode::CIPHER_MODE_DEC);
+  expect_init_context(std::string("\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 16));
+  _set_last_expectation(
+          EXPECT_CALL(cryptor, update_context(_, CompareArrayToString(
+                                                   std::string("1234")),
+                                              _, block_size))
+          .After(*expectation_set).WillOnce(Invoke(
+            [buf](MockCryptoContext*, const unsigned char* in,
+                  unsigned char* out, uint32_t len) {
+              EXPECT_EQ(reinterpret_cast<unsigned char*>(buf), out);
+              EXPECT_EQ(in, out);
+              return len;
+            })));
+  expect_init_context(std::string("\x01\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 16));
+  expect_update_context("5678", 4);
+  EXPECT_CALL(cryptor, return_context(_, CipherMode::CIPHER_MODE_DEC));
+
+  ASSERT_EQ(0, bc->decrypt(&data, 0));
+  ASSERT_EQ(buf, data.c_str());
+}
+
 TEST_F(TestMockBlockCrypto, UnalignedImageOffset) {
   ceph::bufferlist data;
   data.append("1234");
@@ -128,6 +178,7 @@ TEST_F(TestMockBlockCrypto, InitContextError) {
   data.append("1234");
   expect_get_context(CipherMode::CIPHER_MODE_ENC);
   EXPECT_CALL(cryptor, init_context(_, _, _)).WillOnce(Return(-123));
+  EXPECT_CALL(cryptor, return_context(_, CipherMode::CIPHER_MODE_ENC));
   ASSERT_EQ(-123, bc->encrypt(&data, 0));
 }
 
@@ -137,6 +188,7 @@ TEST_F(TestMockBlockCrypto, UpdateContextError) {
   expect_get_context(CipherMode::CIPHER_MODE_ENC);
   EXPECT_CALL(cryptor, init_context(_, _, _));
   EXPECT_CALL(cryptor, update_context(_, _, _, _)).WillOnce(Return(-123));
+  EXPECT_CALL(cryptor, return_context(_, CipherMode::CIPHER_MODE_ENC));
   ASSERT_EQ(-123, bc->encrypt(&data, 0));
 }
 
@@ -23,9 +23,22 @@ struct MockTestImageCtx : public MockImageCtx {
 
 namespace io {
 
+// the write inter-arrival time is measured with this clock. it stays at
+// the epoch unless a test moves it, which disables the adaptive delay
+struct MockClock {
+  typedef ceph::real_clock::time_point time_point;
+  static time_point s_now;
+  static time_point now() {
+    return s_now;
+  }
+};
+
+MockClock::time_point MockClock::s_now;
+
 template <>
 struct TypeTraits<MockTestImageCtx> {
   typedef ::MockSafeTimer SafeTimer;
+  typedef MockClock Clock;
 };
 
 template <>
@@ -70,6 +83,7 @@ struct TestMockIoSimpleSchedulerObjectDispatch : public TestMockFixture {
   TestMockIoSimpleSchedulerObjectDispatch() {
     MockTestImageCtx::set_timer_instance(&m_mock_timer, &m_mock_timer_lock);
     EXPECT_EQ(0, _rados.conf_set("rbd_io_scheduler_simple_max_delay", "1"));
+    MockClock::s_now = {};
   }
 
   void expect_get_object_name(MockTestImageCtx &mock_image_ctx,
@@ -819,5 +833,204 @@ TEST_F(TestMockIoSimpleSchedulerObjectDispatch, Timer) {
   ASSERT_EQ(0, cond2.wait());
 }
 
+TEST_F(TestMockIoSimpleSchedulerObjectDispatch, WriteSparse) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockSimpleSchedulerObjectDispatch
+      mock_simple_scheduler_object_dispatch(&mock_image_ctx);
+
+  expect_get_object_name(mock_image_ctx, 0);
+
+  InSequence seq;
+
+  MockClock::s_now = MockClock::time_point(std::chrono::seconds(1));
+
+  ceph::bufferlist data;
+  data.append("X");
+  int object_dispatch_flags = 0;
+  C_SaferCond cond1;
+  Context *on_finish1 = &cond1;
+  ASSERT_FALSE(mock_simple_scheduler_object_dispatch.write(
+      0, 0, std::move(data), mock_image_ctx.get_data_io_context(), 0, 0,
+      std::nullopt, {}, &object_dispatch_flags, nullptr, nullptr, &on_finish1,
+      nullptr));
+  ASSERT_NE(on_finish1, &cond1);
+
+  // writes arriving further apart than the max delay are not delayed
+  MockClock::s_now += std::chrono::milliseconds(5);
+
+  data.clear();
+  data.append("X");
+  io::DispatchResult dispatch_result;
+  C_SaferCond cond2;
+  Context *on_finish2 = &cond2;
+  ASSERT_FALSE(mock_simple_scheduler_object_dispatch.write(
+      0, 1, std::move(data), mock_image_ctx.get_data_io_context(), 0, 0,
+      std::nullopt, {}, &object_dispatch_flags, nullptr, &dispatch_result,
+      &on_finish2, nullptr));
+  ASSERT_NE(on_finish2, &cond2);
+
+  on_finish1->complete(0);
+  ASSERT_EQ(0, cond1.wait());
+  on_finish2->complete(0);
+  ASSERT_EQ(0, cond2.wait());
+}
+
+TEST_F(TestMockIoSimpleSchedulerObjectDispatch, WriteAdaptiveDelay) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockSimpleSchedulerObjectDispatch
+      mock_simple_scheduler_object_dispatch(&mock_image_ctx);
+
+  expect_get_object_name(mock_image_ctx, 0);
+
+  InSequence seq;
+
+  MockClock::s_now = MockClock::time_point(std::chrono::seconds(1));
+
+  ceph::bufferlist data;
+  data.append("X");
+  int object_dispatch_flags = 0;
+  C_SaferCond cond1;
+  Context *on_finish1 = &cond1;
+  ASSERT_FALSE(mock_simple_scheduler_object_dispatch.write(
+      0, 0, std::move(data), mock_image_ctx.get_data_io_context(), 0, 0,
+      std::nullopt, {}, &object_dispatch_flags, nullptr, nullptr, &on_finish1,
+      nullptr));
+  ASSERT_NE(on_finish1, &cond1);
+
+  // writes 100us apart wait for four inter-arrival times instead of the
+  // 1ms max delay
+  MockClock::s_now += std::chrono::microseconds(100);
+
+  Context *timer_task = nullptr;
+  ceph::real_clock::time_point dispatch_time;
+  EXPECT_CALL(m_mock_timer, add_event_at(_, _))
+    .WillOnce(Invoke([&timer_task, &dispatch_time](
+                         ceph::real_clock::time_point t, Context *task) {
+                dispatch_time = t;
+                timer_task = task;
+                return task;
+              }));
+
+  data.clear();
+  data.append("X");
+  io::DispatchResult dispatch_result;
+  C_SaferCond cond2;
+  Context *on_finish2 = &cond2;
+  C_SaferCond on_dispatched;
+  ASSERT_TRUE(mock_simple_scheduler_object_dispatch.write(
+      0, 1, std::move(data), mock_image_ctx.get_data_io_context(), 0, 0,
+      std::nullopt, {}, &object_dispatch_flags, nullptr, &dispatch_result,
+      &on_finish2, &on_dispatched));
+  ASSERT_EQ(dispatch_result, io::DISPATCH_RESULT_COMPLETE);
+  ASSERT_NE(on_finish2, &cond2);
+  ASSERT_NE(timer_task, nullptr);
+  ASSERT_EQ(MockClock::s_now + std::chrono::microseconds(400), dispatch_time);
+
+  expect_dispatch_delayed_requests(mock_image_ctx, 0);
+  expect_schedule_dispatch_delayed_requests(timer_task, nullptr);
+
+  on_finish1->complete(0);
+  ASSERT_EQ(0, cond1.wait());
+  ASSERT_EQ(0, on_dispatched.wait());
+  on_finish2->complete(0);
+  ASSERT_EQ(0, cond2.wait());
+}
+
+TEST_F(TestMockIoSimpleSchedulerObjectDispatch, TimerDueObjects) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  MockSimpleSchedulerObjectDispatch
+      mock_simple_scheduler_object_dispatch(&mock_image_ctx);
+
+  expect_get_object_name(mock_image_ctx, 0);
+  expect_get_object_name(mock_image_ctx, 1);
+  expect_get_object_name(mock_image_ctx, 2);
+  expect_op_work_queue(mock_image_ctx);
+
+  InSequence seq;
+
+  // in-flight and delayed writes to objects 0, 1 and 2, 200us apart: the
+  // delayed writes wait 800us and are due at 1000us, 1400us and 1800us
+  auto start = MockClock::time_point(std::chrono::seconds(1));
+  ceph::bufferlist data;
+  int object_dispatch_flags = 0;
+  io::DispatchResult dispatch_result;
+  Context *timer_task = nullptr;
+  C_SaferCond cond[6];
+  Context *on_finish[6];
+  C_SaferCond on_dispatched[3];
+  for (uint64_t object_no = 0; object_no < 3; ++object_no) {
+    MockClock::s_now = start + std::chrono::microseconds(400 * object_no);
+    data.clear();
+    on_finish[object_no * 2] = &cond[object_no * 2];
+    ASSERT_FALSE(mock_simple_scheduler_object_dispatch.write(
+        object_no, 0, std::move(data), mock_image_ctx.get_data_io_context(),
+        0, 0, std::nullopt, {}, &object_dispatch_flags, nullptr, nullptr,
+        &on_finish[object_no * 2], nullptr));
+
+    if (object_no == 0) {
+      expect_schedule_dispatch_delayed_requests(nullptr, &timer_task);
+    }
+
+    MockClock::s_now += std::chrono::microseconds(200);
+    data.clear();
+    on_finish[object_no * 2 + 1] = &cond[object_no * 2 + 1];
+    ASSERT_TRUE(mock_simple_scheduler_object_dispatch.write(
+        object_no, 0, std::move(data), mock_image_ctx.get_data_io_context(),
+        0, 0, std::nullopt, {}, &object_dispatch_flags, nullptr,
+        &dispatch_result, &on_finish[object_no * 2 + 1],
+        &on_dispatched[object_no]));
+    ASSERT_EQ(dispatch_result, io::DISPATCH_RESULT_COMPLETE);
+  }
+  ASSERT_NE(timer_task, nullptr);
+
+  // the timer for object 0 runs late and dispatches object 1 as well,
+  // but not object 2, which isn't due yet
+  MockClock::s_now = start + std::chrono::microseconds(1400);
+  Context *next_timer_task = nullptr;
+  expect_dispatch_delayed_requests(mock_image_ctx, 0);
+  expect_add_timer_task(&next_timer_task);
+  expect_dispatch_delayed_requests(mock_image_ctx, 0);
+  EXPECT_CALL(m_mock_timer, cancel_event(_))
+    .WillOnce(Invoke([](Context *timer_task) {
+                delete timer_task;
+                return true;
+              }));
+  expect_add_timer_task(&next_timer_task);
+
+  run_timer_task(timer_task);
+  ASSERT_EQ(0, on_dispatched[0].wait());
+  ASSERT_EQ(0, on_dispatched[1].wait());
+
+  // wait for the timer run to release the scheduler lock
+  io::ReadExtents extents;
+  C_SaferCond read_cond;
+  Context *on_read_finish = &read_cond;
+  ASSERT_FALSE(mock_simple_scheduler_object_dispatch.read(
+      0, &extents, mock_image_ctx.get_data_io_context(), 0, 0, {}, nullptr,
+      nullptr, nullptr, &on_read_finish, nullptr));
+  on_read_finish->complete(0);
+  ASSERT_EQ(0, read_cond.wait());
+  ASSERT_NE(next_timer_task, nullptr);
+
+  MockClock::s_now = start + std::chrono::microseconds(1800);
+  expect_dispatch_delayed_requests(mock_image_ctx, 0);
+  run_timer_task(next_timer_task);
+  ASSERT_EQ(0, on_dispatched[2].wait());
+
+  for (int i = 0; i < 6; ++i) {
+    on_finish[i]->complete(0);
+    ASSERT_EQ(0, cond[i].wait());
+  }
+}
+
 } // namespace io
 } // namespace librbd
@@ -0,0 +1,519 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "include/rbd_types.h"
+#include "common/ceph_mutex.h"
+#include "librbd/migration/HttpClient.h"
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/lexical_cast.hpp>
+#include <atomic>
+#include <regex>
+#include <thread>
+
+namespace librbd {
+namespace {
+
+struct MockTestImageCtx : public MockImageCtx {
+  MockTestImageCtx(ImageCtx &image_ctx) : MockImageCtx(image_ctx) {
+  }
+};
+
+} // anonymous namespace
+} // namespace librbd
+
+#include "librbd/migration/HttpClient.cc"
+
+namespace librbd {
+namespace migration {
+
+namespace http = boost::beast::http;
+using boost::asio::ip::tcp;
+
+/*
+ * Minimal HTTP/1.1 server that serves a single object from memory and
+ * supports HEAD and single-range GET requests on keep-alive connections.
+ */
+class TestHttpServer {
+public:
+  TestHttpServer(const std::string& data)
+    : m_data(data),
+      m_acceptor(m_io_context, {boost::asio::ip::make_address("127.0.0.1"),
+                                0}) {
+    m_accept_thread = std::thread([this]() { accept(); });
+  }
+
+  ~TestHttpServer() {
+    m_stopping = true;
+
+    // wake up the blocked acceptor
+    boost::system::error_code ec;
+    tcp::socket socket(m_io_context);
+    socket.connect(m_acceptor.local_endpoint(), ec);
+    m_accept_thread.join();
+    m_acceptor.close(ec);
+
+    // unblock any connection threads waiting for requests
+    {
+      std::lock_guard locker{m_lock};
+      for (auto& socket : m_sockets) {
+        socket->shutdown(tcp::socket::shutdown_both, ec);
+      }
+    }
+
+    for (auto& thread : m_connection_threads) {
+      thread.join();
+    }
+  }
+
+  uint16_t get_port() const {
+    return m_acceptor.local_endpoint().port();
+  }
+
+  std::atomic<uint32_t> get_requests{0};
+  std::atomic<uint32_t> connections{0};
+  std::string required_header_value;
+  std::atomic<bool> ignore_range{false};
+
+private:
+  std::string m_data;
+  boost::asio::io_context m_io_context;
+  tcp::acceptor m_acceptor;
+  std::atomic<bool> m_stopping{false};
+
+  std::mutex m_lock;
+  std::list<std::unique_ptr<tcp::socket>> m_sockets;
+  std::thread m_accept_thread;
+  std::list<std::thread> m_connection_threads;
+
+  void accept() {
+    while (!m_stopping) {
+      auto socket = std::make_unique<tcp::socket>(m_io_context);
+      boost::system::error_code ec;
+      m_acceptor.accept(*socket, ec);
+      if (ec || m_stopping) {
+        break;
+      }
+
+      ++connections;
+      std::lock_guard locker{m_lock};
+      auto socket_ptr = socket.get();
+      m_sockets.push_back(std::move(socket));
+      m_connection_threads.emplace_back([this, socket_ptr]() {
+          serve(socket_ptr);
+        });
+    }
+  }
+
+  void serve(tcp::socket* socket) {
+    boost::beast::flat_buffer buffer;
+    while (!m_stopping) {
+      http::request<http::empty_body> request;
+      boost::system::error_code ec;
+      http::read(*socket, buffer, request, ec);
+      if (ec) {
+        break;
+      }
+
+      http::response<http::string_body> response;
+      response.version(request.version());
+      response.keep_alive(request.keep_alive());
+      handle_request(request, &response);
+
+      http::write(*socket, response, ec);
+      if (ec || !response.keep_alive()) {
+        break;
+      }
+    }
+
+    boost::system::error_code ec;
+    socket->shutdown(tcp::socket::shutdown_both, ec);
+  }
+
+  void handle_request(const http::request<http::empty_body>& request,
+                      http::response<http::string_body>* response) {
+    if (request.target() != "/object") {
+      response->result(http::status::not_found);
+      response->prepare_payload();
+      return;
+    }
+
+    if (!required_header_value.empty() &&
+        request[http::field::authorization] != required_header_value) {
+      response->result(http::status::forbidden);
+      response->prepare_payload();
+      return;
+    }
+
+    if (request.method() == http::verb::head) {
+      response->result(http::status::ok);
+      response->content_length(m_data.size());
+      return;
+    }
+
+    ++get_requests;
+    auto range = request[http::field::range];
+    if (range.empty() || ignore_range) {
+      response->result(http::status::ok);
+      response->body() = m_data;
+      response->prepare_payload();
+      return;
+    }
+
+    std::smatch match;
+    std::string range_str{range};
+    if (!std::regex_match(range_str, match,
+                          std::regex("bytes=([0-9]+)-([0-9]+)"))) {
+      response->result(http::status::bad_request);
+      response->prepare_payload();
+      return;
+    }
+
+    auto start = boost::lexical_cast<uint64_t>(match[1].str());
+    auto end = boost::lexical_cast<uint64_t>(match[2].str());
+    if (start > end || end >= m_data.size()) {
+      response->result(http::status::range_not_satisfiable);
+      response->prepare_payload();
+      return;
+    }
+
+    response->result(http::status::partial_content);
+    response->body() = m_data.substr(start, end - start + 1);
+    response->prepare_payload();
+  }
+};
+
+struct TestHttpProcessor : public HttpProcessorInterface {
+  std::string authorization;
+
+  void process_request(EmptyRequest& request) override {
+    request.set(http::field::authorization, authorization);
+  }
+};
+
+class TestMockMigrationHttpClient : public TestMockFixture {
+public:
+  typedef HttpClient<MockTestImageCtx> MockHttpClient;
+
+  librbd::ImageCtx *m_image_ctx;
+
+  void SetUp() override {
+    TestMockFixture::SetUp();
+
+    ASSERT_EQ(0, open_image(m_image_name, &m_image_ctx));
+
+    for (size_t i = 0; i < 40000; ++i) {
+      m_data.push_back('a' + (i % 26) + (i / 4096));
+    }
+    m_server = std::make_unique<TestHttpServer>(m_data);
+  }
+
+  void TearDown() override {
+    m_server.reset();
+    TestMockFixture::TearDown();
+  }
+
+  std::string get_url(const std::string& path = "/object") {
+    return "http://127.0.0.1:" + stringify(m_server->get_port()) + path;
+  }
+
+  void init_config(MockTestImageCtx& mock_image_ctx,
+                   const std::string& cache_size = "1048576",
+                   const std::string& prefetch_blocks = "0") {
+    ASSERT_EQ(0, mock_image_ctx.config.set_val(
+      "rbd_migration_http_block_size", "4096"));
+    ASSERT_EQ(0, mock_image_ctx.config.set_val(
+      "rbd_migration_http_cache_size", cache_size));
+    ASSERT_EQ(0, mock_image_ctx.config.set_val(
+      "rbd_migration_http_prefetch_blocks", prefetch_blocks));
+  }
+
+  void close(MockHttpClient& http_client) {
+    C_SaferCond ctx;
+    http_client.close(&ctx);
+    ASSERT_EQ(0, ctx.wait());
+  }
+
+  std::string m_data;
+  std::unique_ptr<TestHttpServer> m_server;
+};
+
+TEST_F(TestMockMigrationHttpClient, OpenGetSize) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+  init_config(mock_image_ctx);
+
+  MockHttpClient http_client(&mock_image_ctx, get_url());
+
+  C_SaferCond ctx1;
+  http_client.open(&ctx1);
+  ASSERT_EQ(0, ctx1.wait());
+
+  C_SaferCond ctx2;
+  uint64_t size;
+  http_client.get_size(&size, &ctx2);
+  ASSERT_EQ(0, ctx2.wait());
+  ASSERT_EQ(m_data.size(), size);
+
+  close(http_client);
+}
+
+TEST_F(TestMockMigrationHttpClient, OpenNotFound) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+  init_config(mock_image_ctx);
+
+  MockHttpClient http_client(&mock_image_ctx, get_url("/missing"));
+
+  C_SaferCond ctx1;
+  http_client.open(&ctx1);
+  ASSERT_EQ(-ENOENT, ctx1.wait());
+
+  close(http_client);
+}
+
+TEST_F(TestMockMigrationHttpClient, OpenInvalidUrl) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+  init_config(mock_image_ctx);
+
+  MockHttpClient http_client(&mock_image_ctx, "ftp://127.0.0.1/object");
+
+  C_SaferCond ctx1;
+  http_client.open(&ctx1);
+  ASSERT_EQ(-EINVAL, ctx1.wait());
+
+  close(http_client);
+}
+
+TEST_F(TestMockMigrationHttpClient, Read) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+  init_config(mock_image_ctx);
+
+  MockHttpClient http_client(&mock_image_ctx, get_url());
+
+  C_SaferCond ctx1;
+  http_client.open(&ctx1);
+  ASSERT_EQ(0, ctx1.wait());
+
+  C_SaferCond ctx2;
+  bufferlist bl;
+  http_client.read({{100, 5000}, {20000, 10}, {39990, 10}}, &bl, &ctx2);
+  ASSERT_EQ(0, ctx2.wait());
+
+  bufferlist expect_bl;
+  expect_bl.append(m_data.substr(100, 5000));
+  expect_bl.append(m_data.substr(20000, 10));
+  expect_bl.append(m_data.substr(39990, 10));
+  ASSERT_EQ(expect_bl, bl);
+
+  // blocks 0-1 are fetched with a single range request
+  ASSERT_EQ(3U, m_server->get_requests);
+
+  close(http_client);
+}
+
+TEST_F(TestMockMigrationHttpClient, ReadCached) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+  init_config(mock_image_ctx);
+
+  MockHttpClient http_client(&mock_image_ctx, get_url());
+
+  C_SaferCond ctx1;
+  http_client.open(&ctx1);
+  ASSERT_EQ(0, ctx1.wait());
+
+  C_SaferCond ctx2;
+  bufferlist bl1;
+  http_client.read({{0, 8192}}, &bl1, &ctx2);
+  ASSERT_EQ(0, ctx2.wait());
+  ASSERT_EQ(1U, m_server->get_requests);
+
+  C_SaferCond ctx3;
+  bufferlist bl2;
+  http_client.read({{1000, 4000}}, &bl2, &ctx3);
+  ASSERT_EQ(0, ctx3.wait());
+  ASSERT_EQ(1U, m_server->get_requests);
+
+  bufferlist expect_bl;
+  expect_bl.append(m_data.substr(1000, 4000));
+  ASSERT_EQ(expect_bl, bl2);
+
+  close(http_client);
+}
+
+TEST_F(TestMockMigrationHttpClient, ReadEvicted) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+  init_config(mock_image_ctx, "4096");
+
+  MockHttpClient http_client(&mock_image_ctx, get_url());
+
+  C_SaferCond ctx1;
+  http_client.open(&ctx1);
+  ASSERT_EQ(0, ctx1.wait());
+
+  C_SaferCond ctx2;
+  bufferlist bl1;
+  http_client.read({{0, 4096}}, &bl1, &ctx2);
+  ASSERT_EQ(0, ctx2.wait());
+
+  C_SaferCond ctx3;
+  bufferlist bl2;
+  http_client.read({{8192, 4096}}, &bl2, &ctx3);
+  ASSERT_EQ(0, ctx3.wait());
+
+  C_SaferCond ctx4;
+  bufferlist bl3;
+  http_client.read({{0, 4096}}, &bl3, &ctx4);
+  ASSERT_EQ(0, ctx4.wait());
+  ASSERT_EQ(3U, m_server->get_requests);
+
+  bufferlist expect_bl;
+  expect_bl.append(m_data.substr(0, 4096));
+  ASSERT_EQ(expect_bl, bl3);
+
+  close(http_client);
+}
+
+TEST_F(TestMockMigrationHttpClient, ReadPrefetch) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+  init_config(mock_image_ctx, "1048576", "4");
+
+  MockHttpClient http_client(&mock_image_ctx, get_url());
+
+  C_SaferCond ctx1;
+  http_client.open(&ctx1);
+  ASSERT_EQ(0, ctx1.wait());
+
+  C_SaferCond ctx2;
+  bufferlist bl1;
+  http_client.read({{0, 4096}}, &bl1, &ctx2);
+  ASSERT_EQ(0, ctx2.wait());
+
+  // waits for the in-flight prefetch of blocks 1-4
+  C_SaferCond ctx3;
+  bufferlist bl2;
+  http_client.read({{4096, 4096}}, &bl2, &ctx3);
+  ASSERT_EQ(0, ctx3.wait());
+
+  // the remaining prefetched blocks are served without the server
+  m_server.reset();
+  for (uint64_t offset = 2 * 4096; offset < 5 * 4096; offset += 4096) {
+    C_SaferCond ctx;
+    bufferlist bl;
+    http_client.read({{offset, 4096}}, &bl, &ctx);
+    ASSERT_EQ(0, ctx.wait());
+
+    bufferlist expect_bl;
+    expect_bl.append(m_data.substr(offset, 4096));
+    ASSERT_EQ(expect_bl, bl);
+  }
+
+  close(http_client);
+}
+
+TEST_F(TestMockMigrationHttpClient, ReadBeyondEnd) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+  init_config(mock_image_ctx);
+
+  MockHttpClient http_client(&mock_image_ctx, get_url());
+
+  C_SaferCond ctx1;
+  http_client.open(&ctx1);
+  ASSERT_EQ(0, ctx1.wait());
+
+  C_SaferCond ctx2;
+  bufferlist bl;
+  http_client.read({{39000, 2000}}, &bl, &ctx2);
+  ASSERT_EQ(-ERANGE, ctx2.wait());
+
+  close(http_client);
+}
+
+TEST_F(TestMockMigrationHttpClient, ReadRangeIgnored) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+  init_config(mock_image_ctx);
+
+  MockHttpClient http_client(&mock_image_ctx, get_url());
+
+  C_SaferCond ctx1;
+  http_client.open(&ctx1);
+  ASSERT_EQ(0, ctx1.wait());
+
+  // a full 200 response is never buffered in place of the range
+  m_server->ignore_range = true;
+  C_SaferCond ctx2;
+  bufferlist bl;
+  http_client.read({{100, 10}}, &bl, &ctx2);
+  ASSERT_EQ(-EIO, ctx2.wait());
+
+  close(http_client);
+}
+
+TEST_F(TestMockMigrationHttpClient, ReadConcurrent) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+  init_config(mock_image_ctx);
+
+  MockHttpClient http_client(&mock_image_ctx, get_url());
+
+  C_SaferCond ctx1;
+  http_client.open(&ctx1);
+  ASSERT_EQ(0, ctx1.wait());
+
+  std::vector<C_SaferCond> ctxs(9);
+  std::vector<bufferlist> bls(9);
+  for (uint64_t i = 0; i < 9; ++i) {
+    http_client.read({{i * 4096, 4096}}, &bls[i], &ctxs[i]);
+  }
+
+  for (uint64_t i = 0; i < 9; ++i) {
+    ASSERT_EQ(0, ctxs[i].wait());
+
+    bufferlist expect_bl;
+    expect_bl.append(m_data.substr(i * 4096, 4096));
+    ASSERT_EQ(expect_bl, bls[i]);
+  }
+
+  auto max_connections = mock_image_ctx.config.get_val<uint64_t>(
+    "rbd_migration_http_max_connections");
+  ASSERT_LE(m_server->connections, max_connections);
+
+  close(http_client);
+}
+
+TEST_F(TestMockMigrationHttpClient, HttpProcessor) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+  init_config(mock_image_ctx);
+  m_server->required_header_value = "AWS access:signature";
+
+  TestHttpProcessor http_processor;
+  MockHttpClient http_client(&mock_image_ctx, get_url());
+  http_client.set_http_processor(&http_processor);
+
+  C_SaferCond ctx1;
+  http_client.open(&ctx1);
+  ASSERT_EQ(-EACCES, ctx1.wait());
+  close(http_client);
+
+  http_processor.authorization = "AWS access:signature";
+  MockHttpClient http_client2(&mock_image_ctx, get_url());
+  http_client2.set_http_processor(&http_processor);
+
+  C_SaferCond ctx2;
+  http_client2.open(&ctx2);
+  ASSERT_EQ(0, ctx2.wait());
+
+  C_SaferCond ctx3;
+  bufferlist bl;
+  http_client2.read({{0, 10}}, &bl, &ctx3);
+  ASSERT_EQ(0, ctx3.wait());
+
+  close(http_client2);
+}
+
+} // namespace migration
+} // namespace librbd
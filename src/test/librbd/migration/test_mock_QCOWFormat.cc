@@ -0,0 +1,554 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "include/rbd_types.h"
+#include "librbd/io/Types.h"
+#include "librbd/migration/QCOW.h"
+#include "librbd/migration/QCOWFormat.h"
+#include "librbd/migration/StreamBuilder.h"
+#include "librbd/migration/StreamInterface.h"
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "json_spirit/json_spirit.h"
+#include <boost/endian/conversion.hpp>
+#include <zlib.h>
+
+namespace librbd {
+namespace {
+
+struct MockTestImageCtx : public MockImageCtx {
+  MockTestImageCtx(ImageCtx &image_ctx) : MockImageCtx(image_ctx) {
+  }
+};
+
+// serves an in-memory file and records the issued reads
+struct MemoryStream : public migration::StreamInterface {
+  bufferlist bl;
+  std::vector<io::Extents>* reads;
+
+  MemoryStream(const bufferlist& bl, std::vector<io::Extents>* reads)
+    : bl(bl), reads(reads) {
+  }
+
+  void open(Context* on_finish) override {
+    on_finish->complete(0);
+  }
+
+  void close(Context* on_finish) override {
+    on_finish->complete(0);
+  }
+
+  void get_size(uint64_t* size, Context* on_finish) override {
+    *size = bl.length();
+    on_finish->complete(0);
+  }
+
+  void read(io::Extents&& byte_extents, bufferlist* data,
+            Context* on_finish) override {
+    reads->push_back(byte_extents);
+
+    data->clear();
+    for (auto [offset, length] : byte_extents) {
+      if (offset + length > bl.length()) {
+        on_finish->complete(-ERANGE);
+        return;
+      }
+
+      bufferlist sub_bl;
+      sub_bl.substr_of(bl, offset, length);
+      data->claim_append(sub_bl);
+    }
+    on_finish->complete(0);
+  }
+};
+
+} // anonymous namespace
+
+namespace migration {
+
+template<>
+struct StreamBuilder<librbd::MockTestImageCtx> {
+  static std::map<std::string, bufferlist> s_files;
+  static std::vector<io::Extents> s_reads;
+
+  static int build(librbd::MockTestImageCtx*,
+                   const json_spirit::mObject& format_object,
+                   std::unique_ptr<StreamInterface>* stream) {
+    auto& stream_obj = format_object.at("stream").get_obj();
+    auto it = s_files.find(stream_obj.at("file_path").get_str());
+    if (it == s_files.end()) {
+      return -ENOENT;
+    }
+
+    stream->reset(new MemoryStream(it->second, &s_reads));
+    return 0;
+  }
+};
+
+std::map<std::string, bufferlist> StreamBuilder<librbd::MockTestImageCtx>::s_files;
+std::vector<io::Extents> StreamBuilder<librbd::MockTestImageCtx>::s_reads;
+
+} // namespace migration
+} // namespace librbd
+
+#include "librbd/migration/QCOWFormat.cc"
+
+namespace librbd {
+namespace migration {
+
+using namespace qcow;
+
+class TestMockMigrationQCOWFormat : public TestMockFixture {
+public:
+  typedef QCOWFormat<MockTestImageCtx> MockQCOWFormat;
+  typedef StreamBuilder<MockTestImageCtx> MockStreamBuilder;
+
+  static const uint32_t CLUSTER_BITS = 9;
+  static const uint64_t CLUSTER_SIZE = 1 << CLUSTER_BITS;
+
+  // cluster 0: header, cluster 1: L1 table, cluster 2: L2 table
+  static const uint64_t L1_TABLE_OFFSET = CLUSTER_SIZE;
+  static const uint64_t L2_TABLE_OFFSET = 2 * CLUSTER_SIZE;
+
+  librbd::ImageCtx *m_image_ctx;
+  std::string m_image;
+
+  void SetUp() override {
+    TestMockFixture::SetUp();
+
+    ASSERT_EQ(0, open_image(m_image_name, &m_image_ctx));
+
+    MockStreamBuilder::s_files.clear();
+    MockStreamBuilder::s_reads.clear();
+  }
+
+  json_spirit::mObject build_spec(const std::string& file_path,
+                                  const std::string& type = "qcow") {
+    json_spirit::mObject stream_obj;
+    stream_obj["type"] = "file";
+    stream_obj["file_path"] = file_path;
+
+    json_spirit::mObject json_object;
+    json_object["type"] = type;
+    json_object["stream"] = stream_obj;
+    return json_object;
+  }
+
+  json_spirit::mObject build_spec(const std::string& file_path,
+                                  const json_spirit::mObject& backing_spec) {
+    auto json_object = build_spec(file_path);
+    json_object["backing"] = backing_spec;
+    return json_object;
+  }
+
+  void encode_be32(uint64_t offset, uint32_t value) {
+    value = boost::endian::native_to_big(value);
+    m_image.replace(offset, sizeof(value),
+                    reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void encode_be64(uint64_t offset, uint64_t value) {
+    value = boost::endian::native_to_big(value);
+    m_image.replace(offset, sizeof(value),
+                    reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void init_image(uint32_t version, uint64_t size) {
+    m_image.assign(3 * CLUSTER_SIZE, '\0');
+    encode_be32(HEADER_MAGIC, QCOW_MAGIC);
+    encode_be32(HEADER_VERSION, version);
+    encode_be32(HEADER_CLUSTER_BITS, CLUSTER_BITS);
+    encode_be64(HEADER_SIZE, size);
+    encode_be32(HEADER_L1_SIZE, 1);
+    encode_be64(HEADER_L1_TABLE_OFFSET, L1_TABLE_OFFSET);
+    if (version >= 3) {
+      encode_be32(HEADER_LENGTH, HEADER_V3_MIN_LENGTH);
+    }
+
+    encode_be64(L1_TABLE_OFFSET, L2_TABLE_OFFSET | QCOW_OFLAG_COPIED);
+  }
+
+  void set_backing_file(const std::string& name) {
+    uint64_t offset = CLUSTER_SIZE - name.size();
+    encode_be64(HEADER_BACKING_FILE_OFFSET, offset);
+    encode_be32(HEADER_BACKING_FILE_SIZE, name.size());
+    m_image.replace(offset, name.size(), name);
+  }
+
+  void set_l2_entry(uint64_t cluster_index, uint64_t l2_entry) {
+    encode_be64(L2_TABLE_OFFSET + cluster_index * sizeof(uint64_t), l2_entry);
+  }
+
+  void add_data_cluster(uint64_t cluster_index, char c) {
+    auto host_offset = m_image.size();
+    m_image.append(CLUSTER_SIZE, c);
+    set_l2_entry(cluster_index, host_offset | QCOW_OFLAG_COPIED);
+  }
+
+  void add_compressed_cluster(uint64_t cluster_index, const std::string& data,
+                              uint64_t misalignment) {
+    ASSERT_EQ(CLUSTER_SIZE, data.size());
+
+    std::string compressed(2 * CLUSTER_SIZE, '\0');
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    ASSERT_EQ(Z_OK, deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                                 -12, 9, Z_DEFAULT_STRATEGY));
+    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    strm.avail_in = data.size();
+    strm.next_out = reinterpret_cast<Bytef*>(compressed.data());
+    strm.avail_out = compressed.size();
+    ASSERT_EQ(Z_STREAM_END, deflate(&strm, Z_FINISH));
+    compressed.resize(strm.total_out);
+    deflateEnd(&strm);
+
+    auto host_offset = m_image.size() + misalignment;
+    auto nb_csectors = ((host_offset % COMPRESSED_SECTOR_SIZE) +
+                        compressed.size() + COMPRESSED_SECTOR_SIZE - 1) /
+                       COMPRESSED_SECTOR_SIZE;
+    ASSERT_LE(nb_csectors, 2U);
+
+    m_image.append(misalignment, '\0');
+    m_image.append(compressed);
+
+    uint64_t csize_shift = 62 - (CLUSTER_BITS - 8);
+    set_l2_entry(cluster_index, QCOW_OFLAG_COMPRESSED |
+                                ((nb_csectors - 1) << csize_shift) |
+                                host_offset);
+  }
+
+  void add_file(const std::string& file_path, const std::string& data) {
+    bufferlist bl;
+    bl.append(data);
+    MockStreamBuilder::s_files[file_path] = bl;
+  }
+
+  void open(MockQCOWFormat& mock_qcow_format, int r) {
+    C_SaferCond ctx;
+    mock_qcow_format.open(&ctx);
+    ASSERT_EQ(r, ctx.wait());
+  }
+
+  void close(MockQCOWFormat& mock_qcow_format) {
+    C_SaferCond ctx;
+    mock_qcow_format.close(&ctx);
+    ASSERT_EQ(0, ctx.wait());
+  }
+
+  void read(MockQCOWFormat& mock_qcow_format, io::Extents&& image_extents,
+            bufferlist* bl) {
+    C_SaferCond ctx;
+    mock_qcow_format.read_extents(std::move(image_extents), bl, &ctx);
+    ASSERT_EQ(0, ctx.wait());
+  }
+};
+
+TEST_F(TestMockMigrationQCOWFormat, OpenClose) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  init_image(3, 16 * CLUSTER_SIZE);
+  add_file("/image.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(&mock_image_ctx, build_spec("/image.qcow2"), 0);
+  open(mock_qcow_format, 0);
+
+  C_SaferCond ctx1;
+  uint64_t size;
+  mock_qcow_format.get_image_size(CEPH_NOSNAP, &size, &ctx1);
+  ASSERT_EQ(0, ctx1.wait());
+  ASSERT_EQ(16 * CLUSTER_SIZE, size);
+
+  C_SaferCond ctx2;
+  FormatInterface::SnapInfos snap_infos;
+  mock_qcow_format.get_snapshots(&snap_infos, &ctx2);
+  ASSERT_EQ(0, ctx2.wait());
+  ASSERT_TRUE(snap_infos.empty());
+
+  close(mock_qcow_format);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, OpenInvalidMagic) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  add_file("/image.raw", std::string(4 * CLUSTER_SIZE, 'a'));
+
+  MockQCOWFormat mock_qcow_format(&mock_image_ctx, build_spec("/image.raw"), 0);
+  open(mock_qcow_format, -EINVAL);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, OpenUnsupportedVersion) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  init_image(4, 16 * CLUSTER_SIZE);
+  add_file("/image.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(&mock_image_ctx, build_spec("/image.qcow2"), 0);
+  open(mock_qcow_format, -ENOTSUP);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, OpenEncrypted) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  init_image(3, 16 * CLUSTER_SIZE);
+  encode_be32(HEADER_CRYPT_METHOD, 2);
+  add_file("/image.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(&mock_image_ctx, build_spec("/image.qcow2"), 0);
+  open(mock_qcow_format, -ENOTSUP);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, OpenIncompatibleFeatures) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  init_image(3, 16 * CLUSTER_SIZE);
+  encode_be64(HEADER_INCOMPATIBLE_FEATURES, QCOW_INCOMPAT_EXTL2);
+  add_file("/image.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(&mock_image_ctx, build_spec("/image.qcow2"), 0);
+  open(mock_qcow_format, -ENOTSUP);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, OpenShortL1Table) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  // a single L2 table only covers 64 clusters
+  init_image(2, 65 * CLUSTER_SIZE);
+  add_file("/image.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(&mock_image_ctx, build_spec("/image.qcow2"), 0);
+  open(mock_qcow_format, -EINVAL);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, OpenLargeL1Table) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  // larger than the 32MiB limit on the table
+  init_image(2, 16 * CLUSTER_SIZE);
+  encode_be32(HEADER_L1_SIZE, (32 << 20) / sizeof(uint64_t) + 1);
+  add_file("/image.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(&mock_image_ctx, build_spec("/image.qcow2"),
+                                  0);
+  open(mock_qcow_format, -EINVAL);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, OpenL1TableBeyondStream) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  init_image(2, 16 * CLUSTER_SIZE);
+  encode_be32(HEADER_L1_SIZE, 2 * CLUSTER_SIZE / sizeof(uint64_t) + 1);
+  add_file("/image.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(&mock_image_ctx, build_spec("/image.qcow2"),
+                                  0);
+  open(mock_qcow_format, -EINVAL);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, OpenTooLarge) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  // 512 byte clusters cover 32KiB per L1 entry
+  init_image(2, 1ULL << 50);
+  add_file("/image.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(&mock_image_ctx, build_spec("/image.qcow2"),
+                                  0);
+  open(mock_qcow_format, -EFBIG);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, Read) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  init_image(3, 16 * CLUSTER_SIZE);
+  add_data_cluster(0, 'a');
+  add_data_cluster(1, 'b');
+  set_l2_entry(3, QCOW_OFLAG_ZERO);
+  add_data_cluster(4, 'c');
+  add_file("/image.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(&mock_image_ctx, build_spec("/image.qcow2"), 0);
+  open(mock_qcow_format, 0);
+
+  MockStreamBuilder::s_reads.clear();
+  bufferlist bl;
+  read(mock_qcow_format, {{CLUSTER_SIZE / 2, 4 * CLUSTER_SIZE},
+                          {15 * CLUSTER_SIZE, 2 * CLUSTER_SIZE}}, &bl);
+
+  std::string expected;
+  expected.append(CLUSTER_SIZE / 2, 'a');
+  expected.append(CLUSTER_SIZE, 'b');
+  expected.append(2 * CLUSTER_SIZE, '\0');
+  expected.append(CLUSTER_SIZE / 2, 'c');
+  expected.append(2 * CLUSTER_SIZE, '\0');
+  ASSERT_EQ(expected, bl.to_str());
+
+  // one L2 table load followed by a single read for the contiguous data
+  ASSERT_EQ(2U, MockStreamBuilder::s_reads.size());
+  ASSERT_EQ(io::Extents({{L2_TABLE_OFFSET, CLUSTER_SIZE}}),
+            MockStreamBuilder::s_reads[0]);
+  ASSERT_EQ(io::Extents({{3 * CLUSTER_SIZE + CLUSTER_SIZE / 2,
+                          2 * CLUSTER_SIZE}}),
+            MockStreamBuilder::s_reads[1]);
+
+  // the L2 table is cached
+  MockStreamBuilder::s_reads.clear();
+  bl.clear();
+  read(mock_qcow_format, {{0, CLUSTER_SIZE}}, &bl);
+  ASSERT_EQ(std::string(CLUSTER_SIZE, 'a'), bl.to_str());
+  ASSERT_EQ(1U, MockStreamBuilder::s_reads.size());
+
+  close(mock_qcow_format);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, ReadCompressed) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  std::string data1;
+  for (uint64_t idx = 0; idx < CLUSTER_SIZE; ++idx) {
+    data1.push_back('a' + (idx % 7));
+  }
+  std::string data2(CLUSTER_SIZE, 'z');
+
+  init_image(2, 16 * CLUSTER_SIZE);
+  add_compressed_cluster(0, data1, 0);
+  add_compressed_cluster(1, data2, 100);
+  add_file("/image.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(&mock_image_ctx, build_spec("/image.qcow2"), 0);
+  open(mock_qcow_format, 0);
+
+  bufferlist bl;
+  read(mock_qcow_format, {{10, 2 * CLUSTER_SIZE - 20}}, &bl);
+  ASSERT_EQ(data1.substr(10) + data2.substr(0, CLUSTER_SIZE - 10),
+            bl.to_str());
+
+  close(mock_qcow_format);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, ReadRawBacking) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  // the backing image is smaller than the overlay
+  add_file("/images/base.raw", std::string(3 * CLUSTER_SIZE / 2, 'x'));
+
+  init_image(3, 4 * CLUSTER_SIZE);
+  set_backing_file("base.raw");
+  add_data_cluster(0, 'a');
+  add_file("/images/overlay.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(
+    &mock_image_ctx, build_spec("/images/overlay.qcow2",
+                                build_spec("/images/base.raw", "raw")), 0);
+  open(mock_qcow_format, 0);
+
+  bufferlist bl;
+  read(mock_qcow_format, {{0, 3 * CLUSTER_SIZE}}, &bl);
+
+  std::string expected;
+  expected.append(CLUSTER_SIZE, 'a');
+  expected.append(CLUSTER_SIZE / 2, 'x');
+  expected.append(3 * CLUSTER_SIZE / 2, '\0');
+  ASSERT_EQ(expected, bl.to_str());
+
+  close(mock_qcow_format);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, ReadQCOWBacking) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  init_image(3, 4 * CLUSTER_SIZE);
+  add_data_cluster(0, 'b');
+  add_data_cluster(1, 'b');
+  add_file("/images/base.qcow2", m_image);
+
+  init_image(3, 4 * CLUSTER_SIZE);
+  set_backing_file("/images/base.qcow2");
+  add_data_cluster(1, 'a');
+  add_file("/images/overlay.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(
+    &mock_image_ctx, build_spec("/images/overlay.qcow2",
+                                build_spec("/images/base.qcow2")), 0);
+  open(mock_qcow_format, 0);
+
+  bufferlist bl;
+  read(mock_qcow_format, {{0, 4 * CLUSTER_SIZE}}, &bl);
+
+  std::string expected;
+  expected.append(CLUSTER_SIZE, 'b');
+  expected.append(CLUSTER_SIZE, 'a');
+  expected.append(2 * CLUSTER_SIZE, '\0');
+  ASSERT_EQ(expected, bl.to_str());
+
+  close(mock_qcow_format);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, OpenMissingBacking) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  init_image(3, 4 * CLUSTER_SIZE);
+  set_backing_file("base.qcow2");
+  add_file("/images/overlay.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(
+    &mock_image_ctx, build_spec("/images/overlay.qcow2",
+                                build_spec("/images/base.qcow2")), 0);
+  open(mock_qcow_format, -ENOENT);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, OpenImplicitBacking) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  add_file("/images/base.raw", std::string(CLUSTER_SIZE, 'x'));
+
+  // the backing file named by the image is never opened on its own
+  init_image(3, 4 * CLUSTER_SIZE);
+  set_backing_file("base.raw");
+  add_file("/images/overlay.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(&mock_image_ctx,
+                                  build_spec("/images/overlay.qcow2"), 0);
+  open(mock_qcow_format, -ENOTSUP);
+}
+
+TEST_F(TestMockMigrationQCOWFormat, ListSnaps) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  add_file("/images/base.raw", std::string(CLUSTER_SIZE, 'x'));
+
+  init_image(3, 4 * CLUSTER_SIZE);
+  set_backing_file("base.raw");
+  add_data_cluster(2, 'a');
+  set_l2_entry(3, QCOW_OFLAG_ZERO);
+  add_file("/images/overlay.qcow2", m_image);
+
+  MockQCOWFormat mock_qcow_format(
+    &mock_image_ctx, build_spec("/images/overlay.qcow2",
+                                build_spec("/images/base.raw", "raw")), 0);
+  open(mock_qcow_format, 0);
+
+  C_SaferCond ctx;
+  io::SnapshotDelta snapshot_delta;
+  mock_qcow_format.list_snaps({{0, 4 * CLUSTER_SIZE}}, {CEPH_NOSNAP}, 0,
+                              &snapshot_delta, {}, &ctx);
+  ASSERT_EQ(0, ctx.wait());
+
+  io::SnapshotDelta expected_snapshot_delta;
+  auto& expected = expected_snapshot_delta[{CEPH_NOSNAP, CEPH_NOSNAP}];
+  expected.insert(0, CLUSTER_SIZE,
+                  {io::SPARSE_EXTENT_STATE_DATA, CLUSTER_SIZE});
+  expected.insert(CLUSTER_SIZE, CLUSTER_SIZE,
+                  {io::SPARSE_EXTENT_STATE_ZEROED, CLUSTER_SIZE});
+  expected.insert(2 * CLUSTER_SIZE, CLUSTER_SIZE,
+                  {io::SPARSE_EXTENT_STATE_DATA, CLUSTER_SIZE});
+  expected.insert(3 * CLUSTER_SIZE, CLUSTER_SIZE,
+                  {io::SPARSE_EXTENT_STATE_ZEROED, CLUSTER_SIZE});
+  ASSERT_EQ(expected_snapshot_delta, snapshot_delta);
+
+  close(mock_qcow_format);
+}
+
+} // namespace migration
+} // namespace librbd
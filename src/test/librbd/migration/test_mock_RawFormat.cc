@@ -6,6 +6,8 @@
 #include "include/rbd_types.h"
 #include "common/ceph_mutex.h"
 #include "librbd/migration/FileStream.h"
+#include "librbd/migration/HttpStream.h"
+#include "librbd/migration/S3Stream.h"
 #include "librbd/migration/RawFormat.h"
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
@@ -49,9 +51,62 @@ struct FileStream<librbd::MockTestImageCtx> : public StreamInterface {
 
 FileStream<librbd::MockTestImageCtx>* FileStream<librbd::MockTestImageCtx>::s_instance = nullptr;
 
+template<>
+struct HttpStream<librbd::MockTestImageCtx> : public StreamInterface {
+  static HttpStream* s_instance;
+  static HttpStream* create(librbd::MockTestImageCtx*,
+                      const json_spirit::mObject&) {
+    ceph_assert(s_instance != nullptr);
+    return s_instance;
+  }
+
+  MOCK_METHOD1(open, void(Context*));
+  MOCK_METHOD1(close, void(Context*));
+
+  MOCK_METHOD2(get_size, void(uint64_t*, Context*));
+
+  MOCK_METHOD3(read, void(const io::Extents&, bufferlist*, Context*));
+  void read(io::Extents&& byte_extents, bufferlist* bl, Context* on_finish) {
+    read(byte_extents, bl, on_finish);
+  }
+
+  HttpStream() {
+    s_instance = this;
+  }
+};
+
+HttpStream<librbd::MockTestImageCtx>* HttpStream<librbd::MockTestImageCtx>::s_instance = nullptr;
+
+template<>
+struct S3Stream<librbd::MockTestImageCtx> : public StreamInterface {
+  static S3Stream* s_instance;
+  static S3Stream* create(librbd::MockTestImageCtx*,
+                      const json_spirit::mObject&) {
+    ceph_assert(s_instance != nullptr);
+    return s_instance;
+  }
+
+  MOCK_METHOD1(open, void(Context*));
+  MOCK_METHOD1(close, void(Context*));
+
+  MOCK_METHOD2(get_size, void(uint64_t*, Context*));
+
+  MOCK_METHOD3(read, void(const io::Extents&, bufferlist*, Context*));
+  void read(io::Extents&& byte_extents, bufferlist* bl, Context* on_finish) {
+    read(byte_extents, bl, on_finish);
+  }
+
+  S3Stream() {
+    s_instance = this;
+  }
+};
+
+S3Stream<librbd::MockTestImageCtx>* S3Stream<librbd::MockTestImageCtx>::s_instance = nullptr;
+
 } // namespace migration
 } // namespace librbd
 
+#include "librbd/migration/StreamBuilder.cc"
 #include "librbd/migration/RawFormat.cc"
 
 using ::testing::_;
@@ -68,6 +123,8 @@ class TestMockMigrationRawFormat : public TestMockFixture {
 public:
   typedef RawFormat<MockTestImageCtx> MockRawFormat;
   typedef FileStream<MockTestImageCtx> MockFileStream;
+  typedef HttpStream<MockTestImageCtx> MockHttpStream;
+  typedef S3Stream<MockTestImageCtx> MockS3Stream;
 
   librbd::ImageCtx *m_image_ctx;
 
@@ -134,6 +191,75 @@ TEST_F(TestMockMigrationRawFormat, OpenClose) {
   ASSERT_EQ(0, ctx2.wait());
 }
 
+TEST_F(TestMockMigrationRawFormat, OpenHttpStream) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  InSequence seq;
+  auto mock_http_stream = new MockHttpStream();
+  EXPECT_CALL(*mock_http_stream, open(_))
+    .WillOnce(Invoke([](Context* ctx) { ctx->complete(0); }));
+  EXPECT_CALL(*mock_http_stream, close(_))
+    .WillOnce(Invoke([](Context* ctx) { ctx->complete(0); }));
+
+  json_spirit::mObject stream_obj;
+  stream_obj["type"] = "http";
+  stream_obj["url"] = "http://localhost/image";
+  json_object["stream"] = stream_obj;
+  MockRawFormat mock_raw_format(&mock_image_ctx, json_object);
+
+  C_SaferCond ctx1;
+  mock_raw_format.open(&ctx1);
+  ASSERT_EQ(0, ctx1.wait());
+
+  C_SaferCond ctx2;
+  mock_raw_format.close(&ctx2);
+  ASSERT_EQ(0, ctx2.wait());
+}
+
+TEST_F(TestMockMigrationRawFormat, OpenS3Stream) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  InSequence seq;
+  auto mock_s3_stream = new MockS3Stream();
+  EXPECT_CALL(*mock_s3_stream, open(_))
+    .WillOnce(Invoke([](Context* ctx) { ctx->complete(0); }));
+  EXPECT_CALL(*mock_s3_stream, close(_))
+    .WillOnce(Invoke([](Context* ctx) { ctx->complete(0); }));
+
+  json_spirit::mObject stream_obj;
+  stream_obj["type"] = "s3";
+  stream_obj["url"] = "http://localhost/bucket/image";
+  stream_obj["access_key"] = "access";
+  stream_obj["secret_key"] = "secret";
+  json_object["stream"] = stream_obj;
+  MockRawFormat mock_raw_format(&mock_image_ctx, json_object);
+
+  C_SaferCond ctx1;
+  mock_raw_format.open(&ctx1);
+  ASSERT_EQ(0, ctx1.wait());
+
+  C_SaferCond ctx2;
+  mock_raw_format.close(&ctx2);
+  ASSERT_EQ(0, ctx2.wait());
+}
+
+TEST_F(TestMockMigrationRawFormat, OpenUnknownStream) {
+  MockTestImageCtx mock_image_ctx(*m_image_ctx);
+
+  json_spirit::mObject stream_obj;
+  stream_obj["type"] = "ftp";
+  json_object["stream"] = stream_obj;
+  MockRawFormat mock_raw_format(&mock_image_ctx, json_object);
+
+  C_SaferCond ctx1;
+  mock_raw_format.open(&ctx1);
+  ASSERT_EQ(-EINVAL, ctx1.wait());
+
+  C_SaferCond ctx2;
+  mock_raw_format.close(&ctx2);
+  ASSERT_EQ(0, ctx2.wait());
+}
+
 TEST_F(TestMockMigrationRawFormat, GetSnapshots) {
   MockTestImageCtx mock_image_ctx(*m_image_ctx);
 
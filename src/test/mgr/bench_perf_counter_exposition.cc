@@ -0,0 +1,119 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ *
+ */
+
+/*
+ * measures what PerfCounterExposition costs a daemon report, and how
+ * long a scrape of the whole cluster's counters takes.
+ */
+
+#include <chrono>
+#include <iostream>
+
+#include "common/ceph_argparse.h"
+#include "global/global_init.h"
+#include "include/stringify.h"
+#include "mgr/DaemonState.h"
+#include "mgr/PerfCounterExposition.h"
+
+static void usage()
+{
+  std::cout << "usage: ceph_test_mgr_perf_counter_exposition_bench [options]\n"
+            << "  --daemons N    reporting osds (default 1500)\n"
+            << "  --counters N   counters per osd (default 200)\n"
+            << "  --reports N    reports per osd (default 3)\n";
+  generic_client_usage();
+}
+
+int main(int argc, char** argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+  if (ceph_argparse_need_usage(args)) {
+    usage();
+    exit(0);
+  }
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  int osds = 1500;
+  int counters_per_osd = 200;
+  int reports = 3;
+  std::string val;
+  for (auto i = args.begin(); i != args.end();) {
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_witharg(args, i, &val, "--daemons", (char*)NULL)) {
+      osds = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--counters", (char*)NULL)) {
+      counters_per_osd = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--reports", (char*)NULL)) {
+      reports = atoi(val.c_str());
+    } else {
+      cerr << "unrecognized arg " << *i << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  PerfCounterTypes types;
+  for (int c = 0; c < counters_per_osd; ++c) {
+    PerfCounterType t;
+    t.path = "osd.counter_" + stringify(c);
+    t.description = t.path;
+    t.type = c % 4 == 0 ?
+      (perfcounter_type_d)(PERFCOUNTER_TIME | PERFCOUNTER_LONGRUNAVG) :
+      (perfcounter_type_d)(PERFCOUNTER_U64 | PERFCOUNTER_COUNTER);
+    t.priority = 5;
+    t.unit = UNIT_NONE;
+    types[t.path] = t;
+  }
+
+  std::vector<DaemonPerfCounters> counters(osds, DaemonPerfCounters(types));
+  PerfCounterExposition exposition;
+  exposition.enable();
+
+  // a stream of reports from every osd
+  std::chrono::duration<double> update_time{0};
+  for (int r = 0; r < reports; ++r) {
+    for (int osd = 0; osd < osds; ++osd) {
+      auto &daemon_counters = counters[osd];
+      for (auto &[path, type] : types) {
+	auto i = daemon_counters.instances.find(path);
+	if (i == daemon_counters.instances.end()) {
+	  i = daemon_counters.instances.emplace(path, type.type).first;
+	}
+	if (type.type & PERFCOUNTER_LONGRUNAVG) {
+	  i->second.push_avg(ceph_clock_now(), r * 1000, r);
+	} else {
+	  i->second.push(ceph_clock_now(), r * 1000);
+	}
+      }
+      auto start = std::chrono::steady_clock::now();
+      exposition.update({"osd", stringify(osd)}, daemon_counters);
+      update_time += std::chrono::steady_clock::now() - start;
+    }
+  }
+
+  std::string out;
+  auto start = std::chrono::steady_clock::now();
+  exposition.render(5, {"osd"}, &out);
+  std::chrono::duration<double> scrape_time =
+    std::chrono::steady_clock::now() - start;
+
+  std::cout << osds << " osds x " << counters_per_osd << " counters: "
+	    << update_time.count() * 1000000 / (reports * osds)
+	    << " us per report, scrape " << scrape_time.count() * 1000
+	    << " ms, " << out.size() << " bytes" << std::endl;
+  return EXIT_SUCCESS;
+}
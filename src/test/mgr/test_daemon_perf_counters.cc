@@ -0,0 +1,341 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <limits>
+
+#include "global/global_context.h"
+#include "mgr/DaemonState.h"
+#include "mgr/MgrSession.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const auto LATENCY = static_cast<perfcounter_type_d>(
+  PERFCOUNTER_TIME | PERFCOUNTER_LONGRUNAVG);
+
+PerfCounterType make_type(const std::string &path,
+			  perfcounter_type_d type = PERFCOUNTER_U64)
+{
+  PerfCounterType t;
+  t.path = path;
+  t.description = path;
+  t.nick = "";
+  t.type = type;
+  t.priority = 5;
+  t.unit = UNIT_NONE;
+  return t;
+}
+
+// the counters a daemon reports, in path order as MgrClient packs them
+typedef std::map<std::string, std::pair<perfcounter_type_d,
+					PerfCounterReportedValue>> Values;
+
+// a version 1 report, carrying the values of every declared counter
+ceph::ref_t<MMgrReport> make_full_report(const Values &values)
+{
+  auto report = ceph::make_message<MMgrReport>();
+  ENCODE_START(1, 1, report->packed);
+  for (auto &[path, v] : values) {
+    auto &[type, value] = v;
+    encode(value.value, report->packed);
+    if (type & PERFCOUNTER_LONGRUNAVG) {
+      encode(value.avgcount, report->packed);
+      encode(value.avgcount2, report->packed);
+    }
+  }
+  ENCODE_FINISH(report->packed);
+  return report;
+}
+
+// a version 2 report, carrying the counters that changed since @p sent
+ceph::ref_t<MMgrReport> make_delta_report(const Values &sent,
+					  const Values &values)
+{
+  auto report = ceph::make_message<MMgrReport>();
+  ceph::buffer::list deltas;
+  uint32_t changed = 0;
+  {
+    auto app = deltas.get_contiguous_appender(values.size() * (5 + 3 * 10));
+    uint32_t index = 0;
+    uint32_t last_changed = 0;
+    for (auto &[path, v] : values) {
+      auto &[type, value] = v;
+      PerfCounterReportedValue from;
+      auto i = sent.find(path);
+      if (i != sent.end()) {
+	from = i->second.second;
+      }
+      if (value.value != from.value ||
+	  value.avgcount != from.avgcount ||
+	  value.avgcount2 != from.avgcount2) {
+	denc_varint(index - last_changed, app);
+	MMgrReport::encode_delta(from.value, value.value, app);
+	if (type & PERFCOUNTER_LONGRUNAVG) {
+	  MMgrReport::encode_delta(from.avgcount, value.avgcount, app);
+	  MMgrReport::encode_delta(from.avgcount2, value.avgcount2, app);
+	}
+	last_changed = index;
+	++changed;
+      }
+      ++index;
+    }
+  }
+  ENCODE_START(2, 2, report->packed);
+  encode(changed, report->packed);
+  encode(deltas, report->packed);
+  ENCODE_FINISH(report->packed);
+  return report;
+}
+
+void declare(MMgrReport *report, const Values &values)
+{
+  for (auto &[path, v] : values) {
+    report->declare_types.push_back(make_type(path, v.first));
+  }
+}
+
+uint64_t latest(const DaemonPerfCounters &counters, const std::string &path)
+{
+  return counters.instances.at(path).get_latest_data().v;
+}
+
+std::pair<uint64_t, uint64_t> latest_avg(const DaemonPerfCounters &counters,
+					 const std::string &path)
+{
+  auto &d = counters.instances.at(path).get_latest_data_avg();
+  return {d.s, d.c};
+}
+
+size_t samples(const DaemonPerfCounters &counters, const std::string &path)
+{
+  return counters.instances.at(path).get_data().size();
+}
+
+MgrSessionRef make_session()
+{
+  return ceph::make_ref<MgrSession>(g_ceph_context);
+}
+
+} // anonymous namespace
+
+TEST(MMgrReport, Delta)
+{
+  const uint64_t max = std::numeric_limits<uint64_t>::max();
+  const uint64_t half = uint64_t(1) << 63;
+  const std::vector<std::pair<uint64_t, uint64_t>> cases = {
+    {0, 0}, {0, 1}, {1, 0}, {5, 3}, {1000, 1},
+    // wrapping around the u64 range either way
+    {0, max}, {max, 0}, {max - 1, 2}, {0, half}, {half, 0}, {1, half + 2},
+    {max, half}, {half - 1, max},
+  };
+  for (auto &[from, to] : cases) {
+    ceph::buffer::list bl;
+    {
+      auto app = bl.get_contiguous_appender(10);
+      MMgrReport::encode_delta(from, to, app);
+    }
+    ceph::buffer::ptr tmp;
+    auto q = bl.cbegin();
+    q.copy_shallow(bl.length(), tmp);
+    auto p = std::cbegin(tmp);
+    EXPECT_EQ(to, MMgrReport::decode_delta(from, p))
+      << "from " << from << " to " << to;
+    EXPECT_EQ(bl.length(), p.get_offset());
+  }
+}
+
+TEST(MMgrReport, DeltaSize)
+{
+  auto size = [](uint64_t from, uint64_t to) {
+    ceph::buffer::list bl;
+    {
+      auto app = bl.get_contiguous_appender(10);
+      MMgrReport::encode_delta(from, to, app);
+    }
+    return bl.length();
+  };
+  // small differences are small whatever their sign, including across
+  // the wrap around
+  EXPECT_EQ(1u, size(10, 10));
+  EXPECT_EQ(1u, size(10, 11));
+  EXPECT_EQ(1u, size(10, 9));
+  EXPECT_EQ(1u, size(0, std::numeric_limits<uint64_t>::max()));
+  EXPECT_EQ(2u, size(1000, 900));
+  EXPECT_EQ(10u, size(0, uint64_t(1) << 63));
+}
+
+TEST(DaemonPerfCounters, FullReports)
+{
+  PerfCounterTypes types;
+  DaemonPerfCounters counters(types);
+  auto session = make_session();
+
+  Values values = {
+    {"osd.a", {PERFCOUNTER_U64, {7, 0, 0}}},
+    {"osd.lat", {LATENCY, {2500, 5, 30}}},
+    {"osd.z", {PERFCOUNTER_U64, {std::numeric_limits<uint64_t>::max(), 0, 0}}},
+  };
+  auto report = make_full_report(values);
+  declare(report.get(), values);
+  counters.update(*report, session.get());
+
+  EXPECT_EQ(7u, latest(counters, "osd.a"));
+  EXPECT_EQ(std::make_pair(uint64_t(2500), uint64_t(5)),
+	    latest_avg(counters, "osd.lat"));
+  EXPECT_EQ(std::numeric_limits<uint64_t>::max(), latest(counters, "osd.z"));
+  EXPECT_EQ(3u, session->declared_types.size());
+  EXPECT_EQ(30u, session->declared_types["osd.lat"].avgcount2);
+
+  values["osd.a"].second.value = 3;
+  counters.update(*make_full_report(values), session.get());
+  EXPECT_EQ(3u, latest(counters, "osd.a"));
+  EXPECT_EQ(2u, samples(counters, "osd.a"));
+}
+
+TEST(DaemonPerfCounters, DeltaReports)
+{
+  PerfCounterTypes types;
+  DaemonPerfCounters counters(types);
+  auto session = make_session();
+
+  // the declaring report is relative to zero
+  Values values = {
+    {"osd.a", {PERFCOUNTER_U64, {7, 0, 0}}},
+    {"osd.b", {PERFCOUNTER_U64, {0, 0, 0}}},
+    {"osd.lat", {LATENCY, {2500, 5, 30}}},
+  };
+  auto report = make_delta_report({}, values);
+  declare(report.get(), values);
+  counters.update(*report, session.get());
+  EXPECT_EQ(7u, latest(counters, "osd.a"));
+  EXPECT_EQ(0u, latest(counters, "osd.b"));
+  EXPECT_EQ(std::make_pair(uint64_t(2500), uint64_t(5)),
+	    latest_avg(counters, "osd.lat"));
+
+  // decreasing and wrapping values
+  auto sent = values;
+  values["osd.a"].second.value = 2;
+  values["osd.lat"].second = {std::numeric_limits<uint64_t>::max(), 4, 1};
+  counters.update(*make_delta_report(sent, values), session.get());
+  EXPECT_EQ(2u, latest(counters, "osd.a"));
+  EXPECT_EQ(std::make_pair(std::numeric_limits<uint64_t>::max(), uint64_t(4)),
+	    latest_avg(counters, "osd.lat"));
+  EXPECT_EQ(1u, session->declared_types["osd.lat"].avgcount2);
+
+  // nothing changed, but every counter still gets a sample
+  counters.update(*make_delta_report(values, values), session.get());
+  EXPECT_EQ(2u, latest(counters, "osd.a"));
+  EXPECT_EQ(0u, latest(counters, "osd.b"));
+  EXPECT_EQ(3u, samples(counters, "osd.a"));
+  EXPECT_EQ(3u, samples(counters, "osd.b"));
+}
+
+TEST(DaemonPerfCounters, DeclareUndeclare)
+{
+  PerfCounterTypes types;
+  DaemonPerfCounters counters(types);
+  auto session = make_session();
+
+  Values values = {
+    {"osd.a", {PERFCOUNTER_U64, {1, 0, 0}}},
+    {"osd.c", {PERFCOUNTER_U64, {3, 0, 0}}},
+  };
+  auto report = make_delta_report({}, values);
+  declare(report.get(), values);
+  counters.update(*report, session.get());
+
+  // a counter declared between the others shifts their indexes
+  auto sent = values;
+  values["osd.b"] = {PERFCOUNTER_U64, {2, 0, 0}};
+  values["osd.c"].second.value = 4;
+  report = make_delta_report(sent, values);
+  declare(report.get(), {{"osd.b", values["osd.b"]}});
+  counters.update(*report, session.get());
+  EXPECT_EQ(1u, latest(counters, "osd.a"));
+  EXPECT_EQ(2u, latest(counters, "osd.b"));
+  EXPECT_EQ(4u, latest(counters, "osd.c"));
+
+  // and so does one undeclared
+  sent = values;
+  values.erase("osd.a");
+  values["osd.c"].second.value = 5;
+  report = make_delta_report(sent, values);
+  report->undeclare_types.push_back("osd.a");
+  counters.update(*report, session.get());
+  EXPECT_EQ(2u, latest(counters, "osd.b"));
+  EXPECT_EQ(5u, latest(counters, "osd.c"));
+  EXPECT_EQ(0u, session->declared_types.count("osd.a"));
+  EXPECT_EQ(2u, samples(counters, "osd.a"));
+  EXPECT_EQ(3u, samples(counters, "osd.c"));
+}
+
+TEST(DaemonPerfCounters, SessionSwitch)
+{
+  PerfCounterTypes types;
+  DaemonPerfCounters counters(types);
+
+  // two sessions of a daemon with the same name, declaring different
+  // counters
+  auto session1 = make_session();
+  Values values1 = {
+    {"osd.a", {PERFCOUNTER_U64, {1, 0, 0}}},
+    {"osd.b", {PERFCOUNTER_U64, {2, 0, 0}}},
+  };
+  auto report = make_delta_report({}, values1);
+  declare(report.get(), values1);
+  counters.update(*report, session1.get());
+
+  auto session2 = make_session();
+  EXPECT_NE(session1->session_id, session2->session_id);
+  Values values2 = {
+    {"osd.b", {PERFCOUNTER_U64, {20, 0, 0}}},
+  };
+  report = make_delta_report({}, values2);
+  declare(report.get(), values2);
+  counters.update(*report, session2.get());
+  EXPECT_EQ(20u, latest(counters, "osd.b"));
+
+  // reports without declarations switching back and forth are applied
+  // to their own session's counters
+  auto sent1 = values1;
+  values1["osd.a"].second.value = 11;
+  values1["osd.b"].second.value = 12;
+  counters.update(*make_delta_report(sent1, values1), session1.get());
+  EXPECT_EQ(11u, latest(counters, "osd.a"));
+  EXPECT_EQ(12u, latest(counters, "osd.b"));
+
+  auto sent2 = values2;
+  values2["osd.b"].second.value = 21;
+  counters.update(*make_delta_report(sent2, values2), session2.get());
+  EXPECT_EQ(21u, latest(counters, "osd.b"));
+  EXPECT_EQ(2u, samples(counters, "osd.a"));
+
+  // the counters don't keep a closed session alive
+  session1.reset();
+  session2.reset();
+  auto session3 = make_session();
+  report = make_full_report(values2);
+  declare(report.get(), values2);
+  counters.update(*report, session3.get());
+  EXPECT_EQ(21u, latest(counters, "osd.b"));
+}
+
+TEST(DaemonPerfCounters, BadIndex)
+{
+  PerfCounterTypes types;
+  DaemonPerfCounters counters(types);
+  auto session = make_session();
+
+  Values values = {
+    {"osd.a", {PERFCOUNTER_U64, {1, 0, 0}}},
+  };
+  auto report = make_delta_report({}, values);
+  declare(report.get(), values);
+  counters.update(*report, session.get());
+
+  // a counter that was never declared
+  values["osd.b"] = {PERFCOUNTER_U64, {2, 0, 0}};
+  EXPECT_THROW(counters.update(*make_delta_report({}, values), session.get()),
+	       ceph::buffer::malformed_input);
+}
@@ -0,0 +1,232 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "mgr/DaemonState.h"
+#include "mgr/PerfCounterExposition.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const std::set<std::string> all_services = {
+  "mds", "mon", "osd", "rbd-mirror", "rgw", "tcmu-runner"};
+
+void declare(PerfCounterTypes *types, const std::string &path,
+	     enum perfcounter_type_d type, uint8_t priority = 5,
+	     const std::string &description = "")
+{
+  PerfCounterType t;
+  t.path = path;
+  t.description = description.empty() ? path : description;
+  t.nick = "";
+  t.type = type;
+  t.priority = priority;
+  t.unit = UNIT_NONE;
+  (*types)[path] = t;
+}
+
+// what a report carrying these values would leave in the counters
+void report(DaemonPerfCounters *counters, const std::string &path,
+	    uint64_t value, uint64_t count = 0)
+{
+  auto &type = counters->types.at(path);
+  auto i = counters->instances.find(path);
+  if (i == counters->instances.end()) {
+    i = counters->instances.emplace(path, type.type).first;
+  }
+  if (type.type & PERFCOUNTER_LONGRUNAVG) {
+    i->second.push_avg(ceph_clock_now(), value, count);
+  } else {
+    i->second.push(ceph_clock_now(), value);
+  }
+}
+
+std::string render(const PerfCounterExposition &exposition,
+		   int prio_limit = 5,
+		   const std::set<std::string> &services = all_services)
+{
+  std::string out;
+  exposition.render(prio_limit, services, &out);
+  return out;
+}
+
+} // anonymous namespace
+
+TEST(PerfCounterExposition, Types)
+{
+  PerfCounterTypes types;
+  declare(&types, "osd.numpg", PERFCOUNTER_U64, 5, "Placement groups");
+  declare(&types, "osd.op", (perfcounter_type_d)(PERFCOUNTER_U64 |
+						 PERFCOUNTER_COUNTER));
+  declare(&types, "osd.op_latency", (perfcounter_type_d)(PERFCOUNTER_TIME |
+							 PERFCOUNTER_LONGRUNAVG));
+  declare(&types, "osd.op_hist", (perfcounter_type_d)(PERFCOUNTER_U64 |
+						      PERFCOUNTER_HISTOGRAM));
+  declare(&types, "osd.debug", PERFCOUNTER_U64, 1);
+
+  DaemonPerfCounters counters(types);
+  report(&counters, "osd.numpg", 12);
+  report(&counters, "osd.op", 100);
+  report(&counters, "osd.op_latency", 2500000000, 5);
+  report(&counters, "osd.op_hist", 1);
+  report(&counters, "osd.debug", 1);
+
+  PerfCounterExposition exposition;
+  exposition.enable();
+  exposition.update({"osd", "0"}, counters);
+
+  ASSERT_EQ(
+    "\n# HELP ceph_osd_numpg Placement groups"
+    "\n# TYPE ceph_osd_numpg gauge"
+    "\nceph_osd_numpg{ceph_daemon=\"osd.0\"} 12.0"
+    "\n# HELP ceph_osd_op osd.op"
+    "\n# TYPE ceph_osd_op counter"
+    "\nceph_osd_op{ceph_daemon=\"osd.0\"} 100.0"
+    "\n# HELP ceph_osd_op_latency_count osd.op_latency Count"
+    "\n# TYPE ceph_osd_op_latency_count counter"
+    "\nceph_osd_op_latency_count{ceph_daemon=\"osd.0\"} 5.0"
+    "\n# HELP ceph_osd_op_latency_sum osd.op_latency Total"
+    "\n# TYPE ceph_osd_op_latency_sum counter"
+    "\nceph_osd_op_latency_sum{ceph_daemon=\"osd.0\"} 2.5",
+    render(exposition));
+
+  // low priority counters are only rendered on request
+  ASSERT_NE(std::string::npos,
+	    render(exposition, 0).find("ceph_osd_debug{"));
+}
+
+TEST(PerfCounterExposition, Daemons)
+{
+  PerfCounterTypes types;
+  declare(&types, "osd.numpg", PERFCOUNTER_U64);
+  declare(&types, "mds.inodes", PERFCOUNTER_U64);
+
+  DaemonPerfCounters osd0(types), osd1(types), mds(types);
+  report(&osd0, "osd.numpg", 1);
+  report(&osd1, "osd.numpg", 2);
+  report(&mds, "mds.inodes", 3);
+
+  PerfCounterExposition exposition;
+  exposition.enable();
+  exposition.update({"osd", "0"}, osd0);
+  exposition.update({"osd", "1"}, osd1);
+  exposition.update({"mds", "a"}, mds);
+
+  ASSERT_EQ(
+    "\n# HELP ceph_mds_inodes mds.inodes"
+    "\n# TYPE ceph_mds_inodes gauge"
+    "\nceph_mds_inodes{ceph_daemon=\"mds.a\"} 3.0"
+    "\n# HELP ceph_osd_numpg osd.numpg"
+    "\n# TYPE ceph_osd_numpg gauge"
+    "\nceph_osd_numpg{ceph_daemon=\"osd.0\"} 1.0"
+    "\nceph_osd_numpg{ceph_daemon=\"osd.1\"} 2.0",
+    render(exposition));
+
+  // services filter
+  ASSERT_EQ(
+    "\n# HELP ceph_mds_inodes mds.inodes"
+    "\n# TYPE ceph_mds_inodes gauge"
+    "\nceph_mds_inodes{ceph_daemon=\"mds.a\"} 3.0",
+    render(exposition, 5, {"mds"}));
+
+  // new values replace the old ones
+  report(&osd1, "osd.numpg", 4);
+  exposition.update({"osd", "1"}, osd1);
+  ASSERT_NE(std::string::npos,
+	    render(exposition).find("{ceph_daemon=\"osd.1\"} 4.0"));
+
+  // counters that are no longer reported are dropped
+  mds.instances.clear();
+  exposition.update({"mds", "a"}, mds);
+  ASSERT_EQ(std::string::npos, render(exposition).find("mds"));
+
+  exposition.remove({"osd", "0"});
+  exposition.remove({"osd", "1"});
+  ASSERT_EQ("", render(exposition));
+}
+
+TEST(PerfCounterExposition, Labels)
+{
+  PerfCounterTypes types;
+  declare(&types, "rbd_mirror_image_pool/ns/image.replay",
+	  (perfcounter_type_d)(PERFCOUNTER_U64 | PERFCOUNTER_COUNTER));
+  declare(&types, "data-sync-from-us-east.fetch_bytes",
+	  (perfcounter_type_d)(PERFCOUNTER_U64 | PERFCOUNTER_COUNTER));
+  declare(&types, "throttle-msgr_dispatch_throttler-", PERFCOUNTER_U64);
+
+  DaemonPerfCounters rbd_mirror(types), rgw(types);
+  report(&rbd_mirror, "rbd_mirror_image_pool/ns/image.replay", 7);
+  report(&rgw, "data-sync-from-us-east.fetch_bytes", 8);
+  report(&rgw, "throttle-msgr_dispatch_throttler-", 9);
+
+  PerfCounterExposition exposition;
+  exposition.enable();
+  exposition.update({"rbd-mirror", "a"}, rbd_mirror);
+  exposition.update({"rgw", "b"}, rgw);
+
+  auto out = render(exposition);
+  ASSERT_NE(std::string::npos, out.find(
+    "\nceph_rbd_mirror_image_replay{ceph_daemon=\"rbd-mirror.a\","
+    "pool=\"pool\",namespace=\"ns\",image=\"image\"} 7.0"));
+  ASSERT_NE(std::string::npos, out.find(
+    "\nceph_data_sync_from_us_east_fetch_bytes{ceph_daemon=\"rgw.b\"} 8.0"));
+  ASSERT_NE(std::string::npos, out.find(
+    "\nceph_data_sync_from_zone_fetch_bytes{ceph_daemon=\"rgw.b\","
+    "source_zone=\"us-east\"} 8.0"));
+  ASSERT_NE(std::string::npos, out.find(
+    "\nceph_throttle-msgr_dispatch_throttler_minus{ceph_daemon=\"rgw.b\"} "
+    "9.0"));
+}
+
+TEST(PerfCounterExposition, Priority)
+{
+  // daemons of different versions may declare the same counter with a
+  // different priority
+  PerfCounterTypes debug_types, useful_types;
+  declare(&debug_types, "osd.op", PERFCOUNTER_U64, 1);
+  declare(&useful_types, "osd.op", PERFCOUNTER_U64, 5);
+
+  DaemonPerfCounters osd0(debug_types), osd1(useful_types);
+  report(&osd0, "osd.op", 1);
+  report(&osd1, "osd.op", 2);
+
+  PerfCounterExposition exposition;
+  exposition.enable();
+  exposition.update({"osd", "0"}, osd0);
+  exposition.update({"osd", "1"}, osd1);
+
+  ASSERT_EQ(
+    "\n# HELP ceph_osd_op osd.op"
+    "\n# TYPE ceph_osd_op gauge"
+    "\nceph_osd_op{ceph_daemon=\"osd.1\"} 2.0",
+    render(exposition));
+  ASSERT_EQ(
+    "\n# HELP ceph_osd_op osd.op"
+    "\n# TYPE ceph_osd_op gauge"
+    "\nceph_osd_op{ceph_daemon=\"osd.0\"} 1.0"
+    "\nceph_osd_op{ceph_daemon=\"osd.1\"} 2.0",
+    render(exposition, 0));
+
+  // only osd.1 passes the limit, so the family goes with it
+  exposition.remove({"osd", "1"});
+  ASSERT_EQ("", render(exposition));
+}
+
+TEST(PerfCounterExposition, Enable)
+{
+  PerfCounterTypes types;
+  declare(&types, "osd.numpg", PERFCOUNTER_U64);
+  DaemonPerfCounters counters(types);
+  report(&counters, "osd.numpg", 1);
+
+  // reports are ignored until the exposition is first asked for
+  PerfCounterExposition exposition;
+  exposition.update({"osd", "0"}, counters);
+  ASSERT_EQ("", render(exposition));
+
+  ASSERT_TRUE(exposition.enable());
+  ASSERT_FALSE(exposition.enable());
+  exposition.update({"osd", "0"}, counters);
+  ASSERT_NE(std::string::npos,
+	    render(exposition).find("{ceph_daemon=\"osd.0\"} 1.0"));
+}
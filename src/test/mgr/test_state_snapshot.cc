@@ -0,0 +1,300 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <Python.h>
+
+#include "mgr/PyStateView.h"
+#include "mgr/StateSnapshot.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// a snapshot whose items are dumped from a private copy of a "map"
+std::shared_ptr<const StateSnapshot> make_snapshot(version_t version,
+						   int value,
+						   size_t list_size = 3,
+						   int *dumps = nullptr)
+{
+  auto s = std::make_shared<StateSnapshot>("test_map", version);
+  s->add_value("epoch", [version](ceph::Formatter *f) {
+    f->dump_unsigned("epoch", version);
+  });
+  s->add_dumped([value, dumps](ceph::Formatter *f) {
+    if (dumps != nullptr) {
+      ++*dumps;
+    }
+    f->dump_int("value", value);
+    f->open_object_section("nested");
+    f->dump_string("name", "n" + std::to_string(value));
+    f->close_section();
+    // already added above
+    f->dump_unsigned("epoch", 0);
+  });
+  s->add_list("items", list_size, [value](size_t n, ceph::Formatter *f) {
+    f->dump_int("n", n);
+    f->dump_int("value", value);
+  });
+  return s;
+}
+
+std::string dump(const StateSnapshot &s, const std::string &name)
+{
+  JSONFormatter f;
+  f.open_object_section("dump");
+  s.dump_value(name, &f);
+  f.close_section();
+  std::ostringstream ss;
+  f.flush(ss);
+  return ss.str();
+}
+
+} // anonymous namespace
+
+TEST(StateSnapshot, Keys)
+{
+  auto s = make_snapshot(5, 42);
+  EXPECT_EQ("test_map", s->get_what());
+  EXPECT_EQ(5u, s->get_version());
+  EXPECT_EQ((std::vector<std::string>{"epoch", "value", "nested", "items"}),
+	    s->get_keys());
+  EXPECT_TRUE(s->has_key("nested"));
+  EXPECT_FALSE(s->has_key("missing"));
+
+  EXPECT_EQ(nullptr, s->get_list("value"));
+  auto list = s->get_list("items");
+  ASSERT_NE(nullptr, list);
+  EXPECT_EQ(3u, list->size);
+}
+
+TEST(StateSnapshot, DumpedValues)
+{
+  int dumps = 0;
+  auto s = make_snapshot(5, 42, 3, &dumps);
+  EXPECT_EQ(1, dumps);
+  // each item only gets its own part of the dump
+  EXPECT_EQ("{\"epoch\":5}", dump(*s, "epoch"));
+  EXPECT_EQ("{\"value\":42}", dump(*s, "value"));
+  EXPECT_EQ("{\"nested\":{\"name\":\"n42\"}}", dump(*s, "nested"));
+  EXPECT_EQ("{\"nested\":{\"name\":\"n42\"}}", dump(*s, "nested"));
+  // the items are replayed, not dumped again
+  EXPECT_EQ(1, dumps);
+}
+
+TEST(StateSnapshot, DumpedTypes)
+{
+  StateSnapshot s("test_map", 1);
+  s.add_dumped([](ceph::Formatter *f) {
+    f->dump_stream("stream") << "a" << 1;
+    f->open_array_section("array");
+    f->dump_stream("s") << "b";
+    f->dump_float("f", 0.5);
+    f->dump_bool("b", true);
+    f->dump_format("q", "%d-%s", 7, "x");
+    f->dump_format_unquoted("u", "%d", 8);
+    f->close_section();
+    f->dump_stream("last") << "c";
+  });
+  EXPECT_EQ((std::vector<std::string>{"stream", "array", "last"}),
+	    s.get_keys());
+  EXPECT_EQ("{\"stream\":\"a1\"}", dump(s, "stream"));
+  EXPECT_EQ("{\"array\":[\"b\",0.5,true,\"7-x\",8]}", dump(s, "array"));
+  EXPECT_EQ("{\"last\":\"c\"}", dump(s, "last"));
+}
+
+TEST(StateSnapshotCache, ReuseSameVersion)
+{
+  StateSnapshotCache cache;
+  int builds = 0;
+  auto build = [&builds](StateSnapshot *s) {
+    ++builds;
+    s->add_value("x", [](ceph::Formatter *f) { f->dump_int("x", 1); });
+  };
+
+  auto s1 = cache.get("pg_stats", "pg_map", 10, build);
+  auto s2 = cache.get("pg_stats", "pg_map", 10, build);
+  EXPECT_EQ(s1, s2);
+  EXPECT_EQ(1, builds);
+
+  // another kind of snapshot of the same map is built separately
+  auto s3 = cache.get("pool_stats", "pg_map", 10, build);
+  EXPECT_NE(s1, s3);
+  EXPECT_EQ(2, builds);
+
+  auto s4 = cache.get("pg_stats", "pg_map", 11, build);
+  EXPECT_NE(s1, s4);
+  EXPECT_EQ(11u, s4->get_version());
+  EXPECT_EQ(3, builds);
+}
+
+TEST(StateSnapshotCache, FindAndAdd)
+{
+  StateSnapshotCache cache;
+  EXPECT_EQ(nullptr, cache.find("osd_map", 3));
+
+  auto s = cache.add("osd_map", std::make_shared<StateSnapshot>("osd_map", 3));
+  EXPECT_EQ(s, cache.find("osd_map", 3));
+  EXPECT_EQ(nullptr, cache.find("osd_map", 4));
+  EXPECT_EQ(nullptr, cache.find("pg_stats", 3));
+
+  // a snapshot of the same version is reused by get()
+  int builds = 0;
+  EXPECT_EQ(s, cache.get("osd_map", "osd_map", 3,
+			 [&builds](StateSnapshot *) { ++builds; }));
+  EXPECT_EQ(0, builds);
+}
+
+TEST(StateSnapshotCache, NewVersionDropsOlder)
+{
+  StateSnapshotCache cache;
+  int builds = 0;
+  auto build = [&builds](StateSnapshot *s) { ++builds; };
+
+  std::weak_ptr<const StateSnapshot> pool_stats =
+    cache.get("pool_stats", "pg_map", 10, build);
+  std::weak_ptr<const StateSnapshot> osd_map =
+    cache.get("osd_map", "osd_map", 3, build);
+  EXPECT_FALSE(pool_stats.expired());
+
+  // a newer pg map drops the other snapshots of the old one, but leaves
+  // the osd map alone
+  cache.get("pg_stats", "pg_map", 11, build);
+  EXPECT_TRUE(pool_stats.expired());
+  EXPECT_FALSE(osd_map.expired());
+  EXPECT_EQ(3, builds);
+
+  cache.get("osd_map", "osd_map", 3, build);
+  EXPECT_EQ(3, builds);
+}
+
+// ----------
+
+class PyStateViewTest : public ::testing::Test {
+public:
+  static void SetUpTestCase() {
+    Py_Initialize();
+    ASSERT_EQ(0, PyType_Ready(&StateViewType));
+    ASSERT_EQ(0, PyType_Ready(&StateViewListType));
+  }
+
+  // run python statements with the view bound to "view"
+  void run(PyObject *view, const char *code) {
+    PyObject *globals = PyDict_New();
+    PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+    PyDict_SetItemString(globals, "view", view);
+    PyObject *r = PyRun_String(code, Py_file_input, globals, globals);
+    if (r == nullptr) {
+      PyErr_Print();
+    }
+    EXPECT_NE(nullptr, r) << code;
+    Py_XDECREF(r);
+    Py_DECREF(globals);
+  }
+};
+
+TEST_F(PyStateViewTest, Mapping)
+{
+  PyObject *view = construct_state_view(make_snapshot(5, 42));
+  ASSERT_NE(nullptr, view);
+  run(view, R"(
+assert len(view) == 4
+assert view.version == 5
+assert list(view) == ['epoch', 'value', 'nested', 'items']
+assert view.keys() == ['epoch', 'value', 'nested', 'items']
+assert 'value' in view
+assert 'missing' not in view
+assert 1 not in view
+assert view['epoch'] == 5
+assert view['value'] == 42
+assert view['nested'] == {'name': 'n42'}
+assert view.get('value') == 42
+assert view.get('missing') is None
+assert view.get('missing', 7) == 7
+try:
+    view['missing']
+    assert False
+except KeyError:
+    pass
+values = view.values()
+assert values[:3] == [5, 42, {'name': 'n42'}]
+assert len(values[3]) == 3
+items = view.items()
+assert [k for k, v in items] == view.keys()
+assert items[1] == ('value', 42)
+# items are converted once and then cached
+assert view['nested'] is view['nested']
+)");
+  Py_DECREF(view);
+}
+
+TEST_F(PyStateViewTest, List)
+{
+  PyObject *view = construct_state_view(make_snapshot(5, 42, 4));
+  ASSERT_NE(nullptr, view);
+  run(view, R"(
+items = view['items']
+assert len(items) == 4
+assert items[0] == {'n': 0, 'value': 42}
+assert items[-1] == {'n': 3, 'value': 42}
+assert items[1:3] == [{'n': 1, 'value': 42}, {'n': 2, 'value': 42}]
+assert [i['n'] for i in items] == [0, 1, 2, 3]
+assert items[2] is items[2]
+try:
+    items[4]
+    assert False
+except IndexError:
+    pass
+)");
+  Py_DECREF(view);
+}
+
+TEST_F(PyStateViewTest, Snapshot)
+{
+  auto s = make_snapshot(5, 42);
+  PyObject *view = construct_state_view(s);
+  ASSERT_NE(nullptr, view);
+  EXPECT_EQ(s.get(), get_state_view_snapshot(view));
+
+  PyObject *other = PyDict_New();
+  EXPECT_EQ(nullptr, get_state_view_snapshot(other));
+  Py_DECREF(other);
+  Py_DECREF(view);
+}
+
+TEST_F(PyStateViewTest, ConsistentAfterNewerMap)
+{
+  StateSnapshotCache cache;
+  auto build = [](int value) {
+    return [value](StateSnapshot *s) {
+      s->add_value("value", [value](ceph::Formatter *f) {
+	f->dump_int("value", value);
+      });
+      s->add_list("items", 2, [value](size_t n, ceph::Formatter *f) {
+	f->dump_int("value", value);
+      });
+    };
+  };
+
+  PyObject *old_view = construct_state_view(
+    cache.get("pg_stats", "pg_map", 1, build(1)));
+  ASSERT_NE(nullptr, old_view);
+  run(old_view, "assert view['items'][0]['value'] == 1");
+
+  // a newer map replaces the cached snapshot, but the old view still
+  // sees version 1, including the items it has not converted yet
+  PyObject *new_view = construct_state_view(
+    cache.get("pg_stats", "pg_map", 2, build(2)));
+  ASSERT_NE(nullptr, new_view);
+  run(old_view, R"(
+assert view.version == 1
+assert view['value'] == 1
+assert view['items'][1]['value'] == 1
+)");
+  run(new_view, R"(
+assert view.version == 2
+assert view['value'] == 2
+assert view['items'][1]['value'] == 2
+)");
+  Py_DECREF(old_view);
+  Py_DECREF(new_view);
+}
@@ -164,3 +164,218 @@ TEST(pgmap, dump_object_stat_sum_2)
   ASSERT_EQ(percentify(0), tbl.get(0, col++));
   ASSERT_EQ(stringify(byte_u_t(avail/pool.size)), tbl.get(0, col++));
 }
+
+namespace {
+  pg_stat_t make_pg_stat(unsigned seed, int osds)
+  {
+    pg_stat_t s;
+    s.state = PG_STATE_ACTIVE | PG_STATE_CLEAN;
+    for (int i = 0; i < 3; ++i) {
+      s.up.push_back((seed + i * 7) % osds);
+    }
+    s.acting = s.up;
+    s.up_primary = s.acting_primary = s.up[0];
+    s.stats.sum.num_objects = seed % 100;
+    s.stats.sum.num_bytes = s.stats.sum.num_objects * 4096;
+    s.log_size = s.ondisk_log_size = seed % 30;
+    s.purged_snaps.insert(snapid_t(1), 10);
+    return s;
+  }
+
+  void apply(PGMap &pgmap, PGMap::Incremental &inc)
+  {
+    inc.version = pgmap.version + 1;
+    pgmap.apply_incremental(g_ceph_context, inc);
+    inc = PGMap::Incremental();
+  }
+
+  // the aggregate stats without the entries an update leaves at zero
+  template <typename M>
+  std::map<typename M::key_type, typename M::mapped_type> nonzero(const M &m)
+  {
+    std::map<typename M::key_type, typename M::mapped_type> r;
+    for (auto &[k, v] : m) {
+      if (v != typename M::mapped_type{}) {
+	r.emplace(k, v);
+      }
+    }
+    return r;
+  }
+
+  template <typename M>
+  std::map<typename M::key_type, typename M::mapped_type> nonempty(const M &m)
+  {
+    std::map<typename M::key_type, typename M::mapped_type> r;
+    for (auto &[k, v] : m) {
+      if (!v.empty()) {
+	r.emplace(k, v);
+      }
+    }
+    return r;
+  }
+
+  std::map<int32_t, std::tuple<int32_t, int32_t, int32_t>>
+  pg_counts(const PGMap &pgmap)
+  {
+    std::map<int32_t, std::tuple<int32_t, int32_t, int32_t>> r;
+    for (auto &[osd, c] : pgmap.num_pg_by_osd) {
+      if (c.acting || c.up_not_acting || c.primary) {
+	r[osd] = {c.acting, c.up_not_acting, c.primary};
+      }
+    }
+    return r;
+  }
+
+  void expect_same_sum(const pool_stat_t &a, const pool_stat_t &b)
+  {
+    EXPECT_TRUE(a.stats == b.stats);
+    EXPECT_EQ(a.log_size, b.log_size);
+    EXPECT_EQ(a.ondisk_log_size, b.ondisk_log_size);
+    EXPECT_EQ(a.up, b.up);
+    EXPECT_EQ(a.acting, b.acting);
+  }
+
+  // the stats kept up to date by apply_incremental() and
+  // calc_purged_snaps() are the ones of a fresh calc_stats()
+  void expect_fresh_stats(PGMap &pgmap)
+  {
+    pgmap.calc_purged_snaps();
+    PGMap fresh;
+    fresh.pg_stat = pgmap.pg_stat;
+    fresh.calc_stats();
+    fresh.calc_purged_snaps();
+
+    EXPECT_EQ(fresh.num_pg, pgmap.num_pg);
+    EXPECT_EQ(fresh.num_pg_active, pgmap.num_pg_active);
+    EXPECT_EQ(fresh.num_pg_unknown, pgmap.num_pg_unknown);
+    EXPECT_EQ(nonzero(fresh.num_pg_by_state), nonzero(pgmap.num_pg_by_state));
+    EXPECT_EQ(nonzero(fresh.num_pg_by_pool), nonzero(pgmap.num_pg_by_pool));
+    for (auto &[pool, n] : nonzero(fresh.num_pg_by_pool)) {
+      EXPECT_EQ(nonzero(fresh.num_pg_by_pool_state[pool]),
+		nonzero(pgmap.num_pg_by_pool_state[pool]));
+      expect_same_sum(fresh.pg_pool_sum[pool], pgmap.pg_pool_sum[pool]);
+    }
+    expect_same_sum(fresh.pg_sum, pgmap.pg_sum);
+    EXPECT_EQ(pg_counts(fresh), pg_counts(pgmap));
+    EXPECT_EQ(nonempty(fresh.pg_by_osd), nonempty(pgmap.pg_by_osd));
+    EXPECT_EQ(nonzero(fresh.blocked_by_sum), nonzero(pgmap.blocked_by_sum));
+    EXPECT_EQ(fresh.purged_snaps, pgmap.purged_snaps);
+  }
+}
+
+TEST(pgmap, apply_incremental)
+{
+  const int pools = 3, pgs = 300, osds = 20;
+  PGMap pgmap;
+  PGMap::Incremental inc;
+  for (int i = 0; i < pgs; ++i) {
+    inc.pg_stat_updates[pg_t(i / pools, i % pools)] = make_pg_stat(i, osds);
+  }
+  apply(pgmap, inc);
+  expect_fresh_stats(pgmap);
+
+  // stats only, which take the sameosds path
+  for (int i = 0; i < pgs; i += 3) {
+    pg_t pgid(i / pools, i % pools);
+    auto s = pgmap.pg_stat[pgid];
+    s.stats.sum.num_objects += 5;
+    s.stats.sum.num_bytes += 5 * 4096;
+    s.log_size += 1;
+    s.state |= PG_STATE_SCRUBBING;
+    inc.pg_stat_updates[pgid] = s;
+  }
+  apply(pgmap, inc);
+  expect_fresh_stats(pgmap);
+
+  // moved pgs, a new primary and blocked pgs
+  for (int i = 1; i < pgs; i += 7) {
+    pg_t pgid(i / pools, i % pools);
+    auto s = pgmap.pg_stat[pgid];
+    switch (i % 3) {
+    case 0:
+      s.up[1] = (s.up[1] + 1) % osds;
+      break;
+    case 1:
+      s.acting = {s.acting[1], s.acting[0], s.acting[2]};
+      s.up_primary = s.acting_primary = s.acting[0];
+      break;
+    case 2:
+      s.blocked_by.push_back(i % osds);
+      s.state = PG_STATE_PEERING;
+      break;
+    }
+    inc.pg_stat_updates[pgid] = s;
+  }
+  apply(pgmap, inc);
+  expect_fresh_stats(pgmap);
+
+  // removed and new pgs
+  inc.pg_remove.insert(pg_t(0, 0));
+  inc.pg_remove.insert(pg_t(1, 2));
+  inc.pg_stat_updates[pg_t(pgs, 1)] = make_pg_stat(pgs, osds);
+  apply(pgmap, inc);
+  expect_fresh_stats(pgmap);
+}
+
+TEST(pgmap, calc_purged_snaps)
+{
+  const int pools = 3, pgs = 30, osds = 10;
+  PGMap pgmap;
+  PGMap::Incremental inc;
+  for (int i = 0; i < pgs; ++i) {
+    inc.pg_stat_updates[pg_t(i / pools, i % pools)] = make_pg_stat(i, osds);
+  }
+  apply(pgmap, inc);
+  expect_fresh_stats(pgmap);
+  ASSERT_EQ(3u, pgmap.purged_snaps.size());
+
+  // every pg of pool 1 purges more snaps
+  for (int i = 0; i < pgs / pools; ++i) {
+    auto s = pgmap.pg_stat[pg_t(i, 1)];
+    s.purged_snaps.insert(snapid_t(20), 5);
+    inc.pg_stat_updates[pg_t(i, 1)] = s;
+    apply(pgmap, inc);
+    expect_fresh_stats(pgmap);
+  }
+  ASSERT_TRUE(pgmap.purged_snaps[1].contains(snapid_t(20), 5));
+  ASSERT_FALSE(pgmap.purged_snaps[0].contains(snapid_t(20)));
+
+  // an unknown pg, then its removal
+  auto s = pgmap.pg_stat[pg_t(3, 2)];
+  s.state = 0;
+  inc.pg_stat_updates[pg_t(3, 2)] = s;
+  apply(pgmap, inc);
+  expect_fresh_stats(pgmap);
+  ASSERT_EQ(0u, pgmap.purged_snaps.count(2));
+  inc.pg_remove.insert(pg_t(3, 2));
+  apply(pgmap, inc);
+  expect_fresh_stats(pgmap);
+  ASSERT_EQ(1u, pgmap.purged_snaps.count(2));
+
+  // nothing changed
+  apply(pgmap, inc);
+  expect_fresh_stats(pgmap);
+}
+
+TEST(pgmap, calc_stats_parallel)
+{
+  // large enough for several shards
+  const int pools = 5, pgs = 100000, osds = 100;
+  PGMap serial;
+  for (int i = 0; i < pgs; ++i) {
+    serial.pg_stat[pg_t(i / pools, i % pools)] = make_pg_stat(i, osds);
+  }
+  serial.calc_stats(1);
+  PGMap parallel;
+  parallel.pg_stat = serial.pg_stat;
+  // the threads are kept from one call to the next
+  for (int i = 0; i < 3; ++i) {
+    parallel.calc_stats(4);
+    expect_same_sum(serial.pg_sum, parallel.pg_sum);
+    for (int pool = 0; pool < pools; ++pool) {
+      expect_same_sum(serial.pg_pool_sum[pool], parallel.pg_pool_sum[pool]);
+    }
+    EXPECT_EQ(serial.num_pg, parallel.num_pg);
+    EXPECT_EQ(pg_counts(serial), pg_counts(parallel));
+  }
+}
@@ -0,0 +1,93 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "global/global_context.h"
+#include "include/stringify.h"
+#include "mon/LogVersionCodec.h"
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace {
+
+// interleaved entries of a few channels, each repeating itself enough
+// to compress
+multimap<utime_t,LogEntry> make_entries()
+{
+  const vector<string> channels = {"cluster", "audit", "cephadm"};
+  multimap<utime_t,LogEntry> entries;
+  for (uint64_t seq = 1; seq <= 60; ++seq) {
+    LogEntry e;
+    e.name.set_id("a");
+    e.rank = entity_name_t::MON(0);
+    e.stamp = utime_t(1000 + seq, 0);
+    e.seq = seq;
+    e.prio = seq % 5 ? CLOG_INFO : CLOG_WARN;
+    e.channel = channels[seq % channels.size()];
+    e.msg = e.channel + " message about pg 1." + stringify(seq % 7) +
+      " on osd." + stringify(seq % 3);
+    entries.emplace(e.stamp, e);
+  }
+  return entries;
+}
+
+void round_trip(LogVersionCodec *codec, __u8 v,
+		Compressor::CompressionAlgorithm alg, bufferlist *bl)
+{
+  auto entries = make_entries();
+  uint64_t raw_bytes = codec->encode(entries, v, CEPH_FEATURES_ALL, alg, *bl);
+  ASSERT_GT(raw_bytes, 0u);
+
+  vector<LogEntry> decoded;
+  ostringstream err;
+  ASSERT_EQ(0, codec->decode(*bl, &decoded, &err)) << err.str();
+  ASSERT_EQ(entries.size(), decoded.size());
+  auto d = decoded.begin();
+  for (auto& [stamp, e] : entries) {
+    EXPECT_EQ(e.stamp, d->stamp);
+    EXPECT_EQ(e.seq, d->seq);
+    EXPECT_EQ(e.prio, d->prio);
+    EXPECT_EQ(e.channel, d->channel);
+    EXPECT_EQ(e.msg, d->msg);
+    EXPECT_EQ(e.name, d->name);
+    EXPECT_EQ(e.rank, d->rank);
+    ++d;
+  }
+}
+
+} // anonymous namespace
+
+TEST(LogVersionCodec, V1)
+{
+  LogVersionCodec codec(g_ceph_context);
+  bufferlist bl;
+  round_trip(&codec, 1, Compressor::COMP_ALG_NONE, &bl);
+
+  // the old format cannot be compressed
+  bufferlist compressed;
+  round_trip(&codec, 1, Compressor::COMP_ALG_SNAPPY, &compressed);
+  ASSERT_EQ(bl.length(), compressed.length());
+}
+
+TEST(LogVersionCodec, V2)
+{
+  LogVersionCodec codec(g_ceph_context);
+  bufferlist bl;
+  round_trip(&codec, 2, Compressor::COMP_ALG_NONE, &bl);
+}
+
+TEST(LogVersionCodec, V2Compressed)
+{
+  LogVersionCodec codec(g_ceph_context);
+  bufferlist plain, compressed;
+  round_trip(&codec, 2, Compressor::COMP_ALG_NONE, &plain);
+  round_trip(&codec, 2, Compressor::COMP_ALG_SNAPPY, &compressed);
+  ASSERT_LT(compressed.length(), plain.length());
+
+  // a fresh codec has to find the compressor from the chunks
+  LogVersionCodec other(g_ceph_context);
+  vector<LogEntry> decoded;
+  ostringstream err;
+  ASSERT_EQ(0, other.decode(compressed, &decoded, &err)) << err.str();
+  ASSERT_EQ(make_entries().size(), decoded.size());
+}
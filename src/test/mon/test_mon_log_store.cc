@@ -0,0 +1,233 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "common/ceph_context.h"
+#include "common/errno.h"
+#include "global/global_context.h"
+#include "mon/MonitorDBStore.h"
+#include "mon/MonitorLogStore.h"
+#include "include/stringify.h"
+#include "gtest/gtest.h"
+
+using namespace std;
+
+class MonitorLogStoreTest : public ::testing::Test {
+public:
+  const string path = "mon_log_store_temp_dir";
+
+  void SetUp() override {
+    int r = ::mkdir(path.c_str(), 0777);
+    if (r < 0 && errno != EEXIST) {
+      r = -errno;
+      cerr << __func__ << ": unable to create " << path << ": "
+	   << cpp_strerror(r) << std::endl;
+    }
+    ASSERT_EQ(0, r);
+    g_ceph_context->_conf.set_val("mon_log_store_prefixes", "paxos,osdmap");
+  }
+
+  void TearDown() override {
+    g_ceph_context->_conf.set_val("mon_log_store_prefixes", "");
+    g_ceph_context->_conf.set_val("mon_log_store_segment_size", "64M");
+    string cmd = string("rm -r ") + path;
+    ASSERT_EQ(0, ::system(cmd.c_str()));
+  }
+
+  int count_segments() {
+    int n = 0;
+    DIR *dir = ::opendir((path + "/store.log").c_str());
+    if (!dir) {
+      return -errno;
+    }
+    while (struct dirent *de = ::readdir(dir)) {
+      if (string(de->d_name).find(".seg") != string::npos) {
+	++n;
+      }
+    }
+    ::closedir(dir);
+    return n;
+  }
+
+  static bufferlist value(const string& s) {
+    bufferlist bl;
+    bl.append(s);
+    return bl;
+  }
+};
+
+TEST_F(MonitorLogStoreTest, PutGetErase) {
+  {
+    MonitorDBStore store(path);
+    ASSERT_EQ(0, store.create_and_open(cerr));
+    auto t = std::make_shared<MonitorDBStore::Transaction>();
+    for (version_t v = 1; v <= 10; ++v) {
+      t->put("paxos", v, value("paxos" + stringify(v)));
+      t->put("osdmap", v, value("osdmap" + stringify(v)));
+    }
+    t->put("paxos", "last_committed", 10);
+    t->put("auth", 1, value("auth1"));
+    ASSERT_EQ(0, store.apply_transaction(t));
+
+    t = std::make_shared<MonitorDBStore::Transaction>();
+    for (version_t v = 1; v <= 5; ++v) {
+      t->erase("paxos", v);
+    }
+    t->erase_range("osdmap", "1", "5");
+    t->put("paxos", "first_committed", 6);
+    ASSERT_EQ(0, store.apply_transaction(t));
+    store.close();
+  }
+  // the versions come back from the log, everything else from the db
+  MonitorDBStore store(path);
+  ASSERT_EQ(0, store.open(cerr));
+  for (version_t v = 1; v <= 10; ++v) {
+    bufferlist bl;
+    if (v <= 5) {
+      ASSERT_EQ(-ENOENT, store.get("paxos", v, bl));
+      ASSERT_FALSE(store.exists("paxos", v));
+    } else {
+      ASSERT_EQ(0, store.get("paxos", v, bl));
+      ASSERT_EQ("paxos" + stringify(v), bl.to_str());
+    }
+  }
+  // "10" sorts before "5"
+  ASSERT_FALSE(store.exists("osdmap", 1));
+  ASSERT_FALSE(store.exists("osdmap", 10));
+  ASSERT_FALSE(store.exists("osdmap", 4));
+  ASSERT_TRUE(store.exists("osdmap", 5));
+  ASSERT_EQ(10u, store.get("paxos", "last_committed"));
+  ASSERT_EQ(6u, store.get("paxos", "first_committed"));
+  bufferlist bl;
+  ASSERT_EQ(0, store.get("auth", 1, bl));
+
+  // iterating over a prefix sees both stores, in order
+  vector<string> keys;
+  for (auto it = store.get_iterator("paxos"); it->valid(); it->next()) {
+    keys.push_back(it->key());
+  }
+  vector<string> expected = {"10", "6", "7", "8", "9",
+			     "first_committed", "last_committed"};
+  ASSERT_EQ(expected, keys);
+  store.close();
+}
+
+TEST_F(MonitorLogStoreTest, TrimSegments) {
+  g_ceph_context->_conf.set_val("mon_log_store_segment_size", "1M");
+  MonitorDBStore store(path);
+  ASSERT_EQ(0, store.create_and_open(cerr));
+  bufferlist big;
+  big.append_zero(256 << 10);
+  for (version_t v = 1; v <= 40; ++v) {
+    auto t = std::make_shared<MonitorDBStore::Transaction>();
+    t->put("paxos", v, big);
+    t->put("paxos", "last_committed", v);
+    ASSERT_EQ(0, store.apply_transaction(t));
+  }
+  int segments = count_segments();
+  ASSERT_GE(segments, 10);
+
+  // trimming all but the last versions drops the old segments
+  auto t = std::make_shared<MonitorDBStore::Transaction>();
+  for (version_t v = 1; v <= 36; ++v) {
+    t->erase("paxos", v);
+  }
+  ASSERT_EQ(0, store.apply_transaction(t));
+  ASSERT_LE(count_segments(), 3);
+  for (version_t v = 37; v <= 40; ++v) {
+    bufferlist bl;
+    ASSERT_EQ(0, store.get("paxos", v, bl));
+    ASSERT_EQ(big.length(), bl.length());
+  }
+  store.close();
+}
+
+TEST_F(MonitorLogStoreTest, UncommittedRecords) {
+  string log_path = path + "/store.log";
+  {
+    MonitorLogStore log(g_ceph_context, log_path, 1 << 20);
+    ASSERT_EQ(0, log.open(true, 0, cerr));
+    uint64_t seq;
+    MonitorLogStore::Transaction t1;
+    t1.put("paxos", "1", value("one"));
+    ASSERT_EQ(0, log.submit(t1, &seq));
+    ASSERT_EQ(1u, seq);
+    log.commit(seq);
+    MonitorLogStore::Transaction t2;
+    t2.put("paxos", "2", value("two"));
+    t2.erase("paxos", "1");
+    ASSERT_EQ(0, log.submit(t2, &seq));
+    ASSERT_EQ(2u, seq);
+    // not visible until committed
+    ASSERT_TRUE(log.exists("paxos", "1"));
+    ASSERT_FALSE(log.exists("paxos", "2"));
+  }
+  // the second record never made it to the kv store
+  MonitorLogStore log(g_ceph_context, log_path, 1 << 20);
+  ASSERT_EQ(0, log.open(false, 1, cerr));
+  bufferlist bl;
+  ASSERT_EQ(0, log.get("paxos", "1", &bl));
+  ASSERT_EQ("one", bl.to_str());
+  ASSERT_FALSE(log.exists("paxos", "2"));
+
+  uint64_t seq;
+  MonitorLogStore::Transaction t;
+  t.put("paxos", "2", value("two again"));
+  ASSERT_EQ(0, log.submit(t, &seq));
+  ASSERT_EQ(2u, seq);
+  log.commit(seq);
+  bl.clear();
+  ASSERT_EQ(0, log.get("paxos", "2", &bl));
+  ASSERT_EQ("two again", bl.to_str());
+}
+
+TEST_F(MonitorLogStoreTest, UncommittedTrim) {
+  string log_path = path + "/store.log";
+  bufferlist big;
+  big.append_zero(600 << 10);
+  {
+    MonitorLogStore log(g_ceph_context, log_path, 1 << 20);
+    ASSERT_EQ(0, log.open(true, 0, cerr));
+    uint64_t seq;
+    MonitorLogStore::Transaction t1;
+    t1.put("paxos", "1", big);
+    ASSERT_EQ(0, log.submit(t1, &seq));
+    log.commit(seq);
+    MonitorLogStore::Transaction t2;
+    t2.put("paxos", "2", big);
+    ASSERT_EQ(0, log.submit(t2, &seq));
+    log.commit(seq);
+    ASSERT_EQ(2, count_segments());
+
+    // the record erasing the only value of the first segment starts a
+    // new one, but the first one has to stay until it is committed
+    MonitorLogStore::Transaction t3;
+    t3.erase("paxos", "1");
+    t3.put("paxos", "3", big);
+    ASSERT_EQ(0, log.submit(t3, &seq));
+    ASSERT_EQ(3u, seq);
+    ASSERT_EQ(3, count_segments());
+  }
+  // the erase never made it to the kv store
+  {
+    MonitorLogStore log(g_ceph_context, log_path, 1 << 20);
+    ASSERT_EQ(0, log.open(false, 2, cerr));
+    bufferlist bl;
+    ASSERT_EQ(0, log.get("paxos", "1", &bl));
+    ASSERT_EQ(big.length(), bl.length());
+    ASSERT_FALSE(log.exists("paxos", "3"));
+    ASSERT_EQ(3, count_segments());
+
+    // once it does, the first segment goes
+    uint64_t seq;
+    MonitorLogStore::Transaction t;
+    t.erase("paxos", "1");
+    ASSERT_EQ(0, log.submit(t, &seq));
+    ASSERT_EQ(3u, seq);
+    log.commit(seq);
+    ASSERT_FALSE(log.exists("paxos", "1"));
+    ASSERT_EQ(2, count_segments());
+  }
+}
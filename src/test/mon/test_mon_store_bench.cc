@@ -0,0 +1,188 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Synthetic mon store workload: commits paxos-like transactions to a
+ * MonitorDBStore, each adding a new version to a few service prefixes
+ * and trimming the oldest ones the way PaxosService does, and prints
+ * the commit latency and the size of the store, with the versions kept
+ * in the kv store and in the log store.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "common/ceph_argparse.h"
+#include "common/common_init.h"
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "include/stringify.h"
+#include "mon/MonitorDBStore.h"
+
+using namespace std;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double us_since(clock_type::time_point start)
+{
+  return std::chrono::duration<double, std::micro>(
+    clock_type::now() - start).count();
+}
+
+void usage()
+{
+  cout << "usage: ceph_test_mon_store_bench [options] <dir>\n"
+       << "  --backend <kv|log|both>  where to keep the versions "
+       << "(default both)\n"
+       << "  --commits <n>            transactions to commit (default 20000)\n"
+       << "  --value-size <bytes>     size of a paxos value (default 16384)\n"
+       << "  --keep <n>               versions kept per prefix "
+       << "(default 500)\n"
+       << "  --trim-every <n>         commits between trims (default 50)\n"
+       << std::endl;
+}
+
+const vector<string> prefixes = {"paxos", "osdmap", "logm"};
+
+int run(const string& dir, bool use_log, int commits, int value_size,
+	int keep, int trim_every)
+{
+  g_ceph_context->_conf.set_val(
+    "mon_log_store_prefixes", use_log ? "paxos,osdmap,logm" : "");
+  if (::mkdir(dir.c_str(), 0755) < 0) {
+    cerr << "unable to create " << dir << ": " << cpp_strerror(errno)
+	 << std::endl;
+    return 1;
+  }
+  MonitorDBStore store(dir);
+  ostringstream out;
+  if (store.create_and_open(out) < 0) {
+    cerr << "unable to create the store in " << dir << ": " << out.str()
+	 << std::endl;
+    return 1;
+  }
+
+  std::mt19937_64 rng(42);
+  bufferlist paxos_value, service_value, log_value;
+  for (int i = 0; i < value_size; i += sizeof(uint64_t)) {
+    uint64_t r = rng();
+    paxos_value.append((const char*)&r, sizeof(r));
+  }
+  service_value.substr_of(paxos_value, 0, paxos_value.length() / 2);
+  log_value.substr_of(paxos_value, 0, std::min(4096u,
+					       paxos_value.length()));
+
+  vector<double> latencies;
+  latencies.reserve(commits);
+  version_t first_committed = 1;
+  for (version_t v = 1; v <= (version_t)commits; ++v) {
+    auto t = std::make_shared<MonitorDBStore::Transaction>();
+    t->put("paxos", v, paxos_value);
+    t->put("paxos", "last_committed", v);
+    t->put("osdmap", v, service_value);
+    t->put("osdmap", "last_committed", v);
+    t->put("logm", v, log_value);
+    t->put("logm", "last_committed", v);
+    if (v % trim_every == 0 && v > (version_t)keep) {
+      version_t trim_to = v - keep;
+      for (auto& prefix : prefixes) {
+	for (version_t i = first_committed; i < trim_to; ++i) {
+	  t->erase(prefix, i);
+	}
+	t->put(prefix, "first_committed", trim_to);
+	t->compact_range(prefix, stringify(first_committed - 1),
+			 stringify(trim_to));
+      }
+      first_committed = trim_to;
+    }
+    auto start = clock_type::now();
+    store.apply_transaction(t);
+    latencies.push_back(us_since(start));
+  }
+
+  std::map<string, uint64_t> extras;
+  uint64_t size = store.get_estimated_size(extras);
+  store.close();
+  string cmd = string("rm -r ") + dir;
+  if (::system(cmd.c_str()) != 0) {
+    cerr << "unable to remove " << dir << std::endl;
+  }
+
+  if (!latencies.empty()) {
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (auto l : latencies) {
+      total += l;
+    }
+    cout << (use_log ? "log" : "kv") << ": " << commits
+	 << " commits, us per commit: mean " << total / latencies.size()
+	 << " p50 " << latencies[latencies.size() / 2]
+	 << " p99 " << latencies[latencies.size() * 99 / 100]
+	 << " p999 " << latencies[latencies.size() * 999 / 1000]
+	 << " max " << latencies.back()
+	 << ", store size " << size / 1024 << " KiB" << std::endl;
+  }
+  return 0;
+}
+
+} // anonymous namespace
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_MON,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  string backend = "both";
+  int commits = 20000;
+  int value_size = 16384;
+  int keep = 500;
+  int trim_every = 50;
+  std::string val;
+  for (auto i = args.begin(); i != args.end(); ) {
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_flag(args, i, "-h", "--help", (char*)NULL)) {
+      usage();
+      return 0;
+    } else if (ceph_argparse_witharg(args, i, &val, "--backend", (char*)NULL)) {
+      backend = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--commits", (char*)NULL)) {
+      commits = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--value-size", (char*)NULL)) {
+      value_size = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--keep", (char*)NULL)) {
+      keep = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--trim-every", (char*)NULL)) {
+      trim_every = std::stoi(val);
+    } else {
+      ++i;
+    }
+  }
+  if (args.size() != 1 || commits < 0 || value_size <= 0 || keep <= 0 ||
+      trim_every <= 0 ||
+      (backend != "kv" && backend != "log" && backend != "both")) {
+    usage();
+    return 1;
+  }
+  string dir = args[0];
+
+  int r = 0;
+  if (backend != "log") {
+    r = run(dir + "/kv", false, commits, value_size, keep, trim_every);
+  }
+  if (r == 0 && backend != "kv") {
+    r = run(dir + "/log", true, commits, value_size, keep, trim_every);
+  }
+  return r;
+}
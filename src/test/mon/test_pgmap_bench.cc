@@ -0,0 +1,202 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Synthetic PGMap workload: builds a PGMap, applies a stream of pg stat
+ * updates to it in incrementals the way the mgr does on every report,
+ * and prints the latency of applying them and of recalculating the
+ * aggregate stats.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "common/ceph_argparse.h"
+#include "mon/PGMap.h"
+
+using namespace std;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double ms_since(clock_type::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(
+    clock_type::now() - start).count();
+}
+
+void usage()
+{
+  cout << "usage: ceph_test_mon_pgmap_bench [options]\n"
+       << "  --pools <n>        number of pools (default 4)\n"
+       << "  --pgs <n>          number of pgs (default 100000)\n"
+       << "  --osds <n>         number of osds (default 1000)\n"
+       << "  --updates <n>      pg stat updates to apply (default 1000000)\n"
+       << "  --batch <n>        pg stat updates per incremental "
+       << "(default 10000)\n"
+       << "  --moved <percent>  updates that change the up/acting sets "
+       << "(default 1)\n"
+       << std::endl;
+}
+
+pg_stat_t make_pg_stat(std::mt19937_64 &rng, int osds, unsigned seed)
+{
+  pg_stat_t s;
+  s.state = PG_STATE_ACTIVE | PG_STATE_CLEAN;
+  for (int i = 0; i < 3; ++i) {
+    s.up.push_back((seed + i * 7919) % osds);
+  }
+  s.acting = s.up;
+  s.up_primary = s.acting_primary = s.up[0];
+  s.stats.sum.num_objects = rng() % 10000;
+  s.stats.sum.num_bytes = s.stats.sum.num_objects * 4194304;
+  s.stats.sum.num_object_copies = s.stats.sum.num_objects * 3;
+  s.log_size = s.ondisk_log_size = 3000;
+  s.purged_snaps.insert(snapid_t(1), 10);
+  return s;
+}
+
+} // anonymous namespace
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+
+  int pools = 4;
+  int pgs = 100000;
+  int osds = 1000;
+  int updates = 1000000;
+  int batch = 10000;
+  int moved = 1;
+  std::string val;
+  for (auto i = args.begin(); i != args.end(); ) {
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_flag(args, i, "-h", "--help", (char*)NULL)) {
+      usage();
+      return 0;
+    } else if (ceph_argparse_witharg(args, i, &val, "--pools", (char*)NULL)) {
+      pools = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--pgs", (char*)NULL)) {
+      pgs = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--osds", (char*)NULL)) {
+      osds = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--updates", (char*)NULL)) {
+      updates = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--batch", (char*)NULL)) {
+      batch = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--moved", (char*)NULL)) {
+      moved = std::stoi(val);
+    } else {
+      cerr << "unknown option " << *i << std::endl;
+      usage();
+      return 1;
+    }
+  }
+  if (pools <= 0 || pgs < pools || osds < 3 || updates < 0 || batch <= 0) {
+    usage();
+    return 1;
+  }
+
+  std::mt19937_64 rng(42);
+  vector<pg_t> pgids;
+  pgids.reserve(pgs);
+  for (int i = 0; i < pgs; ++i) {
+    pgids.emplace_back(i / pools, i % pools);
+  }
+
+  PGMap pg_map;
+  utime_t stamp(1, 0);
+  {
+    PGMap::Incremental inc;
+    inc.version = pg_map.get_version() + 1;
+    inc.stamp = stamp;
+    for (unsigned i = 0; i < pgids.size(); ++i) {
+      inc.pg_stat_updates[pgids[i]] = make_pg_stat(rng, osds, i);
+    }
+    auto start = clock_type::now();
+    pg_map.apply_incremental(nullptr, inc);
+    cout << "created " << pgs << " pgs in " << pools << " pools: "
+	 << ms_since(start) << " ms" << std::endl;
+  }
+
+  // the stream of updates
+  vector<double> latencies;
+  int applied = 0;
+  while (applied < updates) {
+    PGMap::Incremental inc;
+    inc.version = pg_map.get_version() + 1;
+    stamp += 5;
+    inc.stamp = stamp;
+    for (int i = 0; i < batch && applied < updates; ++i, ++applied) {
+      auto &pgid = pgids[rng() % pgids.size()];
+      pg_stat_t s = pg_map.pg_stat.at(pgid);
+      s.reported_seq++;
+      s.stats.sum.num_objects += rng() % 16;
+      s.stats.sum.num_bytes = s.stats.sum.num_objects * 4194304;
+      s.stats.sum.num_rd += rng() % 1000;
+      s.stats.sum.num_wr += rng() % 1000;
+      if ((int)(rng() % 100) < moved) {
+	s.acting[rng() % s.acting.size()] = rng() % osds;
+	s.up = s.acting;
+      }
+      inc.pg_stat_updates[pgid] = s;
+    }
+    auto n = inc.pg_stat_updates.size();
+    auto start = clock_type::now();
+    pg_map.apply_incremental(nullptr, inc);
+    latencies.push_back(ms_since(start) / n * 1000);
+  }
+  if (!latencies.empty()) {
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (auto l : latencies) {
+      total += l;
+    }
+    cout << "applied " << updates << " pg stat updates in "
+	 << latencies.size() << " incrementals, us per update: mean "
+	 << total / latencies.size()
+	 << " p50 " << latencies[latencies.size() / 2]
+	 << " p99 " << latencies[latencies.size() * 99 / 100]
+	 << " max " << latencies.back() << std::endl;
+  }
+
+  // recalculating the aggregates from scratch, as on decode
+  auto pg_sum = pg_map.pg_sum;
+  auto start = clock_type::now();
+  pg_map.calc_stats(1);
+  cout << "calc_stats on one thread: " << ms_since(start) << " ms"
+       << std::endl;
+  start = clock_type::now();
+  pg_map.calc_stats();
+  cout << "calc_stats: " << ms_since(start) << " ms" << std::endl;
+  if (!(pg_map.pg_sum.stats.sum == pg_sum.stats.sum)) {
+    cerr << "calc_stats sum differs from the incrementally maintained one"
+	 << std::endl;
+    return 1;
+  }
+
+  start = clock_type::now();
+  pg_map.calc_purged_snaps();
+  cout << "calc_purged_snaps, all pools: " << ms_since(start) << " ms"
+       << std::endl;
+  {
+    PGMap::Incremental inc;
+    inc.version = pg_map.get_version() + 1;
+    stamp += 5;
+    inc.stamp = stamp;
+    auto &pgid = pgids[0];
+    inc.pg_stat_updates[pgid] = pg_map.pg_stat.at(pgid);
+    pg_map.apply_incremental(nullptr, inc);
+  }
+  start = clock_type::now();
+  pg_map.calc_purged_snaps();
+  cout << "calc_purged_snaps, one pool: " << ms_since(start) << " ms"
+       << std::endl;
+  return 0;
+}
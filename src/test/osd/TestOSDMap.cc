@@ -450,6 +450,73 @@ TEST_F(OSDMapTest, KeepsNecessaryTemps) {
   EXPECT_FALSE(pending_inc.new_primary_temp.count(pgid));
 }
 
+TEST_F(OSDMapTest, CopyOnWrite) {
+  set_up_map();
+
+  pg_t pga = osdmap.raw_pg_to_pg(pg_t(0, my_rep_pool));
+  pg_t pgb = osdmap.raw_pg_to_pg(pg_t(1, my_rep_pool));
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pg_temp[pga] = mempool::osdmap::vector<int>({0, 1, 2});
+    inc.new_primary_temp[pga] = 1;
+    inc.new_pg_upmap_items[pga] =
+      mempool::osdmap::vector<pair<int32_t,int32_t>>({{0, 3}});
+    osdmap.apply_incremental(inc);
+  }
+  const uint64_t features = CEPH_FEATURES_SUPPORTED_DEFAULT;
+  bufferlist before;
+  osdmap.encode(before, features | CEPH_FEATURE_RESERVED);
+
+  // modify every shared structure of a copy
+  OSDMap nextmap;
+  nextmap.deepish_copy_from(osdmap);
+  {
+    OSDMap::Incremental inc(nextmap.get_epoch() + 1);
+    inc.fsid = nextmap.get_fsid();
+    inc.new_pg_temp[pga] = mempool::osdmap::vector<int>();
+    inc.new_pg_temp[pgb] = mempool::osdmap::vector<int>({3, 4, 5});
+    inc.new_primary_temp[pga] = -1;
+    inc.new_primary_temp[pgb] = 4;
+    inc.old_pg_upmap_items.insert(pga);
+    inc.new_pg_upmap[pgb] = mempool::osdmap::vector<int32_t>({5, 4, 3});
+    inc.new_primary_affinity[0] = 0x8000;
+    uuid_d uuid;
+    uuid.generate_random();
+    inc.new_uuid[0] = uuid;
+    entity_addrvec_t addrs;
+    addrs.v.push_back(entity_addr_t());
+    addrs.v[0].nonce = 100;
+    inc.new_up_cluster[1] = addrs;
+    nextmap.apply_incremental(inc);
+  }
+  ASSERT_EQ(1u, nextmap.get_num_pg_temp());
+  ASSERT_FALSE(nextmap.have_pg_upmaps(pga));
+  ASSERT_TRUE(nextmap.have_pg_upmaps(pgb));
+  ASSERT_EQ(0x8000u, nextmap.get_primary_affinity(0));
+  ASSERT_NE(osdmap.get_uuid(0), nextmap.get_uuid(0));
+  ASSERT_NE(osdmap.get_cluster_addrs(1), nextmap.get_cluster_addrs(1));
+
+  // ... and of a map decoded into a copy
+  OSDMap decoded;
+  decoded.deepish_copy_from(osdmap);
+  {
+    bufferlist bl;
+    nextmap.encode(bl, features | CEPH_FEATURE_RESERVED);
+    decoded.decode(bl);
+  }
+  ASSERT_EQ(1u, decoded.get_num_pg_temp());
+
+  // the original map is untouched
+  bufferlist after;
+  osdmap.encode(after, features | CEPH_FEATURE_RESERVED);
+  ASSERT_TRUE(before.contents_equal(after));
+  ASSERT_EQ(1u, osdmap.get_num_pg_temp());
+  ASSERT_TRUE(osdmap.have_pg_upmaps(pga));
+  ASSERT_FALSE(osdmap.have_pg_upmaps(pgb));
+  ASSERT_EQ(unsigned(CEPH_OSD_DEFAULT_PRIMARY_AFFINITY),
+	    osdmap.get_primary_affinity(0));
+}
+
 TEST_F(OSDMapTest, PrimaryAffinity) {
   set_up_map();
 
@@ -1864,3 +1931,66 @@ TEST_F(OSDMapTest, BUG_43124) {
     }
   }
 }
+
+TEST_F(OSDMapTest, CalcPGUpmapsParallel) {
+  set_up_map();
+  vector<pair<int64_t,int>> pools = {{my_ec_pool, 100}, {my_rep_pool, 100}};
+  auto in_pools = [&](const OSDMap::Incremental& inc, set<int64_t> ids) {
+    for (auto& [pg, items] : inc.new_pg_upmap_items) {
+      if (!ids.count(pg.pool()))
+        return false;
+    }
+    for (auto& pg : inc.old_pg_upmap_items) {
+      if (!ids.count(pg.pool()))
+        return false;
+    }
+    return true;
+  };
+  {
+    // every pool is balanced, and the changes are accounted to it
+    OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+    map<int64_t,int> changed_by_pool;
+    int changed = osdmap.calc_pg_upmaps_parallel(
+      g_ceph_context, 1, 200, pools, 2, &pending_inc, &changed_by_pool);
+    int total = 0;
+    for (auto& [pool, n] : changed_by_pool) {
+      ASSERT_TRUE(pool == (int64_t)my_ec_pool || pool == (int64_t)my_rep_pool);
+      total += n;
+    }
+    ASSERT_EQ(changed, total);
+    ASSERT_LE(pending_inc.new_pg_upmap_items.size() +
+	      pending_inc.old_pg_upmap_items.size(), (size_t)changed);
+    ASSERT_TRUE(in_pools(pending_inc,
+			 {(int64_t)my_ec_pool, (int64_t)my_rep_pool}));
+    OSDMap tmp;
+    tmp.deepish_copy_from(osdmap);
+    ASSERT_EQ(0, tmp.apply_incremental(pending_inc));
+  }
+  {
+    // a pool that does not fit in what is left is limited to it
+    OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+    map<int64_t,int> changed_by_pool;
+    int unlimited = osdmap.calc_pg_upmaps_parallel(
+      g_ceph_context, 1, 200, pools, 2, &pending_inc);
+    int max = std::max(1, unlimited - 1);
+    pending_inc = OSDMap::Incremental(osdmap.get_epoch() + 1);
+    int changed = osdmap.calc_pg_upmaps_parallel(
+      g_ceph_context, 1, max, pools, 2, &pending_inc, &changed_by_pool);
+    int total = 0;
+    for (auto& [pool, n] : changed_by_pool) {
+      total += n;
+    }
+    ASSERT_EQ(changed, total);
+    ASSERT_LE(changed, max);
+    if (unlimited > 1) {
+      ASSERT_LT(0, changed);
+    }
+  }
+  {
+    // only the given pools are touched
+    OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+    osdmap.calc_pg_upmaps_parallel(
+      g_ceph_context, 1, 100, {{my_rep_pool, 100}}, 4, &pending_inc);
+    ASSERT_TRUE(in_pools(pending_inc, {(int64_t)my_rep_pool}));
+  }
+}
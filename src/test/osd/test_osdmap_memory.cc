@@ -0,0 +1,219 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Synthetic OSDMap workload: builds a large OSDMap, applies a stream of
+ * small incrementals to it the way OSDs and clients do, keeps the most
+ * recent epochs around like the OSD map cache, and prints the time spent
+ * per epoch and the memory held by the cached maps.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include "common/ceph_argparse.h"
+#include "common/common_init.h"
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "include/mempool.h"
+#include "osd/OSDMap.h"
+
+using namespace std;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double us_since(clock_type::time_point start)
+{
+  return std::chrono::duration<double, std::micro>(
+    clock_type::now() - start).count();
+}
+
+void usage()
+{
+  cout << "usage: ceph_test_osdmap_memory [options]\n"
+       << "  --osds <n>         number of osds (default 3000)\n"
+       << "  --pgs <n>          number of pgs (default 131072)\n"
+       << "  --pg-temps <n>     pg_temp entries (default 10000)\n"
+       << "  --upmaps <n>       pg_upmap_items entries (default 50000)\n"
+       << "  --epochs <n>       incrementals to apply (default 500)\n"
+       << "  --changes <n>      pgs changed per incremental (default 10)\n"
+       << "  --cache <n>        epochs kept in memory (default 50)\n"
+       << std::endl;
+}
+
+size_t osdmap_bytes()
+{
+  return mempool::osdmap::allocated_bytes();
+}
+
+} // anonymous namespace
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  int osds = 3000;
+  int pgs = 131072;
+  int pg_temps = 10000;
+  int upmaps = 50000;
+  int epochs = 500;
+  int changes = 10;
+  int cache = 50;
+  std::string val;
+  for (auto i = args.begin(); i != args.end(); ) {
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_flag(args, i, "-h", "--help", (char*)NULL)) {
+      usage();
+      return 0;
+    } else if (ceph_argparse_witharg(args, i, &val, "--osds", (char*)NULL)) {
+      osds = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--pgs", (char*)NULL)) {
+      pgs = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--pg-temps", (char*)NULL)) {
+      pg_temps = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--upmaps", (char*)NULL)) {
+      upmaps = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--epochs", (char*)NULL)) {
+      epochs = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--changes", (char*)NULL)) {
+      changes = std::stoi(val);
+    } else if (ceph_argparse_witharg(args, i, &val, "--cache", (char*)NULL)) {
+      cache = std::stoi(val);
+    } else {
+      cerr << "unknown option " << *i << std::endl;
+      usage();
+      return 1;
+    }
+  }
+  if (osds < 6 || pgs <= 0 || pg_temps < 0 || pg_temps > pgs ||
+      upmaps < 0 || upmaps > pgs || epochs < 0 || changes < 0 ||
+      cache <= 0) {
+    usage();
+    return 1;
+  }
+
+  std::mt19937_64 rng(42);
+  auto random_osds = [&](unsigned n) {
+    mempool::osdmap::vector<int32_t> v;
+    while (v.size() < n) {
+      int32_t osd = rng() % osds;
+      if (std::find(v.begin(), v.end(), osd) == v.end()) {
+	v.push_back(osd);
+      }
+    }
+    return v;
+  };
+
+  auto map = std::make_shared<OSDMap>();
+  const int64_t pool_id = 1;
+  {
+    uuid_d fsid;
+    map->build_simple(g_ceph_context, 0, fsid, osds);
+    OSDMap::Incremental inc(map->get_epoch() + 1);
+    inc.fsid = map->get_fsid();
+    entity_addrvec_t addrs;
+    addrs.v.push_back(entity_addr_t());
+    for (int i = 0; i < osds; ++i) {
+      addrs.v[0].nonce = i;
+      inc.new_state[i] = CEPH_OSD_EXISTS | CEPH_OSD_NEW;
+      inc.new_up_client[i] = addrs;
+      inc.new_up_cluster[i] = addrs;
+      inc.new_hb_back_up[i] = addrs;
+      inc.new_hb_front_up[i] = addrs;
+      inc.new_weight[i] = CEPH_OSD_IN;
+      inc.new_uuid[i].generate_random();
+    }
+    inc.new_pool_max = pool_id;
+    pg_pool_t empty;
+    auto pool = inc.get_new_pool(pool_id, &empty);
+    pool->size = 3;
+    pool->set_pg_num(pgs);
+    pool->set_pgp_num(pgs);
+    pool->type = pg_pool_t::TYPE_REPLICATED;
+    pool->crush_rule = 0;
+    inc.new_pool_names[pool_id] = "pool";
+    for (int i = 0; i < pg_temps; ++i) {
+      inc.new_pg_temp[pg_t(i, pool_id)] = random_osds(3);
+      inc.new_primary_temp[pg_t(i, pool_id)] = rng() % osds;
+    }
+    for (int i = 0; i < upmaps; ++i) {
+      auto from_to = random_osds(2);
+      inc.new_pg_upmap_items[pg_t(pgs - 1 - i, pool_id)] = {
+	{from_to[0], from_to[1]}};
+    }
+    map->apply_incremental(inc);
+  }
+  size_t base_bytes = osdmap_bytes();
+  cout << osds << " osds, " << pgs << " pgs, " << pg_temps
+       << " pg_temps, " << upmaps << " pg_upmap_items: "
+       << base_bytes / 1024 << " KiB for one map" << std::endl;
+
+  // the stream of epochs, the latest ones kept like the OSD map cache
+  std::deque<std::shared_ptr<const OSDMap>> maps;
+  maps.push_back(map);
+  double total_us = 0, max_us = 0;
+  for (int e = 0; e < epochs; ++e) {
+    OSDMap::Incremental inc(map->get_epoch() + 1);
+    inc.fsid = map->get_fsid();
+    for (int i = 0; i < changes; ++i) {
+      int osd = rng() % osds;
+      inc.new_up_thru[osd] = map->get_epoch();
+      if (pg_temps) {
+	pg_t pgid(rng() % pg_temps, pool_id);
+	inc.new_pg_temp[pgid] = random_osds(3);
+      }
+      if (upmaps) {
+	pg_t pgid(pgs - 1 - rng() % upmaps, pool_id);
+	auto from_to = random_osds(2);
+	inc.new_pg_upmap_items[pgid] = {{from_to[0], from_to[1]}};
+      }
+    }
+    if (e % 10 == 0) {
+      // an osd restarts and comes back up with new addresses
+      int osd = rng() % osds;
+      entity_addrvec_t addrs;
+      addrs.v.push_back(entity_addr_t());
+      addrs.v[0].nonce = osds + e;
+      inc.new_up_client[osd] = addrs;
+      inc.new_up_cluster[osd] = addrs;
+      inc.new_hb_back_up[osd] = addrs;
+      inc.new_hb_front_up[osd] = addrs;
+    }
+
+    auto start = clock_type::now();
+    auto next = std::make_shared<OSDMap>();
+    next->deepish_copy_from(*map);
+    next->apply_incremental(inc);
+    double us = us_since(start);
+    total_us += us;
+    max_us = std::max(max_us, us);
+
+    map = next;
+    maps.push_back(map);
+    if (maps.size() > (size_t)cache) {
+      maps.pop_front();
+    }
+  }
+  if (epochs > 0) {
+    cout << "applied " << epochs << " incrementals, us per epoch: mean "
+	 << total_us / epochs << " max " << max_us << std::endl;
+  }
+  size_t bytes = osdmap_bytes();
+  cout << maps.size() << " cached maps: " << bytes / 1024 << " KiB, "
+       << bytes / maps.size() / 1024 << " KiB per map, "
+       << (bytes - base_bytes) / 1024 << " KiB more than one map"
+       << std::endl;
+  return 0;
+}
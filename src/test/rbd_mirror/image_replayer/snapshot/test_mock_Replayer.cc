@@ -235,6 +235,8 @@ struct Threads<librbd::MockTestImageCtx> {
 
   MockContextWQ *work_queue;
 
+  BandwidthThrottler *image_sync_throttler = nullptr;
+
   Threads(Threads<librbd::ImageCtx>* threads)
     : timer(new MockSafeTimer()),
       timer_lock(threads->timer_lock),
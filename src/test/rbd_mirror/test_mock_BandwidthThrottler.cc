@@ -0,0 +1,69 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/rbd_mirror/test_mock_fixture.h"
+#include "common/Cond.h"
+#include "include/stringify.h"
+#include "tools/rbd_mirror/BandwidthThrottler.h"
+#include "tools/rbd_mirror/Threads.h"
+
+namespace rbd {
+namespace mirror {
+
+class TestMockBandwidthThrottler : public TestMockFixture {
+public:
+  void SetUp() override {
+    TestMockFixture::SetUp();
+
+    m_throttler = new BandwidthThrottler(
+      g_ceph_context, "rbd_mirror_image_sync_bps", m_threads->timer,
+      &m_threads->timer_lock, m_threads->work_queue);
+  }
+
+  void TearDown() override {
+    delete m_throttler;
+    set_limit(0);
+
+    TestMockFixture::TearDown();
+  }
+
+  void set_limit(uint64_t limit) {
+    g_ceph_context->_conf.set_val_or_die("rbd_mirror_image_sync_bps_limit",
+                                         stringify(limit));
+    g_ceph_context->_conf.apply_changes(nullptr);
+  }
+
+  BandwidthThrottler *m_throttler = nullptr;
+};
+
+TEST_F(TestMockBandwidthThrottler, Unlimited) {
+  C_SaferCond on_start;
+  m_throttler->start_op(1 << 30, &on_start);
+  ASSERT_EQ(0, on_start.wait());
+}
+
+TEST_F(TestMockBandwidthThrottler, Limited) {
+  set_limit(1 << 20);
+
+  C_SaferCond on_start1;
+  m_throttler->start_op(1 << 18, &on_start1);
+  C_SaferCond on_start2;
+  m_throttler->start_op(1 << 18, &on_start2);
+
+  ASSERT_EQ(0, on_start1.wait());
+  ASSERT_EQ(0, on_start2.wait());
+}
+
+TEST_F(TestMockBandwidthThrottler, DisableReleasesWaiters) {
+  set_limit(1);
+
+  C_SaferCond on_start;
+  m_throttler->start_op(1 << 20, &on_start);
+  ASSERT_EQ(ETIMEDOUT, on_start.wait_for(0.5));
+
+  set_limit(0);
+  ASSERT_EQ(0, on_start.wait());
+}
+
+} // namespace mirror
+} // namespace rbd
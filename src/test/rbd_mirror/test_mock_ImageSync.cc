@@ -73,6 +73,8 @@ struct Threads<librbd::MockTestImageCtx> {
   SafeTimer *timer;
   librbd::asio::ContextWQ *work_queue;
 
+  BandwidthThrottler *image_sync_throttler = nullptr;
+
   Threads(Threads<librbd::ImageCtx> *threads)
     : timer_lock(threads->timer_lock), timer(threads->timer),
       work_queue(threads->work_queue) {
@@ -0,0 +1,273 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ *
+ */
+
+#include "rgw/rgw_coroutine.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "global/global_context.h"
+
+#include <boost/asio/yield.hpp>
+#include <gtest/gtest.h>
+
+// completes queued notifiers from its own thread, standing in for the
+// http manager or librados callback threads that feed sync coroutines.
+// with a burst size, completions are held until that many are queued
+class Completer {
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::deque<RGWAioCompletionNotifier*> pending;
+  const size_t burst;
+  bool held = false;
+  bool stopping = false;
+  std::thread thread;
+
+  void run() {
+    std::unique_lock lock{mutex};
+    while (!stopping || !pending.empty()) {
+      if (pending.empty() ||
+          (!stopping && (held || pending.size() < burst))) {
+        cond.wait(lock);
+        continue;
+      }
+      std::deque<RGWAioCompletionNotifier*> batch;
+      batch.swap(pending);
+      lock.unlock();
+      for (auto cn : batch) {
+        cn->cb();
+      }
+      lock.lock();
+    }
+  }
+ public:
+  explicit Completer(size_t burst = 1)
+    : burst(burst), thread([this] { run(); }) {}
+  ~Completer() {
+    {
+      std::lock_guard lock{mutex};
+      stopping = true;
+    }
+    cond.notify_all();
+    thread.join();
+  }
+  void queue(RGWAioCompletionNotifier* cn) {
+    {
+      std::lock_guard lock{mutex};
+      pending.push_back(cn);
+    }
+    cond.notify_all();
+  }
+  // keep every completion until destruction
+  void hold() {
+    std::lock_guard lock{mutex};
+    held = true;
+  }
+  void wait_for_pending(size_t count) {
+    std::unique_lock lock{mutex};
+    cond.wait(lock, [&] { return pending.size() >= count; });
+  }
+};
+
+class FakeRequestCR : public RGWSimpleCoroutine {
+  Completer& completer;
+  std::atomic<uint64_t>& completed;
+  boost::intrusive_ptr<RGWAioCompletionNotifier> cn;
+ public:
+  FakeRequestCR(CephContext* cct, Completer& completer,
+                std::atomic<uint64_t>& completed)
+    : RGWSimpleCoroutine(cct), completer(completer), completed(completed) {}
+
+  int send_request() override {
+    // the initial ref of the notifier belongs to the completion callback
+    cn = stack->create_completion_notifier();
+    completer.queue(cn.get());
+    return 0;
+  }
+  int request_complete() override {
+    ++completed;
+    return 0;
+  }
+};
+
+// issues requests one after another, like a data sync shard
+class FakeShardCR : public RGWCoroutine {
+  Completer& completer;
+  std::atomic<uint64_t>& completed;
+  uint64_t num_requests;
+  uint64_t i = 0;
+ public:
+  FakeShardCR(CephContext* cct, Completer& completer,
+              std::atomic<uint64_t>& completed, uint64_t num_requests)
+    : RGWCoroutine(cct), completer(completer), completed(completed),
+      num_requests(num_requests) {}
+
+  int operate() override {
+    reenter(this) {
+      for (i = 0; i < num_requests; i++) {
+        yield call(new FakeRequestCR(cct, completer, completed));
+        if (retcode < 0) {
+          return set_cr_error(retcode);
+        }
+      }
+      return set_cr_done();
+    }
+    return 0;
+  }
+};
+
+class FakeSyncCR : public RGWCoroutine {
+  Completer& completer;
+  std::atomic<uint64_t>& completed;
+  uint64_t num_shards;
+  uint64_t num_requests;
+  uint64_t shard = 0;
+ public:
+  FakeSyncCR(CephContext* cct, Completer& completer,
+             std::atomic<uint64_t>& completed,
+             uint64_t num_shards, uint64_t num_requests)
+    : RGWCoroutine(cct), completer(completer), completed(completed),
+      num_shards(num_shards), num_requests(num_requests) {}
+
+  int operate() override {
+    reenter(this) {
+      for (shard = 0; shard < num_shards; shard++) {
+        spawn(new FakeShardCR(cct, completer, completed, num_requests), false);
+      }
+      drain_all();
+      return set_cr_done();
+    }
+    return 0;
+  }
+};
+
+using io_completion = RGWCompletionManager::io_completion;
+
+TEST(RGWCompletionManager, TryGetAll)
+{
+  auto cm = new RGWCompletionManager(g_ceph_context);
+  int infos[3];
+  for (int i = 0; i < 3; i++) {
+    cm->complete(nullptr, rgw_io_id{i, -1}, &infos[i]);
+  }
+
+  std::list<io_completion> ios;
+  cm->try_get_all(ios);
+  ASSERT_EQ(3u, ios.size());
+  int i = 0;
+  for (auto& io : ios) {
+    EXPECT_EQ(i, io.io_id.id);
+    EXPECT_EQ(&infos[i], io.user_info);
+    i++;
+  }
+
+  // each completion is handed out once
+  ios.clear();
+  cm->try_get_all(ios);
+  EXPECT_TRUE(ios.empty());
+
+  // later completions are appended to what the caller already holds
+  cm->complete(nullptr, rgw_io_id{3, -1}, nullptr);
+  ios.push_back(io_completion{rgw_io_id{42, -1}, nullptr});
+  cm->try_get_all(ios);
+  ASSERT_EQ(2u, ios.size());
+  EXPECT_EQ(42, ios.front().io_id.id);
+  EXPECT_EQ(3, ios.back().io_id.id);
+  cm->put();
+}
+
+TEST(RGWCompletionManager, GetAllWaitsForCompletion)
+{
+  auto cm = new RGWCompletionManager(g_ceph_context);
+  std::list<io_completion> ios;
+  int r = -1;
+  std::thread waiter([&] { r = cm->get_all(ios); });
+  cm->complete(nullptr, rgw_io_id{7, -1}, nullptr);
+  waiter.join();
+  EXPECT_EQ(0, r);
+  ASSERT_EQ(1u, ios.size());
+  EXPECT_EQ(7, ios.front().io_id.id);
+  cm->put();
+}
+
+TEST(RGWCompletionManager, GoDownWakesGetAll)
+{
+  auto cm = new RGWCompletionManager(g_ceph_context);
+  std::list<io_completion> ios;
+  int r = 0;
+  std::thread waiter([&] { r = cm->get_all(ios); });
+  cm->go_down();
+  waiter.join();
+  EXPECT_EQ(-ECANCELED, r);
+  EXPECT_TRUE(ios.empty());
+  cm->put();
+}
+
+TEST(RGWCoroutinesManager, AllShardsComplete)
+{
+  // more shards than RGW_ASYNC_OPS_MGR_WINDOW, so run() also blocks on
+  // the ops window
+  constexpr uint64_t num_shards = 128;
+  constexpr uint64_t num_requests = 20;
+
+  auto cct = g_ceph_context;
+  std::atomic<uint64_t> completed{0};
+  Completer completer;
+  RGWCoroutinesManager crs(cct, nullptr);
+
+  int r = crs.run(new FakeSyncCR(cct, completer, completed,
+                                 num_shards, num_requests));
+  ASSERT_EQ(0, r);
+  EXPECT_EQ(num_shards * num_requests, completed.load());
+}
+
+TEST(RGWCoroutinesManager, BurstCompletions)
+{
+  // every shard blocks before any completion is delivered, so each batch
+  // taken from the completion manager unblocks many stacks at once
+  constexpr uint64_t num_shards = 32;
+  constexpr uint64_t num_requests = 10;
+
+  auto cct = g_ceph_context;
+  std::atomic<uint64_t> completed{0};
+  Completer completer(num_shards);
+  RGWCoroutinesManager crs(cct, nullptr);
+
+  int r = crs.run(new FakeSyncCR(cct, completer, completed,
+                                 num_shards, num_requests));
+  ASSERT_EQ(0, r);
+  EXPECT_EQ(num_shards * num_requests, completed.load());
+}
+
+TEST(RGWCoroutinesManager, StopWhileBlocked)
+{
+  constexpr uint64_t num_shards = 8;
+
+  auto cct = g_ceph_context;
+  std::atomic<uint64_t> completed{0};
+  RGWCoroutinesManager crs(cct, nullptr);
+  // destroyed first, so the held notifiers are released before crs
+  Completer completer;
+  completer.hold();
+
+  int r = 0;
+  std::thread runner([&] {
+    r = crs.run(new FakeSyncCR(cct, completer, completed, num_shards, 1));
+  });
+  completer.wait_for_pending(num_shards);
+  crs.stop();
+  runner.join();
+  EXPECT_EQ(-ECANCELED, r);
+  EXPECT_EQ(0u, completed.load());
+}
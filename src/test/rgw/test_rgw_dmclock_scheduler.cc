@@ -17,7 +17,9 @@
 #include "rgw/rgw_dmclock_sync_scheduler.h"
 #include "rgw/rgw_dmclock_async_scheduler.h"
 
+#include <algorithm>
 #include <optional>
+#include <vector>
 #include <boost/asio/spawn.hpp>
 #include <gtest/gtest.h>
 #include "acconfig.h"
@@ -40,12 +42,12 @@ auto capture(std::optional<error_code>& opt_ec,
 TEST(Queue, SyncRequest)
 {
   ClientCounters counters(g_ceph_context);
-  auto client_info_f = [] (client_id client) -> ClientInfo* {
+  auto client_info_f = [] (const client_key& client) -> ClientInfo* {
                          static ClientInfo clients[] = {
                                                         {1, 1, 1}, //admin: satisfy by reservation
                                                         {0, 1, 1}, //auth: satisfy by priority
                          };
-                         return &clients[static_cast<size_t>(client)];
+                         return &clients[static_cast<size_t>(client.id)];
                        };
   std::atomic <bool> ready = false;
   auto server_ready_f = [&ready]() -> bool { return ready.load();};
@@ -81,12 +83,12 @@ TEST(Queue, RateLimit)
   boost::asio::io_context context;
   ClientCounters counters(g_ceph_context);
   AsyncScheduler queue(g_ceph_context, context, std::ref(counters), nullptr,
-                  [] (client_id client) -> ClientInfo* {
+                  [] (const client_key& client) -> ClientInfo* {
       static ClientInfo clients[] = {
         {1, 1, 1}, // admin
         {0, 1, 1}, // auth
       };
-      return &clients[static_cast<size_t>(client)];
+      return &clients[static_cast<size_t>(client.id)];
     }, AtLimit::Reject);
 
   std::optional<error_code> ec1, ec2, ec3, ec4;
@@ -142,12 +144,12 @@ TEST(Queue, AsyncRequest)
   boost::asio::io_context context;
   ClientCounters counters(g_ceph_context);
   AsyncScheduler queue(g_ceph_context, context, std::ref(counters), nullptr,
-                  [] (client_id client) -> ClientInfo* {
+                  [] (const client_key& client) -> ClientInfo* {
       static ClientInfo clients[] = {
         {1, 1, 1}, // admin: satisfy by reservation
         {0, 1, 1}, // auth: satisfy by priority
       };
-      return &clients[static_cast<size_t>(client)];
+      return &clients[static_cast<size_t>(client.id)];
 		  }, AtLimit::Reject
 		  );
 
@@ -195,7 +197,7 @@ TEST(Queue, Cancel)
   boost::asio::io_context context;
   ClientCounters counters(g_ceph_context);
   AsyncScheduler queue(g_ceph_context, context, std::ref(counters), nullptr,
-                  [] (client_id client) -> ClientInfo* {
+                  [] (const client_key& client) -> ClientInfo* {
       static ClientInfo info{0, 1, 1};
       return &info;
     });
@@ -243,7 +245,7 @@ TEST(Queue, CancelClient)
   boost::asio::io_context context;
   ClientCounters counters(g_ceph_context);
   AsyncScheduler queue(g_ceph_context, context, std::ref(counters), nullptr,
-                  [] (client_id client) -> ClientInfo* {
+                  [] (const client_key& client) -> ClientInfo* {
       static ClientInfo info{0, 1, 1};
       return &info;
     });
@@ -299,7 +301,7 @@ TEST(Queue, CancelOnDestructor)
   ClientCounters counters(g_ceph_context);
   {
     AsyncScheduler queue(g_ceph_context, context, std::ref(counters), nullptr,
-                    [] (client_id client) -> ClientInfo* {
+                    [] (const client_key& client) -> ClientInfo* {
         static ClientInfo info{0, 1, 1};
         return &info;
       });
@@ -349,7 +351,7 @@ TEST(Queue, CrossExecutorRequest)
   boost::asio::io_context queue_context;
   ClientCounters counters(g_ceph_context);
   AsyncScheduler queue(g_ceph_context, queue_context, std::ref(counters), nullptr,
-                  [] (client_id client) -> ClientInfo* {
+                  [] (const client_key& client) -> ClientInfo* {
       static ClientInfo info{0, 1, 1};
       return &info;
     });
@@ -403,12 +405,12 @@ TEST(Queue, SpawnAsyncRequest)
   boost::asio::spawn(context, [&] (boost::asio::yield_context yield) {
     ClientCounters counters(g_ceph_context);
     AsyncScheduler queue(g_ceph_context, context, std::ref(counters), nullptr,
-                    [] (client_id client) -> ClientInfo* {
+                    [] (const client_key& client) -> ClientInfo* {
         static ClientInfo clients[] = {
           {1, 1, 1}, // admin: satisfy by reservation
           {0, 1, 1}, // auth: satisfy by priority
         };
-        return &clients[static_cast<size_t>(client)];
+        return &clients[static_cast<size_t>(client.id)];
       });
 
     error_code ec1, ec2;
@@ -425,4 +427,162 @@ TEST(Queue, SpawnAsyncRequest)
   EXPECT_TRUE(context.stopped());
 }
 
+// with a single request allowed at a time, queue a backlog for one client and
+// then one request for another, and return the position the latter ran at
+size_t light_client_position(const client_key& heavy, const client_key& light,
+                             size_t backlog)
+{
+  auto& conf = g_ceph_context->_conf;
+  conf.set_val_or_die("rgw_max_concurrent_requests", "1");
+
+  boost::asio::io_context context;
+  ClientCounters counters(g_ceph_context);
+  AsyncScheduler queue(g_ceph_context, context, std::ref(counters), nullptr,
+                       [] (const client_key& client) -> ClientInfo* {
+      static ClientInfo info{0, 1, 0};
+      return &info;
+    });
+
+  std::vector<client_key> completed;
+  auto complete = [&] (const client_key& client) {
+    return [&, client] (error_code ec, PhaseType) {
+      EXPECT_FALSE(ec);
+      completed.push_back(client);
+      queue.request_complete();
+    };
+  };
+
+  auto now = get_time();
+  for (size_t i = 0; i < backlog; i++) {
+    queue.async_request(heavy, {}, now, 1, complete(heavy));
+  }
+  queue.async_request(light, {}, now, 1, complete(light));
+
+  context.poll();
+  EXPECT_TRUE(context.stopped());
+  EXPECT_EQ(backlog + 1, completed.size());
+
+  conf.rm_val("rgw_max_concurrent_requests");
+  return std::find(completed.begin(), completed.end(), light) -
+      completed.begin();
+}
+
+TEST(Queue, KeyedClientIsolation)
+{
+  constexpr size_t backlog = 32;
+  // sharing the data class, the light tenant waits behind the whole backlog
+  EXPECT_EQ(backlog, light_client_position(client_id::data, client_id::data,
+                                           backlog));
+  // with a class per tenant, it gets its share right away
+  EXPECT_GE(1u, light_client_position({client_id::data, "heavy"},
+                                      {client_id::data, "light"}, backlog));
+}
+
+TEST(Queue, KeyedClientCounters)
+{
+  boost::asio::io_context context;
+  ClientCounters counters(g_ceph_context);
+  AsyncScheduler queue(g_ceph_context, context, std::ref(counters), nullptr,
+                       [] (const client_key& client) -> ClientInfo* {
+      static ClientInfo info{0, 1, 0};
+      return &info;
+    });
+
+  const client_key tenant1{client_id::data, "tenant1"};
+  const client_key tenant2{client_id::data, "tenant2"};
+
+  std::optional<error_code> ec1, ec2, ec3;
+  std::optional<PhaseType> p1, p2, p3;
+
+  auto now = get_time();
+  queue.async_request(tenant1, {}, now, 1, capture(ec1, p1));
+  queue.async_request(tenant1, {}, now, 1, capture(ec2, p2));
+  queue.async_request(tenant2, {}, now, 1, capture(ec3, p3));
+  EXPECT_EQ(2u, counters.keyed_count());
+  EXPECT_EQ(2u, counters(tenant1)->get(queue_counters::l_qlen));
+  EXPECT_EQ(1u, counters(tenant2)->get(queue_counters::l_qlen));
+  EXPECT_EQ(0u, counters(client_id::data)->get(queue_counters::l_qlen));
+
+  queue.cancel(tenant2);
+  context.poll();
+  EXPECT_TRUE(context.stopped());
+
+  EXPECT_EQ(0u, counters(tenant1)->get(queue_counters::l_qlen));
+  EXPECT_EQ(2u, counters(tenant1)->get(queue_counters::l_prio));
+  EXPECT_EQ(0u, counters(tenant2)->get(queue_counters::l_qlen));
+  EXPECT_EQ(1u, counters(tenant2)->get(queue_counters::l_cancel));
+  EXPECT_EQ(0u, counters(client_id::data)->get(queue_counters::l_prio));
+}
+
+TEST(ClientConfig, KeyedOverrides)
+{
+  auto& conf = g_ceph_context->_conf;
+  conf.set_val_or_die("rgw_dmclock_client_res", "1");
+  conf.set_val_or_die("rgw_dmclock_client_wgt", "2");
+  conf.set_val_or_die("rgw_dmclock_client_lim", "3");
+  conf.set_val_or_die("rgw_dmclock_client_overrides",
+                      "acme=10,20,30 bad=1,2 t1:bucket=0,5,0");
+
+  ClientConfig config(g_ceph_context);
+  auto acme = config({client_id::data, "acme"});
+  EXPECT_EQ(10, acme->reservation);
+  EXPECT_EQ(20, acme->weight);
+  EXPECT_EQ(30, acme->limit);
+  // an override covers both the data and metadata requests of its key
+  EXPECT_EQ(acme, config({client_id::metadata, "acme"}));
+
+  auto bucket = config({client_id::data, "t1:bucket"});
+  EXPECT_EQ(0, bucket->reservation);
+  EXPECT_EQ(5, bucket->weight);
+
+  // malformed entries fall back to the defaults
+  auto bad = config({client_id::data, "bad"});
+  EXPECT_EQ(1, bad->reservation);
+  EXPECT_EQ(2, bad->weight);
+  EXPECT_EQ(3, bad->limit);
+  EXPECT_EQ(bad, config({client_id::data, "other"}));
+
+  // unkeyed requests keep their op class settings
+  EXPECT_EQ(conf.get_val<double>("rgw_dmclock_data_wgt"),
+            config(client_id::data)->weight);
+
+  conf.rm_val("rgw_dmclock_client_res");
+  conf.rm_val("rgw_dmclock_client_wgt");
+  conf.rm_val("rgw_dmclock_client_lim");
+  conf.rm_val("rgw_dmclock_client_overrides");
+}
+
+TEST(ClientConfig, UpdateKeepsClientInfos)
+{
+  auto& conf = g_ceph_context->_conf;
+  conf.set_val_or_die("rgw_dmclock_client_overrides", "acme=10,20,30");
+
+  ClientConfig config(g_ceph_context);
+  auto data = config(client_id::data);
+  auto acme = config({client_id::data, "acme"});
+
+  // the queue may still hold these pointers, so updates happen in place
+  conf.set_val_or_die("rgw_dmclock_data_wgt", "7");
+  conf.set_val_or_die("rgw_dmclock_client_overrides", "acme=1,2,3 other=4,5,6");
+  config.handle_conf_change(conf, {"rgw_dmclock_data_wgt",
+                                   "rgw_dmclock_client_overrides"});
+  EXPECT_EQ(data, config(client_id::data));
+  EXPECT_EQ(7, data->weight);
+  EXPECT_EQ(acme, config({client_id::data, "acme"}));
+  EXPECT_EQ(1, acme->reservation);
+  EXPECT_EQ(2, acme->weight);
+  EXPECT_EQ(3, acme->limit);
+  EXPECT_EQ(5, config({client_id::data, "other"})->weight);
+
+  // a dropped override falls back to the defaults, but its entry survives
+  conf.rm_val("rgw_dmclock_client_overrides");
+  config.handle_conf_change(conf, {"rgw_dmclock_client_overrides"});
+  auto dflt = config({client_id::data, "acme"});
+  EXPECT_NE(acme, dflt);
+  EXPECT_EQ(dflt, config({client_id::data, "unknown"}));
+  EXPECT_EQ(2, acme->weight);
+
+  conf.rm_val("rgw_dmclock_data_wgt");
+}
+
 } // namespace rgw::dmclock
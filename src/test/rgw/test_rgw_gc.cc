@@ -0,0 +1,55 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation. See file COPYING.
+ *
+ */
+
+#include "rgw/rgw_gc.h"
+
+#include <gtest/gtest.h>
+
+TEST(GCTailRemoves, object_pg)
+{
+  // the raw hash is mapped like pg_pool_t::raw_pg_to_pg()
+  EXPECT_EQ(4u, rgw_gc_object_pg(0x1234, 12));
+  EXPECT_EQ(5u, rgw_gc_object_pg(13, 12));
+  EXPECT_EQ(13u, rgw_gc_object_pg(13, 16));
+  EXPECT_EQ(0u, rgw_gc_object_pg(0xdeadbeef, 1));
+  // unknown pg_num leaves the hash as is
+  EXPECT_EQ(0xdeadbeefu, rgw_gc_object_pg(0xdeadbeef, 0));
+}
+
+TEST(GCTailRemoves, sort_by_pool_and_pg)
+{
+  const string tag = "tag";
+  std::vector<cls_rgw_obj> objs(6);
+  // hashes 13 and 5 are in the same pg of a 12 pg pool, though 0x1234
+  // (pg 4) sorts between them by hash
+  const std::vector<std::pair<int64_t, uint32_t>> placement = {
+    {2, 13}, {1, 0x1234}, {2, 0x1234}, {1, 5}, {2, 5}, {1, 13}};
+  std::vector<RGWGCTailRemove> removes;
+  for (size_t i = 0; i < objs.size(); ++i) {
+    objs[i].key.name = "obj" + std::to_string(i);
+    removes.push_back(RGWGCTailRemove{
+      placement[i].first, rgw_gc_object_pg(placement[i].second, 12),
+      nullptr, &objs[i], &tag});
+  }
+
+  rgw_gc_sort_tail_removes(removes);
+
+  std::vector<string> order;
+  for (auto& r : removes) {
+    order.push_back(r.obj->key.name);
+  }
+  // grouped by pool and pg, in batch order within a pg
+  const std::vector<string> expected = {
+    "obj1", "obj3", "obj5",   // pool 1: pg 4, then pg 5 twice
+    "obj2", "obj0", "obj4"};  // pool 2: pg 4, then pg 5 twice
+  EXPECT_EQ(expected, order);
+}
@@ -0,0 +1,144 @@
+// -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "rgw/rgw_lc_checkpoint.h"
+
+#include "test/librados/test_cxx.h"
+#include "gtest/gtest.h"
+
+// creates a rados client and temporary pool
+struct RadosEnv : public ::testing::Environment {
+  static std::optional<std::string> pool_name;
+ public:
+  static std::optional<librados::Rados> rados;
+
+  void SetUp() override {
+    rados.emplace();
+    // create pool
+    std::string name = get_temp_pool_name();
+    ASSERT_EQ("", create_one_pool_pp(name, *rados));
+    pool_name = name;
+  }
+  void TearDown() override {
+    if (pool_name) {
+      ASSERT_EQ(0, destroy_one_pool_pp(*pool_name, *rados));
+    }
+    rados.reset();
+  }
+
+  static int ioctx_create(librados::IoCtx& ioctx) {
+    return rados->ioctx_create(pool_name->c_str(), ioctx);
+  }
+};
+std::optional<std::string> RadosEnv::pool_name;
+std::optional<librados::Rados> RadosEnv::rados;
+
+auto *const rados_env = ::testing::AddGlobalTestEnvironment(new RadosEnv);
+
+class rgw_lc_checkpoint : public ::testing::Test {
+ protected:
+  static librados::IoCtx ioctx;
+
+  static void SetUpTestSuite() {
+    ASSERT_EQ(0, RadosEnv::ioctx_create(ioctx));
+  }
+  static void TearDownTestSuite() {
+    ioctx.close();
+  }
+
+  // use the test's name as the bucket so different tests don't conflict
+  std::string get_test_bucket() const {
+    return ::testing::UnitTest::GetInstance()->current_test_info()->name();
+  }
+
+  static LCShardCheckpoint make_ckpt(bool done, const std::string& name) {
+    LCShardCheckpoint ckpt;
+    ckpt.done = done;
+    ckpt.marker = cls_rgw_obj_key(name, "instance");
+    return ckpt;
+  }
+};
+librados::IoCtx rgw_lc_checkpoint::ioctx;
+
+TEST(LCShardCheckpoint, encode_decode)
+{
+  LCShardCheckpoint ckpt;
+  ckpt.done = true;
+  ckpt.marker = cls_rgw_obj_key("obj", "v1");
+  bufferlist bl;
+  encode(ckpt, bl);
+  LCShardCheckpoint out;
+  auto p = bl.cbegin();
+  decode(out, p);
+  EXPECT_TRUE(out.done);
+  EXPECT_EQ(ckpt.marker, out.marker);
+
+  LCShardCheckpointsHeader header{0xabcd, 1234567};
+  bl.clear();
+  encode(header, bl);
+  LCShardCheckpointsHeader header_out;
+  p = bl.cbegin();
+  decode(header_out, p);
+  EXPECT_EQ(header, header_out);
+}
+
+TEST_F(rgw_lc_checkpoint, resume)
+{
+  const auto bucket = get_test_bucket();
+  const auto key1 = LCShardCheckpoints::make_key(0, 1);
+  const auto key2 = LCShardCheckpoints::make_key(0, 2);
+  {
+    LCShardCheckpoints ckpts(ioctx, bucket);
+    ASSERT_EQ(0, ckpts.load(42, 1000));
+    EXPECT_FALSE(ckpts.get(key1).done);
+    ASSERT_EQ(0, ckpts.save(key1, make_ckpt(false, "b")));
+    ASSERT_EQ(0, ckpts.save(key2, make_ckpt(true, "z")));
+  }
+  // the same cycle picks up where it stopped
+  LCShardCheckpoints ckpts(ioctx, bucket);
+  ASSERT_EQ(0, ckpts.load(42, 1000));
+  auto ckpt1 = ckpts.get(key1);
+  EXPECT_FALSE(ckpt1.done);
+  EXPECT_EQ("b", ckpt1.marker.name);
+  EXPECT_TRUE(ckpts.get(key2).done);
+  EXPECT_FALSE(ckpts.get(LCShardCheckpoints::make_key(1, 1)).done);
+
+  ASSERT_EQ(0, ckpts.clear());
+  ASSERT_EQ(0, ckpts.load(42, 1000));
+  EXPECT_FALSE(ckpts.get(key2).done);
+}
+
+TEST_F(rgw_lc_checkpoint, new_cycle)
+{
+  const auto bucket = get_test_bucket();
+  const auto key = LCShardCheckpoints::make_key(0, 0);
+  {
+    LCShardCheckpoints ckpts(ioctx, bucket);
+    ASSERT_EQ(0, ckpts.load(42, 1000));
+    ASSERT_EQ(0, ckpts.save(key, make_ckpt(true, "a")));
+  }
+  // shards done in an unfinished cycle are processed again in the next
+  {
+    LCShardCheckpoints ckpts(ioctx, bucket);
+    ASSERT_EQ(0, ckpts.load(42, 1000 + 86400));
+    EXPECT_FALSE(ckpts.get(key).done);
+  }
+  // and the old cycle's checkpoints are gone
+  LCShardCheckpoints ckpts(ioctx, bucket);
+  ASSERT_EQ(0, ckpts.load(42, 1000));
+  EXPECT_FALSE(ckpts.get(key).done);
+}
+
+TEST_F(rgw_lc_checkpoint, new_config)
+{
+  const auto bucket = get_test_bucket();
+  const auto key = LCShardCheckpoints::make_key(0, 0);
+  {
+    LCShardCheckpoints ckpts(ioctx, bucket);
+    ASSERT_EQ(0, ckpts.load(42, 1000));
+    ASSERT_EQ(0, ckpts.save(key, make_ckpt(true, "a")));
+  }
+  LCShardCheckpoints ckpts(ioctx, bucket);
+  ASSERT_EQ(0, ckpts.load(43, 1000));
+  EXPECT_FALSE(ckpts.get(key).done);
+}
@@ -0,0 +1,268 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab ft=cpp
+
+#include <chrono>
+#include <list>
+#include <map>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "common/ceph_context.h"
+#include "common/perf_counters.h"
+#include "global/global_context.h"
+#include "rgw/rgw_log.h"
+#include "rgw/rgw_log_batcher.h"
+#include "rgw/rgw_perf_counters.h"
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/* records the appends, and completes them only when told to */
+class MockBackend : public OpsLogBatcher::Backend {
+  ceph::mutex lock = ceph::make_mutex("MockBackend");
+  ceph::condition_variable cond;
+  std::list<Context*> pending;
+public:
+  std::map<std::string, bufferlist> objs;
+  int num_appends = 0;
+
+  ~MockBackend() override {
+    complete_all(0);
+  }
+
+  int append(const std::string& oid, bufferlist& bl,
+             Context *on_complete) override {
+    std::lock_guard l{lock};
+    objs[oid].append(bl);
+    num_appends++;
+    pending.push_back(on_complete);
+    cond.notify_all();
+    return 0;
+  }
+
+  void complete_all(int r) {
+    std::list<Context*> done;
+    {
+      std::lock_guard l{lock};
+      done.swap(pending);
+    }
+    for (auto c : done) {
+      c->complete(r);
+    }
+  }
+
+  bool wait_for_appends(int n) {
+    std::unique_lock l{lock};
+    return cond.wait_for(l, 10s, [&] { return num_appends >= n; });
+  }
+};
+
+rgw_log_entry make_entry(const std::string& bucket, const std::string& uri)
+{
+  rgw_log_entry entry;
+  entry.bucket = bucket;
+  entry.uri = uri;
+  entry.op = "get_obj";
+  entry.http_status = "200";
+  return entry;
+}
+
+std::vector<rgw_log_entry> decode_all(const bufferlist& bl)
+{
+  std::vector<rgw_log_entry> entries;
+  auto iter = bl.cbegin();
+  rgw_log_entry entry;
+  int r;
+  while ((r = rgw_log_entry_decode_next(iter, &entry)) > 0) {
+    entries.push_back(entry);
+  }
+  EXPECT_EQ(0, r);
+  return entries;
+}
+
+class OpsLogBatcherTest : public ::testing::Test {
+protected:
+  CephContext *cct = g_ceph_context;
+
+  void SetUp() override {
+    // only explicit flushes unless a test lowers these
+    cct->_conf.set_val("rgw_ops_log_flush_interval", "3600000");
+    cct->_conf.set_val("rgw_ops_log_flush_size", "64M");
+    cct->_conf.set_val("rgw_ops_log_max_buffer", "64M");
+    cct->_conf.set_val("rgw_ops_log_file_path", "");
+    if (!perfcounter) {
+      rgw_perf_start(cct);
+    }
+  }
+};
+
+} // anonymous namespace
+
+TEST(OpsLogDecode, decode_next)
+{
+  bufferlist bl;
+  encode(make_entry("b1", "/b1/o1"), bl);
+  encode(make_entry("b2", "/b2/o2"), bl);
+
+  auto entries = decode_all(bl);
+  ASSERT_EQ(2u, entries.size());
+  EXPECT_EQ("b1", entries[0].bucket);
+  EXPECT_EQ("/b1/o1", entries[0].uri);
+  EXPECT_EQ("b2", entries[1].bucket);
+  EXPECT_EQ("/b2/o2", entries[1].uri);
+}
+
+TEST(OpsLogDecode, decode_truncated)
+{
+  bufferlist bl;
+  encode(make_entry("b1", "/b1/o1"), bl);
+  bufferlist second;
+  encode(make_entry("b2", "/b2/o2"), second);
+  bl.append(second.c_str(), second.length() - 1);
+
+  auto iter = bl.cbegin();
+  rgw_log_entry entry;
+  EXPECT_EQ(1, rgw_log_entry_decode_next(iter, &entry));
+  EXPECT_EQ("b1", entry.bucket);
+  EXPECT_EQ(-EINVAL, rgw_log_entry_decode_next(iter, &entry));
+}
+
+TEST_F(OpsLogBatcherTest, batch_per_object)
+{
+  MockBackend backend;
+  OpsLogBatcher batcher(cct, &backend);
+
+  batcher.insert(make_entry("b1", "/b1/o1"), "log1", nullptr);
+  batcher.insert(make_entry("b2", "/b2/o1"), "log2", nullptr);
+  batcher.insert(make_entry("b1", "/b1/o2"), "log1", nullptr);
+  batcher.insert(make_entry("b1", "/b1/o3"), "", nullptr); // not to rados
+  EXPECT_LT(0u, batcher.get_buffered_bytes());
+  EXPECT_EQ(0, backend.num_appends);
+
+  batcher.flush();
+  EXPECT_EQ(0u, batcher.get_buffered_bytes());
+  // one append per log object, holding all of its entries in order
+  EXPECT_EQ(2, backend.num_appends);
+  auto log1 = decode_all(backend.objs["log1"]);
+  ASSERT_EQ(2u, log1.size());
+  EXPECT_EQ("/b1/o1", log1[0].uri);
+  EXPECT_EQ("/b1/o2", log1[1].uri);
+  auto log2 = decode_all(backend.objs["log2"]);
+  ASSERT_EQ(1u, log2.size());
+  EXPECT_EQ("/b2/o1", log2[0].uri);
+
+  // nothing buffered, nothing written
+  batcher.flush();
+  EXPECT_EQ(2, backend.num_appends);
+}
+
+TEST_F(OpsLogBatcherTest, flush_lat_on_completion)
+{
+  MockBackend backend;
+  OpsLogBatcher batcher(cct, &backend);
+
+  const auto before = perfcounter->get_tavg_ns(l_rgw_ops_log_flush_lat);
+  const auto bytes_before = perfcounter->get(l_rgw_ops_log_flushed_bytes);
+
+  batcher.insert(make_entry("b1", "/b1/o1"), "log1", nullptr);
+  batcher.insert(make_entry("b2", "/b2/o1"), "log2", nullptr);
+  const uint64_t bytes = batcher.get_buffered_bytes();
+  batcher.flush();
+  ASSERT_EQ(2, backend.num_appends);
+
+  // submitted but not completed
+  EXPECT_EQ(before.second,
+            perfcounter->get_tavg_ns(l_rgw_ops_log_flush_lat).second);
+
+  backend.complete_all(0);
+  EXPECT_EQ(before.second + 1,
+            perfcounter->get_tavg_ns(l_rgw_ops_log_flush_lat).second);
+  EXPECT_EQ(bytes_before + bytes,
+            perfcounter->get(l_rgw_ops_log_flushed_bytes));
+}
+
+TEST_F(OpsLogBatcherTest, max_buffer)
+{
+  bufferlist bl;
+  encode(make_entry("b1", "/b1/o1"), bl);
+  cct->_conf.set_val("rgw_ops_log_max_buffer",
+                     std::to_string(bl.length() * 2));
+
+  MockBackend backend;
+  OpsLogBatcher batcher(cct, &backend);
+
+  const auto dropped = perfcounter->get(l_rgw_ops_log_dropped);
+  for (int i = 0; i < 3; i++) {
+    batcher.insert(make_entry("b1", "/b1/o1"), "log1", nullptr);
+  }
+  EXPECT_EQ(bl.length() * 2, batcher.get_buffered_bytes());
+  EXPECT_EQ(dropped + 1, perfcounter->get(l_rgw_ops_log_dropped));
+
+  batcher.flush();
+  EXPECT_EQ(2u, decode_all(backend.objs["log1"]).size());
+
+  // room again after the flush
+  batcher.insert(make_entry("b1", "/b1/o1"), "log1", nullptr);
+  EXPECT_EQ(bl.length(), batcher.get_buffered_bytes());
+}
+
+TEST_F(OpsLogBatcherTest, flush_size)
+{
+  bufferlist bl;
+  encode(make_entry("b1", "/b1/o1"), bl);
+  cct->_conf.set_val("rgw_ops_log_flush_size",
+                     std::to_string(bl.length() * 2));
+
+  MockBackend backend;
+  OpsLogBatcher batcher(cct, &backend);
+
+  batcher.insert(make_entry("b1", "/b1/o1"), "log1", nullptr);
+  batcher.insert(make_entry("b1", "/b1/o2"), "log1", nullptr);
+  // the flush thread wakes up well before the hour long interval
+  ASSERT_TRUE(backend.wait_for_appends(1));
+  EXPECT_EQ(2u, decode_all(backend.objs["log1"]).size());
+}
+
+TEST_F(OpsLogBatcherTest, flush_on_shutdown)
+{
+  MockBackend backend;
+  {
+    OpsLogBatcher batcher(cct, &backend);
+    batcher.insert(make_entry("b1", "/b1/o1"), "log1", nullptr);
+  }
+  EXPECT_EQ(1, backend.num_appends);
+  EXPECT_EQ(1u, decode_all(backend.objs["log1"]).size());
+}
+
+TEST_F(OpsLogBatcherTest, log_file)
+{
+  char path[] = "/tmp/test_rgw_log_batcher.XXXXXX";
+  int fd = ::mkstemp(path);
+  ASSERT_LE(0, fd);
+  ::close(fd);
+  cct->_conf.set_val("rgw_ops_log_file_path", path);
+
+  MockBackend backend;
+  {
+    OpsLogBatcher batcher(cct, &backend);
+    batcher.insert(make_entry("b1", "/b1/o1"), "", nullptr);
+    batcher.insert(make_entry("b2", "/b2/o1"), "log2", nullptr);
+    batcher.flush();
+    batcher.insert(make_entry("b1", "/b1/o2"), "", nullptr);
+  }
+  EXPECT_EQ(1, backend.num_appends);
+
+  // what 'radosgw-admin log show --infile' reads back
+  bufferlist bl;
+  std::string err;
+  ASSERT_EQ(0, bl.read_file(path, &err));
+  ::unlink(path);
+  auto entries = decode_all(bl);
+  ASSERT_EQ(3u, entries.size());
+  EXPECT_EQ("/b1/o1", entries[0].uri);
+  EXPECT_EQ("/b2/o1", entries[1].uri);
+  EXPECT_EQ("/b1/o2", entries[2].uri);
+}
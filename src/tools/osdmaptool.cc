@@ -60,6 +60,7 @@ void usage()
   cout << "                           max deviation from target [default: 5]" << std::endl;
   cout << "   --upmap-pool <poolname> restrict upmap balancing to 1 or more pools" << std::endl;
   cout << "   --upmap-active          Act like an active balancer, keep applying changes until balanced" << std::endl;
+  cout << "   --upmap-threads <n>     balance up to <n> pools at a time [default: 1]" << std::endl;
   cout << "   --dump <format>         displays the map in plain text when <format> is 'plain', 'json' if specified format is not supported" << std::endl;
   cout << "   --tree                  displays a tree of the map" << std::endl;
   cout << "   --test-crush [--range-first <first> --range-last <last>] map pgs to acting osds" << std::endl;
@@ -153,6 +154,7 @@ int main(int argc, const char **argv)
   int upmap_max = 10;
   int upmap_deviation = 5;
   bool upmap_active = false;
+  int upmap_threads = 1;
   std::set<std::string> upmap_pools;
   int64_t pg_num = -1;
   bool test_map_pgs_dump_all = false;
@@ -184,6 +186,7 @@ int main(int argc, const char **argv)
       upmap = true;
     } else if (ceph_argparse_witharg(args, i, &upmap_max, err, "--upmap-max", (char*)NULL)) {
     } else if (ceph_argparse_witharg(args, i, &upmap_deviation, err, "--upmap-deviation", (char*)NULL)) {
+    } else if (ceph_argparse_witharg(args, i, &upmap_threads, err, "--upmap-threads", (char*)NULL)) {
     } else if (ceph_argparse_witharg(args, i, &val, "--upmap-pool", (char*)NULL)) {
       upmap_pools.insert(val);
     } else if (ceph_argparse_witharg(args, i, &num_osd, err, "--createsimple", (char*)NULL)) {
@@ -276,6 +279,10 @@ int main(int argc, const char **argv)
     cerr << me << ": upmap-deviation must be >= 1" << std::endl;
     usage();
   }
+  if (upmap_threads < 1) {
+    cerr << me << ": upmap-threads must be >= 1" << std::endl;
+    usage();
+  }
   fn = args[0];
 
   if (range_first >= 0 && range_last >= 0) {
@@ -442,6 +449,10 @@ int main(int argc, const char **argv)
     cout << "upmap, max-count " << upmap_max
 	 << ", max deviation " << upmap_deviation
 	 << std::endl;
+    if (upmap_threads > 1) {
+      cout << " balancing up to " << upmap_threads << " pools at a time"
+	   << std::endl;
+    }
     vector<int64_t> pools;
     set<int64_t> upmap_pool_nums;
     for (auto& s : upmap_pools) {
@@ -484,17 +495,28 @@ int main(int argc, const char **argv)
       struct timespec begin, end;
       r = clock_gettime(CLOCK_MONOTONIC, &begin);
       assert(r == 0);
-      for (auto& i: pools) {
-        set<int64_t> one_pool;
-        one_pool.insert(i);
-        int did = osdmap.calc_pg_upmaps(
+      if (upmap_threads > 1) {
+        vector<pair<int64_t,int>> pool_max;
+        for (auto& i: pools) {
+          pool_max.emplace_back(i, left);
+        }
+        total_did = osdmap.calc_pg_upmaps_parallel(
           g_ceph_context, upmap_deviation,
-          left, one_pool,
+          left, pool_max, upmap_threads,
           &pending_inc);
-        total_did += did;
-        left -= did;
-        if (left <= 0)
-          break;
+      } else {
+        for (auto& i: pools) {
+          set<int64_t> one_pool;
+          one_pool.insert(i);
+          int did = osdmap.calc_pg_upmaps(
+            g_ceph_context, upmap_deviation,
+            left, one_pool,
+            &pending_inc);
+          total_did += did;
+          left -= did;
+          if (left <= 0)
+            break;
+        }
       }
       r = clock_gettime(CLOCK_MONOTONIC, &end);
       assert(r == 0);
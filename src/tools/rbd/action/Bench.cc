@@ -7,9 +7,14 @@
 #include "common/errno.h"
 #include "common/strtol.h"
 #include "common/ceph_mutex.h"
+#include "common/Formatter.h"
+#include "common/perf_histogram.h"
 #include "include/types.h"
 #include "global/signal_handler.h"
+#include <cmath>
 #include <iostream>
+#include <memory>
+#include <random>
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics/stats.hpp>
 #include <boost/accumulators/statistics/rolling_sum.hpp>
@@ -44,7 +49,9 @@ enum io_type_t {
 enum io_pattern_t {
   IO_PATTERN_RAND,
   IO_PATTERN_SEQ,
-  IO_PATTERN_FULL_SEQ
+  IO_PATTERN_FULL_SEQ,
+  IO_PATTERN_ZIPF,
+  IO_PATTERN_HOTSPOT
 };
 
 struct IOType {};
@@ -74,6 +81,10 @@ void validate(boost::any& v, const std::vector<std::string>& values,
     v = IO_PATTERN_SEQ;
   } else if (s == "full-seq") {
     v = IO_PATTERN_FULL_SEQ;
+  } else if (s == "zipf") {
+    v = IO_PATTERN_ZIPF;
+  } else if (s == "hotspot") {
+    v = IO_PATTERN_HOTSPOT;
   } else {
     throw po::validation_error(po::validation_error::invalid_option_value);
   }
@@ -101,6 +112,226 @@ void validate(boost::any& v, const std::vector<std::string>& values,
     v = boost::any(io_type);
 }
 
+const char* get_io_pattern_name(io_pattern_t io_pattern) {
+  switch (io_pattern) {
+  case IO_PATTERN_RAND:
+    return "random";
+  case IO_PATTERN_SEQ:
+    return "sequential";
+  case IO_PATTERN_FULL_SEQ:
+    return "full sequential";
+  case IO_PATTERN_ZIPF:
+    return "zipf";
+  case IO_PATTERN_HOTSPOT:
+    return "hotspot";
+  default:
+    ceph_abort();
+  }
+}
+
+/*
+ * Zipf distributed block numbers in [0, n) using rejection-inversion
+ * sampling (W. Hormann, G. Derflinger), which needs O(1) setup even for
+ * very large images. Rank 1 is the hottest block; ranks are scattered over
+ * the image so that hot blocks do not all land in the first objects.
+ */
+class ZipfGenerator {
+public:
+  ZipfGenerator(uint64_t n, double theta)
+    : m_n(n), m_theta(theta),
+      m_h_integral_x1(h_integral(1.5) - 1.0),
+      m_h_integral_n(h_integral(n + 0.5)),
+      m_s(2.0 - h_integral_inverse(h_integral(2.5) - h(2.0))) {
+  }
+
+  template <typename RNG>
+  uint64_t operator()(RNG& rng) {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    uint64_t k;
+    while (true) {
+      double u = m_h_integral_n +
+        uniform(rng) * (m_h_integral_x1 - m_h_integral_n);
+      double x = h_integral_inverse(u);
+      k = static_cast<uint64_t>(std::max(x + 0.5, 1.0));
+      k = std::min(k, m_n);
+      if (k - x <= m_s || u >= h_integral(k + 0.5) - h(k)) {
+        break;
+      }
+    }
+    return scatter(k - 1);
+  }
+
+private:
+  // Knuth's multiplicative hash constant, a prime
+  static const uint64_t SCATTER_PRIME = 2654435761ULL;
+
+  uint64_t m_n;
+  double m_theta;
+  double m_h_integral_x1;
+  double m_h_integral_n;
+  double m_s;
+
+  uint64_t scatter(uint64_t rank) const {
+    // a bijection on [0, n) as long as the product cannot overflow
+    if (m_n > std::numeric_limits<uint32_t>::max() ||
+        m_n % SCATTER_PRIME == 0) {
+      return rank;
+    }
+    return (rank * SCATTER_PRIME) % m_n;
+  }
+
+  double h(double x) const {
+    return std::exp(-m_theta * std::log(x));
+  }
+
+  double h_integral(double x) const {
+    double log_x = std::log(x);
+    return helper2((1.0 - m_theta) * log_x) * log_x;
+  }
+
+  double h_integral_inverse(double x) const {
+    double t = std::max(x * (1.0 - m_theta), -1.0);
+    return std::exp(helper1(t) * x);
+  }
+
+  // log(1 + x) / x, accurate around 0
+  static double helper1(double x) {
+    if (std::abs(x) > 1e-8) {
+      return std::log1p(x) / x;
+    }
+    return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+  }
+
+  // (exp(x) - 1) / x, accurate around 0
+  static double helper2(double x) {
+    if (std::abs(x) > 1e-8) {
+      return std::expm1(x) / x;
+    }
+    return 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+  }
+};
+
+/*
+ * Per-op latency distribution in microseconds. Buckets are powers of two
+ * and percentiles are interpolated linearly within a bucket.
+ */
+class LatencyHistogram : public PerfHistogram<1> {
+public:
+  LatencyHistogram()
+    : PerfHistogram<1>({{"latency_usec", SCALE_LOG2, 0, 1, 32}}) {
+  }
+
+  void add(uint64_t usec) {
+    inc(static_cast<int64_t>(usec));
+    if (m_count == 0 || usec < m_min) {
+      m_min = usec;
+    }
+    m_max = std::max(m_max, usec);
+    m_sum += usec;
+    ++m_count;
+  }
+
+  void merge(const LatencyHistogram& other) {
+    if (other.m_count == 0) {
+      return;
+    }
+    for (int64_t i = 0; i < m_axes_config[0].m_buckets; ++i) {
+      m_rawData[i] += other.read_bucket(i);
+    }
+    if (m_count == 0 || other.m_min < m_min) {
+      m_min = other.m_min;
+    }
+    m_max = std::max(m_max, other.m_max);
+    m_sum += other.m_sum;
+    m_count += other.m_count;
+  }
+
+  uint64_t count() const {
+    return m_count;
+  }
+
+  double percentile(double p) const {
+    if (m_count == 0) {
+      return 0;
+    }
+
+    auto ranges = get_axis_bucket_ranges(m_axes_config[0]);
+    double target = p / 100.0 * m_count;
+    uint64_t cumulative = 0;
+    for (int64_t i = 0; i < m_axes_config[0].m_buckets; ++i) {
+      uint64_t bucket = read_bucket(i);
+      if (bucket == 0 || cumulative + bucket < target) {
+        cumulative += bucket;
+        continue;
+      }
+
+      double low = std::max<double>(ranges[i].first, m_min);
+      double high = std::min<double>(ranges[i].second, m_max);
+      double value = low + (high - low) * (target - cumulative) / bucket;
+      return std::max<double>(std::min<double>(value, m_max), m_min);
+    }
+    return m_max;
+  }
+
+  void dump(ceph::Formatter *f) const {
+    f->dump_unsigned("min", m_min);
+    f->dump_float("avg", m_count == 0 ? 0 : (double)m_sum / m_count);
+    f->dump_unsigned("max", m_max);
+    for (auto& p : PERCENTILES) {
+      f->dump_float(p.first, percentile(p.second));
+    }
+    f->open_object_section("histogram");
+    dump_formatted(f);
+    f->close_section();
+  }
+
+  void print(std::ostream& os) const {
+    os << "min: " << m_min << "   "
+       << "avg: " << (m_count == 0 ? 0 : m_sum / m_count) << "   ";
+    for (auto& p : PERCENTILES) {
+      os << p.first << ": " << (uint64_t)percentile(p.second) << "   ";
+    }
+    os << "max: " << m_max;
+  }
+
+private:
+  static const std::vector<std::pair<const char*, double>> PERCENTILES;
+
+  uint64_t m_count = 0;
+  uint64_t m_sum = 0;
+  uint64_t m_min = 0;
+  uint64_t m_max = 0;
+};
+
+const std::vector<std::pair<const char*, double>>
+LatencyHistogram::PERCENTILES = {
+  {"p50", 50}, {"p90", 90}, {"p95", 95}, {"p99", 99}, {"p99.9", 99.9}};
+
+struct OpStats {
+  uint64_t ops = 0;
+  uint64_t bytes = 0;
+  LatencyHistogram latency;
+
+  void merge(const OpStats& other) {
+    ops += other.ops;
+    bytes += other.bytes;
+    latency.merge(other.latency);
+  }
+};
+
+struct BenchConfig {
+  io_type_t io_type;
+  uint64_t io_size;
+  uint32_t io_threads;
+  uint32_t io_depth;
+  uint64_t io_bytes;
+  io_pattern_t io_pattern;
+  uint64_t read_proportion;
+  double zipf_theta;
+  uint64_t hotspot_data;
+  uint64_t hotspot_io;
+};
+
 } // anonymous namespace
 
 static void rbd_bencher_completion(void *c, void *pc);
@@ -109,10 +340,15 @@ struct rbd_bencher;
 struct bencher_completer {
   rbd_bencher *bencher;
   bufferlist *bl;
+  uint32_t stream;
+  bool read_flag;
+  mono_time start_time;
 
 public:
-  bencher_completer(rbd_bencher *bencher, bufferlist *bl)
-    : bencher(bencher), bl(bl)
+  bencher_completer(rbd_bencher *bencher, bufferlist *bl, uint32_t stream,
+                    bool read_flag)
+    : bencher(bencher), bl(bl), stream(stream), read_flag(read_flag),
+      start_time(mono_clock::now())
   { }
 
   ~bencher_completer()
@@ -123,56 +359,182 @@ public:
 };
 
 struct rbd_bencher {
-  librbd::Image *image;
-  ceph::mutex lock = ceph::make_mutex("rbd_bencher::lock");
-  ceph::condition_variable cond;
-  int in_flight;
-  io_type_t io_type;
-  uint64_t io_size;
+  std::string image_spec;
+  librados::IoCtx io_ctx;
+  librbd::Image image;
+  uint64_t size = 0;
+
+  // shared by all images in the benchmark
+  const BenchConfig *config = nullptr;
+  ceph::mutex *lock = nullptr;
+  ceph::condition_variable *cond = nullptr;
+  std::mt19937_64 *rng = nullptr;
+
+  int in_flight = 0;
+  std::vector<uint32_t> stream_in_flight;
+  std::vector<uint64_t> stream_offset;
+  uint32_t next_stream = 0;
+  uint64_t seq_chunk_length = 0;
+  uint64_t full_seq_offset = 0;
+  std::unique_ptr<ZipfGenerator> zipf;
+
+  uint64_t bytes_issued = 0;
+  OpStats read_stats;
+  OpStats write_stats;
   bufferlist write_bl;
 
-  explicit rbd_bencher(librbd::Image *i, io_type_t io_type, uint64_t io_size)
-    : image(i),
-      in_flight(0),
-      io_type(io_type),
-      io_size(io_size)
+  void init(const BenchConfig *config, ceph::mutex *lock,
+            ceph::condition_variable *cond, std::mt19937_64 *rng)
   {
-    if (io_type == IO_TYPE_WRITE || io_type == IO_TYPE_RW) {
+    this->config = config;
+    this->lock = lock;
+    this->cond = cond;
+    this->rng = rng;
+
+    auto io_size = config->io_size;
+    if (config->io_type == IO_TYPE_WRITE || config->io_type == IO_TYPE_RW) {
       bufferptr bp(io_size);
-      memset(bp.c_str(), rand() & 0xff, io_size);
+      memset(bp.c_str(), (*rng)() & 0xff, io_size);
       write_bl.push_back(bp);
     }
+
+    uint64_t blocks = size / io_size;
+    if (config->io_pattern == IO_PATTERN_ZIPF) {
+      zipf.reset(new ZipfGenerator(blocks, config->zipf_theta));
+    }
+
+    // disturb all thread's offset
+    seq_chunk_length = (blocks / config->io_threads) * io_size;
+    stream_in_flight.resize(config->io_threads);
+    for (uint32_t i = 0; i < config->io_threads; i++) {
+      uint64_t start_pos = 0;
+      if (config->io_pattern == IO_PATTERN_SEQ) {
+        start_pos = seq_chunk_length * i;
+      }
+      stream_offset.push_back(start_pos);
+    }
+  }
+
+  // returns a thread with less than io_depth ios in flight, or -1
+  int get_idle_stream()
+  {
+    auto io_threads = config->io_threads;
+    for (uint32_t i = 0; i < io_threads; ++i) {
+      uint32_t stream = (next_stream + i) % io_threads;
+      if (stream_in_flight[stream] < config->io_depth) {
+        next_stream = (stream + 1) % io_threads;
+        return stream;
+      }
+    }
+    return -1;
+  }
+
+  uint64_t get_random_block(uint64_t first, uint64_t count)
+  {
+    std::uniform_int_distribution<uint64_t> dist(first, first + count - 1);
+    return dist(*rng);
   }
 
-  void start_io(int max, uint64_t off, uint64_t len, int op_flags, bool read_flag)
+  uint64_t next_offset(uint32_t stream)
   {
-    {
-      std::lock_guard l{lock};
-      in_flight++;
+    auto io_size = config->io_size;
+    uint64_t blocks = size / io_size;
+    uint64_t offset = 0;
+    switch (config->io_pattern) {
+    case IO_PATTERN_RAND:
+      offset = get_random_block(0, blocks) * io_size;
+      break;
+    case IO_PATTERN_SEQ:
+      offset = stream_offset[stream];
+      stream_offset[stream] += io_size;
+      if (stream_offset[stream] + io_size > size ||
+          (stream + 1 < config->io_threads &&
+           stream_offset[stream] >= seq_chunk_length * (stream + 1))) {
+        stream_offset[stream] = seq_chunk_length * stream;
+      }
+      break;
+    case IO_PATTERN_FULL_SEQ:
+      offset = full_seq_offset;
+      full_seq_offset += io_size;
+      if (full_seq_offset + io_size > size) {
+        full_seq_offset = 0;
+      }
+      break;
+    case IO_PATTERN_ZIPF:
+      offset = (*zipf)(*rng) * io_size;
+      break;
+    case IO_PATTERN_HOTSPOT:
+      {
+        uint64_t hot_blocks = std::max<uint64_t>(
+          1, blocks * config->hotspot_data / 100);
+        std::uniform_int_distribution<uint64_t> pct(0, 99);
+        if (hot_blocks == blocks || pct(*rng) < config->hotspot_io) {
+          offset = get_random_block(0, hot_blocks) * io_size;
+        } else {
+          offset = get_random_block(hot_blocks, blocks - hot_blocks) * io_size;
+        }
+      }
+      break;
+    default:
+      ceph_abort();
     }
+    return offset;
+  }
+
+  bool should_read()
+  {
+    std::uniform_int_distribution<uint64_t> pct(0, 99);
+    return pct(*rng) < config->read_proportion;
+  }
+
+  // called with the shared lock held, which is dropped while submitting
+  void start_io(std::unique_lock<ceph::mutex>& locker, uint32_t stream)
+  {
+    bool read_flag = should_read();
+    uint64_t off = next_offset(stream);
+    uint64_t len = config->io_size;
+    int op_flags = (config->io_pattern == IO_PATTERN_SEQ ||
+                    config->io_pattern == IO_PATTERN_FULL_SEQ ?
+                      LIBRADOS_OP_FLAG_FADVISE_SEQUENTIAL :
+                      LIBRADOS_OP_FLAG_FADVISE_RANDOM);
+
+    in_flight++;
+    stream_in_flight[stream]++;
+    bytes_issued += len;
+    locker.unlock();
 
     librbd::RBD::AioCompletion *c;
     if (read_flag) {
       bufferlist *read_bl = new bufferlist();
-      c = new librbd::RBD::AioCompletion((void *)(new bencher_completer(this, read_bl)),
-					 rbd_bencher_completion);
-      image->aio_read2(off, len, *read_bl, c, op_flags);
+      c = new librbd::RBD::AioCompletion(
+        (void *)(new bencher_completer(this, read_bl, stream, true)),
+        rbd_bencher_completion);
+      image.aio_read2(off, len, *read_bl, c, op_flags);
     } else {
-      c = new librbd::RBD::AioCompletion((void *)(new bencher_completer(this, NULL)),
-					 rbd_bencher_completion);
-      image->aio_write2(off, len, write_bl, c, op_flags);
+      c = new librbd::RBD::AioCompletion(
+        (void *)(new bencher_completer(this, NULL, stream, false)),
+        rbd_bencher_completion);
+      image.aio_write2(off, len, write_bl, c, op_flags);
     }
-  }
 
-  int wait_for(int max, bool interrupt_on_terminating) {
-    std::unique_lock l{lock};
-    while (in_flight > max && !(terminating && interrupt_on_terminating)) {
-      cond.wait_for(l, 200ms);
-    }
-
-    return terminating ? -EINTR : 0;
+    locker.lock();
   }
 
+  void finish_io(bencher_completer *bc)
+  {
+    auto latency = duration_cast<microseconds>(
+      mono_clock::now() - bc->start_time);
+
+    std::lock_guard l{*lock};
+    auto& stats = (bc->read_flag ? read_stats : write_stats);
+    stats.ops++;
+    stats.bytes += config->io_size;
+    stats.latency.add(latency.count());
+
+    in_flight--;
+    stream_in_flight[bc->stream]--;
+    cond->notify_all();
+  }
 };
 
 void rbd_bencher_completion(void *vc, void *pc)
@@ -182,42 +544,55 @@ void rbd_bencher_completion(void *vc, void *pc)
   rbd_bencher *b = bc->bencher;
   //cout << "complete " << c << std::endl;
   int ret = c->get_return_value();
-  if (b->io_type == IO_TYPE_WRITE && ret != 0) {
+  if (!bc->read_flag && ret != 0) {
     std::cout << "write error: " << cpp_strerror(ret) << std::endl;
     exit(ret < 0 ? -ret : ret);
-  } else if (b->io_type == IO_TYPE_READ && (unsigned int)ret != b->io_size) {
+  } else if (bc->read_flag && (unsigned int)ret != b->config->io_size) {
     cout << "read error: " << cpp_strerror(ret) << std::endl;
     exit(ret < 0 ? -ret : ret);
   }
-  b->lock.lock();
-  b->in_flight--;
-  b->cond.notify_all();
-  b->lock.unlock();
+  b->finish_io(bc);
   c->release();
   delete bc;
 }
 
-bool should_read(uint64_t read_proportion)
+static void dump_op_stats(ceph::Formatter *f, const char *name,
+                          const OpStats &stats, double elapsed)
 {
-  uint64_t rand_num = rand() % 100;
+  f->open_object_section(name);
+  f->dump_unsigned("ops", stats.ops);
+  f->dump_unsigned("bytes", stats.bytes);
+  f->dump_float("ops_per_sec", stats.ops / elapsed);
+  f->dump_float("bytes_per_sec", stats.bytes / elapsed);
+  f->open_object_section("latency_usec");
+  stats.latency.dump(f);
+  f->close_section();
+  f->close_section();
+}
 
-  if (rand_num < read_proportion)
-    return true;
-  else
-    return false;
+static void print_latency(const char *name, const OpStats &stats)
+{
+  if (stats.ops == 0) {
+    return;
+  }
+  std::cout << name << "_lat_usec: ";
+  stats.latency.print(std::cout);
+  std::cout << std::endl;
 }
 
-int do_bench(librbd::Image& image, io_type_t io_type,
-		   uint64_t io_size, uint64_t io_threads,
-		   uint64_t io_bytes, io_pattern_t io_pattern,
-                   uint64_t read_proportion)
+int do_bench(std::vector<std::unique_ptr<rbd_bencher>>& benchers,
+             const BenchConfig& config, ceph::Formatter *formatter)
 {
-  uint64_t size = 0;
-  image.size(&size);
-  if (io_size > size) {
-    std::cerr << "rbd: io-size " << byte_u_t(io_size) << " "
-              << "larger than image size " << byte_u_t(size) << std::endl;
-    return -EINVAL;
+  auto io_type = config.io_type;
+  auto io_size = config.io_size;
+  for (auto& b : benchers) {
+    b->image.size(&b->size);
+    if (io_size > b->size) {
+      std::cerr << "rbd: io-size " << byte_u_t(io_size) << " "
+                << "larger than image " << b->image_spec << " size "
+                << byte_u_t(b->size) << std::endl;
+      return -EINVAL;
+    }
   }
 
   if (io_size > std::numeric_limits<uint32_t>::max()) {
@@ -225,67 +600,43 @@ int do_bench(librbd::Image& image, io_type_t io_type,
     return -EINVAL;
   }
 
-  int r = image.flush();
-  if (r < 0 && (r != -EROFS || io_type != IO_TYPE_READ)) {
-    std::cerr << "rbd: failed to flush: " << cpp_strerror(r) << std::endl;
-    return r;
+  for (auto& b : benchers) {
+    int r = b->image.flush();
+    if (r < 0 && (r != -EROFS || io_type != IO_TYPE_READ)) {
+      std::cerr << "rbd: failed to flush: " << cpp_strerror(r) << std::endl;
+      return r;
+    }
   }
 
-  rbd_bencher b(&image, io_type, io_size);
-
-  std::cout << "bench "
-       << " type " << (io_type == IO_TYPE_READ ? "read" :
-                       io_type == IO_TYPE_WRITE ? "write" : "readwrite")
-       << (io_type == IO_TYPE_RW ? " read:write=" +
-           to_string(read_proportion) + ":" + to_string(100 - read_proportion) : "")
-       << " io_size " << io_size
-       << " io_threads " << io_threads
-       << " bytes " << io_bytes
-       << " pattern ";
-  switch (io_pattern) {
-  case IO_PATTERN_RAND:
-    std::cout << "random";
-    break;
-  case IO_PATTERN_SEQ:
-    std::cout << "sequential";
-    break;
-  case IO_PATTERN_FULL_SEQ:
-    std::cout << "full sequential";
-    break;
-  default:
-    ceph_assert(false);
-    break;
+  ceph::mutex lock = ceph::make_mutex("rbd_bencher::lock");
+  ceph::condition_variable cond;
+  std::mt19937_64 rng(time(NULL));
+  for (auto& b : benchers) {
+    b->init(&config, &lock, &cond, &rng);
   }
-  std::cout << std::endl;
 
-  srand(time(NULL) % (unsigned long) -1);
+  if (formatter == nullptr) {
+    std::cout << "bench "
+         << " type " << (io_type == IO_TYPE_READ ? "read" :
+                         io_type == IO_TYPE_WRITE ? "write" : "readwrite")
+         << (io_type == IO_TYPE_RW ? " read:write=" +
+             to_string(config.read_proportion) + ":" +
+             to_string(100 - config.read_proportion) : "")
+         << " io_size " << io_size
+         << " io_threads " << config.io_threads;
+    if (config.io_depth > 1) {
+      std::cout << " io_depth " << config.io_depth;
+    }
+    std::cout << " bytes " << config.io_bytes
+              << " pattern " << get_io_pattern_name(config.io_pattern);
+    if (benchers.size() > 1) {
+      std::cout << " images " << benchers.size();
+    }
+    std::cout << std::endl;
+  }
 
   coarse_mono_time start = coarse_mono_clock::now();
   chrono::duration<double> last = chrono::duration<double>::zero();
-  unsigned ios = 0;
-
-  vector<uint64_t> thread_offset;
-  uint64_t i;
-  uint64_t seq_chunk_length = (size / io_size / io_threads) * io_size;;
-
-  // disturb all thread's offset
-  for (i = 0; i < io_threads; i++) {
-    uint64_t start_pos = 0;
-    switch (io_pattern) {
-    case IO_PATTERN_RAND:
-      start_pos = (rand() % (size / io_size)) * io_size;
-      break;
-    case IO_PATTERN_SEQ:
-      start_pos = seq_chunk_length * i;
-      break;
-    case IO_PATTERN_FULL_SEQ:
-      start_pos = i * io_size;
-      break;
-    default:
-      break;
-    }
-    thread_offset.push_back(start_pos);
-  }
 
   const int WINDOW_SIZE = 5;
   typedef boost::accumulators::accumulator_set<
@@ -298,116 +649,140 @@ int do_bench(librbd::Image& image, io_type_t io_type,
     boost::accumulators::tag::rolling_window::window_size = WINDOW_SIZE);
   RollingSum off_acc(
     boost::accumulators::tag::rolling_window::window_size = WINDOW_SIZE);
-  uint64_t cur_ios = 0;
-  uint64_t cur_off = 0;
+  uint64_t last_ios = 0;
+  uint64_t last_off = 0;
 
-  int op_flags;
-  if  (io_pattern == IO_PATTERN_RAND) {
-    op_flags = LIBRADOS_OP_FLAG_FADVISE_RANDOM;
-  } else {
-    op_flags = LIBRADOS_OP_FLAG_FADVISE_SEQUENTIAL;
+  if (formatter == nullptr) {
+    printf("  SEC       OPS   OPS/SEC   BYTES/SEC\n");
   }
 
-  printf("  SEC       OPS   OPS/SEC   BYTES/SEC\n");
-  uint64_t off;
-  int read_ops = 0;
-  int write_ops = 0;
-
-  for (off = 0; off < io_bytes; ) {
-    // Issue I/O
-    i = 0;
-    int r = 0;
-    while (i < io_threads && off < io_bytes) {
-      bool read_flag = should_read(read_proportion);
-
-      r = b.wait_for(io_threads - 1, true);
-      if (r < 0) {
-        break;
-      }
-      b.start_io(io_threads, thread_offset[i], io_size, op_flags, read_flag);
-
-      ++i;
-      ++ios;
-      off += io_size;
-
-      ++cur_ios;
-      cur_off += io_size;
-
-      if (read_flag)
-        read_ops++;
-      else
-        write_ops++;
-    }
-
-    if (r < 0) {
+  int r = 0;
+  std::unique_lock locker{lock};
+  while (true) {
+    if (terminating) {
+      r = -EINTR;
       break;
     }
 
-    // Set the thread_offsets of next I/O
-    for (i = 0; i < io_threads; ++i) {
-      switch (io_pattern) {
-      case IO_PATTERN_RAND:
-        thread_offset[i] = (rand() % (size / io_size)) * io_size;
+    // Issue I/O to every image that has an idle thread
+    bool done = true;
+    bool issued = false;
+    for (auto& b : benchers) {
+      if (b->bytes_issued >= config.io_bytes) {
         continue;
-      case IO_PATTERN_SEQ:
-        if (off < (seq_chunk_length * io_threads)) {
-          thread_offset[i] += io_size;
-        } else {
-          // thread_offset is adjusted to the chunks unassigned to threads.
-          thread_offset[i] = off + (i * io_size);
-        }
-        if (thread_offset[i] + io_size > size) {
-          thread_offset[i] = seq_chunk_length * i;
-        }
-        break;
-      case IO_PATTERN_FULL_SEQ:
-        thread_offset[i] += (io_size * io_threads);
-        if (thread_offset[i] >= size) {
-          thread_offset[i] = i * io_size;
-        }
-        break;
-      default:
-        break;
+      }
+      done = false;
+
+      int stream = b->get_idle_stream();
+      if (stream >= 0) {
+        b->start_io(locker, stream);
+        issued = true;
       }
     }
+    if (done) {
+      break;
+    } else if (!issued) {
+      cond.wait_for(locker, 200ms);
+    }
 
     coarse_mono_time now = coarse_mono_clock::now();
     chrono::duration<double> elapsed = now - start;
     if (last == chrono::duration<double>::zero()) {
       last = elapsed;
     } else if ((int)elapsed.count() != (int)last.count()) {
+      uint64_t ios = 0;
+      uint64_t off = 0;
+      for (auto& b : benchers) {
+        ios += b->read_stats.ops + b->write_stats.ops;
+        off += b->read_stats.bytes + b->write_stats.bytes;
+      }
       time_acc((elapsed - last).count());
-      ios_acc(static_cast<double>(cur_ios));
-      off_acc(static_cast<double>(cur_off));
-      cur_ios = 0;
-      cur_off = 0;
-
-      double time_sum = boost::accumulators::rolling_sum(time_acc);
-      std::cout.width(5);
-      std::cout << (int)elapsed.count();
-      std::cout.width(10);
-      std::cout << (int)(ios - io_threads);
-      std::cout.width(10);
-      std::cout << boost::accumulators::rolling_sum(ios_acc) / time_sum;
-      std::cout.width(10);
-      std::cout << byte_u_t(boost::accumulators::rolling_sum(off_acc) / time_sum) << "/s"
-                << std::endl;
+      ios_acc(static_cast<double>(ios - last_ios));
+      off_acc(static_cast<double>(off - last_off));
+      last_ios = ios;
+      last_off = off;
       last = elapsed;
+
+      if (formatter == nullptr) {
+        double time_sum = boost::accumulators::rolling_sum(time_acc);
+        std::cout.width(5);
+        std::cout << (int)elapsed.count();
+        std::cout.width(10);
+        std::cout << ios;
+        std::cout.width(10);
+        std::cout << boost::accumulators::rolling_sum(ios_acc) / time_sum;
+        std::cout.width(10);
+        std::cout << byte_u_t(boost::accumulators::rolling_sum(off_acc) /
+                              time_sum) << "/s"
+                  << std::endl;
+      }
     }
   }
-  b.wait_for(0, false);
+
+  // wait for all in-flight IOs, even if interrupted
+  for (auto& b : benchers) {
+    while (b->in_flight > 0) {
+      cond.wait_for(locker, 200ms);
+    }
+  }
+  locker.unlock();
 
   if (io_type != IO_TYPE_READ) {
-    r = image.flush();
-    if (r < 0) {
-      std::cerr << "rbd: failed to flush at the end: " << cpp_strerror(r)
-                << std::endl;
+    for (auto& b : benchers) {
+      int flush_r = b->image.flush();
+      if (flush_r < 0) {
+        std::cerr << "rbd: failed to flush at the end: "
+                  << cpp_strerror(flush_r) << std::endl;
+      }
     }
   }
 
   coarse_mono_time now = coarse_mono_clock::now();
   chrono::duration<double> elapsed = now - start;
 
+  OpStats read_stats;
+  OpStats write_stats;
+  for (auto& b : benchers) {
+    read_stats.merge(b->read_stats);
+    write_stats.merge(b->write_stats);
+  }
+  uint64_t ios = read_stats.ops + write_stats.ops;
+  uint64_t off = read_stats.bytes + write_stats.bytes;
+
+  if (formatter != nullptr) {
+    formatter->open_object_section("bench");
+    formatter->dump_string("io_type",
+                           io_type == IO_TYPE_READ ? "read" :
+                           io_type == IO_TYPE_WRITE ? "write" : "readwrite");
+    formatter->dump_unsigned("io_size", io_size);
+    formatter->dump_unsigned("io_threads", config.io_threads);
+    formatter->dump_unsigned("io_depth", config.io_depth);
+    formatter->dump_unsigned("io_total", config.io_bytes);
+    formatter->dump_string("io_pattern",
+                           get_io_pattern_name(config.io_pattern));
+    formatter->dump_unsigned("rw_mix_read", config.read_proportion);
+    formatter->dump_float("elapsed_sec", elapsed.count());
+    formatter->dump_unsigned("ops", ios);
+    formatter->dump_unsigned("bytes", off);
+    formatter->dump_float("ops_per_sec", ios / elapsed.count());
+    formatter->dump_float("bytes_per_sec", off / elapsed.count());
+    dump_op_stats(formatter, "read", read_stats, elapsed.count());
+    dump_op_stats(formatter, "write", write_stats, elapsed.count());
+    formatter->open_array_section("images");
+    for (auto& b : benchers) {
+      formatter->open_object_section("image");
+      formatter->dump_string("image", b->image_spec);
+      dump_op_stats(formatter, "read", b->read_stats, elapsed.count());
+      dump_op_stats(formatter, "write", b->write_stats, elapsed.count());
+      formatter->close_section();
+    }
+    formatter->close_section();
+    formatter->close_section();
+    formatter->flush(std::cout);
+    std::cout << std::endl;
+    return r == -EINTR ? 0 : r;
+  }
+
   std::cout << "elapsed: " << (int)elapsed.count() << "   "
             << "ops: " << ios << "   "
             << "ops/sec: " << (double)ios / elapsed.count() << "   "
@@ -415,31 +790,55 @@ int do_bench(librbd::Image& image, io_type_t io_type,
             << std::endl;
 
   if (io_type == IO_TYPE_RW) {
-  std::cout << "read_ops: " << read_ops << "   "
-            << "read_ops/sec: " << (double)read_ops / elapsed.count() << "   "
-            << "read_bytes/sec: " << byte_u_t((double)read_ops * io_size / elapsed.count()) << "/s"
+  std::cout << "read_ops: " << read_stats.ops << "   "
+            << "read_ops/sec: " << (double)read_stats.ops / elapsed.count() << "   "
+            << "read_bytes/sec: " << byte_u_t((double)read_stats.bytes / elapsed.count()) << "/s"
             << std::endl;
 
-  std::cout << "write_ops: " << write_ops << "   "
-            << "write_ops/sec: " << (double)write_ops / elapsed.count() << "   "
-            << "write_bytes/sec: " << byte_u_t((double)write_ops * io_size / elapsed.count()) << "/s"
+  std::cout << "write_ops: " << write_stats.ops << "   "
+            << "write_ops/sec: " << (double)write_stats.ops / elapsed.count() << "   "
+            << "write_bytes/sec: " << byte_u_t((double)write_stats.bytes / elapsed.count()) << "/s"
             << std::endl;
 
   }
 
-  return 0;
+  print_latency("read", read_stats);
+  print_latency("write", write_stats);
+
+  if (benchers.size() > 1) {
+    for (auto& b : benchers) {
+      uint64_t image_ios = b->read_stats.ops + b->write_stats.ops;
+      uint64_t image_off = b->read_stats.bytes + b->write_stats.bytes;
+      std::cout << "image " << b->image_spec << ": "
+                << "ops: " << image_ios << "   "
+                << "ops/sec: " << (double)image_ios / elapsed.count() << "   "
+                << "bytes/sec: "
+                << byte_u_t((double)image_off / elapsed.count()) << "/s"
+                << std::endl;
+    }
+  }
+
+  return r == -EINTR ? 0 : r;
 }
 
 void add_bench_common_options(po::options_description *positional,
 			      po::options_description *options) {
   at::add_image_spec_options(positional, options, at::ARGUMENT_MODIFIER_NONE);
+  positional->add_options()
+    ("additional-image-spec", po::value<std::vector<std::string>>()->multitoken(),
+     "additional images to benchmark concurrently");
 
   options->add_options()
     ("io-size", po::value<Size>(), "IO size (in B/K/M/G/T) [default: 4K]")
-    ("io-threads", po::value<uint32_t>(), "ios in flight [default: 16]")
-    ("io-total", po::value<Size>(), "total size for IO (in B/K/M/G/T) [default: 1G]")
-    ("io-pattern", po::value<IOPattern>(), "IO pattern (rand, seq, or full-seq) [default: seq]")
-    ("rw-mix-read", po::value<uint64_t>(), "read proportion in readwrite (<= 100) [default: 50]");
+    ("io-threads", po::value<uint32_t>(), "threads issuing ios per image [default: 16]")
+    ("io-depth", po::value<uint32_t>(), "ios in flight per thread [default: 1]")
+    ("io-total", po::value<Size>(), "total size for IO per image (in B/K/M/G/T) [default: 1G]")
+    ("io-pattern", po::value<IOPattern>(), "IO pattern (rand, seq, full-seq, zipf, or hotspot) [default: seq]")
+    ("rw-mix-read", po::value<uint64_t>(), "read proportion in readwrite (<= 100) [default: 50]")
+    ("zipf-theta", po::value<double>(), "skew of the zipf IO pattern (> 0) [default: 0.99]")
+    ("hotspot-data", po::value<uint64_t>(), "percentage of the image in the hotspot IO pattern's hot set (<= 100) [default: 10]")
+    ("hotspot-io", po::value<uint64_t>(), "percentage of ios sent to the hot set (<= 100) [default: 90]");
+  at::add_format_options(options);
 }
 
 void get_arguments_for_write(po::options_description *positional,
@@ -472,76 +871,183 @@ int bench_execute(const po::variables_map &vm, io_type_t bench_io_type) {
     return r;
   }
 
-  uint64_t bench_io_size;
+  struct ImageSpec {
+    std::string pool_name;
+    std::string namespace_name;
+    std::string image_name;
+    std::string snap_name;
+  };
+  std::vector<ImageSpec> image_specs{
+    {pool_name, namespace_name, image_name, snap_name}};
+
+  // any further positional arguments are additional images
+  while (true) {
+    std::string spec = utils::get_positional_argument(vm, arg_index++);
+    if (spec.empty()) {
+      break;
+    }
+
+    ImageSpec image_spec;
+    if (vm.count(at::POOL_NAME)) {
+      image_spec.pool_name = vm[at::POOL_NAME].as<std::string>();
+    }
+    if (vm.count(at::NAMESPACE_NAME)) {
+      image_spec.namespace_name = vm[at::NAMESPACE_NAME].as<std::string>();
+    }
+    r = utils::extract_spec(spec, &image_spec.pool_name,
+                            &image_spec.namespace_name,
+                            &image_spec.image_name, &image_spec.snap_name,
+                            utils::SPEC_VALIDATION_NONE);
+    if (r < 0) {
+      return r;
+    }
+    r = utils::validate_snapshot_name(at::ARGUMENT_MODIFIER_NONE,
+                                      image_spec.snap_name, snap_presence,
+                                      utils::SPEC_VALIDATION_NONE);
+    if (r < 0) {
+      return r;
+    }
+    image_specs.push_back(image_spec);
+  }
+
+  BenchConfig config;
+  config.io_type = bench_io_type;
+
   if (vm.count("io-size")) {
-    bench_io_size = vm["io-size"].as<uint64_t>();
+    config.io_size = vm["io-size"].as<uint64_t>();
   } else {
-    bench_io_size = 4096;
+    config.io_size = 4096;
   }
-  if (bench_io_size == 0) {
+  if (config.io_size == 0) {
     std::cerr << "rbd: --io-size should be greater than zero." << std::endl;
     return -EINVAL;
   }
 
-  uint32_t bench_io_threads;
   if (vm.count("io-threads")) {
-    bench_io_threads = vm["io-threads"].as<uint32_t>();
+    config.io_threads = vm["io-threads"].as<uint32_t>();
   } else {
-    bench_io_threads = 16;
+    config.io_threads = 16;
   }
-  if (bench_io_threads == 0) {
+  if (config.io_threads == 0) {
     std::cerr << "rbd: --io-threads should be greater than zero." << std::endl;
     return -EINVAL;
   }
 
-  uint64_t bench_bytes;
+  if (vm.count("io-depth")) {
+    config.io_depth = vm["io-depth"].as<uint32_t>();
+  } else {
+    config.io_depth = 1;
+  }
+  if (config.io_depth == 0) {
+    std::cerr << "rbd: --io-depth should be greater than zero." << std::endl;
+    return -EINVAL;
+  }
+
   if (vm.count("io-total")) {
-    bench_bytes = vm["io-total"].as<uint64_t>();
+    config.io_bytes = vm["io-total"].as<uint64_t>();
   } else {
-    bench_bytes = 1 << 30;
+    config.io_bytes = 1 << 30;
   }
 
-  io_pattern_t bench_pattern;
   if (vm.count("io-pattern")) {
-    bench_pattern = vm["io-pattern"].as<io_pattern_t>();
+    config.io_pattern = vm["io-pattern"].as<io_pattern_t>();
   } else {
-    bench_pattern = IO_PATTERN_SEQ;
+    config.io_pattern = IO_PATTERN_SEQ;
   }
 
-  uint64_t bench_read_proportion;
   if (bench_io_type == IO_TYPE_READ) {
-    bench_read_proportion = 100;
+    config.read_proportion = 100;
   } else if (bench_io_type == IO_TYPE_WRITE) {
-    bench_read_proportion = 0;
+    config.read_proportion = 0;
   } else {
     if (vm.count("rw-mix-read")) {
-      bench_read_proportion = vm["rw-mix-read"].as<uint64_t>();
+      config.read_proportion = vm["rw-mix-read"].as<uint64_t>();
     } else {
-      bench_read_proportion = 50;
+      config.read_proportion = 50;
     }
 
-    if (bench_read_proportion > 100) {
+    if (config.read_proportion > 100) {
       std::cerr << "rbd: --rw-mix-read should not be larger than 100." << std::endl;
       return -EINVAL;
     }
   }
 
+  if (vm.count("zipf-theta")) {
+    config.zipf_theta = vm["zipf-theta"].as<double>();
+  } else {
+    config.zipf_theta = 0.99;
+  }
+  if (!(config.zipf_theta > 0)) {
+    std::cerr << "rbd: --zipf-theta should be greater than zero." << std::endl;
+    return -EINVAL;
+  }
+
+  if (vm.count("hotspot-data")) {
+    config.hotspot_data = vm["hotspot-data"].as<uint64_t>();
+  } else {
+    config.hotspot_data = 10;
+  }
+  if (vm.count("hotspot-io")) {
+    config.hotspot_io = vm["hotspot-io"].as<uint64_t>();
+  } else {
+    config.hotspot_io = 90;
+  }
+  if (config.hotspot_data > 100 || config.hotspot_io > 100) {
+    std::cerr << "rbd: --hotspot-data and --hotspot-io should not be larger "
+              << "than 100." << std::endl;
+    return -EINVAL;
+  }
+
+  at::Format::Formatter formatter;
+  r = utils::get_formatter(vm, &formatter);
+  if (r < 0) {
+    return r;
+  }
+
+  utils::init_context();
+
   librados::Rados rados;
-  librados::IoCtx io_ctx;
-  librbd::Image image;
-  r = utils::init_and_open_image(pool_name, namespace_name, image_name, "",
-                                 snap_name, false, &rados, &io_ctx, &image);
+  r = utils::init_rados(&rados);
   if (r < 0) {
     return r;
   }
 
+  std::vector<std::unique_ptr<rbd_bencher>> benchers;
+  for (auto& image_spec : image_specs) {
+    std::unique_ptr<rbd_bencher> b(new rbd_bencher());
+    b->image_spec = image_spec.image_name;
+    if (!image_spec.snap_name.empty()) {
+      b->image_spec += "@" + image_spec.snap_name;
+    }
+    utils::normalize_pool_name(&image_spec.pool_name);
+    b->image_spec = image_spec.pool_name + "/" +
+      (image_spec.namespace_name.empty() ? "" :
+         image_spec.namespace_name + "/") + b->image_spec;
+
+    r = utils::init_io_ctx(rados, image_spec.pool_name,
+                           image_spec.namespace_name, &b->io_ctx);
+    if (r < 0) {
+      return r;
+    }
+    r = utils::open_image(b->io_ctx, image_spec.image_name, false, &b->image);
+    if (r < 0) {
+      return r;
+    }
+    if (!image_spec.snap_name.empty()) {
+      r = utils::snap_set(b->image, image_spec.snap_name);
+      if (r < 0) {
+        return r;
+      }
+    }
+    benchers.push_back(std::move(b));
+  }
+
   init_async_signal_handler();
   register_async_signal_handler(SIGHUP, sighup_handler);
   register_async_signal_handler_oneshot(SIGINT, handle_signal);
   register_async_signal_handler_oneshot(SIGTERM, handle_signal);
 
-  r = do_bench(image, bench_io_type, bench_io_size, bench_io_threads,
-		     bench_bytes, bench_pattern, bench_read_proportion);
+  r = do_bench(benchers, config, formatter.get());
 
   unregister_async_signal_handler(SIGHUP, sighup_handler);
   unregister_async_signal_handler(SIGINT, handle_signal);
@@ -12,6 +12,7 @@
 #include <iostream>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <vector>
 #include <boost/program_options.hpp>
 #include <boost/scope_exit.hpp>
 
@@ -19,27 +20,38 @@ namespace rbd {
 namespace action {
 namespace export_full {
 
+class C_ExportDiff;
+
 struct ExportDiffContext {
   librbd::Image *image;
   int fd;
   int export_format;
   uint64_t totalsize;
+  uint64_t max_read_length;
   utils::ProgressContext pc;
   OrderedThrottle throttle;
 
-  ExportDiffContext(librbd::Image *i, int f, uint64_t t, int max_ops,
-                    bool no_progress, int eformat) :
-    image(i), fd(f), export_format(eformat), totalsize(t), pc("Exporting image", no_progress),
+  // adjacent data extents that are read back with a single request
+  std::vector<std::pair<uint64_t, uint64_t>> pending_extents;
+  uint64_t pending_length = 0;
+
+  ExportDiffContext(librbd::Image *i, int f, uint64_t t, uint64_t max_read,
+                    int max_ops, bool no_progress, int eformat) :
+    image(i), fd(f), export_format(eformat), totalsize(t),
+    max_read_length(max_read), pc("Exporting image", no_progress),
     throttle(max_ops, true) {
   }
+
+  int send_pending();
 };
 
 class C_ExportDiff : public Context {
 public:
-  C_ExportDiff(ExportDiffContext *edc, uint64_t offset, uint64_t length,
-               bool exists, int export_format)
-    : m_export_diff_context(edc), m_offset(offset), m_length(length),
-      m_exists(exists), m_export_format(export_format) {
+  C_ExportDiff(ExportDiffContext *edc,
+               std::vector<std::pair<uint64_t, uint64_t>>&& extents,
+               uint64_t length, bool exists, int export_format)
+    : m_export_diff_context(edc), m_extents(std::move(extents)),
+      m_length(length), m_exists(exists), m_export_format(export_format) {
   }
 
   int send() {
@@ -54,7 +66,8 @@ public:
 
       int op_flags = LIBRADOS_OP_FLAG_FADVISE_NOCACHE;
       int r = m_export_diff_context->image->aio_read2(
-        m_offset, m_length, m_read_data, aio_completion, op_flags);
+        m_extents.front().first, m_length, m_read_data, aio_completion,
+        op_flags);
       if (r < 0) {
         aio_completion->release();
         ctx->complete(r);
@@ -69,55 +82,99 @@ public:
 			    void *arg) {
     ExportDiffContext *edc = reinterpret_cast<ExportDiffContext *>(arg);
 
-    C_ExportDiff *context = new C_ExportDiff(edc, offset, length, exists, edc->export_format);
+    if (exists) {
+      if (!edc->pending_extents.empty() &&
+          (edc->pending_extents.back().first +
+             edc->pending_extents.back().second != offset ||
+           edc->pending_length + length > edc->max_read_length)) {
+        int r = edc->send_pending();
+        if (r < 0) {
+          return r;
+        }
+      }
+      edc->pending_extents.emplace_back(offset, length);
+      edc->pending_length += length;
+      return 0;
+    }
+
+    // preserve the order of the extents in the stream
+    int r = edc->send_pending();
+    if (r < 0) {
+      return r;
+    }
+
+    C_ExportDiff *context = new C_ExportDiff(edc, {{offset, length}}, length,
+                                             false, edc->export_format);
     return context->send();
   }
 
 protected:
   void finish(int r) override {
-    if (r >= 0) {
-      if (m_exists) {
-        m_exists = !m_read_data.is_zero();
+    uint64_t buffer_offset = 0;
+    for (auto& [offset, length] : m_extents) {
+      if (r < 0) {
+        break;
       }
-      r = write_extent(m_export_diff_context, m_offset, m_length, m_exists, m_export_format);
-      if (r == 0 && m_exists) {
-        r = m_read_data.write_fd(m_export_diff_context->fd);
+
+      bufferlist bl;
+      bool exists = m_exists;
+      if (exists) {
+        bl.substr_of(m_read_data, buffer_offset, length);
+        exists = !bl.is_zero();
+        buffer_offset += length;
+      }
+
+      bufferlist extent_bl;
+      encode_extent(offset, length, exists, m_export_format, &extent_bl);
+      if (exists) {
+        extent_bl.claim_append(bl);
       }
+      r = extent_bl.write_fd(m_export_diff_context->fd);
+
+      m_export_diff_context->pc.update_progress(
+        offset, m_export_diff_context->totalsize);
     }
     m_export_diff_context->throttle.end_op(r);
   }
 
 private:
   ExportDiffContext *m_export_diff_context;
-  uint64_t m_offset;
+  std::vector<std::pair<uint64_t, uint64_t>> m_extents;
   uint64_t m_length;
   bool m_exists;
   int m_export_format;
   bufferlist m_read_data;
 
-  static int write_extent(ExportDiffContext *edc, uint64_t offset,
-                          uint64_t length, bool exists, int export_format) {
+  static void encode_extent(uint64_t offset, uint64_t length, bool exists,
+                            int export_format, bufferlist *bl) {
     // extent
-    bufferlist bl;
     __u8 tag = exists ? RBD_DIFF_WRITE : RBD_DIFF_ZERO;
     uint64_t len = 0;
-    encode(tag, bl);
+    encode(tag, *bl);
     if (export_format == 2) {
       if (tag == RBD_DIFF_WRITE)
 	len = 8 + 8 + length;
       else
 	len = 8 + 8;
-      encode(len, bl);
+      encode(len, *bl);
     }
-    encode(offset, bl);
-    encode(length, bl);
-    int r = bl.write_fd(edc->fd);
-
-    edc->pc.update_progress(offset, edc->totalsize);
-    return r;
+    encode(offset, *bl);
+    encode(length, *bl);
   }
 };
 
+int ExportDiffContext::send_pending() {
+  if (pending_extents.empty()) {
+    return 0;
+  }
+
+  C_ExportDiff *context = new C_ExportDiff(this, std::move(pending_extents),
+                                           pending_length, true,
+                                           export_format);
+  pending_extents.clear();
+  pending_length = 0;
+  return context->send();
+}
 
 int do_export_diff_fd(librbd::Image& image, const char *fromsnapname,
 		   const char *endsnapname, bool whole_object,
@@ -189,7 +246,7 @@ int do_export_diff_fd(librbd::Image& image, const char *fromsnapname,
       return r;
     }
   }
-  ExportDiffContext edc(&image, fd, info.size,
+  ExportDiffContext edc(&image, fd, info.size, info.obj_size,
                         g_conf().get_val<uint64_t>("rbd_concurrent_management_ops"),
                         no_progress, export_format);
   r = image.diff_iterate2(fromsnapname, 0, info.size, true, whole_object,
@@ -198,6 +255,11 @@ int do_export_diff_fd(librbd::Image& image, const char *fromsnapname,
     goto out;
   }
 
+  r = edc.send_pending();
+  if (r < 0) {
+    goto out;
+  }
+
   r = edc.throttle.wait_for_ret();
   if (r < 0) {
     goto out;
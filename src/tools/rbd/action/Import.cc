@@ -11,6 +11,7 @@
 #include "common/Throttle.h"
 #include "include/compat.h"
 #include "include/encoding.h"
+#include "include/interval_set.h"
 #include "common/debug.h"
 #include "common/errno.h"
 #include "common/safe_io.h"
@@ -33,11 +34,11 @@ struct ImportDiffContext {
   utils::ProgressContext pc;
   OrderedThrottle throttle;
   uint64_t last_offset;
+  interval_set<uint64_t> in_flight_extents;
 
   ImportDiffContext(librbd::Image *image, int fd, size_t size, bool no_progress)
     : image(image), fd(fd), size(size), pc("Importing image diff", no_progress),
-      throttle((fd == STDIN_FILENO) ? 1 :
-                  g_conf().get_val<uint64_t>("rbd_concurrent_management_ops"),
+      throttle(g_conf().get_val<uint64_t>("rbd_concurrent_management_ops"),
                false),
       last_offset(0) {
   }
@@ -98,6 +99,17 @@ public:
       return m_idiffctx->throttle.wait_for_ret();
     }
 
+    if (m_length > 0) {
+      if (m_idiffctx->in_flight_extents.intersects(m_offset, m_length)) {
+        // overlapping extents must be applied in stream order
+        int r = m_idiffctx->throttle.wait_for_ret();
+        if (r < 0) {
+          return r;
+        }
+      }
+      m_idiffctx->in_flight_extents.insert(m_offset, m_length);
+    }
+
     C_OrderedThrottle *ctx = m_idiffctx->throttle.start_op(this);
     librbd::RBD::AioCompletion *aio_completion =
       new librbd::RBD::AioCompletion(ctx, &utils::aio_context_callback);
@@ -123,6 +135,9 @@ public:
 
   void finish(int r) override
   {
+    if (m_length > 0) {
+      m_idiffctx->in_flight_extents.erase(m_offset, m_length);
+    }
     m_idiffctx->update_progress(m_prog_offset);
     m_idiffctx->throttle.end_op(r);
   }
@@ -225,6 +240,12 @@ static int do_image_resize(ImportDiffContext *idiffctx)
   auto p = bl.cbegin();
   decode(end_size, p);
 
+  // don't race with in-flight writes
+  r = idiffctx->throttle.wait_for_ret();
+  if (r < 0) {
+    return r;
+  }
+
   uint64_t cur_size;
   idiffctx->image->size(&cur_size);
   if (cur_size != end_size) {
@@ -0,0 +1,84 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "BandwidthThrottler.h"
+#include "common/debug.h"
+#include "common/errno.h"
+#include "include/Context.h"
+#include "librbd/asio/ContextWQ.h"
+
+#define dout_context g_ceph_context
+#define dout_subsys ceph_subsys_rbd_mirror
+#undef dout_prefix
+#define dout_prefix *_dout << "rbd::mirror::BandwidthThrottler: " << this \
+                           << " " << __func__ << ": "
+
+namespace rbd {
+namespace mirror {
+
+BandwidthThrottler::BandwidthThrottler(CephContext *cct,
+                                       const std::string &config_prefix,
+                                       SafeTimer *timer,
+                                       ceph::mutex *timer_lock,
+                                       librbd::asio::ContextWQ *work_queue)
+  : m_cct(cct), m_limit_key(config_prefix + "_limit"),
+    m_burst_key(config_prefix + "_burst"),
+    m_burst_seconds_key(config_prefix + "_burst_seconds"),
+    m_config_keys{m_limit_key.c_str(), m_burst_key.c_str(),
+                  m_burst_seconds_key.c_str(), nullptr},
+    m_work_queue(work_queue),
+    m_throttle(cct, config_prefix, 0, 0, timer, timer_lock) {
+  set_limit(m_cct->_conf);
+  m_cct->_conf.add_observer(this);
+}
+
+BandwidthThrottler::~BandwidthThrottler() {
+  m_cct->_conf.remove_observer(this);
+}
+
+void BandwidthThrottler::start_op(uint64_t bytes, Context *on_start) {
+  dout(20) << "bytes=" << bytes << dendl;
+
+  if (!m_throttle.get(bytes, this, &BandwidthThrottler::handle_tokens,
+                      on_start, 0)) {
+    on_start->complete(0);
+  }
+}
+
+void BandwidthThrottler::handle_tokens(Context *on_start, uint64_t flag) {
+  dout(20) << dendl;
+
+  // invoked from the timer thread with the timer lock held
+  m_work_queue->queue(on_start, 0);
+}
+
+void BandwidthThrottler::set_limit(const ConfigProxy& conf) {
+  auto limit = conf.get_val<uint64_t>(m_limit_key);
+  auto burst = conf.get_val<uint64_t>(m_burst_key);
+  auto burst_seconds = conf.get_val<uint64_t>(m_burst_seconds_key);
+  dout(5) << m_limit_key << "=" << limit << ", "
+          << m_burst_key << "=" << burst << ", "
+          << m_burst_seconds_key << "=" << burst_seconds << dendl;
+
+  int r = m_throttle.set_limit(limit, burst, burst_seconds);
+  if (r < 0) {
+    derr << "invalid " << m_burst_key << " " << burst << ": "
+         << cpp_strerror(r) << ", ignoring burst" << dendl;
+    m_throttle.set_limit(limit, 0, burst_seconds);
+  }
+}
+
+const char** BandwidthThrottler::get_tracked_conf_keys() const {
+  return m_config_keys;
+}
+
+void BandwidthThrottler::handle_conf_change(
+    const ConfigProxy& conf, const std::set<std::string> &changed) {
+  if (changed.count(m_limit_key) || changed.count(m_burst_key) ||
+      changed.count(m_burst_seconds_key)) {
+    set_limit(conf);
+  }
+}
+
+} // namespace mirror
+} // namespace rbd
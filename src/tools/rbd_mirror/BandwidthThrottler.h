@@ -0,0 +1,62 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef RBD_MIRROR_BANDWIDTH_THROTTLER_H
+#define RBD_MIRROR_BANDWIDTH_THROTTLER_H
+
+#include <set>
+#include <string>
+
+#include "common/ceph_mutex.h"
+#include "common/config_obs.h"
+#include "common/Throttle.h"
+#include "include/common_fwd.h"
+
+class Context;
+class SafeTimer;
+
+namespace librbd { namespace asio { struct ContextWQ; } }
+
+namespace rbd {
+namespace mirror {
+
+/*
+ * Daemon-wide token bucket shared by all image syncs. The limit is read
+ * from the "<config_prefix>_limit", "<config_prefix>_burst" and
+ * "<config_prefix>_burst_seconds" options and tracks runtime changes.
+ */
+class BandwidthThrottler : public md_config_obs_t {
+public:
+  BandwidthThrottler(CephContext *cct, const std::string &config_prefix,
+                     SafeTimer *timer, ceph::mutex *timer_lock,
+                     librbd::asio::ContextWQ *work_queue);
+  ~BandwidthThrottler() override;
+
+  BandwidthThrottler(const BandwidthThrottler&) = delete;
+  BandwidthThrottler& operator=(const BandwidthThrottler&) = delete;
+
+  // 'on_start' is queued once 'bytes' tokens are available
+  void start_op(uint64_t bytes, Context *on_start);
+
+private:
+  CephContext *m_cct;
+  const std::string m_limit_key;
+  const std::string m_burst_key;
+  const std::string m_burst_seconds_key;
+  mutable const char* m_config_keys[4];
+
+  librbd::asio::ContextWQ *m_work_queue;
+  TokenBucketThrottle m_throttle;
+
+  void set_limit(const ConfigProxy& conf);
+  void handle_tokens(Context *on_start, uint64_t flag);
+
+  const char **get_tracked_conf_keys() const override;
+  void handle_conf_change(const ConfigProxy& conf,
+                          const std::set<std::string> &changed) override;
+};
+
+} // namespace mirror
+} // namespace rbd
+
+#endif // RBD_MIRROR_BANDWIDTH_THROTTLER_H
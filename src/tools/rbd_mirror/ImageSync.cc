@@ -14,6 +14,7 @@
 #include "librbd/internal.h"
 #include "librbd/asio/ContextWQ.h"
 #include "librbd/deep_copy/Handler.h"
+#include "tools/rbd_mirror/BandwidthThrottler.h"
 #include "tools/rbd_mirror/Threads.h"
 #include "tools/rbd_mirror/image_sync/SyncPointCreateRequest.h"
 #include "tools/rbd_mirror/image_sync/SyncPointPruneRequest.h"
@@ -45,6 +46,15 @@ public:
     return 0;
   }
 
+  void throttle_read(uint64_t bytes, Context* on_ready) override {
+    auto throttler = image_sync->m_threads->image_sync_throttler;
+    if (throttler == nullptr) {
+      on_ready->complete(0);
+      return;
+    }
+    throttler->start_op(bytes, on_ready);
+  }
+
   ImageSync *image_sync;
 };
 
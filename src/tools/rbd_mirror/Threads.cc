@@ -2,6 +2,7 @@
 // vim: ts=8 sw=2 smarttab
 
 #include "tools/rbd_mirror/Threads.h"
+#include "tools/rbd_mirror/BandwidthThrottler.h"
 #include "common/Timer.h"
 #include "librbd/AsioEngine.h"
 #include "librbd/ImageCtx.h"
@@ -18,10 +19,15 @@ Threads<I>::Threads(std::shared_ptr<librados::Rados>& rados) {
 
   timer = new SafeTimer(cct, timer_lock, true);
   timer->init();
+
+  image_sync_throttler = new BandwidthThrottler(
+    cct, "rbd_mirror_image_sync_bps", timer, &timer_lock, work_queue);
 }
 
 template <typename I>
 Threads<I>::~Threads() {
+  delete image_sync_throttler;
+
   {
     std::lock_guard timer_locker{timer_lock};
     timer->shutdown();
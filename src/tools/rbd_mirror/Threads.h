@@ -21,6 +21,8 @@ namespace asio { struct ContextWQ; }
 namespace rbd {
 namespace mirror {
 
+class BandwidthThrottler;
+
 template <typename ImageCtxT = librbd::ImageCtx>
 class Threads {
 public:
@@ -30,6 +32,9 @@ public:
   SafeTimer *timer = nullptr;
   ceph::mutex timer_lock = ceph::make_mutex("Threads::timer_lock");
 
+  // daemon-wide bandwidth limit shared by all image syncs
+  BandwidthThrottler *image_sync_throttler = nullptr;
+
   explicit Threads(std::shared_ptr<librados::Rados>& rados);
   Threads(const Threads&) = delete;
   Threads& operator=(const Threads&) = delete;
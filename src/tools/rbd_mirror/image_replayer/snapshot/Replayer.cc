@@ -20,6 +20,7 @@
 #include "librbd/mirror/snapshot/GetImageStateRequest.h"
 #include "librbd/mirror/snapshot/ImageMeta.h"
 #include "librbd/mirror/snapshot/UnlinkPeerRequest.h"
+#include "tools/rbd_mirror/BandwidthThrottler.h"
 #include "tools/rbd_mirror/InstanceWatcher.h"
 #include "tools/rbd_mirror/PoolMetaCache.h"
 #include "tools/rbd_mirror/Threads.h"
@@ -102,6 +103,15 @@ struct Replayer<I>::DeepCopyHandler : public librbd::deep_copy::Handler {
     replayer->handle_copy_image_progress(object_number, object_count);
     return 0;
   }
+
+  void throttle_read(uint64_t bytes, Context* on_ready) override {
+    auto throttler = replayer->m_threads->image_sync_throttler;
+    if (throttler == nullptr) {
+      on_ready->complete(0);
+      return;
+    }
+    throttler->start_op(bytes, on_ready);
+  }
 };
 
 template <typename I>
@@ -272,6 +282,24 @@ bool Replayer<I>::get_replay_status(std::string* description,
   root_obj["bytes_per_snapshot"] = round_to_two_places(bytes_per_snapshot);
 
   auto pending_bytes = bytes_per_snapshot * m_pending_snapshots;
+  if (m_remote_snap_id_end != CEPH_NOSNAP && m_pending_snapshots > 0 &&
+      m_local_object_count > 0) {
+    // extrapolate the in-progress snapshot from the objects copied so far
+    // instead of assuming it is an average snapshot
+    auto last_copied_object_number = std::min(
+      m_local_mirror_snap_ns.last_copied_object_number, m_local_object_count);
+    auto copied_objects = last_copied_object_number -
+      std::min(m_copy_start_object_number, last_copied_object_number);
+    if (copied_objects > 0) {
+      auto syncing_bytes_remaining = static_cast<double>(m_snapshot_bytes) *
+        (m_local_object_count - last_copied_object_number) / copied_objects;
+      root_obj["syncing_bytes_remaining"] = round_to_two_places(
+        syncing_bytes_remaining);
+      pending_bytes = bytes_per_snapshot * (m_pending_snapshots - 1) +
+                      syncing_bytes_remaining;
+    }
+  }
+
   if (bytes_per_second > 0 && m_pending_snapshots > 0) {
     std::uint64_t seconds_until_synced = round_to_two_places(
       pending_bytes / bytes_per_second);
@@ -981,6 +1009,8 @@ void Replayer<I>::copy_image() {
            << "snap_seqs=" << m_local_mirror_snap_ns.snap_seqs << dendl;
 
   m_snapshot_bytes = 0;
+  m_copy_start_object_number =
+    m_local_mirror_snap_ns.last_copied_object_number;
   m_deep_copy_handler = new DeepCopyHandler(this);
   auto ctx = create_context_callback<
     Replayer<I>, &Replayer<I>::handle_copy_image>(this);
@@ -231,6 +231,7 @@ private:
   TimeRollingMean m_bytes_per_second;
 
   uint64_t m_snapshot_bytes = 0;
+  uint64_t m_copy_start_object_number = 0;
   boost::accumulators::accumulator_set<
     uint64_t, boost::accumulators::stats<
       boost::accumulators::tag::rolling_mean>> m_bytes_per_snapshot{
@@ -51,6 +51,7 @@ namespace fs = std::experimental::filesystem;
 #include <iostream>
 #include <memory>
 #include <regex>
+#include <thread>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/lexical_cast.hpp>
 
@@ -64,6 +65,7 @@ namespace fs = std::experimental::filesystem;
 #include "common/errno.h"
 #include "common/event_socket.h"
 #include "common/module.h"
+#include "common/perf_counters.h"
 #include "common/safe_io.h"
 #include "common/version.h"
 
@@ -96,6 +98,7 @@ struct Config {
   int max_part = 255;
   int io_timeout = -1;
   int reattach_timeout = 30;
+  int num_connections = 0;  // 0: one per CPU
 
   bool exclusive = false;
   bool quiesce = false;
@@ -145,6 +148,10 @@ static void usage()
             << "  --io-timeout <sec>       Set nbd IO timeout\n"
             << "  --max_part <limit>       Override for module param max_part\n"
             << "  --nbds_max <limit>       Override for module param nbds_max\n"
+            << "  --num-connections <num>  Number of connections to the nbd device,\n"
+            << "                           each served by its own threads;\n"
+            << "                           more than one needs --try-netlink\n"
+            << "                           (default: number of CPUs, 1 with ioctl)\n"
             << "  --quiesce                Use quiesce callbacks\n"
             << "  --quiesce-hook <path>    Specify quiesce hook path\n"
             << "                           (default: " << Config().quiesce_hook << ")\n"
@@ -163,6 +170,7 @@ static void usage()
 static int nbd = -1;
 static int nbd_index = -1;
 static EventSocket terminate_event_sock;
+static std::atomic<bool> got_signal = { false };
 
 #define RBD_NBD_BLKSIZE 512UL
 
@@ -186,25 +194,42 @@ static int run_quiesce_hook(const std::string &quiesce_hook,
                             const std::string &devpath,
                             const std::string &command);
 
+enum {
+  l_rbd_nbd_queue_first = 28000,
+  l_rbd_nbd_queue_rd,
+  l_rbd_nbd_queue_rd_bytes,
+  l_rbd_nbd_queue_rd_latency,
+  l_rbd_nbd_queue_wr,
+  l_rbd_nbd_queue_wr_bytes,
+  l_rbd_nbd_queue_wr_latency,
+  l_rbd_nbd_queue_flush,
+  l_rbd_nbd_queue_flush_latency,
+  l_rbd_nbd_queue_discard,
+  l_rbd_nbd_queue_discard_bytes,
+  l_rbd_nbd_queue_discard_latency,
+  l_rbd_nbd_queue_inflight,
+  l_rbd_nbd_queue_last,
+};
+
 class NBDServer
 {
 public:
   uint64_t quiesce_watch_handle = 0;
 
 private:
-  int fd;
   librbd::Image &image;
   Config *cfg;
 
 public:
-  NBDServer(int fd, librbd::Image& image, Config *cfg)
-    : fd(fd)
-    , image(image)
+  NBDServer(const std::vector<int> &fds, librbd::Image& image, Config *cfg)
+    : image(image)
     , cfg(cfg)
-    , reader_thread(*this, &NBDServer::reader_entry)
-    , writer_thread(*this, &NBDServer::writer_entry)
     , quiesce_thread(*this, &NBDServer::quiesce_entry)
   {
+    for (size_t i = 0; i < fds.size(); i++) {
+      queues.push_back(std::make_unique<Queue>(*this, i, fds[i]));
+    }
+
     std::vector<librbd::config_option_t> options;
     image.config_list(&options);
     for (auto &option : options) {
@@ -229,14 +254,17 @@ private:
   std::atomic<bool> terminated = { false };
   std::atomic<bool> allow_internal_flush = { false };
 
+  class Queue;
+
   struct IOContext
   {
     xlist<IOContext*>::item item;
-    NBDServer *server = nullptr;
+    Queue *queue = nullptr;
     struct nbd_request request;
     struct nbd_reply reply;
     bufferlist data;
     int command = 0;
+    ceph::mono_time start_time;
 
     IOContext()
       : item(this)
@@ -247,61 +275,6 @@ private:
 
   ceph::mutex lock = ceph::make_mutex("NBDServer::Locker");
   ceph::condition_variable cond;
-  xlist<IOContext*> io_pending;
-  xlist<IOContext*> io_finished;
-
-  void io_start(IOContext *ctx)
-  {
-    std::lock_guard l{lock};
-    io_pending.push_back(&ctx->item);
-  }
-
-  void io_finish(IOContext *ctx)
-  {
-    std::lock_guard l{lock};
-    ceph_assert(ctx->item.is_on_list());
-    ctx->item.remove_myself();
-    io_finished.push_back(&ctx->item);
-    cond.notify_all();
-  }
-
-  IOContext *wait_io_finish()
-  {
-    std::unique_lock l{lock};
-    cond.wait(l, [this] {
-                   return !io_finished.empty() ||
-                          (io_pending.empty() && terminated);
-                 });
-
-    if (io_finished.empty())
-      return NULL;
-
-    IOContext *ret = io_finished.front();
-    io_finished.pop_front();
-
-    return ret;
-  }
-
-  void wait_clean()
-  {
-    std::unique_lock l{lock};
-    cond.wait(l, [this] { return io_pending.empty(); });
-
-    while(!io_finished.empty()) {
-      std::unique_ptr<IOContext> free_ctx(io_finished.front());
-      io_finished.pop_front();
-    }
-  }
-
-  void assert_clean()
-  {
-    std::unique_lock l{lock};
-
-    ceph_assert(!reader_thread.is_started());
-    ceph_assert(!writer_thread.is_started());
-    ceph_assert(io_pending.empty());
-    ceph_assert(io_finished.empty());
-  }
 
   static void aio_callback(librbd::completion_t cb, void *arg)
   {
@@ -333,156 +306,362 @@ private:
     } else {
       ctx->reply.error = htonl(0);
     }
-    ctx->server->io_finish(ctx);
+    ctx->queue->io_finish(ctx);
 
     aio_completion->release();
   }
 
-  void reader_entry()
+  /*
+   * Serves one connection of the nbd device. Each queue has its own
+   * reader and writer threads, so request parsing and reply writing
+   * scale with the number of connections.
+   */
+  class Queue
   {
-    struct pollfd poll_fds[2];
-    memset(poll_fds, 0, sizeof(struct pollfd) * 2);
-    poll_fds[0].fd = fd;
-    poll_fds[0].events = POLLIN;
-    poll_fds[1].fd = terminate_event_fd;
-    poll_fds[1].events = POLLIN;
+  public:
+    Queue(NBDServer &server, int index, int fd)
+      : server(server)
+      , index(index)
+      , fd(fd)
+      , reader_thread(*this, &Queue::reader_entry)
+      , writer_thread(*this, &Queue::writer_entry)
+    {
+      PerfCountersBuilder plb(g_ceph_context,
+                              "rbd_nbd_queue_" + stringify(index),
+                              l_rbd_nbd_queue_first, l_rbd_nbd_queue_last);
+      plb.add_u64_counter(l_rbd_nbd_queue_rd, "rd", "Reads", "r");
+      plb.add_u64_counter(l_rbd_nbd_queue_rd_bytes, "rd_bytes", "Data size in reads",
+                          "rb", PerfCountersBuilder::PRIO_USEFUL,
+                          unit_t(UNIT_BYTES));
+      plb.add_time_avg(l_rbd_nbd_queue_rd_latency, "rd_latency",
+                       "Latency of reads", "rl");
+      plb.add_u64_counter(l_rbd_nbd_queue_wr, "wr", "Writes", "w");
+      plb.add_u64_counter(l_rbd_nbd_queue_wr_bytes, "wr_bytes", "Written data",
+                          "wb", PerfCountersBuilder::PRIO_USEFUL,
+                          unit_t(UNIT_BYTES));
+      plb.add_time_avg(l_rbd_nbd_queue_wr_latency, "wr_latency",
+                       "Write latency", "wl");
+      plb.add_u64_counter(l_rbd_nbd_queue_flush, "flush", "Flushes");
+      plb.add_time_avg(l_rbd_nbd_queue_flush_latency, "flush_latency",
+                       "Latency of flushes");
+      plb.add_u64_counter(l_rbd_nbd_queue_discard, "discard", "Discards");
+      plb.add_u64_counter(l_rbd_nbd_queue_discard_bytes, "discard_bytes",
+                          "Discarded data", NULL, 0, unit_t(UNIT_BYTES));
+      plb.add_time_avg(l_rbd_nbd_queue_discard_latency, "discard_latency",
+                       "Discard latency");
+      plb.add_u64(l_rbd_nbd_queue_inflight, "inflight",
+                  "Requests in flight");
+      perf_counters = plb.create_perf_counters();
+      g_ceph_context->get_perfcounters_collection()->add(perf_counters);
+    }
 
-    while (true) {
-      std::unique_ptr<IOContext> ctx(new IOContext());
-      ctx->server = this;
+    ~Queue()
+    {
+      g_ceph_context->get_perfcounters_collection()->remove(perf_counters);
+      delete perf_counters;
+    }
 
-      dout(20) << __func__ << ": waiting for nbd request" << dendl;
+    void start()
+    {
+      reader_thread.create(("rbd_reader" + stringify(index)).c_str());
+      writer_thread.create(("rbd_writer" + stringify(index)).c_str());
+    }
 
-      int r = poll(poll_fds, 2, -1);
-      if (r == -1) {
-        if (errno == EINTR) {
-          continue;
-        }
-        r = -errno;
-        derr << "failed to poll nbd: " << cpp_strerror(r) << dendl;
-        goto signal;
-      }
+    void join()
+    {
+      reader_thread.join();
+      writer_thread.join();
+    }
 
-      if ((poll_fds[1].revents & POLLIN) != 0) {
-        dout(0) << __func__ << ": terminate received" << dendl;
-        goto signal;
-      }
+    void wake_up()
+    {
+      std::lock_guard l{lock};
+      cond.notify_all();
+    }
 
-      if ((poll_fds[0].revents & POLLIN) == 0) {
-        dout(20) << __func__ << ": nothing to read" << dendl;
-        continue;
-      }
+    void io_finish(IOContext *ctx)
+    {
+      std::lock_guard l{lock};
+      ceph_assert(ctx->item.is_on_list());
+      ctx->item.remove_myself();
+      io_finished.push_back(&ctx->item);
+      cond.notify_all();
+    }
 
-      r = safe_read_exact(fd, &ctx->request, sizeof(struct nbd_request));
-      if (r < 0) {
-	derr << "failed to read nbd request header: " << cpp_strerror(r)
-	     << dendl;
-	goto signal;
-      }
+    void assert_clean()
+    {
+      std::unique_lock l{lock};
 
-      if (ctx->request.magic != htonl(NBD_REQUEST_MAGIC)) {
-	derr << "invalid nbd request header" << dendl;
-	goto signal;
-      }
+      ceph_assert(!reader_thread.is_started());
+      ceph_assert(!writer_thread.is_started());
+      ceph_assert(io_pending.empty());
+      ceph_assert(io_finished.empty());
+    }
+
+  private:
+    NBDServer &server;
+    int index;
+    int fd;
+    PerfCounters *perf_counters = nullptr;
 
-      ctx->request.from = ntohll(ctx->request.from);
-      ctx->request.type = ntohl(ctx->request.type);
-      ctx->request.len = ntohl(ctx->request.len);
+    ceph::mutex lock = ceph::make_mutex("NBDServer::Queue::Locker");
+    ceph::condition_variable cond;
+    xlist<IOContext*> io_pending;
+    xlist<IOContext*> io_finished;
 
-      ctx->reply.magic = htonl(NBD_REPLY_MAGIC);
-      memcpy(ctx->reply.handle, ctx->request.handle, sizeof(ctx->reply.handle));
+    void io_start(IOContext *ctx)
+    {
+      std::lock_guard l{lock};
+      io_pending.push_back(&ctx->item);
+      perf_counters->inc(l_rbd_nbd_queue_inflight);
+    }
 
-      ctx->command = ctx->request.type & 0x0000ffff;
+    IOContext *wait_io_finish()
+    {
+      std::unique_lock l{lock};
+      cond.wait(l, [this] {
+                     return !io_finished.empty() ||
+                            (io_pending.empty() && server.terminated);
+                   });
 
-      dout(20) << *ctx << ": start" << dendl;
+      if (io_finished.empty())
+        return NULL;
 
-      switch (ctx->command)
-      {
-        case NBD_CMD_DISC:
-          // NBD_DO_IT will return when pipe is closed
-	  dout(0) << "disconnect request received" << dendl;
-          goto signal;
-        case NBD_CMD_WRITE:
-          bufferptr ptr(ctx->request.len);
-	  r = safe_read_exact(fd, ptr.c_str(), ctx->request.len);
-          if (r < 0) {
-	    derr << *ctx << ": failed to read nbd request data: "
-		 << cpp_strerror(r) << dendl;
-            goto signal;
-	  }
-          ctx->data.push_back(ptr);
-          break;
+      IOContext *ret = io_finished.front();
+      io_finished.pop_front();
+
+      return ret;
+    }
+
+    void wait_clean()
+    {
+      std::unique_lock l{lock};
+      cond.wait(l, [this] { return io_pending.empty(); });
+
+      while(!io_finished.empty()) {
+        std::unique_ptr<IOContext> free_ctx(io_finished.front());
+        io_finished.pop_front();
+        perf_counters->dec(l_rbd_nbd_queue_inflight);
       }
+    }
 
-      IOContext *pctx = ctx.release();
-      io_start(pctx);
-      librbd::RBD::AioCompletion *c = new librbd::RBD::AioCompletion(pctx, aio_callback);
-      switch (pctx->command)
+    void update_counters(const IOContext &ctx)
+    {
+      auto latency = ceph::mono_clock::now() - ctx.start_time;
+      perf_counters->dec(l_rbd_nbd_queue_inflight);
+      switch (ctx.command)
       {
         case NBD_CMD_WRITE:
-          image.aio_write(pctx->request.from, pctx->request.len, pctx->data, c);
+          perf_counters->inc(l_rbd_nbd_queue_wr);
+          perf_counters->inc(l_rbd_nbd_queue_wr_bytes, ctx.request.len);
+          perf_counters->tinc(l_rbd_nbd_queue_wr_latency, latency);
           break;
         case NBD_CMD_READ:
-          image.aio_read(pctx->request.from, pctx->request.len, pctx->data, c);
+          perf_counters->inc(l_rbd_nbd_queue_rd);
+          perf_counters->inc(l_rbd_nbd_queue_rd_bytes, ctx.request.len);
+          perf_counters->tinc(l_rbd_nbd_queue_rd_latency, latency);
           break;
         case NBD_CMD_FLUSH:
-          image.aio_flush(c);
-          allow_internal_flush = true;
+          perf_counters->inc(l_rbd_nbd_queue_flush);
+          perf_counters->tinc(l_rbd_nbd_queue_flush_latency, latency);
           break;
         case NBD_CMD_TRIM:
-          image.aio_discard(pctx->request.from, pctx->request.len, c);
+          perf_counters->inc(l_rbd_nbd_queue_discard);
+          perf_counters->inc(l_rbd_nbd_queue_discard_bytes, ctx.request.len);
+          perf_counters->tinc(l_rbd_nbd_queue_discard_latency, latency);
           break;
-        default:
-	  derr << *pctx << ": invalid request command" << dendl;
-          c->release();
-          goto signal;
       }
     }
-signal:
-    std::lock_guard l{lock};
-    terminated = true;
-    cond.notify_all();
 
-    std::lock_guard disconnect_l{disconnect_lock};
-    disconnect_cond.notify_all();
+    void reader_entry()
+    {
+      librbd::Image &image = server.image;
+      struct pollfd poll_fds[2];
+      memset(poll_fds, 0, sizeof(struct pollfd) * 2);
+      poll_fds[0].fd = fd;
+      poll_fds[0].events = POLLIN;
+      poll_fds[1].fd = server.terminate_event_fd;
+      poll_fds[1].events = POLLIN;
+
+      while (true) {
+        std::unique_ptr<IOContext> ctx(new IOContext());
+        ctx->queue = this;
+
+        dout(20) << __func__ << ": " << index << ": waiting for nbd request"
+                 << dendl;
+
+        int r = poll(poll_fds, 2, -1);
+        if (r == -1) {
+          if (errno == EINTR) {
+            continue;
+          }
+          r = -errno;
+          derr << "failed to poll nbd: " << cpp_strerror(r) << dendl;
+          goto signal;
+        }
 
-    dout(20) << __func__ << ": terminated" << dendl;
-  }
+        if ((poll_fds[1].revents & POLLIN) != 0) {
+          dout(0) << __func__ << ": " << index << ": terminate received"
+                  << dendl;
+          goto signal;
+        }
 
-  void writer_entry()
-  {
-    while (true) {
-      dout(20) << __func__ << ": waiting for io request" << dendl;
-      std::unique_ptr<IOContext> ctx(wait_io_finish());
-      if (!ctx) {
-	dout(20) << __func__ << ": no io requests, terminating" << dendl;
-        goto done;
-      }
+        if ((poll_fds[0].revents & POLLIN) == 0) {
+          dout(20) << __func__ << ": nothing to read" << dendl;
+          continue;
+        }
+
+        r = safe_read_exact(fd, &ctx->request, sizeof(struct nbd_request));
+        if (r < 0) {
+          derr << "failed to read nbd request header: " << cpp_strerror(r)
+               << dendl;
+          goto signal;
+        }
+
+        if (ctx->request.magic != htonl(NBD_REQUEST_MAGIC)) {
+          derr << "invalid nbd request header" << dendl;
+          goto signal;
+        }
 
-      dout(20) << __func__ << ": got: " << *ctx << dendl;
+        ctx->start_time = ceph::mono_clock::now();
+        ctx->request.from = ntohll(ctx->request.from);
+        ctx->request.type = ntohl(ctx->request.type);
+        ctx->request.len = ntohl(ctx->request.len);
 
-      int r = safe_write(fd, &ctx->reply, sizeof(struct nbd_reply));
-      if (r < 0) {
-	derr << *ctx << ": failed to write reply header: " << cpp_strerror(r)
-	     << dendl;
-        goto error;
+        ctx->reply.magic = htonl(NBD_REPLY_MAGIC);
+        memcpy(ctx->reply.handle, ctx->request.handle, sizeof(ctx->reply.handle));
+
+        ctx->command = ctx->request.type & 0x0000ffff;
+
+        dout(20) << *ctx << ": start" << dendl;
+
+        switch (ctx->command)
+        {
+          case NBD_CMD_DISC:
+            // NBD_DO_IT will return when pipe is closed
+            dout(0) << "disconnect request received" << dendl;
+            goto signal;
+          case NBD_CMD_WRITE:
+            bufferptr ptr(ctx->request.len);
+            r = safe_read_exact(fd, ptr.c_str(), ctx->request.len);
+            if (r < 0) {
+              derr << *ctx << ": failed to read nbd request data: "
+                   << cpp_strerror(r) << dendl;
+              goto signal;
+            }
+            ctx->data.push_back(ptr);
+            break;
+        }
+
+        IOContext *pctx = ctx.release();
+        io_start(pctx);
+        librbd::RBD::AioCompletion *c = new librbd::RBD::AioCompletion(pctx, aio_callback);
+        switch (pctx->command)
+        {
+          case NBD_CMD_WRITE:
+            image.aio_write(pctx->request.from, pctx->request.len, pctx->data, c);
+            break;
+          case NBD_CMD_READ:
+            image.aio_read(pctx->request.from, pctx->request.len, pctx->data, c);
+            break;
+          case NBD_CMD_FLUSH:
+            image.aio_flush(c);
+            server.allow_internal_flush = true;
+            break;
+          case NBD_CMD_TRIM:
+            image.aio_discard(pctx->request.from, pctx->request.len, c);
+            break;
+          default:
+            derr << *pctx << ": invalid request command" << dendl;
+            c->release();
+            goto signal;
+        }
       }
-      if (ctx->command == NBD_CMD_READ && ctx->reply.error == htonl(0)) {
-	r = ctx->data.write_fd(fd);
+  signal:
+      server.terminate();
+
+      dout(20) << __func__ << ": " << index << ": terminated" << dendl;
+    }
+
+    void writer_entry()
+    {
+      while (true) {
+        dout(20) << __func__ << ": " << index << ": waiting for io request"
+                 << dendl;
+        std::unique_ptr<IOContext> ctx(wait_io_finish());
+        if (!ctx) {
+          dout(20) << __func__ << ": no io requests, terminating" << dendl;
+          goto done;
+        }
+
+        dout(20) << __func__ << ": got: " << *ctx << dendl;
+
+        int r = safe_write(fd, &ctx->reply, sizeof(struct nbd_reply));
         if (r < 0) {
-	  derr << *ctx << ": failed to write replay data: " << cpp_strerror(r)
-	       << dendl;
+          derr << *ctx << ": failed to write reply header: " << cpp_strerror(r)
+               << dendl;
           goto error;
-	}
+        }
+        if (ctx->command == NBD_CMD_READ && ctx->reply.error == htonl(0)) {
+          r = ctx->data.write_fd(fd);
+          if (r < 0) {
+            derr << *ctx << ": failed to write replay data: " << cpp_strerror(r)
+                 << dendl;
+            goto error;
+          }
+        }
+        update_counters(*ctx);
+        dout(20) << *ctx << ": finish" << dendl;
       }
-      dout(20) << *ctx << ": finish" << dendl;
+    error:
+      wait_clean();
+    done:
+      ::shutdown(fd, SHUT_RDWR);
+
+      dout(20) << __func__ << ": " << index << ": terminated" << dendl;
     }
-  error:
-    wait_clean();
-  done:
-    ::shutdown(fd, SHUT_RDWR);
 
-    dout(20) << __func__ << ": terminated" << dendl;
+    class ThreadHelper : public Thread
+    {
+    public:
+      typedef void (Queue::*entry_func)();
+    private:
+      Queue &queue;
+      entry_func func;
+    public:
+      ThreadHelper(Queue &_queue, entry_func _func)
+        :queue(_queue)
+        ,func(_func)
+      {}
+    protected:
+      void* entry() override
+      {
+        (queue.*func)();
+        return NULL;
+      }
+    } reader_thread, writer_thread;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+
+  /*
+   * Stops all queues once any of them stops: the kernel disconnects
+   * all connections of a device together.
+   */
+  void terminate()
+  {
+    {
+      std::lock_guard l{lock};
+      terminated = true;
+      cond.notify_all();
+    }
+    terminate_event_sock.notify();
+    for (auto &queue : queues) {
+      queue->wake_up();
+    }
+
+    std::lock_guard disconnect_l{disconnect_lock};
+    disconnect_cond.notify_all();
   }
 
   bool wait_quiesce() {
@@ -578,7 +757,7 @@ signal:
       (server.*func)();
       return NULL;
     }
-  } reader_thread, writer_thread, quiesce_thread;
+  } quiesce_thread;
 
   bool started = false;
   bool quiesce = false;
@@ -587,7 +766,8 @@ public:
   void start()
   {
     if (!started) {
-      dout(10) << __func__ << ": starting" << dendl;
+      dout(10) << __func__ << ": starting " << queues.size() << " queues"
+               << dendl;
 
       started = true;
 
@@ -597,8 +777,9 @@ public:
                                         EVENT_SOCKET_TYPE_EVENTFD);
       ceph_assert(r >= 0);
 
-      reader_thread.create("rbd_reader");
-      writer_thread.create("rbd_writer");
+      for (auto &queue : queues) {
+        queue->start();
+      }
       if (cfg->quiesce) {
         quiesce_thread.create("rbd_quiesce");
       }
@@ -611,7 +792,7 @@ public:
       return;
 
     std::unique_lock l{disconnect_lock};
-    disconnect_cond.wait(l);
+    disconnect_cond.wait(l, [this] { return terminated.load(); });
   }
 
   void notify_quiesce() {
@@ -643,13 +824,16 @@ public:
 
       terminate_event_sock.notify();
 
-      reader_thread.join();
-      writer_thread.join();
+      for (auto &queue : queues) {
+        queue->join();
+      }
       if (cfg->quiesce) {
         quiesce_thread.join();
       }
 
-      assert_clean();
+      for (auto &queue : queues) {
+        queue->assert_clean();
+      }
 
       close(terminate_event_fd);
       started = false;
@@ -974,10 +1158,65 @@ static int parse_nbd_index(const std::string& devpath)
   return index;
 }
 
-static int try_ioctl_setup(Config *cfg, int fd, uint64_t size, uint64_t flags)
+/*
+ * The connection count of a mapping, for attach: the kernel only takes
+ * back as many connections as the device was set up with.
+ */
+static std::string mapping_config_path(const std::string &devpath)
+{
+  return g_conf()->run_dir + "/rbd-nbd-" +
+    fs::path(devpath).filename().string() + ".conf";
+}
+
+static int save_mapping_config(const Config *cfg)
+{
+  std::string path = mapping_config_path(cfg->devpath);
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream ofs(tmp_path, std::ofstream::trunc);
+    ofs << "num_connections=" << cfg->num_connections << std::endl;
+    if (!ofs) {
+      return -EIO;
+    }
+  }
+  if (::rename(tmp_path.c_str(), path.c_str()) < 0) {
+    int r = -errno;
+    ::unlink(tmp_path.c_str());
+    return r;
+  }
+  return 0;
+}
+
+static int load_mapping_config(const std::string &devpath,
+                               int *num_connections)
+{
+  std::ifstream ifs(mapping_config_path(devpath));
+  if (!ifs.is_open()) {
+    return -ENOENT;
+  }
+  std::string line;
+  while (std::getline(ifs, line)) {
+    if (sscanf(line.c_str(), "num_connections=%d", num_connections) == 1 &&
+        *num_connections > 0) {
+      return 0;
+    }
+  }
+  return -EINVAL;
+}
+
+static void remove_mapping_config(const std::string &devpath)
+{
+  ::unlink(mapping_config_path(devpath).c_str());
+}
+
+// The kernel takes a single connection per device over ioctl
+static int try_ioctl_setup(Config *cfg, const std::vector<int> &fds,
+                           uint64_t size, uint64_t flags)
 {
   int index = 0, r;
 
+  ceph_assert(fds.size() == 1);
+
   if (cfg->devpath.empty()) {
     char dev[64];
     const char *path = "/sys/module/nbd/parameters/nbds_max";
@@ -1005,7 +1244,7 @@ static int try_ioctl_setup(Config *cfg, int fd, uint64_t size, uint64_t flags)
         goto done;
       }
 
-      r = ioctl(nbd, NBD_SET_SOCK, fd);
+      r = ioctl(nbd, NBD_SET_SOCK, fds[0]);
       if (r < 0) {
         close(nbd);
         ++index;
@@ -1028,7 +1267,7 @@ static int try_ioctl_setup(Config *cfg, int fd, uint64_t size, uint64_t flags)
       goto done;
     }
 
-    r = ioctl(nbd, NBD_SET_SOCK, fd);
+    r = ioctl(nbd, NBD_SET_SOCK, fds[0]);
     if (r < 0) {
       r = -errno;
       cerr << "rbd-nbd: the device " << cfg->devpath << " is busy" << std::endl;
@@ -1247,8 +1486,9 @@ static int netlink_connect_cb(struct nl_msg *msg, void *arg)
   return NL_OK;
 }
 
-static int netlink_connect(Config *cfg, struct nl_sock *sock, int nl_id, int fd,
-                           uint64_t size, uint64_t flags, bool reconnect)
+static int netlink_connect(Config *cfg, struct nl_sock *sock, int nl_id,
+                           const std::vector<int> &fds, uint64_t size,
+                           uint64_t flags, bool reconnect)
 {
   struct nlattr *sock_attr;
   struct nlattr *sock_opt;
@@ -1301,14 +1541,16 @@ static int netlink_connect(Config *cfg, struct nl_sock *sock, int nl_id, int fd,
     goto free_msg;
   }
 
-  sock_opt = nla_nest_start(msg, NBD_SOCK_ITEM);
-  if (!sock_opt) {
-    cerr << "rbd-nbd: Could not init sock in netlink message." << std::endl;
-    goto free_msg;
-  }
+  for (auto fd : fds) {
+    sock_opt = nla_nest_start(msg, NBD_SOCK_ITEM);
+    if (!sock_opt) {
+      cerr << "rbd-nbd: Could not init sock in netlink message." << std::endl;
+      goto free_msg;
+    }
 
-  NLA_PUT_U32(msg, NBD_SOCK_FD, fd);
-  nla_nest_end(msg, sock_opt);
+    NLA_PUT_U32(msg, NBD_SOCK_FD, fd);
+    nla_nest_end(msg, sock_opt);
+  }
   nla_nest_end(msg, sock_attr);
 
   ret = nl_send_sync(sock, msg);
@@ -1327,22 +1569,34 @@ free_msg:
   return -EIO;
 }
 
-static int try_netlink_setup(Config *cfg, int fd, uint64_t size, uint64_t flags,
-                             bool reconnect)
+static bool netlink_supported()
 {
   struct nl_sock *sock;
-  int nl_id, ret;
+  int nl_id;
 
   sock = netlink_init(&nl_id);
   if (!sock) {
-    cerr << "rbd-nbd: Netlink interface not supported. Using ioctl interface."
-         << std::endl;
-    return 1;
+    return false;
   }
+  netlink_cleanup(sock);
 
   dout(10) << "netlink interface supported." << dendl;
+  return true;
+}
+
+static int try_netlink_setup(Config *cfg, const std::vector<int> &fds,
+                             uint64_t size, uint64_t flags, bool reconnect)
+{
+  struct nl_sock *sock;
+  int nl_id, ret;
+
+  sock = netlink_init(&nl_id);
+  if (!sock) {
+    cerr << "rbd-nbd: failed to initialize netlink" << std::endl;
+    return -EIO;
+  }
 
-  ret = netlink_connect(cfg, sock, nl_id, fd, size, flags, reconnect);
+  ret = netlink_connect(cfg, sock, nl_id, fds, size, flags, reconnect);
   netlink_cleanup(sock);
 
   if (ret != 0)
@@ -1392,17 +1646,20 @@ static void handle_signal(int signum)
   ceph_assert(signum == SIGINT || signum == SIGTERM);
   derr << "*** Got signal " << sig_str(signum) << " ***" << dendl;
 
+  got_signal = true;
+
   dout(20) << __func__ << ": " << "notifying terminate" << dendl;
 
   ceph_assert(terminate_event_sock.is_valid());
   terminate_event_sock.notify();
 }
 
-static NBDServer *start_server(int fd, librbd::Image& image, Config *cfg)
+static NBDServer *start_server(const std::vector<int> &fds,
+                               librbd::Image& image, Config *cfg)
 {
   NBDServer *server;
 
-  server = new NBDServer(fd, image, cfg);
+  server = new NBDServer(fds, image, cfg);
   server->start();
 
   init_async_signal_handler();
@@ -1496,7 +1753,8 @@ static int do_map(int argc, const char *argv[], Config *cfg, bool reconnect)
   unsigned long size;
   bool use_netlink;
 
-  int fd[2];
+  std::vector<int> kernel_fds;
+  std::vector<int> server_fds;
 
   librbd::image_info_t info;
 
@@ -1538,11 +1796,6 @@ static int do_map(int argc, const char *argv[], Config *cfg, bool reconnect)
   common_init_finish(g_ceph_context);
   global_init_chdir(g_ceph_context);
 
-  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fd) == -1) {
-    r = -errno;
-    goto close_ret;
-  }
-
   r = rados.init_with_context(g_ceph_context);
   if (r < 0)
     goto close_fd;
@@ -1599,20 +1852,68 @@ static int do_map(int argc, const char *argv[], Config *cfg, bool reconnect)
   if (r < 0)
     goto close_fd;
 
-  server = start_server(fd[1], image, cfg);
-
   use_netlink = cfg->try_netlink || reconnect;
+  if (use_netlink && !netlink_supported()) {
+    cerr << "rbd-nbd: Netlink interface not supported. Using ioctl interface."
+         << std::endl;
+    use_netlink = false;
+  }
+
+  if (reconnect) {
+    int num_connections;
+    r = load_mapping_config(cfg->devpath, &num_connections);
+    if (r == 0) {
+      if (cfg->num_connections == 0) {
+        cfg->num_connections = num_connections;
+      } else if (cfg->num_connections != num_connections) {
+        cerr << "rbd-nbd: " << cfg->devpath << " was mapped with "
+             << num_connections << " connections" << std::endl;
+        r = -EINVAL;
+        goto close_fd;
+      }
+    } else if (r != -ENOENT) {
+      derr << "failed to load " << mapping_config_path(cfg->devpath) << ": "
+           << cpp_strerror(r) << dendl;
+    }
+  }
+
+  if (!use_netlink) {
+    if (cfg->num_connections > 1) {
+      cerr << "rbd-nbd: more than one connection requires the netlink "
+           << "interface (--try-netlink)" << std::endl;
+      r = -EINVAL;
+      goto close_fd;
+    }
+    cfg->num_connections = 1;
+  } else if (cfg->num_connections == 0) {
+    cfg->num_connections = std::max(1U, std::thread::hardware_concurrency());
+  }
+#ifdef NBD_FLAG_CAN_MULTI_CONN
+  if (cfg->num_connections > 1) {
+    flags |= NBD_FLAG_CAN_MULTI_CONN;
+  }
+#endif
+
+  for (int i = 0; i < cfg->num_connections; i++) {
+    int fd[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fd) == -1) {
+      r = -errno;
+      goto close_fd;
+    }
+    kernel_fds.push_back(fd[0]);
+    server_fds.push_back(fd[1]);
+  }
+
+  server = start_server(server_fds, image, cfg);
+
   if (use_netlink) {
-    r = try_netlink_setup(cfg, fd[0], size, flags, reconnect);
-    if (r < 0) {
+    r = try_netlink_setup(cfg, kernel_fds, size, flags, reconnect);
+    if (r < 0)
       goto free_server;
-    } else if (r == 1) {
-      use_netlink = false;
-    }
   }
 
   if (!use_netlink) {
-    r = try_ioctl_setup(cfg, fd[0], size, flags);
+    r = try_ioctl_setup(cfg, kernel_fds, size, flags);
     if (r < 0)
       goto free_server;
   }
@@ -1645,10 +1946,24 @@ static int do_map(int argc, const char *argv[], Config *cfg, bool reconnect)
     if (r < 0)
       goto close_nbd;
 
+    if (use_netlink) {
+      r = save_mapping_config(cfg);
+      if (r < 0) {
+        derr << "failed to save " << mapping_config_path(cfg->devpath)
+             << ": " << cpp_strerror(r) << dendl;
+        r = 0;
+      }
+    }
+
     cout << cfg->devpath << std::endl;
 
     run_server(forker, server, use_netlink);
 
+    // Kept for attach while detached, until the device is disconnected
+    if (use_netlink && !got_signal) {
+      remove_mapping_config(cfg->devpath);
+    }
+
     if (cfg->quiesce) {
       r = image.quiesce_unwatch(server->quiesce_watch_handle);
       ceph_assert(r == 0);
@@ -1672,9 +1987,13 @@ close_nbd:
 free_server:
   delete server;
 close_fd:
-  close(fd[0]);
-  close(fd[1]);
-close_ret:
+  for (auto fd : kernel_fds) {
+    close(fd);
+  }
+  for (auto fd : server_fds) {
+    close(fd);
+  }
+
   image.close();
   io_ctx.close();
   rados.shutdown();
@@ -1875,6 +2194,16 @@ static int parse_args(vector<const char*>& args, std::ostream *err_msg,
         *err_msg << "rbd-nbd: Invalid argument for nbds_max!";
         return -EINVAL;
       }
+    } else if (ceph_argparse_witharg(args, i, &cfg->num_connections, err,
+                                     "--num-connections", (char *)NULL)) {
+      if (!err.str().empty()) {
+        *err_msg << "rbd-nbd: " << err.str();
+        return -EINVAL;
+      }
+      if (cfg->num_connections <= 0) {
+        *err_msg << "rbd-nbd: Invalid argument for num-connections!";
+        return -EINVAL;
+      }
     } else if (ceph_argparse_witharg(args, i, &cfg->max_part, err, "--max_part", (char *)NULL)) {
       if (!err.str().empty()) {
         *err_msg << "rbd-nbd: " << err.str();